@@ -1010,6 +1010,66 @@ static BOOLEAN PhpShowErrorProcess(
     }
 }
 
+// Processes that need phsvc are collected in a batch, which is sent to the server in a single
+// call once every process has been tried. The connection made for the first of these processes
+// is kept open until then.
+
+static VOID PhpAddElevatedProcessCommand(
+    _In_ HWND hWnd,
+    _In_ PWSTR Verb,
+    _Inout_ PPHSVC_BATCH *Batch,
+    _Inout_ PPH_LIST *BatchProcesses,
+    _In_ PPH_PROCESS_ITEM Process,
+    _In_ PHSVC_API_CONTROLPROCESS_COMMAND Command
+    )
+{
+    NTSTATUS status;
+
+    if (*Batch)
+    {
+        PhUiDisconnectFromPhSvc();
+    }
+    else
+    {
+        *Batch = PhSvcCreateBatch();
+        *BatchProcesses = PhCreateList(4);
+    }
+
+    if (NT_SUCCESS(status = PhSvcBatchControlProcess(*Batch, Process->ProcessId, Command, 0)))
+        PhAddItemList(*BatchProcesses, Process);
+    else
+        PhpShowErrorProcess(hWnd, Verb, Process, status, 0);
+}
+
+static BOOLEAN PhpExecuteElevatedProcessCommands(
+    _In_ HWND hWnd,
+    _In_ PWSTR Verb,
+    _In_ PPHSVC_BATCH Batch,
+    _In_ PPH_LIST BatchProcesses
+    )
+{
+    BOOLEAN success = FALSE;
+    ULONG i;
+
+    PhSvcExecuteBatch(Batch);
+
+    for (i = 0; i < BatchProcesses->Count; i++)
+    {
+        NTSTATUS status;
+
+        if (NT_SUCCESS(status = PhSvcGetBatchEntryStatus(Batch, i)))
+            success = TRUE;
+        else if (!PhpShowErrorProcess(hWnd, Verb, BatchProcesses->Items[i], status, 0))
+            break;
+    }
+
+    PhSvcDestroyBatch(Batch);
+    PhDereferenceObject(BatchProcesses);
+    PhUiDisconnectFromPhSvc();
+
+    return success;
+}
+
 BOOLEAN PhUiTerminateProcesses(
     _In_ HWND hWnd,
     _In_ PPH_PROCESS_ITEM *Processes,
@@ -1018,6 +1078,8 @@ BOOLEAN PhUiTerminateProcesses(
 {
     BOOLEAN success = TRUE;
     BOOLEAN cancelled = FALSE;
+    PPHSVC_BATCH batch = NULL;
+    PPH_LIST batchProcesses = NULL;
     ULONG i;
 
     if (!PhpShowContinueMessageProcesses(
@@ -1064,12 +1126,7 @@ BOOLEAN PhUiTerminateProcesses(
             {
                 if (connected)
                 {
-                    if (NT_SUCCESS(status = PhSvcCallControlProcess(Processes[i]->ProcessId, PhSvcControlProcessTerminate, 0)))
-                        success = TRUE;
-                    else
-                        PhpShowErrorProcess(hWnd, L"terminate", Processes[i], status, 0);
-
-                    PhUiDisconnectFromPhSvc();
+                    PhpAddElevatedProcessCommand(hWnd, L"terminate", &batch, &batchProcesses, Processes[i], PhSvcControlProcessTerminate);
                 }
                 else
                 {
@@ -1084,6 +1141,9 @@ BOOLEAN PhUiTerminateProcesses(
         }
     }
 
+    if (batch && PhpExecuteElevatedProcessCommands(hWnd, L"terminate", batch, batchProcesses))
+        success = TRUE;
+
     return success;
 }
 
@@ -1216,6 +1276,8 @@ BOOLEAN PhUiSuspendProcesses(
 {
     BOOLEAN success = TRUE;
     BOOLEAN cancelled = FALSE;
+    PPHSVC_BATCH batch = NULL;
+    PPH_LIST batchProcesses = NULL;
     ULONG i;
 
     if (!PhpShowContinueMessageProcesses(
@@ -1258,12 +1320,7 @@ BOOLEAN PhUiSuspendProcesses(
             {
                 if (connected)
                 {
-                    if (NT_SUCCESS(status = PhSvcCallControlProcess(Processes[i]->ProcessId, PhSvcControlProcessSuspend, 0)))
-                        success = TRUE;
-                    else
-                        PhpShowErrorProcess(hWnd, L"suspend", Processes[i], status, 0);
-
-                    PhUiDisconnectFromPhSvc();
+                    PhpAddElevatedProcessCommand(hWnd, L"suspend", &batch, &batchProcesses, Processes[i], PhSvcControlProcessSuspend);
                 }
                 else
                 {
@@ -1278,6 +1335,9 @@ BOOLEAN PhUiSuspendProcesses(
         }
     }
 
+    if (batch && PhpExecuteElevatedProcessCommands(hWnd, L"suspend", batch, batchProcesses))
+        success = TRUE;
+
     return success;
 }
 
@@ -1289,6 +1349,8 @@ BOOLEAN PhUiResumeProcesses(
 {
     BOOLEAN success = TRUE;
     BOOLEAN cancelled = FALSE;
+    PPHSVC_BATCH batch = NULL;
+    PPH_LIST batchProcesses = NULL;
     ULONG i;
 
     if (!PhpShowContinueMessageProcesses(
@@ -1331,12 +1393,7 @@ BOOLEAN PhUiResumeProcesses(
             {
                 if (connected)
                 {
-                    if (NT_SUCCESS(status = PhSvcCallControlProcess(Processes[i]->ProcessId, PhSvcControlProcessResume, 0)))
-                        success = TRUE;
-                    else
-                        PhpShowErrorProcess(hWnd, L"resume", Processes[i], status, 0);
-
-                    PhUiDisconnectFromPhSvc();
+                    PhpAddElevatedProcessCommand(hWnd, L"resume", &batch, &batchProcesses, Processes[i], PhSvcControlProcessResume);
                 }
                 else
                 {
@@ -1351,6 +1408,9 @@ BOOLEAN PhUiResumeProcesses(
         }
     }
 
+    if (batch && PhpExecuteElevatedProcessCommands(hWnd, L"resume", batch, batchProcesses))
+        success = TRUE;
+
     return success;
 }
 
@@ -1362,6 +1422,8 @@ BOOLEAN PhUiRestartProcess(
     NTSTATUS status;
     BOOLEAN cont = FALSE;
     HANDLE processHandle = NULL;
+    PH_PEB_OFFSET offsets[2] = { PhpoCommandLine, PhpoCurrentDirectory };
+    PPH_STRING strings[2];
     PPH_STRING commandLine;
     PPH_STRING currentDirectory;
 
@@ -1394,21 +1456,17 @@ BOOLEAN PhUiRestartProcess(
         )))
         goto ErrorExit;
 
-    if (!NT_SUCCESS(status = PhGetProcessCommandLine(
+    if (!NT_SUCCESS(status = PhGetProcessPebStrings(
         processHandle,
-        &commandLine
+        RTL_NUMBER_OF(offsets),
+        offsets,
+        strings
         )))
         goto ErrorExit;
 
+    commandLine = strings[0];
+    currentDirectory = strings[1];
     PH_AUTO(commandLine);
-
-    if (!NT_SUCCESS(status = PhGetProcessPebString(
-        processHandle,
-        PhpoCurrentDirectory,
-        &currentDirectory
-        )))
-        goto ErrorExit;
-
     PH_AUTO(currentDirectory);
 
     NtClose(processHandle);
@@ -31,7 +31,7 @@ typedef struct _CHOOSE_PROCESS_DIALOG_CONTEXT
 
     PH_LAYOUT_MANAGER LayoutManager;
     RECT MinimumSize;
-    HIMAGELIST ImageList;
+    PPH_LIST FileIcons;
     HWND ListViewHandle;
 } CHOOSE_PROCESS_DIALOG_CONTEXT, *PCHOOSE_PROCESS_DIALOG_CONTEXT;
 
@@ -81,6 +81,7 @@ static VOID PhpRefreshProcessList(
     NTSTATUS status;
     PVOID processes;
     PSYSTEM_PROCESS_INFORMATION process;
+    ULONG i;
 
     if (!NT_SUCCESS(status = PhEnumProcesses(&processes)))
     {
@@ -90,7 +91,11 @@ static VOID PhpRefreshProcessList(
 
     ExtendedListView_SetRedraw(Context->ListViewHandle, FALSE);
     ListView_DeleteAllItems(Context->ListViewHandle);
-    ImageList_RemoveAll(Context->ImageList);
+
+    for (i = 0; i < Context->FileIcons->Count; i++)
+        PhDereferenceFileIcon(Context->FileIcons->Items[i]);
+
+    PhClearList(Context->FileIcons);
 
     process = PH_FIRST_PROCESS(processes);
 
@@ -100,10 +105,9 @@ static VOID PhpRefreshProcessList(
         PPH_STRING name;
         HANDLE processHandle;
         PPH_STRING fileName = NULL;
-        HICON icon = NULL;
+        PPH_FILE_ICON fileIcon;
         WCHAR processIdString[PH_INT32_STR_LEN_1];
         PPH_STRING userName = NULL;
-        INT imageIndex = INT_MAX;
 
         if (process->UniqueProcessId != SYSTEM_IDLE_PROCESS_ID)
             name = PhCreateStringFromUnicodeString(&process->ImageName);
@@ -148,20 +152,13 @@ static VOID PhpRefreshProcessList(
         // Icon
         if (!PhIsNullOrEmptyString(fileName))
         {
-            PhExtractIcon(PhGetString(fileName), NULL, &icon);
-        }
-
-        if (icon)
-        {
-            imageIndex = ImageList_AddIcon(Context->ImageList, icon);
-            PhSetListViewItemImageIndex(Context->ListViewHandle, lvItemIndex, imageIndex);
-            DestroyIcon(icon);
+            fileIcon = PhGetFileIcon(PhGetString(fileName), 0);
+            PhAddItemList(Context->FileIcons, fileIcon);
+            PhSetListViewItemImageIndex(Context->ListViewHandle, lvItemIndex, PhGetFileIconImageListIndex(fileIcon));
         }
         else
         {
-            PhGetStockApplicationIcon(NULL, &icon);
-            imageIndex = ImageList_AddIcon(Context->ImageList, icon);
-            PhSetListViewItemImageIndex(Context->ListViewHandle, lvItemIndex, imageIndex);
+            PhSetListViewItemImageIndex(Context->ListViewHandle, lvItemIndex, 0); // stock application icon
         }
 
         // PID
@@ -235,7 +232,7 @@ INT_PTR CALLBACK PhpChooseProcessDlgProc(
             MapDialogRect(hwndDlg, &context->MinimumSize);
 
             context->ListViewHandle = lvHandle = GetDlgItem(hwndDlg, IDC_LIST);
-            context->ImageList = ImageList_Create(PhSmallIconSize.X, PhSmallIconSize.Y, ILC_COLOR32 | ILC_MASK, 0, 40);
+            context->FileIcons = PhCreateList(64);
 
             PhSetListViewStyle(lvHandle, FALSE, TRUE);
             PhSetControlTheme(lvHandle, L"explorer");
@@ -244,7 +241,7 @@ INT_PTR CALLBACK PhpChooseProcessDlgProc(
             PhAddListViewColumn(lvHandle, 2, 2, 2, LVCFMT_LEFT, 160, L"User name");
             PhSetExtendedListView(lvHandle);
 
-            ListView_SetImageList(lvHandle, context->ImageList, LVSIL_SMALL);
+            ListView_SetImageList(lvHandle, PhGetFileIconImageList(), LVSIL_SMALL);
 
             PhpRefreshProcessList(hwndDlg, context);
 
@@ -253,7 +250,12 @@ INT_PTR CALLBACK PhpChooseProcessDlgProc(
         break;
     case WM_DESTROY:
         {
-            ImageList_Destroy(context->ImageList);
+            ULONG i;
+
+            for (i = 0; i < context->FileIcons->Count; i++)
+                PhDereferenceFileIcon(context->FileIcons->Items[i]);
+
+            PhDereferenceObject(context->FileIcons);
             PhDeleteLayoutManager(&context->LayoutManager);
         }
         break;
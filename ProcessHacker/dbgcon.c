@@ -35,10 +35,14 @@
 #include <workqueue.h>
 #include <workqueuep.h>
 
+#include <mainwnd.h>
+#include <phplug.h>
 #include <procprv.h>
 #include <srvprv.h>
 #include <thrdprv.h>
 
+#include <mainwndp.h>
+
 typedef struct _STRING_TABLE_ENTRY
 {
     PPH_STRING String;
@@ -769,6 +773,7 @@ NTSTATUS PhpDebugConsoleThreadStart(
                 L"dumpautopool\n"
                 L"threads\n"
                 L"provthreads\n"
+                L"providers\n"
                 L"workqueues\n"
                 L"procrecords\n"
                 L"procitem\n"
@@ -1310,12 +1315,29 @@ NTSTATUS PhpDebugConsoleThreadStart(
                     while (providerEntry != &providerThread->ListHead)
                     {
                         PPH_PROVIDER_REGISTRATION registration;
+                        PPH_PROVIDER_STATISTICS statistics;
 
                         registration = CONTAINING_RECORD(providerEntry, PH_PROVIDER_REGISTRATION, ListEntry);
+                        statistics = &registration->Statistics;
 
                         wprintf(L"\tProvider registration at %Ix\n", (ULONG_PTR)registration);
                         wprintf(L"\t\tEnabled: %s\n", registration->Enabled ? L"Yes" : L"No");
                         wprintf(L"\t\tFunction: %s\n", PhpGetSymbolForAddress(registration->Function));
+                        wprintf(L"\t\tInterval: %u ms, flags: %x, backoff: %u\n",
+                            registration->Interval ? registration->Interval : providerThread->Interval,
+                            registration->Flags,
+                            statistics->Backoff
+                            );
+                        wprintf(L"\t\tRuns: %u, skipped: %u\n", statistics->NumberOfRuns, statistics->NumberOfSkippedRuns);
+
+                        if (statistics->NumberOfRuns != 0)
+                        {
+                            wprintf(L"\t\tRun time: last %.3f ms, average %.3f ms, maximum %.3f ms\n",
+                                (DOUBLE)statistics->LastRunTime / PH_TICKS_PER_MS,
+                                (DOUBLE)statistics->TotalRunTime / statistics->NumberOfRuns / PH_TICKS_PER_MS,
+                                (DOUBLE)statistics->MaximumRunTime / PH_TICKS_PER_MS
+                                );
+                        }
 
                         if (registration->Object)
                         {
@@ -1337,6 +1359,44 @@ NTSTATUS PhpDebugConsoleThreadStart(
             wprintf(commandDebugOnly);
 #endif
         }
+        else if (PhEqualStringZ(command, L"providers", TRUE))
+        {
+            static struct
+            {
+                PWSTR Name;
+                PPH_PROVIDER_REGISTRATION Registration;
+            } providers[] =
+            {
+                { L"Processes", &PhMwpProcessProviderRegistration },
+                { L"Services", &PhMwpServiceProviderRegistration },
+                { L"Network", &PhMwpNetworkProviderRegistration },
+                { L"Events", &PhMwpProcessEventProviderRegistration }
+            };
+            ULONG i;
+
+            wprintf(L"%-10s %7s %7s %7s %8s %10s %10s %10s\n",
+                L"Provider", L"Enabled", L"Backoff", L"Runs", L"Skipped", L"Last (ms)", L"Avg (ms)", L"Max (ms)");
+
+            for (i = 0; i < RTL_NUMBER_OF(providers); i++)
+            {
+                PH_PROVIDER_STATISTICS statistics;
+
+                PhGetStatisticsProvider(providers[i].Registration, &statistics);
+
+                wprintf(L"%-10s %7s %7u %7u %8u %10.3f %10.3f %10.3f\n",
+                    providers[i].Name,
+                    PhGetEnabledProvider(providers[i].Registration) ? L"Yes" : L"No",
+                    statistics.Backoff,
+                    statistics.NumberOfRuns,
+                    statistics.NumberOfSkippedRuns,
+                    (DOUBLE)statistics.LastRunTime / PH_TICKS_PER_MS,
+                    statistics.NumberOfRuns ? (DOUBLE)statistics.TotalRunTime / statistics.NumberOfRuns / PH_TICKS_PER_MS : 0.0,
+                    (DOUBLE)statistics.MaximumRunTime / PH_TICKS_PER_MS
+                    );
+            }
+
+            wprintf(L"Background: %s\n", PhPrimaryProviderThread.Background ? L"Yes" : L"No");
+        }
         else if (PhEqualStringZ(command, L"workqueues", TRUE))
         {
 #ifdef DEBUG
@@ -0,0 +1,710 @@
+/*
+ * Process Hacker -
+ *   headless export mode
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Export mode runs the process, service, network, handle and module providers without creating
+ * any windows and writes a row for each item to a file at a fixed interval. CSV and JSON Lines
+ * rows are formatted into a single reusable buffer and written to the file stream as soon as they
+ * are complete, so memory usage does not depend on the number of samples. In the snapshot format
+ * (see colsnap.h), each sample is encoded column by column and written once it is complete.
+ *
+ * Fields that the providers query asynchronously (e.g. user names) may be empty in the first
+ * sample.
+ */
+
+#include <phapp.h>
+
+#include <json.h>
+
+#include <hndlprv.h>
+#include <modprv.h>
+#include <netprv.h>
+#include <procprv.h>
+#include <srvprv.h>
+
+#define PH_EXPORT_PROCESSES 0x1
+#define PH_EXPORT_SERVICES 0x2
+#define PH_EXPORT_NETWORK 0x4
+#define PH_EXPORT_HANDLES 0x8
+#define PH_EXPORT_THREADS 0x10
+#define PH_EXPORT_MODULES 0x20
+
+typedef enum _PH_EXPORT_FORMAT
+{
+    ExportCsvFormat,
+    ExportJsonLinesFormat,
+    ExportSnapshotFormat
+} PH_EXPORT_FORMAT;
+
+typedef struct _PH_EXPORT_CONTEXT
+{
+    PPH_FILE_STREAM FileStream;
+    PH_EXPORT_FORMAT Format;
+    ULONG Types;
+
+    LARGE_INTEGER SampleTime;
+    ULONG ColumnIndex;
+
+    // CSV
+    BOOLEAN HeaderWritten;
+    PH_STRING_BUILDER HeaderBuilder;
+    PH_STRING_BUILDER RowBuilder;
+
+    // JSON Lines
+    PH_JSON_WRITER JsonWriter;
+
+    // Snapshot
+    PPH_SNAPSHOT_WRITER SnapshotWriter;
+    PH_BYTES_BUILDER SnapshotBuilder;
+} PH_EXPORT_CONTEXT, *PPH_EXPORT_CONTEXT;
+
+static ULONG PhpParseExportTypes(
+    _In_ PPH_STRINGREF Types
+    )
+{
+    ULONG types = 0;
+    PH_STRINGREF remainingPart;
+    PH_STRINGREF part;
+
+    remainingPart = *Types;
+
+    while (remainingPart.Length != 0)
+    {
+        PhSplitStringRefAtChar(&remainingPart, L',', &part, &remainingPart);
+
+        if (PhEqualStringRef2(&part, L"processes", TRUE))
+            types |= PH_EXPORT_PROCESSES;
+        else if (PhEqualStringRef2(&part, L"services", TRUE))
+            types |= PH_EXPORT_SERVICES;
+        else if (PhEqualStringRef2(&part, L"network", TRUE))
+            types |= PH_EXPORT_NETWORK;
+        else if (PhEqualStringRef2(&part, L"handles", TRUE))
+            types |= PH_EXPORT_HANDLES;
+        else if (PhEqualStringRef2(&part, L"threads", TRUE))
+            types |= PH_EXPORT_THREADS;
+        else if (PhEqualStringRef2(&part, L"modules", TRUE))
+            types |= PH_EXPORT_MODULES;
+        else
+            return 0;
+    }
+
+    return types;
+}
+
+static VOID PhpClearStringBuilder(
+    _Inout_ PPH_STRING_BUILDER StringBuilder
+    )
+{
+    PhRemoveStringBuilder(StringBuilder, 0, StringBuilder->String->Length / sizeof(WCHAR));
+}
+
+static VOID PhpExportInteger(
+    _Inout_ PPH_EXPORT_CONTEXT Context,
+    _In_ PSTR Name,
+    _In_ LONG64 Value
+    )
+{
+    if (Context->Format == ExportCsvFormat)
+    {
+        PH_FORMAT format;
+        WCHAR buffer[PH_INT64_STR_LEN_1];
+        SIZE_T returnLength;
+
+        if (!Context->HeaderWritten)
+        {
+            if (Context->ColumnIndex != 0)
+                PhAppendCharStringBuilder(&Context->HeaderBuilder, L',');
+
+            while (*Name)
+                PhAppendCharStringBuilder(&Context->HeaderBuilder, *Name++);
+        }
+
+        if (Context->ColumnIndex != 0)
+            PhAppendCharStringBuilder(&Context->RowBuilder, L',');
+
+        PhInitFormatI64D(&format, Value);
+
+        if (PhFormatToBuffer(&format, 1, buffer, sizeof(buffer), &returnLength))
+            PhAppendStringBuilderEx(&Context->RowBuilder, buffer, returnLength - sizeof(UNICODE_NULL));
+    }
+    else if (Context->Format == ExportSnapshotFormat)
+    {
+        PhAddSnapshotInteger(Context->SnapshotWriter, Name, Value);
+    }
+    else
+    {
+        PhWriteJsonInteger64(&Context->JsonWriter, Name, Value);
+    }
+
+    Context->ColumnIndex++;
+}
+
+static VOID PhpExportString(
+    _Inout_ PPH_EXPORT_CONTEXT Context,
+    _In_ PSTR Name,
+    _In_opt_ PPH_STRINGREF Value
+    )
+{
+    if (Context->Format == ExportCsvFormat)
+    {
+        if (!Context->HeaderWritten)
+        {
+            if (Context->ColumnIndex != 0)
+                PhAppendCharStringBuilder(&Context->HeaderBuilder, L',');
+
+            while (*Name)
+                PhAppendCharStringBuilder(&Context->HeaderBuilder, *Name++);
+        }
+
+        if (Context->ColumnIndex != 0)
+            PhAppendCharStringBuilder(&Context->RowBuilder, L',');
+
+        PhAppendCharStringBuilder(&Context->RowBuilder, L'\"');
+
+        if (Value)
+        {
+            PH_STRINGREF remainingPart;
+            PH_STRINGREF part;
+
+            // Quotes are escaped by doubling them.
+
+            remainingPart = *Value;
+
+            while (PhSplitStringRefAtChar(&remainingPart, L'\"', &part, &remainingPart))
+            {
+                PhAppendStringBuilder(&Context->RowBuilder, &part);
+                PhAppendStringBuilder2(&Context->RowBuilder, L"\"\"");
+            }
+
+            PhAppendStringBuilder(&Context->RowBuilder, &part);
+        }
+
+        PhAppendCharStringBuilder(&Context->RowBuilder, L'\"');
+    }
+    else if (Context->Format == ExportSnapshotFormat)
+    {
+        PhAddSnapshotString(Context->SnapshotWriter, Name, Value);
+    }
+    else
+    {
+        if (Value)
+            PhWriteJsonString(&Context->JsonWriter, Name, Value);
+        else
+            PhWriteJsonNull(&Context->JsonWriter, Name);
+    }
+
+    Context->ColumnIndex++;
+}
+
+static VOID PhpExportStringZ(
+    _Inout_ PPH_EXPORT_CONTEXT Context,
+    _In_ PSTR Name,
+    _In_opt_ PWSTR Value
+    )
+{
+    PH_STRINGREF string;
+
+    if (Value)
+    {
+        PhInitializeStringRefLongHint(&string, Value);
+        PhpExportString(Context, Name, &string);
+    }
+    else
+    {
+        PhpExportString(Context, Name, NULL);
+    }
+}
+
+static VOID PhpExportBeginRow(
+    _Inout_ PPH_EXPORT_CONTEXT Context,
+    _In_ PSTR Type
+    )
+{
+    Context->ColumnIndex = 0;
+
+    if (Context->Format == ExportCsvFormat)
+    {
+        // A CSV file only contains one type of item, so the type column is omitted.
+        PhpClearStringBuilder(&Context->RowBuilder);
+    }
+    else if (Context->Format == ExportSnapshotFormat)
+    {
+        PhBeginSnapshotRow(Context->SnapshotWriter, Type);
+    }
+    else
+    {
+        PhResetJsonWriter(&Context->JsonWriter);
+        PhWriteJsonBeginObject(&Context->JsonWriter, NULL);
+        PhWriteJsonStringZ(&Context->JsonWriter, "type", Type);
+    }
+
+    PhpExportInteger(Context, "time", Context->SampleTime.QuadPart);
+}
+
+static NTSTATUS PhpExportEndRow(
+    _Inout_ PPH_EXPORT_CONTEXT Context
+    )
+{
+    NTSTATUS status;
+
+    if (Context->Format == ExportCsvFormat)
+    {
+        if (!Context->HeaderWritten)
+        {
+            PhAppendStringBuilder2(&Context->HeaderBuilder, L"\r\n");
+
+            if (!NT_SUCCESS(status = PhWriteStringAsUtf8FileStream(Context->FileStream, &Context->HeaderBuilder.String->sr)))
+                return status;
+
+            Context->HeaderWritten = TRUE;
+        }
+
+        PhAppendStringBuilder2(&Context->RowBuilder, L"\r\n");
+
+        return PhWriteStringAsUtf8FileStream(Context->FileStream, &Context->RowBuilder.String->sr);
+    }
+    else if (Context->Format == ExportSnapshotFormat)
+    {
+        // The row is written with the rest of the sample.
+        PhEndSnapshotRow(Context->SnapshotWriter);
+        return STATUS_SUCCESS;
+    }
+    else
+    {
+        PhWriteJsonEndObject(&Context->JsonWriter);
+
+        if (!NT_SUCCESS(status = PhWriteFileStream(
+            Context->FileStream,
+            Context->JsonWriter.BytesBuilder.Bytes->Buffer,
+            (ULONG)Context->JsonWriter.BytesBuilder.Bytes->Length
+            )))
+            return status;
+
+        return PhWriteFileStream(Context->FileStream, "\n", 1);
+    }
+}
+
+static NTSTATUS PhpExportProcesses(
+    _Inout_ PPH_EXPORT_CONTEXT Context
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PPH_PROCESS_ITEM *processes;
+    ULONG numberOfProcesses;
+    ULONG i;
+
+    PhEnumProcessItems(&processes, &numberOfProcesses);
+
+    for (i = 0; i < numberOfProcesses; i++)
+    {
+        PPH_PROCESS_ITEM process = processes[i];
+
+        if (NT_SUCCESS(status))
+        {
+            PhpExportBeginRow(Context, "process");
+            PhpExportInteger(Context, "pid", HandleToUlong(process->ProcessId));
+            PhpExportInteger(Context, "ppid", HandleToUlong(process->ParentProcessId));
+            PhpExportInteger(Context, "session", process->SessionId);
+            PhpExportInteger(Context, "create_time", process->CreateTime.QuadPart);
+            PhpExportString(Context, "name", process->ProcessName ? &process->ProcessName->sr : NULL);
+            PhpExportString(Context, "file_name", process->FileNameWin32 ? &process->FileNameWin32->sr : NULL);
+            PhpExportString(Context, "command_line", process->CommandLine ? &process->CommandLine->sr : NULL);
+            PhpExportString(Context, "user", process->UserName ? &process->UserName->sr : NULL);
+            PhpExportInteger(Context, "priority", process->BasePriority);
+            PhpExportInteger(Context, "threads", process->NumberOfThreads);
+            PhpExportInteger(Context, "handles", process->NumberOfHandles);
+            PhpExportInteger(Context, "kernel_time", process->KernelTime.QuadPart);
+            PhpExportInteger(Context, "user_time", process->UserTime.QuadPart);
+            PhpExportInteger(Context, "cycles", process->CycleTimeDelta.Value);
+            PhpExportInteger(Context, "private_bytes", process->VmCounters.PagefileUsage);
+            PhpExportInteger(Context, "working_set", process->VmCounters.WorkingSetSize);
+            PhpExportInteger(Context, "page_faults", process->VmCounters.PageFaultCount);
+            PhpExportInteger(Context, "io_read_bytes", process->IoCounters.ReadTransferCount);
+            PhpExportInteger(Context, "io_write_bytes", process->IoCounters.WriteTransferCount);
+            PhpExportInteger(Context, "io_other_bytes", process->IoCounters.OtherTransferCount);
+            status = PhpExportEndRow(Context);
+        }
+
+        PhDereferenceObject(process);
+    }
+
+    PhFree(processes);
+
+    return status;
+}
+
+static NTSTATUS PhpExportThreads(
+    _Inout_ PPH_EXPORT_CONTEXT Context
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PSYSTEM_PROCESS_INFORMATION process;
+    ULONG i;
+
+    // The process provider runs on this thread, so its last snapshot of the process list can be
+    // used directly.
+    if (!PhProcessInformation)
+        return STATUS_SUCCESS;
+
+    process = PH_FIRST_PROCESS(PhProcessInformation);
+
+    do
+    {
+        for (i = 0; i < process->NumberOfThreads && NT_SUCCESS(status); i++)
+        {
+            PSYSTEM_THREAD_INFORMATION thread = &process->Threads[i];
+
+            PhpExportBeginRow(Context, "thread");
+            PhpExportInteger(Context, "pid", HandleToUlong(process->UniqueProcessId));
+            PhpExportInteger(Context, "tid", HandleToUlong(thread->ClientId.UniqueThread));
+            PhpExportInteger(Context, "create_time", thread->CreateTime.QuadPart);
+            PhpExportInteger(Context, "start_address", (ULONG_PTR)thread->StartAddress);
+            PhpExportInteger(Context, "priority", thread->Priority);
+            PhpExportInteger(Context, "base_priority", thread->BasePriority);
+            PhpExportInteger(Context, "state", thread->ThreadState);
+            PhpExportInteger(Context, "wait_reason", thread->WaitReason);
+            PhpExportInteger(Context, "kernel_time", thread->KernelTime.QuadPart);
+            PhpExportInteger(Context, "user_time", thread->UserTime.QuadPart);
+            PhpExportInteger(Context, "context_switches", thread->ContextSwitches);
+            status = PhpExportEndRow(Context);
+        }
+    } while (NT_SUCCESS(status) && (process = PH_NEXT_PROCESS(process)));
+
+    return status;
+}
+
+static NTSTATUS PhpExportServices(
+    _Inout_ PPH_EXPORT_CONTEXT Context
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PPH_SERVICE_ITEM *services;
+    ULONG numberOfServices;
+    ULONG i;
+
+    PhEnumServiceItems(&services, &numberOfServices);
+
+    for (i = 0; i < numberOfServices; i++)
+    {
+        PPH_SERVICE_ITEM service = services[i];
+
+        if (NT_SUCCESS(status))
+        {
+            PhpExportBeginRow(Context, "service");
+            PhpExportString(Context, "name", &service->Name->sr);
+            PhpExportString(Context, "display_name", service->DisplayName ? &service->DisplayName->sr : NULL);
+            PhpExportInteger(Context, "service_type", service->Type);
+            PhpExportInteger(Context, "state", service->State);
+            PhpExportInteger(Context, "start_type", service->StartType);
+            PhpExportInteger(Context, "pid", HandleToUlong(service->ProcessId));
+            PhpExportString(Context, "file_name", service->FileName ? &service->FileName->sr : NULL);
+            status = PhpExportEndRow(Context);
+        }
+
+        PhDereferenceObject(service);
+    }
+
+    PhFree(services);
+
+    return status;
+}
+
+static NTSTATUS PhpExportNetwork(
+    _Inout_ PPH_EXPORT_CONTEXT Context
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PPH_NETWORK_ITEM *networkItems;
+    ULONG numberOfNetworkItems;
+    ULONG i;
+
+    PhEnumNetworkItems(&networkItems, &numberOfNetworkItems);
+
+    for (i = 0; i < numberOfNetworkItems; i++)
+    {
+        PPH_NETWORK_ITEM networkItem = networkItems[i];
+
+        if (NT_SUCCESS(status))
+        {
+            PhpExportBeginRow(Context, "network");
+            PhpExportStringZ(Context, "protocol", PhGetProtocolTypeName(networkItem->ProtocolType));
+            PhpExportStringZ(Context, "local_address", networkItem->LocalAddressString);
+            PhpExportInteger(Context, "local_port", networkItem->LocalEndpoint.Port);
+            PhpExportStringZ(Context, "remote_address", networkItem->RemoteAddressString);
+            PhpExportInteger(Context, "remote_port", networkItem->RemoteEndpoint.Port);
+            PhpExportStringZ(Context, "state", (networkItem->ProtocolType & PH_TCP_PROTOCOL_TYPE) ? PhGetTcpStateName(networkItem->State) : NULL);
+            PhpExportInteger(Context, "pid", HandleToUlong(networkItem->ProcessId));
+            PhpExportString(Context, "process_name", networkItem->ProcessName ? &networkItem->ProcessName->sr : NULL);
+            status = PhpExportEndRow(Context);
+        }
+
+        PhDereferenceObject(networkItem);
+    }
+
+    PhFree(networkItems);
+
+    return status;
+}
+
+static NTSTATUS PhpExportHandles(
+    _Inout_ PPH_EXPORT_CONTEXT Context,
+    _In_ PPH_HANDLE_PROVIDER HandleProvider
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    ULONG i;
+    PPH_HASH_ENTRY entry;
+    PPH_HANDLE_ITEM handleItem;
+
+    PhAcquireQueuedLockShared(&HandleProvider->HandleHashSetLock);
+
+    for (i = 0; i < HandleProvider->HandleHashSetSize && NT_SUCCESS(status); i++)
+    {
+        for (entry = HandleProvider->HandleHashSet[i]; entry && NT_SUCCESS(status); entry = entry->Next)
+        {
+            handleItem = CONTAINING_RECORD(entry, PH_HANDLE_ITEM, HashEntry);
+
+            PhpExportBeginRow(Context, "handle");
+            PhpExportInteger(Context, "pid", HandleToUlong(HandleProvider->ProcessId));
+            PhpExportInteger(Context, "handle", (ULONG_PTR)handleItem->Handle);
+            PhpExportString(Context, "object_type", handleItem->TypeName ? &handleItem->TypeName->sr : NULL);
+            PhpExportString(Context, "name", handleItem->BestObjectName ? &handleItem->BestObjectName->sr : NULL);
+            PhpExportInteger(Context, "granted_access", handleItem->GrantedAccess);
+            PhpExportInteger(Context, "attributes", handleItem->Attributes);
+            status = PhpExportEndRow(Context);
+        }
+    }
+
+    PhReleaseQueuedLockShared(&HandleProvider->HandleHashSetLock);
+
+    return status;
+}
+
+static NTSTATUS PhpExportModules(
+    _Inout_ PPH_EXPORT_CONTEXT Context,
+    _In_ PPH_MODULE_PROVIDER ModuleProvider
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    ULONG enumerationKey = 0;
+    PPH_MODULE_ITEM *moduleItem;
+
+    PhAcquireFastLockShared(&ModuleProvider->ModuleHashtableLock);
+
+    while (NT_SUCCESS(status) && PhEnumHashtable(ModuleProvider->ModuleHashtable, (PVOID *)&moduleItem, &enumerationKey))
+    {
+        PhpExportBeginRow(Context, "module");
+        PhpExportInteger(Context, "pid", HandleToUlong(ModuleProvider->ProcessId));
+        PhpExportInteger(Context, "base_address", (ULONG_PTR)(*moduleItem)->BaseAddress);
+        PhpExportInteger(Context, "size", (*moduleItem)->Size);
+        PhpExportInteger(Context, "module_type", (*moduleItem)->Type);
+        PhpExportString(Context, "name", (*moduleItem)->Name ? &(*moduleItem)->Name->sr : NULL);
+        PhpExportString(Context, "file_name", (*moduleItem)->FileName ? &(*moduleItem)->FileName->sr : NULL);
+        PhpExportInteger(Context, "load_time", (*moduleItem)->LoadTime.QuadPart);
+        status = PhpExportEndRow(Context);
+    }
+
+    PhReleaseFastLockShared(&ModuleProvider->ModuleHashtableLock);
+
+    return status;
+}
+
+static NTSTATUS PhpExportWriteSnapshot(
+    _Inout_ PPH_EXPORT_CONTEXT Context
+    )
+{
+    NTSTATUS status;
+
+    PhWriteSnapshot(Context->SnapshotWriter, Context->SampleTime.QuadPart, &Context->SnapshotBuilder);
+
+    status = PhWriteFileStream(
+        Context->FileStream,
+        Context->SnapshotBuilder.Bytes->Buffer,
+        (ULONG)Context->SnapshotBuilder.Bytes->Length
+        );
+
+    // Reuse the buffer for the next sample.
+    Context->SnapshotBuilder.Bytes->Length = 0;
+
+    return status;
+}
+
+NTSTATUS PhExportModeStart(
+    VOID
+    )
+{
+    NTSTATUS status;
+    PH_EXPORT_CONTEXT context;
+    PPH_HANDLE_PROVIDER handleProvider = NULL;
+    PPH_MODULE_PROVIDER moduleProvider = NULL;
+    ULONG interval;
+    ULONG count;
+    ULONG i;
+
+    memset(&context, 0, sizeof(PH_EXPORT_CONTEXT));
+
+    if (!(context.Types = PhpParseExportTypes(&PhStartupParameters.ExportTypes->sr)))
+        return STATUS_INVALID_PARAMETER;
+
+    if (!PhStartupParameters.ExportFormat || PhEqualString2(PhStartupParameters.ExportFormat, L"csv", TRUE))
+        context.Format = ExportCsvFormat;
+    else if (PhEqualString2(PhStartupParameters.ExportFormat, L"jsonl", TRUE))
+        context.Format = ExportJsonLinesFormat;
+    else if (PhEqualString2(PhStartupParameters.ExportFormat, L"snapshot", TRUE))
+        context.Format = ExportSnapshotFormat;
+    else
+        return STATUS_INVALID_PARAMETER;
+
+    // CSV rows need the same columns throughout the file.
+    if (context.Format == ExportCsvFormat && (context.Types & (context.Types - 1)))
+        return STATUS_INVALID_PARAMETER;
+
+    if ((context.Types & (PH_EXPORT_HANDLES | PH_EXPORT_MODULES)) && !PhStartupParameters.ExportProcessId)
+        return STATUS_INVALID_PARAMETER;
+
+    // Sample once unless an interval was given. A zero count with an interval means sampling
+    // continues until the process is terminated.
+    interval = PhStartupParameters.ExportInterval;
+    count = PhStartupParameters.ExportCount;
+
+    if (!interval)
+        count = 1;
+
+    if (PhStartupParameters.ExportFileName)
+    {
+        status = PhCreateFileStream(
+            &context.FileStream,
+            PhStartupParameters.ExportFileName->Buffer,
+            FILE_GENERIC_WRITE,
+            FILE_SHARE_READ,
+            FILE_OVERWRITE_IF,
+            0
+            );
+    }
+    else
+    {
+        HANDLE outputHandle = NtCurrentPeb()->ProcessParameters->StandardOutput;
+
+        if (outputHandle)
+            status = PhCreateFileStream2(&context.FileStream, outputHandle, PH_FILE_STREAM_HANDLE_UNOWNED, 0);
+        else
+            status = STATUS_INVALID_HANDLE;
+    }
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    // Only addresses are exported, so don't resolve host names.
+    PhEnableNetworkProviderResolve = FALSE;
+
+    if (context.Types & PH_EXPORT_HANDLES)
+        handleProvider = PhCreateHandleProvider(UlongToHandle(PhStartupParameters.ExportProcessId));
+    if (context.Types & PH_EXPORT_MODULES)
+        moduleProvider = PhCreateModuleProvider(UlongToHandle(PhStartupParameters.ExportProcessId));
+
+    if (context.Format == ExportCsvFormat)
+    {
+        PhInitializeStringBuilder(&context.HeaderBuilder, 0x100);
+        PhInitializeStringBuilder(&context.RowBuilder, 0x200);
+    }
+    else if (context.Format == ExportSnapshotFormat)
+    {
+        context.SnapshotWriter = PhCreateSnapshotWriter();
+        PhInitializeBytesBuilder(&context.SnapshotBuilder, 0x10000);
+    }
+    else
+    {
+        PhInitializeJsonWriter(&context.JsonWriter, 0x200);
+    }
+
+    status = STATUS_SUCCESS;
+
+    for (i = 0; count == 0 || i < count; i++)
+    {
+        PH_AUTO_POOL autoPool;
+
+        if (i != 0)
+            PhDelayExecution(interval);
+
+        PhInitializeAutoPool(&autoPool);
+
+        // The service provider uses the process list, so the process provider always runs.
+        PhProcessProviderUpdate(NULL);
+
+        if (context.Types & PH_EXPORT_SERVICES)
+            PhServiceProviderUpdate(NULL);
+        if (context.Types & PH_EXPORT_NETWORK)
+            PhNetworkProviderUpdate(NULL);
+        if (handleProvider)
+            PhHandleProviderUpdate(handleProvider);
+        if (moduleProvider)
+            PhModuleProviderUpdate(moduleProvider);
+
+        PhQuerySystemTime(&context.SampleTime);
+
+        if (NT_SUCCESS(status) && (context.Types & PH_EXPORT_PROCESSES))
+            status = PhpExportProcesses(&context);
+        if (NT_SUCCESS(status) && (context.Types & PH_EXPORT_THREADS))
+            status = PhpExportThreads(&context);
+        if (NT_SUCCESS(status) && (context.Types & PH_EXPORT_SERVICES))
+            status = PhpExportServices(&context);
+        if (NT_SUCCESS(status) && (context.Types & PH_EXPORT_NETWORK))
+            status = PhpExportNetwork(&context);
+        if (NT_SUCCESS(status) && handleProvider)
+            status = PhpExportHandles(&context, handleProvider);
+        if (NT_SUCCESS(status) && moduleProvider)
+            status = PhpExportModules(&context, moduleProvider);
+        if (NT_SUCCESS(status) && context.Format == ExportSnapshotFormat)
+            status = PhpExportWriteSnapshot(&context);
+
+        // Make each sample visible to readers of the file as soon as it is complete.
+        if (NT_SUCCESS(status))
+            status = PhFlushFileStream(context.FileStream, FALSE);
+
+        PhDeleteAutoPool(&autoPool);
+
+        if (!NT_SUCCESS(status))
+            break;
+    }
+
+    if (context.Format == ExportCsvFormat)
+    {
+        PhDeleteStringBuilder(&context.HeaderBuilder);
+        PhDeleteStringBuilder(&context.RowBuilder);
+    }
+    else if (context.Format == ExportSnapshotFormat)
+    {
+        PhDestroySnapshotWriter(context.SnapshotWriter);
+        PhDeleteBytesBuilder(&context.SnapshotBuilder);
+    }
+    else
+    {
+        PhDeleteJsonWriter(&context.JsonWriter);
+    }
+
+    if (handleProvider)
+        PhDereferenceObject(handleProvider);
+    if (moduleProvider)
+        PhDereferenceObject(moduleProvider);
+
+    PhDereferenceObject(context.FileStream);
+
+    return status;
+}
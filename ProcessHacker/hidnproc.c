@@ -642,11 +642,9 @@ static PPH_PROCESS_ITEM PhpCreateProcessItemForHiddenProcess(
     if (processItem->FileName)
     {
         // Small icon, large icon.
-        PhExtractIcon(
-            processItem->FileName->Buffer,
-            &processItem->LargeIcon,
-            &processItem->SmallIcon
-            );
+        processItem->FileIcon = PhGetFileIcon(processItem->FileName->Buffer, 0);
+        processItem->SmallIcon = processItem->FileIcon->SmallIcon;
+        processItem->LargeIcon = processItem->FileIcon->LargeIcon;
 
         // Version info.
         PhInitializeImageVersionInfo(&processItem->VersionInfo, processItem->FileName->Buffer);
@@ -656,20 +654,8 @@ static PPH_PROCESS_ITEM PhpCreateProcessItemForHiddenProcess(
     {
         if (!processItem->SmallIcon || !processItem->LargeIcon)
         {
-            if (processItem->SmallIcon)
-            {
-                DestroyIcon(processItem->SmallIcon);
-                processItem->SmallIcon = NULL;
-            }
-            else if (processItem->LargeIcon)
-            {
-                DestroyIcon(processItem->LargeIcon);
-                processItem->LargeIcon = NULL;
-            }
-
+            // The stock icons are shared and are never destroyed.
             PhGetStockApplicationIcon(&processItem->SmallIcon, &processItem->LargeIcon);
-            processItem->SmallIcon = CopyIcon(processItem->SmallIcon);
-            processItem->LargeIcon = CopyIcon(processItem->LargeIcon);
         }
     }
 
@@ -18,6 +18,7 @@ typedef union _PH_MWP_NOTIFICATION_DETAILS
 extern PH_PROVIDER_REGISTRATION PhMwpProcessProviderRegistration;
 extern PH_PROVIDER_REGISTRATION PhMwpServiceProviderRegistration;
 extern PH_PROVIDER_REGISTRATION PhMwpNetworkProviderRegistration;
+extern PH_PROVIDER_REGISTRATION PhMwpProcessEventProviderRegistration;
 extern BOOLEAN PhMwpUpdateAutomatically;
 
 extern ULONG PhMwpNotifyIconNotifyMask;
@@ -337,10 +338,22 @@ VOID NTAPI PhMwpProcessesUpdatedHandler(
     _In_opt_ PVOID Context
     );
 
+VOID NTAPI PhMwpProcessEventProviderUpdate(
+    _In_ PVOID Object
+    );
+
+ULONG PhMwpFlushProcessEvents(
+    _In_ ULONG RunId
+    );
+
 VOID PhMwpOnProcessesUpdated(
     _In_ ULONG RunId
     );
 
+VOID PhMwpOnProcessEventsUpdated(
+    _In_ ULONG RunId
+    );
+
 // Services
 
 extern PPH_MAIN_TAB_PAGE PhMwpServicesPage;
@@ -69,6 +69,11 @@ PhReferenceNetworkItem(
     );
 // end_phapppub
 
+VOID PhEnumNetworkItems(
+    _Out_ PPH_NETWORK_ITEM **NetworkItems,
+    _Out_ PULONG NumberOfNetworkItems
+    );
+
 //PPH_STRING PhGetHostNameFromAddress(
 //    _In_ PPH_IP_ADDRESS Address
 //    );
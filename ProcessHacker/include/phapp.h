@@ -15,6 +15,12 @@
 #include <treenew.h>
 #include <graph.h>
 #include <circbuf.h>
+#include <histbuf.h>
+#include <binlog.h>
+#include <colsnap.h>
+#include <phquery.h>
+#include <timeline.h>
+#include <systrace.h>
 #include <dltmgr.h>
 #include <phnet.h>
 
@@ -68,10 +74,21 @@ typedef struct _PH_STARTUP_PARAMETERS
     PPH_LIST PluginParameters;
     PPH_STRING SelectTab;
     PPH_STRING SysInfo;
+
+    PPH_STRING ExportTypes;
+    PPH_STRING ExportFileName;
+    PPH_STRING ExportFormat;
+    ULONG ExportInterval;
+    ULONG ExportCount;
+    ULONG ExportProcessId;
+
+    PPH_STRING RecordTraceFileName;
+    PPH_STRING ReplayTraceFileName;
 } PH_STARTUP_PARAMETERS, *PPH_STARTUP_PARAMETERS;
 
 extern BOOLEAN PhPluginsEnabled;
 extern PPH_STRING PhSettingsFileName;
+extern PPH_STRING PhSettingsStoreFileName;
 extern PH_STARTUP_PARAMETERS PhStartupParameters;
 
 extern PH_PROVIDER_THREAD PhPrimaryProviderThread;
@@ -200,12 +217,20 @@ typedef struct _PH_LOG_ENTRY
     UCHAR Buffer[1];
 } PH_LOG_ENTRY, *PPH_LOG_ENTRY;
 
-extern PH_CIRCULAR_BUFFER_PVOID PhLogBuffer;
+extern PPH_BINARY_LOG PhLogBuffer;
 
 VOID PhLogInitialization(
     VOID
     );
 
+VOID PhFreeLogEntry(
+    _In_ _Post_invalid_ PPH_LOG_ENTRY Entry
+    );
+
+PPH_LOG_ENTRY PhReadLogEntry(
+    _In_ ULONG64 Sequence
+    );
+
 VOID PhClearLogEntries(
     VOID
     );
@@ -265,6 +290,12 @@ NTSTATUS PhCommandModeStart(
     VOID
     );
 
+// expmode
+
+NTSTATUS PhExportModeStart(
+    VOID
+    );
+
 // anawait
 
 VOID PhUiAnalyzeWaitThread(
@@ -226,4 +226,9 @@ NTSTATUS PhSvcApiQueryProcessHeapInformation(
     _Inout_ PPHSVC_API_PAYLOAD Payload
     );
 
+NTSTATUS PhSvcApiExecuteBatch(
+    _In_ PPHSVC_CLIENT Client,
+    _Inout_ PPHSVC_API_PAYLOAD Payload
+    );
+
 #endif
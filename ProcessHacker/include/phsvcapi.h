@@ -25,6 +25,7 @@ typedef enum _PHSVC_API_NUMBER
     PhSvcSetServiceSecurityApiNumber = 17,
     PhSvcWriteMiniDumpProcessApiNumber = 18, // WOW64 compatible
     PhSvcQueryProcessDebugInformationApiNumber = 19, // WOW64 compatible
+    PhSvcExecuteBatchApiNumber = 20,
     PhSvcMaximumApiNumber
 } PHSVC_API_NUMBER, *PPHSVC_API_NUMBER;
 
@@ -266,6 +267,18 @@ typedef union _PHSVC_API_PROCESSHEAPINFORMATION
     } o;
 } PHSVC_API_PROCESSHEAPINFORMATION, *PPHSVC_API_PROCESSHEAPINFORMATION;
 
+typedef union _PHSVC_API_EXECUTEBATCH
+{
+    struct
+    {
+        PH_RELATIVE_STRINGREF Batch; // PHSVC_API_BATCH
+    } i;
+    struct
+    {
+        ULONG NumberOfFailedEntries;
+    } o;
+} PHSVC_API_EXECUTEBATCH, *PPHSVC_API_EXECUTEBATCH;
+
 typedef union _PHSVC_API_PAYLOAD
 {
     PHSVC_API_CONNECTINFO ConnectInfo;
@@ -293,10 +306,23 @@ typedef union _PHSVC_API_PAYLOAD
             PHSVC_API_SETSERVICESECURITY SetServiceSecurity;
             PHSVC_API_WRITEMINIDUMPPROCESS WriteMiniDumpProcess;
             PHSVC_API_PROCESSHEAPINFORMATION QueryProcessHeap;
+            PHSVC_API_EXECUTEBATCH ExecuteBatch;
         } u;
     };
 } PHSVC_API_PAYLOAD, *PPHSVC_API_PAYLOAD;
 
+// A batch of API calls that is stored in the client's port section and sent in a single message.
+// The server executes the entries in order. As each entry completes, the server writes its status
+// and output back into the entry and then updates NumberOfCompletedEntries, so the client can
+// observe the progress of a batch before the reply arrives. Batches cannot be nested.
+
+typedef struct _PHSVC_API_BATCH
+{
+    ULONG NumberOfEntries;
+    volatile ULONG NumberOfCompletedEntries;
+    PHSVC_API_PAYLOAD Entries[1];
+} PHSVC_API_BATCH, *PPHSVC_API_BATCH;
+
 typedef struct _PHSVC_API_MSG
 {
     PORT_MESSAGE h;
@@ -153,4 +153,62 @@ NTSTATUS PhSvcCallQueryProcessHeapInformation(
     _Out_ PPH_STRING* HeapInformation
     );
 
+// Batches are stored in the port section, so they must be destroyed before disconnecting from
+// the server. Entries are numbered in the order they were added.
+
+typedef struct _PHSVC_BATCH *PPHSVC_BATCH;
+
+typedef VOID (NTAPI *PPHSVC_BATCH_COMPLETION_ROUTINE)(
+    _In_ PPHSVC_BATCH Batch,
+    _In_ NTSTATUS Status,
+    _In_opt_ PVOID Context
+    );
+
+PPHSVC_BATCH PhSvcCreateBatch(
+    VOID
+    );
+
+VOID PhSvcDestroyBatch(
+    _In_ _Post_invalid_ PPHSVC_BATCH Batch
+    );
+
+NTSTATUS PhSvcBatchControlProcess(
+    _Inout_ PPHSVC_BATCH Batch,
+    _In_ HANDLE ProcessId,
+    _In_ PHSVC_API_CONTROLPROCESS_COMMAND Command,
+    _In_ ULONG Argument
+    );
+
+NTSTATUS PhSvcBatchControlService(
+    _Inout_ PPHSVC_BATCH Batch,
+    _In_ PWSTR ServiceName,
+    _In_ PHSVC_API_CONTROLSERVICE_COMMAND Command
+    );
+
+NTSTATUS PhSvcBatchControlThread(
+    _Inout_ PPHSVC_BATCH Batch,
+    _In_ HANDLE ThreadId,
+    _In_ PHSVC_API_CONTROLTHREAD_COMMAND Command,
+    _In_ ULONG Argument
+    );
+
+NTSTATUS PhSvcExecuteBatch(
+    _Inout_ PPHSVC_BATCH Batch
+    );
+
+VOID PhSvcQueueBatch(
+    _Inout_ PPHSVC_BATCH Batch,
+    _In_ PPHSVC_BATCH_COMPLETION_ROUTINE CompletionRoutine,
+    _In_opt_ PVOID Context
+    );
+
+ULONG PhSvcGetBatchProgress(
+    _In_ PPHSVC_BATCH Batch
+    );
+
+NTSTATUS PhSvcGetBatchEntryStatus(
+    _In_ PPHSVC_BATCH Batch,
+    _In_ ULONG Index
+    );
+
 #endif
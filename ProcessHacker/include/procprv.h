@@ -3,13 +3,20 @@
 
 #define PH_RECORD_MAX_USAGE
 
+// Each level of the per-CPU history summarizes 4 items of the level below.
+#define PH_CPU_HISTORY_LEVEL_FACTOR 4
+#define PH_CPU_HISTORY_LEVEL_COUNT 4
+
 extern PPH_OBJECT_TYPE PhProcessItemType;
 extern PPH_LIST PhProcessRecordList;
 extern PH_QUEUED_LOCK PhProcessRecordListLock;
 
 extern ULONG PhStatisticsSampleCount;
 extern BOOLEAN PhEnablePurgeProcessRecords;
+extern ULONG PhProcessRecordRetentionTime;
 extern BOOLEAN PhEnableCycleCpuUsage;
+extern PPH_SYSTEM_TRACE PhProcessProviderTrace;
+extern PPH_PROVIDER_REGISTRATION PhProcessProviderEventRegistration;
 
 extern PVOID PhProcessInformation; // only can be used if running on same thread as process provider
 extern ULONG PhProcessInformationSequenceNumber;
@@ -50,6 +57,8 @@ extern PH_CIRCULAR_BUFFER_FLOAT PhCpuUserHistory;
 extern PPH_CIRCULAR_BUFFER_FLOAT PhCpusKernelHistory;
 extern PPH_CIRCULAR_BUFFER_FLOAT PhCpusUserHistory;
 //extern PPH_CIRCULAR_BUFFER_FLOAT PhCpusOtherHistory;
+extern PPH_HISTORY_BUFFER PhCpusKernelHistoryLevels;
+extern PPH_HISTORY_BUFFER PhCpusTotalHistoryLevels; // kernel + user
 
 extern PH_CIRCULAR_BUFFER_ULONG64 PhIoReadHistory;
 extern PH_CIRCULAR_BUFFER_ULONG64 PhIoWriteHistory;
@@ -115,8 +124,9 @@ typedef struct _PH_PROCESS_ITEM
 
     // File
 
-    HICON SmallIcon;
-    HICON LargeIcon;
+    PPH_FILE_ICON FileIcon;
+    HICON SmallIcon; // owned by FileIcon
+    HICON LargeIcon; // owned by FileIcon
     PH_IMAGE_VERSION_INFO VersionInfo;
 
     // Security
@@ -236,6 +246,8 @@ typedef struct _PH_PROCESS_ITEM
 #define PH_PROCESS_RECORD_DEAD 0x1
 // An extra reference has been added to the process record for the statistics system.
 #define PH_PROCESS_RECORD_STAT_REF 0x2
+// An extra reference has been added to the process record to keep it after the process has exited.
+#define PH_PROCESS_RECORD_RETAINED 0x4
 
 typedef struct _PH_PROCESS_RECORD
 {
@@ -254,6 +266,8 @@ typedef struct _PH_PROCESS_RECORD
     PPH_STRING FileName;
     PPH_STRING CommandLine;
     /*PPH_STRING UserName;*/
+
+    PH_RETENTION_ENTRY RetainedEntry; // valid if PH_PROCESS_RECORD_RETAINED is set
 } PH_PROCESS_RECORD, *PPH_PROCESS_RECORD;
 // end_phapppub
 
@@ -344,6 +358,10 @@ VOID PhFlushProcessQueryData(
     VOID
     );
 
+VOID PhPrioritizeProcessQuery(
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    );
+
 VOID PhProcessProviderUpdate(
     _In_ PVOID Object
     );
@@ -414,4 +432,27 @@ PhGetProcessInformationCache(
     VOID
     );
 // end_phapppub
+
+// begin_phapppub
+typedef enum _PH_PROCESS_PROVIDER_EVENT_TYPE
+{
+    ProcessProviderStartedEvent,
+    ProcessProviderExitedEvent
+} PH_PROCESS_PROVIDER_EVENT_TYPE;
+
+PHAPPAPI
+VOID
+NTAPI
+PhQueueProcessProviderEvent(
+    _In_ PH_PROCESS_PROVIDER_EVENT_TYPE Type,
+    _In_ HANDLE ProcessId,
+    _In_ HANDLE ParentProcessId,
+    _In_ ULONG SessionId,
+    _In_opt_ PPH_STRING ImageName
+    );
+// end_phapppub
+
+BOOLEAN PhProcessProviderUpdateEvents(
+    _In_ BOOLEAN Discard
+    );
 #endif
@@ -14,8 +14,9 @@ typedef struct _PH_SERVICE_ITEM
     PPH_STRING DisplayName;
     PPH_STRING FileName; // only available after first update
 
-    HICON SmallIcon;
-    HICON LargeIcon;
+    PPH_FILE_ICON FileIcon;
+    HICON SmallIcon; // owned by FileIcon
+    HICON LargeIcon; // owned by FileIcon
 
     // State
     ULONG Type;
@@ -83,6 +84,11 @@ PhReferenceServiceItem(
     );
 // end_phapppub
 
+VOID PhEnumServiceItems(
+    _Out_ PPH_SERVICE_ITEM **ServiceItems,
+    _Out_ PULONG NumberOfServiceItems
+    );
+
 VOID PhMarkNeedsConfigUpdateServiceItem(
     _In_ PPH_SERVICE_ITEM ServiceItem
     );
@@ -265,6 +265,15 @@ VOID PhSipNotifyCpuGraph(
     _In_ NMHDR *Header
     );
 
+VOID PhSipShowCpusHistoryLevelMenu(
+    VOID
+    );
+
+PPH_STRING PhSipGetCpusHistoryTooltipText(
+    _In_ ULONG Index,
+    _In_ ULONG ItemIndex
+    );
+
 VOID PhSipUpdateCpuGraphs(
     VOID
     );
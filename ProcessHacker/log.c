@@ -25,18 +25,45 @@
 #include <phplug.h>
 #include <settings.h>
 
-PH_CIRCULAR_BUFFER_PVOID PhLogBuffer;
+#define PH_LOG_SEGMENT_SHIFT 20 // 1 MB
+
+PPH_BINARY_LOG PhLogBuffer;
 
 VOID PhLogInitialization(
     VOID
     )
 {
-    ULONG entries;
+    static PH_STRINGREF logFileName = PH_STRINGREF_INIT(L"\\log.bin");
+    NTSTATUS status = STATUS_UNSUCCESSFUL;
+    ULONG segments;
+
+    segments = PhGetIntegerSetting(L"LogSegments");
+    if (segments < 2) segments = 2;
+    if (segments > 0x400) segments = 0x400;
+
+    // Keep the log next to the settings file so that it survives restarts. If there is no
+    // settings file or the log is already in use by another instance, fall back to a log that
+    // only lives as long as this process.
+    if (PhSettingsFileName)
+    {
+        PPH_STRING directory;
+        PPH_STRING fileName;
+
+        if (directory = PhGetBaseDirectory(PhSettingsFileName))
+        {
+            PhCreateDirectory(directory);
+            fileName = PhConcatStringRef2(&directory->sr, &logFileName);
+            status = PhCreateBinaryLog(&PhLogBuffer, fileName->Buffer, PH_LOG_SEGMENT_SHIFT, segments);
+            PhDereferenceObject(fileName);
+            PhDereferenceObject(directory);
+        }
+    }
 
-    entries = PhGetIntegerSetting(L"LogEntries");
-    if (entries > 0x1000) entries = 0x1000;
-    PhInitializeCircularBuffer_PVOID(&PhLogBuffer, entries);
-    memset(PhLogBuffer.Data, 0, sizeof(PVOID) * PhLogBuffer.Size);
+    if (!NT_SUCCESS(status))
+    {
+        if (!NT_SUCCESS(PhCreateBinaryLog(&PhLogBuffer, NULL, PH_LOG_SEGMENT_SHIFT, segments)))
+            PhLogBuffer = NULL;
+    }
 }
 
 PPH_LOG_ENTRY PhpCreateLogEntry(
@@ -54,7 +81,7 @@ PPH_LOG_ENTRY PhpCreateLogEntry(
     return entry;
 }
 
-VOID PhpFreeLogEntry(
+VOID PhFreeLogEntry(
     _In_ _Post_invalid_ PPH_LOG_ENTRY Entry
     )
 {
@@ -140,30 +167,102 @@ VOID PhpLogEntry(
     _In_ PPH_LOG_ENTRY Entry
     )
 {
-    PPH_LOG_ENTRY oldEntry;
+    PH_BINARY_LOG_RECORD record;
+    PPH_STRINGREF strings[PH_BINARY_LOG_STRING_COUNT];
 
-    oldEntry = PhAddItemCircularBuffer2_PVOID(&PhLogBuffer, Entry);
+    memset(&record, 0, sizeof(PH_BINARY_LOG_RECORD));
+    memset(strings, 0, sizeof(strings));
+    record.Type = Entry->Type;
+    record.Flags = Entry->Flags;
+    record.Time = Entry->Time;
+
+    if (Entry->Type >= PH_LOG_ENTRY_PROCESS_FIRST && Entry->Type <= PH_LOG_ENTRY_PROCESS_LAST)
+    {
+        record.Values[0] = HandleToUlong(Entry->Process.ProcessId);
+        record.Values[1] = HandleToUlong(Entry->Process.ParentProcessId);
+        record.Values[2] = Entry->Process.ExitStatus;
+        strings[0] = &Entry->Process.Name->sr;
+        strings[1] = Entry->Process.ParentName ? &Entry->Process.ParentName->sr : NULL;
+    }
+    else if (Entry->Type >= PH_LOG_ENTRY_SERVICE_FIRST && Entry->Type <= PH_LOG_ENTRY_SERVICE_LAST)
+    {
+        strings[0] = &Entry->Service.Name->sr;
+        strings[1] = &Entry->Service.DisplayName->sr;
+    }
+    else if (Entry->Type == PH_LOG_ENTRY_MESSAGE)
+    {
+        strings[0] = &Entry->Message->sr;
+    }
 
-    if (oldEntry)
-        PhpFreeLogEntry(oldEntry);
+    if (PhLogBuffer)
+        PhWriteBinaryLog(PhLogBuffer, &record, strings, NULL);
 
+    // Plugins still receive the entry; it is only valid for the duration of the callback.
     PhInvokeCallback(PhGetGeneralCallback(GeneralCallbackLoggedEvent), Entry);
+    PhFreeLogEntry(Entry);
 }
 
-VOID PhClearLogEntries(
-    VOID
+/**
+ * Reads an entry from the log.
+ *
+ * \param Sequence The sequence number of the entry.
+ *
+ * \return The entry, or NULL if it has been discarded. The entry must be freed using
+ * PhFreeLogEntry().
+ */
+PPH_LOG_ENTRY PhReadLogEntry(
+    _In_ ULONG64 Sequence
     )
 {
+    PH_BINARY_LOG_RECORD record;
+    PPH_STRING strings[PH_BINARY_LOG_STRING_COUNT];
+    PPH_LOG_ENTRY entry;
     ULONG i;
 
-    for (i = 0; i < PhLogBuffer.Size; i++)
+    if (!PhLogBuffer)
+        return NULL;
+    if (!NT_SUCCESS(PhReadBinaryLog(PhLogBuffer, Sequence, &record, strings)))
+        return NULL;
+
+    entry = PhpCreateLogEntry((UCHAR)record.Type);
+    entry->Flags = (USHORT)record.Flags;
+    entry->Time = record.Time;
+
+    if (entry->Type >= PH_LOG_ENTRY_PROCESS_FIRST && entry->Type <= PH_LOG_ENTRY_PROCESS_LAST)
+    {
+        entry->Process.ProcessId = UlongToHandle(record.Values[0]);
+        entry->Process.ParentProcessId = UlongToHandle(record.Values[1]);
+        entry->Process.ExitStatus = record.Values[2];
+        entry->Process.Name = strings[0] ? strings[0] : PhReferenceEmptyString();
+        entry->Process.ParentName = strings[1];
+        strings[0] = NULL;
+        strings[1] = NULL;
+    }
+    else if (entry->Type >= PH_LOG_ENTRY_SERVICE_FIRST && entry->Type <= PH_LOG_ENTRY_SERVICE_LAST)
+    {
+        entry->Service.Name = strings[0] ? strings[0] : PhReferenceEmptyString();
+        entry->Service.DisplayName = strings[1] ? strings[1] : PhReferenceEmptyString();
+        strings[0] = NULL;
+        strings[1] = NULL;
+    }
+    else if (entry->Type == PH_LOG_ENTRY_MESSAGE)
     {
-        if (PhLogBuffer.Data[i])
-            PhpFreeLogEntry(PhLogBuffer.Data[i]);
+        entry->Message = strings[0] ? strings[0] : PhReferenceEmptyString();
+        strings[0] = NULL;
     }
 
-    PhClearCircularBuffer_PVOID(&PhLogBuffer);
-    memset(PhLogBuffer.Data, 0, sizeof(PVOID) * PhLogBuffer.Size);
+    for (i = 0; i < PH_BINARY_LOG_STRING_COUNT; i++)
+        PhClearReference(&strings[i]);
+
+    return entry;
+}
+
+VOID PhClearLogEntries(
+    VOID
+    )
+{
+    if (PhLogBuffer)
+        PhClearBinaryLog(PhLogBuffer);
 }
 
 VOID PhLogProcessEntry(
@@ -40,6 +40,9 @@ static PH_LAYOUT_MANAGER WindowLayoutManager;
 static RECT MinimumSize;
 static HWND ListViewHandle;
 static ULONG ListViewCount;
+static ULONG64 ListViewFirstSequence;
+static ULONG64 CachedSequence = MAXULONG64;
+static PPH_LOG_ENTRY CachedEntry;
 static PH_CALLBACK_REGISTRATION LoggedRegistration;
 
 VOID PhShowLogDialog(
@@ -72,11 +75,64 @@ static VOID NTAPI LoggedCallback(
     PostMessage(PhLogWindowHandle, WM_PH_LOG_UPDATED, 0, 0);
 }
 
+static VOID PhpClearCachedLogEntry(
+    VOID
+    )
+{
+    if (CachedEntry)
+    {
+        PhFreeLogEntry(CachedEntry);
+        CachedEntry = NULL;
+    }
+
+    CachedSequence = MAXULONG64;
+}
+
+static PPH_LOG_ENTRY PhpGetLogEntryForItem(
+    _In_ ULONG Index
+    )
+{
+    ULONG64 sequence;
+
+    // The list view is virtual, so entries are read from the log on demand. Both columns of a
+    // row are requested one after the other, so keep the last entry around.
+
+    sequence = ListViewFirstSequence + Index;
+
+    if (sequence != CachedSequence)
+    {
+        PhpClearCachedLogEntry();
+
+        // Don't remember failures; the entry may not have been committed yet.
+        if (CachedEntry = PhReadLogEntry(sequence))
+            CachedSequence = sequence;
+    }
+
+    return CachedEntry;
+}
+
 static VOID PhpUpdateLogList(
     VOID
     )
 {
-    ListViewCount = PhLogBuffer.Count;
+    ULONG64 firstSequence = 0;
+    ULONG64 nextSequence = 0;
+
+    if (PhLogBuffer)
+        PhQueryBinaryLogRange(PhLogBuffer, &firstSequence, &nextSequence);
+
+    // Items are numbered from the oldest entry in the log.
+    if (nextSequence - firstSequence > MAXLONG)
+        firstSequence = nextSequence - MAXLONG;
+
+    if (firstSequence != ListViewFirstSequence)
+    {
+        ListViewFirstSequence = firstSequence;
+        PhpClearCachedLogEntry();
+        InvalidateRect(ListViewHandle, NULL, FALSE);
+    }
+
+    ListViewCount = (ULONG)(nextSequence - firstSequence);
     ListView_SetItemCountEx(ListViewHandle, ListViewCount, LVSICF_NOSCROLL);
 
     if (ListViewCount >= 2 && Button_GetCheck(GetDlgItem(PhLogWindowHandle, IDC_AUTOSCROLL)) == BST_CHECKED)
@@ -88,6 +144,33 @@ static VOID PhpUpdateLogList(
     }
 }
 
+static VOID PhpAppendStringForLogEntry(
+    _Inout_ PPH_STRING_BUILDER StringBuilder,
+    _In_ ULONG Index
+    )
+{
+    PPH_LOG_ENTRY entry;
+    SYSTEMTIME systemTime;
+    PPH_STRING temp;
+
+    // Entries that have been discarded since the list was last updated are skipped.
+    if (!(entry = PhReadLogEntry(ListViewFirstSequence + Index)))
+        return;
+
+    PhLargeIntegerToLocalSystemTime(&systemTime, &entry->Time);
+    temp = PhFormatDateTime(&systemTime);
+    PhAppendStringBuilder(StringBuilder, &temp->sr);
+    PhDereferenceObject(temp);
+    PhAppendStringBuilder2(StringBuilder, L": ");
+
+    temp = PhFormatLogEntry(entry);
+    PhAppendStringBuilder(StringBuilder, &temp->sr);
+    PhDereferenceObject(temp);
+    PhAppendStringBuilder2(StringBuilder, L"\r\n");
+
+    PhFreeLogEntry(entry);
+}
+
 static PPH_STRING PhpGetStringForSelectedLogEntries(
     _In_ BOOLEAN All
     )
@@ -100,45 +183,23 @@ static PPH_STRING PhpGetStringForSelectedLogEntries(
 
     PhInitializeStringBuilder(&stringBuilder, 0x100);
 
-    i = ListViewCount - 1;
-
-    while (TRUE)
+    if (All)
+    {
+        for (i = 0; i < ListViewCount; i++)
+            PhpAppendStringForLogEntry(&stringBuilder, i);
+    }
+    else
     {
-        PPH_LOG_ENTRY entry;
-        SYSTEMTIME systemTime;
-        PPH_STRING temp;
+        INT index = -1;
 
-        if (!All)
+        // The list can hold millions of entries, so only visit the selected ones.
+        while ((index = PhFindListViewItemByFlags(ListViewHandle, index, LVNI_SELECTED)) != -1)
         {
-            // The list view displays the items in reverse order...
-            if (!(ListView_GetItemState(ListViewHandle, ListViewCount - i - 1, LVIS_SELECTED) & LVIS_SELECTED))
-            {
-                goto ContinueLoop;
-            }
-        }
-
-        entry = PhGetItemCircularBuffer_PVOID(&PhLogBuffer, i);
-
-        if (!entry)
-            goto ContinueLoop;
-
-        PhLargeIntegerToLocalSystemTime(&systemTime, &entry->Time);
-        temp = PhFormatDateTime(&systemTime);
-        PhAppendStringBuilder(&stringBuilder, &temp->sr);
-        PhDereferenceObject(temp);
-        PhAppendStringBuilder2(&stringBuilder, L": ");
-
-        temp = PhFormatLogEntry(entry);
-        PhAppendStringBuilder(&stringBuilder, &temp->sr);
-        PhDereferenceObject(temp);
-        PhAppendStringBuilder2(&stringBuilder, L"\r\n");
-
-ContinueLoop:
-
-        if (i == 0)
-            break;
+            if ((ULONG)index >= ListViewCount)
+                break;
 
-        i--;
+            PhpAppendStringForLogEntry(&stringBuilder, index);
+        }
     }
 
     return PhFinalStringBuilderString(&stringBuilder);
@@ -200,6 +261,7 @@ INT_PTR CALLBACK PhpLogDlgProc(
             PhDeleteLayoutManager(&WindowLayoutManager);
 
             PhUnregisterCallback(PhGetGeneralCallback(GeneralCallbackLoggedEvent), &LoggedRegistration);
+            PhpClearCachedLogEntry();
             PhUnregisterDialog(PhLogWindowHandle);
             PhLogWindowHandle = NULL;
         }
@@ -305,7 +367,12 @@ INT_PTR CALLBACK PhpLogDlgProc(
                     NMLVDISPINFO *dispInfo = (NMLVDISPINFO *)header;
                     PPH_LOG_ENTRY entry;
 
-                    entry = PhGetItemCircularBuffer_PVOID(&PhLogBuffer, ListViewCount - dispInfo->item.iItem - 1);
+                    if (!(entry = PhpGetLogEntryForItem(dispInfo->item.iItem)))
+                    {
+                        if ((dispInfo->item.mask & LVIF_TEXT) && dispInfo->item.cchTextMax != 0)
+                            dispInfo->item.pszText[0] = UNICODE_NULL;
+                        break;
+                    }
 
                     if (dispInfo->item.iSubItem == 0)
                     {
@@ -62,6 +62,10 @@ VOID PhpInitializeSettings(
     VOID
     );
 
+VOID PhpInitializeSystemTrace(
+    VOID
+    );
+
 VOID PhpProcessStartupParameters(
     VOID
     );
@@ -88,6 +92,7 @@ BOOLEAN PhInitializeMitigationPolicy(
 
 BOOLEAN PhPluginsEnabled = FALSE;
 PPH_STRING PhSettingsFileName = NULL;
+PPH_STRING PhSettingsStoreFileName = NULL;
 PH_STARTUP_PARAMETERS PhStartupParameters;
 
 PH_PROVIDER_THREAD PhPrimaryProviderThread;
@@ -142,6 +147,15 @@ INT WINAPI wWinMain(
 
     PhSettingsInitialization();
     PhpInitializeSettings();
+    PhpInitializeSystemTrace();
+
+    if (PhStartupParameters.ExportTypes)
+    {
+        if (!PhInitializeAppSystem())
+            RtlExitUserProcess(STATUS_UNSUCCESSFUL);
+
+        RtlExitUserProcess(PhExportModeStart());
+    }
 
     if (PhGetIntegerSetting(L"AllowOnlyOneInstance") &&
         !PhStartupParameters.NewInstance &&
@@ -1104,6 +1118,21 @@ BOOLEAN PhInitializeAppSystem(
     return TRUE;
 }
 
+static BOOLEAN PhpIsSettingsStoreCurrent(
+    VOID
+    )
+{
+    FILE_NETWORK_OPEN_INFORMATION storeInformation;
+    FILE_NETWORK_OPEN_INFORMATION fileInformation;
+
+    if (!NT_SUCCESS(PhQueryFullAttributesFileWin32(PhSettingsStoreFileName->Buffer, &storeInformation)))
+        return FALSE;
+    if (!NT_SUCCESS(PhQueryFullAttributesFileWin32(PhSettingsFileName->Buffer, &fileInformation)))
+        return TRUE;
+
+    return storeInformation.LastWriteTime.QuadPart >= fileInformation.LastWriteTime.QuadPart;
+}
+
 VOID PhpInitializeSettings(
     VOID
     )
@@ -1159,7 +1188,27 @@ VOID PhpInitializeSettings(
 
         if (PhSettingsFileName)
         {
-            status = PhLoadSettings(PhSettingsFileName->Buffer);
+            static PH_STRINGREF xmlSuffix = PH_STRINGREF_INIT(L".xml");
+            static PH_STRINGREF storeSuffix = PH_STRINGREF_INIT(L".bin");
+            PH_STRINGREF baseName;
+
+            // Settings are saved to a binary store next to the XML file (settings.xml ->
+            // settings.bin). The XML file is only read if it is newer than the store, i.e. on the
+            // first run after upgrading, or if it was edited by hand or by an older version.
+
+            baseName = PhSettingsFileName->sr;
+
+            if (PhEndsWithStringRef(&baseName, &xmlSuffix, TRUE))
+                baseName.Length -= xmlSuffix.Length;
+
+            PhSettingsStoreFileName = PhConcatStringRef2(&baseName, &storeSuffix);
+
+            status = STATUS_NOT_FOUND;
+
+            if (PhpIsSettingsStoreCurrent())
+                status = PhLoadSettings(PhSettingsStoreFileName->Buffer);
+            if (!NT_SUCCESS(status))
+                status = PhLoadSettings(PhSettingsFileName->Buffer);
 
             // If we didn't find the file, it will be created. Otherwise,
             // there was probably a parsing error and we don't want to
@@ -1200,6 +1249,7 @@ VOID PhpInitializeSettings(
                     // don't happen.
                     PhDereferenceObject(PhSettingsFileName);
                     PhSettingsFileName = NULL;
+                    PhClearReference(&PhSettingsStoreFileName);
                 }
             }
         }
@@ -1222,6 +1272,41 @@ VOID PhpInitializeSettings(
     }
 }
 
+VOID PhpInitializeSystemTrace(
+    VOID
+    )
+{
+    NTSTATUS status;
+    PPH_STRING fileName;
+    ULONG flags;
+
+    if (PhStartupParameters.ReplayTraceFileName)
+    {
+        fileName = PhStartupParameters.ReplayTraceFileName;
+        flags = PH_SYSTEM_TRACE_REPLAY;
+    }
+    else if (PhStartupParameters.RecordTraceFileName)
+    {
+        fileName = PhStartupParameters.RecordTraceFileName;
+        flags = 0;
+    }
+    else
+    {
+        return;
+    }
+
+    // The trace stays open until the program exits. Each tick is flushed as it is recorded.
+    status = PhCreateSystemTrace(&PhProcessProviderTrace, fileName->Buffer, flags);
+
+    if (!NT_SUCCESS(status))
+    {
+        if (!PhStartupParameters.Silent)
+            PhShowStatus(NULL, L"Unable to open the trace file", status, 0);
+
+        RtlExitUserProcess(status);
+    }
+}
+
 #define PH_ARG_SETTINGS 1
 #define PH_ARG_NOSETTINGS 2
 #define PH_ARG_SHOWVISIBLE 3
@@ -1250,6 +1335,14 @@ VOID PhpInitializeSettings(
 #define PH_ARG_PLUGIN 26
 #define PH_ARG_SELECTTAB 27
 #define PH_ARG_SYSINFO 28
+#define PH_ARG_EXPORT 29
+#define PH_ARG_EXPORTFILE 30
+#define PH_ARG_EXPORTFORMAT 31
+#define PH_ARG_EXPORTINTERVAL 32
+#define PH_ARG_EXPORTCOUNT 33
+#define PH_ARG_EXPORTPID 34
+#define PH_ARG_RECORDTRACE 35
+#define PH_ARG_REPLAYTRACE 36
 
 BOOLEAN NTAPI PhpCommandLineOptionCallback(
     _In_opt_ PPH_COMMAND_LINE_OPTION Option,
@@ -1374,6 +1467,33 @@ BOOLEAN NTAPI PhpCommandLineOptionCallback(
         case PH_ARG_SYSINFO:
             PhSwapReference(&PhStartupParameters.SysInfo, Value ? Value : PhReferenceEmptyString());
             break;
+        case PH_ARG_EXPORT:
+            PhSwapReference(&PhStartupParameters.ExportTypes, Value);
+            break;
+        case PH_ARG_EXPORTFILE:
+            PhSwapReference(&PhStartupParameters.ExportFileName, Value);
+            break;
+        case PH_ARG_EXPORTFORMAT:
+            PhSwapReference(&PhStartupParameters.ExportFormat, Value);
+            break;
+        case PH_ARG_EXPORTINTERVAL:
+            if (Value && PhStringToInteger64(&Value->sr, 10, &integer))
+                PhStartupParameters.ExportInterval = (ULONG)integer;
+            break;
+        case PH_ARG_EXPORTCOUNT:
+            if (Value && PhStringToInteger64(&Value->sr, 10, &integer))
+                PhStartupParameters.ExportCount = (ULONG)integer;
+            break;
+        case PH_ARG_EXPORTPID:
+            if (Value && PhStringToInteger64(&Value->sr, 0, &integer))
+                PhStartupParameters.ExportProcessId = (ULONG)integer;
+            break;
+        case PH_ARG_RECORDTRACE:
+            PhSwapReference(&PhStartupParameters.RecordTraceFileName, Value);
+            break;
+        case PH_ARG_REPLAYTRACE:
+            PhSwapReference(&PhStartupParameters.ReplayTraceFileName, Value);
+            break;
         }
     }
     else
@@ -1432,7 +1552,15 @@ VOID PhpProcessStartupParameters(
         { PH_ARG_PRIORITY, L"priority", MandatoryArgumentType },
         { PH_ARG_PLUGIN, L"plugin", MandatoryArgumentType },
         { PH_ARG_SELECTTAB, L"selecttab", MandatoryArgumentType },
-        { PH_ARG_SYSINFO, L"sysinfo", OptionalArgumentType }
+        { PH_ARG_SYSINFO, L"sysinfo", OptionalArgumentType },
+        { PH_ARG_EXPORT, L"export", MandatoryArgumentType },
+        { PH_ARG_EXPORTFILE, L"exportfile", MandatoryArgumentType },
+        { PH_ARG_EXPORTFORMAT, L"exportformat", MandatoryArgumentType },
+        { PH_ARG_EXPORTINTERVAL, L"exportinterval", MandatoryArgumentType },
+        { PH_ARG_EXPORTCOUNT, L"exportcount", MandatoryArgumentType },
+        { PH_ARG_EXPORTPID, L"exportpid", MandatoryArgumentType },
+        { PH_ARG_RECORDTRACE, L"recordtrace", MandatoryArgumentType },
+        { PH_ARG_REPLAYTRACE, L"replaytrace", MandatoryArgumentType }
     };
     PH_STRINGREF commandLine;
 
@@ -1459,6 +1587,12 @@ VOID PhpProcessStartupParameters(
             L"-cvalue command-value\n"
             L"-debug\n"
             L"-elevate\n"
+            L"-export processes|threads|services|network|handles|modules[,...]\n"
+            L"-exportcount number-of-samples\n"
+            L"-exportfile filename\n"
+            L"-exportformat csv|jsonl|snapshot\n"
+            L"-exportinterval milliseconds\n"
+            L"-exportpid pid-for-handles-and-modules\n"
             L"-help\n"
             L"-hide\n"
             L"-installkph\n"
@@ -1468,6 +1602,8 @@ VOID PhpProcessStartupParameters(
             L"-nosettings\n"
             L"-plugin pluginname:value\n"
             L"-priority r|h|n|l\n"
+            L"-recordtrace filename\n"
+            L"-replaytrace filename\n"
             L"-s\n"
             L"-selectpid pid-to-select\n"
             L"-selecttab name-of-tab-to-select\n"
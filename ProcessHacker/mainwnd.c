@@ -58,6 +58,7 @@ BOOLEAN PhMainWndEarlyExit = FALSE;
 PH_PROVIDER_REGISTRATION PhMwpProcessProviderRegistration;
 PH_PROVIDER_REGISTRATION PhMwpServiceProviderRegistration;
 PH_PROVIDER_REGISTRATION PhMwpNetworkProviderRegistration;
+PH_PROVIDER_REGISTRATION PhMwpProcessEventProviderRegistration;
 BOOLEAN PhMwpUpdateAutomatically = TRUE;
 
 ULONG PhMwpNotifyIconNotifyMask = 0;
@@ -395,10 +396,23 @@ VOID PhMwpInitializeProviders(
     PhRegisterProvider(&PhPrimaryProviderThread, PhProcessProviderUpdate, NULL, &PhMwpProcessProviderRegistration);
     PhRegisterProvider(&PhPrimaryProviderThread, PhServiceProviderUpdate, NULL, &PhMwpServiceProviderRegistration);
     PhRegisterProvider(&PhPrimaryProviderThread, PhNetworkProviderUpdate, NULL, &PhMwpNetworkProviderRegistration);
+    PhRegisterProvider(&PhPrimaryProviderThread, PhMwpProcessEventProviderUpdate, NULL, &PhMwpProcessEventProviderRegistration);
+
+    // The tray icons and notifications need the process provider even when the window is hidden.
+    // The service provider only does a little work unless services change, and the network
+    // provider reports the runs where connections change.
+    PhSetScheduleProvider(&PhMwpServiceProviderRegistration, 0, PH_PROVIDER_BACKOFF_BACKGROUND);
+    PhSetScheduleProvider(&PhMwpNetworkProviderRegistration, 0, PH_PROVIDER_BACKOFF_UNCHANGED | PH_PROVIDER_BACKOFF_BACKGROUND);
 
     PhSetEnabledProvider(&PhMwpProcessProviderRegistration, TRUE);
     PhSetEnabledProvider(&PhMwpServiceProviderRegistration, TRUE);
 
+    // The process event provider is never enabled. It only runs when process events are queued,
+    // which boosts it. The process provider keeps the thread interval even when events arrive: the
+    // counters, rate columns, history samples and tray icons all come from its full update and
+    // assume one full update per interval.
+    PhProcessProviderEventRegistration = &PhMwpProcessEventProviderRegistration;
+
     PhStartProviderThread(&PhPrimaryProviderThread);
     PhStartProviderThread(&PhSecondaryProviderThread);
 }
@@ -1595,6 +1609,8 @@ VOID PhMwpOnShowWindow(
         ShowWindow(WindowHandle, SW_MAXIMIZE);
         NeedsMaximize = FALSE;
     }
+
+    PhSetBackgroundProviderThread(&PhPrimaryProviderThread, !Showing || IsMinimized(WindowHandle));
 }
 
 BOOLEAN PhMwpOnSysCommand(
@@ -1732,6 +1748,8 @@ VOID PhMwpOnSize(
         PhMwpLayout(&deferHandle);
         EndDeferWindowPos(deferHandle);
     }
+
+    PhSetBackgroundProviderThread(&PhPrimaryProviderThread, IsMinimized(WindowHandle) || !IsWindowVisible(WindowHandle));
 }
 
 VOID PhMwpOnSizing(
@@ -2010,6 +2028,7 @@ VOID PhMwpLoadSettings(
     opacity = PhGetIntegerSetting(L"MainWindowOpacity");
     PhStatisticsSampleCount = PhGetIntegerSetting(L"SampleCount");
     PhEnablePurgeProcessRecords = !PhGetIntegerSetting(L"NoPurgeProcessRecords");
+    PhProcessRecordRetentionTime = PhGetIntegerSetting(L"ProcessRecordRetentionTime");
     PhEnableCycleCpuUsage = !!PhGetIntegerSetting(L"EnableCycleCpuUsage");
     PhEnableServiceNonPoll = !!PhGetIntegerSetting(L"EnableServiceNonPoll");
     PhEnableNetworkProviderResolve = !!PhGetIntegerSetting(L"EnableNetworkResolve");
@@ -2050,8 +2069,8 @@ VOID PhMwpSaveSettings(
     PhSaveWindowPlacementToSetting(L"MainWindowPosition", L"MainWindowSize", WindowHandle);
     PhMwpSaveWindowState(WindowHandle);
 
-    if (PhSettingsFileName)
-        PhSaveSettings(PhSettingsFileName->Buffer);
+    if (PhSettingsStoreFileName)
+        PhSaveSettingsBinary(PhSettingsStoreFileName->Buffer);
 }
 
 VOID PhMwpSaveWindowState(
@@ -353,6 +353,7 @@ VOID NTAPI PhMwpNetworkItemAddedHandler(
 
     PhReferenceObject(networkItem);
     PhPushProviderEventQueue(&PhMwpNetworkEventQueue, ProviderAddedEvent, Parameter, PhGetRunIdProvider(&PhMwpNetworkProviderRegistration));
+    PhSetChangedProvider(&PhMwpNetworkProviderRegistration);
 }
 
 VOID NTAPI PhMwpNetworkItemModifiedHandler(
@@ -363,6 +364,7 @@ VOID NTAPI PhMwpNetworkItemModifiedHandler(
     PPH_NETWORK_ITEM networkItem = (PPH_NETWORK_ITEM)Parameter;
 
     PhPushProviderEventQueue(&PhMwpNetworkEventQueue, ProviderModifiedEvent, Parameter, PhGetRunIdProvider(&PhMwpNetworkProviderRegistration));
+    PhSetChangedProvider(&PhMwpNetworkProviderRegistration);
 }
 
 VOID NTAPI PhMwpNetworkItemRemovedHandler(
@@ -373,6 +375,7 @@ VOID NTAPI PhMwpNetworkItemRemovedHandler(
     PPH_NETWORK_ITEM networkItem = (PPH_NETWORK_ITEM)Parameter;
 
     PhPushProviderEventQueue(&PhMwpNetworkEventQueue, ProviderRemovedEvent, Parameter, PhGetRunIdProvider(&PhMwpNetworkProviderRegistration));
+    PhSetChangedProvider(&PhMwpNetworkProviderRegistration);
 }
 
 VOID NTAPI PhMwpNetworkItemsUpdatedHandler(
@@ -860,6 +860,16 @@ VOID NTAPI PhMwpProcessesUpdatedHandler(
     ProcessHacker_Invoke(PhMainWndHandle, PhMwpOnProcessesUpdated, PhGetRunIdProvider(&PhMwpProcessProviderRegistration));
 }
 
+VOID NTAPI PhMwpProcessEventProviderUpdate(
+    _In_ PVOID Object
+    )
+{
+    // Process events are discarded while automatic updates are paused. The next update finds the
+    // processes anyway.
+    if (PhProcessProviderUpdateEvents(!PhGetEnabledProvider(&PhMwpProcessProviderRegistration)))
+        ProcessHacker_Invoke(PhMainWndHandle, PhMwpOnProcessEventsUpdated, PhGetRunIdProvider(&PhMwpProcessProviderRegistration));
+}
+
 VOID PhMwpOnProcessAdded(
     _In_ _Assume_refs_(1) PPH_PROCESS_ITEM ProcessItem,
     _In_ ULONG RunId
@@ -1010,7 +1020,7 @@ VOID PhMwpOnProcessRemoved(
         ProcessToScrollTo = NULL;
 }
 
-VOID PhMwpOnProcessesUpdated(
+ULONG PhMwpFlushProcessEvents(
     _In_ ULONG RunId
     )
 {
@@ -1046,6 +1056,17 @@ VOID PhMwpOnProcessesUpdated(
         PhFree(events);
     }
 
+    return count;
+}
+
+VOID PhMwpOnProcessesUpdated(
+    _In_ ULONG RunId
+    )
+{
+    ULONG count;
+
+    count = PhMwpFlushProcessEvents(RunId);
+
     // The modified notification is only sent for special cases.
     // We have to invalidate the text on each update.
     PhTickProcessNodes();
@@ -1075,3 +1096,19 @@ VOID PhMwpOnProcessesUpdated(
         ProcessToScrollTo = NULL;
     }
 }
+
+VOID PhMwpOnProcessEventsUpdated(
+    _In_ ULONG RunId
+    )
+{
+    // Only the processes added or removed by process events are shown here. The nodes are ticked
+    // and the plugins are notified after the next full update.
+    if (PhMwpFlushProcessEvents(RunId) != 0)
+        TreeNew_SetRedraw(PhMwpProcessTreeNewHandle, TRUE);
+
+    if (ProcessToScrollTo)
+    {
+        TreeNew_EnsureVisible(PhMwpProcessTreeNewHandle, &ProcessToScrollTo->Node);
+        ProcessToScrollTo = NULL;
+    }
+}
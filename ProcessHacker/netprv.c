@@ -232,6 +232,36 @@ PPH_NETWORK_ITEM PhReferenceNetworkItem(
     return networkItem;
 }
 
+VOID PhEnumNetworkItems(
+    _Out_ PPH_NETWORK_ITEM **NetworkItems,
+    _Out_ PULONG NumberOfNetworkItems
+    )
+{
+    PPH_NETWORK_ITEM *networkItems;
+    ULONG numberOfNetworkItems;
+    ULONG count = 0;
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PPH_NETWORK_ITEM *networkItem;
+
+    PhAcquireQueuedLockShared(&PhNetworkHashtableLock);
+
+    numberOfNetworkItems = PhNetworkHashtable->Count;
+    networkItems = PhAllocate(sizeof(PPH_NETWORK_ITEM) * numberOfNetworkItems);
+
+    PhBeginEnumHashtable(PhNetworkHashtable, &enumContext);
+
+    while (networkItem = PhNextEnumHashtable(&enumContext))
+    {
+        PhReferenceObject(*networkItem);
+        networkItems[count++] = *networkItem;
+    }
+
+    PhReleaseQueuedLockShared(&PhNetworkHashtableLock);
+
+    *NetworkItems = networkItems;
+    *NumberOfNetworkItems = numberOfNetworkItems;
+}
+
 VOID PhpRemoveNetworkItem(
     _In_ PPH_NETWORK_ITEM NetworkItem
     )
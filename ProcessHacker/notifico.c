@@ -54,6 +54,7 @@ static PH_NF_MSG_SHOWMINIINFOSECTION_DATA IconClickShowMiniInfoSectionData;
 static BOOLEAN IconClickUpDueToDown = FALSE;
 static BOOLEAN IconDisableHover = FALSE;
 static HANDLE PhpTrayIconEventHandle = NULL;
+static PPH_SETTING_HANDLE IconSingleClickSetting = NULL;
 
 VOID PhNfLoadStage1(
     VOID
@@ -219,6 +220,7 @@ VOID PhNfLoadStage2(
     )
 {
     PhNfMiniInfoEnabled = !!PhGetIntegerSetting(L"MiniInfoWindowEnabled");
+    IconSingleClickSetting = PhGetSettingHandle(L"IconSingleClick");
     PhNfLoadGuids();
 
     PhNfRegisterIcon(NULL, PH_TRAY_ICON_ID_CPU_USAGE, PhNfpTrayIconItemGuids[PH_TRAY_ICON_GUID_CPU_USAGE], NULL, L"CPU &usage", 0, PhNfpCpuUsageIconUpdateCallback, NULL);
@@ -332,7 +334,7 @@ VOID PhNfForwardMessage(
     {
     case WM_LBUTTONDOWN:
         {
-            if (PhGetIntegerSetting(L"IconSingleClick"))
+            if (PhGetIntegerSettingByHandle(IconSingleClickSetting))
             {
                 ProcessHacker_IconClick(WindowHandle);
                 PhNfpDisableHover();
@@ -345,7 +347,7 @@ VOID PhNfForwardMessage(
         break;
     case WM_LBUTTONUP:
         {
-            if (!PhGetIntegerSetting(L"IconSingleClick") && PhNfMiniInfoEnabled && IconClickUpDueToDown)
+            if (!PhGetIntegerSettingByHandle(IconSingleClickSetting) && PhNfMiniInfoEnabled && IconClickUpDueToDown)
             {
                 PH_NF_MSG_SHOWMINIINFOSECTION_DATA showMiniInfoSectionData;
 
@@ -375,7 +377,7 @@ VOID PhNfForwardMessage(
         break;
     case WM_LBUTTONDBLCLK:
         {
-            if (!PhGetIntegerSetting(L"IconSingleClick"))
+            if (!PhGetIntegerSettingByHandle(IconSingleClickSetting))
             {
                 if (PhNfMiniInfoEnabled)
                 {
@@ -395,7 +397,7 @@ VOID PhNfForwardMessage(
         {
             POINT location;
 
-            if (!PhGetIntegerSetting(L"IconSingleClick") && PhNfMiniInfoEnabled)
+            if (!PhGetIntegerSettingByHandle(IconSingleClickSetting) && PhNfMiniInfoEnabled)
                 KillTimer(WindowHandle, TIMER_ICON_CLICK_ACTIVATE);
 
             PhPinMiniInformation(MiniInfoIconPinType, -1, 0, 0, NULL, NULL);
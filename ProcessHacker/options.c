@@ -286,6 +286,7 @@ INT_PTR CALLBACK PhOptionsDialogProc(
             PhAddLayoutItem(&WindowLayoutManager, ContainerControl, NULL, PH_ANCHOR_LEFT | PH_ANCHOR_TOP | PH_ANCHOR_RIGHT | PH_ANCHOR_BOTTOM);
             PhAddLayoutItem(&WindowLayoutManager, GetDlgItem(hwndDlg, IDC_RESET), NULL, PH_ANCHOR_LEFT | PH_ANCHOR_BOTTOM);
             PhAddLayoutItem(&WindowLayoutManager, GetDlgItem(hwndDlg, IDC_CLEANUP), NULL, PH_ANCHOR_LEFT | PH_ANCHOR_BOTTOM);
+            PhAddLayoutItem(&WindowLayoutManager, GetDlgItem(hwndDlg, IDC_EXPORT), NULL, PH_ANCHOR_LEFT | PH_ANCHOR_BOTTOM);
             //PhAddLayoutItem(&WindowLayoutManager, GetDlgItem(hwndDlg, IDC_APPLY), NULL, PH_ANCHOR_RIGHT | PH_ANCHOR_BOTTOM);
             PhAddLayoutItem(&WindowLayoutManager, GetDlgItem(hwndDlg, IDOK), NULL, PH_ANCHOR_RIGHT | PH_ANCHOR_BOTTOM);
 
@@ -382,8 +383,8 @@ INT_PTR CALLBACK PhOptionsDialogProc(
 
                         PhResetSettings();
 
-                        if (PhSettingsFileName)
-                            PhSaveSettings(PhSettingsFileName->Buffer);
+                        if (PhSettingsStoreFileName)
+                            PhSaveSettingsBinary(PhSettingsStoreFileName->Buffer);
 
                         PhShellProcessHacker(
                             PhMainWndHandle,
@@ -412,6 +413,37 @@ INT_PTR CALLBACK PhOptionsDialogProc(
                     }
                 }
                 break;
+            case IDC_EXPORT:
+                {
+                    static PH_FILETYPE_FILTER filters[] =
+                    {
+                        { L"XML files (*.xml)", L"*.xml" },
+                        { L"All files (*.*)", L"*.*" }
+                    };
+                    PVOID fileDialog;
+
+                    // Settings are saved to the binary store, so this is the only way to get a
+                    // readable copy of them. The XML file can be loaded with -settings.
+                    fileDialog = PhCreateSaveFileDialog();
+
+                    PhSetFileDialogFilter(fileDialog, filters, sizeof(filters) / sizeof(PH_FILETYPE_FILTER));
+                    PhSetFileDialogFileName(fileDialog, L"settings.xml");
+
+                    if (PhShowFileDialog(hwndDlg, fileDialog))
+                    {
+                        NTSTATUS status;
+                        PPH_STRING fileName;
+
+                        fileName = PH_AUTO(PhGetFileDialogFileName(fileDialog));
+                        ProcessHacker_SaveAllSettings(PhMainWndHandle);
+
+                        if (!NT_SUCCESS(status = PhSaveSettings(fileName->Buffer)))
+                            PhShowStatus(hwndDlg, L"Unable to export the settings", status, 0);
+                    }
+
+                    PhFreeFileDialog(fileDialog);
+                }
+                break;
             }
         }
         break;
@@ -950,8 +982,8 @@ VOID PhpSetDefaultTaskManager(
         if (!NT_SUCCESS(status))
             PhShowStatus(ParentWindowHandle, L"Unable to replace Task Manager", status, 0);
 
-        if (PhSettingsFileName)
-            PhSaveSettings(PhSettingsFileName->Buffer);
+        if (PhSettingsStoreFileName)
+            PhSaveSettingsBinary(PhSettingsStoreFileName->Buffer);
     }
 }
 
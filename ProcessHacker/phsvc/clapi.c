@@ -1261,3 +1261,252 @@ NTSTATUS PhSvcCallQueryProcessHeapInformation(
 
     return status;
 }
+
+typedef struct _PHSVC_BATCH
+{
+    PPHSVC_API_BATCH Buffer;
+    ULONG BufferOffset;
+    ULONG AllocatedEntries;
+    PPH_LIST Strings;
+    NTSTATUS Status;
+
+    PPHSVC_BATCH_COMPLETION_ROUTINE CompletionRoutine;
+    PVOID Context;
+} PHSVC_BATCH;
+
+PPHSVC_BATCH PhSvcCreateBatch(
+    VOID
+    )
+{
+    PPHSVC_BATCH batch;
+
+    batch = PhAllocateZero(sizeof(PHSVC_BATCH));
+    batch->Strings = PhCreateList(4);
+    batch->Status = STATUS_PENDING;
+
+    return batch;
+}
+
+VOID PhSvcDestroyBatch(
+    _In_ _Post_invalid_ PPHSVC_BATCH Batch
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < Batch->Strings->Count; i++)
+        PhSvcpFreeHeap(Batch->Strings->Items[i]);
+
+    if (Batch->Buffer)
+        PhSvcpFreeHeap(Batch->Buffer);
+
+    PhDereferenceObject(Batch->Strings);
+    PhFree(Batch);
+}
+
+static PPHSVC_API_PAYLOAD PhSvcpAddBatchEntry(
+    _Inout_ PPHSVC_BATCH Batch,
+    _In_ PHSVC_API_NUMBER ApiNumber
+    )
+{
+    PPHSVC_API_PAYLOAD entry;
+    ULONG numberOfEntries;
+
+    numberOfEntries = Batch->Buffer ? Batch->Buffer->NumberOfEntries : 0;
+
+    if (numberOfEntries == Batch->AllocatedEntries)
+    {
+        PPHSVC_API_BATCH newBuffer;
+        ULONG newOffset;
+        ULONG newAllocatedEntries;
+
+        newAllocatedEntries = Batch->AllocatedEntries ? Batch->AllocatedEntries * 2 : 16;
+        newBuffer = PhSvcpAllocateHeap(
+            FIELD_OFFSET(PHSVC_API_BATCH, Entries) + newAllocatedEntries * sizeof(PHSVC_API_PAYLOAD),
+            &newOffset
+            );
+
+        if (!newBuffer)
+            return NULL;
+
+        if (Batch->Buffer)
+        {
+            memcpy(newBuffer, Batch->Buffer, FIELD_OFFSET(PHSVC_API_BATCH, Entries) + numberOfEntries * sizeof(PHSVC_API_PAYLOAD));
+            PhSvcpFreeHeap(Batch->Buffer);
+        }
+        else
+        {
+            newBuffer->NumberOfEntries = 0;
+            newBuffer->NumberOfCompletedEntries = 0;
+        }
+
+        Batch->Buffer = newBuffer;
+        Batch->BufferOffset = newOffset;
+        Batch->AllocatedEntries = newAllocatedEntries;
+    }
+
+    entry = &Batch->Buffer->Entries[numberOfEntries];
+    memset(entry, 0, sizeof(PHSVC_API_PAYLOAD));
+    entry->ApiNumber = ApiNumber;
+    entry->ReturnStatus = STATUS_PENDING;
+    Batch->Buffer->NumberOfEntries = numberOfEntries + 1;
+
+    return entry;
+}
+
+NTSTATUS PhSvcBatchControlProcess(
+    _Inout_ PPHSVC_BATCH Batch,
+    _In_ HANDLE ProcessId,
+    _In_ PHSVC_API_CONTROLPROCESS_COMMAND Command,
+    _In_ ULONG Argument
+    )
+{
+    PPHSVC_API_PAYLOAD entry;
+
+    if (!PhSvcClPortHandle)
+        return STATUS_PORT_DISCONNECTED;
+
+    if (!(entry = PhSvcpAddBatchEntry(Batch, PhSvcControlProcessApiNumber)))
+        return STATUS_NO_MEMORY;
+
+    entry->u.ControlProcess.i.ProcessId = ProcessId;
+    entry->u.ControlProcess.i.Command = Command;
+    entry->u.ControlProcess.i.Argument = Argument;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS PhSvcBatchControlService(
+    _Inout_ PPHSVC_BATCH Batch,
+    _In_ PWSTR ServiceName,
+    _In_ PHSVC_API_CONTROLSERVICE_COMMAND Command
+    )
+{
+    PHSVC_API_CONTROLSERVICE controlService;
+    PPHSVC_API_PAYLOAD entry;
+    PVOID serviceName;
+
+    if (!PhSvcClPortHandle)
+        return STATUS_PORT_DISCONNECTED;
+
+    // Create the string first because adding an entry can move the entries.
+    if (!(serviceName = PhSvcpCreateString(ServiceName, -1, &controlService.i.ServiceName)))
+        return STATUS_NO_MEMORY;
+
+    if (!(entry = PhSvcpAddBatchEntry(Batch, PhSvcControlServiceApiNumber)))
+    {
+        PhSvcpFreeHeap(serviceName);
+        return STATUS_NO_MEMORY;
+    }
+
+    PhAddItemList(Batch->Strings, serviceName);
+    controlService.i.Command = Command;
+    entry->u.ControlService = controlService;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS PhSvcBatchControlThread(
+    _Inout_ PPHSVC_BATCH Batch,
+    _In_ HANDLE ThreadId,
+    _In_ PHSVC_API_CONTROLTHREAD_COMMAND Command,
+    _In_ ULONG Argument
+    )
+{
+    PPHSVC_API_PAYLOAD entry;
+
+    if (!PhSvcClPortHandle)
+        return STATUS_PORT_DISCONNECTED;
+
+    if (!(entry = PhSvcpAddBatchEntry(Batch, PhSvcControlThreadApiNumber)))
+        return STATUS_NO_MEMORY;
+
+    entry->u.ControlThread.i.ThreadId = ThreadId;
+    entry->u.ControlThread.i.Command = Command;
+    entry->u.ControlThread.i.Argument = Argument;
+
+    return STATUS_SUCCESS;
+}
+
+// Executes every entry with a single call to the server. The return value is the status of the
+// call; use PhSvcGetBatchEntryStatus to get the status of each entry.
+NTSTATUS PhSvcExecuteBatch(
+    _Inout_ PPHSVC_BATCH Batch
+    )
+{
+    PHSVC_API_MSG m;
+
+    if (!PhSvcClPortHandle)
+        return Batch->Status = STATUS_PORT_DISCONNECTED;
+
+    if (!Batch->Buffer)
+        return Batch->Status = STATUS_SUCCESS;
+
+    memset(&m, 0, sizeof(PHSVC_API_MSG));
+    m.p.ApiNumber = PhSvcExecuteBatchApiNumber;
+    m.p.u.ExecuteBatch.i.Batch.Offset = Batch->BufferOffset;
+    m.p.u.ExecuteBatch.i.Batch.Length = FIELD_OFFSET(PHSVC_API_BATCH, Entries) + Batch->Buffer->NumberOfEntries * sizeof(PHSVC_API_PAYLOAD);
+    Batch->Buffer->NumberOfCompletedEntries = 0;
+    Batch->Status = STATUS_PENDING;
+
+    return Batch->Status = PhSvcpCallServer(&m);
+}
+
+static NTSTATUS NTAPI PhSvcpExecuteBatchWorker(
+    _In_ PVOID Parameter
+    )
+{
+    PPHSVC_BATCH batch = Parameter;
+    NTSTATUS status;
+
+    status = PhSvcExecuteBatch(batch);
+    batch->CompletionRoutine(batch, status, batch->Context);
+
+    return STATUS_SUCCESS;
+}
+
+// Executes a batch on a worker thread and then calls the completion routine from that thread.
+// The batch must not be modified or destroyed until then, but PhSvcGetBatchProgress can be used
+// to monitor it.
+VOID PhSvcQueueBatch(
+    _Inout_ PPHSVC_BATCH Batch,
+    _In_ PPHSVC_BATCH_COMPLETION_ROUTINE CompletionRoutine,
+    _In_opt_ PVOID Context
+    )
+{
+    Batch->CompletionRoutine = CompletionRoutine;
+    Batch->Context = Context;
+
+    if (Batch->Buffer)
+        Batch->Buffer->NumberOfCompletedEntries = 0;
+
+    PhQueueItemWorkQueue(PhGetGlobalWorkQueue(), PhSvcpExecuteBatchWorker, Batch);
+}
+
+// Gets the number of entries that the server has completed.
+ULONG PhSvcGetBatchProgress(
+    _In_ PPHSVC_BATCH Batch
+    )
+{
+    if (!Batch->Buffer)
+        return 0;
+
+    return Batch->Buffer->NumberOfCompletedEntries;
+}
+
+NTSTATUS PhSvcGetBatchEntryStatus(
+    _In_ PPHSVC_BATCH Batch,
+    _In_ ULONG Index
+    )
+{
+    if (!Batch->Buffer || Index >= Batch->Buffer->NumberOfEntries)
+        return STATUS_INVALID_PARAMETER;
+
+    if (Index < Batch->Buffer->NumberOfCompletedEntries)
+        return Batch->Buffer->Entries[Index].ReturnStatus;
+
+    // The entry was never executed because the call itself failed.
+    if (Batch->Status != STATUS_PENDING && !NT_SUCCESS(Batch->Status))
+        return Batch->Status;
+
+    return STATUS_PENDING;
+}
@@ -66,7 +66,8 @@ PPHSVC_API_PROCEDURE PhSvcApiCallTable[] =
     PhSvcApiCreateProcessIgnoreIfeoDebugger,
     PhSvcApiSetServiceSecurity,
     PhSvcApiWriteMiniDumpProcess,
-    PhSvcApiQueryProcessHeapInformation
+    PhSvcApiQueryProcessHeapInformation,
+    PhSvcApiExecuteBatch
 };
 C_ASSERT(sizeof(PhSvcApiCallTable) / sizeof(PPHSVC_API_PROCEDURE) == PhSvcMaximumApiNumber - 1);
 
@@ -77,28 +78,30 @@ NTSTATUS PhSvcApiInitialization(
     return STATUS_SUCCESS;
 }
 
-VOID PhSvcDispatchApiCall(
+static NTSTATUS PhSvcpCallApi(
     _In_ PPHSVC_CLIENT Client,
-    _Inout_ PPHSVC_API_PAYLOAD Payload,
-    _Out_ PHANDLE ReplyPortHandle
+    _Inout_ PPHSVC_API_PAYLOAD Payload
     )
 {
-    NTSTATUS status;
-
     if (
         Payload->ApiNumber == 0 ||
         (ULONG)Payload->ApiNumber >= (ULONG)PhSvcMaximumApiNumber ||
         !PhSvcApiCallTable[Payload->ApiNumber - 1]
         )
     {
-        Payload->ReturnStatus = STATUS_INVALID_SYSTEM_SERVICE;
-        *ReplyPortHandle = Client->PortHandle;
-        return;
+        return STATUS_INVALID_SYSTEM_SERVICE;
     }
 
-    status = PhSvcApiCallTable[Payload->ApiNumber - 1](Client, Payload);
-    Payload->ReturnStatus = status;
+    return PhSvcApiCallTable[Payload->ApiNumber - 1](Client, Payload);
+}
 
+VOID PhSvcDispatchApiCall(
+    _In_ PPHSVC_CLIENT Client,
+    _Inout_ PPHSVC_API_PAYLOAD Payload,
+    _Out_ PHANDLE ReplyPortHandle
+    )
+{
+    Payload->ReturnStatus = PhSvcpCallApi(Client, Payload);
     *ReplyPortHandle = Client->PortHandle;
 }
 
@@ -1546,3 +1549,57 @@ CleanupExit:
 
     return status;
 }
+
+NTSTATUS PhSvcApiExecuteBatch(
+    _In_ PPHSVC_CLIENT Client,
+    _Inout_ PPHSVC_API_PAYLOAD Payload
+    )
+{
+    NTSTATUS status;
+    PPHSVC_API_BATCH batch;
+    ULONG numberOfEntries;
+    ULONG numberOfFailedEntries;
+    ULONG i;
+
+    // The payload layout differs between the 32-bit server and a 64-bit client.
+    if (PhIsExecutingInWow64())
+        return STATUS_NOT_SUPPORTED;
+
+    if (!NT_SUCCESS(status = PhSvcProbeBuffer(&Payload->u.ExecuteBatch.i.Batch, sizeof(ULONG_PTR), FALSE, &batch)))
+        return status;
+
+    if (Payload->u.ExecuteBatch.i.Batch.Length < UFIELD_OFFSET(PHSVC_API_BATCH, Entries))
+        return STATUS_INVALID_BUFFER_SIZE;
+
+    // The client can modify the batch at any time, so each entry is captured before it is used.
+
+    numberOfEntries = batch->NumberOfEntries;
+
+    if (numberOfEntries > (Payload->u.ExecuteBatch.i.Batch.Length - UFIELD_OFFSET(PHSVC_API_BATCH, Entries)) / sizeof(PHSVC_API_PAYLOAD))
+        return STATUS_INVALID_BUFFER_SIZE;
+
+    numberOfFailedEntries = 0;
+
+    for (i = 0; i < numberOfEntries; i++)
+    {
+        PHSVC_API_PAYLOAD entry;
+
+        memcpy(&entry, &batch->Entries[i], sizeof(PHSVC_API_PAYLOAD));
+
+        if (entry.ApiNumber != PhSvcExecuteBatchApiNumber)
+            entry.ReturnStatus = PhSvcpCallApi(Client, &entry);
+        else
+            entry.ReturnStatus = STATUS_INVALID_PARAMETER;
+
+        if (!NT_SUCCESS(entry.ReturnStatus))
+            numberOfFailedEntries++;
+
+        memcpy(&batch->Entries[i], &entry, sizeof(PHSVC_API_PAYLOAD));
+        MemoryBarrier();
+        batch->NumberOfCompletedEntries = i + 1;
+    }
+
+    Payload->u.ExecuteBatch.o.NumberOfFailedEntries = numberOfFailedEntries;
+
+    return STATUS_SUCCESS;
+}
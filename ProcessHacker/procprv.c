@@ -81,8 +81,7 @@ typedef struct _PH_PROCESS_QUERY_S1_DATA
 
     PPH_STRING CommandLine;
 
-    HICON SmallIcon;
-    HICON LargeIcon;
+    PPH_FILE_ICON FileIcon;
     PH_IMAGE_VERSION_INFO VersionInfo;
 
     HANDLE ConsoleHostProcessId;
@@ -119,12 +118,104 @@ typedef struct _PH_PROCESS_QUERY_S2_DATA
     PH_IMAGE_VERSION_INFO VersionInfo; // LXSS only
 } PH_PROCESS_QUERY_S2_DATA, *PPH_PROCESS_QUERY_S2_DATA;
 
+// Stage 1 and stage 2 queries are queued in groups of processes that have the same image. The
+// information that only depends on the image is queried once for each group, and each group is
+// served by one work item. Groups of processes that are visible are moved to the high priority list
+// so that they are served first.
+
+#define PH_PROCESS_QUERY_MAXIMUM_WORKERS 2
+
+typedef struct _PH_PROCESS_QUERY_IMAGE
+{
+    PPH_STRING FileName;
+    PPH_FILE_ICON FileIcon;
+    PH_IMAGE_VERSION_INFO VersionInfo;
+} PH_PROCESS_QUERY_IMAGE, *PPH_PROCESS_QUERY_IMAGE;
+
+typedef struct _PH_PROCESS_QUERY_GROUP
+{
+    LIST_ENTRY ListEntry;
+    PPH_STRING FileName; // NULL if the group can only contain one process
+    BOOLEAN HighPriority;
+    PPH_LIST ProcessItems;
+} PH_PROCESS_QUERY_GROUP, *PPH_PROCESS_QUERY_GROUP;
+
+typedef struct _PH_PROCESS_QUERY_QUEUE
+{
+    PH_QUEUED_LOCK Lock;
+    ULONG Stage;
+    LIST_ENTRY HighPriorityListHead;
+    LIST_ENTRY NormalPriorityListHead;
+    PPH_HASHTABLE GroupHashtable;
+    ULONG NumberOfWorkers;
+    volatile ULONG NumberOfGroups;
+} PH_PROCESS_QUERY_QUEUE, *PPH_PROCESS_QUERY_QUEUE;
+
 typedef struct _PH_SID_FULL_NAME_CACHE_ENTRY
 {
     PSID Sid;
     PPH_STRING FullName;
 } PH_SID_FULL_NAME_CACHE_ENTRY, *PPH_SID_FULL_NAME_CACHE_ENTRY;
 
+typedef struct _PH_PROCESS_RECORD_STRING
+{
+    PPH_STRING String;
+    ULONG Count; // number of process records using the string
+} PH_PROCESS_RECORD_STRING, *PPH_PROCESS_RECORD_STRING;
+
+typedef struct _PH_PROCESS_RECORD_PURGE_CONTEXT
+{
+    LONG64 StatisticsThreshold;
+    PPH_LIST DerefList; // records to dereference after the list lock is released
+} PH_PROCESS_RECORD_PURGE_CONTEXT, *PPH_PROCESS_RECORD_PURGE_CONTEXT;
+
+// The statistics of existing processes are updated in chunks of consecutive process entries. The
+// first chunk is updated on the provider thread and the other chunks are updated in parallel on a
+// work queue. Each chunk finds its own maximum CPU and I/O usage, and these are reduced in the
+// order of the chunks, so the results don't depend on the number of chunks.
+
+#define PH_PROCESS_STATISTICS_MINIMUM_CHUNK_SIZE 256
+#define PH_PROCESS_STATISTICS_MAXIMUM_CHUNKS 64
+
+typedef struct _PH_PROCESS_STATISTICS_ENTRY
+{
+    PSYSTEM_PROCESS_INFORMATION Process;
+    PPH_PROCESS_ITEM ProcessItem;
+    BOOLEAN Modified;
+} PH_PROCESS_STATISTICS_ENTRY, *PPH_PROCESS_STATISTICS_ENTRY;
+
+typedef struct _PH_PROCESS_STATISTICS_CHUNK
+{
+    PPH_PROCESS_STATISTICS_ENTRY Entries;
+    ULONG Count;
+    ULONG64 SysTotalTime;
+    ULONG64 SysTotalCycleTime;
+
+    FLOAT MaxCpuValue;
+    PPH_PROCESS_ITEM MaxCpuProcessItem;
+    ULONG64 MaxIoValue;
+    PPH_PROCESS_ITEM MaxIoProcessItem;
+} PH_PROCESS_STATISTICS_CHUNK, *PPH_PROCESS_STATISTICS_CHUNK;
+
+// Plugins that are notified when processes are created or terminated (for example by ETW) queue
+// process events, which are applied on the provider thread without waiting for the next full
+// update. The full update still finds every process, so events that can't be applied or don't fit
+// in the queue are simply dropped.
+
+#define PH_PROCESS_PROVIDER_MAXIMUM_EVENTS 1024
+
+typedef struct _PH_PROCESS_PROVIDER_EVENT
+{
+    SLIST_ENTRY ListEntry;
+    PH_PROCESS_PROVIDER_EVENT_TYPE Type;
+    HANDLE ProcessId;
+    HANDLE ParentProcessId;
+    ULONG SessionId;
+    PPH_STRING ImageName;
+    LARGE_INTEGER Time;
+    BOOLEAN Handled;
+} PH_PROCESS_PROVIDER_EVENT, *PPH_PROCESS_PROVIDER_EVENT;
+
 VOID NTAPI PhpProcessItemDeleteProcedure(
     _In_ PVOID Object,
     _In_ ULONG Flags
@@ -138,6 +229,11 @@ VOID PhpQueueProcessQueryStage2(
     _In_ PPH_PROCESS_ITEM ProcessItem
     );
 
+VOID PhpInitializeProcessQueryQueue(
+    _Out_ PPH_PROCESS_QUERY_QUEUE Queue,
+    _In_ ULONG Stage
+    );
+
 PPH_PROCESS_RECORD PhpCreateProcessRecord(
     _In_ PPH_PROCESS_ITEM ProcessItem
     );
@@ -150,6 +246,19 @@ VOID PhpRemoveProcessRecord(
     _Inout_ PPH_PROCESS_RECORD ProcessRecord
     );
 
+VOID PhpRetainProcessRecord(
+    _Inout_ PPH_PROCESS_RECORD ProcessRecord
+    );
+
+BOOLEAN PhpProcessRecordStringEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    );
+
+ULONG PhpProcessRecordStringHashFunction(
+    _In_ PVOID Entry
+    );
+
 PPH_OBJECT_TYPE PhProcessItemType = NULL;
 
 PPH_HASH_ENTRY PhProcessHashSet[256] = PH_HASH_SET_INIT;
@@ -157,13 +266,31 @@ ULONG PhProcessHashSetCount = 0;
 PH_QUEUED_LOCK PhProcessHashSetLock = PH_QUEUED_LOCK_INIT;
 
 SLIST_HEADER PhProcessQueryDataListHead;
+static PH_PROCESS_QUERY_QUEUE PhpProcessQueryQueues[2];
+static PPH_HASHTABLE PhpProcessQueryImageHashtable = NULL; // only used by the provider thread
 
 PPH_LIST PhProcessRecordList = NULL;
 PH_QUEUED_LOCK PhProcessRecordListLock = PH_QUEUED_LOCK_INIT;
+static PH_TIMELINE PhpProcessRecordTimeline; // process records by process ID and create time
+static PPH_HASHTABLE PhpProcessRecordStringHashtable = NULL; // names shared by process records
+static LIST_ENTRY PhpRetainedProcessRecordListHead; // dead process records in order of exit time
+
+static PH_WORK_QUEUE PhpProcessStatisticsWorkQueue;
+static HANDLE PhpProcessStatisticsEventHandle = NULL; // set when the last queued chunk has been updated
+static volatile LONG PhpProcessStatisticsPendingChunks = 0;
+static PPH_PROCESS_STATISTICS_ENTRY PhpProcessStatisticsEntries = NULL; // only used by the provider thread
+static ULONG PhpProcessStatisticsEntriesAllocated = 0;
+
+static SLIST_HEADER PhpProcessProviderEventListHead;
+static volatile LONG PhpProcessProviderEventCount = 0;
+static ULONG64 PhpExitedProcessCycleTime = 0; // cycle time of processes removed since the last full update
 
 ULONG PhStatisticsSampleCount = 512;
 BOOLEAN PhEnablePurgeProcessRecords = TRUE;
+ULONG PhProcessRecordRetentionTime = 0;
 BOOLEAN PhEnableCycleCpuUsage = TRUE;
+PPH_SYSTEM_TRACE PhProcessProviderTrace = NULL; // records or replays the system information of each update
+PPH_PROVIDER_REGISTRATION PhProcessProviderEventRegistration = NULL; // boosted when process events are queued
 
 PVOID PhProcessInformation = NULL; // only can be used if running on same thread as process provider
 SYSTEM_PERFORMANCE_INFORMATION PhPerfInformation;
@@ -211,6 +338,8 @@ PH_CIRCULAR_BUFFER_FLOAT PhCpuUserHistory;
 PPH_CIRCULAR_BUFFER_FLOAT PhCpusKernelHistory;
 PPH_CIRCULAR_BUFFER_FLOAT PhCpusUserHistory;
 //PPH_CIRCULAR_BUFFER_FLOAT PhCpusOtherHistory;
+PPH_HISTORY_BUFFER PhCpusKernelHistoryLevels;
+PPH_HISTORY_BUFFER PhCpusTotalHistoryLevels;
 
 PH_CIRCULAR_BUFFER_ULONG64 PhIoReadHistory;
 PH_CIRCULAR_BUFFER_ULONG64 PhIoWriteHistory;
@@ -236,12 +365,38 @@ BOOLEAN PhProcessProviderInitialization(
     PFLOAT usageBuffer;
     PPH_UINT64_DELTA deltaBuffer;
     PPH_CIRCULAR_BUFFER_FLOAT historyBuffer;
+    PPH_HISTORY_BUFFER historyLevelsBuffer;
 
     PhProcessItemType = PhCreateObjectType(L"ProcessItem", 0, PhpProcessItemDeleteProcedure);
 
     RtlInitializeSListHead(&PhProcessQueryDataListHead);
+    RtlInitializeSListHead(&PhpProcessProviderEventListHead);
+    PhpInitializeProcessQueryQueue(&PhpProcessQueryQueues[0], 1);
+    PhpInitializeProcessQueryQueue(&PhpProcessQueryQueues[1], 2);
 
     PhProcessRecordList = PhCreateList(40);
+    PhInitializeTimeline(&PhpProcessRecordTimeline);
+    PhpProcessRecordStringHashtable = PhCreateHashtable(
+        sizeof(PH_PROCESS_RECORD_STRING),
+        PhpProcessRecordStringEqualFunction,
+        PhpProcessRecordStringHashFunction,
+        64
+        );
+    InitializeListHead(&PhpRetainedProcessRecordListHead);
+
+    if (PhSystemBasicInformation.NumberOfProcessors > 1)
+    {
+        PhInitializeWorkQueue(
+            &PhpProcessStatisticsWorkQueue,
+            0,
+            min((ULONG)PhSystemBasicInformation.NumberOfProcessors, PH_PROCESS_STATISTICS_MAXIMUM_CHUNKS) - 1,
+            5000
+            );
+
+        // The statistics are updated on the provider thread only if this fails.
+        if (!NT_SUCCESS(NtCreateEvent(&PhpProcessStatisticsEventHandle, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE)))
+            PhpProcessStatisticsEventHandle = NULL;
+    }
 
     PhDpcsProcessInformation = PhAllocateZero(sizeof(SYSTEM_PROCESS_INFORMATION) + sizeof(SYSTEM_PROCESS_INFORMATION_EXTENSION));
     RtlInitUnicodeString(&PhDpcsProcessInformation->ImageName, L"DPCs");
@@ -282,6 +437,11 @@ BOOLEAN PhProcessProviderInitialization(
         (ULONG)PhSystemBasicInformation.NumberOfProcessors *
         2
         );
+    historyLevelsBuffer = PhAllocate(
+        sizeof(PH_HISTORY_BUFFER) *
+        (ULONG)PhSystemBasicInformation.NumberOfProcessors *
+        2
+        );
 
     PhCpusKernelUsage = usageBuffer;
     PhCpusUserUsage = PhCpusKernelUsage + (ULONG)PhSystemBasicInformation.NumberOfProcessors;
@@ -294,6 +454,9 @@ BOOLEAN PhProcessProviderInitialization(
     PhCpusKernelHistory = historyBuffer;
     PhCpusUserHistory = PhCpusKernelHistory + (ULONG)PhSystemBasicInformation.NumberOfProcessors;
 
+    PhCpusKernelHistoryLevels = historyLevelsBuffer;
+    PhCpusTotalHistoryLevels = PhCpusKernelHistoryLevels + (ULONG)PhSystemBasicInformation.NumberOfProcessors;
+
     memset(deltaBuffer, 0, sizeof(PH_UINT64_DELTA) * (ULONG)PhSystemBasicInformation.NumberOfProcessors);
 
     return TRUE;
@@ -468,8 +631,7 @@ VOID PhpProcessItemDeleteProcedure(
     if (processItem->FileNameWin32) PhDereferenceObject(processItem->FileNameWin32);
     if (processItem->FileName) PhDereferenceObject(processItem->FileName);
     if (processItem->CommandLine) PhDereferenceObject(processItem->CommandLine);
-    if (processItem->SmallIcon) DestroyIcon(processItem->SmallIcon);
-    if (processItem->LargeIcon) DestroyIcon(processItem->LargeIcon);
+    if (processItem->FileIcon) PhDereferenceFileIcon(processItem->FileIcon);
     PhDeleteImageVersionInfo(&processItem->VersionInfo);
     if (processItem->Sid) PhFree(processItem->Sid);
     if (processItem->VerifySignerName) PhDereferenceObject(processItem->VerifySignerName);
@@ -739,33 +901,156 @@ VOID PhpFlushSidFullNameCache(
     PhClearReference(&PhpSidFullNameCacheHashtable);
 }
 
-VOID PhpProcessQueryStage1(
-    _Inout_ PPH_PROCESS_QUERY_S1_DATA Data
+BOOLEAN PhpCanGroupProcessQuery(
+    _In_ PPH_PROCESS_ITEM ProcessItem
     )
 {
-    NTSTATUS status;
-    PPH_PROCESS_ITEM processItem = Data->Header.ProcessItem;
-    HANDLE processId = processItem->ProcessId;
-    HANDLE processHandleLimited = processItem->QueryHandle;
+    return !PhIsNullOrEmptyString(ProcessItem->FileNameWin32) && !ProcessItem->IsSubsystemProcess;
+}
 
-    if (!PhIsNullOrEmptyString(processItem->FileName) && !processItem->IsSubsystemProcess)
+VOID PhpProcessQueryStage1Image(
+    _In_ PPH_PROCESS_ITEM ProcessItem,
+    _Out_ PPH_PROCESS_QUERY_IMAGE Image
+    )
+{
+    memset(Image, 0, sizeof(PH_PROCESS_QUERY_IMAGE));
+
+    if (!PhIsNullOrEmptyString(ProcessItem->FileName) && !ProcessItem->IsSubsystemProcess)
     {
-        if (PhDoesFileExists(PhGetString(processItem->FileName)))
+        if (PhDoesFileExists(PhGetString(ProcessItem->FileName)))
         {
-            if (!PhExtractIcon(
-                PhGetString(processItem->FileNameWin32),
-                &Data->LargeIcon,
-                &Data->SmallIcon
-                ))
-            {
-                Data->LargeIcon = NULL;
-                Data->SmallIcon = NULL;
-            }
+            // Small icon, large icon. These are shared with other processes that have the same
+            // image.
+            Image->FileIcon = PhGetFileIcon(PhGetString(ProcessItem->FileNameWin32), 0);
 
             // Version info.
-            PhInitializeImageVersionInfoCached(&Data->VersionInfo, processItem->FileNameWin32, FALSE);
+            PhInitializeImageVersionInfoCached(&Image->VersionInfo, ProcessItem->FileNameWin32, FALSE);
         }
     }
+}
+
+VOID PhpCopyProcessQueryImage(
+    _In_ PPH_PROCESS_QUERY_IMAGE Image,
+    _Inout_ PPH_PROCESS_QUERY_S1_DATA Data
+    )
+{
+    if (Image->FileIcon)
+        Data->FileIcon = PhReferenceFileIcon(Image->FileIcon);
+
+    Data->VersionInfo = Image->VersionInfo;
+
+    if (Data->VersionInfo.CompanyName)
+        PhReferenceObject(Data->VersionInfo.CompanyName);
+    if (Data->VersionInfo.FileDescription)
+        PhReferenceObject(Data->VersionInfo.FileDescription);
+    if (Data->VersionInfo.FileVersion)
+        PhReferenceObject(Data->VersionInfo.FileVersion);
+    if (Data->VersionInfo.ProductName)
+        PhReferenceObject(Data->VersionInfo.ProductName);
+}
+
+VOID PhpDeleteProcessQueryImage(
+    _Inout_ PPH_PROCESS_QUERY_IMAGE Image
+    )
+{
+    if (Image->FileName) PhDereferenceObject(Image->FileName);
+    if (Image->FileIcon) PhDereferenceFileIcon(Image->FileIcon);
+    PhDeleteImageVersionInfo(&Image->VersionInfo);
+}
+
+BOOLEAN PhpProcessQueryImageEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PPH_PROCESS_QUERY_IMAGE image1 = Entry1;
+    PPH_PROCESS_QUERY_IMAGE image2 = Entry2;
+
+    return PhEqualString(image1->FileName, image2->FileName, TRUE);
+}
+
+ULONG PhpProcessQueryImageHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PPH_PROCESS_QUERY_IMAGE image = Entry;
+
+    return PhHashStringRef(&image->FileName->sr, TRUE);
+}
+
+/**
+ * Queries the image information for a new process on the provider thread. The information is
+ * cached until the end of the provider update, so it is only queried once for each image when
+ * many processes are created at the same time.
+ */
+VOID PhpProcessQueryStage1ImageCached(
+    _Inout_ PPH_PROCESS_QUERY_S1_DATA Data
+    )
+{
+    PPH_PROCESS_ITEM processItem = Data->Header.ProcessItem;
+    PH_PROCESS_QUERY_IMAGE newImage;
+    PPH_PROCESS_QUERY_IMAGE image;
+
+    if (!PhpCanGroupProcessQuery(processItem))
+    {
+        PhpProcessQueryStage1Image(processItem, &newImage);
+        PhpCopyProcessQueryImage(&newImage, Data);
+        PhpDeleteProcessQueryImage(&newImage);
+        return;
+    }
+
+    if (!PhpProcessQueryImageHashtable)
+    {
+        PhpProcessQueryImageHashtable = PhCreateHashtable(
+            sizeof(PH_PROCESS_QUERY_IMAGE),
+            PhpProcessQueryImageEqualFunction,
+            PhpProcessQueryImageHashFunction,
+            16
+            );
+    }
+
+    newImage.FileName = processItem->FileNameWin32;
+    image = PhFindEntryHashtable(PhpProcessQueryImageHashtable, &newImage);
+
+    if (!image)
+    {
+        PhpProcessQueryStage1Image(processItem, &newImage);
+        newImage.FileName = PhReferenceObject(processItem->FileNameWin32);
+        image = PhAddEntryHashtableEx(PhpProcessQueryImageHashtable, &newImage, NULL);
+    }
+
+    PhpCopyProcessQueryImage(image, Data);
+}
+
+VOID PhpFlushProcessQueryImageCache(
+    VOID
+    )
+{
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PPH_PROCESS_QUERY_IMAGE image;
+
+    if (!PhpProcessQueryImageHashtable)
+        return;
+
+    PhBeginEnumHashtable(PhpProcessQueryImageHashtable, &enumContext);
+
+    while (image = PhNextEnumHashtable(&enumContext))
+        PhpDeleteProcessQueryImage(image);
+
+    PhClearReference(&PhpProcessQueryImageHashtable);
+}
+
+/**
+ * Queries the information for a new process that does not only depend on its image.
+ */
+VOID PhpProcessQueryStage1(
+    _Inout_ PPH_PROCESS_QUERY_S1_DATA Data
+    )
+{
+    NTSTATUS status;
+    PPH_PROCESS_ITEM processItem = Data->Header.ProcessItem;
+    HANDLE processId = processItem->ProcessId;
+    HANDLE processHandleLimited = processItem->QueryHandle;
 
     // Command line, .NET
     if (processHandleLimited && !processItem->IsSubsystemProcess)
@@ -978,151 +1263,429 @@ VOID PhpProcessQueryStage2(
     }
 }
 
-NTSTATUS PhpProcessQueryStage1Worker(
-    _In_ PVOID Parameter
+VOID PhpCopyProcessQueryStage2Data(
+    _In_ PPH_PROCESS_QUERY_S2_DATA Source,
+    _Inout_ PPH_PROCESS_QUERY_S2_DATA Destination
     )
 {
-    PPH_PROCESS_ITEM processItem = (PPH_PROCESS_ITEM)Parameter;
-    PPH_PROCESS_QUERY_S1_DATA data;
-
-    data = PhAllocateZero(sizeof(PH_PROCESS_QUERY_S1_DATA));
-    data->Header.Stage = 1;
-    data->Header.ProcessItem = processItem;
-
-    PhpProcessQueryStage1(data);
-
-    RtlInterlockedPushEntrySList(&PhProcessQueryDataListHead, &data->Header.ListEntry);
-
-    return STATUS_SUCCESS;
+    Destination->VerifyResult = Source->VerifyResult;
+    PhSetReference(&Destination->VerifySignerName, Source->VerifySignerName);
+    Destination->IsPacked = Source->IsPacked;
+    Destination->ImportFunctions = Source->ImportFunctions;
+    Destination->ImportModules = Source->ImportModules;
 }
 
-NTSTATUS PhpProcessQueryStage2Worker(
-    _In_ PVOID Parameter
+VOID PhpProcessQueryStage1Group(
+    _In_ PPH_PROCESS_QUERY_GROUP Group
     )
 {
-    PPH_PROCESS_ITEM processItem = (PPH_PROCESS_ITEM)Parameter;
-    PPH_PROCESS_QUERY_S2_DATA data;
+    PH_PROCESS_QUERY_IMAGE image;
+    BOOLEAN imageQueried = FALSE;
+    ULONG i;
 
-    data = PhAllocateZero(sizeof(PH_PROCESS_QUERY_S2_DATA));
-    data->Header.Stage = 2;
-    data->Header.ProcessItem = processItem;
+    for (i = 0; i < Group->ProcessItems->Count; i++)
+    {
+        PPH_PROCESS_ITEM processItem = Group->ProcessItems->Items[i];
+        PPH_PROCESS_QUERY_S1_DATA data;
+
+        data = PhAllocateZero(sizeof(PH_PROCESS_QUERY_S1_DATA));
+        data->Header.Stage = 1;
+        data->Header.ProcessItem = processItem;
+
+        // Don't query processes that exited while they were queued. The empty data is still
+        // returned so that the stage 1 event is set.
+        if (!(processItem->State & PH_PROCESS_ITEM_REMOVED))
+        {
+            if (!imageQueried)
+            {
+                PhpProcessQueryStage1Image(processItem, &image);
+                imageQueried = TRUE;
+            }
 
-    PhpProcessQueryStage2(data);
+            PhpCopyProcessQueryImage(&image, data);
+            PhpProcessQueryStage1(data);
+        }
 
-    RtlInterlockedPushEntrySList(&PhProcessQueryDataListHead, &data->Header.ListEntry);
+        RtlInterlockedPushEntrySList(&PhProcessQueryDataListHead, &data->Header.ListEntry);
+    }
 
-    return STATUS_SUCCESS;
+    if (imageQueried)
+        PhpDeleteProcessQueryImage(&image);
 }
 
-VOID PhpQueueProcessQueryStage1(
-    _In_ PPH_PROCESS_ITEM ProcessItem
+VOID PhpProcessQueryStage2Group(
+    _In_ PPH_PROCESS_QUERY_GROUP Group
     )
 {
-    PH_WORK_QUEUE_ENVIRONMENT environment;
+    PH_PROCESS_QUERY_S2_DATA imageData;
+    BOOLEAN imageQueried = FALSE;
+    ULONG i;
 
-    // Ref: dereferenced when the provider update function removes the item from the queue.
-    PhReferenceObject(ProcessItem);
+    // Stage 2 only depends on the image, so it is queried for the first process in the group
+    // and copied to the others.
 
-    PhInitializeWorkQueueEnvironment(&environment);
-    environment.BasePriority = THREAD_PRIORITY_BELOW_NORMAL;
+    memset(&imageData, 0, sizeof(PH_PROCESS_QUERY_S2_DATA));
 
-    PhQueueItemWorkQueueEx(PhGetGlobalWorkQueue(), PhpProcessQueryStage1Worker, ProcessItem, NULL, &environment);
-}
+    for (i = 0; i < Group->ProcessItems->Count; i++)
+    {
+        PPH_PROCESS_ITEM processItem = Group->ProcessItems->Items[i];
+        PPH_PROCESS_QUERY_S2_DATA data;
 
-VOID PhpQueueProcessQueryStage2(
-    _In_ PPH_PROCESS_ITEM ProcessItem
-    )
-{
-    PH_WORK_QUEUE_ENVIRONMENT environment;
+        if (processItem->State & PH_PROCESS_ITEM_REMOVED)
+        {
+            PhDereferenceObject(processItem);
+            continue;
+        }
 
-    PhReferenceObject(ProcessItem);
+        data = PhAllocateZero(sizeof(PH_PROCESS_QUERY_S2_DATA));
+        data->Header.Stage = 2;
+        data->Header.ProcessItem = processItem;
 
-    PhInitializeWorkQueueEnvironment(&environment);
-    environment.BasePriority = THREAD_PRIORITY_BELOW_NORMAL;
-    environment.IoPriority = IoPriorityVeryLow;
-    environment.PagePriority = MEMORY_PRIORITY_VERY_LOW;
+        if (!Group->FileName)
+        {
+            PhpProcessQueryStage2(data);
+        }
+        else
+        {
+            if (!imageQueried)
+            {
+                imageData.Header.ProcessItem = processItem;
+                PhpProcessQueryStage2(&imageData);
+                imageQueried = TRUE;
+            }
+
+            PhpCopyProcessQueryStage2Data(&imageData, data);
+        }
+
+        RtlInterlockedPushEntrySList(&PhProcessQueryDataListHead, &data->Header.ListEntry);
+    }
 
-    PhQueueItemWorkQueueEx(PhGetGlobalWorkQueue(), PhpProcessQueryStage2Worker, ProcessItem, NULL, &environment);
+    if (imageData.VerifySignerName)
+        PhDereferenceObject(imageData.VerifySignerName);
 }
 
-VOID PhpFillProcessItemStage1(
-    _In_ PPH_PROCESS_QUERY_S1_DATA Data
+BOOLEAN PhpProcessQueryGroupEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
     )
 {
-    PPH_PROCESS_ITEM processItem = Data->Header.ProcessItem;
+    PPH_PROCESS_QUERY_GROUP group1 = *(PPH_PROCESS_QUERY_GROUP *)Entry1;
+    PPH_PROCESS_QUERY_GROUP group2 = *(PPH_PROCESS_QUERY_GROUP *)Entry2;
 
-    processItem->CommandLine = Data->CommandLine;
-    processItem->SmallIcon = Data->SmallIcon;
-    processItem->LargeIcon = Data->LargeIcon;
-    memcpy(&processItem->VersionInfo, &Data->VersionInfo, sizeof(PH_IMAGE_VERSION_INFO));
-    processItem->ConsoleHostProcessId = Data->ConsoleHostProcessId;
-    processItem->PackageFullName = Data->PackageFullName;
-    processItem->IsDotNet = Data->IsDotNet;
-    processItem->IsInJob = Data->IsInJob;
-    processItem->IsInSignificantJob = Data->IsInSignificantJob;
-    processItem->IsBeingDebugged = Data->IsBeingDebugged;
-    processItem->IsImmersive = Data->IsImmersive;
-    processItem->IsProtectedHandle = Data->IsFilteredHandle;
+    return PhEqualString(group1->FileName, group2->FileName, TRUE);
+}
 
-    PhSwapReference(&processItem->Record->CommandLine, processItem->CommandLine);
+ULONG PhpProcessQueryGroupHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PPH_PROCESS_QUERY_GROUP group = *(PPH_PROCESS_QUERY_GROUP *)Entry;
 
-    // Note: We might have referenced the cached username so don't overwrite the previous data. (dmex)
-    if (!processItem->UserName)
-        processItem->UserName = Data->UserName;
-    else if (Data->UserName)
-        PhDereferenceObject(Data->UserName);
+    return PhHashStringRef(&group->FileName->sr, TRUE);
+}
 
-    // Note: Queue stage 2 processing after filling stage1 process data. 
-    PhpQueueProcessQueryStage2(processItem);
+VOID PhpInitializeProcessQueryQueue(
+    _Out_ PPH_PROCESS_QUERY_QUEUE Queue,
+    _In_ ULONG Stage
+    )
+{
+    PhInitializeQueuedLock(&Queue->Lock);
+    Queue->Stage = Stage;
+    InitializeListHead(&Queue->HighPriorityListHead);
+    InitializeListHead(&Queue->NormalPriorityListHead);
+    Queue->GroupHashtable = PhCreateHashtable(
+        sizeof(PPH_PROCESS_QUERY_GROUP),
+        PhpProcessQueryGroupEqualFunction,
+        PhpProcessQueryGroupHashFunction,
+        32
+        );
+    Queue->NumberOfWorkers = 0;
+    Queue->NumberOfGroups = 0;
 }
 
-VOID PhpFillProcessItemStage2(
-    _In_ PPH_PROCESS_QUERY_S2_DATA Data
+PPH_PROCESS_QUERY_GROUP PhpFindProcessQueryGroup(
+    _In_ PPH_PROCESS_QUERY_QUEUE Queue,
+    _In_ PPH_PROCESS_ITEM ProcessItem
     )
 {
-    PPH_PROCESS_ITEM processItem = Data->Header.ProcessItem;
+    PH_PROCESS_QUERY_GROUP lookupGroup;
+    PPH_PROCESS_QUERY_GROUP lookupGroupPtr = &lookupGroup;
+    PPH_PROCESS_QUERY_GROUP *group;
+    PLIST_ENTRY listEntry;
 
-    processItem->VerifyResult = Data->VerifyResult;
-    processItem->VerifySignerName = Data->VerifySignerName;
-    processItem->IsPacked = Data->IsPacked;
-    processItem->ImportFunctions = Data->ImportFunctions;
-    processItem->ImportModules = Data->ImportModules;
+    if (PhpCanGroupProcessQuery(ProcessItem))
+    {
+        lookupGroup.FileName = ProcessItem->FileNameWin32;
+        group = PhFindEntryHashtable(Queue->GroupHashtable, &lookupGroupPtr);
 
-    // Note: We query Win32 processes in stage1 so don't overwrite the previous data. (dmex)
-    if (processItem->IsSubsystemProcess)
+        return group ? *group : NULL;
+    }
+
+    // Groups of processes that can't be grouped only contain one process. Only groups with normal
+    // priority need to be searched.
+    for (listEntry = Queue->NormalPriorityListHead.Flink; listEntry != &Queue->NormalPriorityListHead; listEntry = listEntry->Flink)
     {
-        memcpy(&processItem->VersionInfo, &Data->VersionInfo, sizeof(PH_IMAGE_VERSION_INFO));
+        PPH_PROCESS_QUERY_GROUP otherGroup = CONTAINING_RECORD(listEntry, PH_PROCESS_QUERY_GROUP, ListEntry);
+
+        if (!otherGroup->FileName && otherGroup->ProcessItems->Items[0] == ProcessItem)
+            return otherGroup;
     }
+
+    return NULL;
 }
 
-VOID PhpFillProcessItemExtension(
-    _Inout_ PPH_PROCESS_ITEM ProcessItem,
-    _In_ PSYSTEM_PROCESS_INFORMATION Process
+NTSTATUS PhpProcessQueryWorker(
+    _In_ PVOID Parameter
+    );
+
+VOID PhpQueueProcessQueryWorker(
+    _In_ PPH_PROCESS_QUERY_QUEUE Queue
     )
 {
-    PSYSTEM_PROCESS_INFORMATION_EXTENSION processExtension;
+    PH_WORK_QUEUE_ENVIRONMENT environment;
 
-    if (WindowsVersion < WINDOWS_10_RS3 || PhIsExecutingInWow64())
-        return;
-    
-    processExtension = PH_PROCESS_EXTENSION(Process);
+    PhInitializeWorkQueueEnvironment(&environment);
+    environment.BasePriority = THREAD_PRIORITY_BELOW_NORMAL;
 
-    ProcessItem->JobObjectId = processExtension->JobObjectId;
-    ProcessItem->ProcessSequenceNumber = processExtension->ProcessSequenceNumber;
+    if (Queue->Stage == 2)
+    {
+        environment.IoPriority = IoPriorityVeryLow;
+        environment.PagePriority = MEMORY_PRIORITY_VERY_LOW;
+    }
+
+    PhQueueItemWorkQueueEx(PhGetGlobalWorkQueue(), PhpProcessQueryWorker, Queue, NULL, &environment);
 }
 
-VOID PhpFillProcessItem(
-    _Inout_ PPH_PROCESS_ITEM ProcessItem,
-    _In_ PSYSTEM_PROCESS_INFORMATION Process
+NTSTATUS PhpProcessQueryWorker(
+    _In_ PVOID Parameter
     )
 {
-    ProcessItem->ParentProcessId = Process->InheritedFromUniqueProcessId;
-    ProcessItem->SessionId = Process->SessionId;
-    ProcessItem->CreateTime = Process->CreateTime;
+    PPH_PROCESS_QUERY_QUEUE queue = Parameter;
+    PPH_PROCESS_QUERY_GROUP group;
+    PLIST_ENTRY listEntry;
 
-    if (ProcessItem->ProcessId != SYSTEM_IDLE_PROCESS_ID)
-        ProcessItem->ProcessName = PhCreateStringFromUnicodeString(&Process->ImageName);
-    else
+    PhAcquireQueuedLockExclusive(&queue->Lock);
+
+    if (!IsListEmpty(&queue->HighPriorityListHead))
+    {
+        listEntry = RemoveHeadList(&queue->HighPriorityListHead);
+    }
+    else if (!IsListEmpty(&queue->NormalPriorityListHead))
+    {
+        listEntry = RemoveHeadList(&queue->NormalPriorityListHead);
+    }
+    else
+    {
+        queue->NumberOfWorkers--;
+        PhReleaseQueuedLockExclusive(&queue->Lock);
+        return STATUS_SUCCESS;
+    }
+
+    group = CONTAINING_RECORD(listEntry, PH_PROCESS_QUERY_GROUP, ListEntry);
+
+    // New processes with the same image will be added to a new group from now on.
+    if (group->FileName)
+        PhRemoveEntryHashtable(queue->GroupHashtable, &group);
+
+    queue->NumberOfGroups--;
+
+    PhReleaseQueuedLockExclusive(&queue->Lock);
+
+    if (queue->Stage == 1)
+        PhpProcessQueryStage1Group(group);
+    else
+        PhpProcessQueryStage2Group(group);
+
+    if (group->FileName)
+        PhDereferenceObject(group->FileName);
+
+    PhDereferenceObject(group->ProcessItems);
+    PhFree(group);
+
+    // Serve the next group using a new work item instead of looping, so that other users of the
+    // global work queue aren't delayed when many processes are created.
+    PhpQueueProcessQueryWorker(queue);
+
+    return STATUS_SUCCESS;
+}
+
+VOID PhpQueueProcessQuery(
+    _In_ PPH_PROCESS_QUERY_QUEUE Queue,
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    )
+{
+    PPH_PROCESS_QUERY_GROUP group;
+    BOOLEAN queueWorker = FALSE;
+
+    // Ref: dereferenced when the provider update function removes the item from the queue.
+    PhReferenceObject(ProcessItem);
+
+    PhAcquireQueuedLockExclusive(&Queue->Lock);
+
+    if (PhpCanGroupProcessQuery(ProcessItem) && (group = PhpFindProcessQueryGroup(Queue, ProcessItem)))
+    {
+        PhAddItemList(group->ProcessItems, ProcessItem);
+    }
+    else
+    {
+        group = PhAllocateZero(sizeof(PH_PROCESS_QUERY_GROUP));
+        group->ProcessItems = PhCreateList(1);
+        PhAddItemList(group->ProcessItems, ProcessItem);
+        InsertTailList(&Queue->NormalPriorityListHead, &group->ListEntry);
+
+        if (PhpCanGroupProcessQuery(ProcessItem))
+        {
+            group->FileName = PhReferenceObject(ProcessItem->FileNameWin32);
+            PhAddEntryHashtable(Queue->GroupHashtable, &group);
+        }
+
+        Queue->NumberOfGroups++;
+    }
+
+    if (Queue->NumberOfWorkers < PH_PROCESS_QUERY_MAXIMUM_WORKERS)
+    {
+        Queue->NumberOfWorkers++;
+        queueWorker = TRUE;
+    }
+
+    PhReleaseQueuedLockExclusive(&Queue->Lock);
+
+    if (queueWorker)
+        PhpQueueProcessQueryWorker(Queue);
+}
+
+VOID PhpQueueProcessQueryStage1(
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    )
+{
+    PhpQueueProcessQuery(&PhpProcessQueryQueues[0], ProcessItem);
+}
+
+VOID PhpQueueProcessQueryStage2(
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    )
+{
+    PhpQueueProcessQuery(&PhpProcessQueryQueues[1], ProcessItem);
+}
+
+/**
+ * Moves the queued queries for a process ahead of the queries for other processes. This should
+ * be called for processes that are visible to the user.
+ *
+ * \param ProcessItem The process item.
+ */
+VOID PhPrioritizeProcessQuery(
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < RTL_NUMBER_OF(PhpProcessQueryQueues); i++)
+    {
+        PPH_PROCESS_QUERY_QUEUE queue = &PhpProcessQueryQueues[i];
+        PPH_PROCESS_QUERY_GROUP group;
+
+        if (queue->NumberOfGroups == 0)
+            continue;
+
+        PhAcquireQueuedLockExclusive(&queue->Lock);
+
+        if ((group = PhpFindProcessQueryGroup(queue, ProcessItem)) && !group->HighPriority)
+        {
+            RemoveEntryList(&group->ListEntry);
+            InsertTailList(&queue->HighPriorityListHead, &group->ListEntry);
+            group->HighPriority = TRUE;
+        }
+
+        PhReleaseQueuedLockExclusive(&queue->Lock);
+    }
+}
+
+VOID PhpFillProcessItemStage1(
+    _In_ PPH_PROCESS_QUERY_S1_DATA Data
+    )
+{
+    PPH_PROCESS_ITEM processItem = Data->Header.ProcessItem;
+
+    processItem->CommandLine = Data->CommandLine;
+    processItem->FileIcon = Data->FileIcon;
+
+    if (processItem->FileIcon)
+    {
+        processItem->SmallIcon = processItem->FileIcon->SmallIcon;
+        processItem->LargeIcon = processItem->FileIcon->LargeIcon;
+    }
+
+    memcpy(&processItem->VersionInfo, &Data->VersionInfo, sizeof(PH_IMAGE_VERSION_INFO));
+    processItem->ConsoleHostProcessId = Data->ConsoleHostProcessId;
+    processItem->PackageFullName = Data->PackageFullName;
+    processItem->IsDotNet = Data->IsDotNet;
+    processItem->IsInJob = Data->IsInJob;
+    processItem->IsInSignificantJob = Data->IsInSignificantJob;
+    processItem->IsBeingDebugged = Data->IsBeingDebugged;
+    processItem->IsImmersive = Data->IsImmersive;
+    processItem->IsProtectedHandle = Data->IsFilteredHandle;
+
+    PhSwapReference(&processItem->Record->CommandLine, processItem->CommandLine);
+
+    // Note: We might have referenced the cached username so don't overwrite the previous data. (dmex)
+    if (!processItem->UserName)
+        processItem->UserName = Data->UserName;
+    else if (Data->UserName)
+        PhDereferenceObject(Data->UserName);
+
+    // Note: Queue stage 2 processing after filling stage1 process data. 
+    if (!(processItem->State & PH_PROCESS_ITEM_REMOVED))
+        PhpQueueProcessQueryStage2(processItem);
+}
+
+VOID PhpFillProcessItemStage2(
+    _In_ PPH_PROCESS_QUERY_S2_DATA Data
+    )
+{
+    PPH_PROCESS_ITEM processItem = Data->Header.ProcessItem;
+
+    processItem->VerifyResult = Data->VerifyResult;
+    processItem->VerifySignerName = Data->VerifySignerName;
+    processItem->IsPacked = Data->IsPacked;
+    processItem->ImportFunctions = Data->ImportFunctions;
+    processItem->ImportModules = Data->ImportModules;
+
+    // Note: We query Win32 processes in stage1 so don't overwrite the previous data. (dmex)
+    if (processItem->IsSubsystemProcess)
+    {
+        memcpy(&processItem->VersionInfo, &Data->VersionInfo, sizeof(PH_IMAGE_VERSION_INFO));
+    }
+}
+
+VOID PhpFillProcessItemExtension(
+    _Inout_ PPH_PROCESS_ITEM ProcessItem,
+    _In_ PSYSTEM_PROCESS_INFORMATION Process
+    )
+{
+    PSYSTEM_PROCESS_INFORMATION_EXTENSION processExtension;
+
+    if (WindowsVersion < WINDOWS_10_RS3 || PhIsExecutingInWow64())
+        return;
+    
+    processExtension = PH_PROCESS_EXTENSION(Process);
+
+    ProcessItem->JobObjectId = processExtension->JobObjectId;
+    ProcessItem->ProcessSequenceNumber = processExtension->ProcessSequenceNumber;
+}
+
+VOID PhpFillProcessItem(
+    _Inout_ PPH_PROCESS_ITEM ProcessItem,
+    _In_ PSYSTEM_PROCESS_INFORMATION Process
+    )
+{
+    ProcessItem->ParentProcessId = Process->InheritedFromUniqueProcessId;
+    ProcessItem->SessionId = Process->SessionId;
+    ProcessItem->CreateTime = Process->CreateTime;
+
+    if (ProcessItem->ProcessId != SYSTEM_IDLE_PROCESS_ID)
+        ProcessItem->ProcessName = PhCreateStringFromUnicodeString(&Process->ImageName);
+    else
         ProcessItem->ProcessName = PhCreateString(SYSTEM_IDLE_PROCESS_NAME);
 
     if (PH_IS_REAL_PROCESS_ID(ProcessItem->ProcessId))
@@ -1359,7 +1922,7 @@ VOID PhpUpdatePerfInformation(
     VOID
     )
 {
-    NtQuerySystemInformation(
+    PhQuerySystemInformation(
         SystemPerformanceInformation,
         &PhPerfInformation,
         sizeof(SYSTEM_PERFORMANCE_INFORMATION),
@@ -1379,7 +1942,7 @@ VOID PhpUpdateCpuInformation(
     ULONG i;
     ULONG64 totalTime;
 
-    NtQuerySystemInformation(
+    PhQuerySystemInformation(
         SystemProcessorPerformanceInformation,
         PhCpuInformation,
         sizeof(SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION) * (ULONG)PhSystemBasicInformation.NumberOfProcessors,
@@ -1459,7 +2022,7 @@ VOID PhpUpdateCpuCycleInformation(
     // We need to query this separately because the idle cycle time in SYSTEM_PROCESS_INFORMATION
     // doesn't give us data for individual processors.
 
-    NtQuerySystemInformation(
+    PhQuerySystemInformation(
         SystemProcessorIdleCycleTimeInformation,
         PhCpuIdleCycleTime,
         sizeof(LARGE_INTEGER) * (ULONG)PhSystemBasicInformation.NumberOfProcessors,
@@ -1479,7 +2042,7 @@ VOID PhpUpdateCpuCycleInformation(
 
     // System
 
-    NtQuerySystemInformation(
+    PhQuerySystemInformation(
         SystemProcessorCycleTimeInformation,
         PhCpuSystemCycleTime,
         sizeof(LARGE_INTEGER) * (ULONG)PhSystemBasicInformation.NumberOfProcessors,
@@ -1593,6 +2156,8 @@ VOID PhpInitializeProcessStatistics(
     {
         PhInitializeCircularBuffer_FLOAT(&PhCpusKernelHistory[i], PhStatisticsSampleCount);
         PhInitializeCircularBuffer_FLOAT(&PhCpusUserHistory[i], PhStatisticsSampleCount);
+        PhInitializeHistoryBuffer(&PhCpusKernelHistoryLevels[i], PhStatisticsSampleCount, PH_CPU_HISTORY_LEVEL_FACTOR, PH_CPU_HISTORY_LEVEL_COUNT);
+        PhInitializeHistoryBuffer(&PhCpusTotalHistoryLevels[i], PhStatisticsSampleCount, PH_CPU_HISTORY_LEVEL_FACTOR, PH_CPU_HISTORY_LEVEL_COUNT);
     }
 }
 
@@ -1613,6 +2178,8 @@ VOID PhpUpdateSystemHistory(
     {
         PhAddItemCircularBuffer_FLOAT(&PhCpusKernelHistory[i], PhCpusKernelUsage[i]);
         PhAddItemCircularBuffer_FLOAT(&PhCpusUserHistory[i], PhCpusUserUsage[i]);
+        PhAddItemHistoryBuffer(&PhCpusKernelHistoryLevels[i], PhCpusKernelUsage[i]);
+        PhAddItemHistoryBuffer(&PhCpusTotalHistoryLevels[i], PhCpusKernelUsage[i] + PhCpusUserUsage[i]);
     }
 
     // I/O
@@ -1779,79 +2346,619 @@ VOID PhpGetProcessThreadInformation(
         *ContextSwitches = contextSwitches;
 }
 
-VOID PhProcessProviderUpdate(
-    _In_ PVOID Object
+VOID PhpUpdateProcessItemStatistics(
+    _Inout_ PPH_PROCESS_STATISTICS_CHUNK Chunk
     )
 {
-    static ULONG runCount = 0;
-    static PSYSTEM_PROCESS_INFORMATION pidBuckets[PROCESS_ID_BUCKETS];
+    ULONG i;
 
-    // Note about locking:
-    //
-    // Since this is the only function that is allowed to modify the process hashtable, locking is
-    // not needed for shared accesses. However, exclusive accesses need locking.
+    for (i = 0; i < Chunk->Count; i++)
+    {
+        PPH_PROCESS_STATISTICS_ENTRY entry = &Chunk->Entries[i];
+        PSYSTEM_PROCESS_INFORMATION process = entry->Process;
+        PPH_PROCESS_ITEM processItem = entry->ProcessItem;
+        BOOLEAN modified = FALSE;
+        BOOLEAN isSuspended;
+        BOOLEAN isPartiallySuspended;
+        ULONG contextSwitches;
+        FLOAT newCpuUsage;
+        FLOAT kernelCpuUsage;
+        FLOAT userCpuUsage;
+
+        PhpGetProcessThreadInformation(process, &isSuspended, &isPartiallySuspended, &contextSwitches);
+        PhpUpdateDynamicInfoProcessItem(processItem, process);
+        PhpFillProcessItemExtension(processItem, process);
+
+        // Update the deltas.
+        PhUpdateDelta(&processItem->CpuKernelDelta, process->KernelTime.QuadPart);
+        PhUpdateDelta(&processItem->CpuUserDelta, process->UserTime.QuadPart);
+        PhUpdateDelta(&processItem->IoReadDelta, process->ReadTransferCount.QuadPart);
+        PhUpdateDelta(&processItem->IoWriteDelta, process->WriteTransferCount.QuadPart);
+        PhUpdateDelta(&processItem->IoOtherDelta, process->OtherTransferCount.QuadPart);
+        PhUpdateDelta(&processItem->IoReadCountDelta, process->ReadOperationCount.QuadPart);
+        PhUpdateDelta(&processItem->IoWriteCountDelta, process->WriteOperationCount.QuadPart);
+        PhUpdateDelta(&processItem->IoOtherCountDelta, process->OtherOperationCount.QuadPart);
+        PhUpdateDelta(&processItem->ContextSwitchesDelta, contextSwitches);
+        PhUpdateDelta(&processItem->PageFaultsDelta, process->PageFaultCount);
+        PhUpdateDelta(&processItem->CycleTimeDelta, process->CycleTime);
+        PhUpdateDelta(&processItem->PrivateBytesDelta, process->PagefileUsage);
+
+        processItem->TimeSequenceNumber++;
+        PhAddItemCircularBuffer_ULONG64(&processItem->IoReadHistory, processItem->IoReadDelta.Delta);
+        PhAddItemCircularBuffer_ULONG64(&processItem->IoWriteHistory, processItem->IoWriteDelta.Delta);
+        PhAddItemCircularBuffer_ULONG64(&processItem->IoOtherHistory, processItem->IoOtherDelta.Delta);
+
+        PhAddItemCircularBuffer_SIZE_T(&processItem->PrivateBytesHistory, processItem->VmCounters.PagefileUsage);
+        //PhAddItemCircularBuffer_SIZE_T(&processItem->WorkingSetHistory, processItem->VmCounters.WorkingSetSize);
+
+        if (InterlockedExchange(&processItem->JustProcessed, 0) != 0)
+            modified = TRUE;
 
-    PVOID processes;
-    PSYSTEM_PROCESS_INFORMATION process;
-    ULONG bucketIndex;
+        if (PhEnableCycleCpuUsage)
+        {
+            FLOAT totalDelta;
 
-    ULONG64 sysTotalTime; // total time for this update period
-    ULONG64 sysTotalCycleTime = 0; // total cycle time for this update period
-    ULONG64 sysIdleCycleTime = 0; // total idle cycle time for this update period
-    FLOAT maxCpuValue = 0;
-    PPH_PROCESS_ITEM maxCpuProcessItem = NULL;
-    ULONG64 maxIoValue = 0;
-    PPH_PROCESS_ITEM maxIoProcessItem = NULL;
+            newCpuUsage = (FLOAT)processItem->CycleTimeDelta.Delta / Chunk->SysTotalCycleTime;
 
-    // Pre-update tasks
+            // Calculate the kernel/user CPU usage based on the kernel/user time. If the kernel
+            // and user deltas are both zero, we'll just have to use an estimate. Currently, we
+            // split the CPU usage evenly across the kernel and user components, except when the
+            // total user time is zero, in which case we assign it all to the kernel component.
 
-    if (runCount % 512 == 0) // yes, a very long time
-    {
-        if (PhEnablePurgeProcessRecords)
-            PhPurgeProcessRecords();
+            totalDelta = (FLOAT)(processItem->CpuKernelDelta.Delta + processItem->CpuUserDelta.Delta);
 
-        PhpFlushSidFullNameCache();
+            if (totalDelta != 0)
+            {
+                kernelCpuUsage = newCpuUsage * ((FLOAT)processItem->CpuKernelDelta.Delta / totalDelta);
+                userCpuUsage = newCpuUsage * ((FLOAT)processItem->CpuUserDelta.Delta / totalDelta);
+            }
+            else
+            {
+                if (processItem->UserTime.QuadPart != 0)
+                {
+                    kernelCpuUsage = newCpuUsage / 2;
+                    userCpuUsage = newCpuUsage / 2;
+                }
+                else
+                {
+                    kernelCpuUsage = newCpuUsage;
+                    userCpuUsage = 0;
+                }
+            }
+        }
+        else
+        {
+            kernelCpuUsage = (FLOAT)processItem->CpuKernelDelta.Delta / Chunk->SysTotalTime;
+            userCpuUsage = (FLOAT)processItem->CpuUserDelta.Delta / Chunk->SysTotalTime;
+            newCpuUsage = kernelCpuUsage + userCpuUsage;
+        }
 
-        PhFlushImageVersionInfoCache();
-    }
+        processItem->CpuUsage = newCpuUsage;
+        processItem->CpuKernelUsage = kernelCpuUsage;
+        processItem->CpuUserUsage = userCpuUsage;
 
-    if (!PhProcessStatisticsInitialized)
-    {
-        PhpInitializeProcessStatistics();
-        PhProcessStatisticsInitialized = TRUE;
+        PhAddItemCircularBuffer_FLOAT(&processItem->CpuKernelHistory, kernelCpuUsage);
+        PhAddItemCircularBuffer_FLOAT(&processItem->CpuUserHistory, userCpuUsage);
+
+        // Max. values
+
+        if (processItem->ProcessId)
+        {
+            if (Chunk->MaxCpuValue < newCpuUsage)
+            {
+                Chunk->MaxCpuValue = newCpuUsage;
+                Chunk->MaxCpuProcessItem = processItem;
+            }
+
+            // I/O for Other is not included because it is too generic.
+            if (Chunk->MaxIoValue < processItem->IoReadDelta.Delta + processItem->IoWriteDelta.Delta)
+            {
+                Chunk->MaxIoValue = processItem->IoReadDelta.Delta + processItem->IoWriteDelta.Delta;
+                Chunk->MaxIoProcessItem = processItem;
+            }
+        }
+
+        // Suspended
+        if (processItem->IsSuspended != isSuspended)
+        {
+            processItem->IsSuspended = isSuspended;
+            modified = TRUE;
+        }
+
+        processItem->IsPartiallySuspended = isPartiallySuspended;
+
+        entry->Modified = modified;
     }
+}
 
-    PhpUpdatePerfInformation();
+NTSTATUS PhpProcessStatisticsWorker(
+    _In_ PVOID Parameter
+    )
+{
+    PhpUpdateProcessItemStatistics(Parameter);
 
-    if (PhEnableCycleCpuUsage)
+    // Don't touch the chunk after this; it is on the stack of the provider thread.
+    if (_InterlockedDecrement(&PhpProcessStatisticsPendingChunks) == 0)
+        NtSetEvent(PhpProcessStatisticsEventHandle, NULL);
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * Updates the deltas, usage and history of existing processes.
+ *
+ * \param Entries The process entries and their items, in the order of the process list.
+ * \param Count The number of entries.
+ * \param SysTotalTime The total CPU time for this update period.
+ * \param SysTotalCycleTime The total cycle time for this update period.
+ * \param MaxCpuProcessItem A variable which receives the process with the highest CPU usage, or
+ * NULL.
+ * \param MaxIoProcessItem A variable which receives the process with the highest I/O usage, or
+ * NULL.
+ *
+ * \remarks If several processes have the same maximum usage, the first one in \a Entries is
+ * returned, as if the entries had been updated one after the other.
+ */
+VOID PhpUpdateProcessStatistics(
+    _Inout_updates_(Count) PPH_PROCESS_STATISTICS_ENTRY Entries,
+    _In_ ULONG Count,
+    _In_ ULONG64 SysTotalTime,
+    _In_ ULONG64 SysTotalCycleTime,
+    _Out_ PPH_PROCESS_ITEM *MaxCpuProcessItem,
+    _Out_ PPH_PROCESS_ITEM *MaxIoProcessItem
+    )
+{
+    PH_PROCESS_STATISTICS_CHUNK chunks[PH_PROCESS_STATISTICS_MAXIMUM_CHUNKS];
+    ULONG numberOfChunks = 1;
+    ULONG i;
+    FLOAT maxCpuValue = 0;
+    PPH_PROCESS_ITEM maxCpuProcessItem = NULL;
+    ULONG64 maxIoValue = 0;
+    PPH_PROCESS_ITEM maxIoProcessItem = NULL;
+
+    if (PhpProcessStatisticsEventHandle)
     {
-        PhpUpdateCpuInformation(FALSE, &sysTotalTime);
-        PhpUpdateCpuCycleInformation(&sysIdleCycleTime);
+        numberOfChunks = Count / PH_PROCESS_STATISTICS_MINIMUM_CHUNK_SIZE;
+
+        if (numberOfChunks > (ULONG)PhSystemBasicInformation.NumberOfProcessors)
+            numberOfChunks = (ULONG)PhSystemBasicInformation.NumberOfProcessors;
+        if (numberOfChunks > PH_PROCESS_STATISTICS_MAXIMUM_CHUNKS)
+            numberOfChunks = PH_PROCESS_STATISTICS_MAXIMUM_CHUNKS;
+        if (numberOfChunks == 0)
+            numberOfChunks = 1;
     }
-    else
+
+    for (i = 0; i < numberOfChunks; i++)
     {
-        PhpUpdateCpuInformation(TRUE, &sysTotalTime);
+        ULONG start = (ULONG)((ULONG64)Count * i / numberOfChunks);
+        ULONG end = (ULONG)((ULONG64)Count * (i + 1) / numberOfChunks);
+
+        chunks[i].Entries = &Entries[start];
+        chunks[i].Count = end - start;
+        chunks[i].SysTotalTime = SysTotalTime;
+        chunks[i].SysTotalCycleTime = SysTotalCycleTime;
+        chunks[i].MaxCpuValue = 0;
+        chunks[i].MaxCpuProcessItem = NULL;
+        chunks[i].MaxIoValue = 0;
+        chunks[i].MaxIoProcessItem = NULL;
     }
 
-    if (runCount != 0)
+    if (numberOfChunks > 1)
     {
-        PhTimeSequenceNumber++;
+        PhpProcessStatisticsPendingChunks = numberOfChunks - 1;
+
+        for (i = 1; i < numberOfChunks; i++)
+            PhQueueItemWorkQueue(&PhpProcessStatisticsWorkQueue, PhpProcessStatisticsWorker, &chunks[i]);
     }
 
-    // Get the process list.
+    PhpUpdateProcessItemStatistics(&chunks[0]);
 
-    PhTotalProcesses = 0;
-    PhTotalThreads = 0;
-    PhTotalHandles = 0;
+    if (numberOfChunks > 1)
+        NtWaitForSingleObject(PhpProcessStatisticsEventHandle, FALSE, NULL);
 
-    if (!NT_SUCCESS(PhEnumProcesses(&processes)))
-        return;
+    // Max. values
 
-    // Notes on cycle-based CPU usage:
-    //
-    // Cycle-based CPU usage is a bit tricky to calculate because we cannot get the total number of
-    // cycles consumed by all processes since system startup - we can only get total number of
-    // cycles per process. This means there are two ways to calculate the system-wide cycle time
+    for (i = 0; i < numberOfChunks; i++)
+    {
+        if (maxCpuValue < chunks[i].MaxCpuValue)
+        {
+            maxCpuValue = chunks[i].MaxCpuValue;
+            maxCpuProcessItem = chunks[i].MaxCpuProcessItem;
+        }
+
+        if (maxIoValue < chunks[i].MaxIoValue)
+        {
+            maxIoValue = chunks[i].MaxIoValue;
+            maxIoProcessItem = chunks[i].MaxIoProcessItem;
+        }
+    }
+
+    *MaxCpuProcessItem = maxCpuProcessItem;
+    *MaxIoProcessItem = maxIoProcessItem;
+}
+
+PPH_PROCESS_ITEM PhpAddNewProcessItem(
+    _In_ PSYSTEM_PROCESS_INFORMATION Process,
+    _In_ BOOLEAN QueryNow
+    )
+{
+    PPH_PROCESS_ITEM processItem;
+    PPH_PROCESS_RECORD processRecord;
+    BOOLEAN isSuspended;
+    BOOLEAN isPartiallySuspended;
+    ULONG contextSwitches;
+
+    // Create the process item and fill in basic information.
+    processItem = PhCreateProcessItem(Process->UniqueProcessId);
+    PhpFillProcessItem(processItem, Process);
+    PhpFillProcessItemExtension(processItem, Process);
+    processItem->TimeSequenceNumber = PhTimeSequenceNumber;
+
+    processRecord = PhpCreateProcessRecord(processItem);
+    PhpAddProcessRecord(processRecord);
+    processItem->Record = processRecord;
+
+    PhpGetProcessThreadInformation(Process, &isSuspended, &isPartiallySuspended, &contextSwitches);
+    PhpUpdateDynamicInfoProcessItem(processItem, Process);
+
+    // Initialize the deltas.
+    PhUpdateDelta(&processItem->CpuKernelDelta, Process->KernelTime.QuadPart);
+    PhUpdateDelta(&processItem->CpuUserDelta, Process->UserTime.QuadPart);
+    PhUpdateDelta(&processItem->IoReadDelta, Process->ReadTransferCount.QuadPart);
+    PhUpdateDelta(&processItem->IoWriteDelta, Process->WriteTransferCount.QuadPart);
+    PhUpdateDelta(&processItem->IoOtherDelta, Process->OtherTransferCount.QuadPart);
+    PhUpdateDelta(&processItem->IoReadCountDelta, Process->ReadOperationCount.QuadPart);
+    PhUpdateDelta(&processItem->IoWriteCountDelta, Process->WriteOperationCount.QuadPart);
+    PhUpdateDelta(&processItem->IoOtherCountDelta, Process->OtherOperationCount.QuadPart);
+    PhUpdateDelta(&processItem->ContextSwitchesDelta, contextSwitches);
+    PhUpdateDelta(&processItem->PageFaultsDelta, Process->PageFaultCount);
+    PhUpdateDelta(&processItem->CycleTimeDelta, Process->CycleTime);
+    PhUpdateDelta(&processItem->PrivateBytesDelta, Process->PagefileUsage);
+
+    processItem->IsSuspended = isSuspended;
+    processItem->IsPartiallySuspended = isPartiallySuspended;
+
+    if (QueryNow)
+    {
+        PH_PROCESS_QUERY_S1_DATA data;
+
+        memset(&data, 0, sizeof(PH_PROCESS_QUERY_S1_DATA));
+        data.Header.Stage = 1;
+        data.Header.ProcessItem = processItem;
+        PhpProcessQueryStage1ImageCached(&data);
+        PhpProcessQueryStage1(&data);
+        PhpFillProcessItemStage1(&data);
+        PhSetEvent(&processItem->Stage1Event);
+    }
+    else
+    {
+        PhpQueueProcessQueryStage1(processItem);
+    }
+
+    // Add pending service items to the process item.
+    PhUpdateProcessItemServices(processItem);
+
+    // Add the process item to the hashtable.
+    PhAcquireQueuedLockExclusive(&PhProcessHashSetLock);
+    PhpAddProcessItem(processItem);
+    PhReleaseQueuedLockExclusive(&PhProcessHashSetLock);
+
+    // Raise the process added event.
+    PhInvokeCallback(PhGetGeneralCallback(GeneralCallbackProcessProviderAddedEvent), processItem);
+
+    // (Ref: for the process item being in the hashtable.)
+    // Instead of referencing then dereferencing we simply don't do anything.
+    // Dereferenced in PhpRemoveProcessItem.
+
+    return processItem;
+}
+
+VOID PhpMarkProcessItemRemoved(
+    _In_ PPH_PROCESS_ITEM ProcessItem,
+    _Inout_ PULONG64 TotalCycleTime
+    )
+{
+    LARGE_INTEGER exitTime;
+
+    ProcessItem->State |= PH_PROCESS_ITEM_REMOVED;
+    exitTime.QuadPart = 0;
+
+    if (ProcessItem->QueryHandle)
+    {
+        KERNEL_USER_TIMES times;
+        ULONG64 finalCycleTime;
+
+        if (NT_SUCCESS(PhGetProcessTimes(ProcessItem->QueryHandle, &times)))
+        {
+            exitTime = times.ExitTime;
+        }
+
+        if (PhEnableCycleCpuUsage)
+        {
+            if (NT_SUCCESS(PhGetProcessCycleTime(ProcessItem->QueryHandle, &finalCycleTime)))
+            {
+                // Adjust deltas for the terminated process because this doesn't get
+                // picked up anywhere else.
+                //
+                // Note that if we don't have sufficient access to the process, the
+                // worst that will happen is that the CPU usages of other processes
+                // will get inflated. (See PhProcessProviderUpdate; if we were using the first
+                // technique, we could get negative deltas, which is much worse.)
+                *TotalCycleTime += finalCycleTime - ProcessItem->CycleTimeDelta.Value;
+            }
+        }
+    }
+
+    // If we don't have a valid exit time, use the current time.
+    if (exitTime.QuadPart == 0)
+        PhQuerySystemTime(&exitTime);
+
+    ProcessItem->Record->Flags |= PH_PROCESS_RECORD_DEAD;
+    ProcessItem->Record->ExitTime = exitTime;
+    PhpRetainProcessRecord(ProcessItem->Record);
+
+    // Raise the process removed event.
+    PhInvokeCallback(PhGetGeneralCallback(GeneralCallbackProcessProviderRemovedEvent), ProcessItem);
+}
+
+PPH_PROCESS_ITEM PhpAddProcessItemForEvent(
+    _In_ PPH_PROCESS_PROVIDER_EVENT Event,
+    _In_ BOOLEAN Exited
+    )
+{
+    HANDLE processHandle;
+    PSYSTEM_PROCESS_INFORMATION process;
+    PPH_STRING fileName;
+    PPH_STRING processName = NULL;
+    PPH_PROCESS_ITEM processItem = NULL;
+
+    // The next full update has to recognize the process item, so the process is identified in
+    // the same way as in the process list. If the process can't be opened, we leave it to the
+    // full update, unless the process has already exited.
+    if (!NT_SUCCESS(PhOpenProcess(&processHandle, PROCESS_QUERY_LIMITED_INFORMATION, Event->ProcessId)))
+        processHandle = NULL;
+
+    if (!processHandle && !Exited)
+        return NULL;
+
+    // The image name in the event is truncated, so we prefer the name of the image file.
+    if (NT_SUCCESS(PhGetProcessImageFileNameByProcessId(Event->ProcessId, &fileName)))
+    {
+        processName = PhGetBaseName(fileName);
+        PhDereferenceObject(fileName);
+    }
+    else if (Event->ImageName)
+    {
+        processName = PhReferenceObject(Event->ImageName);
+    }
+
+    if (processName)
+    {
+        process = PhAllocateZero(sizeof(SYSTEM_PROCESS_INFORMATION) + sizeof(SYSTEM_PROCESS_INFORMATION_EXTENSION));
+        process->NumberOfThreads = 1; // PhpFillProcessItem closes the handle of processes without threads
+        process->UniqueProcessId = Event->ProcessId;
+        process->InheritedFromUniqueProcessId = Event->ParentProcessId;
+        process->SessionId = Event->SessionId;
+        process->CreateTime = Event->Time;
+        PhStringRefToUnicodeString(&processName->sr, &process->ImageName);
+
+        if (processHandle)
+        {
+            KERNEL_USER_TIMES times;
+
+            if (NT_SUCCESS(PhGetProcessTimes(processHandle, &times)))
+                process->CreateTime = times.CreateTime;
+
+            if (WindowsVersion >= WINDOWS_10_RS3 && !PhIsExecutingInWow64())
+                PhGetProcessSequenceNumber(processHandle, &PH_PROCESS_EXTENSION(process)->ProcessSequenceNumber);
+        }
+
+        // The counters are updated by the next full update.
+        processItem = PhpAddNewProcessItem(process, TRUE);
+
+        PhFree(process);
+        PhDereferenceObject(processName);
+    }
+
+    if (processHandle)
+        NtClose(processHandle);
+
+    return processItem;
+}
+
+BOOLEAN PhpFlushProcessProviderEvents(
+    _In_ BOOLEAN Apply
+    )
+{
+    PSLIST_ENTRY entry;
+    PSLIST_ENTRY listEntry;
+    PPH_PROCESS_PROVIDER_EVENT *events;
+    ULONG count;
+    ULONG i;
+    ULONG j;
+    BOOLEAN changed = FALSE;
+
+    if (!RtlFirstEntrySList(&PhpProcessProviderEventListHead))
+        return FALSE;
+
+    entry = RtlInterlockedFlushSList(&PhpProcessProviderEventListHead);
+
+    // The events were pushed onto the list, so put them back in order.
+
+    count = 0;
+
+    for (listEntry = entry; listEntry; listEntry = listEntry->Next)
+        count++;
+
+    _InterlockedExchangeAdd(&PhpProcessProviderEventCount, -(LONG)count);
+    events = PhAllocate(sizeof(PPH_PROCESS_PROVIDER_EVENT) * count);
+
+    for (i = count; entry; entry = entry->Next)
+        events[--i] = CONTAINING_RECORD(entry, PH_PROCESS_PROVIDER_EVENT, ListEntry);
+
+    for (i = 0; Apply && i < count; i++)
+    {
+        PPH_PROCESS_PROVIDER_EVENT event = events[i];
+        PPH_PROCESS_ITEM processItem;
+
+        if (event->Handled)
+            continue;
+
+        if (event->Type == ProcessProviderStartedEvent)
+        {
+            PPH_PROCESS_PROVIDER_EVENT exitEvent = NULL;
+
+            // The process may have been found by a full update already.
+            if (PhpLookupProcessItem(event->ProcessId))
+                continue;
+
+            // Processes which exit before the events are applied are added and removed, so that
+            // they appear in the process records and notifications.
+            for (j = i + 1; j < count; j++)
+            {
+                if (events[j]->Type == ProcessProviderExitedEvent && events[j]->ProcessId == event->ProcessId)
+                {
+                    exitEvent = events[j];
+                    exitEvent->Handled = TRUE;
+                    break;
+                }
+            }
+
+            if (!(processItem = PhpAddProcessItemForEvent(event, !!exitEvent)))
+                continue;
+
+            changed = TRUE;
+
+            if (!exitEvent)
+                continue;
+        }
+        else
+        {
+            KERNEL_USER_TIMES times;
+
+            // Without a handle we can't tell whether the process item belongs to a newer process
+            // with the same ID, so we leave it to the full update.
+            if (!(processItem = PhpLookupProcessItem(event->ProcessId)) ||
+                !processItem->QueryHandle ||
+                !NT_SUCCESS(PhGetProcessTimes(processItem->QueryHandle, &times)) ||
+                times.ExitTime.QuadPart == 0)
+            {
+                continue;
+            }
+        }
+
+        // The final cycle time of the process is added to the next full update.
+        PhpMarkProcessItemRemoved(processItem, &PhpExitedProcessCycleTime);
+        changed = TRUE;
+
+        PhAcquireQueuedLockExclusive(&PhProcessHashSetLock);
+        PhpRemoveProcessItem(processItem);
+        PhReleaseQueuedLockExclusive(&PhProcessHashSetLock);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (events[i]->ImageName)
+            PhDereferenceObject(events[i]->ImageName);
+
+        PhFree(events[i]);
+    }
+
+    PhFree(events);
+
+    return changed;
+}
+
+VOID PhProcessProviderUpdate(
+    _In_ PVOID Object
+    )
+{
+    static ULONG runCount = 0;
+    static PSYSTEM_PROCESS_INFORMATION pidBuckets[PROCESS_ID_BUCKETS];
+
+    // Note about locking:
+    //
+    // Since this is the only function that is allowed to modify the process hashtable, locking is
+    // not needed for shared accesses. However, exclusive accesses need locking.
+
+    PVOID processes;
+    PSYSTEM_PROCESS_INFORMATION process;
+    ULONG bucketIndex;
+    ULONG numberOfStatisticsEntries;
+    ULONG i;
+
+    ULONG64 sysTotalTime; // total time for this update period
+    ULONG64 sysTotalCycleTime = 0; // total cycle time for this update period
+    ULONG64 sysIdleCycleTime = 0; // total idle cycle time for this update period
+    PPH_PROCESS_ITEM maxCpuProcessItem;
+    PPH_PROCESS_ITEM maxIoProcessItem;
+
+    // Pre-update tasks
+
+    if (PhEnablePurgeProcessRecords)
+        PhPurgeProcessRecords();
+
+    if (runCount % 512 == 0) // yes, a very long time
+    {
+        PhpFlushSidFullNameCache();
+
+        PhFlushImageVersionInfoCache();
+    }
+
+    if (!PhProcessStatisticsInitialized)
+    {
+        PhpInitializeProcessStatistics();
+        PhProcessStatisticsInitialized = TRUE;
+    }
+
+    // Apply the queued process events. The events queued before the first run describe processes
+    // that are about to be enumerated.
+    PhpFlushProcessProviderEvents(runCount != 0);
+
+    // The system information queried below is recorded or replayed if there is a trace. This
+    // doesn't apply to information queried from each process.
+    if (PhProcessProviderTrace)
+        PhBeginSystemTraceTick(PhProcessProviderTrace);
+
+    PhpUpdatePerfInformation();
+
+    if (PhEnableCycleCpuUsage)
+    {
+        PhpUpdateCpuInformation(FALSE, &sysTotalTime);
+        PhpUpdateCpuCycleInformation(&sysIdleCycleTime);
+    }
+    else
+    {
+        PhpUpdateCpuInformation(TRUE, &sysTotalTime);
+    }
+
+    if (runCount != 0)
+    {
+        PhTimeSequenceNumber++;
+    }
+
+    // Get the process list.
+
+    PhTotalProcesses = 0;
+    PhTotalThreads = 0;
+    PhTotalHandles = 0;
+
+    if (!NT_SUCCESS(PhEnumProcesses(&processes)))
+    {
+        if (PhProcessProviderTrace)
+            PhEndSystemTraceTick(PhProcessProviderTrace);
+
+        return;
+    }
+
+    if (PhProcessProviderTrace)
+        PhEndSystemTraceTick(PhProcessProviderTrace);
+
+    // Notes on cycle-based CPU usage:
+    //
+    // Cycle-based CPU usage is a bit tricky to calculate because we cannot get the total number of
+    // cycles consumed by all processes since system startup - we can only get total number of
+    // cycles per process. This means there are two ways to calculate the system-wide cycle time
     // delta:
     //
     // 1. Each update, sum the cycle times of all processes, and calculate the system-wide delta
@@ -1913,6 +3020,10 @@ VOID PhProcessProviderUpdate(
         }
     } while (process = PH_NEXT_PROCESS(process));
 
+    // Add the cycle time of the processes that were removed by process events.
+    sysTotalCycleTime += PhpExitedProcessCycleTime;
+    PhpExitedProcessCycleTime = 0;
+
     // Add the fake processes to the PID list.
     //
     // On Windows 7 the two fake processes are merged into "Interrupts" since we can only get cycle
@@ -1933,7 +3044,6 @@ VOID PhProcessProviderUpdate(
     // Look for dead processes.
     {
         PPH_LIST processesToRemove = NULL;
-        ULONG i;
         PPH_HASH_ENTRY entry;
         PPH_PROCESS_ITEM processItem;
         PSYSTEM_PROCESS_INFORMATION processEntry;
@@ -1978,46 +3088,7 @@ VOID PhProcessProviderUpdate(
 
                 if (processRemoved)
                 {
-                    LARGE_INTEGER exitTime;
-
-                    processItem->State |= PH_PROCESS_ITEM_REMOVED;
-                    exitTime.QuadPart = 0;
-
-                    if (processItem->QueryHandle)
-                    {
-                        KERNEL_USER_TIMES times;
-                        ULONG64 finalCycleTime;
-
-                        if (NT_SUCCESS(PhGetProcessTimes(processItem->QueryHandle, &times)))
-                        {
-                            exitTime = times.ExitTime;
-                        }
-
-                        if (PhEnableCycleCpuUsage)
-                        {
-                            if (NT_SUCCESS(PhGetProcessCycleTime(processItem->QueryHandle, &finalCycleTime)))
-                            {
-                                // Adjust deltas for the terminated process because this doesn't get
-                                // picked up anywhere else.
-                                //
-                                // Note that if we don't have sufficient access to the process, the
-                                // worst that will happen is that the CPU usages of other processes
-                                // will get inflated. (See above; if we were using the first
-                                // technique, we could get negative deltas, which is much worse.)
-                                sysTotalCycleTime += finalCycleTime - processItem->CycleTimeDelta.Value;
-                            }
-                        }
-                    }
-
-                    // If we don't have a valid exit time, use the current time.
-                    if (exitTime.QuadPart == 0)
-                        PhQuerySystemTime(&exitTime);
-
-                    processItem->Record->Flags |= PH_PROCESS_RECORD_DEAD;
-                    processItem->Record->ExitTime = exitTime;
-
-                    // Raise the process removed event.
-                    PhInvokeCallback(PhGetGeneralCallback(GeneralCallbackProcessProviderRemovedEvent), processItem);
+                    PhpMarkProcessItemRemoved(processItem, &sysTotalCycleTime);
 
                     if (!processesToRemove)
                         processesToRemove = PhCreateList(2);
@@ -2052,7 +3123,19 @@ VOID PhProcessProviderUpdate(
 
     PhCpuTotalCycleDelta = sysTotalCycleTime;
 
-    // Look for new processes and update existing ones.
+    // Make room for the existing processes and the fake processes.
+    if (PhpProcessStatisticsEntriesAllocated < PhTotalProcesses + 2)
+    {
+        if (PhpProcessStatisticsEntries)
+            PhFree(PhpProcessStatisticsEntries);
+
+        PhpProcessStatisticsEntriesAllocated = PhTotalProcesses + 2 + 64;
+        PhpProcessStatisticsEntries = PhAllocate(sizeof(PH_PROCESS_STATISTICS_ENTRY) * PhpProcessStatisticsEntriesAllocated);
+    }
+
+    numberOfStatisticsEntries = 0;
+
+    // Look for new processes. Existing processes are updated below.
     process = PH_FIRST_PROCESS(processes);
 
     while (process)
@@ -2063,417 +3146,271 @@ VOID PhProcessProviderUpdate(
 
         if (!processItem)
         {
-            PPH_PROCESS_RECORD processRecord;
-            BOOLEAN isSuspended;
-            BOOLEAN isPartiallySuspended;
-            ULONG contextSwitches;
-
-            // Create the process item and fill in basic information.
-            processItem = PhCreateProcessItem(process->UniqueProcessId);
-            PhpFillProcessItem(processItem, process);
-            PhpFillProcessItemExtension(processItem, process);
-            processItem->TimeSequenceNumber = PhTimeSequenceNumber;
-
-            processRecord = PhpCreateProcessRecord(processItem);
-            PhpAddProcessRecord(processRecord);
-            processItem->Record = processRecord;
-
-            PhpGetProcessThreadInformation(process, &isSuspended, &isPartiallySuspended, &contextSwitches);
-            PhpUpdateDynamicInfoProcessItem(processItem, process);
-
-            // Initialize the deltas.
-            PhUpdateDelta(&processItem->CpuKernelDelta, process->KernelTime.QuadPart);
-            PhUpdateDelta(&processItem->CpuUserDelta, process->UserTime.QuadPart);
-            PhUpdateDelta(&processItem->IoReadDelta, process->ReadTransferCount.QuadPart);
-            PhUpdateDelta(&processItem->IoWriteDelta, process->WriteTransferCount.QuadPart);
-            PhUpdateDelta(&processItem->IoOtherDelta, process->OtherTransferCount.QuadPart);
-            PhUpdateDelta(&processItem->IoReadCountDelta, process->ReadOperationCount.QuadPart);
-            PhUpdateDelta(&processItem->IoWriteCountDelta, process->WriteOperationCount.QuadPart);
-            PhUpdateDelta(&processItem->IoOtherCountDelta, process->OtherOperationCount.QuadPart);
-            PhUpdateDelta(&processItem->ContextSwitchesDelta, contextSwitches);
-            PhUpdateDelta(&processItem->PageFaultsDelta, process->PageFaultCount);
-            PhUpdateDelta(&processItem->CycleTimeDelta, process->CycleTime);
-            PhUpdateDelta(&processItem->PrivateBytesDelta, process->PagefileUsage);
-
-            processItem->IsSuspended = isSuspended;
-            processItem->IsPartiallySuspended = isPartiallySuspended;
-
             // If this is the first run of the provider, queue the
             // process query tasks. Otherwise, perform stage 1
             // processing now and queue stage 2 processing.
-            if (runCount > 0)
-            {
-                PH_PROCESS_QUERY_S1_DATA data;
-
-                memset(&data, 0, sizeof(PH_PROCESS_QUERY_S1_DATA));
-                data.Header.Stage = 1;
-                data.Header.ProcessItem = processItem;
-                PhpProcessQueryStage1(&data);
-                PhpFillProcessItemStage1(&data);
-                PhSetEvent(&processItem->Stage1Event);
-            }
-            else
-            {
-                PhpQueueProcessQueryStage1(processItem);
-            }
-
-            // Add pending service items to the process item.
-            PhUpdateProcessItemServices(processItem);
+            PhpAddNewProcessItem(process, runCount > 0);
+        }
+        else
+        {
+            PPH_PROCESS_STATISTICS_ENTRY entry;
 
-            // Add the process item to the hashtable.
-            PhAcquireQueuedLockExclusive(&PhProcessHashSetLock);
-            PhpAddProcessItem(processItem);
-            PhReleaseQueuedLockExclusive(&PhProcessHashSetLock);
+            // The statistics are updated after all new processes have been added.
+            entry = &PhpProcessStatisticsEntries[numberOfStatisticsEntries++];
+            entry->Process = process;
+            entry->ProcessItem = processItem;
+            entry->Modified = FALSE;
 
-            // Raise the process added event.
-            PhInvokeCallback(PhGetGeneralCallback(GeneralCallbackProcessProviderAddedEvent), processItem);
+            // No reference added by PhpLookupProcessItem.
+        }
 
-            // (Ref: for the process item being in the hashtable.)
-            // Instead of referencing then dereferencing we simply don't do anything.
-            // Dereferenced in PhpRemoveProcessItem.
+        // Trick ourselves into thinking that the fake processes
+        // are on the list.
+        if (process == PhInterruptsProcessInformation)
+        {
+            process = NULL;
+        }
+        else if (process == PhDpcsProcessInformation)
+        {
+            process = PhInterruptsProcessInformation;
         }
         else
         {
-            BOOLEAN modified = FALSE;
-            BOOLEAN isSuspended;
-            BOOLEAN isPartiallySuspended;
-            ULONG contextSwitches;
-            FLOAT newCpuUsage;
-            FLOAT kernelCpuUsage;
-            FLOAT userCpuUsage;
-
-            PhpGetProcessThreadInformation(process, &isSuspended, &isPartiallySuspended, &contextSwitches);
-            PhpUpdateDynamicInfoProcessItem(processItem, process);
-            PhpFillProcessItemExtension(processItem, process);
-
-            // Update the deltas.
-            PhUpdateDelta(&processItem->CpuKernelDelta, process->KernelTime.QuadPart);
-            PhUpdateDelta(&processItem->CpuUserDelta, process->UserTime.QuadPart);
-            PhUpdateDelta(&processItem->IoReadDelta, process->ReadTransferCount.QuadPart);
-            PhUpdateDelta(&processItem->IoWriteDelta, process->WriteTransferCount.QuadPart);
-            PhUpdateDelta(&processItem->IoOtherDelta, process->OtherTransferCount.QuadPart);
-            PhUpdateDelta(&processItem->IoReadCountDelta, process->ReadOperationCount.QuadPart);
-            PhUpdateDelta(&processItem->IoWriteCountDelta, process->WriteOperationCount.QuadPart);
-            PhUpdateDelta(&processItem->IoOtherCountDelta, process->OtherOperationCount.QuadPart);
-            PhUpdateDelta(&processItem->ContextSwitchesDelta, contextSwitches);
-            PhUpdateDelta(&processItem->PageFaultsDelta, process->PageFaultCount);
-            PhUpdateDelta(&processItem->CycleTimeDelta, process->CycleTime);
-            PhUpdateDelta(&processItem->PrivateBytesDelta, process->PagefileUsage);
-
-            processItem->TimeSequenceNumber++;
-            PhAddItemCircularBuffer_ULONG64(&processItem->IoReadHistory, processItem->IoReadDelta.Delta);
-            PhAddItemCircularBuffer_ULONG64(&processItem->IoWriteHistory, processItem->IoWriteDelta.Delta);
-            PhAddItemCircularBuffer_ULONG64(&processItem->IoOtherHistory, processItem->IoOtherDelta.Delta);
-
-            PhAddItemCircularBuffer_SIZE_T(&processItem->PrivateBytesHistory, processItem->VmCounters.PagefileUsage);
-            //PhAddItemCircularBuffer_SIZE_T(&processItem->WorkingSetHistory, processItem->VmCounters.WorkingSetSize);
-
-            if (InterlockedExchange(&processItem->JustProcessed, 0) != 0)
-                modified = TRUE;
+            process = PH_NEXT_PROCESS(process);
 
-            if (PhEnableCycleCpuUsage)
+            if (process == NULL)
             {
-                FLOAT totalDelta;
-
-                newCpuUsage = (FLOAT)processItem->CycleTimeDelta.Delta / sysTotalCycleTime;
-
-                // Calculate the kernel/user CPU usage based on the kernel/user time. If the kernel
-                // and user deltas are both zero, we'll just have to use an estimate. Currently, we
-                // split the CPU usage evenly across the kernel and user components, except when the
-                // total user time is zero, in which case we assign it all to the kernel component.
-
-                totalDelta = (FLOAT)(processItem->CpuKernelDelta.Delta + processItem->CpuUserDelta.Delta);
-
-                if (totalDelta != 0)
-                {
-                    kernelCpuUsage = newCpuUsage * ((FLOAT)processItem->CpuKernelDelta.Delta / totalDelta);
-                    userCpuUsage = newCpuUsage * ((FLOAT)processItem->CpuUserDelta.Delta / totalDelta);
-                }
+                if (PhEnableCycleCpuUsage)
+                    process = PhInterruptsProcessInformation;
                 else
-                {
-                    if (processItem->UserTime.QuadPart != 0)
-                    {
-                        kernelCpuUsage = newCpuUsage / 2;
-                        userCpuUsage = newCpuUsage / 2;
-                    }
-                    else
-                    {
-                        kernelCpuUsage = newCpuUsage;
-                        userCpuUsage = 0;
-                    }
-                }
-            }
-            else
-            {
-                kernelCpuUsage = (FLOAT)processItem->CpuKernelDelta.Delta / sysTotalTime;
-                userCpuUsage = (FLOAT)processItem->CpuUserDelta.Delta / sysTotalTime;
-                newCpuUsage = kernelCpuUsage + userCpuUsage;
+                    process = PhDpcsProcessInformation;
             }
+        }
+    }
 
-            processItem->CpuUsage = newCpuUsage;
-            processItem->CpuKernelUsage = kernelCpuUsage;
-            processItem->CpuUserUsage = userCpuUsage;
-
-            PhAddItemCircularBuffer_FLOAT(&processItem->CpuKernelHistory, kernelCpuUsage);
-            PhAddItemCircularBuffer_FLOAT(&processItem->CpuUserHistory, userCpuUsage);
-
-            // Max. values
+    PhpFlushProcessQueryImageCache();
+
+    // Update the deltas and history of existing processes, which can be done in parallel. The rest
+    // of their information is queried on this thread because the token information uses the SID
+    // name cache, and the modified events are raised on this thread as well.
+    PhpUpdateProcessStatistics(
+        PhpProcessStatisticsEntries,
+        numberOfStatisticsEntries,
+        sysTotalTime,
+        sysTotalCycleTime,
+        &maxCpuProcessItem,
+        &maxIoProcessItem
+        );
 
-            if (processItem->ProcessId)
-            {
-                if (maxCpuValue < newCpuUsage)
-                {
-                    maxCpuValue = newCpuUsage;
-                    maxCpuProcessItem = processItem;
-                }
+    for (i = 0; i < numberOfStatisticsEntries; i++)
+    {
+        PPH_PROCESS_ITEM processItem = PhpProcessStatisticsEntries[i].ProcessItem;
+        BOOLEAN modified = PhpProcessStatisticsEntries[i].Modified;
 
-                // I/O for Other is not included because it is too generic.
-                if (maxIoValue < processItem->IoReadDelta.Delta + processItem->IoWriteDelta.Delta)
-                {
-                    maxIoValue = processItem->IoReadDelta.Delta + processItem->IoWriteDelta.Delta;
-                    maxIoProcessItem = processItem;
-                }
-            }
+        // Token information
+        if (
+            processItem->QueryHandle &&
+            processItem->ProcessId != SYSTEM_PROCESS_ID // System token can't be opened (dmex)
+            )
+        {
+            HANDLE tokenHandle;
 
-            // Token information
-            if (
-                processItem->QueryHandle &&
-                processItem->ProcessId != SYSTEM_PROCESS_ID // System token can't be opened (dmex)
-                )
+            if (NT_SUCCESS(PhOpenProcessToken(
+                processItem->QueryHandle,
+                TOKEN_QUERY,
+                &tokenHandle
+                )))
             {
-                HANDLE tokenHandle;
+                PTOKEN_USER tokenUser;
+                TOKEN_ELEVATION_TYPE elevationType;
+                MANDATORY_LEVEL integrityLevel;
+                PWSTR integrityString;
 
-                if (NT_SUCCESS(PhOpenProcessToken(
-                    processItem->QueryHandle,
-                    TOKEN_QUERY,
-                    &tokenHandle
-                    )))
+                // User
+                if (NT_SUCCESS(PhGetTokenUser(tokenHandle, &tokenUser)))
                 {
-                    PTOKEN_USER tokenUser;
-                    TOKEN_ELEVATION_TYPE elevationType;
-                    MANDATORY_LEVEL integrityLevel;
-                    PWSTR integrityString;
-
-                    // User
-                    if (NT_SUCCESS(PhGetTokenUser(tokenHandle, &tokenUser)))
+                    if (!RtlEqualSid(processItem->Sid, tokenUser->User.Sid))
                     {
-                        if (!RtlEqualSid(processItem->Sid, tokenUser->User.Sid))
-                        {
-                            PSID processSid;
-
-                            // HACK (dmex)
-                            processSid = processItem->Sid;
-                            processItem->Sid = PhAllocateCopy(tokenUser->User.Sid, RtlLengthSid(tokenUser->User.Sid));
-                            PhFree(processSid);
+                        PSID processSid;
 
-                            PhMoveReference(&processItem->UserName, PhpGetSidFullNameCachedSlow(processItem->Sid));
+                        // HACK (dmex)
+                        processSid = processItem->Sid;
+                        processItem->Sid = PhAllocateCopy(tokenUser->User.Sid, RtlLengthSid(tokenUser->User.Sid));
+                        PhFree(processSid);
 
-                            modified = TRUE;
-                        }
+                        PhMoveReference(&processItem->UserName, PhpGetSidFullNameCachedSlow(processItem->Sid));
 
-                        PhFree(tokenUser);
+                        modified = TRUE;
                     }
 
-                    // Elevation
-                    if (NT_SUCCESS(PhGetTokenElevationType(tokenHandle, &elevationType)))
+                    PhFree(tokenUser);
+                }
+
+                // Elevation
+                if (NT_SUCCESS(PhGetTokenElevationType(tokenHandle, &elevationType)))
+                {
+                    if (processItem->ElevationType != elevationType)
                     {
-                        if (processItem->ElevationType != elevationType)
-                        {
-                            processItem->ElevationType = elevationType;
-                            processItem->IsElevated = elevationType == TokenElevationTypeFull;
-                            modified = TRUE;
-                        }
+                        processItem->ElevationType = elevationType;
+                        processItem->IsElevated = elevationType == TokenElevationTypeFull;
+                        modified = TRUE;
                     }
+                }
 
-                    // Integrity
-                    if (NT_SUCCESS(PhGetTokenIntegrityLevel(tokenHandle, &integrityLevel, &integrityString)))
+                // Integrity
+                if (NT_SUCCESS(PhGetTokenIntegrityLevel(tokenHandle, &integrityLevel, &integrityString)))
+                {
+                    if (processItem->IntegrityLevel != integrityLevel)
                     {
-                        if (processItem->IntegrityLevel != integrityLevel)
-                        {
-                            processItem->IntegrityLevel = integrityLevel;
-                            processItem->IntegrityString = integrityString;
-                            modified = TRUE;
-                        }
+                        processItem->IntegrityLevel = integrityLevel;
+                        processItem->IntegrityString = integrityString;
+                        modified = TRUE;
                     }
-
-                    NtClose(tokenHandle);
                 }
+
+                NtClose(tokenHandle);
             }
+        }
+
+        // Job
+        if (processItem->QueryHandle)
+        {
+            NTSTATUS status;
+            BOOLEAN isInSignificantJob = FALSE;
+            BOOLEAN isInJob = FALSE;
 
-            // Job
-            if (processItem->QueryHandle)
+            if (KphIsConnected())
             {
-                NTSTATUS status;
-                BOOLEAN isInSignificantJob = FALSE;
-                BOOLEAN isInJob = FALSE;
+                HANDLE jobHandle = NULL;
 
-                if (KphIsConnected())
+                status = KphOpenProcessJob(
+                    processItem->QueryHandle,
+                    JOB_OBJECT_QUERY,
+                    &jobHandle
+                    );
+
+                if (NT_SUCCESS(status) && status != STATUS_PROCESS_NOT_IN_JOB)
                 {
-                    HANDLE jobHandle = NULL;
+                    JOBOBJECT_BASIC_LIMIT_INFORMATION basicLimits;
 
-                    status = KphOpenProcessJob(
-                        processItem->QueryHandle,
-                        JOB_OBJECT_QUERY,
-                        &jobHandle
-                        );
+                    isInJob = TRUE;
 
-                    if (NT_SUCCESS(status) && status != STATUS_PROCESS_NOT_IN_JOB)
+                    if (NT_SUCCESS(PhGetJobBasicLimits(jobHandle, &basicLimits)))
                     {
-                        JOBOBJECT_BASIC_LIMIT_INFORMATION basicLimits;
-
-                        isInJob = TRUE;
-
-                        if (NT_SUCCESS(PhGetJobBasicLimits(jobHandle, &basicLimits)))
-                        {
-                            isInSignificantJob = basicLimits.LimitFlags != JOB_OBJECT_LIMIT_SILENT_BREAKAWAY_OK;
-                        }
+                        isInSignificantJob = basicLimits.LimitFlags != JOB_OBJECT_LIMIT_SILENT_BREAKAWAY_OK;
                     }
-
-                    if (jobHandle)
-                        NtClose(jobHandle);
-                }
-                else
-                {
-                    status = NtIsProcessInJob(processItem->QueryHandle, NULL);
-
-                    if (NT_SUCCESS(status))
-                        isInJob = status == STATUS_PROCESS_IN_JOB;
-                }
-
-                if (processItem->IsInSignificantJob != isInSignificantJob)
-                {
-                    processItem->IsInSignificantJob = isInSignificantJob;
-                    modified = TRUE;
                 }
 
-                if (processItem->IsInJob != isInJob)
-                {
-                    processItem->IsInJob = isInJob;
-                    modified = TRUE;
-                }
+                if (jobHandle)
+                    NtClose(jobHandle);
             }
-
-            // Debugged
-            if (processItem->QueryHandle && !processItem->IsSubsystemProcess && !processItem->IsProtectedHandle)
+            else
             {
-                BOOLEAN isBeingDebugged = FALSE;
+                status = NtIsProcessInJob(processItem->QueryHandle, NULL);
 
-                PhGetProcessIsBeingDebugged(processItem->QueryHandle, &isBeingDebugged);
+                if (NT_SUCCESS(status))
+                    isInJob = status == STATUS_PROCESS_IN_JOB;
+            }
 
-                if (processItem->IsBeingDebugged != isBeingDebugged)
-                {
-                    processItem->IsBeingDebugged = isBeingDebugged;
-                    modified = TRUE;
-                }
+            if (processItem->IsInSignificantJob != isInSignificantJob)
+            {
+                processItem->IsInSignificantJob = isInSignificantJob;
+                modified = TRUE;
             }
 
-            // Suspended
-            if (processItem->IsSuspended != isSuspended)
+            if (processItem->IsInJob != isInJob)
             {
-                processItem->IsSuspended = isSuspended;
+                processItem->IsInJob = isInJob;
                 modified = TRUE;
             }
+        }
+
+        // Debugged
+        if (processItem->QueryHandle && !processItem->IsSubsystemProcess && !processItem->IsProtectedHandle)
+        {
+            BOOLEAN isBeingDebugged = FALSE;
 
-            processItem->IsPartiallySuspended = isPartiallySuspended;
+            PhGetProcessIsBeingDebugged(processItem->QueryHandle, &isBeingDebugged);
 
-            // .NET
-            if (processItem->UpdateIsDotNet)
+            if (processItem->IsBeingDebugged != isBeingDebugged)
             {
-                BOOLEAN isDotNet;
-                ULONG flags = 0;
+                processItem->IsBeingDebugged = isBeingDebugged;
+                modified = TRUE;
+            }
+        }
 
-                if (NT_SUCCESS(PhGetProcessIsDotNetEx(processItem->ProcessId, NULL, 0, &isDotNet, &flags)))
-                {
-                    processItem->IsDotNet = isDotNet;
+        // .NET
+        if (processItem->UpdateIsDotNet)
+        {
+            BOOLEAN isDotNet;
+            ULONG flags = 0;
 
-                    // This check is needed for the DotNetTools plugin. (dmex)
-                    if (!isDotNet && (flags & PH_CLR_JIT_PRESENT))
-                        processItem->IsDotNet = TRUE;
+            if (NT_SUCCESS(PhGetProcessIsDotNetEx(processItem->ProcessId, NULL, 0, &isDotNet, &flags)))
+            {
+                processItem->IsDotNet = isDotNet;
 
-                    modified = TRUE;
-                }
+                // This check is needed for the DotNetTools plugin. (dmex)
+                if (!isDotNet && (flags & PH_CLR_JIT_PRESENT))
+                    processItem->IsDotNet = TRUE;
 
-                processItem->UpdateIsDotNet = FALSE;
+                modified = TRUE;
             }
 
-            // Immersive
-            if (processItem->QueryHandle && WindowsVersion >= WINDOWS_8 && IsImmersiveProcess && !processItem->IsSubsystemProcess)
-            {
-                BOOLEAN isImmersive;
+            processItem->UpdateIsDotNet = FALSE;
+        }
 
-                isImmersive = !!IsImmersiveProcess(processItem->QueryHandle);
+        // Immersive
+        if (processItem->QueryHandle && WindowsVersion >= WINDOWS_8 && IsImmersiveProcess && !processItem->IsSubsystemProcess)
+        {
+            BOOLEAN isImmersive;
 
-                if (processItem->IsImmersive != isImmersive)
-                {
-                    processItem->IsImmersive = isImmersive;
-                    modified = TRUE;
-                }
-            }
+            isImmersive = !!IsImmersiveProcess(processItem->QueryHandle);
 
-            if (processItem->QueryHandle && processItem->IsHandleValid)
+            if (processItem->IsImmersive != isImmersive)
             {
-                OBJECT_BASIC_INFORMATION basicInfo;
-                BOOLEAN filteredHandle = FALSE;
+                processItem->IsImmersive = isImmersive;
+                modified = TRUE;
+            }
+        }
 
-                if (NT_SUCCESS(PhGetHandleInformationEx(
-                    NtCurrentProcess(),
-                    processItem->QueryHandle,
-                    ULONG_MAX,
-                    0,
-                    NULL,
-                    &basicInfo,
-                    NULL,
-                    NULL,
-                    NULL,
-                    NULL
-                    )))
-                {
-                    if ((basicInfo.GrantedAccess & PROCESS_QUERY_INFORMATION) != PROCESS_QUERY_INFORMATION)
-                    {
-                        filteredHandle = TRUE;
-                    }
-                }
-                else
+        if (processItem->QueryHandle && processItem->IsHandleValid)
+        {
+            OBJECT_BASIC_INFORMATION basicInfo;
+            BOOLEAN filteredHandle = FALSE;
+
+            if (NT_SUCCESS(PhGetHandleInformationEx(
+                NtCurrentProcess(),
+                processItem->QueryHandle,
+                ULONG_MAX,
+                0,
+                NULL,
+                &basicInfo,
+                NULL,
+                NULL,
+                NULL,
+                NULL
+                )))
+            {
+                if ((basicInfo.GrantedAccess & PROCESS_QUERY_INFORMATION) != PROCESS_QUERY_INFORMATION)
                 {
                     filteredHandle = TRUE;
                 }
-
-                if (processItem->IsProtectedHandle != filteredHandle)
-                {
-                    processItem->IsProtectedHandle = filteredHandle;
-                    modified = TRUE;
-                }
             }
-
-            if (modified)
+            else
             {
-                PhInvokeCallback(PhGetGeneralCallback(GeneralCallbackProcessProviderModifiedEvent), processItem);
+                filteredHandle = TRUE;
             }
 
-            // No reference added by PhpLookupProcessItem.
+            if (processItem->IsProtectedHandle != filteredHandle)
+            {
+                processItem->IsProtectedHandle = filteredHandle;
+                modified = TRUE;
+            }
         }
 
-        // Trick ourselves into thinking that the fake processes
-        // are on the list.
-        if (process == PhInterruptsProcessInformation)
+        if (modified)
         {
-            process = NULL;
-        }
-        else if (process == PhDpcsProcessInformation)
-        {
-            process = PhInterruptsProcessInformation;
-        }
-        else
-        {
-            process = PH_NEXT_PROCESS(process);
-
-            if (process == NULL)
-            {
-                if (PhEnableCycleCpuUsage)
-                    process = PhInterruptsProcessInformation;
-                else
-                    process = PhDpcsProcessInformation;
-            }
+            PhInvokeCallback(PhGetGeneralCallback(GeneralCallbackProcessProviderModifiedEvent), processItem);
         }
     }
 
@@ -2501,11 +3438,7 @@ VOID PhProcessProviderUpdate(
             PhAddItemCircularBuffer_FLOAT(&PhMaxCpuUsageHistory, maxCpuProcessItem->CpuUsage);
 #endif
 
-            if (!(maxCpuProcessItem->Record->Flags & PH_PROCESS_RECORD_STAT_REF))
-            {
-                PhReferenceProcessRecord(maxCpuProcessItem->Record);
-                maxCpuProcessItem->Record->Flags |= PH_PROCESS_RECORD_STAT_REF;
-            }
+            PhReferenceProcessRecordForStatistics(maxCpuProcessItem->Record);
         }
         else
         {
@@ -2524,11 +3457,7 @@ VOID PhProcessProviderUpdate(
             PhAddItemCircularBuffer_ULONG64(&PhMaxIoWriteHistory, maxIoProcessItem->IoWriteDelta.Delta);
 #endif
 
-            if (!(maxIoProcessItem->Record->Flags & PH_PROCESS_RECORD_STAT_REF))
-            {
-                PhReferenceProcessRecord(maxIoProcessItem->Record);
-                maxIoProcessItem->Record->Flags |= PH_PROCESS_RECORD_STAT_REF;
-            }
+            PhReferenceProcessRecordForStatistics(maxIoProcessItem->Record);
         }
         else
         {
@@ -2544,6 +3473,18 @@ VOID PhProcessProviderUpdate(
     runCount++;
 }
 
+BOOLEAN PhProcessProviderUpdateEvents(
+    _In_ BOOLEAN Discard
+    )
+{
+    // The process events are applied by the full update until it has run twice, because the
+    // processes added by the first run aren't reported as new processes.
+    if (!Discard && PhTimeSequenceNumber == 0)
+        return FALSE;
+
+    return PhpFlushProcessProviderEvents(!Discard);
+}
+
 PPH_PROCESS_RECORD PhpCreateProcessRecord(
     _In_ PPH_PROCESS_ITEM ProcessItem
     )
@@ -2635,6 +3576,90 @@ PPH_PROCESS_RECORD PhpSearchProcessRecordList(
     }
 }
 
+BOOLEAN PhpProcessRecordStringEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PPH_PROCESS_RECORD_STRING string1 = Entry1;
+    PPH_PROCESS_RECORD_STRING string2 = Entry2;
+
+    return PhEqualString(string1->String, string2->String, FALSE);
+}
+
+ULONG PhpProcessRecordStringHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PPH_PROCESS_RECORD_STRING string = Entry;
+
+    return PhHashStringRef(&string->String->sr, FALSE);
+}
+
+/**
+ * Replaces a string with an equal one shared by other process records. Most records have the
+ * same few names, so this saves memory when many records are kept.
+ *
+ * \param String A variable which contains the string. The variable receives the shared string,
+ * and the reference is transferred to it.
+ *
+ * \remarks The process record list lock must be held exclusively.
+ */
+VOID PhpInternProcessRecordString(
+    _Inout_ PPH_STRING *String
+    )
+{
+    PH_PROCESS_RECORD_STRING lookupString;
+    PPH_PROCESS_RECORD_STRING string;
+
+    if (!*String)
+        return;
+
+    lookupString.String = *String;
+
+    if (string = PhFindEntryHashtable(PhpProcessRecordStringHashtable, &lookupString))
+    {
+        string->Count++;
+        PhReferenceObject(string->String);
+        PhDereferenceObject(*String);
+        *String = string->String;
+    }
+    else
+    {
+        PhReferenceObject(*String);
+        lookupString.Count = 1;
+        PhAddEntryHashtable(PhpProcessRecordStringHashtable, &lookupString);
+    }
+}
+
+/**
+ * Releases a string returned by PhpInternProcessRecordString(). The caller still owns its own
+ * reference to the string.
+ *
+ * \remarks The process record list lock must be held exclusively.
+ */
+VOID PhpReleaseProcessRecordString(
+    _In_opt_ PPH_STRING String
+    )
+{
+    PH_PROCESS_RECORD_STRING lookupString;
+    PPH_PROCESS_RECORD_STRING string;
+
+    if (!String)
+        return;
+
+    lookupString.String = String;
+
+    if (string = PhFindEntryHashtable(PhpProcessRecordStringHashtable, &lookupString))
+    {
+        if (--string->Count == 0)
+        {
+            PhRemoveEntryHashtable(PhpProcessRecordStringHashtable, &lookupString);
+            PhDereferenceObject(String);
+        }
+    }
+}
+
 VOID PhpAddProcessRecord(
     _Inout_ PPH_PROCESS_RECORD ProcessRecord
     )
@@ -2644,6 +3669,17 @@ VOID PhpAddProcessRecord(
 
     PhAcquireQueuedLockExclusive(&PhProcessRecordListLock);
 
+    // The record is not visible to anyone else yet, so we can swap its strings.
+    PhpInternProcessRecordString(&ProcessRecord->ProcessName);
+    PhpInternProcessRecordString(&ProcessRecord->FileName);
+
+    PhAddTimelineEntry(
+        &PhpProcessRecordTimeline,
+        (ULONG_PTR)ProcessRecord->ProcessId,
+        ProcessRecord->CreateTime.QuadPart,
+        ProcessRecord
+        );
+
     processRecord = PhpSearchProcessRecordList(&ProcessRecord->CreateTime, NULL, &insertIndex);
 
     if (!processRecord)
@@ -2684,6 +3720,40 @@ VOID PhpRemoveProcessRecord(
             PhProcessRecordList->Items[i] = CONTAINING_RECORD(headProcessRecord->ListEntry.Flink, PH_PROCESS_RECORD, ListEntry);
     }
 
+    PhRemoveTimelineEntry(
+        &PhpProcessRecordTimeline,
+        (ULONG_PTR)ProcessRecord->ProcessId,
+        ProcessRecord->CreateTime.QuadPart,
+        ProcessRecord
+        );
+
+    PhpReleaseProcessRecordString(ProcessRecord->ProcessName);
+    PhpReleaseProcessRecordString(ProcessRecord->FileName);
+
+    PhReleaseQueuedLockExclusive(&PhProcessRecordListLock);
+}
+
+/**
+ * Keeps a dead process record until it is purged by PhPurgeProcessRecords().
+ */
+VOID PhpRetainProcessRecord(
+    _Inout_ PPH_PROCESS_RECORD ProcessRecord
+    )
+{
+    if (!(ProcessRecord->Flags & PH_PROCESS_RECORD_DEAD))
+        return;
+    if (PhProcessRecordRetentionTime == 0 && !(ProcessRecord->Flags & PH_PROCESS_RECORD_STAT_REF))
+        return;
+
+    PhAcquireQueuedLockExclusive(&PhProcessRecordListLock);
+
+    if (!(ProcessRecord->Flags & PH_PROCESS_RECORD_RETAINED))
+    {
+        PhReferenceProcessRecord(ProcessRecord);
+        ProcessRecord->Flags |= PH_PROCESS_RECORD_RETAINED;
+        PhInsertRetentionEntry(&PhpRetainedProcessRecordListHead, &ProcessRecord->RetainedEntry, ProcessRecord->ExitTime.QuadPart);
+    }
+
     PhReleaseQueuedLockExclusive(&PhProcessRecordListLock);
 }
 
@@ -2709,6 +3779,9 @@ VOID PhReferenceProcessRecordForStatistics(
     {
         PhReferenceProcessRecord(ProcessRecord);
         ProcessRecord->Flags |= PH_PROCESS_RECORD_STAT_REF;
+
+        // Records of processes that have already exited are not retained yet.
+        PhpRetainProcessRecord(ProcessRecord);
     }
 }
 
@@ -2771,6 +3844,29 @@ PPH_PROCESS_RECORD PhFindProcessRecord(
     if (PhProcessRecordList->Count == 0)
         return NULL;
 
+    if (ProcessId)
+    {
+        PPH_TIMELINE_ENTRY entry;
+
+        // The lifetimes of the processes that used a process ID don't overlap, so the newest record
+        // of the process ID that was created at or before the time is the one we want.
+
+        processRecord = NULL;
+
+        PhAcquireQueuedLockShared(&PhProcessRecordListLock);
+
+        if (entry = PhFindTimelineEntry(&PhpProcessRecordTimeline, (ULONG_PTR)ProcessId, Time->QuadPart))
+        {
+            // See below.
+            if (PhReferenceProcessRecordSafe(entry->Value))
+                processRecord = entry->Value;
+        }
+
+        PhReleaseQueuedLockShared(&PhProcessRecordListLock);
+
+        return processRecord;
+    }
+
     PhAcquireQueuedLockShared(&PhProcessRecordListLock);
 
     processRecord = PhpSearchProcessRecordList(Time, &i, NULL);
@@ -2843,70 +3939,86 @@ PPH_PROCESS_RECORD PhFindProcessRecord(
         return NULL;
 }
 
-/**
- * Deletes unused process records.
- */
-VOID PhPurgeProcessRecords(
-    VOID
+static BOOLEAN NTAPI PhpPurgeProcessRecordCallback(
+    _In_ PPH_RETENTION_ENTRY Entry,
+    _In_opt_ PVOID Context
     )
 {
+    PPH_PROCESS_RECORD_PURGE_CONTEXT context = Context;
     PPH_PROCESS_RECORD processRecord;
-    PPH_PROCESS_RECORD startProcessRecord;
-    ULONG i;
-    LARGE_INTEGER threshold;
-    PPH_LIST derefList = NULL;
 
-    if (PhProcessRecordList->Count == 0)
-        return;
+    processRecord = CONTAINING_RECORD(Entry, PH_PROCESS_RECORD, RetainedEntry);
 
-    // Get the oldest statistics time.
-    PhGetStatisticsTime(NULL, PhTimeHistory.Count - 1, &threshold);
+    // Check if the process exit time is before the oldest statistics time. If not, the
+    // statistics system may still need the record, so keep it and look at the next one.
+    if ((processRecord->Flags & PH_PROCESS_RECORD_STAT_REF) &&
+        processRecord->ExitTime.QuadPart >= context->StatisticsThreshold)
+        return FALSE;
 
-    PhAcquireQueuedLockShared(&PhProcessRecordListLock);
+    if (!context->DerefList)
+        context->DerefList = PhCreateList(2);
+
+    // Clear the bits; this is to make sure we don't try to dereference the record twice (e.g.
+    // if someone else currently holds a reference to the record and it doesn't get removed
+    // immediately).
+    processRecord->Flags &= ~PH_PROCESS_RECORD_RETAINED;
+    PhAddItemList(context->DerefList, processRecord);
 
-    for (i = 0; i < PhProcessRecordList->Count; i++)
+    if (processRecord->Flags & PH_PROCESS_RECORD_STAT_REF)
     {
-        processRecord = PhProcessRecordList->Items[i];
-        startProcessRecord = processRecord;
+        processRecord->Flags &= ~PH_PROCESS_RECORD_STAT_REF;
+        PhAddItemList(context->DerefList, processRecord);
+    }
 
-        do
-        {
-            ULONG requiredFlags;
+    return TRUE;
+}
 
-            requiredFlags = PH_PROCESS_RECORD_DEAD | PH_PROCESS_RECORD_STAT_REF;
+/**
+ * Deletes unused process records.
+ *
+ * \remarks Dead process records are kept for PhProcessRecordRetentionTime seconds, and records
+ * referenced by the statistics system are kept until they are older than the oldest statistics
+ * time. Records are retained in order of exit time, so only the expired records at the head of
+ * the list are visited. Records that the statistics system still needs are skipped.
+ */
+VOID PhPurgeProcessRecords(
+    VOID
+    )
+{
+    PH_PROCESS_RECORD_PURGE_CONTEXT context;
+    ULONG i;
+    LARGE_INTEGER statisticsThreshold;
+    LARGE_INTEGER retentionThreshold;
 
-            if ((processRecord->Flags & requiredFlags) == requiredFlags)
-            {
-                // Check if the process exit time is before the oldest statistics time. If so we can
-                // dereference the process record.
-                if (processRecord->ExitTime.QuadPart < threshold.QuadPart)
-                {
-                    // Clear the stat ref bit; this is to make sure we don't try to dereference the
-                    // record twice (e.g. if someone else currently holds a reference to the record
-                    // and it doesn't get removed immediately).
-                    processRecord->Flags &= ~PH_PROCESS_RECORD_STAT_REF;
+    if (IsListEmpty(&PhpRetainedProcessRecordListHead) || PhTimeHistory.Count == 0)
+        return;
 
-                    if (!derefList)
-                        derefList = PhCreateList(2);
+    // Get the oldest statistics time.
+    PhGetStatisticsTime(NULL, PhTimeHistory.Count - 1, &statisticsThreshold);
 
-                    PhAddItemList(derefList, processRecord);
-                }
-            }
+    PhQuerySystemTime(&retentionThreshold);
+    retentionThreshold.QuadPart -= (LONG64)PhProcessRecordRetentionTime * PH_TICKS_PER_SEC;
 
-            processRecord = CONTAINING_RECORD(processRecord->ListEntry.Flink, PH_PROCESS_RECORD, ListEntry);
-        } while (processRecord != startProcessRecord);
-    }
+    context.StatisticsThreshold = statisticsThreshold.QuadPart;
+    context.DerefList = NULL;
 
-    PhReleaseQueuedLockShared(&PhProcessRecordListLock);
+    PhAcquireQueuedLockExclusive(&PhProcessRecordListLock);
+    PhPurgeRetentionQueue(
+        &PhpRetainedProcessRecordListHead,
+        retentionThreshold.QuadPart,
+        PhpPurgeProcessRecordCallback,
+        &context
+        );
+    PhReleaseQueuedLockExclusive(&PhProcessRecordListLock);
 
-    if (derefList)
+    if (context.DerefList)
     {
-        for (i = 0; i < derefList->Count; i++)
+        for (i = 0; i < context.DerefList->Count; i++)
         {
-            PhDereferenceProcessRecord(derefList->Items[i]);
+            PhDereferenceProcessRecord(context.DerefList->Items[i]);
         }
 
-        PhDereferenceObject(derefList);
+        PhDereferenceObject(context.DerefList);
     }
 }
 
@@ -2983,3 +4095,38 @@ PVOID PhGetProcessInformationCache(
 {
     return PhProcessInformation;
 }
+
+VOID PhQueueProcessProviderEvent(
+    _In_ PH_PROCESS_PROVIDER_EVENT_TYPE Type,
+    _In_ HANDLE ProcessId,
+    _In_ HANDLE ParentProcessId,
+    _In_ ULONG SessionId,
+    _In_opt_ PPH_STRING ImageName
+    )
+{
+    PPH_PROCESS_PROVIDER_EVENT event;
+
+    if (!PhProcessProviderEventRegistration)
+        return;
+
+    // If the events aren't being applied, the full update finds the processes anyway.
+    if (_InterlockedIncrement(&PhpProcessProviderEventCount) > PH_PROCESS_PROVIDER_MAXIMUM_EVENTS)
+    {
+        _InterlockedDecrement(&PhpProcessProviderEventCount);
+        return;
+    }
+
+    event = PhAllocateZero(sizeof(PH_PROCESS_PROVIDER_EVENT));
+    event->Type = Type;
+    event->ProcessId = ProcessId;
+    event->ParentProcessId = ParentProcessId;
+    event->SessionId = SessionId;
+    PhQuerySystemTime(&event->Time);
+
+    if (ImageName)
+        event->ImageName = PhReferenceObject(ImageName);
+
+    RtlInterlockedPushEntrySList(&PhpProcessProviderEventListHead, &event->ListEntry);
+
+    PhBoostProvider(PhProcessProviderEventRegistration, NULL);
+}
@@ -29,7 +29,7 @@
 typedef struct _PROCESS_RECORD_CONTEXT
 {
     PPH_PROCESS_RECORD Record;
-    HICON FileIcon;
+    PPH_FILE_ICON FileIcon;
 } PROCESS_RECORD_CONTEXT, *PPROCESS_RECORD_CONTEXT;
 
 INT_PTR CALLBACK PhpProcessRecordDlgProc(
@@ -46,6 +46,7 @@ VOID PhShowProcessRecordDialog(
 {
     PROCESS_RECORD_CONTEXT context;
 
+    memset(&context, 0, sizeof(PROCESS_RECORD_CONTEXT));
     context.Record = Record;
 
     DialogBoxParam(
@@ -166,19 +167,15 @@ INT_PTR CALLBACK PhpProcessRecordDlgProc(
 
             if (context->Record->FileName)
             {
-                PhExtractIcon(
-                    context->Record->FileName->Buffer,
-                    &context->FileIcon,
-                    NULL
-                    );
+                context->FileIcon = PhGetFileIcon(context->Record->FileName->Buffer, 0);
 
                 if (PhInitializeImageVersionInfo(&versionInfo, context->Record->FileName->Buffer))
                     versionInfoInitialized = TRUE;
             }
 
-            if (context->FileIcon)
+            if (context->FileIcon && context->FileIcon->LargeIcon)
             {
-                SendMessage(GetDlgItem(hwndDlg, IDC_FILEICON), STM_SETICON, (WPARAM)context->FileIcon, 0);
+                SendMessage(GetDlgItem(hwndDlg, IDC_FILEICON), STM_SETICON, (WPARAM)context->FileIcon->LargeIcon, 0);
             }
             else
             {
@@ -222,7 +219,7 @@ INT_PTR CALLBACK PhpProcessRecordDlgProc(
     case WM_DESTROY:
         {
             if (context->FileIcon)
-                DestroyIcon(context->FileIcon);
+                PhDereferenceFileIcon(context->FileIcon);
         }
         break;
     case WM_COMMAND:
@@ -3098,6 +3098,9 @@ BOOLEAN NTAPI PhpProcessTreeNewCallback(
 
             node = (PPH_PROCESS_NODE)getNodeIcon->Node;
 
+            // The node is visible, so serve any queued queries for the process first.
+            PhPrioritizeProcessQuery(node->ProcessItem);
+
             if (node->ProcessItem->SmallIcon)
             {
                 getNodeIcon->Icon = node->ProcessItem->SmallIcon;
@@ -543,6 +543,7 @@
 #define IDC_USERMODE                    1413
 #define IDC_HYPERVISOR                  1414
 #define IDC_SIZESINBYTES                1415
+#define IDC_EXPORT                      1416
 #define ID_HACKER_EXIT                  40001
 #define ID_PROCESS_PROPERTIES           40006
 #define ID_PROCESS_TERMINATE            40007
@@ -763,7 +764,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        257
 #define _APS_NEXT_COMMAND_VALUE         40298
-#define _APS_NEXT_CONTROL_VALUE         1410
+#define _APS_NEXT_CONTROL_VALUE         1417
 #define _APS_NEXT_SYMED_VALUE           170
 #endif
 #endif
@@ -14,6 +14,12 @@
 #include "lsasup.h"
 #include "svcsup.h"
 #include "circbuf.h"
+#include "histbuf.h"
+#include "binlog.h"
+#include "colsnap.h"
+#include "phquery.h"
+#include "timeline.h"
+#include "systrace.h"
 #include "dltmgr.h"
 #include "guisup.h"
 #include "treenew.h"
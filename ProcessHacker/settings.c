@@ -94,8 +94,8 @@ VOID PhAddDefaultSettings(
     PhpAddIntegerSetting(L"IconTogglesVisibility", L"1");
     PhpAddStringSetting(L"JobListViewColumns", L"");
     //PhpAddIntegerSetting(L"KphUnloadOnShutdown", L"0");
-    PhpAddIntegerSetting(L"LogEntries", L"200"); // 512
     PhpAddStringSetting(L"LogListViewColumns", L"");
+    PhpAddIntegerSetting(L"LogSegments", L"8"); // 1 MB each
     PhpAddIntegerPairSetting(L"LogWindowPosition", L"0,0");
     PhpAddScalableIntegerPairSetting(L"LogWindowSize", L"@96|450,500");
     PhpAddIntegerSetting(L"MainWindowAlwaysOnTop", L"0");
@@ -142,6 +142,7 @@ VOID PhAddDefaultSettings(
     PhpAddScalableIntegerPairSetting(L"PluginManagerWindowSize", L"@96|900,590");
     PhpAddStringSetting(L"PluginManagerTreeListColumns", L"");
     PhpAddStringSetting(L"PluginsDirectory", L"plugins");
+    PhpAddIntegerSetting(L"ProcessRecordRetentionTime", L"0"); // seconds
     PhpAddStringSetting(L"ProcessServiceListViewColumns", L"");
     PhpAddStringSetting(L"ProcessTreeColumnSetConfig", L"");
     PhpAddStringSetting(L"ProcessTreeListColumns", L"");
@@ -90,8 +90,7 @@ typedef struct _PH_SERVICE_QUERY_S1_DATA
     PH_SERVICE_QUERY_DATA Header;
 
     PPH_STRING FileName;
-    HICON SmallIcon;
-    HICON LargeIcon;
+    PPH_FILE_ICON FileIcon;
 } PH_SERVICE_QUERY_S1_DATA, *PPH_SERVICE_QUERY_S1_DATA;
 
 typedef struct _PH_SERVICE_QUERY_S2_DATA
@@ -212,8 +211,7 @@ VOID PhpServiceItemDeleteProcedure(
     if (serviceItem->DisplayName) PhDereferenceObject(serviceItem->DisplayName);
     if (serviceItem->FileName) PhDereferenceObject(serviceItem->FileName);
     if (serviceItem->VerifySignerName) PhDereferenceObject(serviceItem->VerifySignerName);
-    if (serviceItem->SmallIcon) DestroyIcon(serviceItem->SmallIcon);
-    if (serviceItem->LargeIcon) DestroyIcon(serviceItem->LargeIcon);
+    if (serviceItem->FileIcon) PhDereferenceFileIcon(serviceItem->FileIcon);
     //PhDeleteImageVersionInfo(&serviceItem->VersionInfo);
 }
 
@@ -280,6 +278,36 @@ PPH_SERVICE_ITEM PhReferenceServiceItem(
     return serviceItem;
 }
 
+VOID PhEnumServiceItems(
+    _Out_ PPH_SERVICE_ITEM **ServiceItems,
+    _Out_ PULONG NumberOfServiceItems
+    )
+{
+    PPH_SERVICE_ITEM *serviceItems;
+    ULONG numberOfServiceItems;
+    ULONG count = 0;
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PPH_SERVICE_ITEM *serviceItem;
+
+    PhAcquireQueuedLockShared(&PhServiceHashtableLock);
+
+    numberOfServiceItems = PhServiceHashtable->Count;
+    serviceItems = PhAllocate(sizeof(PPH_SERVICE_ITEM) * numberOfServiceItems);
+
+    PhBeginEnumHashtable(PhServiceHashtable, &enumContext);
+
+    while (serviceItem = PhNextEnumHashtable(&enumContext))
+    {
+        PhReferenceObject(*serviceItem);
+        serviceItems[count++] = *serviceItem;
+    }
+
+    PhReleaseQueuedLockShared(&PhServiceHashtableLock);
+
+    *ServiceItems = serviceItems;
+    *NumberOfServiceItems = numberOfServiceItems;
+}
+
 VOID PhpResetServiceNonPollGate(
     VOID
     )
@@ -516,11 +544,7 @@ VOID PhpServiceQueryStage1(
 
     if (Data->FileName)
     {
-        if (!PhExtractIcon(Data->FileName->Buffer, &Data->LargeIcon, &Data->SmallIcon))
-        {
-            Data->LargeIcon = NULL;
-            Data->SmallIcon = NULL;
-        }
+        Data->FileIcon = PhGetFileIcon(Data->FileName->Buffer, 0);
 
         // Version info.
         //PhInitializeImageVersionInfo(&Data->VersionInfo, Data->FileName->Buffer);
@@ -622,8 +646,14 @@ VOID PhpFillServiceItemStage1(
     PPH_SERVICE_ITEM serviceItem = Data->Header.ServiceItem;
 
     serviceItem->FileName = Data->FileName;
-    serviceItem->SmallIcon = Data->SmallIcon;
-    serviceItem->LargeIcon = Data->LargeIcon;
+    serviceItem->FileIcon = Data->FileIcon;
+
+    if (serviceItem->FileIcon)
+    {
+        serviceItem->SmallIcon = serviceItem->FileIcon->SmallIcon;
+        serviceItem->LargeIcon = serviceItem->FileIcon->LargeIcon;
+    }
+
     //memcpy(&processItem->VersionInfo, &Data->VersionInfo, sizeof(PH_IMAGE_VERSION_INFO));
 
     // Note: Queue stage 2 processing after filling stage1 process data.
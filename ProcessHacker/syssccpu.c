@@ -40,6 +40,7 @@ static PH_GRAPH_STATE CpuGraphState;
 static HWND *CpusGraphHandle;
 static PPH_GRAPH_STATE CpusGraphState;
 static BOOLEAN OneGraphPerCpu;
+static ULONG CpusHistoryLevel; // 0 for every sample, otherwise the history level plus one
 static HWND CpuPanel;
 static ULONG CpuTicked;
 static ULONG CpuMaxMhz;
@@ -610,17 +611,47 @@ VOID PhSipNotifyCpuGraph(
             }
             else
             {
-                PhGraphStateGetDrawInfo(
-                    &CpusGraphState[Index],
-                    getDrawInfo,
-                    PhCpuKernelHistory.Count
-                    );
+                if (CpusHistoryLevel == 0)
+                {
+                    PhGraphStateGetDrawInfo(
+                        &CpusGraphState[Index],
+                        getDrawInfo,
+                        PhCpuKernelHistory.Count
+                        );
 
-                if (!CpusGraphState[Index].Valid)
+                    if (!CpusGraphState[Index].Valid)
+                    {
+                        PhCopyCircularBuffer_FLOAT(&PhCpusKernelHistory[Index], CpusGraphState[Index].Data1, drawInfo->LineDataCount);
+                        PhCopyCircularBuffer_FLOAT(&PhCpusUserHistory[Index], CpusGraphState[Index].Data2, drawInfo->LineDataCount);
+                        CpusGraphState[Index].Valid = TRUE;
+                    }
+                }
+                else
                 {
-                    PhCopyCircularBuffer_FLOAT(&PhCpusKernelHistory[Index], CpusGraphState[Index].Data1, drawInfo->LineDataCount);
-                    PhCopyCircularBuffer_FLOAT(&PhCpusUserHistory[Index], CpusGraphState[Index].Data2, drawInfo->LineDataCount);
-                    CpusGraphState[Index].Valid = TRUE;
+                    ULONG level = CpusHistoryLevel - 1;
+
+                    PhGraphStateGetDrawInfo(
+                        &CpusGraphState[Index],
+                        getDrawInfo,
+                        PhCpusTotalHistoryLevels[Index].Levels[level].Average.Count
+                        );
+
+                    if (!CpusGraphState[Index].Valid)
+                    {
+                        PFLOAT data1 = CpusGraphState[Index].Data1;
+                        PFLOAT data2 = CpusGraphState[Index].Data2;
+
+                        // The total is stored instead of the user time so that the minimum and
+                        // maximum are meaningful. Averages are additive, so the user time is
+                        // recovered by subtracting the kernel time.
+                        PhCopyHistoryBuffer(&PhCpusKernelHistoryLevels[Index], level, AverageHistoryAggregate, data1, drawInfo->LineDataCount);
+                        PhCopyHistoryBuffer(&PhCpusTotalHistoryLevels[Index], level, AverageHistoryAggregate, data2, drawInfo->LineDataCount);
+
+                        for (ULONG i = 0; i < drawInfo->LineDataCount; i++)
+                            data2[i] = max(data2[i] - data1[i], 0);
+
+                        CpusGraphState[Index].Valid = TRUE;
+                    }
                 }
 
                 if (PhCsGraphShowText)
@@ -691,7 +722,14 @@ VOID PhSipNotifyCpuGraph(
                 }
                 else
                 {
-                    if (CpusGraphState[Index].TooltipIndex != getTooltipText->Index)
+                    if (CpusHistoryLevel != 0)
+                    {
+                        if (CpusGraphState[Index].TooltipIndex != getTooltipText->Index)
+                        {
+                            PhMoveReference(&CpusGraphState[Index].TooltipText, PhSipGetCpusHistoryTooltipText(Index, getTooltipText->Index));
+                        }
+                    }
+                    else if (CpusGraphState[Index].TooltipIndex != getTooltipText->Index)
                     {
                         FLOAT cpuKernel;
                         FLOAT cpuUser;
@@ -728,7 +766,24 @@ VOID PhSipNotifyCpuGraph(
 
             if (mouseEvent->Message == WM_LBUTTONDBLCLK && mouseEvent->Index < mouseEvent->TotalCount)
             {
-                record = PhSipReferenceMaxCpuRecord(mouseEvent->Index);
+                if (Index == ULONG_MAX || CpusHistoryLevel == 0)
+                {
+                    record = PhSipReferenceMaxCpuRecord(mouseEvent->Index);
+                }
+                else
+                {
+                    ULONG sampleIndex;
+
+                    // Use the newest sample of the item, if it is still in the full-resolution history.
+                    sampleIndex = PhGetSampleIndexHistoryBuffer(&PhCpusTotalHistoryLevels[Index], CpusHistoryLevel - 1, mouseEvent->Index);
+
+                    if (sampleIndex < PhMaxCpuHistory.Count)
+                        record = PhSipReferenceMaxCpuRecord(sampleIndex);
+                }
+            }
+            else if (mouseEvent->Message == WM_RBUTTONUP && Index != ULONG_MAX)
+            {
+                PhSipShowCpusHistoryLevelMenu();
             }
 
             if (record)
@@ -741,6 +796,101 @@ VOID PhSipNotifyCpuGraph(
     }
 }
 
+VOID PhSipShowCpusHistoryLevelMenu(
+    VOID
+    )
+{
+    PPH_EMENU menu;
+    PPH_EMENU_ITEM menuItem;
+    PPH_EMENU_ITEM selectedItem;
+    POINT point;
+    ULONG i;
+
+    menu = PhCreateEMenu();
+    PhInsertEMenuItem(menu, PhCreateEMenuItem(0, 1, L"&Every sample", NULL, NULL), ULONG_MAX);
+
+    for (i = 0; i < PH_CPU_HISTORY_LEVEL_COUNT; i++)
+    {
+        PPH_STRING text;
+
+        text = PhFormatString(L"Average of %lu samples", PhCpusTotalHistoryLevels[0].Levels[i].Scale);
+        menuItem = PhCreateEMenuItem(PH_EMENU_TEXT_OWNED, i + 2, PhAllocateCopy(text->Buffer, text->Length + sizeof(UNICODE_NULL)), NULL, NULL);
+        PhInsertEMenuItem(menu, menuItem, ULONG_MAX);
+        PhDereferenceObject(text);
+    }
+
+    if (menuItem = PhFindEMenuItem(menu, 0, NULL, CpusHistoryLevel + 1))
+        menuItem->Flags |= PH_EMENU_CHECKED | PH_EMENU_RADIOCHECK;
+
+    GetCursorPos(&point);
+    selectedItem = PhShowEMenu(
+        menu,
+        CpuDialog,
+        PH_EMENU_SHOW_LEFTRIGHT,
+        PH_ALIGN_LEFT | PH_ALIGN_TOP,
+        point.x,
+        point.y
+        );
+
+    if (selectedItem && selectedItem->Id != CpusHistoryLevel + 1)
+    {
+        CpusHistoryLevel = selectedItem->Id - 1;
+
+        for (i = 0; i < NumberOfProcessors; i++)
+        {
+            CpusGraphState[i].Valid = FALSE;
+            CpusGraphState[i].TooltipIndex = ULONG_MAX;
+            Graph_Draw(CpusGraphHandle[i]);
+            Graph_UpdateTooltip(CpusGraphHandle[i]);
+            InvalidateRect(CpusGraphHandle[i], NULL, FALSE);
+        }
+    }
+
+    PhDestroyEMenu(menu);
+}
+
+PPH_STRING PhSipGetCpusHistoryTooltipText(
+    _In_ ULONG Index,
+    _In_ ULONG ItemIndex
+    )
+{
+    ULONG level = CpusHistoryLevel - 1;
+    FLOAT cpuKernel;
+    FLOAT cpuTotal;
+    ULONG sampleIndex;
+    PPH_STRING timeString;
+    PH_FORMAT format[13];
+
+    cpuKernel = PhGetItemHistoryBuffer(&PhCpusKernelHistoryLevels[Index], level, AverageHistoryAggregate, ItemIndex);
+    cpuTotal = PhGetItemHistoryBuffer(&PhCpusTotalHistoryLevels[Index], level, AverageHistoryAggregate, ItemIndex);
+    sampleIndex = PhGetSampleIndexHistoryBuffer(&PhCpusTotalHistoryLevels[Index], level, ItemIndex);
+
+    // The time history only covers the full-resolution samples.
+    if (sampleIndex < PhCpuKernelHistory.Count)
+        timeString = PhGetStatisticsTimeString(NULL, sampleIndex);
+    else
+        timeString = PhCreateString(L"Unknown time");
+
+    // %.2f%% (K: %.2f%%, U: %.2f%%)\nMin.: %.2f%%, max.: %.2f%%\n%s
+    PhInitFormatF(&format[0], (DOUBLE)cpuTotal * 100, 2);
+    PhInitFormatS(&format[1], L"% (K: ");
+    PhInitFormatF(&format[2], (DOUBLE)cpuKernel * 100, 2);
+    PhInitFormatS(&format[3], L"%, U: ");
+    PhInitFormatF(&format[4], (DOUBLE)max(cpuTotal - cpuKernel, 0) * 100, 2);
+    PhInitFormatS(&format[5], L"%)");
+    PhInitFormatS(&format[6], L"\nMin.: ");
+    PhInitFormatF(&format[7], (DOUBLE)PhGetItemHistoryBuffer(&PhCpusTotalHistoryLevels[Index], level, MinimumHistoryAggregate, ItemIndex) * 100, 2);
+    PhInitFormatS(&format[8], L"%, max.: ");
+    PhInitFormatF(&format[9], (DOUBLE)PhGetItemHistoryBuffer(&PhCpusTotalHistoryLevels[Index], level, MaximumHistoryAggregate, ItemIndex) * 100, 2);
+    PhInitFormatC(&format[10], L'%');
+    PhInitFormatC(&format[11], L'\n');
+    PhInitFormatSR(&format[12], timeString->sr);
+
+    PhMoveReference(&timeString, PhFormat(format, RTL_NUMBER_OF(format), 160));
+
+    return timeString;
+}
+
 VOID PhSipUpdateCpuGraphs(
     VOID
     )
@@ -756,7 +906,11 @@ VOID PhSipUpdateCpuGraphs(
     {
         CpusGraphState[i].Valid = FALSE;
         CpusGraphState[i].TooltipIndex = ULONG_MAX;
-        Graph_MoveGrid(CpusGraphHandle[i], 1);
+
+        // At a coarser level the graph only advances when a new item is completed.
+        if (CpusHistoryLevel == 0 || PhGetSampleIndexHistoryBuffer(&PhCpusTotalHistoryLevels[i], CpusHistoryLevel - 1, 0) == 0)
+            Graph_MoveGrid(CpusGraphHandle[i], 1);
+
         Graph_Draw(CpusGraphHandle[i]);
         Graph_UpdateTooltip(CpusGraphHandle[i]);
         InvalidateRect(CpusGraphHandle[i], NULL, FALSE);
@@ -0,0 +1,749 @@
+/*
+ * Process Hacker -
+ *   binary log
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The binary log stores fixed-size records in a memory-mapped file, or in memory backed by the
+ * paging file if no file name is given.
+ *
+ * Writers never block each other. A record and any new strings it needs are reserved in the
+ * current segment with a single compare-exchange on the segment's allocation word. The record
+ * is then filled in and published by setting its type. Only switching to the next segment, which
+ * happens when the current segment is full, takes a lock.
+ *
+ * Strings are stored once per segment; a small lock-free hash table in the segment header maps
+ * string contents to their offsets. If two writers store the same new string at the same time,
+ * one copy simply remains unused.
+ *
+ * Readers do not take any locks either. A reader copies a record and its strings, then checks
+ * that the segment was not reused in the meantime.
+ */
+
+#include <phbase.h>
+#include <binlog.h>
+
+#define PH_BINARY_LOG_DATA_OFFSET ((ULONG)ALIGN_UP_BY(sizeof(PH_BINARY_LOG_SEGMENT_HEADER), 64))
+#define PH_BINARY_LOG_INTERN_PROBES 8
+
+#define PhpMakeBinaryLogAllocation(RecordEnd, StringStart) ((LONG64)(((ULONG64)(StringStart) << 32) | (RecordEnd)))
+
+C_ASSERT(sizeof(PH_BINARY_LOG_RECORD) == 48);
+
+FORCEINLINE PPH_BINARY_LOG_SEGMENT_HEADER PhpGetBinaryLogSegment(
+    _In_ PPH_BINARY_LOG Log,
+    _In_ ULONG Index
+    )
+{
+    return (PPH_BINARY_LOG_SEGMENT_HEADER)PTR_ADD_OFFSET(Log->FirstSegment, (SIZE_T)Index << Log->SegmentShift);
+}
+
+FORCEINLINE ULONG PhpGetBinaryLogRecordCount(
+    _In_ PPH_BINARY_LOG_SEGMENT_HEADER Segment
+    )
+{
+    return ((ULONG)Segment->Allocation - PH_BINARY_LOG_DATA_OFFSET) / sizeof(PH_BINARY_LOG_RECORD);
+}
+
+FORCEINLINE ULONG PhpGetBinaryLogStringSize(
+    _In_ PPH_STRINGREF String
+    )
+{
+    return (ULONG)ALIGN_UP_BY(sizeof(ULONG) + String->Length, 8);
+}
+
+/**
+ * Prepares a segment to receive records.
+ *
+ * \param Log A binary log.
+ * \param Index The index of the segment.
+ * \param FirstSequence The sequence number of the first record in the segment.
+ */
+static VOID PhpResetBinaryLogSegment(
+    _Inout_ PPH_BINARY_LOG Log,
+    _In_ ULONG Index,
+    _In_ ULONG64 FirstSequence
+    )
+{
+    PPH_BINARY_LOG_SEGMENT_HEADER segment;
+    ULONG recordEnd;
+
+    segment = PhpGetBinaryLogSegment(Log, Index);
+
+    // Make readers ignore the segment while its contents are inconsistent.
+    segment->FirstSequence = MAXULONG64;
+    MemoryBarrier();
+
+    // Records are published by setting their type, so the old records must be cleared before
+    // slots can be reserved again.
+    recordEnd = (ULONG)segment->Allocation;
+    memset(PTR_ADD_OFFSET(segment, PH_BINARY_LOG_DATA_OFFSET), 0, recordEnd - PH_BINARY_LOG_DATA_OFFSET);
+    memset((PVOID)segment->InternTable, 0, sizeof(segment->InternTable));
+
+    segment->Magic = PH_BINARY_LOG_MAGIC;
+    segment->Allocation = PhpMakeBinaryLogAllocation(PH_BINARY_LOG_DATA_OFFSET, Log->SegmentSize);
+    MemoryBarrier();
+    segment->FirstSequence = FirstSequence;
+}
+
+/**
+ * Marks a segment as unused without touching its contents.
+ */
+static VOID PhpInvalidateBinaryLogSegment(
+    _Inout_ PPH_BINARY_LOG_SEGMENT_HEADER Segment
+    )
+{
+    Segment->FirstSequence = MAXULONG64;
+    Segment->Magic = PH_BINARY_LOG_MAGIC;
+    Segment->Allocation = PhpMakeBinaryLogAllocation(PH_BINARY_LOG_DATA_OFFSET, PH_BINARY_LOG_DATA_OFFSET);
+}
+
+static BOOLEAN PhpIsValidBinaryLogSegment(
+    _In_ PPH_BINARY_LOG Log,
+    _In_ PPH_BINARY_LOG_SEGMENT_HEADER Segment
+    )
+{
+    ULONG recordEnd;
+    ULONG stringStart;
+
+    if (Segment->Magic != PH_BINARY_LOG_MAGIC)
+        return FALSE;
+
+    recordEnd = (ULONG)Segment->Allocation;
+    stringStart = (ULONG)((ULONG64)Segment->Allocation >> 32);
+
+    return
+        recordEnd >= PH_BINARY_LOG_DATA_OFFSET &&
+        recordEnd <= stringStart &&
+        stringStart <= Log->SegmentSize &&
+        (recordEnd - PH_BINARY_LOG_DATA_OFFSET) % sizeof(PH_BINARY_LOG_RECORD) == 0;
+}
+
+/**
+ * Closes the current segment and starts writing to the next one. The rotate lock must be held.
+ */
+static VOID PhpSwitchBinaryLogSegment(
+    _Inout_ PPH_BINARY_LOG Log
+    )
+{
+    PPH_BINARY_LOG_SEGMENT_HEADER segment;
+    LONG64 allocation;
+    LONG64 sealedAllocation;
+    ULONG nextIndex;
+
+    segment = PhpGetBinaryLogSegment(Log, Log->CurrentSegment);
+
+    // Seal the segment so that no more records can be reserved in it. Otherwise a small record
+    // could still fit after the next segment's first sequence number has been decided.
+
+    do
+    {
+        allocation = segment->Allocation;
+        sealedAllocation = PhpMakeBinaryLogAllocation((ULONG)allocation, (ULONG)allocation);
+    } while (_InterlockedCompareExchange64(&segment->Allocation, sealedAllocation, allocation) != allocation);
+
+    nextIndex = (Log->CurrentSegment + 1) % Log->NumberOfSegments;
+    PhpResetBinaryLogSegment(Log, nextIndex, segment->FirstSequence + PhpGetBinaryLogRecordCount(segment));
+    _InterlockedExchange((volatile LONG *)&Log->CurrentSegment, nextIndex);
+}
+
+static VOID PhpRotateBinaryLog(
+    _Inout_ PPH_BINARY_LOG Log,
+    _In_ ULONG FullSegment
+    )
+{
+    PhAcquireQueuedLockExclusive(&Log->RotateLock);
+
+    // Another writer may have already switched segments.
+    if (Log->CurrentSegment == FullSegment)
+        PhpSwitchBinaryLogSegment(Log);
+
+    PhReleaseQueuedLockExclusive(&Log->RotateLock);
+}
+
+/**
+ * Creates or opens a binary log.
+ *
+ * \param Log A variable which receives the binary log.
+ * \param FileName The file name of the log. If NULL, the log is kept in memory backed by the
+ * paging file.
+ * \param SegmentShift The base-2 logarithm of the size of each segment. This value must be
+ * between 16 and 28, inclusive.
+ * \param NumberOfSegments The number of segments. This value must be at least 2.
+ *
+ * \remarks If the file exists but was created with different parameters, its contents are
+ * discarded.
+ */
+NTSTATUS PhCreateBinaryLog(
+    _Out_ PPH_BINARY_LOG *Log,
+    _In_opt_ PWSTR FileName,
+    _In_ ULONG SegmentShift,
+    _In_ ULONG NumberOfSegments
+    )
+{
+    NTSTATUS status;
+    PPH_BINARY_LOG log;
+    LARGE_INTEGER fileSize;
+    LARGE_INTEGER sectionSize;
+    SIZE_T viewSize;
+    PPH_BINARY_LOG_FILE_HEADER header;
+    BOOLEAN creating;
+    ULONG i;
+
+    if (SegmentShift < 16 || SegmentShift > 28 || NumberOfSegments < 2)
+        return STATUS_INVALID_PARAMETER;
+    if (((ULONG64)NumberOfSegments << SegmentShift) > 0x40000000)
+        return STATUS_INVALID_PARAMETER;
+
+    log = PhAllocateZero(sizeof(PH_BINARY_LOG));
+    log->SegmentShift = SegmentShift;
+    log->SegmentSize = 1 << SegmentShift;
+    log->NumberOfSegments = NumberOfSegments;
+    PhInitializeQueuedLock(&log->RotateLock);
+
+    sectionSize.QuadPart = PAGE_SIZE + ((ULONG64)NumberOfSegments << SegmentShift);
+    creating = TRUE;
+
+    if (FileName)
+    {
+        // Don't allow other writers; a second instance should fall back to its own log.
+        status = PhCreateFileWin32(
+            &log->FileHandle,
+            FileName,
+            FILE_GENERIC_READ | FILE_GENERIC_WRITE,
+            FILE_ATTRIBUTE_NORMAL,
+            FILE_SHARE_READ,
+            FILE_OPEN_IF,
+            FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+            );
+
+        if (!NT_SUCCESS(status))
+            goto CleanupExit;
+
+        if (!NT_SUCCESS(status = PhGetFileSize(log->FileHandle, &fileSize)))
+            goto CleanupExit;
+
+        if (fileSize.QuadPart == sectionSize.QuadPart)
+        {
+            creating = FALSE;
+        }
+        else
+        {
+            // Truncate the file first so that the extended file is zero-filled.
+            fileSize.QuadPart = 0;
+
+            if (!NT_SUCCESS(status = PhSetFileSize(log->FileHandle, &fileSize)))
+                goto CleanupExit;
+            if (!NT_SUCCESS(status = PhSetFileSize(log->FileHandle, &sectionSize)))
+                goto CleanupExit;
+        }
+    }
+
+    status = NtCreateSection(
+        &log->SectionHandle,
+        SECTION_ALL_ACCESS,
+        NULL,
+        &sectionSize,
+        PAGE_READWRITE,
+        SEC_COMMIT,
+        log->FileHandle
+        );
+
+    if (!NT_SUCCESS(status))
+        goto CleanupExit;
+
+    viewSize = 0;
+    status = NtMapViewOfSection(
+        log->SectionHandle,
+        NtCurrentProcess(),
+        &log->ViewBase,
+        0,
+        0,
+        NULL,
+        &viewSize,
+        ViewUnmap,
+        0,
+        PAGE_READWRITE
+        );
+
+    if (!NT_SUCCESS(status))
+        goto CleanupExit;
+
+    header = log->ViewBase;
+    log->FirstSegment = PTR_ADD_OFFSET(log->ViewBase, PAGE_SIZE);
+
+    if (!creating && (
+        header->Magic != PH_BINARY_LOG_MAGIC ||
+        header->Version != PH_BINARY_LOG_VERSION ||
+        header->SegmentShift != SegmentShift ||
+        header->NumberOfSegments != NumberOfSegments
+        ))
+    {
+        memset(log->ViewBase, 0, (SIZE_T)sectionSize.QuadPart);
+        creating = TRUE;
+    }
+
+    if (creating)
+    {
+        header->Magic = PH_BINARY_LOG_MAGIC;
+        header->Version = PH_BINARY_LOG_VERSION;
+        header->SegmentShift = SegmentShift;
+        header->NumberOfSegments = NumberOfSegments;
+
+        for (i = 0; i < NumberOfSegments; i++)
+            PhpInvalidateBinaryLogSegment(PhpGetBinaryLogSegment(log, i));
+
+        log->CurrentSegment = 0;
+        PhpResetBinaryLogSegment(log, 0, 0);
+    }
+    else
+    {
+        ULONG64 lastSequence = 0;
+        BOOLEAN found = FALSE;
+
+        // Continue writing to the newest segment.
+
+        for (i = 0; i < NumberOfSegments; i++)
+        {
+            PPH_BINARY_LOG_SEGMENT_HEADER segment = PhpGetBinaryLogSegment(log, i);
+
+            if (!PhpIsValidBinaryLogSegment(log, segment))
+            {
+                memset(segment, 0, log->SegmentSize);
+                PhpInvalidateBinaryLogSegment(segment);
+                continue;
+            }
+
+            if (segment->FirstSequence != MAXULONG64 && (!found || segment->FirstSequence > lastSequence))
+            {
+                log->CurrentSegment = i;
+                lastSequence = segment->FirstSequence;
+                found = TRUE;
+            }
+        }
+
+        if (!found)
+        {
+            log->CurrentSegment = 0;
+            PhpResetBinaryLogSegment(log, 0, 0);
+        }
+    }
+
+CleanupExit:
+    if (NT_SUCCESS(status))
+        *Log = log;
+    else
+        PhDestroyBinaryLog(log);
+
+    return status;
+}
+
+/**
+ * Closes a binary log.
+ *
+ * \param Log A binary log.
+ */
+VOID PhDestroyBinaryLog(
+    _In_ _Post_invalid_ PPH_BINARY_LOG Log
+    )
+{
+    if (Log->ViewBase)
+        NtUnmapViewOfSection(NtCurrentProcess(), Log->ViewBase);
+    if (Log->SectionHandle)
+        NtClose(Log->SectionHandle);
+    if (Log->FileHandle)
+        NtClose(Log->FileHandle);
+
+    PhFree(Log);
+}
+
+/**
+ * Removes all records from a binary log. Sequence numbers are not reused.
+ *
+ * \param Log A binary log.
+ */
+VOID PhClearBinaryLog(
+    _Inout_ PPH_BINARY_LOG Log
+    )
+{
+    ULONG i;
+
+    PhAcquireQueuedLockExclusive(&Log->RotateLock);
+
+    PhpSwitchBinaryLogSegment(Log);
+
+    for (i = 0; i < Log->NumberOfSegments; i++)
+    {
+        if (i != Log->CurrentSegment)
+            PhpGetBinaryLogSegment(Log, i)->FirstSequence = MAXULONG64;
+    }
+
+    PhReleaseQueuedLockExclusive(&Log->RotateLock);
+}
+
+static ULONG PhpFindBinaryLogString(
+    _In_ PPH_BINARY_LOG Log,
+    _In_ PPH_BINARY_LOG_SEGMENT_HEADER Segment,
+    _In_ PPH_STRINGREF String,
+    _In_ ULONG Hash
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < PH_BINARY_LOG_INTERN_PROBES; i++)
+    {
+        LONG64 entry;
+        ULONG offset;
+        PULONG length;
+
+        entry = Segment->InternTable[(Hash + i) & (PH_BINARY_LOG_INTERN_COUNT - 1)];
+
+        if (!entry)
+            break;
+        if ((ULONG)((ULONG64)entry >> 32) != Hash)
+            continue;
+
+        offset = (ULONG)entry;
+
+        if (offset > Log->SegmentSize - sizeof(ULONG))
+            continue;
+
+        length = PTR_ADD_OFFSET(Segment, offset);
+
+        if (*length == String->Length && *length <= Log->SegmentSize - offset - sizeof(ULONG) &&
+            memcmp(length + 1, String->Buffer, String->Length) == 0)
+        {
+            return offset;
+        }
+    }
+
+    return 0;
+}
+
+static VOID PhpAddBinaryLogString(
+    _In_ PPH_BINARY_LOG_SEGMENT_HEADER Segment,
+    _In_ ULONG Offset,
+    _In_ ULONG Hash
+    )
+{
+    LONG64 entry = PhpMakeBinaryLogAllocation(Offset, Hash);
+    ULONG i;
+
+    for (i = 0; i < PH_BINARY_LOG_INTERN_PROBES; i++)
+    {
+        if (_InterlockedCompareExchange64(&Segment->InternTable[(Hash + i) & (PH_BINARY_LOG_INTERN_COUNT - 1)], entry, 0) == 0)
+            break;
+    }
+}
+
+/**
+ * Appends a record to a binary log. This function may be called from any number of threads at
+ * the same time.
+ *
+ * \param Log A binary log.
+ * \param Record The record to append. The Type field must not be zero, and the Strings field is
+ * ignored.
+ * \param Strings An array of PH_BINARY_LOG_STRING_COUNT strings to store with the record. Entries
+ * may be NULL.
+ * \param Sequence A variable which receives the sequence number of the record.
+ */
+NTSTATUS PhWriteBinaryLog(
+    _Inout_ PPH_BINARY_LOG Log,
+    _In_ PPH_BINARY_LOG_RECORD Record,
+    _In_reads_opt_(PH_BINARY_LOG_STRING_COUNT) PPH_STRINGREF *Strings,
+    _Out_opt_ PULONG64 Sequence
+    )
+{
+    PH_STRINGREF strings[PH_BINARY_LOG_STRING_COUNT];
+    ULONG hashes[PH_BINARY_LOG_STRING_COUNT];
+    ULONG offsets[PH_BINARY_LOG_STRING_COUNT];
+    BOOLEAN added[PH_BINARY_LOG_STRING_COUNT];
+    PPH_BINARY_LOG_SEGMENT_HEADER segment;
+    ULONG64 firstSequence;
+    ULONG recordEnd;
+    ULONG stringStart;
+    ULONG stringOffset;
+    PPH_BINARY_LOG_RECORD record;
+    ULONG i;
+    ULONG j;
+
+    if (Record->Type == 0)
+        return STATUS_INVALID_PARAMETER;
+
+    for (i = 0; i < PH_BINARY_LOG_STRING_COUNT; i++)
+    {
+        if (Strings && Strings[i] && Strings[i]->Length != 0)
+        {
+            strings[i] = *Strings[i];
+
+            if (strings[i].Length > PH_BINARY_LOG_MAXIMUM_STRING_LENGTH)
+                strings[i].Length = PH_BINARY_LOG_MAXIMUM_STRING_LENGTH;
+
+            hashes[i] = PhHashStringRef(&strings[i], FALSE);
+        }
+        else
+        {
+            strings[i].Length = 0;
+            hashes[i] = 0;
+        }
+    }
+
+    while (TRUE)
+    {
+        LONG64 allocation;
+        LONG64 newAllocation;
+        ULONG segmentIndex;
+        ULONG stringsSize;
+        BOOLEAN full;
+
+        segmentIndex = Log->CurrentSegment;
+        segment = PhpGetBinaryLogSegment(Log, segmentIndex);
+        firstSequence = segment->FirstSequence;
+
+        // Look for strings that are already stored in this segment.
+
+        stringsSize = 0;
+
+        for (i = 0; i < PH_BINARY_LOG_STRING_COUNT; i++)
+        {
+            offsets[i] = 0;
+            added[i] = FALSE;
+
+            if (strings[i].Length == 0)
+                continue;
+
+            if (offsets[i] = PhpFindBinaryLogString(Log, segment, &strings[i], hashes[i]))
+                continue;
+
+            for (j = 0; j < i; j++)
+            {
+                if (added[j] && hashes[j] == hashes[i] && PhEqualStringRef(&strings[j], &strings[i], FALSE))
+                    break;
+            }
+
+            if (j == i)
+            {
+                added[i] = TRUE;
+                stringsSize += PhpGetBinaryLogStringSize(&strings[i]);
+            }
+        }
+
+        // Reserve the record and the new strings.
+
+        full = FALSE;
+
+        do
+        {
+            allocation = segment->Allocation;
+            recordEnd = (ULONG)allocation;
+            stringStart = (ULONG)((ULONG64)allocation >> 32);
+
+            if (stringStart - recordEnd < sizeof(PH_BINARY_LOG_RECORD) + stringsSize)
+            {
+                full = TRUE;
+                break;
+            }
+
+            newAllocation = PhpMakeBinaryLogAllocation(recordEnd + sizeof(PH_BINARY_LOG_RECORD), stringStart - stringsSize);
+        } while (_InterlockedCompareExchange64(&segment->Allocation, newAllocation, allocation) != allocation);
+
+        if (!full)
+            break;
+
+        PhpRotateBinaryLog(Log, segmentIndex);
+    }
+
+    // Write the new strings.
+
+    // The new strings occupy the reserved space just below the old string start.
+    stringOffset = stringStart;
+
+    for (i = 0; i < PH_BINARY_LOG_STRING_COUNT; i++)
+    {
+        if (!added[i])
+            continue;
+
+        stringOffset -= PhpGetBinaryLogStringSize(&strings[i]);
+        *(PULONG)PTR_ADD_OFFSET(segment, stringOffset) = (ULONG)strings[i].Length;
+        memcpy(PTR_ADD_OFFSET(segment, stringOffset + sizeof(ULONG)), strings[i].Buffer, strings[i].Length);
+        offsets[i] = stringOffset;
+    }
+
+    // Duplicate strings within the record share the first copy.
+
+    for (i = 0; i < PH_BINARY_LOG_STRING_COUNT; i++)
+    {
+        if (strings[i].Length != 0 && offsets[i] == 0)
+        {
+            for (j = 0; j < i; j++)
+            {
+                if (added[j] && hashes[j] == hashes[i] && PhEqualStringRef(&strings[j], &strings[i], FALSE))
+                {
+                    offsets[i] = offsets[j];
+                    break;
+                }
+            }
+        }
+    }
+
+    // Write the record, then publish it.
+
+    record = PTR_ADD_OFFSET(segment, recordEnd);
+    record->Flags = Record->Flags;
+    record->Time = Record->Time;
+    memcpy(record->Values, Record->Values, sizeof(record->Values));
+    memcpy(record->Strings, offsets, sizeof(record->Strings));
+    MemoryBarrier();
+    _InterlockedExchange((volatile LONG *)&record->Type, Record->Type);
+
+    for (i = 0; i < PH_BINARY_LOG_STRING_COUNT; i++)
+    {
+        if (added[i])
+            PhpAddBinaryLogString(segment, offsets[i], hashes[i]);
+    }
+
+    if (Sequence)
+        *Sequence = firstSequence + (recordEnd - PH_BINARY_LOG_DATA_OFFSET) / sizeof(PH_BINARY_LOG_RECORD);
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * Gets the range of sequence numbers in a binary log.
+ *
+ * \param Log A binary log.
+ * \param FirstSequence A variable which receives the sequence number of the oldest record.
+ * \param NextSequence A variable which receives the sequence number that will be assigned to
+ * the next record.
+ */
+VOID PhQueryBinaryLogRange(
+    _In_ PPH_BINARY_LOG Log,
+    _Out_ PULONG64 FirstSequence,
+    _Out_ PULONG64 NextSequence
+    )
+{
+    PPH_BINARY_LOG_SEGMENT_HEADER segment;
+    ULONG64 firstSequence;
+    ULONG64 nextSequence;
+    ULONG i;
+
+    segment = PhpGetBinaryLogSegment(Log, Log->CurrentSegment);
+    nextSequence = segment->FirstSequence + PhpGetBinaryLogRecordCount(segment);
+    firstSequence = nextSequence;
+
+    for (i = 0; i < Log->NumberOfSegments; i++)
+    {
+        ULONG64 sequence = PhpGetBinaryLogSegment(Log, i)->FirstSequence;
+
+        if (sequence != MAXULONG64 && sequence < firstSequence)
+            firstSequence = sequence;
+    }
+
+    *FirstSequence = firstSequence;
+    *NextSequence = nextSequence;
+}
+
+/**
+ * Reads a record from a binary log.
+ *
+ * \param Log A binary log.
+ * \param Sequence The sequence number of the record.
+ * \param Record A variable which receives a copy of the record.
+ * \param Strings An array of PH_BINARY_LOG_STRING_COUNT variables which receive the strings of
+ * the record. Entries for strings that are not present are set to NULL. You must free each string
+ * using PhDereferenceObject() when you no longer need it.
+ *
+ * \return STATUS_NOT_FOUND if the record has been overwritten, has not been completely written
+ * yet or does not exist.
+ */
+NTSTATUS PhReadBinaryLog(
+    _In_ PPH_BINARY_LOG Log,
+    _In_ ULONG64 Sequence,
+    _Out_ PPH_BINARY_LOG_RECORD Record,
+    _Out_writes_opt_(PH_BINARY_LOG_STRING_COUNT) PPH_STRING *Strings
+    )
+{
+    ULONG i;
+    ULONG j;
+
+    for (i = 0; i < Log->NumberOfSegments; i++)
+    {
+        PPH_BINARY_LOG_SEGMENT_HEADER segment;
+        ULONG64 firstSequence;
+        PPH_BINARY_LOG_RECORD record;
+        ULONG type;
+
+        segment = PhpGetBinaryLogSegment(Log, i);
+        firstSequence = segment->FirstSequence;
+
+        if (firstSequence == MAXULONG64 || Sequence < firstSequence)
+            continue;
+        if (Sequence - firstSequence >= PhpGetBinaryLogRecordCount(segment))
+            continue;
+
+        record = PTR_ADD_OFFSET(segment, PH_BINARY_LOG_DATA_OFFSET + (ULONG)(Sequence - firstSequence) * sizeof(PH_BINARY_LOG_RECORD));
+        type = record->Type;
+
+        if (type == 0)
+            return STATUS_NOT_FOUND;
+
+        MemoryBarrier();
+        memcpy(Record, record, sizeof(PH_BINARY_LOG_RECORD));
+        Record->Type = type;
+
+        if (Strings)
+        {
+            for (j = 0; j < PH_BINARY_LOG_STRING_COUNT; j++)
+            {
+                ULONG offset = Record->Strings[j];
+                ULONG length;
+
+                Strings[j] = NULL;
+
+                if (offset < PH_BINARY_LOG_DATA_OFFSET || offset > Log->SegmentSize - sizeof(ULONG))
+                    continue;
+
+                length = *(PULONG)PTR_ADD_OFFSET(segment, offset);
+
+                if (length > PH_BINARY_LOG_MAXIMUM_STRING_LENGTH || length > Log->SegmentSize - offset - sizeof(ULONG))
+                    continue;
+
+                Strings[j] = PhCreateStringEx(PTR_ADD_OFFSET(segment, offset + sizeof(ULONG)), length & ~1);
+            }
+        }
+
+        // Make sure the segment wasn't reused while we were copying.
+
+        MemoryBarrier();
+
+        if (segment->FirstSequence != firstSequence)
+        {
+            if (Strings)
+            {
+                for (j = 0; j < PH_BINARY_LOG_STRING_COUNT; j++)
+                    PhClearReference(&Strings[j]);
+            }
+
+            return STATUS_NOT_FOUND;
+        }
+
+        return STATUS_SUCCESS;
+    }
+
+    return STATUS_NOT_FOUND;
+}
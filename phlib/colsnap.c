@@ -0,0 +1,474 @@
+/*
+ * Process Hacker -
+ *   columnar snapshots
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The snapshot writer encodes values as rows are added, so each column only holds its compressed
+ * data and dictionary until the snapshot is written. The columns of a table are defined by the
+ * names and types of the values in its first row, and every later row must add the same columns
+ * in the same order.
+ *
+ * Dictionary lookups avoid temporary allocations: a string is converted to UTF-8 directly at the
+ * end of the column's dictionary and looked up there. If the string already exists, the new copy
+ * is simply removed again.
+ */
+
+#include <phbase.h>
+#include <colsnap.h>
+
+C_ASSERT(sizeof(PH_SNAPSHOT_HEADER) == 32);
+C_ASSERT(sizeof(PH_SNAPSHOT_TABLE_HEADER) == 32);
+C_ASSERT(sizeof(PH_SNAPSHOT_COLUMN_HEADER) == 48);
+
+typedef struct _PH_SNAPSHOT_COLUMN
+{
+    CHAR Name[PH_SNAPSHOT_COLUMN_NAME_SIZE];
+    ULONG Type;
+    PH_BYTES_BUILDER Data;
+    LONG64 PreviousValue;
+
+    // String columns only
+    PPH_HASHTABLE DictionaryHashtable;
+    PH_BYTES_BUILDER Dictionary;
+    ULONG NumberOfDictionaryEntries;
+} PH_SNAPSHOT_COLUMN, *PPH_SNAPSHOT_COLUMN;
+
+typedef struct _PH_SNAPSHOT_DICTIONARY_ENTRY
+{
+    PPH_SNAPSHOT_COLUMN Column;
+    ULONG Offset;
+    ULONG Length;
+    ULONG Hash;
+    ULONG Index;
+} PH_SNAPSHOT_DICTIONARY_ENTRY, *PPH_SNAPSHOT_DICTIONARY_ENTRY;
+
+typedef struct _PH_SNAPSHOT_TABLE
+{
+    CHAR Name[PH_SNAPSHOT_TABLE_NAME_SIZE];
+    ULONG NumberOfRows;
+    PPH_LIST Columns;
+} PH_SNAPSHOT_TABLE, *PPH_SNAPSHOT_TABLE;
+
+typedef struct _PH_SNAPSHOT_WRITER
+{
+    PPH_LIST Tables;
+    PPH_SNAPSHOT_TABLE CurrentTable;
+    ULONG CurrentColumn;
+} PH_SNAPSHOT_WRITER, *PPH_SNAPSHOT_WRITER;
+
+static BOOLEAN NTAPI PhpSnapshotDictionaryEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PPH_SNAPSHOT_DICTIONARY_ENTRY entry1 = Entry1;
+    PPH_SNAPSHOT_DICTIONARY_ENTRY entry2 = Entry2;
+    PCHAR buffer = entry1->Column->Dictionary.Bytes->Buffer;
+
+    return
+        entry1->Hash == entry2->Hash &&
+        entry1->Length == entry2->Length &&
+        memcmp(buffer + entry1->Offset, buffer + entry2->Offset, entry1->Length) == 0;
+}
+
+static ULONG NTAPI PhpSnapshotDictionaryHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return ((PPH_SNAPSHOT_DICTIONARY_ENTRY)Entry)->Hash;
+}
+
+static VOID PhpCopySnapshotName(
+    _Out_writes_(Size) PCHAR Destination,
+    _In_ PSTR Name,
+    _In_ SIZE_T Size
+    )
+{
+    SIZE_T length;
+
+    length = strlen(Name);
+    assert(length <= Size);
+
+    memset(Destination, 0, Size);
+    memcpy(Destination, Name, min(length, Size));
+}
+
+static VOID PhpTruncateBytesBuilder(
+    _Inout_ PPH_BYTES_BUILDER BytesBuilder,
+    _In_ SIZE_T Length
+    )
+{
+    BytesBuilder->Bytes->Length = Length;
+    BytesBuilder->Bytes->Buffer[Length] = ANSI_NULL;
+}
+
+static VOID PhpAppendSnapshotVarint(
+    _Inout_ PPH_BYTES_BUILDER BytesBuilder,
+    _In_ ULONG64 Value
+    )
+{
+    UCHAR buffer[10];
+    ULONG length = 0;
+
+    while (Value >= 0x80)
+    {
+        buffer[length++] = (UCHAR)Value | 0x80;
+        Value >>= 7;
+    }
+
+    buffer[length++] = (UCHAR)Value;
+
+    PhAppendBytesBuilderEx(BytesBuilder, buffer, length, 0, NULL);
+}
+
+static PPH_SNAPSHOT_COLUMN PhpCreateSnapshotColumn(
+    _In_ PSTR Name,
+    _In_ ULONG Type
+    )
+{
+    PPH_SNAPSHOT_COLUMN column;
+
+    column = PhAllocate(sizeof(PH_SNAPSHOT_COLUMN));
+    memset(column, 0, sizeof(PH_SNAPSHOT_COLUMN));
+    PhpCopySnapshotName(column->Name, Name, sizeof(column->Name));
+    column->Type = Type;
+    PhInitializeBytesBuilder(&column->Data, 0x100);
+
+    if (Type == PH_SNAPSHOT_COLUMN_STRING)
+    {
+        column->DictionaryHashtable = PhCreateHashtable(
+            sizeof(PH_SNAPSHOT_DICTIONARY_ENTRY),
+            PhpSnapshotDictionaryEqualFunction,
+            PhpSnapshotDictionaryHashFunction,
+            64
+            );
+        PhInitializeBytesBuilder(&column->Dictionary, 0x400);
+    }
+
+    return column;
+}
+
+static VOID PhpResetSnapshotColumn(
+    _Inout_ PPH_SNAPSHOT_COLUMN Column
+    )
+{
+    PhpTruncateBytesBuilder(&Column->Data, 0);
+    Column->PreviousValue = 0;
+
+    if (Column->Type == PH_SNAPSHOT_COLUMN_STRING)
+    {
+        PhClearHashtable(Column->DictionaryHashtable);
+        PhpTruncateBytesBuilder(&Column->Dictionary, 0);
+        Column->NumberOfDictionaryEntries = 0;
+    }
+}
+
+static VOID PhpDestroySnapshotColumn(
+    _In_ PPH_SNAPSHOT_COLUMN Column
+    )
+{
+    PhDeleteBytesBuilder(&Column->Data);
+
+    if (Column->Type == PH_SNAPSHOT_COLUMN_STRING)
+    {
+        PhDereferenceObject(Column->DictionaryHashtable);
+        PhDeleteBytesBuilder(&Column->Dictionary);
+    }
+
+    PhFree(Column);
+}
+
+/**
+ * Creates a snapshot writer.
+ */
+PPH_SNAPSHOT_WRITER PhCreateSnapshotWriter(
+    VOID
+    )
+{
+    PPH_SNAPSHOT_WRITER writer;
+
+    writer = PhAllocate(sizeof(PH_SNAPSHOT_WRITER));
+    memset(writer, 0, sizeof(PH_SNAPSHOT_WRITER));
+    writer->Tables = PhCreateList(4);
+
+    return writer;
+}
+
+VOID PhDestroySnapshotWriter(
+    _In_ _Post_invalid_ PPH_SNAPSHOT_WRITER Writer
+    )
+{
+    ULONG i;
+    ULONG j;
+
+    for (i = 0; i < Writer->Tables->Count; i++)
+    {
+        PPH_SNAPSHOT_TABLE table = Writer->Tables->Items[i];
+
+        for (j = 0; j < table->Columns->Count; j++)
+            PhpDestroySnapshotColumn(table->Columns->Items[j]);
+
+        PhDereferenceObject(table->Columns);
+        PhFree(table);
+    }
+
+    PhDereferenceObject(Writer->Tables);
+    PhFree(Writer);
+}
+
+/**
+ * Starts a new row in a snapshot table.
+ *
+ * \param Writer A snapshot writer.
+ * \param TableName The name of the table. The table is created if it does not exist.
+ */
+VOID PhBeginSnapshotRow(
+    _Inout_ PPH_SNAPSHOT_WRITER Writer,
+    _In_ PSTR TableName
+    )
+{
+    PPH_SNAPSHOT_TABLE table;
+    ULONG i;
+
+    assert(!Writer->CurrentTable);
+
+    for (i = 0; i < Writer->Tables->Count; i++)
+    {
+        table = Writer->Tables->Items[i];
+
+        if (strncmp(table->Name, TableName, sizeof(table->Name)) == 0)
+            goto TableFound;
+    }
+
+    table = PhAllocate(sizeof(PH_SNAPSHOT_TABLE));
+    PhpCopySnapshotName(table->Name, TableName, sizeof(table->Name));
+    table->NumberOfRows = 0;
+    table->Columns = PhCreateList(16);
+    PhAddItemList(Writer->Tables, table);
+
+TableFound:
+    Writer->CurrentTable = table;
+    Writer->CurrentColumn = 0;
+}
+
+static PPH_SNAPSHOT_COLUMN PhpGetNextSnapshotColumn(
+    _Inout_ PPH_SNAPSHOT_WRITER Writer,
+    _In_ PSTR Name,
+    _In_ ULONG Type
+    )
+{
+    PPH_SNAPSHOT_TABLE table = Writer->CurrentTable;
+    PPH_SNAPSHOT_COLUMN column;
+
+    if (Writer->CurrentColumn < table->Columns->Count)
+    {
+        column = table->Columns->Items[Writer->CurrentColumn];
+        assert(column->Type == Type && strncmp(column->Name, Name, sizeof(column->Name)) == 0);
+    }
+    else
+    {
+        // Columns can't be added once the table has rows, because the existing rows would have no
+        // value for them.
+        assert(table->NumberOfRows == 0);
+
+        column = PhpCreateSnapshotColumn(Name, Type);
+        PhAddItemList(table->Columns, column);
+    }
+
+    Writer->CurrentColumn++;
+
+    return column;
+}
+
+VOID PhAddSnapshotInteger(
+    _Inout_ PPH_SNAPSHOT_WRITER Writer,
+    _In_ PSTR ColumnName,
+    _In_ LONG64 Value
+    )
+{
+    PPH_SNAPSHOT_COLUMN column;
+    ULONG64 delta;
+
+    column = PhpGetNextSnapshotColumn(Writer, ColumnName, PH_SNAPSHOT_COLUMN_INTEGER);
+
+    delta = (ULONG64)Value - (ULONG64)column->PreviousValue;
+    column->PreviousValue = Value;
+
+    // Zigzag encoding maps small negative differences to small unsigned values.
+    PhpAppendSnapshotVarint(&column->Data, (delta << 1) ^ (ULONG64)((LONG64)delta >> 63));
+}
+
+/**
+ * Adds a string value to the current row.
+ *
+ * \param Writer A snapshot writer.
+ * \param ColumnName The name of the column.
+ * \param Value The string, or NULL if the value is missing. A missing string is distinct from an
+ * empty string.
+ */
+VOID PhAddSnapshotString(
+    _Inout_ PPH_SNAPSHOT_WRITER Writer,
+    _In_ PSTR ColumnName,
+    _In_opt_ PPH_STRINGREF Value
+    )
+{
+    PPH_SNAPSHOT_COLUMN column;
+    PH_SNAPSHOT_DICTIONARY_ENTRY lookupEntry;
+    PPH_SNAPSHOT_DICTIONARY_ENTRY entry;
+    SIZE_T startLength;
+    SIZE_T length;
+    SIZE_T offset;
+    PCHAR buffer;
+    BOOLEAN added;
+
+    column = PhpGetNextSnapshotColumn(Writer, ColumnName, PH_SNAPSHOT_COLUMN_STRING);
+
+    if (!Value)
+    {
+        PhpAppendSnapshotVarint(&column->Data, 0);
+        return;
+    }
+
+    // Append the string to the dictionary, then check whether it was already there.
+
+    PhConvertUtf16ToUtf8Size(&length, Value->Buffer, Value->Length);
+
+    startLength = column->Dictionary.Bytes->Length;
+    PhpAppendSnapshotVarint(&column->Dictionary, length);
+    buffer = PhAppendBytesBuilderEx(&column->Dictionary, NULL, length, 0, &offset);
+    PhConvertUtf16ToUtf8Buffer(buffer, length, NULL, Value->Buffer, Value->Length);
+
+    lookupEntry.Column = column;
+    lookupEntry.Offset = (ULONG)offset;
+    lookupEntry.Length = (ULONG)length;
+    lookupEntry.Hash = PhHashBytes(buffer, length);
+    lookupEntry.Index = column->NumberOfDictionaryEntries;
+
+    entry = PhAddEntryHashtableEx(column->DictionaryHashtable, &lookupEntry, &added);
+
+    if (added)
+        column->NumberOfDictionaryEntries++;
+    else
+        PhpTruncateBytesBuilder(&column->Dictionary, startLength);
+
+    PhpAppendSnapshotVarint(&column->Data, (ULONG64)entry->Index + 1);
+}
+
+VOID PhEndSnapshotRow(
+    _Inout_ PPH_SNAPSHOT_WRITER Writer
+    )
+{
+    assert(Writer->CurrentColumn == Writer->CurrentTable->Columns->Count);
+
+    Writer->CurrentTable->NumberOfRows++;
+    Writer->CurrentTable = NULL;
+}
+
+/**
+ * Writes the rows added since the last snapshot as a new snapshot.
+ *
+ * \param Writer A snapshot writer.
+ * \param Time The time of the snapshot.
+ * \param BytesBuilder A byte string builder to which the snapshot is appended.
+ *
+ * \remarks The tables and their columns are kept, but all rows are removed from the writer.
+ * Tables without rows are not written.
+ */
+VOID PhWriteSnapshot(
+    _Inout_ PPH_SNAPSHOT_WRITER Writer,
+    _In_ LONG64 Time,
+    _Inout_ PPH_BYTES_BUILDER BytesBuilder
+    )
+{
+    PH_SNAPSHOT_HEADER header;
+    SIZE_T headerOffset;
+    ULONG i;
+    ULONG j;
+
+    assert(!Writer->CurrentTable);
+
+    PhAppendBytesBuilderEx(BytesBuilder, NULL, sizeof(PH_SNAPSHOT_HEADER), 0, &headerOffset);
+
+    header.Magic = PH_SNAPSHOT_MAGIC;
+    header.Version = PH_SNAPSHOT_VERSION;
+    header.Time = Time;
+    header.NumberOfTables = 0;
+    header.Reserved = 0;
+
+    for (i = 0; i < Writer->Tables->Count; i++)
+    {
+        PPH_SNAPSHOT_TABLE table = Writer->Tables->Items[i];
+        PH_SNAPSHOT_TABLE_HEADER tableHeader;
+        SIZE_T tableOffset;
+        SIZE_T columnHeadersOffset;
+
+        if (table->NumberOfRows == 0)
+            continue;
+
+        PhAppendBytesBuilderEx(BytesBuilder, NULL, sizeof(PH_SNAPSHOT_TABLE_HEADER), 0, &tableOffset);
+        PhAppendBytesBuilderEx(
+            BytesBuilder,
+            NULL,
+            sizeof(PH_SNAPSHOT_COLUMN_HEADER) * table->Columns->Count,
+            0,
+            &columnHeadersOffset
+            );
+
+        for (j = 0; j < table->Columns->Count; j++)
+        {
+            PPH_SNAPSHOT_COLUMN column = table->Columns->Items[j];
+            PH_SNAPSHOT_COLUMN_HEADER columnHeader;
+
+            memcpy(columnHeader.Name, column->Name, sizeof(columnHeader.Name));
+            columnHeader.Type = column->Type;
+            columnHeader.NumberOfDictionaryEntries = 0;
+            columnHeader.DictionaryLength = 0;
+            columnHeader.DataLength = column->Data.Bytes->Length;
+
+            if (column->Type == PH_SNAPSHOT_COLUMN_STRING)
+            {
+                columnHeader.NumberOfDictionaryEntries = column->NumberOfDictionaryEntries;
+                columnHeader.DictionaryLength = column->Dictionary.Bytes->Length;
+                PhAppendBytesBuilderEx(BytesBuilder, column->Dictionary.Bytes->Buffer, column->Dictionary.Bytes->Length, 0, NULL);
+            }
+
+            PhAppendBytesBuilderEx(BytesBuilder, column->Data.Bytes->Buffer, column->Data.Bytes->Length, 0, NULL);
+
+            memcpy(
+                BytesBuilder->Bytes->Buffer + columnHeadersOffset + sizeof(PH_SNAPSHOT_COLUMN_HEADER) * j,
+                &columnHeader,
+                sizeof(PH_SNAPSHOT_COLUMN_HEADER)
+                );
+
+            PhpResetSnapshotColumn(column);
+        }
+
+        memcpy(tableHeader.Name, table->Name, sizeof(tableHeader.Name));
+        tableHeader.NumberOfRows = table->NumberOfRows;
+        tableHeader.NumberOfColumns = table->Columns->Count;
+        tableHeader.Length = BytesBuilder->Bytes->Length - tableOffset;
+        memcpy(BytesBuilder->Bytes->Buffer + tableOffset, &tableHeader, sizeof(PH_SNAPSHOT_TABLE_HEADER));
+
+        table->NumberOfRows = 0;
+        header.NumberOfTables++;
+    }
+
+    header.Length = BytesBuilder->Bytes->Length - headerOffset;
+    memcpy(BytesBuilder->Bytes->Buffer + headerOffset, &header, sizeof(PH_SNAPSHOT_HEADER));
+}
@@ -46,6 +46,13 @@ typedef struct _PHP_GRAPH_CONTEXT
     PVOID BufferedBits;
     RECT BufferedContextRect;
 
+    PULONG RasterBits; // the graph without the label, text or panel
+    PH_GRAPH_DRAW_INFO RasterDrawInfo; // the information which the raster was drawn from
+    PFLOAT RasterData1;
+    PFLOAT RasterData2;
+    ULONG RasterAllocatedCount;
+    BOOLEAN RasterValid;
+
     HDC FadeOutContext;
     HBITMAP FadeOutOldBitmap;
     HBITMAP FadeOutBitmap;
@@ -91,415 +98,50 @@ BOOLEAN PhGraphControlInitialization(
     return TRUE;
 }
 
-FORCEINLINE VOID PhpGetGraphPoint(
-    _In_ PPH_GRAPH_DRAW_INFO DrawInfo,
-    _In_ ULONG Index,
-    _Out_ PULONG H1,
-    _Out_ PULONG H2
-    )
-{
-    if (Index < DrawInfo->LineDataCount)
-    {
-        FLOAT f1;
-        FLOAT f2;
-
-        f1 = DrawInfo->LineData1[Index];
-
-        if (f1 < 0)
-            f1 = 0;
-        if (f1 > 1)
-            f1 = 1;
-
-        *H1 = (ULONG)(f1 * (DrawInfo->Height - 1));
-
-        if (DrawInfo->Flags & PH_GRAPH_USE_LINE_2)
-        {
-            f2 = f1 + DrawInfo->LineData2[Index];
-
-            if (f2 < 0)
-                f2 = 0;
-            if (f2 > 1)
-                f2 = 1;
-
-            *H2 = (ULONG)(f2 * (DrawInfo->Height - 1));
-        }
-        else
-        {
-            *H2 = *H1;
-        }
-    }
-    else
-    {
-        *H1 = 0;
-        *H2 = 0;
-    }
-}
+#include "graph_i.h"
 
 /**
- * Draws a graph directly to memory.
+ * Draws the maximum label and the text of a graph.
  *
- * \param hdc The DC to draw to. This is only used when drawing text.
- * \param Bits The bits in a bitmap.
+ * \param hdc The DC to draw to.
  * \param DrawInfo A structure which contains graphing information.
- *
- * \remarks The following information is fixed:
- * \li The graph is fixed to the origin (0, 0).
- * \li The total size of the bitmap is assumed to be \a Width and \a Height in \a DrawInfo.
- * \li \a Step is fixed at 2.
- * \li If \ref PH_GRAPH_USE_LINE_2 is specified in \a Flags, \ref PH_GRAPH_OVERLAY_LINE_2 is never
- * used.
  */
-VOID PhDrawGraphDirect(
+static VOID PhpDrawGraphOverlay(
     _In_ HDC hdc,
-    _In_ PVOID Bits,
     _In_ PPH_GRAPH_DRAW_INFO DrawInfo
     )
 {
-    PULONG bits = Bits;
     LONG width = DrawInfo->Width;
     LONG height = DrawInfo->Height;
-    LONG numberOfPixels = width * height;
     ULONG flags = DrawInfo->Flags;
-    LONG i;
-    LONG x;
-
-    BOOLEAN intermediate = FALSE; // whether we are currently between two data positions
-    ULONG dataIndex = 0; // the data index of the current position
-    ULONG h1_i; // the line 1 height value to the left of the current position
-    ULONG h1_o; // the line 1 height value at the current position
-    ULONG h2_i; // the line 1 + line 2 height value to the left of the current position
-    ULONG h2_o; // the line 1 + line 2 height value at the current position
-    ULONG h1; // current pixel
-    ULONG h1_left; // current pixel
-    ULONG h2; // current pixel
-    ULONG h2_left; // current pixel
-
-    LONG mid;
-    LONG h1_low1;
-    LONG h1_high1;
-    LONG h1_low2;
-    LONG h1_high2;
-    LONG h2_low1;
-    LONG h2_high1;
-    LONG h2_low2;
-    LONG h2_high2;
-    LONG old_low2;
-    LONG old_high2;
-
-    ULONG lineColor1;
-    ULONG lineBackColor1;
-    ULONG lineColor2;
-    ULONG lineBackColor2;
-    FLOAT gridHeight;
-    LONG gridYThreshold;
-    ULONG gridYCounter;
-    ULONG gridColor;
-    FLOAT gridBase;
-    FLOAT gridLevel;
-
     ULONG yLabelMax;
     ULONG yLabelDataIndex;
 
-    lineColor1 = COLORREF_TO_BITS(DrawInfo->LineColor1);
-    lineBackColor1 = COLORREF_TO_BITS(DrawInfo->LineBackColor1);
-    lineColor2 = COLORREF_TO_BITS(DrawInfo->LineColor2);
-    lineBackColor2 = COLORREF_TO_BITS(DrawInfo->LineBackColor2);
-
-    if (DrawInfo->BackColor == 0)
-    {
-        memset(bits, 0, (size_t)numberOfPixels * 4);
-    }
-    else
-    {
-        PhFillMemoryUlong(bits, COLORREF_TO_BITS(DrawInfo->BackColor), numberOfPixels);
-    }
-
-    x = width - 1;
-    h1_low2 = MAXLONG;
-    h1_high2 = 0;
-    h2_low2 = MAXLONG;
-    h2_high2 = 0;
-
-    PhpGetGraphPoint(DrawInfo, 0, &h1_i, &h2_i);
-
-    if (flags & (PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y))
-    {
-        gridHeight = max(DrawInfo->GridHeight, 0);
-        gridLevel = gridHeight;
-        gridYThreshold = DrawInfo->GridYThreshold;
-        gridYCounter = DrawInfo->GridWidth - (DrawInfo->GridXOffset * DrawInfo->Step) % DrawInfo->GridWidth - 1;
-        gridColor = COLORREF_TO_BITS(DrawInfo->GridColor);
-    }
-
-    if ((flags & (PH_GRAPH_USE_GRID_Y | PH_GRAPH_LOGARITHMIC_GRID_Y)) == (PH_GRAPH_USE_GRID_Y | PH_GRAPH_LOGARITHMIC_GRID_Y))
-    {
-        // Pre-process to find the largest integer n such that GridHeight*GridBase^n < 1.
-
-        gridBase = DrawInfo->GridBase;
-
-        if (gridBase > 1)
-        {
-            DOUBLE logBase;
-            DOUBLE exponent;
-            DOUBLE high;
-
-            logBase = log(gridBase);
-            exponent = ceil(-log(gridHeight) / logBase) - 1; // Works for both GridHeight > 1 and GridHeight < 1
-            high = exp(exponent * logBase);
-            gridLevel = (FLOAT)(gridHeight * high);
-
-            if (gridLevel < 0 || !isfinite(gridLevel))
-                gridLevel = 0;
-            if (gridLevel > 1)
-                gridLevel = 1;
-        }
-        else
-        {
-            // This is an error.
-            gridLevel = 0;
-        }
-    }
-
     if (flags & PH_GRAPH_LABEL_MAX_Y)
     {
-        yLabelMax = h2_i;
-        yLabelDataIndex = 0;
-    }
-
-    while (x >= 0)
-    {
-        // Calculate the height of the graph at this point.
+        ULONG h1;
+        ULONG h2;
+        ULONG dataIndex;
+        ULONG dataCount;
 
-        if (!intermediate)
-        {
-            h1_o = h1_i;
-            h2_o = h2_i;
-
-            // Pull in new data.
-            dataIndex++;
-            PhpGetGraphPoint(DrawInfo, dataIndex, &h1_i, &h2_i);
-
-            h1 = h1_o;
-            h1_left = (h1_i + h1_o) / 2;
-            h2 = h2_o;
-            h2_left = (h2_i + h2_o) / 2;
-
-            if ((flags & PH_GRAPH_LABEL_MAX_Y) && dataIndex < DrawInfo->LabelMaxYIndexLimit)
-            {
-                if (yLabelMax <= h2_i)
-                {
-                    yLabelMax = h2_i;
-                    yLabelDataIndex = dataIndex;
-                }
-            }
-        }
-        else
-        {
-            h1 = h1_left;
-            h1_left = h1_i;
-            h2 = h2_left;
-            h2_left = h2_i;
-        }
-
-        // The graph is drawn right-to-left. There is one iteration of the loop per horizontal pixel.
-        // There is a fixed step value of 2, so every other iteration is a mid-point (intermediate)
-        // iteration with a height value of (left + right) / 2. In order to rasterize the outline,
-        // effectively in each iteration half of the line is drawn at the current column and the other
-        // half is drawn in the column to the left.
-
-        // Rasterize the data outline.
-        // h?_low2 to h?_high2 is the vertical line to the left of the current pixel.
-        // h?_low1 to h?_high1 is the vertical line at the current pixel.
-        // We merge (union) the old h?_low2 to h?_high2 line with the current line in each iteration.
-        //
-        // For example:
-        //
-        // X represents a data point. M represents the mid-point between two data points ("intermediate").
-        // X, M and x are all part of the outline. # represents the background filled in during
-        // the current loop iteration.
-        //
-        // slope > 0:                                     slope < 0:
-        //
-        //     X  < high1                                   X    < high2 (of next loop iteration)
-        //     x                                            x
-        //     x  < low1                                    x    < low2 (of next loop iteration)
-        //    x#  < high2                                    x   < high1 (of next loop iteration)
-        //    M#  < low2                                     M   < low1 (of next loop iteration)
-        //    x#  < high1 (of next loop iteration)           x   < high2
-        //    x#  < low1 (of next loop iteration)            x   < low2
-        //   x #  < high2 (of next loop iteration)            x  < high1
-        //   x #                                              x
-        //   X #  < low2 (of next loop iteration)             X  < low1
-        //     #                                              #
-        //     ^                                              ^
-        //    ^| current pixel                               ^| current pixel
-        //    |                                              |
-        //    | left of current pixel                        | left of current pixel
-        //
-        // In both examples above, the line low2-high2 will be merged with the line low1-high1 of
-        // the next iteration.
-
-        mid = ((h1_left + h1) / 2) * width;
-        old_low2 = h1_low2;
-        old_high2 = h1_high2;
-
-        if (h1_left < h1) // slope > 0
-        {
-            h1_low2 = h1_left * width;
-            h1_high2 = mid;
-            h1_low1 = mid + width;
-            h1_high1 = h1 * width;
-        }
-        else // slope < 0
-        {
-            h1_high2 = h1_left * width;
-            h1_low2 = mid + width;
-            h1_high1 = mid;
-            h1_low1 = h1 * width;
-        }
+        // Find the highest point among the data points which the rasterizer reads, one for
+        // every two columns.
 
-        // Merge the lines.
-        if (h1_low1 > old_low2)
-            h1_low1 = old_low2;
-        if (h1_high1 < old_high2)
-            h1_high1 = old_high2;
+        dataCount = width > 0 ? (width + 1) / 2 : 0;
 
-        // Fix up values for the current horizontal offset.
-        h1_low1 += x;
-        h1_high1 += x;
-
-        if (flags & PH_GRAPH_USE_LINE_2)
-        {
-            mid = ((h2_left + h2) / 2) * width;
-            old_low2 = h2_low2;
-            old_high2 = h2_high2;
-
-            if (h2_left < h2) // slope > 0
-            {
-                h2_low2 = h2_left * width;
-                h2_high2 = mid;
-                h2_low1 = mid + width;
-                h2_high1 = h2 * width;
-            }
-            else // slope < 0
-            {
-                h2_high2 = h2_left * width;
-                h2_low2 = mid + width;
-                h2_high1 = mid;
-                h2_low1 = h2 * width;
-            }
-
-            // Merge the lines.
-            if (h2_low1 > old_low2)
-                h2_low1 = old_low2;
-            if (h2_high1 < old_high2)
-                h2_high1 = old_high2;
-
-            // Fix up values for the current horizontal offset.
-            h2_low1 += x;
-            h2_high1 += x;
-        }
-
-        // Fill in the background.
-
-        if (flags & PH_GRAPH_USE_LINE_2)
-        {
-            for (i = h1_high1 + width; i < h2_low1; i += width)
-            {
-                bits[i] = lineBackColor2;
-            }
-        }
-
-        for (i = x; i < h1_low1; i += width)
-        {
-            bits[i] = lineBackColor1;
-        }
-
-        // Draw the grid.
-
-        if (flags & PH_GRAPH_USE_GRID_X)
-        {
-            // Draw the vertical grid line.
-            if (gridYCounter == 0)
-            {
-                for (i = x; i < numberOfPixels; i += width)
-                {
-                    bits[i] = gridColor;
-                }
-            }
-
-            gridYCounter++;
-
-            if (gridYCounter == DrawInfo->GridWidth)
-                gridYCounter = 0;
-        }
+        PhpGetGraphPoint(DrawInfo, 0, &h1, &yLabelMax);
+        yLabelDataIndex = 0;
 
-        if (flags & PH_GRAPH_USE_GRID_Y)
+        for (dataIndex = 1; dataIndex <= dataCount; dataIndex++)
         {
-            FLOAT level;
-            LONG h;
-            LONG h_last;
-
-            // Draw the horizontal grid line.
-            if (flags & PH_GRAPH_LOGARITHMIC_GRID_Y)
-            {
-                level = gridLevel;
-                h = (LONG)(level * (height - 1));
-                h_last = height + gridYThreshold - 1;
-
-                while (TRUE)
-                {
-                    if (h <= h_last - gridYThreshold)
-                    {
-                        bits[x + h * width] = gridColor;
-                        h_last = h;
-                    }
-                    else
-                    {
-                        break;
-                    }
-
-                    level /= gridBase;
-                    h = (LONG)(level * (height - 1));
-                }
-            }
-            else
-            {
-                level = gridHeight;
-                h = (LONG)(level * (height - 1));
-                h_last = 0;
-
-                while (h < height - 1)
-                {
-                    if (h >= h_last + gridYThreshold)
-                    {
-                        bits[x + h * width] = gridColor;
-                        h_last = h;
-                    }
-
-                    level += gridHeight;
-                    h = (LONG)(level * (height - 1));
-                }
-            }
-        }
+            PhpGetGraphPoint(DrawInfo, dataIndex, &h1, &h2);
 
-        // Draw the outline (line 1 is allowed to paint over line 2).
-
-        if (flags & PH_GRAPH_USE_LINE_2)
-        {
-            for (i = h2_low1; i <= h2_high1; i += width) // exclude pixel in the middle
+            if (dataIndex < DrawInfo->LabelMaxYIndexLimit && yLabelMax <= h2)
             {
-                bits[i] = lineColor2;
+                yLabelMax = h2;
+                yLabelDataIndex = dataIndex;
             }
         }
-
-        for (i = h1_low1; i <= h1_high1; i += width)
-        {
-            bits[i] = lineColor1;
-        }
-
-        intermediate = !intermediate;
-        x--;
     }
 
     if ((flags & PH_GRAPH_LABEL_MAX_Y) && yLabelDataIndex < DrawInfo->LineDataCount)
@@ -568,6 +210,30 @@ VOID PhDrawGraphDirect(
     }
 }
 
+/**
+ * Draws a graph directly to memory.
+ *
+ * \param hdc The DC to draw to. This is only used when drawing text.
+ * \param Bits The bits in a bitmap.
+ * \param DrawInfo A structure which contains graphing information.
+ *
+ * \remarks The following information is fixed:
+ * \li The graph is fixed to the origin (0, 0).
+ * \li The total size of the bitmap is assumed to be \a Width and \a Height in \a DrawInfo.
+ * \li \a Step is fixed at 2.
+ * \li If \ref PH_GRAPH_USE_LINE_2 is specified in \a Flags, \ref PH_GRAPH_OVERLAY_LINE_2 is never
+ * used.
+ */
+VOID PhDrawGraphDirect(
+    _In_ HDC hdc,
+    _In_ PVOID Bits,
+    _In_ PPH_GRAPH_DRAW_INFO DrawInfo
+    )
+{
+    PhpRasterizeGraph(Bits, DrawInfo->Width, DrawInfo);
+    PhpDrawGraphOverlay(hdc, DrawInfo);
+}
+
 /**
  * Sets the text in a graphing information structure.
  *
@@ -775,10 +441,38 @@ VOID PhpFreeGraphContext(
     PhFree(Context);
 }
 
+static VOID PhpDeleteRaster(
+    _In_ PPHP_GRAPH_CONTEXT Context
+    )
+{
+    if (Context->RasterBits)
+    {
+        PhFree(Context->RasterBits);
+        Context->RasterBits = NULL;
+    }
+
+    if (Context->RasterData1)
+    {
+        PhFree(Context->RasterData1);
+        Context->RasterData1 = NULL;
+    }
+
+    if (Context->RasterData2)
+    {
+        PhFree(Context->RasterData2);
+        Context->RasterData2 = NULL;
+    }
+
+    Context->RasterAllocatedCount = 0;
+    Context->RasterValid = FALSE;
+}
+
 static VOID PhpDeleteBufferedContext(
     _In_ PPHP_GRAPH_CONTEXT Context
     )
 {
+    PhpDeleteRaster(Context);
+
     if (Context->BufferedContext)
     {
         // The original bitmap must be selected back into the context, otherwise the bitmap can't be
@@ -913,13 +607,210 @@ VOID PhpUpdateDrawInfo(
     SendMessage(GetParent(hwnd), WM_NOTIFY, 0, (LPARAM)&getDrawInfo);
 }
 
+FORCEINLINE FLOAT PhpGetGraphValue(
+    _In_ PFLOAT Data,
+    _In_ ULONG Count,
+    _In_ ULONG Index
+    )
+{
+    // Data points past the end are drawn the same way as zero.
+    return Index < Count ? Data[Index] : 0;
+}
+
+/**
+ * Determines whether the raster of a graph can be reused for its current information.
+ *
+ * \param Context The graph context.
+ * \param Shift A variable which receives the number of data points which have been added since the
+ * raster was drawn. The rest of the data must be unchanged.
+ *
+ * \return TRUE if the raster can be scrolled by \a Shift data points, otherwise FALSE.
+ */
+static BOOLEAN PhpGetGraphRasterShift(
+    _In_ PPHP_GRAPH_CONTEXT Context,
+    _Out_ PULONG Shift
+    )
+{
+    PPH_GRAPH_DRAW_INFO oldInfo = &Context->RasterDrawInfo;
+    PPH_GRAPH_DRAW_INFO newInfo = &Context->DrawInfo;
+    ULONG rasterFlags = PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y | PH_GRAPH_LOGARITHMIC_GRID_Y | PH_GRAPH_USE_LINE_2;
+    ULONG lastIndex;
+    ULONG shift;
+    ULONG i;
+
+    if (
+        newInfo->Width != oldInfo->Width ||
+        newInfo->Height != oldInfo->Height ||
+        newInfo->Step != 2 ||
+        oldInfo->Step != 2 ||
+        (newInfo->Flags & rasterFlags) != (oldInfo->Flags & rasterFlags) ||
+        newInfo->BackColor != oldInfo->BackColor ||
+        newInfo->LineColor1 != oldInfo->LineColor1 ||
+        newInfo->LineColor2 != oldInfo->LineColor2 ||
+        newInfo->LineBackColor1 != oldInfo->LineBackColor1 ||
+        newInfo->LineBackColor2 != oldInfo->LineBackColor2 ||
+        newInfo->GridColor != oldInfo->GridColor ||
+        newInfo->GridWidth != oldInfo->GridWidth ||
+        newInfo->GridHeight != oldInfo->GridHeight ||
+        newInfo->GridYThreshold != oldInfo->GridYThreshold ||
+        newInfo->GridBase != oldInfo->GridBase
+        )
+    {
+        return FALSE;
+    }
+
+    // Callers move the grid by one for every data point they add, so the grid offset tells us how
+    // far the data should have moved. The rasterizer reads data points 0 to lastIndex.
+
+    lastIndex = (newInfo->Width + 1) / 2;
+    shift = newInfo->GridXOffset - oldInfo->GridXOffset;
+
+    if (shift > lastIndex)
+        return FALSE;
+
+    for (i = 0; i + shift <= lastIndex; i++)
+    {
+        if (PhpGetGraphValue(newInfo->LineData1, newInfo->LineDataCount, i + shift) !=
+            PhpGetGraphValue(oldInfo->LineData1, oldInfo->LineDataCount, i))
+        {
+            return FALSE;
+        }
+
+        if ((newInfo->Flags & PH_GRAPH_USE_LINE_2) &&
+            PhpGetGraphValue(newInfo->LineData2, newInfo->LineDataCount, i + shift) !=
+            PhpGetGraphValue(oldInfo->LineData2, oldInfo->LineDataCount, i))
+        {
+            return FALSE;
+        }
+    }
+
+    *Shift = shift;
+
+    return TRUE;
+}
+
+static VOID PhpSaveGraphRasterInfo(
+    _In_ PPHP_GRAPH_CONTEXT Context
+    )
+{
+    PPH_GRAPH_DRAW_INFO drawInfo = &Context->DrawInfo;
+    ULONG count;
+
+    // Only keep the data points which the rasterizer reads.
+    count = min(drawInfo->LineDataCount, (drawInfo->Width + 1) / 2 + 1);
+
+    if (Context->RasterAllocatedCount < count)
+    {
+        if (Context->RasterData1)
+            PhFree(Context->RasterData1);
+        if (Context->RasterData2)
+            PhFree(Context->RasterData2);
+
+        Context->RasterAllocatedCount = count;
+        Context->RasterData1 = PhAllocate(count * sizeof(FLOAT));
+        Context->RasterData2 = PhAllocate(count * sizeof(FLOAT));
+    }
+
+    if (count != 0)
+    {
+        memcpy(Context->RasterData1, drawInfo->LineData1, count * sizeof(FLOAT));
+
+        if (drawInfo->Flags & PH_GRAPH_USE_LINE_2)
+            memcpy(Context->RasterData2, drawInfo->LineData2, count * sizeof(FLOAT));
+    }
+
+    memcpy(&Context->RasterDrawInfo, drawInfo, sizeof(PH_GRAPH_DRAW_INFO));
+    Context->RasterDrawInfo.LineDataCount = count;
+    Context->RasterDrawInfo.LineData1 = Context->RasterData1;
+    Context->RasterDrawInfo.LineData2 = Context->RasterData2;
+    Context->RasterValid = TRUE;
+}
+
+/**
+ * Brings the raster of a graph up to date with its current information.
+ *
+ * \param Context The graph context. The size of the graph must match the size of the buffered
+ * context.
+ *
+ * \remarks When the only change is that new data points were added, the raster is scrolled and
+ * only the newly exposed columns are drawn. Nothing is drawn if nothing changed.
+ */
+static VOID PhpUpdateGraphRaster(
+    _In_ PPHP_GRAPH_CONTEXT Context
+    )
+{
+    PPH_GRAPH_DRAW_INFO drawInfo = &Context->DrawInfo;
+    LONG width = drawInfo->Width;
+    LONG height = drawInfo->Height;
+    ULONG shift;
+
+    if (!Context->RasterBits)
+    {
+        Context->RasterBits = PhAllocate((SIZE_T)width * height * sizeof(ULONG));
+        Context->RasterValid = FALSE;
+    }
+
+    if (Context->RasterValid && PhpGetGraphRasterShift(Context, &shift))
+    {
+        PH_GRAPH_DRAW_INFO columnsDrawInfo;
+        LONG columns;
+        LONG y;
+
+        if (shift == 0)
+            return;
+
+        // Each data point takes two columns. The column which used to be the rightmost one was
+        // drawn without a neighbour to its right, so it is drawn again.
+        columns = shift * 2 + 1;
+
+        if (columns < width)
+        {
+            for (y = 0; y < height; y++)
+            {
+                PULONG row = Context->RasterBits + (SIZE_T)y * width;
+
+                memmove(row, row + shift * 2, (width - shift * 2) * sizeof(ULONG));
+            }
+
+            memcpy(&columnsDrawInfo, drawInfo, sizeof(PH_GRAPH_DRAW_INFO));
+            columnsDrawInfo.Width = columns;
+            PhpRasterizeGraph(Context->RasterBits + width - columns, width, &columnsDrawInfo);
+            PhpSaveGraphRasterInfo(Context);
+            return;
+        }
+    }
+
+    PhpRasterizeGraph(Context->RasterBits, width, drawInfo);
+    PhpSaveGraphRasterInfo(Context);
+}
+
 VOID PhpDrawGraphControl(
     _In_ HWND hwnd,
     _In_ PPHP_GRAPH_CONTEXT Context
     )
 {
     if (Context->BufferedBits)
-        PhDrawGraphDirect(Context->BufferedContext, Context->BufferedBits, &Context->DrawInfo);
+    {
+        LONG width = Context->BufferedContextRect.right;
+        LONG height = Context->BufferedContextRect.bottom;
+
+        if (
+            width > 0 && height > 0 &&
+            (LONG)Context->DrawInfo.Width == width &&
+            (LONG)Context->DrawInfo.Height == height
+            )
+        {
+            // The label, text, fade-out and panel are drawn over a copy of the raster, so that the
+            // raster itself can be reused by the next draw.
+            PhpUpdateGraphRaster(Context);
+            memcpy(Context->BufferedBits, Context->RasterBits, (SIZE_T)width * height * sizeof(ULONG));
+            PhpDrawGraphOverlay(Context->BufferedContext, &Context->DrawInfo);
+        }
+        else
+        {
+            PhDrawGraphDirect(Context->BufferedContext, Context->BufferedBits, &Context->DrawInfo);
+        }
+    }
 
     if (Context->Style & GC_STYLE_FADEOUT)
     {
@@ -1256,7 +1147,12 @@ LRESULT CALLBACK PhpGraphWndProc(
         return TRUE;
     case GCM_DRAW:
         {
-            PhpUpdateDrawInfo(hwnd, context);
+            // A graph which can't be seen is brought up to date when it is next painted.
+            if (IsWindowVisible(hwnd) && !IsIconic(GetAncestor(hwnd, GA_ROOT)))
+                PhpUpdateDrawInfo(hwnd, context);
+            else
+                context->NeedsUpdate = TRUE;
+
             context->NeedsDraw = TRUE;
         }
         return TRUE;
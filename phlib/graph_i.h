@@ -0,0 +1,672 @@
+/*
+ * This file contains the graph rasterizer used by PhDrawGraphDirect and the graph control.
+ *
+ * It only uses the PH_GRAPH_DRAW_INFO fields that describe the data, the colors and the grid, so
+ * it can also be built outside of phlib. tools/graphtest includes it on other systems to compare
+ * its output with reference images. The including file must define COLORREF_TO_BITS, and may
+ * define PH_GRAPH_STRIP_MINIMUM_WIDTH to choose when the strip rasterizer is used.
+ */
+
+FORCEINLINE VOID PhpGetGraphPoint(
+    _In_ PPH_GRAPH_DRAW_INFO DrawInfo,
+    _In_ ULONG Index,
+    _Out_ PULONG H1,
+    _Out_ PULONG H2
+    )
+{
+    if (Index < DrawInfo->LineDataCount)
+    {
+        FLOAT f1;
+        FLOAT f2;
+
+        f1 = DrawInfo->LineData1[Index];
+
+        if (f1 < 0)
+            f1 = 0;
+        if (f1 > 1)
+            f1 = 1;
+
+        *H1 = (ULONG)(f1 * (DrawInfo->Height - 1));
+
+        if (DrawInfo->Flags & PH_GRAPH_USE_LINE_2)
+        {
+            f2 = f1 + DrawInfo->LineData2[Index];
+
+            if (f2 < 0)
+                f2 = 0;
+            if (f2 > 1)
+                f2 = 1;
+
+            *H2 = (ULONG)(f2 * (DrawInfo->Height - 1));
+        }
+        else
+        {
+            *H2 = *H1;
+        }
+    }
+    else
+    {
+        *H1 = 0;
+        *H2 = 0;
+    }
+}
+
+#define PH_GRAPH_STRIP_WIDTH 16
+#define PH_GRAPH_STRIP_STACK_COUNT 2048
+
+// Narrower graphs are drawn one pixel at a time. Filling the bitmap up front and the per-strip
+// bookkeeping cost more than the vector stores save until the graph is this wide.
+#ifndef PH_GRAPH_STRIP_MINIMUM_WIDTH
+#define PH_GRAPH_STRIP_MINIMUM_WIDTH 200
+#endif
+
+/**
+ * Fills rows \a Start to \a End - 1 of a graph column, clipped to the height of the column.
+ */
+FORCEINLINE VOID PhpFillGraphSpan(
+    _Inout_ PULONG Column,
+    _In_ LONG Height,
+    _In_ LONG Start,
+    _In_ LONG End,
+    _In_ ULONG Color
+    )
+{
+    if (Start < 0)
+        Start = 0;
+    if (End > Height)
+        End = Height;
+
+#ifndef _ARM64_
+    if (End - Start >= 4 && USER_SHARED_DATA->ProcessorFeatures[PF_XMMI64_INSTRUCTIONS_AVAILABLE])
+    {
+        __m128i pattern = _mm_set1_epi32(Color);
+
+        // The last store overlaps the previous one, so there is no scalar tail.
+        do
+        {
+            _mm_storeu_si128((__m128i *)(Column + Start), pattern);
+            Start += 4;
+        } while (End - Start >= 4);
+
+        _mm_storeu_si128((__m128i *)(Column + End - 4), pattern);
+        return;
+    }
+#endif
+
+    while (Start < End)
+        Column[Start++] = Color;
+}
+
+/**
+ * Copies a strip of up to PH_GRAPH_STRIP_WIDTH columns, each stored contiguously, into the bitmap.
+ *
+ * \param Bits The bits in the bitmap.
+ * \param Width The width of the bitmap.
+ * \param Height The height of the bitmap.
+ * \param Strip The columns. Column \a i of the strip starts at \a Strip + \a i * \a Height.
+ * \param X The horizontal offset of the first column in the bitmap.
+ * \param Count The number of columns in the strip.
+ * \param Rows The number of rows to copy, starting from the first row of the bitmap.
+ */
+static VOID PhpCopyGraphStrip(
+    _Inout_ PULONG Bits,
+    _In_ LONG Width,
+    _In_ LONG Height,
+    _In_ PULONG Strip,
+    _In_ LONG X,
+    _In_ LONG Count,
+    _In_ LONG Rows
+    )
+{
+    LONG y = 0;
+    LONG i = 0;
+
+#ifndef _ARM64_
+    if (Count >= 4 && USER_SHARED_DATA->ProcessorFeatures[PF_XMMI64_INSTRUCTIONS_AVAILABLE])
+    {
+        LONG vectorCount = Count & ~3;
+
+        // Transpose 4x4 blocks so that each row of a block is written with a single store. The
+        // blocks are visited row by row so that the strip is written one cache line at a time.
+
+        for (; y + 4 <= Rows; y += 4)
+        {
+            for (i = 0; i < vectorCount; i += 4)
+            {
+                PULONG column = Strip + (SIZE_T)i * Height + y;
+                __m128i column0 = _mm_loadu_si128((__m128i *)column);
+                __m128i column1 = _mm_loadu_si128((__m128i *)(column + Height));
+                __m128i column2 = _mm_loadu_si128((__m128i *)(column + Height * 2));
+                __m128i column3 = _mm_loadu_si128((__m128i *)(column + Height * 3));
+                __m128i low01 = _mm_unpacklo_epi32(column0, column1);
+                __m128i low23 = _mm_unpacklo_epi32(column2, column3);
+                __m128i high01 = _mm_unpackhi_epi32(column0, column1);
+                __m128i high23 = _mm_unpackhi_epi32(column2, column3);
+                PULONG row = Bits + (SIZE_T)y * Width + X + i;
+
+                _mm_storeu_si128((__m128i *)row, _mm_unpacklo_epi64(low01, low23));
+                row += Width;
+                _mm_storeu_si128((__m128i *)row, _mm_unpackhi_epi64(low01, low23));
+                row += Width;
+                _mm_storeu_si128((__m128i *)row, _mm_unpacklo_epi64(high01, high23));
+                row += Width;
+                _mm_storeu_si128((__m128i *)row, _mm_unpackhi_epi64(high01, high23));
+            }
+        }
+
+        // Copy the remaining columns of the transposed rows.
+        for (i = vectorCount; i < Count; i++)
+        {
+            LONG j;
+
+            for (j = 0; j < y; j++)
+                Bits[(SIZE_T)j * Width + X + i] = Strip[(SIZE_T)i * Height + j];
+        }
+    }
+#endif
+
+    for (; y < Rows; y++)
+    {
+        for (i = 0; i < Count; i++)
+        {
+            Bits[(SIZE_T)y * Width + X + i] = Strip[(SIZE_T)i * Height + y];
+        }
+    }
+}
+
+/**
+ * Rasterizes a graph into a bitmap, without any labels or text.
+ *
+ * \param Bits The first pixel of the area to draw to.
+ * \param Stride The number of pixels in each row of the bitmap.
+ * \param DrawInfo A structure which contains graphing information. \a Width columns are drawn,
+ * with the first data point in the rightmost column.
+ *
+ * \remarks Each column only depends on the data and on the columns to its right, so drawing a
+ * narrower graph produces the same pixels as the rightmost columns of a wider one.
+ */
+static VOID PhpRasterizeGraph(
+    _Inout_ PULONG Bits,
+    _In_ LONG Stride,
+    _In_ PPH_GRAPH_DRAW_INFO DrawInfo
+    )
+{
+    PULONG bits = Bits;
+    LONG width = DrawInfo->Width;
+    LONG height = DrawInfo->Height;
+    ULONG flags = DrawInfo->Flags;
+    LONG i;
+    LONG x;
+
+    BOOLEAN intermediate = FALSE; // whether we are currently between two data positions
+    ULONG dataIndex = 0; // the data index of the current position
+    ULONG h1_i; // the line 1 height value to the left of the current position
+    ULONG h1_o; // the line 1 height value at the current position
+    ULONG h2_i; // the line 1 + line 2 height value to the left of the current position
+    ULONG h2_o; // the line 1 + line 2 height value at the current position
+    ULONG h1; // current pixel
+    ULONG h1_left; // current pixel
+    ULONG h2; // current pixel
+    ULONG h2_left; // current pixel
+
+    LONG mid;
+    LONG h1_low1;
+    LONG h1_high1;
+    LONG h1_low2;
+    LONG h1_high2;
+    LONG h2_low1 = 0;
+    LONG h2_high1 = 0;
+    LONG h2_low2;
+    LONG h2_high2;
+    LONG old_low2;
+    LONG old_high2;
+
+    ULONG backColor;
+    ULONG lineColor1;
+    ULONG lineBackColor1;
+    ULONG lineColor2;
+    ULONG lineBackColor2;
+    FLOAT gridHeight = 0;
+    LONG gridYThreshold = 0;
+    ULONG gridYCounter = 0;
+    ULONG gridColor = 0;
+    FLOAT gridBase = 0;
+    FLOAT gridLevel = 0;
+
+    ULONG stripStackBuffer[PH_GRAPH_STRIP_STACK_COUNT];
+    PULONG stripBuffer;
+    SIZE_T stripBufferCount;
+    PULONG strip; // the columns which have been rasterized but not yet copied to the bitmap
+    PULONG column;
+    LONG columnTops[PH_GRAPH_STRIP_WIDTH]; // the first row of each column above the graph
+    BOOLEAN columnGrids[PH_GRAPH_STRIP_WIDTH]; // whether each column has a vertical grid line
+    LONG top;
+    PLONG gridRows; // the rows which contain a horizontal grid line
+    LONG numberOfGridRows = 0;
+    BOOLEAN useStrips;
+
+    backColor = COLORREF_TO_BITS(DrawInfo->BackColor);
+    lineColor1 = COLORREF_TO_BITS(DrawInfo->LineColor1);
+    lineBackColor1 = COLORREF_TO_BITS(DrawInfo->LineBackColor1);
+    lineColor2 = COLORREF_TO_BITS(DrawInfo->LineColor2);
+    lineBackColor2 = COLORREF_TO_BITS(DrawInfo->LineBackColor2);
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    // The graph is rasterized one column at a time into a strip of columns which are each stored
+    // contiguously, so that every span in a column is filled with vector stores instead of being
+    // written one row at a time. Each completed strip is then transposed into the bitmap. Above the
+    // graph every row is either background or a horizontal grid line, so the bitmap is filled with
+    // those rows up front and only the part of each strip below the highest outline is copied.
+    // Narrow graphs skip the strips and are drawn straight into the bitmap.
+
+    useStrips = width >= PH_GRAPH_STRIP_MINIMUM_WIDTH;
+    stripBufferCount = (SIZE_T)height * (useStrips ? PH_GRAPH_STRIP_WIDTH + 1 : 1);
+
+    if (stripBufferCount <= PH_GRAPH_STRIP_STACK_COUNT)
+        stripBuffer = stripStackBuffer;
+    else
+        stripBuffer = PhAllocate(stripBufferCount * sizeof(ULONG));
+
+    strip = stripBuffer;
+    gridRows = (PLONG)(strip + (SIZE_T)height * (useStrips ? PH_GRAPH_STRIP_WIDTH : 0));
+
+    x = width - 1;
+    h1_low2 = MAXLONG;
+    h1_high2 = 0;
+    h2_low2 = MAXLONG;
+    h2_high2 = 0;
+
+    PhpGetGraphPoint(DrawInfo, 0, &h1_i, &h2_i);
+
+    if (flags & (PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y))
+    {
+        gridHeight = max(DrawInfo->GridHeight, 0);
+        gridLevel = gridHeight;
+        gridYThreshold = DrawInfo->GridYThreshold;
+        gridYCounter = DrawInfo->GridWidth - (DrawInfo->GridXOffset * DrawInfo->Step) % DrawInfo->GridWidth - 1;
+        gridColor = COLORREF_TO_BITS(DrawInfo->GridColor);
+    }
+
+    if ((flags & (PH_GRAPH_USE_GRID_Y | PH_GRAPH_LOGARITHMIC_GRID_Y)) == (PH_GRAPH_USE_GRID_Y | PH_GRAPH_LOGARITHMIC_GRID_Y))
+    {
+        // Pre-process to find the largest integer n such that GridHeight*GridBase^n < 1.
+
+        gridBase = DrawInfo->GridBase;
+
+        if (gridBase > 1)
+        {
+            DOUBLE logBase;
+            DOUBLE exponent;
+            DOUBLE high;
+
+            logBase = log(gridBase);
+            exponent = ceil(-log(gridHeight) / logBase) - 1; // Works for both GridHeight > 1 and GridHeight < 1
+            high = exp(exponent * logBase);
+            gridLevel = (FLOAT)(gridHeight * high);
+
+            if (gridLevel < 0 || !isfinite(gridLevel))
+                gridLevel = 0;
+            if (gridLevel > 1)
+                gridLevel = 1;
+        }
+        else
+        {
+            // This is an error.
+            gridLevel = 0;
+        }
+    }
+
+    if (flags & PH_GRAPH_USE_GRID_Y)
+    {
+        FLOAT level;
+        LONG h;
+        LONG h_last;
+
+        // The horizontal grid lines are at the same rows in every column.
+        if (flags & PH_GRAPH_LOGARITHMIC_GRID_Y)
+        {
+            level = gridLevel;
+            h = (LONG)(level * (height - 1));
+            h_last = height + gridYThreshold - 1;
+
+            while (TRUE)
+            {
+                if (h <= h_last - gridYThreshold)
+                {
+                    if (numberOfGridRows == 0 || gridRows[numberOfGridRows - 1] != h)
+                        gridRows[numberOfGridRows++] = h;
+
+                    h_last = h;
+                }
+                else
+                {
+                    break;
+                }
+
+                level /= gridBase;
+                h = (LONG)(level * (height - 1));
+            }
+        }
+        else
+        {
+            level = gridHeight;
+            h = (LONG)(level * (height - 1));
+            h_last = 0;
+
+            while (h < height - 1)
+            {
+                if (h >= h_last + gridYThreshold)
+                {
+                    if (numberOfGridRows == 0 || gridRows[numberOfGridRows - 1] != h)
+                        gridRows[numberOfGridRows++] = h;
+
+                    h_last = h;
+                }
+
+                level += gridHeight;
+                h = (LONG)(level * (height - 1));
+            }
+        }
+    }
+
+    if (Stride == width)
+    {
+        PhFillMemoryUlong(bits, backColor, (SIZE_T)width * height);
+    }
+    else
+    {
+        for (i = 0; i < height; i++)
+            PhFillMemoryUlong(bits + (SIZE_T)i * Stride, backColor, width);
+    }
+
+    for (i = 0; i < numberOfGridRows; i++)
+    {
+        PhFillMemoryUlong(bits + (SIZE_T)gridRows[i] * Stride, gridColor, width);
+    }
+
+    while (x >= 0)
+    {
+        // Calculate the height of the graph at this point.
+
+        if (!intermediate)
+        {
+            h1_o = h1_i;
+            h2_o = h2_i;
+
+            // Pull in new data.
+            dataIndex++;
+            PhpGetGraphPoint(DrawInfo, dataIndex, &h1_i, &h2_i);
+
+            h1 = h1_o;
+            h1_left = (h1_i + h1_o) / 2;
+            h2 = h2_o;
+            h2_left = (h2_i + h2_o) / 2;
+        }
+        else
+        {
+            h1 = h1_left;
+            h1_left = h1_i;
+            h2 = h2_left;
+            h2_left = h2_i;
+        }
+
+        // The graph is drawn right-to-left. There is one iteration of the loop per horizontal pixel.
+        // There is a fixed step value of 2, so every other iteration is a mid-point (intermediate)
+        // iteration with a height value of (left + right) / 2. In order to rasterize the outline,
+        // effectively in each iteration half of the line is drawn at the current column and the other
+        // half is drawn in the column to the left.
+
+        // Rasterize the data outline.
+        // h?_low2 to h?_high2 is the vertical line to the left of the current pixel.
+        // h?_low1 to h?_high1 is the vertical line at the current pixel.
+        // We merge (union) the old h?_low2 to h?_high2 line with the current line in each iteration.
+        //
+        // For example:
+        //
+        // X represents a data point. M represents the mid-point between two data points ("intermediate").
+        // X, M and x are all part of the outline. # represents the background filled in during
+        // the current loop iteration.
+        //
+        // slope > 0:                                     slope < 0:
+        //
+        //     X  < high1                                   X    < high2 (of next loop iteration)
+        //     x                                            x
+        //     x  < low1                                    x    < low2 (of next loop iteration)
+        //    x#  < high2                                    x   < high1 (of next loop iteration)
+        //    M#  < low2                                     M   < low1 (of next loop iteration)
+        //    x#  < high1 (of next loop iteration)           x   < high2
+        //    x#  < low1 (of next loop iteration)            x   < low2
+        //   x #  < high2 (of next loop iteration)            x  < high1
+        //   x #                                              x
+        //   X #  < low2 (of next loop iteration)             X  < low1
+        //     #                                              #
+        //     ^                                              ^
+        //    ^| current pixel                               ^| current pixel
+        //    |                                              |
+        //    | left of current pixel                        | left of current pixel
+        //
+        // In both examples above, the line low2-high2 will be merged with the line low1-high1 of
+        // the next iteration.
+
+        // All values below are row numbers within the current column.
+
+        mid = (h1_left + h1) / 2;
+        old_low2 = h1_low2;
+        old_high2 = h1_high2;
+
+        if (h1_left < h1) // slope > 0
+        {
+            h1_low2 = h1_left;
+            h1_high2 = mid;
+            h1_low1 = mid + 1;
+            h1_high1 = h1;
+        }
+        else // slope < 0
+        {
+            h1_high2 = h1_left;
+            h1_low2 = mid + 1;
+            h1_high1 = mid;
+            h1_low1 = h1;
+        }
+
+        // Merge the lines.
+        if (h1_low1 > old_low2)
+            h1_low1 = old_low2;
+        if (h1_high1 < old_high2)
+            h1_high1 = old_high2;
+
+        if (flags & PH_GRAPH_USE_LINE_2)
+        {
+            mid = (h2_left + h2) / 2;
+            old_low2 = h2_low2;
+            old_high2 = h2_high2;
+
+            if (h2_left < h2) // slope > 0
+            {
+                h2_low2 = h2_left;
+                h2_high2 = mid;
+                h2_low1 = mid + 1;
+                h2_high1 = h2;
+            }
+            else // slope < 0
+            {
+                h2_high2 = h2_left;
+                h2_low2 = mid + 1;
+                h2_high1 = mid;
+                h2_low1 = h2;
+            }
+
+            // Merge the lines.
+            if (h2_low1 > old_low2)
+                h2_low1 = old_low2;
+            if (h2_high1 < old_high2)
+                h2_high1 = old_high2;
+        }
+
+        if (!useStrips)
+        {
+            // Fill in the background.
+
+            if (flags & PH_GRAPH_USE_LINE_2)
+            {
+                for (i = h1_high1 + 1; i < h2_low1; i++)
+                {
+                    bits[(SIZE_T)i * Stride + x] = lineBackColor2;
+                }
+            }
+
+            for (i = 0; i < h1_low1; i++)
+            {
+                bits[(SIZE_T)i * Stride + x] = lineBackColor1;
+            }
+
+            // Draw the grid.
+
+            if (flags & PH_GRAPH_USE_GRID_X)
+            {
+                // Draw the vertical grid line.
+                if (gridYCounter == 0)
+                {
+                    for (i = 0; i < height; i++)
+                    {
+                        bits[(SIZE_T)i * Stride + x] = gridColor;
+                    }
+                }
+
+                gridYCounter++;
+
+                if (gridYCounter == DrawInfo->GridWidth)
+                    gridYCounter = 0;
+            }
+
+            // Draw the horizontal grid lines.
+            for (i = 0; i < numberOfGridRows; i++)
+            {
+                bits[(SIZE_T)gridRows[i] * Stride + x] = gridColor;
+            }
+
+            // Draw the outline (line 1 is allowed to paint over line 2).
+
+            if (flags & PH_GRAPH_USE_LINE_2)
+            {
+                for (i = h2_low1; i <= h2_high1; i++) // exclude pixel in the middle
+                {
+                    bits[(SIZE_T)i * Stride + x] = lineColor2;
+                }
+            }
+
+            for (i = h1_low1; i <= h1_high1; i++)
+            {
+                bits[(SIZE_T)i * Stride + x] = lineColor1;
+            }
+        }
+        else
+        {
+            column = strip + (SIZE_T)(x % PH_GRAPH_STRIP_WIDTH) * height;
+
+            // Everything from the top of the outline upwards is already in the bitmap, except for the
+            // vertical grid lines which are drawn there directly.
+
+            top = h1_high1 + 1;
+
+            if ((flags & PH_GRAPH_USE_LINE_2) && top < h2_high1 + 1)
+                top = h2_high1 + 1;
+
+            top = max(min(top, height), 0);
+            columnTops[x % PH_GRAPH_STRIP_WIDTH] = top;
+            columnGrids[x % PH_GRAPH_STRIP_WIDTH] = (flags & PH_GRAPH_USE_GRID_X) && gridYCounter == 0;
+
+            // Fill in the background.
+
+            PhpFillGraphSpan(column, height, 0, h1_low1, lineBackColor1);
+            PhpFillGraphSpan(column, height, h1_low1, top, backColor);
+
+            if (flags & PH_GRAPH_USE_LINE_2)
+            {
+                PhpFillGraphSpan(column, height, h1_high1 + 1, h2_low1, lineBackColor2);
+            }
+
+            // Draw the grid.
+
+            if (flags & PH_GRAPH_USE_GRID_X)
+            {
+                // Draw the vertical grid line.
+                if (gridYCounter == 0)
+                {
+                    PhpFillGraphSpan(column, height, 0, top, gridColor);
+
+                    for (i = top; i < height; i++)
+                    {
+                        bits[(SIZE_T)i * Stride + x] = gridColor;
+                    }
+                }
+
+                gridYCounter++;
+
+                if (gridYCounter == DrawInfo->GridWidth)
+                    gridYCounter = 0;
+            }
+
+            // Draw the horizontal grid lines.
+            for (i = 0; i < numberOfGridRows; i++)
+            {
+                if (gridRows[i] < top)
+                    column[gridRows[i]] = gridColor;
+            }
+
+            // Draw the outline (line 1 is allowed to paint over line 2).
+
+            if (flags & PH_GRAPH_USE_LINE_2)
+            {
+                PhpFillGraphSpan(column, height, h2_low1, h2_high1 + 1, lineColor2); // exclude pixel in the middle
+            }
+
+            PhpFillGraphSpan(column, height, h1_low1, h1_high1 + 1, lineColor1);
+
+            // Copy the strip to the bitmap once its leftmost column has been drawn.
+            if (x % PH_GRAPH_STRIP_WIDTH == 0)
+            {
+                LONG count = min(PH_GRAPH_STRIP_WIDTH, width - x);
+                LONG rows = 0;
+                LONG j;
+
+                for (j = 0; j < count; j++)
+                {
+                    if (rows < columnTops[j])
+                        rows = columnTops[j];
+                }
+
+                // Extend the shorter columns up to the highest one with the rows above the graph.
+                for (j = 0; j < count; j++)
+                {
+                    column = strip + (SIZE_T)j * height;
+
+                    if (columnGrids[j])
+                    {
+                        PhpFillGraphSpan(column, height, columnTops[j], rows, gridColor);
+                    }
+                    else if (columnTops[j] < rows)
+                    {
+                        PhpFillGraphSpan(column, height, columnTops[j], rows, backColor);
+
+                        for (i = 0; i < numberOfGridRows; i++)
+                        {
+                            if (gridRows[i] >= columnTops[j] && gridRows[i] < rows)
+                                column[gridRows[i]] = gridColor;
+                        }
+                    }
+                }
+
+                PhpCopyGraphStrip(bits, Stride, height, strip, x, count, rows);
+            }
+        }
+
+        intermediate = !intermediate;
+        x--;
+    }
+
+    if (stripBuffer != stripStackBuffer)
+        PhFree(stripBuffer);
+}
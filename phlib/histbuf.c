@@ -0,0 +1,231 @@
+/*
+ * Process Hacker -
+ *   multi-resolution history buffer
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <phbase.h>
+#include <histbuf.h>
+
+/**
+ * Initializes a history buffer.
+ *
+ * \param Buffer A history buffer.
+ * \param Size The number of items to keep at each level.
+ * \param Factor The number of items from one level that are combined into a single item of the
+ * next level. This must be at least 2.
+ * \param NumberOfLevels The number of levels. Level \a n holds one item for every
+ * Factor^(n + 1) raw samples.
+ */
+VOID PhInitializeHistoryBuffer(
+    _Out_ PPH_HISTORY_BUFFER Buffer,
+    _In_ ULONG Size,
+    _In_ ULONG Factor,
+    _In_ ULONG NumberOfLevels
+    )
+{
+    ULONG scale;
+    ULONG i;
+
+    assert(Factor >= 2);
+
+    if (NumberOfLevels > PH_HISTORY_BUFFER_MAXIMUM_LEVELS)
+        NumberOfLevels = PH_HISTORY_BUFFER_MAXIMUM_LEVELS;
+
+    Buffer->Factor = Factor;
+    Buffer->NumberOfLevels = NumberOfLevels;
+    Buffer->Levels = PhAllocateZero(sizeof(PH_HISTORY_LEVEL) * NumberOfLevels);
+
+    scale = 1;
+
+    for (i = 0; i < NumberOfLevels; i++)
+    {
+        PPH_HISTORY_LEVEL level = &Buffer->Levels[i];
+
+        scale *= Factor;
+        level->Scale = scale;
+
+        PhInitializeCircularBuffer_FLOAT(&level->Average, Size);
+        PhInitializeCircularBuffer_FLOAT(&level->Minimum, Size);
+        PhInitializeCircularBuffer_FLOAT(&level->Maximum, Size);
+    }
+}
+
+/**
+ * Frees resources used by a history buffer.
+ *
+ * \param Buffer A history buffer.
+ */
+VOID PhDeleteHistoryBuffer(
+    _Inout_ PPH_HISTORY_BUFFER Buffer
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < Buffer->NumberOfLevels; i++)
+    {
+        PhDeleteCircularBuffer_FLOAT(&Buffer->Levels[i].Average);
+        PhDeleteCircularBuffer_FLOAT(&Buffer->Levels[i].Minimum);
+        PhDeleteCircularBuffer_FLOAT(&Buffer->Levels[i].Maximum);
+    }
+
+    PhFree(Buffer->Levels);
+}
+
+/**
+ * Removes all items from a history buffer.
+ *
+ * \param Buffer A history buffer.
+ */
+VOID PhClearHistoryBuffer(
+    _Inout_ PPH_HISTORY_BUFFER Buffer
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < Buffer->NumberOfLevels; i++)
+    {
+        PPH_HISTORY_LEVEL level = &Buffer->Levels[i];
+
+        PhClearCircularBuffer_FLOAT(&level->Average);
+        PhClearCircularBuffer_FLOAT(&level->Minimum);
+        PhClearCircularBuffer_FLOAT(&level->Maximum);
+        level->PendingCount = 0;
+    }
+}
+
+/**
+ * Adds a raw sample to a history buffer.
+ *
+ * \param Buffer A history buffer.
+ * \param Value The sample.
+ *
+ * \remarks This function only touches the levels whose group is completed by the sample, so the
+ * amortized cost is constant.
+ */
+VOID PhAddItemHistoryBuffer(
+    _Inout_ PPH_HISTORY_BUFFER Buffer,
+    _In_ FLOAT Value
+    )
+{
+    FLOAT average = Value;
+    FLOAT minimum = Value;
+    FLOAT maximum = Value;
+    ULONG i;
+
+    for (i = 0; i < Buffer->NumberOfLevels; i++)
+    {
+        PPH_HISTORY_LEVEL level = &Buffer->Levels[i];
+
+        if (level->PendingCount == 0)
+        {
+            level->PendingSum = average;
+            level->PendingMinimum = minimum;
+            level->PendingMaximum = maximum;
+        }
+        else
+        {
+            level->PendingSum += average;
+
+            if (level->PendingMinimum > minimum)
+                level->PendingMinimum = minimum;
+            if (level->PendingMaximum < maximum)
+                level->PendingMaximum = maximum;
+        }
+
+        if (++level->PendingCount != Buffer->Factor)
+            break;
+
+        // The group is complete. Every item of the level below covers the same number of raw
+        // samples, so the mean of their averages is the exact average of the group.
+
+        average = level->PendingSum / Buffer->Factor;
+        minimum = level->PendingMinimum;
+        maximum = level->PendingMaximum;
+        level->PendingCount = 0;
+
+        PhAddItemCircularBuffer_FLOAT(&level->Average, average);
+        PhAddItemCircularBuffer_FLOAT(&level->Minimum, minimum);
+        PhAddItemCircularBuffer_FLOAT(&level->Maximum, maximum);
+    }
+}
+
+/**
+ * Copies the items of one level of a history buffer, newest first.
+ *
+ * \param Buffer A history buffer.
+ * \param Level The level to copy from.
+ * \param Aggregate The summary to copy.
+ * \param Destination A buffer which receives the items.
+ * \param Count The number of items to copy.
+ */
+VOID PhCopyHistoryBuffer(
+    _Inout_ PPH_HISTORY_BUFFER Buffer,
+    _In_ ULONG Level,
+    _In_ PH_HISTORY_AGGREGATE Aggregate,
+    _Out_writes_(Count) PFLOAT Destination,
+    _In_ ULONG Count
+    )
+{
+    PPH_HISTORY_LEVEL level = &Buffer->Levels[Level];
+
+    switch (Aggregate)
+    {
+    case MinimumHistoryAggregate:
+        PhCopyCircularBuffer_FLOAT(&level->Minimum, Destination, Count);
+        break;
+    case MaximumHistoryAggregate:
+        PhCopyCircularBuffer_FLOAT(&level->Maximum, Destination, Count);
+        break;
+    default:
+        PhCopyCircularBuffer_FLOAT(&level->Average, Destination, Count);
+        break;
+    }
+}
+
+/**
+ * Gets the raw sample index of the newest sample summarized by an item.
+ *
+ * \param Buffer A history buffer.
+ * \param Level The level of the item.
+ * \param Index The index of the item within \a Level, where 0 is the newest item.
+ *
+ * \return The index of the sample, where 0 is the most recently added sample.
+ */
+ULONG PhGetSampleIndexHistoryBuffer(
+    _In_ PPH_HISTORY_BUFFER Buffer,
+    _In_ ULONG Level,
+    _In_ ULONG Index
+    )
+{
+    ULONG pending;
+    ULONG scale;
+    ULONG i;
+
+    // Samples which have not yet completed a group at this level are newer than its newest item.
+
+    pending = 0;
+    scale = 1;
+
+    for (i = 0; i <= Level; i++)
+    {
+        pending += Buffer->Levels[i].PendingCount * scale;
+        scale = Buffer->Levels[i].Scale;
+    }
+
+    return pending + Index * scale;
+}
@@ -0,0 +1,442 @@
+/*
+ * Process Hacker -
+ *   file icon cache
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Icons are cached by the identity of the file (volume serial number, file ID and last write
+ * time) and the icon index, so different paths to the same file share one entry and an entry is
+ * not reused after the file has been replaced. Entries are reference counted. When an entry is no
+ * longer referenced it is moved to the unused list, which is kept in most recently used order; the
+ * least recently used entries are destroyed once the list is full.
+ *
+ * Each entry can have a slot in a shared image list. Slot 0 contains the stock application icon,
+ * and slots of destroyed entries are reused by ImageList_ReplaceIcon instead of growing the image
+ * list.
+ *
+ * Files that cannot be opened are not cached; their entries are destroyed as soon as they are no
+ * longer referenced.
+ */
+
+#include <ph.h>
+#include <guisup.h>
+
+#define PH_FILE_ICON_CACHE_SIZE 128
+
+typedef struct _PH_FILE_ICON_ENTRY
+{
+    PH_FILE_ICON Icon;
+
+    LIST_ENTRY ListEntry; // in the unused list if RefCount is 0
+    ULONG RefCount;
+    BOOLEAN Cached;
+    INT ImageListIndex;
+
+    ULONG VolumeSerialNumber;
+    LARGE_INTEGER FileId;
+    LARGE_INTEGER LastWriteTime;
+    INT IconIndex;
+} PH_FILE_ICON_ENTRY, *PPH_FILE_ICON_ENTRY;
+
+static PH_INITONCE PhpFileIconCacheInitOnce = PH_INITONCE_INIT;
+static PH_QUEUED_LOCK PhpFileIconCacheLock = PH_QUEUED_LOCK_INIT;
+static PPH_HASHTABLE PhpFileIconHashtable = NULL;
+static LIST_ENTRY PhpUnusedFileIconListHead;
+static ULONG PhpNumberOfUnusedFileIcons = 0;
+static HIMAGELIST PhpFileIconImageList = NULL;
+static PPH_LIST PhpFreeFileIconImageListIndices = NULL;
+
+static BOOLEAN NTAPI PhpFileIconEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PPH_FILE_ICON_ENTRY entry1 = *(PPH_FILE_ICON_ENTRY *)Entry1;
+    PPH_FILE_ICON_ENTRY entry2 = *(PPH_FILE_ICON_ENTRY *)Entry2;
+
+    return
+        entry1->VolumeSerialNumber == entry2->VolumeSerialNumber &&
+        entry1->FileId.QuadPart == entry2->FileId.QuadPart &&
+        entry1->LastWriteTime.QuadPart == entry2->LastWriteTime.QuadPart &&
+        entry1->IconIndex == entry2->IconIndex;
+}
+
+static ULONG NTAPI PhpFileIconHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PPH_FILE_ICON_ENTRY entry = *(PPH_FILE_ICON_ENTRY *)Entry;
+
+    return PhHashInt64(entry->FileId.QuadPart) ^ entry->VolumeSerialNumber ^ PhHashInt32(entry->IconIndex);
+}
+
+static VOID PhpInitializeFileIconCache(
+    VOID
+    )
+{
+    if (PhBeginInitOnce(&PhpFileIconCacheInitOnce))
+    {
+        PhpFileIconHashtable = PhCreateHashtable(
+            sizeof(PPH_FILE_ICON_ENTRY),
+            PhpFileIconEqualFunction,
+            PhpFileIconHashFunction,
+            64
+            );
+        InitializeListHead(&PhpUnusedFileIconListHead);
+        PhpFreeFileIconImageListIndices = PhCreateList(16);
+
+        PhEndInitOnce(&PhpFileIconCacheInitOnce);
+    }
+}
+
+/**
+ * Gets the identity of a file.
+ *
+ * \param FileName The Win32 file name.
+ * \param Entry The entry which receives the identity.
+ */
+static BOOLEAN PhpGetFileIconIdentity(
+    _In_ PWSTR FileName,
+    _Inout_ PPH_FILE_ICON_ENTRY Entry
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle;
+    IO_STATUS_BLOCK isb;
+    FILE_INTERNAL_INFORMATION internalInfo;
+    FILE_BASIC_INFORMATION basicInfo;
+    FILE_FS_VOLUME_INFORMATION volumeInfo;
+
+    if (!NT_SUCCESS(PhCreateFileWin32(
+        &fileHandle,
+        FileName,
+        FILE_READ_ATTRIBUTES | SYNCHRONIZE,
+        FILE_ATTRIBUTE_NORMAL,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        FILE_OPEN,
+        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+        )))
+        return FALSE;
+
+    if (NT_SUCCESS(status = NtQueryInformationFile(
+        fileHandle,
+        &isb,
+        &internalInfo,
+        sizeof(FILE_INTERNAL_INFORMATION),
+        FileInternalInformation
+        )))
+    {
+        status = NtQueryInformationFile(
+            fileHandle,
+            &isb,
+            &basicInfo,
+            sizeof(FILE_BASIC_INFORMATION),
+            FileBasicInformation
+            );
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        // The volume label doesn't fit in the structure; we only need the serial number.
+        status = NtQueryVolumeInformationFile(
+            fileHandle,
+            &isb,
+            &volumeInfo,
+            sizeof(FILE_FS_VOLUME_INFORMATION),
+            FileFsVolumeInformation
+            );
+
+        if (status == STATUS_BUFFER_OVERFLOW)
+            status = STATUS_SUCCESS;
+    }
+
+    NtClose(fileHandle);
+
+    if (!NT_SUCCESS(status))
+        return FALSE;
+
+    Entry->VolumeSerialNumber = volumeInfo.VolumeSerialNumber;
+    Entry->FileId = internalInfo.IndexNumber;
+    Entry->LastWriteTime = basicInfo.LastWriteTime;
+
+    return TRUE;
+}
+
+static VOID PhpDestroyFileIconEntry(
+    _In_ _Post_invalid_ PPH_FILE_ICON_ENTRY Entry
+    )
+{
+    if (Entry->Icon.SmallIcon) DestroyIcon(Entry->Icon.SmallIcon);
+    if (Entry->Icon.LargeIcon) DestroyIcon(Entry->Icon.LargeIcon);
+    PhFree(Entry);
+}
+
+static VOID PhpReferenceFileIconEntry(
+    _Inout_ PPH_FILE_ICON_ENTRY Entry
+    )
+{
+    if (Entry->RefCount++ == 0)
+    {
+        RemoveEntryList(&Entry->ListEntry);
+        PhpNumberOfUnusedFileIcons--;
+    }
+}
+
+static VOID PhpFreeFileIconImageListIndex(
+    _Inout_ PPH_FILE_ICON_ENTRY Entry
+    )
+{
+    if (Entry->ImageListIndex > 0)
+    {
+        PhAddItemList(PhpFreeFileIconImageListIndices, (PVOID)(ULONG_PTR)Entry->ImageListIndex);
+        Entry->ImageListIndex = -1;
+    }
+}
+
+static HIMAGELIST PhpGetFileIconImageList(
+    VOID
+    )
+{
+    HICON stockIcon;
+
+    if (!PhpFileIconImageList)
+    {
+        PhpFileIconImageList = ImageList_Create(
+            PhSmallIconSize.X,
+            PhSmallIconSize.Y,
+            ILC_COLOR32 | ILC_MASK,
+            0,
+            64
+            );
+
+        PhGetStockApplicationIcon(&stockIcon, NULL);
+        ImageList_AddIcon(PhpFileIconImageList, stockIcon);
+    }
+
+    return PhpFileIconImageList;
+}
+
+/**
+ * Gets the icons of a file.
+ *
+ * \param FileName The Win32 file name.
+ * \param IconIndex The index of the icon, or the negated resource ID of the icon.
+ *
+ * \return The icons, which may be NULL if the file does not contain the icon. Call
+ * PhDereferenceFileIcon() when you no longer need them. Do not destroy the icons.
+ */
+PPH_FILE_ICON PhGetFileIcon(
+    _In_ PWSTR FileName,
+    _In_ INT IconIndex
+    )
+{
+    PH_FILE_ICON_ENTRY lookupEntry;
+    PPH_FILE_ICON_ENTRY lookupEntryPtr = &lookupEntry;
+    PPH_FILE_ICON_ENTRY *entryPtr;
+    PPH_FILE_ICON_ENTRY entry;
+    BOOLEAN cached;
+
+    PhpInitializeFileIconCache();
+
+    memset(&lookupEntry, 0, sizeof(PH_FILE_ICON_ENTRY));
+    lookupEntry.IconIndex = IconIndex;
+    cached = PhpGetFileIconIdentity(FileName, &lookupEntry);
+
+    if (cached)
+    {
+        PhAcquireQueuedLockExclusive(&PhpFileIconCacheLock);
+
+        if (entryPtr = PhFindEntryHashtable(PhpFileIconHashtable, &lookupEntryPtr))
+        {
+            entry = *entryPtr;
+            PhpReferenceFileIconEntry(entry);
+            PhReleaseQueuedLockExclusive(&PhpFileIconCacheLock);
+
+            return &entry->Icon;
+        }
+
+        PhReleaseQueuedLockExclusive(&PhpFileIconCacheLock);
+    }
+
+    // Extract the icons without holding the lock. If another thread adds the same entry in the
+    // meantime, we use its entry and destroy ours.
+
+    entry = PhAllocateCopy(&lookupEntry, sizeof(PH_FILE_ICON_ENTRY));
+    entry->RefCount = 1;
+    entry->Cached = cached;
+    entry->ImageListIndex = -1;
+
+    if (!PhExtractIconEx(FileName, IconIndex, &entry->Icon.LargeIcon, &entry->Icon.SmallIcon))
+    {
+        entry->Icon.LargeIcon = NULL;
+        entry->Icon.SmallIcon = NULL;
+    }
+
+    if (cached)
+    {
+        PPH_FILE_ICON_ENTRY existingEntry;
+
+        PhAcquireQueuedLockExclusive(&PhpFileIconCacheLock);
+
+        if (entryPtr = PhFindEntryHashtable(PhpFileIconHashtable, &lookupEntryPtr))
+        {
+            existingEntry = *entryPtr;
+            PhpReferenceFileIconEntry(existingEntry);
+            PhReleaseQueuedLockExclusive(&PhpFileIconCacheLock);
+
+            PhpDestroyFileIconEntry(entry);
+
+            return &existingEntry->Icon;
+        }
+
+        PhAddEntryHashtable(PhpFileIconHashtable, &entry);
+
+        PhReleaseQueuedLockExclusive(&PhpFileIconCacheLock);
+    }
+
+    return &entry->Icon;
+}
+
+/**
+ * References file icons.
+ *
+ * \param Icon The icons returned by PhGetFileIcon().
+ */
+PPH_FILE_ICON PhReferenceFileIcon(
+    _In_ PPH_FILE_ICON Icon
+    )
+{
+    PPH_FILE_ICON_ENTRY entry = CONTAINING_RECORD(Icon, PH_FILE_ICON_ENTRY, Icon);
+
+    PhAcquireQueuedLockExclusive(&PhpFileIconCacheLock);
+    PhpReferenceFileIconEntry(entry);
+    PhReleaseQueuedLockExclusive(&PhpFileIconCacheLock);
+
+    return Icon;
+}
+
+/**
+ * Dereferences file icons.
+ *
+ * \param Icon The icons returned by PhGetFileIcon().
+ */
+VOID PhDereferenceFileIcon(
+    _In_ PPH_FILE_ICON Icon
+    )
+{
+    PPH_FILE_ICON_ENTRY entry = CONTAINING_RECORD(Icon, PH_FILE_ICON_ENTRY, Icon);
+    PPH_FILE_ICON_ENTRY entryToDestroy = NULL;
+
+    PhAcquireQueuedLockExclusive(&PhpFileIconCacheLock);
+
+    if (--entry->RefCount == 0)
+    {
+        if (entry->Cached)
+        {
+            InsertHeadList(&PhpUnusedFileIconListHead, &entry->ListEntry);
+
+            if (++PhpNumberOfUnusedFileIcons > PH_FILE_ICON_CACHE_SIZE)
+            {
+                entryToDestroy = CONTAINING_RECORD(PhpUnusedFileIconListHead.Blink, PH_FILE_ICON_ENTRY, ListEntry);
+                RemoveEntryList(&entryToDestroy->ListEntry);
+                PhpNumberOfUnusedFileIcons--;
+                PhRemoveEntryHashtable(PhpFileIconHashtable, &entryToDestroy);
+            }
+        }
+        else
+        {
+            entryToDestroy = entry;
+        }
+
+        if (entryToDestroy)
+            PhpFreeFileIconImageListIndex(entryToDestroy);
+    }
+
+    PhReleaseQueuedLockExclusive(&PhpFileIconCacheLock);
+
+    if (entryToDestroy)
+        PhpDestroyFileIconEntry(entryToDestroy);
+}
+
+/**
+ * Gets the shared image list that contains small file icons.
+ *
+ * \remarks The image list must not be destroyed. List views that use it must have the
+ * LVS_SHAREIMAGELISTS style.
+ */
+HIMAGELIST PhGetFileIconImageList(
+    VOID
+    )
+{
+    HIMAGELIST imageList;
+
+    PhpInitializeFileIconCache();
+
+    PhAcquireQueuedLockExclusive(&PhpFileIconCacheLock);
+    imageList = PhpGetFileIconImageList();
+    PhReleaseQueuedLockExclusive(&PhpFileIconCacheLock);
+
+    return imageList;
+}
+
+/**
+ * Gets the index of a small file icon in the image list returned by PhGetFileIconImageList().
+ *
+ * \param Icon The icons returned by PhGetFileIcon().
+ *
+ * \return The index of the small icon, or 0 (the stock application icon) if there is no small
+ * icon. The index is valid until the icons are dereferenced.
+ */
+INT PhGetFileIconImageListIndex(
+    _In_ PPH_FILE_ICON Icon
+    )
+{
+    PPH_FILE_ICON_ENTRY entry = CONTAINING_RECORD(Icon, PH_FILE_ICON_ENTRY, Icon);
+    HIMAGELIST imageList;
+    INT index;
+
+    if (!Icon->SmallIcon)
+        return 0;
+
+    PhAcquireQueuedLockExclusive(&PhpFileIconCacheLock);
+
+    if (entry->ImageListIndex == -1)
+    {
+        imageList = PhpGetFileIconImageList();
+
+        if (PhpFreeFileIconImageListIndices->Count != 0)
+        {
+            index = (INT)(ULONG_PTR)PhpFreeFileIconImageListIndices->Items[PhpFreeFileIconImageListIndices->Count - 1];
+            PhRemoveItemList(PhpFreeFileIconImageListIndices, PhpFreeFileIconImageListIndices->Count - 1);
+            index = ImageList_ReplaceIcon(imageList, index, Icon->SmallIcon);
+        }
+        else
+        {
+            index = ImageList_AddIcon(imageList, Icon->SmallIcon);
+        }
+
+        if (index > 0)
+            entry->ImageListIndex = index;
+    }
+
+    index = entry->ImageListIndex;
+
+    PhReleaseQueuedLockExclusive(&PhpFileIconCacheLock);
+
+    return index > 0 ? index : 0;
+}
@@ -0,0 +1,139 @@
+#ifndef _PH_BINLOG_H
+#define _PH_BINLOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// On-disk structures
+
+// A binary log is a file header followed by a fixed number of equally sized segments, which are
+// used as a ring. Records have a fixed size and are allocated from the start of a segment, while
+// the strings they refer to are allocated from the end of the same segment. Each segment is
+// therefore self-contained and can be reused as a whole once it becomes the oldest segment.
+//
+// Records are identified by a 64-bit sequence number. The records in a segment are numbered
+// consecutively from the segment's first sequence number, so any record can be located by
+// finding its segment and indexing into it.
+
+#define PH_BINARY_LOG_MAGIC ('goLB')
+#define PH_BINARY_LOG_VERSION 1
+
+/** The number of hash slots in each segment used to find strings that have already been stored. */
+#define PH_BINARY_LOG_INTERN_COUNT 256
+/** The number of 32-bit values in each record. */
+#define PH_BINARY_LOG_VALUE_COUNT 4
+/** The number of strings that can be referenced by each record. */
+#define PH_BINARY_LOG_STRING_COUNT 4
+/** The maximum length of a string, in bytes. Longer strings are truncated. */
+#define PH_BINARY_LOG_MAXIMUM_STRING_LENGTH 0x2000
+
+typedef struct _PH_BINARY_LOG_FILE_HEADER
+{
+    ULONG Magic;
+    ULONG Version;
+    ULONG SegmentShift;
+    ULONG NumberOfSegments;
+} PH_BINARY_LOG_FILE_HEADER, *PPH_BINARY_LOG_FILE_HEADER;
+
+typedef struct _PH_BINARY_LOG_SEGMENT_HEADER
+{
+    ULONG Magic;
+    ULONG Reserved;
+    /** The sequence number of the first record, or MAXULONG64 if the segment is not in use. */
+    volatile ULONG64 FirstSequence;
+    /** The end of the records in the low 32 bits and the start of the strings in the high 32
+     * bits, both as offsets from the segment header. */
+    volatile LONG64 Allocation;
+    /** Each non-zero entry is the hash of a string in the high 32 bits and its offset in the low
+     * 32 bits. */
+    volatile LONG64 InternTable[PH_BINARY_LOG_INTERN_COUNT];
+} PH_BINARY_LOG_SEGMENT_HEADER, *PPH_BINARY_LOG_SEGMENT_HEADER;
+
+typedef struct _PH_BINARY_LOG_RECORD
+{
+    /** The type of the record. This is zero until the record has been completely written. */
+    volatile ULONG Type;
+    ULONG Flags;
+    LARGE_INTEGER Time;
+    ULONG Values[PH_BINARY_LOG_VALUE_COUNT];
+    /** The offset of each string from the segment header, or zero if there is no string. */
+    ULONG Strings[PH_BINARY_LOG_STRING_COUNT];
+} PH_BINARY_LOG_RECORD, *PPH_BINARY_LOG_RECORD;
+
+// Runtime
+
+typedef struct _PH_BINARY_LOG
+{
+    HANDLE FileHandle;
+    HANDLE SectionHandle;
+    PVOID ViewBase;
+
+    ULONG SegmentShift;
+    ULONG SegmentSize;
+    ULONG NumberOfSegments;
+    PUCHAR FirstSegment;
+    volatile ULONG CurrentSegment;
+
+    /** Guards the switch to a new segment. Appending records does not acquire this lock. */
+    PH_QUEUED_LOCK RotateLock;
+} PH_BINARY_LOG, *PPH_BINARY_LOG;
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhCreateBinaryLog(
+    _Out_ PPH_BINARY_LOG *Log,
+    _In_opt_ PWSTR FileName,
+    _In_ ULONG SegmentShift,
+    _In_ ULONG NumberOfSegments
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDestroyBinaryLog(
+    _In_ _Post_invalid_ PPH_BINARY_LOG Log
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhClearBinaryLog(
+    _Inout_ PPH_BINARY_LOG Log
+    );
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhWriteBinaryLog(
+    _Inout_ PPH_BINARY_LOG Log,
+    _In_ PPH_BINARY_LOG_RECORD Record,
+    _In_reads_opt_(PH_BINARY_LOG_STRING_COUNT) PPH_STRINGREF *Strings,
+    _Out_opt_ PULONG64 Sequence
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhQueryBinaryLogRange(
+    _In_ PPH_BINARY_LOG Log,
+    _Out_ PULONG64 FirstSequence,
+    _Out_ PULONG64 NextSequence
+    );
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhReadBinaryLog(
+    _In_ PPH_BINARY_LOG Log,
+    _In_ ULONG64 Sequence,
+    _Out_ PPH_BINARY_LOG_RECORD Record,
+    _Out_writes_opt_(PH_BINARY_LOG_STRING_COUNT) PPH_STRING *Strings
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef _PH_COLSNAP_H
+#define _PH_COLSNAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// On-disk structures
+
+// A snapshot file is a sequence of snapshots, each of which starts with a snapshot header and
+// can be skipped as a whole using its length. A snapshot contains tables of rows that are stored
+// column by column: each table header is followed by its column headers, and then by the
+// dictionary and data of each column in order. All integers are little-endian and the layout has
+// no padding. tools/snapshot contains a portable reader.
+//
+// Integer columns store the difference between each value and the previous value in the column
+// (starting from zero), zigzag-encoded and written as an unsigned LEB128 varint. Values that are
+// sorted or repeated, such as IDs and sample times, therefore take one byte per row.
+//
+// String columns store each distinct UTF-8 string once in the column's dictionary, as a varint
+// length followed by the bytes. The data is a varint for each row: zero for a missing string, or
+// one plus the index of the string in the dictionary.
+
+#define PH_SNAPSHOT_MAGIC ('SSHP')
+#define PH_SNAPSHOT_VERSION 1
+
+#define PH_SNAPSHOT_TABLE_NAME_SIZE 16
+#define PH_SNAPSHOT_COLUMN_NAME_SIZE 24
+
+#define PH_SNAPSHOT_COLUMN_INTEGER 1
+#define PH_SNAPSHOT_COLUMN_STRING 2
+
+typedef struct _PH_SNAPSHOT_HEADER
+{
+    ULONG Magic;
+    ULONG Version;
+    /** The length of the snapshot, including this header. */
+    ULONG64 Length;
+    /** The time at which the snapshot was taken, in UTC. */
+    LONG64 Time;
+    ULONG NumberOfTables;
+    ULONG Reserved;
+} PH_SNAPSHOT_HEADER, *PPH_SNAPSHOT_HEADER;
+
+typedef struct _PH_SNAPSHOT_TABLE_HEADER
+{
+    /** The name of the table, padded with null characters. */
+    CHAR Name[PH_SNAPSHOT_TABLE_NAME_SIZE];
+    ULONG NumberOfRows;
+    ULONG NumberOfColumns;
+    /** The length of the table, including this header. */
+    ULONG64 Length;
+} PH_SNAPSHOT_TABLE_HEADER, *PPH_SNAPSHOT_TABLE_HEADER;
+
+typedef struct _PH_SNAPSHOT_COLUMN_HEADER
+{
+    /** The name of the column, padded with null characters. */
+    CHAR Name[PH_SNAPSHOT_COLUMN_NAME_SIZE];
+    ULONG Type;
+    ULONG NumberOfDictionaryEntries;
+    ULONG64 DictionaryLength;
+    ULONG64 DataLength;
+} PH_SNAPSHOT_COLUMN_HEADER, *PPH_SNAPSHOT_COLUMN_HEADER;
+
+// Writer
+
+typedef struct _PH_SNAPSHOT_WRITER *PPH_SNAPSHOT_WRITER;
+
+PHLIBAPI
+PPH_SNAPSHOT_WRITER
+NTAPI
+PhCreateSnapshotWriter(
+    VOID
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDestroySnapshotWriter(
+    _In_ _Post_invalid_ PPH_SNAPSHOT_WRITER Writer
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhBeginSnapshotRow(
+    _Inout_ PPH_SNAPSHOT_WRITER Writer,
+    _In_ PSTR TableName
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhAddSnapshotInteger(
+    _Inout_ PPH_SNAPSHOT_WRITER Writer,
+    _In_ PSTR ColumnName,
+    _In_ LONG64 Value
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhAddSnapshotString(
+    _Inout_ PPH_SNAPSHOT_WRITER Writer,
+    _In_ PSTR ColumnName,
+    _In_opt_ PPH_STRINGREF Value
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhEndSnapshotRow(
+    _Inout_ PPH_SNAPSHOT_WRITER Writer
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhWriteSnapshot(
+    _Inout_ PPH_SNAPSHOT_WRITER Writer,
+    _In_ LONG64 Time,
+    _Inout_ PPH_BYTES_BUILDER BytesBuilder
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -373,6 +373,40 @@ HICON PhGetFileShellIcon(
     _In_ BOOLEAN LargeIcon
     );
 
+// iconcache
+
+typedef struct _PH_FILE_ICON
+{
+    HICON SmallIcon;
+    HICON LargeIcon;
+} PH_FILE_ICON, *PPH_FILE_ICON;
+
+PHLIBAPI
+PPH_FILE_ICON PhGetFileIcon(
+    _In_ PWSTR FileName,
+    _In_ INT IconIndex
+    );
+
+PHLIBAPI
+PPH_FILE_ICON PhReferenceFileIcon(
+    _In_ PPH_FILE_ICON Icon
+    );
+
+PHLIBAPI
+VOID PhDereferenceFileIcon(
+    _In_ PPH_FILE_ICON Icon
+    );
+
+PHLIBAPI
+HIMAGELIST PhGetFileIconImageList(
+    VOID
+    );
+
+PHLIBAPI
+INT PhGetFileIconImageListIndex(
+    _In_ PPH_FILE_ICON Icon
+    );
+
 PHLIBAPI
 VOID PhSetClipboardString(
     _In_ HWND hWnd,
@@ -0,0 +1,121 @@
+#ifndef _PH_HISTBUF_H
+#define _PH_HISTBUF_H
+
+#include <circbuf.h>
+
+// A history buffer keeps progressively coarser summaries of a sample stream. Each level holds
+// the average, minimum and maximum of consecutive groups of Factor items from the level below
+// (level 0 summarizes Factor raw samples), so a graph can show a long window at any zoom level
+// by reading one item per data point from the appropriate level.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PH_HISTORY_BUFFER_MAXIMUM_LEVELS 8
+
+typedef enum _PH_HISTORY_AGGREGATE
+{
+    AverageHistoryAggregate,
+    MinimumHistoryAggregate,
+    MaximumHistoryAggregate
+} PH_HISTORY_AGGREGATE;
+
+typedef struct _PH_HISTORY_LEVEL
+{
+    ULONG Scale; // number of raw samples per item
+    PH_CIRCULAR_BUFFER_FLOAT Average;
+    PH_CIRCULAR_BUFFER_FLOAT Minimum;
+    PH_CIRCULAR_BUFFER_FLOAT Maximum;
+
+    // The incomplete group of items from the level below.
+    ULONG PendingCount;
+    FLOAT PendingSum;
+    FLOAT PendingMinimum;
+    FLOAT PendingMaximum;
+} PH_HISTORY_LEVEL, *PPH_HISTORY_LEVEL;
+
+typedef struct _PH_HISTORY_BUFFER
+{
+    ULONG Factor;
+    ULONG NumberOfLevels;
+    PPH_HISTORY_LEVEL Levels;
+} PH_HISTORY_BUFFER, *PPH_HISTORY_BUFFER;
+
+PHLIBAPI
+VOID
+NTAPI
+PhInitializeHistoryBuffer(
+    _Out_ PPH_HISTORY_BUFFER Buffer,
+    _In_ ULONG Size,
+    _In_ ULONG Factor,
+    _In_ ULONG NumberOfLevels
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDeleteHistoryBuffer(
+    _Inout_ PPH_HISTORY_BUFFER Buffer
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhClearHistoryBuffer(
+    _Inout_ PPH_HISTORY_BUFFER Buffer
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhAddItemHistoryBuffer(
+    _Inout_ PPH_HISTORY_BUFFER Buffer,
+    _In_ FLOAT Value
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhCopyHistoryBuffer(
+    _Inout_ PPH_HISTORY_BUFFER Buffer,
+    _In_ ULONG Level,
+    _In_ PH_HISTORY_AGGREGATE Aggregate,
+    _Out_writes_(Count) PFLOAT Destination,
+    _In_ ULONG Count
+    );
+
+PHLIBAPI
+ULONG
+NTAPI
+PhGetSampleIndexHistoryBuffer(
+    _In_ PPH_HISTORY_BUFFER Buffer,
+    _In_ ULONG Level,
+    _In_ ULONG Index
+    );
+
+FORCEINLINE FLOAT PhGetItemHistoryBuffer(
+    _In_ PPH_HISTORY_BUFFER Buffer,
+    _In_ ULONG Level,
+    _In_ PH_HISTORY_AGGREGATE Aggregate,
+    _In_ LONG Index
+    )
+{
+    PPH_HISTORY_LEVEL level = &Buffer->Levels[Level];
+
+    switch (Aggregate)
+    {
+    case MinimumHistoryAggregate:
+        return PhGetItemCircularBuffer_FLOAT(&level->Minimum, Index);
+    case MaximumHistoryAggregate:
+        return PhGetItemCircularBuffer_FLOAT(&level->Maximum, Index);
+    default:
+        return PhGetItemCircularBuffer_FLOAT(&level->Average, Index);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -206,6 +206,242 @@ PhSaveJsonObjectToFile(
     _In_ PVOID Object
     );
 
+// Streaming reader and writer
+
+// The reader returns the tokens of a UTF-8 JSON document one at a time without building a tree or
+// allocating memory. Strings are returned as they appear in the document and are only unescaped
+// when they are converted.
+
+#define PH_JSON_MAXIMUM_DEPTH 64
+
+typedef enum _PH_JSON_TOKEN_TYPE
+{
+    PH_JSON_TOKEN_NONE,
+    PH_JSON_TOKEN_BEGIN_OBJECT,
+    PH_JSON_TOKEN_END_OBJECT,
+    PH_JSON_TOKEN_BEGIN_ARRAY,
+    PH_JSON_TOKEN_END_ARRAY,
+    PH_JSON_TOKEN_STRING,
+    PH_JSON_TOKEN_NUMBER,
+    PH_JSON_TOKEN_BOOLEAN,
+    PH_JSON_TOKEN_NULL
+} PH_JSON_TOKEN_TYPE;
+
+typedef struct _PH_JSON_VALUE
+{
+    PH_JSON_TOKEN_TYPE Type;
+    /** Whether the string contains escape sequences. */
+    BOOLEAN Escaped;
+    /** The contents of a string without the quotes, the text of a number or literal, or the
+     * bracket of an object or array. */
+    PH_BYTESREF Text;
+} PH_JSON_VALUE, *PPH_JSON_VALUE;
+
+typedef struct _PH_JSON_READER
+{
+    PCH Current;
+    PCH End;
+    /** STATUS_SUCCESS, or an error code if the document is malformed. */
+    NTSTATUS Status;
+
+    /** The current token. */
+    PH_JSON_VALUE Value;
+    /** The nesting level of the current token. The top-level value is at depth 0. */
+    ULONG Depth;
+    /** The position of the current value in its parent object or array. */
+    ULONG Index;
+    /** The name of the current value if its parent is an object. The name is not unescaped. */
+    PH_BYTESREF Key;
+
+    ULONG ScopeCount;
+    UCHAR Scopes[PH_JSON_MAXIMUM_DEPTH];
+    ULONG Counts[PH_JSON_MAXIMUM_DEPTH];
+} PH_JSON_READER, *PPH_JSON_READER;
+
+PHLIBAPI
+VOID
+NTAPI
+PhInitializeJsonReader(
+    _Out_ PPH_JSON_READER Reader,
+    _In_reads_bytes_(Length) PVOID Buffer,
+    _In_ SIZE_T Length
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhReadJsonToken(
+    _Inout_ PPH_JSON_READER Reader
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhSkipJsonValue(
+    _Inout_ PPH_JSON_READER Reader
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhEqualJsonKey(
+    _In_ PPH_JSON_READER Reader,
+    _In_ PSTR Key
+    );
+
+PHLIBAPI
+PPH_STRING
+NTAPI
+PhJsonValueToString(
+    _In_ PPH_JSON_VALUE Value
+    );
+
+PHLIBAPI
+LONG64
+NTAPI
+PhJsonValueToInteger64(
+    _In_ PPH_JSON_VALUE Value
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhJsonValueToBoolean(
+    _In_ PPH_JSON_VALUE Value
+    );
+
+typedef struct _PH_JSON_QUERY
+{
+    /** Member names separated by dots. Array elements are selected by index, e.g. "data.0.hash". */
+    PSTR Path;
+    /** The value that was found. The type is PH_JSON_TOKEN_NONE if the path was not found. For
+     * objects and arrays, the text is the entire object or array. */
+    PH_JSON_VALUE Value;
+} PH_JSON_QUERY, *PPH_JSON_QUERY;
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhQueryJson(
+    _In_reads_bytes_(Length) PVOID Buffer,
+    _In_ SIZE_T Length,
+    _Inout_updates_(NumberOfQueries) PPH_JSON_QUERY Queries,
+    _In_ ULONG NumberOfQueries
+    );
+
+// The writer appends UTF-8 JSON to a byte string builder. Keys are UTF-8 and may be NULL for
+// array elements and the top-level value.
+
+typedef struct _PH_JSON_WRITER
+{
+    PH_BYTES_BUILDER BytesBuilder;
+    ULONG Depth;
+    UCHAR Scopes[PH_JSON_MAXIMUM_DEPTH];
+} PH_JSON_WRITER, *PPH_JSON_WRITER;
+
+PHLIBAPI
+VOID
+NTAPI
+PhInitializeJsonWriter(
+    _Out_ PPH_JSON_WRITER Writer,
+    _In_ SIZE_T InitialCapacity
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDeleteJsonWriter(
+    _Inout_ PPH_JSON_WRITER Writer
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhResetJsonWriter(
+    _Inout_ PPH_JSON_WRITER Writer
+    );
+
+PHLIBAPI
+PPH_BYTES
+NTAPI
+PhFinalJsonWriterBytes(
+    _Inout_ PPH_JSON_WRITER Writer
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhWriteJsonBeginObject(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhWriteJsonEndObject(
+    _Inout_ PPH_JSON_WRITER Writer
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhWriteJsonBeginArray(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhWriteJsonEndArray(
+    _Inout_ PPH_JSON_WRITER Writer
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhWriteJsonString(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key,
+    _In_ PPH_STRINGREF Value
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhWriteJsonStringZ(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key,
+    _In_ PSTR Value
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhWriteJsonInteger64(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key,
+    _In_ LONG64 Value
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhWriteJsonBoolean(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key,
+    _In_ BOOLEAN Value
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhWriteJsonNull(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key
+    );
+
 #ifdef __cplusplus
 }
 #endif
@@ -225,7 +225,7 @@ typedef enum _PH_PEB_OFFSET
     PhpoTypeMask = 0xffff,
 
     PhpoWow64 = 0x10000
-} PH_PEB_OFFSET;
+} PH_PEB_OFFSET, *PPH_PEB_OFFSET;
 
 PHLIBAPI
 NTSTATUS
@@ -236,6 +236,46 @@ PhGetProcessPebString(
     _Out_ PPH_STRING *String
     );
 
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhGetProcessPebStrings(
+    _In_ HANDLE ProcessHandle,
+    _In_ ULONG Count,
+    _In_reads_(Count) PPH_PEB_OFFSET Offsets,
+    _Out_writes_(Count) PPH_STRING *Strings
+    );
+
+/**
+ * A callback function passed to PhGetProcessPebStringsEx() to read memory.
+ *
+ * \param ProcessHandle The process handle passed to PhGetProcessPebStringsEx().
+ * \param BaseAddress The address to read from.
+ * \param Buffer A buffer which receives the memory.
+ * \param BufferSize The number of bytes to read.
+ * \param Context A user-defined value passed to PhGetProcessPebStringsEx().
+ */
+typedef NTSTATUS (NTAPI *PPH_READ_VIRTUAL_MEMORY_CALLBACK)(
+    _In_ HANDLE ProcessHandle,
+    _In_ PVOID BaseAddress,
+    _Out_writes_bytes_(BufferSize) PVOID Buffer,
+    _In_ SIZE_T BufferSize,
+    _In_opt_ PVOID Context
+    );
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhGetProcessPebStringsEx(
+    _In_ HANDLE ProcessHandle,
+    _In_ PVOID PebBaseAddress,
+    _In_ ULONG Count,
+    _In_reads_(Count) PPH_PEB_OFFSET Offsets,
+    _Out_writes_(Count) PPH_STRING *Strings,
+    _In_opt_ PPH_READ_VIRTUAL_MEMORY_CALLBACK ReadMemory,
+    _In_opt_ PVOID Context
+    );
+
 PHLIBAPI
 NTSTATUS
 NTAPI
@@ -900,6 +940,16 @@ PhGetKernelFileName(
     sizeof(SYSTEM_EXTENDED_THREAD_INFORMATION) * \
     ((PSYSTEM_PROCESS_INFORMATION)(Process))->NumberOfThreads))
 
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhQuerySystemInformation(
+    _In_ SYSTEM_INFORMATION_CLASS SystemInformationClass,
+    _Out_writes_bytes_opt_(SystemInformationLength) PVOID SystemInformation,
+    _In_ ULONG SystemInformationLength,
+    _Out_opt_ PULONG ReturnLength
+    );
+
 PHLIBAPI
 NTSTATUS
 NTAPI
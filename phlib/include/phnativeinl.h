@@ -461,6 +461,31 @@ PhGetProcessCycleTime(
     return status;
 }
 
+/**
+ * Gets a process' sequence number, which is unique for each process since the system was started.
+ *
+ * \param ProcessHandle A handle to a process. The handle must have
+ * PROCESS_QUERY_LIMITED_INFORMATION access.
+ * \param SequenceNumber A variable which receives the sequence number.
+ *
+ * \remarks This is only supported on Windows 10 RS3 and above.
+ */
+FORCEINLINE
+NTSTATUS
+PhGetProcessSequenceNumber(
+    _In_ HANDLE ProcessHandle,
+    _Out_ PULONGLONG SequenceNumber
+    )
+{
+    return NtQueryInformationProcess(
+        ProcessHandle,
+        ProcessSequenceNumber,
+        SequenceNumber,
+        sizeof(ULONGLONG),
+        NULL
+        );
+}
+
 FORCEINLINE
 NTSTATUS
 PhGetProcessUptime(
@@ -0,0 +1,113 @@
+#ifndef _PH_PHQUERY_H
+#define _PH_PHQUERY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A query is a boolean expression over the fields of an object, for example:
+//
+//     cpu>5 and user:SYSTEM and name~"svc*"
+//
+// Predicates have the form field op value, where op is one of:
+//
+//     :   string contains the value, or number equals the value
+//     =   string equals the value, or number equals the value
+//     !=  negation of =
+//     ~   string matches the value, which may contain * and ? wildcards
+//     < <= > >=   number comparison
+//
+// String comparisons ignore case. Numbers may end in k, m or g (or kb, mb, gb) to multiply them by
+// 1024, 1024^2 or 1024^3. Values that contain spaces or operators can be quoted with double
+// quotes. Predicates can be combined using and, or (or |), not and parentheses; adjacent
+// predicates are combined using and. A word on its own is a text predicate which is passed to the
+// schema's MatchText callback.
+//
+// The query is compiled into a program which is evaluated with short-circuiting. Within each
+// sequence of and/or operands, number predicates are evaluated first, then string predicates and
+// finally text predicates.
+
+#define PH_QUERY_FIELD_NUMBER 1
+#define PH_QUERY_FIELD_STRING 2
+
+typedef struct _PH_QUERY_FIELD
+{
+    PH_STRINGREF Name;
+    ULONG Type;
+    ULONG Id;
+} PH_QUERY_FIELD, *PPH_QUERY_FIELD;
+
+typedef DOUBLE (NTAPI *PPH_QUERY_GET_NUMBER)(
+    _In_ ULONG FieldId,
+    _In_ PVOID Object
+    );
+
+/**
+ * Gets the value of a string field.
+ *
+ * \param FieldId The ID of the field.
+ * \param Object The object passed to PhEvaluateQuery().
+ * \param Value A variable which receives the string. The string does not need to be
+ * null-terminated.
+ *
+ * \return FALSE if the object has no value for the field, in which case every predicate on
+ * the field is false.
+ */
+typedef BOOLEAN (NTAPI *PPH_QUERY_GET_STRING)(
+    _In_ ULONG FieldId,
+    _In_ PVOID Object,
+    _Out_ PPH_STRINGREF Value
+    );
+
+/**
+ * Checks whether an object matches a text predicate.
+ *
+ * \param Text The text, in upper case.
+ * \param Object The object passed to PhEvaluateQuery().
+ */
+typedef BOOLEAN (NTAPI *PPH_QUERY_MATCH_TEXT)(
+    _In_ PPH_STRINGREF Text,
+    _In_ PVOID Object
+    );
+
+typedef struct _PH_QUERY_SCHEMA
+{
+    PPH_QUERY_FIELD Fields;
+    ULONG NumberOfFields;
+    PPH_QUERY_GET_NUMBER GetNumber;
+    PPH_QUERY_GET_STRING GetString;
+    PPH_QUERY_MATCH_TEXT MatchText;
+} PH_QUERY_SCHEMA, *PPH_QUERY_SCHEMA;
+
+typedef struct _PH_QUERY *PPH_QUERY;
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhCompileQuery(
+    _In_ PPH_STRINGREF Text,
+    _In_ PPH_QUERY_SCHEMA Schema,
+    _Out_ PPH_QUERY *Query,
+    _Out_opt_ PULONG NumberOfFieldPredicates
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhFreeQuery(
+    _In_ _Post_invalid_ PPH_QUERY Query
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhEvaluateQuery(
+    _In_ PPH_QUERY Query,
+    _In_ PVOID Object
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
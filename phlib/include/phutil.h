@@ -1046,6 +1046,70 @@ PhFinalHash(
     _Out_opt_ PULONG ReturnLength
     );
 
+#define PH_FILE_HASH_MD5 0x1
+#define PH_FILE_HASH_SHA1 0x2
+#define PH_FILE_HASH_SHA256 0x4
+#define PH_FILE_HASH_ALL (PH_FILE_HASH_MD5 | PH_FILE_HASH_SHA1 | PH_FILE_HASH_SHA256)
+
+typedef struct _PH_FILE_HASHES
+{
+    ULONG Flags; // PH_FILE_HASH_* values which are valid
+    UCHAR Md5[16];
+    UCHAR Sha1[20];
+    UCHAR Sha256[32];
+} PH_FILE_HASHES, *PPH_FILE_HASHES;
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhHashFile(
+    _In_ HANDLE FileHandle,
+    _In_ ULONG Flags,
+    _Out_ PPH_FILE_HASHES Hashes
+    );
+
+typedef struct _PH_FILE_HASH_ITEM
+{
+    // Input
+    PPH_STRING FileName; // used when FileHandle is NULL
+    HANDLE FileHandle;
+    ULONG Flags;
+    PVOID Context;
+
+    // Output
+    NTSTATUS Status;
+    BOOLEAN Cached;
+    ULONG VolumeSerialNumber;
+    LARGE_INTEGER FileId;
+    LARGE_INTEGER LastWriteTime;
+    LARGE_INTEGER EndOfFile;
+    PH_FILE_HASHES Hashes;
+} PH_FILE_HASH_ITEM, *PPH_FILE_HASH_ITEM;
+
+/**
+ * A callback function which looks up previously computed hashes for a file.
+ *
+ * \param Item The item being hashed. The identity fields (VolumeSerialNumber, FileId,
+ * LastWriteTime and EndOfFile) are valid.
+ * \param Context A user-defined value passed to PhHashFiles().
+ *
+ * \return TRUE if \a Item->Hashes was filled in, otherwise FALSE.
+ */
+typedef BOOLEAN (NTAPI *PPH_FILE_HASH_LOOKUP_CALLBACK)(
+    _Inout_ PPH_FILE_HASH_ITEM Item,
+    _In_opt_ PVOID Context
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhHashFiles(
+    _Inout_updates_(NumberOfItems) PPH_FILE_HASH_ITEM Items,
+    _In_ ULONG NumberOfItems,
+    _In_opt_ PPH_FILE_HASH_LOOKUP_CALLBACK LookupCallback,
+    _In_opt_ PVOID Context
+    );
+
 typedef enum _PH_COMMAND_LINE_OPTION_TYPE
 {
     NoArgumentType,
@@ -24,6 +24,28 @@ typedef VOID (NTAPI *PPH_PROVIDER_FUNCTION)(
 struct _PH_PROVIDER_THREAD;
 typedef struct _PH_PROVIDER_THREAD *PPH_PROVIDER_THREAD;
 
+// Schedule flags
+
+// The interval is doubled after each run in which the provider didn't call PhSetChangedProvider,
+// up to PH_PROVIDER_MAXIMUM_BACKOFF times the interval.
+#define PH_PROVIDER_BACKOFF_UNCHANGED 0x1
+// The interval is multiplied by PH_PROVIDER_BACKGROUND_BACKOFF while the provider thread is in the
+// background.
+#define PH_PROVIDER_BACKOFF_BACKGROUND 0x2
+
+#define PH_PROVIDER_MAXIMUM_BACKOFF 8
+#define PH_PROVIDER_BACKGROUND_BACKOFF 4
+
+typedef struct _PH_PROVIDER_STATISTICS
+{
+    ULONG NumberOfRuns;
+    ULONG NumberOfSkippedRuns; // timer ticks on which the provider was enabled but not due
+    ULONG Backoff; // current multiplier of the interval
+    ULONG64 LastRunTime; // in 100ns units
+    ULONG64 MaximumRunTime;
+    ULONG64 TotalRunTime;
+} PH_PROVIDER_STATISTICS, *PPH_PROVIDER_STATISTICS;
+
 typedef struct _PH_PROVIDER_REGISTRATION
 {
     LIST_ENTRY ListEntry;
@@ -34,6 +56,12 @@ typedef struct _PH_PROVIDER_REGISTRATION
     BOOLEAN Enabled;
     BOOLEAN Unregistering;
     BOOLEAN Boosting;
+    BOOLEAN Changed;
+
+    ULONG Interval; // in milliseconds, or 0 to use the interval of the provider thread
+    ULONG Flags;
+    ULONG64 DueTime; // tick count of the next periodic run
+    PH_PROVIDER_STATISTICS Statistics;
 } PH_PROVIDER_REGISTRATION, *PPH_PROVIDER_REGISTRATION;
 
 typedef struct _PH_PROVIDER_THREAD
@@ -46,6 +74,8 @@ typedef struct _PH_PROVIDER_THREAD
     PH_QUEUED_LOCK Lock;
     LIST_ENTRY ListHead;
     ULONG BoostCount;
+    BOOLEAN Background;
+    PPH_PROVIDER_REGISTRATION CurrentRegistration; // the provider being run, if it is still registered
 } PH_PROVIDER_THREAD, *PPH_PROVIDER_THREAD;
 
 PHLIBAPI
@@ -85,6 +115,14 @@ PhSetIntervalProviderThread(
     _In_ ULONG Interval
     );
 
+PHLIBAPI
+VOID
+NTAPI
+PhSetBackgroundProviderThread(
+    _Inout_ PPH_PROVIDER_THREAD ProviderThread,
+    _In_ BOOLEAN Background
+    );
+
 PHLIBAPI
 VOID
 NTAPI
@@ -132,6 +170,30 @@ PhSetEnabledProvider(
     _In_ BOOLEAN Enabled
     );
 
+PHLIBAPI
+VOID
+NTAPI
+PhSetScheduleProvider(
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration,
+    _In_ ULONG Interval,
+    _In_ ULONG Flags
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhSetChangedProvider(
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhGetStatisticsProvider(
+    _In_ PPH_PROVIDER_REGISTRATION Registration,
+    _Out_ PPH_PROVIDER_STATISTICS Statistics
+    );
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,6 +29,10 @@ typedef enum _PH_SETTING_TYPE
     IntegerPairSettingType,
     ScalableIntegerPairSettingType
 } PH_SETTING_TYPE, PPH_SETTING_TYPE;
+
+// A setting handle refers to a setting for the lifetime of the program. Looking up a handle once
+// and using it afterwards avoids hashing the setting name on every access.
+typedef struct _PH_SETTING *PPH_SETTING_HANDLE;
 // end_phapppub
 
 typedef struct _PH_SETTING
@@ -43,6 +47,9 @@ typedef struct _PH_SETTING
         ULONG Integer;
         PH_INTEGER_PAIR IntegerPair;
     } u;
+
+    BOOLEAN Modified; // changed since the binary store was last read or written
+    volatile ULONG Version; // incremented before and after each change, odd while changing
 } PH_SETTING, *PPH_SETTING;
 
 PHLIBAPI
@@ -186,6 +193,99 @@ PhSetStringSetting2(
     _In_ PWSTR Name,
     _In_ PPH_STRINGREF Value
     );
+
+// Setting handles
+
+_May_raise_
+PHLIBAPI
+PPH_SETTING_HANDLE
+NTAPI
+PhGetSettingHandle(
+    _In_ PWSTR Name
+    );
+
+PHLIBAPI
+ULONG
+NTAPI
+PhGetSettingVersion(
+    _In_ PPH_SETTING_HANDLE Handle
+    );
+
+PHLIBAPI
+ULONG
+NTAPI
+PhGetSettingsVersion(
+    VOID
+    );
+
+_May_raise_
+PHLIBAPI
+ULONG
+NTAPI
+PhGetIntegerSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle
+    );
+
+_May_raise_
+PHLIBAPI
+PH_INTEGER_PAIR
+NTAPI
+PhGetIntegerPairSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle
+    );
+
+_May_raise_
+PHLIBAPI
+PH_SCALABLE_INTEGER_PAIR
+NTAPI
+PhGetScalableIntegerPairSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle,
+    _In_ BOOLEAN ScaleToCurrent
+    );
+
+_May_raise_
+PHLIBAPI
+PPH_STRING
+NTAPI
+PhGetStringSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle
+    );
+
+_May_raise_
+PHLIBAPI
+VOID
+NTAPI
+PhSetIntegerSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle,
+    _In_ ULONG Value
+    );
+
+_May_raise_
+PHLIBAPI
+VOID
+NTAPI
+PhSetIntegerPairSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle,
+    _In_ PH_INTEGER_PAIR Value
+    );
+
+_May_raise_
+PHLIBAPI
+VOID
+NTAPI
+PhSetScalableIntegerPairSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle,
+    _In_ PH_SCALABLE_INTEGER_PAIR Value
+    );
+
+_May_raise_
+PHLIBAPI
+VOID
+NTAPI
+PhSetStringSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle,
+    _In_ PPH_STRINGREF Value
+    );
 // end_phapppub
 
 VOID PhClearIgnoredSettings(
@@ -204,6 +304,10 @@ NTSTATUS PhSaveSettings(
     _In_ PWSTR FileName
     );
 
+NTSTATUS PhSaveSettingsBinary(
+    _In_ PWSTR FileName
+    );
+
 VOID PhResetSettings(
     VOID
     );
@@ -0,0 +1,125 @@
+#ifndef _PH_SYSTRACE_H
+#define _PH_SYSTRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// On-disk structures
+
+// A system information trace records the results of NtQuerySystemInformation calls so that they
+// can be replayed later. The file header is followed by a sequence of ticks, and each tick
+// contains the blocks of information that were queried during the tick. All integers are
+// little-endian and the layout has no padding. tools/systrace contains a portable reader.
+//
+// Each block is encoded as a delta against the previous block of the same information class
+// (or against an empty block): a sequence of varint pairs, where the first varint is the number
+// of bytes that are the same as in the previous block and the second is the number of bytes that
+// follow literally. Bytes beyond the end of the previous block count as zero. Varints are
+// unsigned LEB128.
+//
+// Process information (SystemProcessInformation, SystemExtendedProcessInformation and
+// SystemFullProcessInformation) is split into entries, one for each process, and each entry is
+// encoded as a delta against the entry of the same process in the previous block:
+//  - a varint containing zero, or one plus the index of the process in the previous block;
+//  - a varint containing the length of the entry;
+//  - the delta.
+// Processes are identified by their ID and create time. The image name pointer of each entry is
+// stored as an offset from the start of the entry, or zero if there is no image name.
+
+#define PH_SYSTEM_TRACE_MAGIC ('TSHP')
+#define PH_SYSTEM_TRACE_VERSION 1
+
+/** The maximum length of a block. */
+#define PH_SYSTEM_TRACE_MAXIMUM_BLOCK_LENGTH (256 * 1024 * 1024)
+/** The maximum length of a tick. */
+#define PH_SYSTEM_TRACE_MAXIMUM_TICK_LENGTH (1024 * 1024 * 1024)
+
+typedef struct _PH_SYSTEM_TRACE_FILE_HEADER
+{
+    ULONG Magic;
+    ULONG Version;
+    /** The size of a pointer on the system that recorded the trace. */
+    ULONG PointerSize;
+    /** The number of processors on the system that recorded the trace. */
+    ULONG NumberOfProcessors;
+} PH_SYSTEM_TRACE_FILE_HEADER, *PPH_SYSTEM_TRACE_FILE_HEADER;
+
+typedef struct _PH_SYSTEM_TRACE_TICK_HEADER
+{
+    /** The length of the tick, including this header. */
+    ULONG Length;
+    ULONG NumberOfBlocks;
+    /** The time at which the tick started, in UTC. */
+    LONG64 Time;
+} PH_SYSTEM_TRACE_TICK_HEADER, *PPH_SYSTEM_TRACE_TICK_HEADER;
+
+typedef struct _PH_SYSTEM_TRACE_BLOCK_HEADER
+{
+    ULONG InformationClass;
+    /** The length of the information. */
+    ULONG Length;
+    /** The length of the encoded information that follows this header. */
+    ULONG EncodedLength;
+    ULONG Reserved;
+} PH_SYSTEM_TRACE_BLOCK_HEADER, *PPH_SYSTEM_TRACE_BLOCK_HEADER;
+
+// Runtime
+
+typedef struct _PH_SYSTEM_TRACE *PPH_SYSTEM_TRACE;
+
+#define PH_SYSTEM_TRACE_REPLAY 0x1
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhCreateSystemTrace(
+    _Out_ PPH_SYSTEM_TRACE *Trace,
+    _In_ PWSTR FileName,
+    _In_ ULONG Flags
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDestroySystemTrace(
+    _In_ _Post_invalid_ PPH_SYSTEM_TRACE Trace
+    );
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhBeginSystemTraceTick(
+    _Inout_ PPH_SYSTEM_TRACE Trace
+    );
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhEndSystemTraceTick(
+    _Inout_ PPH_SYSTEM_TRACE Trace
+    );
+
+PHLIBAPI
+PPH_SYSTEM_TRACE
+NTAPI
+PhGetCurrentSystemTrace(
+    VOID
+    );
+
+PHLIBAPI
+NTSTATUS
+NTAPI
+PhQuerySystemTraceInformation(
+    _Inout_ PPH_SYSTEM_TRACE Trace,
+    _In_ SYSTEM_INFORMATION_CLASS SystemInformationClass,
+    _Out_writes_bytes_opt_(SystemInformationLength) PVOID SystemInformation,
+    _In_ ULONG SystemInformationLength,
+    _Out_opt_ PULONG ReturnLength
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
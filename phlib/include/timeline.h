@@ -0,0 +1,118 @@
+#ifndef _PH_TIMELINE_H
+#define _PH_TIMELINE_H
+
+// A timeline indexes values by a key and a time, for example process records by process ID and
+// create time. The values of each key are kept in an array sorted by time, so finding the newest
+// value of a key that is not later than a given time is a hashtable lookup followed by a binary
+// search, regardless of how many values other keys have.
+//
+// If the values of a key represent intervals that do not overlap, such as the lifetimes of the
+// processes that used a process ID, the newest value that starts at or before a time is the only
+// one whose interval can contain that time.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _PH_TIMELINE_ENTRY
+{
+    LONG64 Time;
+    PVOID Value;
+} PH_TIMELINE_ENTRY, *PPH_TIMELINE_ENTRY;
+
+typedef struct _PH_TIMELINE
+{
+    PPH_HASHTABLE Hashtable;
+    ULONG Count;
+} PH_TIMELINE, *PPH_TIMELINE;
+
+PHLIBAPI
+VOID
+NTAPI
+PhInitializeTimeline(
+    _Out_ PPH_TIMELINE Timeline
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhDeleteTimeline(
+    _Inout_ PPH_TIMELINE Timeline
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhAddTimelineEntry(
+    _Inout_ PPH_TIMELINE Timeline,
+    _In_ ULONG_PTR Key,
+    _In_ LONG64 Time,
+    _In_opt_ PVOID Value
+    );
+
+PHLIBAPI
+BOOLEAN
+NTAPI
+PhRemoveTimelineEntry(
+    _Inout_ PPH_TIMELINE Timeline,
+    _In_ ULONG_PTR Key,
+    _In_ LONG64 Time,
+    _In_opt_ PVOID Value
+    );
+
+PHLIBAPI
+PPH_TIMELINE_ENTRY
+NTAPI
+PhFindTimelineEntry(
+    _In_ PPH_TIMELINE Timeline,
+    _In_ ULONG_PTR Key,
+    _In_ LONG64 Time
+    );
+
+// A retention queue keeps entries in order of time, so the entries that have expired are at the
+// head of the queue. Entries that cannot be released yet are skipped, and do not hold back the
+// expired entries behind them.
+
+typedef struct _PH_RETENTION_ENTRY
+{
+    LIST_ENTRY ListEntry;
+    LONG64 Time;
+} PH_RETENTION_ENTRY, *PPH_RETENTION_ENTRY;
+
+/**
+ * A callback function passed to PhPurgeRetentionQueue() for each expired entry.
+ *
+ * \param Entry The expired entry.
+ * \param Context A user-defined value passed to PhPurgeRetentionQueue().
+ *
+ * \return TRUE to remove the entry from the queue, FALSE to keep it.
+ */
+typedef BOOLEAN (NTAPI *PPH_RETENTION_CALLBACK)(
+    _In_ PPH_RETENTION_ENTRY Entry,
+    _In_opt_ PVOID Context
+    );
+
+PHLIBAPI
+VOID
+NTAPI
+PhInsertRetentionEntry(
+    _Inout_ PLIST_ENTRY ListHead,
+    _Out_ PPH_RETENTION_ENTRY Entry,
+    _In_ LONG64 Time
+    );
+
+PHLIBAPI
+ULONG
+NTAPI
+PhPurgeRetentionQueue(
+    _Inout_ PLIST_ENTRY ListHead,
+    _In_ LONG64 Threshold,
+    _In_ PPH_RETENTION_CALLBACK Callback,
+    _In_opt_ PVOID Context
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
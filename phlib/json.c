@@ -246,3 +246,1172 @@ VOID PhSaveJsonObjectToFile(
 {
     json_object_to_file(FileName, Object);
 }
+
+// Streaming reader
+
+#define PH_JSON_SCOPE_OBJECT 0x1
+#define PH_JSON_SCOPE_HAS_ELEMENT 0x2
+
+#define PhpIsJsonDigit(Character) ((Character) >= '0' && (Character) <= '9')
+
+static BOOLEAN PhpSetJsonReaderError(
+    _Inout_ PPH_JSON_READER Reader,
+    _In_ NTSTATUS Status
+    )
+{
+    Reader->Status = Status;
+    Reader->Value.Type = PH_JSON_TOKEN_NONE;
+
+    return FALSE;
+}
+
+FORCEINLINE VOID PhpSkipJsonWhitespace(
+    _Inout_ PPH_JSON_READER Reader
+    )
+{
+    while (Reader->Current != Reader->End)
+    {
+        CHAR c = *Reader->Current;
+
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t')
+            break;
+
+        Reader->Current++;
+    }
+}
+
+static BOOLEAN PhpParseJsonHex4(
+    _In_reads_(4) PCH Buffer,
+    _Out_ PULONG Value
+    )
+{
+    ULONG value = 0;
+    ULONG i;
+
+    for (i = 0; i < 4; i++)
+    {
+        CHAR c = Buffer[i];
+
+        value <<= 4;
+
+        if (c >= '0' && c <= '9')
+            value |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value |= c - 'A' + 10;
+        else
+            return FALSE;
+    }
+
+    *Value = value;
+
+    return TRUE;
+}
+
+static BOOLEAN PhpReadJsonString(
+    _Inout_ PPH_JSON_READER Reader,
+    _Out_ PPH_BYTESREF Text,
+    _Out_ PBOOLEAN Escaped
+    )
+{
+    PCH current = Reader->Current + 1; // skip the opening quote
+    PCH end = Reader->End;
+    BOOLEAN escaped = FALSE;
+    ULONG codePoint;
+
+    Text->Buffer = current;
+
+    while (current != end)
+    {
+        UCHAR c = *current;
+
+        if (c == '"')
+        {
+            Text->Length = current - Text->Buffer;
+            *Escaped = escaped;
+            Reader->Current = current + 1;
+            return TRUE;
+        }
+        else if (c == '\\')
+        {
+            escaped = TRUE;
+
+            if (end - current < 2)
+                break;
+
+            switch (current[1])
+            {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                current += 2;
+                break;
+            case 'u':
+                if (end - current < 6 || !PhpParseJsonHex4(current + 2, &codePoint))
+                    return FALSE;
+                current += 6;
+                break;
+            default:
+                return FALSE;
+            }
+        }
+        else if (c < 0x20)
+        {
+            return FALSE;
+        }
+        else
+        {
+            current++;
+        }
+    }
+
+    return FALSE;
+}
+
+static BOOLEAN PhpReadJsonNumber(
+    _Inout_ PPH_JSON_READER Reader
+    )
+{
+    PCH current = Reader->Current;
+    PCH end = Reader->End;
+    PCH digits;
+
+    if (current != end && *current == '-')
+        current++;
+    if (current == end)
+        return FALSE;
+
+    if (*current == '0')
+    {
+        current++;
+    }
+    else if (*current >= '1' && *current <= '9')
+    {
+        while (current != end && PhpIsJsonDigit(*current))
+            current++;
+    }
+    else
+    {
+        return FALSE;
+    }
+
+    if (current != end && *current == '.')
+    {
+        digits = ++current;
+
+        while (current != end && PhpIsJsonDigit(*current))
+            current++;
+
+        if (current == digits)
+            return FALSE;
+    }
+
+    if (current != end && (*current == 'e' || *current == 'E'))
+    {
+        current++;
+
+        if (current != end && (*current == '+' || *current == '-'))
+            current++;
+
+        digits = current;
+
+        while (current != end && PhpIsJsonDigit(*current))
+            current++;
+
+        if (current == digits)
+            return FALSE;
+    }
+
+    Reader->Value.Text.Buffer = Reader->Current;
+    Reader->Value.Text.Length = current - Reader->Current;
+    Reader->Current = current;
+
+    return TRUE;
+}
+
+static BOOLEAN PhpReadJsonLiteral(
+    _Inout_ PPH_JSON_READER Reader,
+    _In_ PSTR Literal,
+    _In_ SIZE_T Length
+    )
+{
+    if ((SIZE_T)(Reader->End - Reader->Current) < Length || memcmp(Reader->Current, Literal, Length) != 0)
+        return FALSE;
+
+    Reader->Value.Text.Buffer = Reader->Current;
+    Reader->Value.Text.Length = Length;
+    Reader->Current += Length;
+
+    return TRUE;
+}
+
+/**
+ * Initializes a JSON reader.
+ *
+ * \param Reader A JSON reader structure.
+ * \param Buffer The UTF-8 document. The buffer must remain valid while the reader and the values
+ * it returns are in use.
+ * \param Length The length of the document, in bytes.
+ */
+VOID PhInitializeJsonReader(
+    _Out_ PPH_JSON_READER Reader,
+    _In_reads_bytes_(Length) PVOID Buffer,
+    _In_ SIZE_T Length
+    )
+{
+    Reader->Current = Buffer;
+    Reader->End = Reader->Current + Length;
+    Reader->Status = STATUS_SUCCESS;
+
+    // Skip the byte order mark.
+    if (Length >= 3 && memcmp(Reader->Current, "\xef\xbb\xbf", 3) == 0)
+        Reader->Current += 3;
+
+    memset(&Reader->Value, 0, sizeof(PH_JSON_VALUE));
+    Reader->Depth = 0;
+    Reader->Index = 0;
+    Reader->Key.Length = 0;
+    Reader->Key.Buffer = NULL;
+
+    Reader->ScopeCount = 1;
+    Reader->Scopes[0] = 0;
+    Reader->Counts[0] = 0;
+}
+
+/**
+ * Reads the next token from a JSON document.
+ *
+ * \param Reader A JSON reader structure.
+ *
+ * \return TRUE if a token was read, otherwise FALSE. If the end of the document was reached,
+ * the status of the reader is STATUS_SUCCESS; otherwise the document is malformed.
+ */
+BOOLEAN PhReadJsonToken(
+    _Inout_ PPH_JSON_READER Reader
+    )
+{
+    PUCHAR scope;
+    CHAR c;
+
+    if (!NT_SUCCESS(Reader->Status))
+        return FALSE;
+
+    PhpSkipJsonWhitespace(Reader);
+
+    scope = &Reader->Scopes[Reader->ScopeCount - 1];
+    Reader->Key.Length = 0;
+    Reader->Key.Buffer = NULL;
+
+    if (Reader->ScopeCount == 1)
+    {
+        // There is exactly one top-level value.
+        if (*scope & PH_JSON_SCOPE_HAS_ELEMENT)
+        {
+            Reader->Value.Type = PH_JSON_TOKEN_NONE;
+
+            if (Reader->Current != Reader->End)
+                return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+
+            return FALSE;
+        }
+
+        Reader->Index = 0;
+    }
+    else
+    {
+        if (Reader->Current == Reader->End)
+            return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+
+        c = *Reader->Current;
+
+        if (c == ((*scope & PH_JSON_SCOPE_OBJECT) ? '}' : ']'))
+        {
+            Reader->Value.Type = (*scope & PH_JSON_SCOPE_OBJECT) ? PH_JSON_TOKEN_END_OBJECT : PH_JSON_TOKEN_END_ARRAY;
+            Reader->Value.Escaped = FALSE;
+            Reader->Value.Text.Buffer = Reader->Current;
+            Reader->Value.Text.Length = 1;
+            Reader->Current++;
+            Reader->ScopeCount--;
+            Reader->Depth = Reader->ScopeCount - 1;
+
+            return TRUE;
+        }
+
+        if (*scope & PH_JSON_SCOPE_HAS_ELEMENT)
+        {
+            if (c != ',')
+                return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+
+            Reader->Current++;
+            PhpSkipJsonWhitespace(Reader);
+        }
+
+        if (*scope & PH_JSON_SCOPE_OBJECT)
+        {
+            BOOLEAN escaped;
+
+            if (Reader->Current == Reader->End || *Reader->Current != '"')
+                return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+            if (!PhpReadJsonString(Reader, &Reader->Key, &escaped))
+                return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+
+            PhpSkipJsonWhitespace(Reader);
+
+            if (Reader->Current == Reader->End || *Reader->Current != ':')
+                return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+
+            Reader->Current++;
+            PhpSkipJsonWhitespace(Reader);
+        }
+
+        Reader->Index = Reader->Counts[Reader->ScopeCount - 1]++;
+    }
+
+    *scope |= PH_JSON_SCOPE_HAS_ELEMENT;
+    Reader->Depth = Reader->ScopeCount - 1;
+    Reader->Value.Escaped = FALSE;
+
+    if (Reader->Current == Reader->End)
+        return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+
+    switch (c = *Reader->Current)
+    {
+    case '{':
+    case '[':
+        if (Reader->ScopeCount == PH_JSON_MAXIMUM_DEPTH)
+            return PhpSetJsonReaderError(Reader, STATUS_NOT_SUPPORTED);
+
+        Reader->Value.Type = c == '{' ? PH_JSON_TOKEN_BEGIN_OBJECT : PH_JSON_TOKEN_BEGIN_ARRAY;
+        Reader->Value.Text.Buffer = Reader->Current;
+        Reader->Value.Text.Length = 1;
+        Reader->Current++;
+
+        Reader->Scopes[Reader->ScopeCount] = c == '{' ? PH_JSON_SCOPE_OBJECT : 0;
+        Reader->Counts[Reader->ScopeCount] = 0;
+        Reader->ScopeCount++;
+        break;
+    case '"':
+        Reader->Value.Type = PH_JSON_TOKEN_STRING;
+
+        if (!PhpReadJsonString(Reader, &Reader->Value.Text, &Reader->Value.Escaped))
+            return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+        break;
+    case 't':
+        Reader->Value.Type = PH_JSON_TOKEN_BOOLEAN;
+
+        if (!PhpReadJsonLiteral(Reader, "true", 4))
+            return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+        break;
+    case 'f':
+        Reader->Value.Type = PH_JSON_TOKEN_BOOLEAN;
+
+        if (!PhpReadJsonLiteral(Reader, "false", 5))
+            return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+        break;
+    case 'n':
+        Reader->Value.Type = PH_JSON_TOKEN_NULL;
+
+        if (!PhpReadJsonLiteral(Reader, "null", 4))
+            return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+        break;
+    default:
+        Reader->Value.Type = PH_JSON_TOKEN_NUMBER;
+
+        if (!PhpReadJsonNumber(Reader))
+            return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+        break;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Skips the contents of an object or array.
+ *
+ * \param Reader A JSON reader structure. If the current token begins an object or array, the
+ * reader is moved to the token that ends it. Otherwise, the reader is not changed.
+ *
+ * \remarks The skipped contents are not validated.
+ */
+BOOLEAN PhSkipJsonValue(
+    _Inout_ PPH_JSON_READER Reader
+    )
+{
+    PCH current;
+    PCH end;
+    ULONG depth;
+
+    if (Reader->Value.Type != PH_JSON_TOKEN_BEGIN_OBJECT && Reader->Value.Type != PH_JSON_TOKEN_BEGIN_ARRAY)
+        return NT_SUCCESS(Reader->Status);
+
+    current = Reader->Current;
+    end = Reader->End;
+    depth = 1;
+
+    while (current != end)
+    {
+        CHAR c = *current++;
+
+        switch (c)
+        {
+        case '"':
+            while (current != end)
+            {
+                c = *current++;
+
+                if (c == '"')
+                    break;
+                if (c == '\\' && current != end)
+                    current++;
+            }
+            break;
+        case '{':
+        case '[':
+            depth++;
+            break;
+        case '}':
+        case ']':
+            if (--depth == 0)
+            {
+                UCHAR scope = Reader->Scopes[Reader->ScopeCount - 1];
+
+                if (c != ((scope & PH_JSON_SCOPE_OBJECT) ? '}' : ']'))
+                    return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+
+                Reader->Value.Type = (scope & PH_JSON_SCOPE_OBJECT) ? PH_JSON_TOKEN_END_OBJECT : PH_JSON_TOKEN_END_ARRAY;
+                Reader->Value.Text.Buffer = current - 1;
+                Reader->Value.Text.Length = 1;
+                Reader->Current = current;
+                Reader->ScopeCount--;
+                Reader->Depth = Reader->ScopeCount - 1;
+
+                return TRUE;
+            }
+            break;
+        }
+    }
+
+    return PhpSetJsonReaderError(Reader, STATUS_FILE_CORRUPT_ERROR);
+}
+
+BOOLEAN PhEqualJsonKey(
+    _In_ PPH_JSON_READER Reader,
+    _In_ PSTR Key
+    )
+{
+    SIZE_T length = strlen(Key);
+
+    return Reader->Key.Buffer && Reader->Key.Length == length && memcmp(Reader->Key.Buffer, Key, length) == 0;
+}
+
+static PPH_STRING PhpUnescapeJsonString(
+    _In_ PPH_BYTESREF Text
+    )
+{
+    PPH_STRING string;
+    PCH buffer;
+    PCH output;
+    PCH current;
+    PCH end;
+
+    // The unescaped string is never longer than the escaped string.
+    buffer = PhAllocate(Text->Length);
+    output = buffer;
+    current = Text->Buffer;
+    end = current + Text->Length;
+
+    while (current != end)
+    {
+        if (*current != '\\')
+        {
+            *output++ = *current++;
+            continue;
+        }
+
+        if (++current == end)
+            break;
+
+        switch (*current++)
+        {
+        case 'b':
+            *output++ = '\b';
+            break;
+        case 'f':
+            *output++ = '\f';
+            break;
+        case 'n':
+            *output++ = '\n';
+            break;
+        case 'r':
+            *output++ = '\r';
+            break;
+        case 't':
+            *output++ = '\t';
+            break;
+        case 'u':
+            {
+                ULONG codePoint;
+                ULONG lowSurrogate;
+                ULONG numberOfCodeUnits;
+
+                if (end - current < 4 || !PhpParseJsonHex4(current, &codePoint))
+                    goto Done;
+
+                current += 4;
+
+                if (codePoint >= 0xd800 && codePoint <= 0xdbff && end - current >= 6 && current[0] == '\\' && current[1] == 'u' &&
+                    PhpParseJsonHex4(current + 2, &lowSurrogate) && lowSurrogate >= 0xdc00 && lowSurrogate <= 0xdfff)
+                {
+                    codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (lowSurrogate - 0xdc00);
+                    current += 6;
+                }
+                else if (codePoint >= 0xd800 && codePoint <= 0xdfff)
+                {
+                    codePoint = 0xfffd;
+                }
+
+                if (PhEncodeUnicode(PH_UNICODE_UTF8, codePoint, output, &numberOfCodeUnits))
+                    output += numberOfCodeUnits;
+            }
+            break;
+        default:
+            *output++ = current[-1];
+            break;
+        }
+    }
+
+Done:
+    string = PhConvertUtf8ToUtf16Ex(buffer, output - buffer);
+    PhFree(buffer);
+
+    return string;
+}
+
+/**
+ * Converts a JSON value to a string.
+ *
+ * \param Value A value returned by a JSON reader or query.
+ *
+ * \return The unescaped contents of a string, the text of any other value, or NULL if the value
+ * is null or was not found.
+ */
+PPH_STRING PhJsonValueToString(
+    _In_ PPH_JSON_VALUE Value
+    )
+{
+    switch (Value->Type)
+    {
+    case PH_JSON_TOKEN_NONE:
+    case PH_JSON_TOKEN_NULL:
+        return NULL;
+    case PH_JSON_TOKEN_STRING:
+        if (Value->Escaped)
+            return PhpUnescapeJsonString(&Value->Text);
+        break;
+    }
+
+    return PhConvertUtf8ToUtf16Ex(Value->Text.Buffer, Value->Text.Length);
+}
+
+LONG64 PhJsonValueToInteger64(
+    _In_ PPH_JSON_VALUE Value
+    )
+{
+    PCH current;
+    PCH end;
+    BOOLEAN negative = FALSE;
+    ULONG64 value = 0;
+
+    switch (Value->Type)
+    {
+    case PH_JSON_TOKEN_BOOLEAN:
+        return Value->Text.Buffer[0] == 't';
+    case PH_JSON_TOKEN_NUMBER:
+    case PH_JSON_TOKEN_STRING:
+        break;
+    default:
+        return 0;
+    }
+
+    current = Value->Text.Buffer;
+    end = current + Value->Text.Length;
+
+    if (Value->Type == PH_JSON_TOKEN_NUMBER && Value->Text.Length < 64 &&
+        (memchr(current, '.', Value->Text.Length) || memchr(current, 'e', Value->Text.Length) || memchr(current, 'E', Value->Text.Length)))
+    {
+        CHAR buffer[64];
+        DOUBLE number;
+
+        memcpy(buffer, current, Value->Text.Length);
+        buffer[Value->Text.Length] = ANSI_NULL;
+        number = strtod(buffer, NULL);
+
+        if (number >= 9223372036854775807.0)
+            return MAXLONG64;
+        if (number <= -9223372036854775808.0)
+            return MINLONG64;
+
+        return (LONG64)number;
+    }
+
+    if (current != end && *current == '-')
+    {
+        negative = TRUE;
+        current++;
+    }
+
+    while (current != end && PhpIsJsonDigit(*current))
+    {
+        if (value > (MAXULONG64 - 9) / 10)
+            return negative ? MINLONG64 : MAXLONG64;
+
+        value = value * 10 + (*current++ - '0');
+    }
+
+    if (negative)
+        return value > (ULONG64)MAXLONG64 ? MINLONG64 : -(LONG64)value;
+    else
+        return value > (ULONG64)MAXLONG64 ? MAXLONG64 : (LONG64)value;
+}
+
+BOOLEAN PhJsonValueToBoolean(
+    _In_ PPH_JSON_VALUE Value
+    )
+{
+    switch (Value->Type)
+    {
+    case PH_JSON_TOKEN_BOOLEAN:
+        return Value->Text.Buffer[0] == 't';
+    case PH_JSON_TOKEN_NUMBER:
+        return PhJsonValueToInteger64(Value) != 0;
+    case PH_JSON_TOKEN_STRING:
+        return Value->Text.Length != 0;
+    }
+
+    return FALSE;
+}
+
+// Compares the next segment of a query path with the name or index of a value. The return value
+// is the rest of the path, or NULL if the segment doesn't match.
+static PSTR PhpMatchJsonPathSegment(
+    _In_ PSTR Path,
+    _In_ PPH_BYTESREF Key,
+    _In_ ULONG Index
+    )
+{
+    PSTR end;
+
+    for (end = Path; *end && *end != '.'; end++)
+        NOTHING;
+
+    if (Key->Buffer)
+    {
+        if ((SIZE_T)(end - Path) != Key->Length || memcmp(Path, Key->Buffer, Key->Length) != 0)
+            return NULL;
+    }
+    else
+    {
+        ULONG64 index = 0;
+        PSTR current;
+
+        if (end == Path)
+            return NULL;
+
+        for (current = Path; current != end; current++)
+        {
+            if (!PhpIsJsonDigit(*current))
+                return NULL;
+
+            index = index * 10 + (*current - '0');
+
+            if (index > MAXULONG)
+                return NULL;
+        }
+
+        if (index != Index)
+            return NULL;
+    }
+
+    return *end ? end + 1 : end;
+}
+
+static PSTR PhpMatchJsonPath(
+    _In_ PSTR Path,
+    _In_ PPH_BYTESREF Keys,
+    _In_ PULONG Indexes,
+    _In_ ULONG Depth
+    )
+{
+    ULONG i;
+
+    // The top-level value has no name, so the first segment names a value at depth 1.
+    for (i = 1; i <= Depth; i++)
+    {
+        if (!*Path)
+            return NULL;
+        if (!(Path = PhpMatchJsonPathSegment(Path, &Keys[i], Indexes[i])))
+            return NULL;
+    }
+
+    return Path;
+}
+
+static ULONG PhpGetJsonPathDepth(
+    _In_ PSTR Path
+    )
+{
+    ULONG depth;
+
+    if (!*Path)
+        return 0;
+
+    for (depth = 1; *Path; Path++)
+    {
+        if (*Path == '.')
+            depth++;
+    }
+
+    return depth;
+}
+
+// Called when an object or array ends. Completes the queries that selected it.
+static ULONG PhpCompleteJsonQueries(
+    _Inout_updates_(NumberOfQueries) PPH_JSON_QUERY Queries,
+    _In_ ULONG NumberOfQueries,
+    _In_ PPH_JSON_READER Reader
+    )
+{
+    ULONG completed = 0;
+    ULONG i;
+
+    for (i = 0; i < NumberOfQueries; i++)
+    {
+        PPH_JSON_VALUE value = &Queries[i].Value;
+
+        if ((value->Type == PH_JSON_TOKEN_BEGIN_OBJECT || value->Type == PH_JSON_TOKEN_BEGIN_ARRAY) &&
+            value->Text.Length == 0 && PhpGetJsonPathDepth(Queries[i].Path) == Reader->Depth)
+        {
+            value->Text.Length = Reader->Value.Text.Buffer + 1 - value->Text.Buffer;
+            completed++;
+        }
+    }
+
+    return completed;
+}
+
+/**
+ * Finds values in a JSON document without building a tree.
+ *
+ * \param Buffer The UTF-8 document.
+ * \param Length The length of the document, in bytes.
+ * \param Queries An array of queries. The value of each query is set to the first value that
+ * matches its path. Objects and arrays that cannot contain a match are skipped, and parsing stops
+ * once every query has been completed.
+ * \param NumberOfQueries The number of queries.
+ */
+NTSTATUS PhQueryJson(
+    _In_reads_bytes_(Length) PVOID Buffer,
+    _In_ SIZE_T Length,
+    _Inout_updates_(NumberOfQueries) PPH_JSON_QUERY Queries,
+    _In_ ULONG NumberOfQueries
+    )
+{
+    PH_JSON_READER reader;
+    PH_BYTESREF keys[PH_JSON_MAXIMUM_DEPTH];
+    ULONG indexes[PH_JSON_MAXIMUM_DEPTH];
+    ULONG remaining;
+    ULONG i;
+
+    for (i = 0; i < NumberOfQueries; i++)
+        memset(&Queries[i].Value, 0, sizeof(PH_JSON_VALUE));
+
+    remaining = NumberOfQueries;
+    PhInitializeJsonReader(&reader, Buffer, Length);
+
+    while (remaining != 0 && PhReadJsonToken(&reader))
+    {
+        BOOLEAN container;
+        BOOLEAN descend;
+
+        if (reader.Value.Type == PH_JSON_TOKEN_END_OBJECT || reader.Value.Type == PH_JSON_TOKEN_END_ARRAY)
+        {
+            remaining -= PhpCompleteJsonQueries(Queries, NumberOfQueries, &reader);
+            continue;
+        }
+
+        container = reader.Value.Type == PH_JSON_TOKEN_BEGIN_OBJECT || reader.Value.Type == PH_JSON_TOKEN_BEGIN_ARRAY;
+        descend = FALSE;
+        keys[reader.Depth] = reader.Key;
+        indexes[reader.Depth] = reader.Index;
+
+        for (i = 0; i < NumberOfQueries; i++)
+        {
+            PPH_JSON_QUERY query = &Queries[i];
+            PSTR rest;
+
+            if (query->Value.Type != PH_JSON_TOKEN_NONE)
+                continue;
+            if (!(rest = PhpMatchJsonPath(query->Path, keys, indexes, reader.Depth)))
+                continue;
+
+            if (!*rest)
+            {
+                query->Value = reader.Value;
+
+                // Objects and arrays are completed when they end.
+                if (container)
+                    query->Value.Text.Length = 0;
+                else
+                    remaining--;
+            }
+            else if (container)
+            {
+                descend = TRUE;
+            }
+        }
+
+        if (container && !descend)
+        {
+            if (!PhSkipJsonValue(&reader))
+                break;
+
+            remaining -= PhpCompleteJsonQueries(Queries, NumberOfQueries, &reader);
+        }
+    }
+
+    return reader.Status;
+}
+
+// Streaming writer
+
+static VOID PhpAppendJson(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_reads_bytes_(Length) PCH Buffer,
+    _In_ SIZE_T Length
+    )
+{
+    PhAppendBytesBuilderEx(&Writer->BytesBuilder, Buffer, Length, 0, NULL);
+}
+
+static ULONG PhpEscapeJsonCharacter(
+    _Out_writes_(6) PCH Buffer,
+    _In_ UCHAR Character
+    )
+{
+    static CHAR hexDigits[] = "0123456789abcdef";
+
+    Buffer[0] = '\\';
+
+    switch (Character)
+    {
+    case '"':
+    case '\\':
+        Buffer[1] = Character;
+        return 2;
+    case '\b':
+        Buffer[1] = 'b';
+        return 2;
+    case '\f':
+        Buffer[1] = 'f';
+        return 2;
+    case '\n':
+        Buffer[1] = 'n';
+        return 2;
+    case '\r':
+        Buffer[1] = 'r';
+        return 2;
+    case '\t':
+        Buffer[1] = 't';
+        return 2;
+    }
+
+    Buffer[1] = 'u';
+    Buffer[2] = '0';
+    Buffer[3] = '0';
+    Buffer[4] = hexDigits[Character >> 4];
+    Buffer[5] = hexDigits[Character & 0xf];
+
+    return 6;
+}
+
+static VOID PhpWriteJsonUtf8String(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_reads_bytes_(Length) PCH Buffer,
+    _In_ SIZE_T Length
+    )
+{
+    PCH start = Buffer;
+    PCH current = Buffer;
+    PCH end = Buffer + Length;
+
+    PhpAppendJson(Writer, "\"", 1);
+
+    while (current != end)
+    {
+        UCHAR c = *current;
+        CHAR escape[6];
+
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            current++;
+            continue;
+        }
+
+        if (current != start)
+            PhpAppendJson(Writer, start, current - start);
+
+        PhpAppendJson(Writer, escape, PhpEscapeJsonCharacter(escape, c));
+        start = ++current;
+    }
+
+    if (current != start)
+        PhpAppendJson(Writer, start, current - start);
+
+    PhpAppendJson(Writer, "\"", 1);
+}
+
+static VOID PhpWriteJsonUtf16String(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_ PPH_STRINGREF Value
+    )
+{
+    CHAR buffer[0x100];
+    SIZE_T length = 0;
+    PWCH current = Value->Buffer;
+    PWCH end = Value->Buffer + Value->Length / sizeof(WCHAR);
+
+    PhpAppendJson(Writer, "\"", 1);
+
+    while (current != end)
+    {
+        ULONG codePoint = *current++;
+
+        // Each code point takes at most 6 bytes.
+        if (length > sizeof(buffer) - 6)
+        {
+            PhpAppendJson(Writer, buffer, length);
+            length = 0;
+        }
+
+        if (codePoint < 0x80)
+        {
+            if (codePoint >= 0x20 && codePoint != '"' && codePoint != '\\')
+                buffer[length++] = (CHAR)codePoint;
+            else
+                length += PhpEscapeJsonCharacter(&buffer[length], (UCHAR)codePoint);
+        }
+        else
+        {
+            ULONG numberOfCodeUnits;
+
+            if (codePoint >= 0xd800 && codePoint <= 0xdbff && current != end && *current >= 0xdc00 && *current <= 0xdfff)
+                codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (*current++ - 0xdc00);
+            else if (codePoint >= 0xd800 && codePoint <= 0xdfff)
+                codePoint = 0xfffd;
+
+            if (PhEncodeUnicode(PH_UNICODE_UTF8, codePoint, &buffer[length], &numberOfCodeUnits))
+                length += numberOfCodeUnits;
+        }
+    }
+
+    if (length != 0)
+        PhpAppendJson(Writer, buffer, length);
+
+    PhpAppendJson(Writer, "\"", 1);
+}
+
+static VOID PhpWriteJsonPrefix(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key
+    )
+{
+    if (Writer->Scopes[Writer->Depth] & PH_JSON_SCOPE_HAS_ELEMENT)
+        PhpAppendJson(Writer, ",", 1);
+
+    Writer->Scopes[Writer->Depth] |= PH_JSON_SCOPE_HAS_ELEMENT;
+
+    if (Key)
+    {
+        PhpWriteJsonUtf8String(Writer, Key, strlen(Key));
+        PhpAppendJson(Writer, ":", 1);
+    }
+}
+
+static VOID PhpWriteJsonBegin(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key,
+    _In_ CHAR Bracket
+    )
+{
+    assert(Writer->Depth + 1 < PH_JSON_MAXIMUM_DEPTH);
+
+    PhpWriteJsonPrefix(Writer, Key);
+    PhpAppendJson(Writer, &Bracket, 1);
+
+    Writer->Depth++;
+    Writer->Scopes[Writer->Depth] = 0;
+}
+
+static VOID PhpWriteJsonEnd(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_ CHAR Bracket
+    )
+{
+    assert(Writer->Depth != 0);
+
+    Writer->Depth--;
+    PhpAppendJson(Writer, &Bracket, 1);
+}
+
+/**
+ * Initializes a JSON writer.
+ *
+ * \param Writer A JSON writer structure.
+ * \param InitialCapacity The number of bytes to allocate initially.
+ */
+VOID PhInitializeJsonWriter(
+    _Out_ PPH_JSON_WRITER Writer,
+    _In_ SIZE_T InitialCapacity
+    )
+{
+    PhInitializeBytesBuilder(&Writer->BytesBuilder, InitialCapacity);
+    Writer->Depth = 0;
+    Writer->Scopes[0] = 0;
+}
+
+VOID PhDeleteJsonWriter(
+    _Inout_ PPH_JSON_WRITER Writer
+    )
+{
+    PhDeleteBytesBuilder(&Writer->BytesBuilder);
+}
+
+/**
+ * Discards the document written by a JSON writer so that the writer can be reused.
+ *
+ * \param Writer A JSON writer structure.
+ */
+VOID PhResetJsonWriter(
+    _Inout_ PPH_JSON_WRITER Writer
+    )
+{
+    Writer->BytesBuilder.Bytes->Length = 0;
+    Writer->BytesBuilder.Bytes->Buffer[0] = ANSI_NULL;
+    Writer->Depth = 0;
+    Writer->Scopes[0] = 0;
+}
+
+/**
+ * Obtains the document written by a JSON writer.
+ *
+ * \param Writer A JSON writer structure.
+ *
+ * \remarks The writer must not be used after this function is called.
+ */
+PPH_BYTES PhFinalJsonWriterBytes(
+    _Inout_ PPH_JSON_WRITER Writer
+    )
+{
+    return PhFinalBytesBuilderBytes(&Writer->BytesBuilder);
+}
+
+VOID PhWriteJsonBeginObject(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key
+    )
+{
+    PhpWriteJsonBegin(Writer, Key, '{');
+}
+
+VOID PhWriteJsonEndObject(
+    _Inout_ PPH_JSON_WRITER Writer
+    )
+{
+    PhpWriteJsonEnd(Writer, '}');
+}
+
+VOID PhWriteJsonBeginArray(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key
+    )
+{
+    PhpWriteJsonBegin(Writer, Key, '[');
+}
+
+VOID PhWriteJsonEndArray(
+    _Inout_ PPH_JSON_WRITER Writer
+    )
+{
+    PhpWriteJsonEnd(Writer, ']');
+}
+
+VOID PhWriteJsonString(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key,
+    _In_ PPH_STRINGREF Value
+    )
+{
+    PhpWriteJsonPrefix(Writer, Key);
+    PhpWriteJsonUtf16String(Writer, Value);
+}
+
+VOID PhWriteJsonStringZ(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key,
+    _In_ PSTR Value
+    )
+{
+    PhpWriteJsonPrefix(Writer, Key);
+    PhpWriteJsonUtf8String(Writer, Value, strlen(Value));
+}
+
+VOID PhWriteJsonInteger64(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key,
+    _In_ LONG64 Value
+    )
+{
+    CHAR buffer[24];
+    PCH start = buffer + sizeof(buffer);
+    ULONG64 magnitude = Value < 0 ? 0 - (ULONG64)Value : (ULONG64)Value;
+
+    do
+    {
+        *--start = '0' + (CHAR)(magnitude % 10);
+    } while (magnitude /= 10);
+
+    if (Value < 0)
+        *--start = '-';
+
+    PhpWriteJsonPrefix(Writer, Key);
+    PhpAppendJson(Writer, start, buffer + sizeof(buffer) - start);
+}
+
+VOID PhWriteJsonBoolean(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key,
+    _In_ BOOLEAN Value
+    )
+{
+    PhpWriteJsonPrefix(Writer, Key);
+
+    if (Value)
+        PhpAppendJson(Writer, "true", 4);
+    else
+        PhpAppendJson(Writer, "false", 5);
+}
+
+VOID PhWriteJsonNull(
+    _Inout_ PPH_JSON_WRITER Writer,
+    _In_opt_ PSTR Key
+    )
+{
+    PhpWriteJsonPrefix(Writer, Key);
+    PhpAppendJson(Writer, "null", 4);
+}
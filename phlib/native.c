@@ -26,6 +26,7 @@
 #include <kphuser.h>
 #include <lsasup.h>
 #include <mapimg.h>
+#include <systrace.h>
 
 #include <sddl.h>
 
@@ -751,6 +752,36 @@ NTSTATUS PhGetProcessDeviceMap(
     return status;
 }
 
+/**
+ * Gets the offset of a string in a process' parameters structure.
+ *
+ * \param Offset The string.
+ *
+ * \return The offset of the string, or ULONG_MAX if \a Offset is invalid.
+ */
+ULONG PhpGetProcessParametersStringOffset(
+    _In_ PH_PEB_OFFSET Offset
+    )
+{
+#define PEB_OFFSET_CASE(Enum, Field) \
+    case Enum: return FIELD_OFFSET(RTL_USER_PROCESS_PARAMETERS, Field); \
+    case Enum | PhpoWow64: return FIELD_OFFSET(RTL_USER_PROCESS_PARAMETERS32, Field)
+
+    switch (Offset)
+    {
+        PEB_OFFSET_CASE(PhpoCurrentDirectory, CurrentDirectory);
+        PEB_OFFSET_CASE(PhpoDllPath, DllPath);
+        PEB_OFFSET_CASE(PhpoImagePathName, ImagePathName);
+        PEB_OFFSET_CASE(PhpoCommandLine, CommandLine);
+        PEB_OFFSET_CASE(PhpoWindowTitle, WindowTitle);
+        PEB_OFFSET_CASE(PhpoDesktopInfo, DesktopInfo);
+        PEB_OFFSET_CASE(PhpoShellInfo, ShellInfo);
+        PEB_OFFSET_CASE(PhpoRuntimeData, RuntimeData);
+    default:
+        return ULONG_MAX;
+    }
+}
+
 /**
  * Gets a string stored in a process' parameters structure.
  *
@@ -772,23 +803,10 @@ NTSTATUS PhGetProcessPebString(
     PPH_STRING string;
     ULONG offset;
 
-#define PEB_OFFSET_CASE(Enum, Field) \
-    case Enum: offset = FIELD_OFFSET(RTL_USER_PROCESS_PARAMETERS, Field); break; \
-    case Enum | PhpoWow64: offset = FIELD_OFFSET(RTL_USER_PROCESS_PARAMETERS32, Field); break
+    offset = PhpGetProcessParametersStringOffset(Offset);
 
-    switch (Offset)
-    {
-        PEB_OFFSET_CASE(PhpoCurrentDirectory, CurrentDirectory);
-        PEB_OFFSET_CASE(PhpoDllPath, DllPath);
-        PEB_OFFSET_CASE(PhpoImagePathName, ImagePathName);
-        PEB_OFFSET_CASE(PhpoCommandLine, CommandLine);
-        PEB_OFFSET_CASE(PhpoWindowTitle, WindowTitle);
-        PEB_OFFSET_CASE(PhpoDesktopInfo, DesktopInfo);
-        PEB_OFFSET_CASE(PhpoShellInfo, ShellInfo);
-        PEB_OFFSET_CASE(PhpoRuntimeData, RuntimeData);
-    default:
+    if (offset == ULONG_MAX)
         return STATUS_INVALID_PARAMETER_2;
-    }
 
     if (!(Offset & PhpoWow64))
     {
@@ -895,6 +913,301 @@ NTSTATUS PhGetProcessPebString(
     return status;
 }
 
+// The contents of the strings are read with a single call if they are at most this far apart.
+#define PH_PEB_STRINGS_MAXIMUM_SPAN (256 * 1024)
+
+static BOOLEAN PhpValidatePebOffsets(
+    _In_ ULONG Count,
+    _In_reads_(Count) PPH_PEB_OFFSET Offsets
+    )
+{
+    BOOLEAN isWow64;
+    ULONG i;
+
+    isWow64 = !!(Offsets[0] & PhpoWow64);
+
+    for (i = 0; i < Count; i++)
+    {
+        if (!!(Offsets[i] & PhpoWow64) != isWow64 || PhpGetProcessParametersStringOffset(Offsets[i]) == ULONG_MAX)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static NTSTATUS NTAPI PhpReadVirtualMemoryCallback(
+    _In_ HANDLE ProcessHandle,
+    _In_ PVOID BaseAddress,
+    _Out_writes_bytes_(BufferSize) PVOID Buffer,
+    _In_ SIZE_T BufferSize,
+    _In_opt_ PVOID Context
+    )
+{
+    return NtReadVirtualMemory(ProcessHandle, BaseAddress, Buffer, BufferSize, NULL);
+}
+
+/**
+ * Gets several strings stored in a process' parameters structure.
+ *
+ * \param ProcessHandle A handle to a process. The handle must have
+ * PROCESS_QUERY_LIMITED_INFORMATION and PROCESS_VM_READ access.
+ * \param Count The number of strings to retrieve.
+ * \param Offsets The strings to retrieve. Either all or none of the values must include
+ * PhpoWow64.
+ * \param Strings An array which receives pointers to the requested strings. You must free the
+ * strings using PhDereferenceObject() when you no longer need them.
+ *
+ * \remarks The parameters structure is read once, and the strings are copied out of a single
+ * read of the memory that contains them, since they are normally stored right after the
+ * structure. Use this function instead of calling PhGetProcessPebString() for each string.
+ *
+ * \retval STATUS_INVALID_PARAMETER_3 An invalid value was specified in the Offsets parameter.
+ */
+NTSTATUS PhGetProcessPebStrings(
+    _In_ HANDLE ProcessHandle,
+    _In_ ULONG Count,
+    _In_reads_(Count) PPH_PEB_OFFSET Offsets,
+    _Out_writes_(Count) PPH_STRING *Strings
+    )
+{
+    NTSTATUS status;
+    PVOID pebBaseAddress;
+
+    if (Count == 0)
+        return STATUS_SUCCESS;
+    if (!PhpValidatePebOffsets(Count, Offsets))
+        return STATUS_INVALID_PARAMETER_3;
+
+    if (!(Offsets[0] & PhpoWow64))
+    {
+        PROCESS_BASIC_INFORMATION basicInfo;
+
+        // Get the PEB address.
+        if (!NT_SUCCESS(status = PhGetProcessBasicInformation(ProcessHandle, &basicInfo)))
+            return status;
+
+        pebBaseAddress = basicInfo.PebBaseAddress;
+    }
+    else
+    {
+        if (!NT_SUCCESS(status = PhGetProcessPeb32(ProcessHandle, &pebBaseAddress)))
+            return status;
+    }
+
+    return PhGetProcessPebStringsEx(
+        ProcessHandle,
+        pebBaseAddress,
+        Count,
+        Offsets,
+        Strings,
+        PhpReadVirtualMemoryCallback,
+        NULL
+        );
+}
+
+/**
+ * Gets several strings stored in a process' parameters structure, using a callback function to
+ * read the process' memory.
+ *
+ * \param ProcessHandle A handle to a process. This value is only passed to \a ReadMemory.
+ * \param PebBaseAddress The address of the process' PEB, or of its PEB32 if the values in
+ * \a Offsets include PhpoWow64.
+ * \param Count The number of strings to retrieve.
+ * \param Offsets The strings to retrieve. Either all or none of the values must include
+ * PhpoWow64.
+ * \param Strings An array which receives pointers to the requested strings. You must free the
+ * strings using PhDereferenceObject() when you no longer need them.
+ * \param ReadMemory A callback function which reads the process' memory, or NULL to use
+ * NtReadVirtualMemory().
+ * \param Context A user-defined value to pass to the callback function.
+ *
+ * \remarks Everything read from the process is untrusted. Strings with an odd length are
+ * truncated to a whole number of characters.
+ *
+ * \retval STATUS_INVALID_PARAMETER_4 An invalid value was specified in the Offsets parameter.
+ */
+NTSTATUS PhGetProcessPebStringsEx(
+    _In_ HANDLE ProcessHandle,
+    _In_ PVOID PebBaseAddress,
+    _In_ ULONG Count,
+    _In_reads_(Count) PPH_PEB_OFFSET Offsets,
+    _Out_writes_(Count) PPH_STRING *Strings,
+    _In_opt_ PPH_READ_VIRTUAL_MEMORY_CALLBACK ReadMemory,
+    _In_opt_ PVOID Context
+    )
+{
+    NTSTATUS status;
+    PUNICODE_STRING unicodeStrings;
+    ULONG_PTR lowAddress;
+    ULONG_PTR highAddress;
+    PVOID buffer = NULL;
+    ULONG i;
+
+    if (Count == 0)
+        return STATUS_SUCCESS;
+    if (!PhpValidatePebOffsets(Count, Offsets))
+        return STATUS_INVALID_PARAMETER_4;
+
+    if (!ReadMemory)
+        ReadMemory = PhpReadVirtualMemoryCallback;
+
+    unicodeStrings = PhAllocate(sizeof(UNICODE_STRING) * Count);
+
+    // Read the parameters structure up to the last string that can be requested.
+
+    if (!(Offsets[0] & PhpoWow64))
+    {
+        PVOID processParameters;
+        RTL_USER_PROCESS_PARAMETERS parameters;
+
+        // Read the address of the process parameters.
+        if (!NT_SUCCESS(status = ReadMemory(
+            ProcessHandle,
+            PTR_ADD_OFFSET(PebBaseAddress, FIELD_OFFSET(PEB, ProcessParameters)),
+            &processParameters,
+            sizeof(PVOID),
+            Context
+            )))
+            goto CleanupExit;
+
+        if (!NT_SUCCESS(status = ReadMemory(
+            ProcessHandle,
+            processParameters,
+            &parameters,
+            FIELD_OFFSET(RTL_USER_PROCESS_PARAMETERS, CurrentDirectories),
+            Context
+            )))
+            goto CleanupExit;
+
+        for (i = 0; i < Count; i++)
+        {
+            unicodeStrings[i] = *(PUNICODE_STRING)PTR_ADD_OFFSET(&parameters, PhpGetProcessParametersStringOffset(Offsets[i]));
+            unicodeStrings[i].Length &= ~1;
+        }
+    }
+    else
+    {
+        ULONG processParameters32;
+        RTL_USER_PROCESS_PARAMETERS32 parameters32;
+
+        if (!NT_SUCCESS(status = ReadMemory(
+            ProcessHandle,
+            PTR_ADD_OFFSET(PebBaseAddress, FIELD_OFFSET(PEB32, ProcessParameters)),
+            &processParameters32,
+            sizeof(ULONG),
+            Context
+            )))
+            goto CleanupExit;
+
+        if (!NT_SUCCESS(status = ReadMemory(
+            ProcessHandle,
+            UlongToPtr(processParameters32),
+            &parameters32,
+            FIELD_OFFSET(RTL_USER_PROCESS_PARAMETERS32, CurrentDirectories),
+            Context
+            )))
+            goto CleanupExit;
+
+        for (i = 0; i < Count; i++)
+        {
+            PUNICODE_STRING32 unicodeString32;
+
+            unicodeString32 = PTR_ADD_OFFSET(&parameters32, PhpGetProcessParametersStringOffset(Offsets[i]));
+            unicodeStrings[i].Length = unicodeString32->Length & ~1;
+            unicodeStrings[i].MaximumLength = unicodeString32->MaximumLength;
+            unicodeStrings[i].Buffer = UlongToPtr(unicodeString32->Buffer);
+        }
+    }
+
+    // Read the contents of all strings at once if they are close together. The lengths and
+    // addresses come from the other process, so check them for overflow.
+
+    lowAddress = MAXULONG_PTR;
+    highAddress = 0;
+
+    for (i = 0; i < Count; i++)
+    {
+        ULONG_PTR address = (ULONG_PTR)unicodeStrings[i].Buffer;
+
+        if (unicodeStrings[i].Length == 0)
+            continue;
+
+        if (address + unicodeStrings[i].Length < address)
+        {
+            lowAddress = MAXULONG_PTR;
+            break;
+        }
+
+        if (lowAddress > address)
+            lowAddress = address;
+        if (highAddress < address + unicodeStrings[i].Length)
+            highAddress = address + unicodeStrings[i].Length;
+    }
+
+    if (lowAddress < highAddress && highAddress - lowAddress <= PH_PEB_STRINGS_MAXIMUM_SPAN)
+    {
+        buffer = PhAllocate(highAddress - lowAddress);
+
+        if (!NT_SUCCESS(ReadMemory(
+            ProcessHandle,
+            (PVOID)lowAddress,
+            buffer,
+            highAddress - lowAddress,
+            Context
+            )))
+        {
+            // There may be a gap between the strings; read them separately.
+            PhFree(buffer);
+            buffer = NULL;
+        }
+    }
+
+    for (i = 0; i < Count; i++)
+    {
+        if (unicodeStrings[i].Length == 0)
+        {
+            Strings[i] = PhReferenceEmptyString();
+        }
+        else if (buffer)
+        {
+            Strings[i] = PhCreateStringEx(
+                PTR_ADD_OFFSET(buffer, (ULONG_PTR)unicodeStrings[i].Buffer - lowAddress),
+                unicodeStrings[i].Length
+                );
+        }
+        else
+        {
+            Strings[i] = PhCreateStringEx(NULL, unicodeStrings[i].Length);
+
+            if (!NT_SUCCESS(status = ReadMemory(
+                ProcessHandle,
+                unicodeStrings[i].Buffer,
+                Strings[i]->Buffer,
+                Strings[i]->Length,
+                Context
+                )))
+            {
+                Count = i + 1;
+
+                for (i = 0; i < Count; i++)
+                    PhDereferenceObject(Strings[i]);
+
+                goto CleanupExit;
+            }
+        }
+    }
+
+    status = STATUS_SUCCESS;
+
+CleanupExit:
+    if (buffer)
+        PhFree(buffer);
+
+    PhFree(unicodeStrings);
+
+    return status;
+}
+
 /**
  * Gets a process' command line.
  *
@@ -4870,6 +5183,46 @@ PPH_STRING PhGetKernelFileName(
     return fileName;
 }
 
+/**
+ * Queries system information.
+ *
+ * \param SystemInformationClass The information class.
+ * \param SystemInformation A buffer which receives the information.
+ * \param SystemInformationLength The length of the buffer.
+ * \param ReturnLength A variable which receives the length of the information.
+ *
+ * \remarks This is the same as NtQuerySystemInformation(), except that the information is recorded
+ * or replayed if a system information trace tick is active on the current thread. See
+ * PhBeginSystemTraceTick().
+ */
+NTSTATUS PhQuerySystemInformation(
+    _In_ SYSTEM_INFORMATION_CLASS SystemInformationClass,
+    _Out_writes_bytes_opt_(SystemInformationLength) PVOID SystemInformation,
+    _In_ ULONG SystemInformationLength,
+    _Out_opt_ PULONG ReturnLength
+    )
+{
+    PPH_SYSTEM_TRACE trace;
+
+    if (trace = PhGetCurrentSystemTrace())
+    {
+        return PhQuerySystemTraceInformation(
+            trace,
+            SystemInformationClass,
+            SystemInformation,
+            SystemInformationLength,
+            ReturnLength
+            );
+    }
+
+    return NtQuerySystemInformation(
+        SystemInformationClass,
+        SystemInformation,
+        SystemInformationLength,
+        ReturnLength
+        );
+}
+
 /**
  * Enumerates the running processes.
  *
@@ -4926,7 +5279,7 @@ NTSTATUS PhEnumProcessesEx(
 
     while (TRUE)
     {
-        status = NtQuerySystemInformation(
+        status = PhQuerySystemInformation(
             SystemInformationClass,
             buffer,
             bufferSize,
@@ -36,6 +36,12 @@
  * even when boosted, always run on the same provider thread. The other option would be to have the
  * boosting thread run the provider function directly, which would involve unnecessary blocking and
  * synchronization.
+ *
+ * Each provider can have its own interval, which is rounded to a multiple of the interval of the
+ * provider thread because providers only run when the timer is signaled. The interval of a
+ * provider can be increased automatically while its data doesn't change, or while the provider
+ * thread is in the background (e.g. when the main window is hidden). The time taken by each run is
+ * measured and can be retrieved with PhGetStatisticsProvider().
  */
 
 #include <ph.h>
@@ -65,6 +71,8 @@ VOID PhInitializeProviderThread(
     PhInitializeQueuedLock(&ProviderThread->Lock);
     InitializeListHead(&ProviderThread->ListHead);
     ProviderThread->BoostCount = 0;
+    ProviderThread->Background = FALSE;
+    ProviderThread->CurrentRegistration = NULL;
 
 #ifdef DEBUG
     PhAcquireQueuedLockExclusive(&PhDbgProviderListLock);
@@ -97,6 +105,66 @@ VOID PhDeleteProviderThread(
 #endif
 }
 
+/**
+ * Determines whether a provider should be run on a periodic run.
+ *
+ * \param ProviderThread A pointer to a provider thread object.
+ * \param Registration A pointer to the registration object for a provider.
+ * \param TickCount The current tick count.
+ */
+FORCEINLINE BOOLEAN PhpIsProviderDue(
+    _In_ PPH_PROVIDER_THREAD ProviderThread,
+    _In_ PPH_PROVIDER_REGISTRATION Registration,
+    _In_ ULONG64 TickCount
+    )
+{
+    // The timer is never signaled exactly on time, so a provider is due if its next run is less than
+    // half an interval away.
+    return TickCount + ProviderThread->Interval / 2 >= Registration->DueTime;
+}
+
+/**
+ * Updates the statistics of a provider after a run and calculates the time of its next run.
+ *
+ * \param ProviderThread A pointer to a provider thread object.
+ * \param Registration A pointer to the registration object for a provider.
+ * \param Boosted TRUE if the provider was boosted, otherwise FALSE.
+ * \param StartTime The tick count at the start of the run.
+ * \param RunTime The time taken by the run, in 100ns units.
+ */
+VOID PhpScheduleProvider(
+    _In_ PPH_PROVIDER_THREAD ProviderThread,
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration,
+    _In_ BOOLEAN Boosted,
+    _In_ ULONG64 StartTime,
+    _In_ ULONG64 RunTime
+    )
+{
+    PPH_PROVIDER_STATISTICS statistics = &Registration->Statistics;
+    ULONG64 interval;
+
+    statistics->NumberOfRuns++;
+    statistics->LastRunTime = RunTime;
+    statistics->TotalRunTime += RunTime;
+
+    if (statistics->MaximumRunTime < RunTime)
+        statistics->MaximumRunTime = RunTime;
+
+    // Someone who boosts a provider wants up-to-date data, so boosting always resets the backoff.
+    if (Boosted || Registration->Changed || !(Registration->Flags & PH_PROVIDER_BACKOFF_UNCHANGED))
+        statistics->Backoff = 1;
+    else if (statistics->Backoff < PH_PROVIDER_MAXIMUM_BACKOFF)
+        statistics->Backoff *= 2;
+
+    interval = Registration->Interval ? Registration->Interval : ProviderThread->Interval;
+    interval *= statistics->Backoff;
+
+    if (ProviderThread->Background && (Registration->Flags & PH_PROVIDER_BACKOFF_BACKGROUND))
+        interval *= PH_PROVIDER_BACKGROUND_BACKOFF;
+
+    Registration->DueTime = StartTime + interval;
+}
+
 NTSTATUS NTAPI PhpProviderThreadStart(
     _In_ PVOID Parameter
     )
@@ -109,6 +177,11 @@ NTSTATUS NTAPI PhpProviderThreadStart(
     PPH_PROVIDER_FUNCTION providerFunction;
     PVOID object;
     LIST_ENTRY tempListHead;
+    ULONG64 tickCount;
+    ULONG64 startTime;
+    LARGE_INTEGER startCounter;
+    LARGE_INTEGER endCounter;
+    LARGE_INTEGER frequency;
 
     PhInitializeAutoPool(&autoPool);
 
@@ -126,6 +199,8 @@ NTSTATUS NTAPI PhpProviderThreadStart(
 
         PhAcquireQueuedLockExclusive(&providerThread->Lock);
 
+        tickCount = NtGetTickCount64();
+
         // Main loop.
 
         // We check the status variable for STATUS_ALERTED, which means that someone is requesting
@@ -158,6 +233,12 @@ NTSTATUS NTAPI PhpProviderThreadStart(
             {
                 if (!registration->Enabled || registration->Unregistering)
                     continue;
+
+                if (!PhpIsProviderDue(providerThread, registration, tickCount))
+                {
+                    registration->Statistics.NumberOfSkippedRuns++;
+                    continue;
+                }
             }
             else
             {
@@ -188,14 +269,33 @@ NTSTATUS NTAPI PhpProviderThreadStart(
                 PhReferenceObject(object);
 
             registration->RunId++;
+            registration->Changed = FALSE;
+            providerThread->CurrentRegistration = registration;
 
             PhReleaseQueuedLockExclusive(&providerThread->Lock);
+            startTime = NtGetTickCount64();
+            NtQueryPerformanceCounter(&startCounter, &frequency);
             providerFunction(object);
+            NtQueryPerformanceCounter(&endCounter, NULL);
             PhDrainAutoPool(&autoPool);
             PhAcquireQueuedLockExclusive(&providerThread->Lock);
 
             if (object)
                 PhDereferenceObject(object);
+
+            // The registration object may have been freed if the provider was unregistered while it
+            // was running.
+            if (providerThread->CurrentRegistration == registration)
+            {
+                PhpScheduleProvider(
+                    providerThread,
+                    registration,
+                    status == STATUS_ALERTED,
+                    startTime,
+                    (ULONG64)(endCounter.QuadPart - startCounter.QuadPart) * PH_TICKS_PER_SEC / frequency.QuadPart
+                    );
+                providerThread->CurrentRegistration = NULL;
+            }
         }
 
         // Re-add the items in the temp list to the main list.
@@ -281,14 +381,32 @@ VOID PhStopProviderThread(
  *
  * \param ProviderThread A pointer to a provider thread object.
  * \param Interval The interval between each run, in milliseconds.
+ *
+ * \remarks The schedules of the providers are reset, so that every provider runs on the next
+ * periodic run and then follows the new interval.
  */
 VOID PhSetIntervalProviderThread(
     _Inout_ PPH_PROVIDER_THREAD ProviderThread,
     _In_ ULONG Interval
     )
 {
+    PLIST_ENTRY listEntry;
+
+    PhAcquireQueuedLockExclusive(&ProviderThread->Lock);
+
     ProviderThread->Interval = Interval;
 
+    // The due times and backoffs were computed with the old interval.
+    for (listEntry = ProviderThread->ListHead.Flink; listEntry != &ProviderThread->ListHead; listEntry = listEntry->Flink)
+    {
+        PPH_PROVIDER_REGISTRATION registration = CONTAINING_RECORD(listEntry, PH_PROVIDER_REGISTRATION, ListEntry);
+
+        registration->DueTime = 0;
+        registration->Statistics.Backoff = 1;
+    }
+
+    PhReleaseQueuedLockExclusive(&ProviderThread->Lock);
+
     if (ProviderThread->TimerHandle)
     {
         LARGE_INTEGER interval;
@@ -298,6 +416,45 @@ VOID PhSetIntervalProviderThread(
     }
 }
 
+/**
+ * Sets whether a provider thread is in the background.
+ *
+ * \param ProviderThread A pointer to a provider thread object.
+ * \param Background TRUE if the data of the providers is not visible, otherwise FALSE.
+ *
+ * \remarks Providers registered with PH_PROVIDER_BACKOFF_BACKGROUND run less often while the
+ * provider thread is in the background.
+ */
+VOID PhSetBackgroundProviderThread(
+    _Inout_ PPH_PROVIDER_THREAD ProviderThread,
+    _In_ BOOLEAN Background
+    )
+{
+    PLIST_ENTRY listEntry;
+
+    PhAcquireQueuedLockExclusive(&ProviderThread->Lock);
+
+    if (ProviderThread->Background != Background)
+    {
+        ProviderThread->Background = Background;
+
+        // Run the providers that were backed off on the next periodic run. The providers that are
+        // running now are rescheduled when they finish.
+        if (!Background)
+        {
+            for (listEntry = ProviderThread->ListHead.Flink; listEntry != &ProviderThread->ListHead; listEntry = listEntry->Flink)
+            {
+                PPH_PROVIDER_REGISTRATION registration = CONTAINING_RECORD(listEntry, PH_PROVIDER_REGISTRATION, ListEntry);
+
+                if (registration->Flags & PH_PROVIDER_BACKOFF_BACKGROUND)
+                    registration->DueTime = 0;
+            }
+        }
+    }
+
+    PhReleaseQueuedLockExclusive(&ProviderThread->Lock);
+}
+
 /**
  * Registers a provider with a provider thread.
  *
@@ -323,6 +480,12 @@ VOID PhRegisterProvider(
     Registration->Enabled = FALSE;
     Registration->Unregistering = FALSE;
     Registration->Boosting = FALSE;
+    Registration->Changed = FALSE;
+    Registration->Interval = 0;
+    Registration->Flags = 0;
+    Registration->DueTime = 0;
+    memset(&Registration->Statistics, 0, sizeof(PH_PROVIDER_STATISTICS));
+    Registration->Statistics.Backoff = 1;
 
     if (Object)
         PhReferenceObject(Object);
@@ -362,6 +525,10 @@ VOID PhUnregisterProvider(
     if (Registration->Boosting)
         providerThread->BoostCount--;
 
+    // Tell the provider thread not to touch the registration object if the provider is running.
+    if (providerThread->CurrentRegistration == Registration)
+        providerThread->CurrentRegistration = NULL;
+
     // The user-supplied object must be dereferenced
     // while the mutex is held.
     if (Registration->Object)
@@ -463,3 +630,63 @@ VOID PhSetEnabledProvider(
 {
     Registration->Enabled = Enabled;
 }
+
+/**
+ * Sets the schedule of a provider.
+ *
+ * \param Registration A pointer to the registration object for a provider.
+ * \param Interval The minimum interval between periodic runs, in milliseconds, or 0 to run the
+ * provider every time the provider thread runs.
+ * \param Flags A combination of flags.
+ * \li \c PH_PROVIDER_BACKOFF_UNCHANGED The provider runs less often while its data doesn't change.
+ * The provider function must call PhSetChangedProvider() when its data changes.
+ * \li \c PH_PROVIDER_BACKOFF_BACKGROUND The provider runs less often while the provider thread is
+ * in the background.
+ */
+VOID PhSetScheduleProvider(
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration,
+    _In_ ULONG Interval,
+    _In_ ULONG Flags
+    )
+{
+    PPH_PROVIDER_THREAD providerThread = Registration->ProviderThread;
+
+    PhAcquireQueuedLockExclusive(&providerThread->Lock);
+    Registration->Interval = Interval;
+    Registration->Flags = Flags;
+    Registration->DueTime = 0;
+    Registration->Statistics.Backoff = 1;
+    PhReleaseQueuedLockExclusive(&providerThread->Lock);
+}
+
+/**
+ * Indicates that the data of a provider has changed during the current run.
+ *
+ * \param Registration A pointer to the registration object for a provider.
+ *
+ * \remarks This function must be called on the provider thread, while the provider is running.
+ */
+VOID PhSetChangedProvider(
+    _Inout_ PPH_PROVIDER_REGISTRATION Registration
+    )
+{
+    Registration->Changed = TRUE;
+}
+
+/**
+ * Gets the run statistics of a provider.
+ *
+ * \param Registration A pointer to the registration object for a provider.
+ * \param Statistics A variable which receives the statistics.
+ */
+VOID PhGetStatisticsProvider(
+    _In_ PPH_PROVIDER_REGISTRATION Registration,
+    _Out_ PPH_PROVIDER_STATISTICS Statistics
+    )
+{
+    PPH_PROVIDER_THREAD providerThread = Registration->ProviderThread;
+
+    PhAcquireQueuedLockExclusive(&providerThread->Lock);
+    *Statistics = Registration->Statistics;
+    PhReleaseQueuedLockExclusive(&providerThread->Lock);
+}
@@ -0,0 +1,895 @@
+/*
+ * Process Hacker -
+ *   search queries
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Queries are parsed into a tree, the operands of each and/or node are sorted by their cost, and
+ * the tree is then flattened into a list of instructions that operate on a single boolean result.
+ * An and/or node with n operands becomes the code for each operand followed by a conditional
+ * jump to the end of the node, except for the last operand. This gives the same short-circuit
+ * evaluation as the tree without any recursion or allocation when a query is evaluated.
+ *
+ * The query text is converted to upper case when the query is compiled, and string values in
+ * instructions point into this copy.
+ */
+
+#include <phbase.h>
+#include <phquery.h>
+
+#define PH_QUERY_MAXIMUM_DEPTH 64
+
+typedef enum _PH_QUERY_OPCODE
+{
+    QueryOpFalse,
+    QueryOpNumber,
+    QueryOpString,
+    QueryOpText,
+    QueryOpNot,
+    QueryOpJumpIfFalse,
+    QueryOpJumpIfTrue
+} PH_QUERY_OPCODE;
+
+typedef enum _PH_QUERY_OPERATOR
+{
+    QueryContains,
+    QueryEqual,
+    QueryNotEqual,
+    QueryMatch,
+    QueryLess,
+    QueryLessEqual,
+    QueryGreater,
+    QueryGreaterEqual
+} PH_QUERY_OPERATOR;
+
+typedef struct _PH_QUERY_INSTRUCTION
+{
+    UCHAR Opcode;
+    UCHAR Operator;
+    /** The field ID, or the target of a jump. */
+    ULONG Argument;
+    union
+    {
+        DOUBLE Number;
+        PH_STRINGREF String;
+    };
+} PH_QUERY_INSTRUCTION, *PPH_QUERY_INSTRUCTION;
+
+typedef struct _PH_QUERY
+{
+    PPH_QUERY_GET_NUMBER GetNumber;
+    PPH_QUERY_GET_STRING GetString;
+    PPH_QUERY_MATCH_TEXT MatchText;
+    PPH_STRING Text;
+    ULONG NumberOfInstructions;
+    PPH_QUERY_INSTRUCTION Instructions;
+} PH_QUERY, *PPH_QUERY;
+
+// Parser
+
+typedef enum _PH_QUERY_TOKEN_TYPE
+{
+    QueryTokenEnd,
+    QueryTokenWord,
+    QueryTokenQuoted,
+    QueryTokenOperator,
+    QueryTokenLeftParen,
+    QueryTokenRightParen,
+    QueryTokenOr
+} PH_QUERY_TOKEN_TYPE;
+
+typedef enum _PH_QUERY_NODE_TYPE
+{
+    QueryNodePredicate,
+    QueryNodeNot,
+    QueryNodeAnd,
+    QueryNodeOr
+} PH_QUERY_NODE_TYPE;
+
+typedef struct _PH_QUERY_NODE
+{
+    PH_QUERY_NODE_TYPE Type;
+    ULONG Cost;
+    PPH_LIST Children;
+    PH_QUERY_INSTRUCTION Predicate;
+} PH_QUERY_NODE, *PPH_QUERY_NODE;
+
+typedef struct _PH_QUERY_PARSER
+{
+    PPH_QUERY_SCHEMA Schema;
+    PH_STRINGREF Remaining;
+    PH_QUERY_TOKEN_TYPE TokenType;
+    PH_STRINGREF TokenText;
+    PH_QUERY_OPERATOR TokenOperator;
+    ULONG Depth;
+    ULONG NumberOfFieldPredicates;
+    PPH_LIST Nodes;
+} PH_QUERY_PARSER, *PPH_QUERY_PARSER;
+
+static PPH_QUERY_NODE PhpParseQueryOr(
+    _Inout_ PPH_QUERY_PARSER Parser
+    );
+
+static BOOLEAN PhpIsQueryWhitespace(
+    _In_ WCHAR Character
+    )
+{
+    return Character == L' ' || Character == L'\t' || Character == L'\r' || Character == L'\n';
+}
+
+static BOOLEAN PhpIsQuerySeparator(
+    _In_ WCHAR Character
+    )
+{
+    switch (Character)
+    {
+    case L'(':
+    case L')':
+    case L'|':
+    case L'"':
+    case L':':
+    case L'~':
+    case L'=':
+    case L'!':
+    case L'<':
+    case L'>':
+        return TRUE;
+    default:
+        return PhpIsQueryWhitespace(Character);
+    }
+}
+
+/**
+ * Reads the next token.
+ *
+ * \param Parser The parser.
+ * \param Value TRUE if the token is the value of a predicate. Unquoted values end at whitespace or
+ * a closing parenthesis, so they can contain operator characters (e.g. path:C:\Windows).
+ */
+static BOOLEAN PhpReadQueryToken(
+    _Inout_ PPH_QUERY_PARSER Parser,
+    _In_ BOOLEAN Value
+    )
+{
+    PWCHAR buffer;
+    SIZE_T length;
+    SIZE_T i;
+
+    while (Parser->Remaining.Length != 0 && PhpIsQueryWhitespace(Parser->Remaining.Buffer[0]))
+        PhSkipStringRef(&Parser->Remaining, sizeof(WCHAR));
+
+    buffer = Parser->Remaining.Buffer;
+    length = Parser->Remaining.Length / sizeof(WCHAR);
+    Parser->TokenText.Buffer = buffer;
+    Parser->TokenText.Length = 0;
+
+    if (length == 0)
+    {
+        Parser->TokenType = QueryTokenEnd;
+        return TRUE;
+    }
+
+    if (buffer[0] == L'"')
+    {
+        for (i = 1; i < length; i++)
+        {
+            if (buffer[i] == L'"')
+                break;
+        }
+
+        if (i == length)
+            return FALSE;
+
+        Parser->TokenType = QueryTokenQuoted;
+        Parser->TokenText.Buffer = buffer + 1;
+        Parser->TokenText.Length = (i - 1) * sizeof(WCHAR);
+        PhSkipStringRef(&Parser->Remaining, (i + 1) * sizeof(WCHAR));
+        return TRUE;
+    }
+
+    if (Value)
+    {
+        for (i = 0; i < length; i++)
+        {
+            if (PhpIsQueryWhitespace(buffer[i]) || buffer[i] == L')')
+                break;
+        }
+
+        if (i == 0)
+            return FALSE;
+
+        Parser->TokenType = QueryTokenWord;
+        Parser->TokenText.Length = i * sizeof(WCHAR);
+        PhSkipStringRef(&Parser->Remaining, i * sizeof(WCHAR));
+        return TRUE;
+    }
+
+    i = 1;
+
+    switch (buffer[0])
+    {
+    case L'(':
+        Parser->TokenType = QueryTokenLeftParen;
+        break;
+    case L')':
+        Parser->TokenType = QueryTokenRightParen;
+        break;
+    case L'|':
+        Parser->TokenType = QueryTokenOr;
+        break;
+    case L':':
+        Parser->TokenType = QueryTokenOperator;
+        Parser->TokenOperator = QueryContains;
+        break;
+    case L'~':
+        Parser->TokenType = QueryTokenOperator;
+        Parser->TokenOperator = QueryMatch;
+        break;
+    case L'=':
+        Parser->TokenType = QueryTokenOperator;
+        Parser->TokenOperator = QueryEqual;
+        break;
+    case L'!':
+        if (length < 2 || buffer[1] != L'=')
+            return FALSE;
+
+        Parser->TokenType = QueryTokenOperator;
+        Parser->TokenOperator = QueryNotEqual;
+        i = 2;
+        break;
+    case L'<':
+    case L'>':
+        Parser->TokenType = QueryTokenOperator;
+
+        if (length >= 2 && buffer[1] == L'=')
+        {
+            Parser->TokenOperator = buffer[0] == L'<' ? QueryLessEqual : QueryGreaterEqual;
+            i = 2;
+        }
+        else
+        {
+            Parser->TokenOperator = buffer[0] == L'<' ? QueryLess : QueryGreater;
+        }
+        break;
+    default:
+        for (i = 0; i < length; i++)
+        {
+            if (PhpIsQuerySeparator(buffer[i]))
+                break;
+        }
+
+        Parser->TokenType = QueryTokenWord;
+        break;
+    }
+
+    Parser->TokenText.Length = i * sizeof(WCHAR);
+    PhSkipStringRef(&Parser->Remaining, i * sizeof(WCHAR));
+
+    return TRUE;
+}
+
+static BOOLEAN PhpIsQueryKeyword(
+    _In_ PPH_QUERY_PARSER Parser,
+    _In_ PWSTR Keyword
+    )
+{
+    // The text is already in upper case.
+    return Parser->TokenType == QueryTokenWord && PhEqualStringRef2(&Parser->TokenText, Keyword, FALSE);
+}
+
+static PPH_QUERY_NODE PhpCreateQueryNode(
+    _Inout_ PPH_QUERY_PARSER Parser,
+    _In_ PH_QUERY_NODE_TYPE Type
+    )
+{
+    PPH_QUERY_NODE node;
+
+    node = PhAllocate(sizeof(PH_QUERY_NODE));
+    memset(node, 0, sizeof(PH_QUERY_NODE));
+    node->Type = Type;
+
+    if (Type != QueryNodePredicate)
+        node->Children = PhCreateList(2);
+
+    PhAddItemList(Parser->Nodes, node);
+
+    return node;
+}
+
+static BOOLEAN PhpParseQueryNumber(
+    _In_ PPH_STRINGREF Text,
+    _Out_ DOUBLE *Number
+    )
+{
+    PH_STRINGREF text;
+    DOUBLE multiplier = 1;
+    WCHAR suffix;
+
+    text = *Text;
+
+    if (text.Length >= 2 * sizeof(WCHAR) && text.Buffer[text.Length / sizeof(WCHAR) - 1] == L'B')
+    {
+        suffix = text.Buffer[text.Length / sizeof(WCHAR) - 2];
+
+        if (suffix == L'K' || suffix == L'M' || suffix == L'G')
+            text.Length -= sizeof(WCHAR);
+    }
+
+    if (text.Length != 0)
+    {
+        switch (text.Buffer[text.Length / sizeof(WCHAR) - 1])
+        {
+        case L'K':
+            multiplier = 1024;
+            break;
+        case L'M':
+            multiplier = 1024 * 1024;
+            break;
+        case L'G':
+            multiplier = 1024 * 1024 * 1024;
+            break;
+        }
+
+        if (multiplier != 1)
+            text.Length -= sizeof(WCHAR);
+    }
+
+    if (text.Length == 0 || !PhStringToDouble(&text, 0, Number))
+        return FALSE;
+
+    *Number *= multiplier;
+
+    return TRUE;
+}
+
+static PPH_QUERY_NODE PhpParseQueryPredicate(
+    _Inout_ PPH_QUERY_PARSER Parser
+    )
+{
+    PPH_QUERY_NODE node;
+    PH_STRINGREF name;
+    PH_QUERY_OPERATOR queryOperator;
+    PPH_QUERY_FIELD field = NULL;
+    ULONG i;
+
+    node = PhpCreateQueryNode(Parser, QueryNodePredicate);
+    name = Parser->TokenText;
+
+    if (Parser->TokenType == QueryTokenQuoted)
+    {
+        node->Predicate.Opcode = QueryOpText;
+        node->Predicate.String = name;
+        node->Cost = 3;
+
+        return PhpReadQueryToken(Parser, FALSE) ? node : NULL;
+    }
+
+    if (!PhpReadQueryToken(Parser, FALSE))
+        return NULL;
+
+    if (Parser->TokenType != QueryTokenOperator)
+    {
+        node->Predicate.Opcode = QueryOpText;
+        node->Predicate.String = name;
+        node->Cost = 3;
+
+        return node;
+    }
+
+    queryOperator = Parser->TokenOperator;
+
+    if (!PhpReadQueryToken(Parser, TRUE))
+        return NULL;
+    if (Parser->TokenType != QueryTokenWord && Parser->TokenType != QueryTokenQuoted)
+        return NULL;
+
+    for (i = 0; i < Parser->Schema->NumberOfFields; i++)
+    {
+        if (PhEqualStringRef(&Parser->Schema->Fields[i].Name, &name, TRUE))
+        {
+            field = &Parser->Schema->Fields[i];
+            break;
+        }
+    }
+
+    if (!field)
+    {
+        // Fields that don't exist in this schema never match, so that one query can be used with
+        // several schemas.
+        node->Predicate.Opcode = QueryOpFalse;
+    }
+    else if (field->Type == PH_QUERY_FIELD_NUMBER)
+    {
+        if (queryOperator == QueryMatch)
+            return NULL;
+        if (queryOperator == QueryContains)
+            queryOperator = QueryEqual;
+        if (!PhpParseQueryNumber(&Parser->TokenText, &node->Predicate.Number))
+            return NULL;
+
+        node->Predicate.Opcode = QueryOpNumber;
+        node->Cost = 0;
+    }
+    else
+    {
+        if (queryOperator >= QueryLess)
+            return NULL;
+
+        node->Predicate.Opcode = QueryOpString;
+        node->Predicate.String = Parser->TokenText;
+        node->Cost = queryOperator == QueryMatch ? 2 : 1;
+    }
+
+    if (field)
+    {
+        node->Predicate.Operator = (UCHAR)queryOperator;
+        node->Predicate.Argument = field->Id;
+        Parser->NumberOfFieldPredicates++;
+    }
+
+    return PhpReadQueryToken(Parser, FALSE) ? node : NULL;
+}
+
+static PPH_QUERY_NODE PhpParseQueryUnary(
+    _Inout_ PPH_QUERY_PARSER Parser
+    )
+{
+    PPH_QUERY_NODE node;
+    PPH_QUERY_NODE child;
+
+    if (Parser->Depth >= PH_QUERY_MAXIMUM_DEPTH)
+        return NULL;
+
+    if (PhpIsQueryKeyword(Parser, L"NOT"))
+    {
+        if (!PhpReadQueryToken(Parser, FALSE))
+            return NULL;
+
+        Parser->Depth++;
+        child = PhpParseQueryUnary(Parser);
+        Parser->Depth--;
+
+        if (!child)
+            return NULL;
+
+        node = PhpCreateQueryNode(Parser, QueryNodeNot);
+        PhAddItemList(node->Children, child);
+        node->Cost = child->Cost;
+
+        return node;
+    }
+
+    if (Parser->TokenType == QueryTokenLeftParen)
+    {
+        if (!PhpReadQueryToken(Parser, FALSE))
+            return NULL;
+
+        Parser->Depth++;
+        node = PhpParseQueryOr(Parser);
+        Parser->Depth--;
+
+        if (!node || Parser->TokenType != QueryTokenRightParen)
+            return NULL;
+        if (!PhpReadQueryToken(Parser, FALSE))
+            return NULL;
+
+        return node;
+    }
+
+    if (PhpIsQueryKeyword(Parser, L"AND") || PhpIsQueryKeyword(Parser, L"OR"))
+        return NULL;
+
+    if (Parser->TokenType == QueryTokenWord || Parser->TokenType == QueryTokenQuoted)
+        return PhpParseQueryPredicate(Parser);
+
+    return NULL;
+}
+
+static VOID PhpSortQueryNodeChildren(
+    _Inout_ PPH_QUERY_NODE Node
+    )
+{
+    PPH_LIST children = Node->Children;
+    ULONG i;
+    ULONG j;
+
+    // Insertion sort by cost. The sort is stable, so operands of the same cost keep their order.
+    for (i = 1; i < children->Count; i++)
+    {
+        PPH_QUERY_NODE child = children->Items[i];
+
+        for (j = i; j > 0 && ((PPH_QUERY_NODE)children->Items[j - 1])->Cost > child->Cost; j--)
+            children->Items[j] = children->Items[j - 1];
+
+        children->Items[j] = child;
+    }
+
+    Node->Cost = ((PPH_QUERY_NODE)children->Items[children->Count - 1])->Cost;
+}
+
+static PPH_QUERY_NODE PhpParseQueryAnd(
+    _Inout_ PPH_QUERY_PARSER Parser
+    )
+{
+    PPH_QUERY_NODE node;
+    PPH_QUERY_NODE child;
+
+    if (!(child = PhpParseQueryUnary(Parser)))
+        return NULL;
+
+    node = NULL;
+
+    while (TRUE)
+    {
+        if (PhpIsQueryKeyword(Parser, L"AND"))
+        {
+            if (!PhpReadQueryToken(Parser, FALSE))
+                return NULL;
+        }
+        else if (
+            PhpIsQueryKeyword(Parser, L"OR") ||
+            (Parser->TokenType != QueryTokenWord && Parser->TokenType != QueryTokenQuoted && Parser->TokenType != QueryTokenLeftParen)
+            )
+        {
+            break;
+        }
+
+        // Adjacent operands are combined using "and".
+
+        if (!node)
+        {
+            node = PhpCreateQueryNode(Parser, QueryNodeAnd);
+            PhAddItemList(node->Children, child);
+        }
+
+        if (!(child = PhpParseQueryUnary(Parser)))
+            return NULL;
+
+        PhAddItemList(node->Children, child);
+    }
+
+    if (!node)
+        return child;
+
+    PhpSortQueryNodeChildren(node);
+
+    return node;
+}
+
+static PPH_QUERY_NODE PhpParseQueryOr(
+    _Inout_ PPH_QUERY_PARSER Parser
+    )
+{
+    PPH_QUERY_NODE node;
+    PPH_QUERY_NODE child;
+
+    if (!(child = PhpParseQueryAnd(Parser)))
+        return NULL;
+
+    node = NULL;
+
+    while (Parser->TokenType == QueryTokenOr || PhpIsQueryKeyword(Parser, L"OR"))
+    {
+        if (!PhpReadQueryToken(Parser, FALSE))
+            return NULL;
+
+        if (!node)
+        {
+            node = PhpCreateQueryNode(Parser, QueryNodeOr);
+            PhAddItemList(node->Children, child);
+        }
+
+        if (!(child = PhpParseQueryAnd(Parser)))
+            return NULL;
+
+        PhAddItemList(node->Children, child);
+    }
+
+    if (!node)
+        return child;
+
+    PhpSortQueryNodeChildren(node);
+
+    return node;
+}
+
+static VOID PhpEmitQueryInstructions(
+    _Inout_ PPH_ARRAY Instructions,
+    _In_ PPH_QUERY_NODE Node
+    )
+{
+    PH_QUERY_INSTRUCTION instruction;
+    SIZE_T firstJump;
+    ULONG i;
+
+    switch (Node->Type)
+    {
+    case QueryNodePredicate:
+        PhAddItemArray(Instructions, &Node->Predicate);
+        break;
+    case QueryNodeNot:
+        PhpEmitQueryInstructions(Instructions, Node->Children->Items[0]);
+        memset(&instruction, 0, sizeof(PH_QUERY_INSTRUCTION));
+        instruction.Opcode = QueryOpNot;
+        PhAddItemArray(Instructions, &instruction);
+        break;
+    case QueryNodeAnd:
+    case QueryNodeOr:
+        memset(&instruction, 0, sizeof(PH_QUERY_INSTRUCTION));
+        instruction.Opcode = Node->Type == QueryNodeAnd ? QueryOpJumpIfFalse : QueryOpJumpIfTrue;
+        firstJump = Instructions->Count;
+
+        for (i = 0; i < Node->Children->Count; i++)
+        {
+            PhpEmitQueryInstructions(Instructions, Node->Children->Items[i]);
+
+            if (i != Node->Children->Count - 1)
+                PhAddItemArray(Instructions, &instruction);
+        }
+
+        // Point the jumps of this node to the end of the node. Jumps of nested nodes already
+        // have targets inside this node.
+        for (; firstJump < Instructions->Count; firstJump++)
+        {
+            PPH_QUERY_INSTRUCTION jump = PhItemArray(Instructions, firstJump);
+
+            if (jump->Opcode == instruction.Opcode && jump->Argument == 0)
+                jump->Argument = (ULONG)Instructions->Count;
+        }
+        break;
+    }
+}
+
+/**
+ * Compiles a query.
+ *
+ * \param Text The text of the query.
+ * \param Schema The fields that can be used in the query. The callbacks are copied to the query,
+ * but the schema does not need to remain valid after this function returns.
+ * \param Query A variable which receives the query. Free it with PhFreeQuery().
+ * \param NumberOfFieldPredicates A variable which receives the number of predicates on fields
+ * that exist in the schema.
+ *
+ * \return STATUS_INVALID_PARAMETER if the query contains a syntax error or compares a field with
+ * a value of the wrong type.
+ */
+NTSTATUS PhCompileQuery(
+    _In_ PPH_STRINGREF Text,
+    _In_ PPH_QUERY_SCHEMA Schema,
+    _Out_ PPH_QUERY *Query,
+    _Out_opt_ PULONG NumberOfFieldPredicates
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    PH_QUERY_PARSER parser;
+    PPH_QUERY_NODE root = NULL;
+    PPH_QUERY query;
+    PPH_STRING text;
+    PH_ARRAY instructions;
+    SIZE_T i;
+
+    text = PhCreateStringEx(Text->Buffer, Text->Length);
+
+    for (i = 0; i < text->Length / sizeof(WCHAR); i++)
+        text->Buffer[i] = RtlUpcaseUnicodeChar(text->Buffer[i]);
+
+    memset(&parser, 0, sizeof(PH_QUERY_PARSER));
+    parser.Schema = Schema;
+    parser.Remaining = text->sr;
+    parser.Nodes = PhCreateList(8);
+
+    // An empty query matches everything.
+    if (!PhpReadQueryToken(&parser, FALSE))
+        status = STATUS_INVALID_PARAMETER;
+    else if (parser.TokenType != QueryTokenEnd && (!(root = PhpParseQueryOr(&parser)) || parser.TokenType != QueryTokenEnd))
+        status = STATUS_INVALID_PARAMETER;
+
+    if (NT_SUCCESS(status))
+    {
+        PhInitializeArray(&instructions, sizeof(PH_QUERY_INSTRUCTION), 8);
+
+        if (root)
+            PhpEmitQueryInstructions(&instructions, root);
+
+        query = PhAllocate(sizeof(PH_QUERY));
+        query->GetNumber = Schema->GetNumber;
+        query->GetString = Schema->GetString;
+        query->MatchText = Schema->MatchText;
+        query->Text = text;
+        query->NumberOfInstructions = (ULONG)instructions.Count;
+        query->Instructions = PhFinalArrayItems(&instructions);
+
+        *Query = query;
+
+        if (NumberOfFieldPredicates)
+            *NumberOfFieldPredicates = parser.NumberOfFieldPredicates;
+    }
+    else
+    {
+        PhDereferenceObject(text);
+    }
+
+    for (i = 0; i < parser.Nodes->Count; i++)
+    {
+        PPH_QUERY_NODE node = parser.Nodes->Items[i];
+
+        if (node->Children)
+            PhDereferenceObject(node->Children);
+
+        PhFree(node);
+    }
+
+    PhDereferenceObject(parser.Nodes);
+
+    return status;
+}
+
+VOID PhFreeQuery(
+    _In_ _Post_invalid_ PPH_QUERY Query
+    )
+{
+    PhDereferenceObject(Query->Text);
+    PhFree(Query->Instructions);
+    PhFree(Query);
+}
+
+static BOOLEAN PhpMatchQueryWildcards(
+    _In_ PPH_STRINGREF Pattern,
+    _In_ PPH_STRINGREF String
+    )
+{
+    PWCHAR pattern = Pattern->Buffer;
+    PWCHAR patternEnd = PTR_ADD_OFFSET(Pattern->Buffer, Pattern->Length);
+    PWCHAR string = String->Buffer;
+    PWCHAR stringEnd = PTR_ADD_OFFSET(String->Buffer, String->Length);
+    PWCHAR starPattern = NULL;
+    PWCHAR starString = NULL;
+
+    // The pattern is already in upper case.
+    while (string < stringEnd)
+    {
+        if (pattern < patternEnd && *pattern == L'*')
+        {
+            // Remember where the star was, so that it can match more characters if the rest of
+            // the pattern doesn't match.
+            starPattern = ++pattern;
+            starString = string;
+        }
+        else if (pattern < patternEnd && (*pattern == L'?' || *pattern == RtlUpcaseUnicodeChar(*string)))
+        {
+            pattern++;
+            string++;
+        }
+        else if (starPattern)
+        {
+            pattern = starPattern;
+            string = ++starString;
+        }
+        else
+        {
+            return FALSE;
+        }
+    }
+
+    while (pattern < patternEnd && *pattern == L'*')
+        pattern++;
+
+    return pattern == patternEnd;
+}
+
+static BOOLEAN PhpEvaluateQueryString(
+    _In_ PPH_QUERY_INSTRUCTION Instruction,
+    _In_ PPH_STRINGREF Value
+    )
+{
+    switch (Instruction->Operator)
+    {
+    case QueryContains:
+        return PhFindStringInStringRef(Value, &Instruction->String, TRUE) != -1;
+    case QueryEqual:
+        return PhEqualStringRef(Value, &Instruction->String, TRUE);
+    case QueryNotEqual:
+        return !PhEqualStringRef(Value, &Instruction->String, TRUE);
+    case QueryMatch:
+        return PhpMatchQueryWildcards(&Instruction->String, Value);
+    default:
+        return FALSE;
+    }
+}
+
+static BOOLEAN PhpEvaluateQueryNumber(
+    _In_ PPH_QUERY_INSTRUCTION Instruction,
+    _In_ DOUBLE Value
+    )
+{
+    switch (Instruction->Operator)
+    {
+    case QueryEqual:
+        return Value == Instruction->Number;
+    case QueryNotEqual:
+        return Value != Instruction->Number;
+    case QueryLess:
+        return Value < Instruction->Number;
+    case QueryLessEqual:
+        return Value <= Instruction->Number;
+    case QueryGreater:
+        return Value > Instruction->Number;
+    case QueryGreaterEqual:
+        return Value >= Instruction->Number;
+    default:
+        return FALSE;
+    }
+}
+
+/**
+ * Checks whether an object matches a query.
+ *
+ * \param Query A compiled query.
+ * \param Object The object, which is passed to the callbacks of the query's schema.
+ */
+BOOLEAN PhEvaluateQuery(
+    _In_ PPH_QUERY Query,
+    _In_ PVOID Object
+    )
+{
+    BOOLEAN result = TRUE;
+    ULONG i = 0;
+
+    while (i < Query->NumberOfInstructions)
+    {
+        PPH_QUERY_INSTRUCTION instruction = &Query->Instructions[i];
+        PH_STRINGREF value;
+
+        switch (instruction->Opcode)
+        {
+        case QueryOpFalse:
+            result = FALSE;
+            break;
+        case QueryOpNumber:
+            result = PhpEvaluateQueryNumber(instruction, Query->GetNumber(instruction->Argument, Object));
+            break;
+        case QueryOpString:
+            result = Query->GetString(instruction->Argument, Object, &value) && PhpEvaluateQueryString(instruction, &value);
+            break;
+        case QueryOpText:
+            result = Query->MatchText && Query->MatchText(&instruction->String, Object);
+            break;
+        case QueryOpNot:
+            result = !result;
+            break;
+        case QueryOpJumpIfFalse:
+            if (!result)
+            {
+                i = instruction->Argument;
+                continue;
+            }
+            break;
+        case QueryOpJumpIfTrue:
+            if (result)
+            {
+                i = instruction->Argument;
+                continue;
+            }
+            break;
+        }
+
+        i++;
+    }
+
+    return result;
+}
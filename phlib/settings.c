@@ -33,6 +33,21 @@
  * The get/set functions are very strict. If the wrong function is used
  * (the get-integer-setting function is used on a string setting) or
  * the setting does not exist, an exception will be raised.
+ *
+ * A setting can be looked up once with PhGetSettingHandle and then
+ * accessed through the handle, which avoids hashing its name on every
+ * call. Integer values are read through a handle without acquiring the
+ * lock. Each setting also has a version number which changes whenever
+ * its value does, so callers can cache values derived from a setting.
+ *
+ * Settings can also be kept in a binary store, which is a header
+ * followed by a journal of records. Each record holds the name and the
+ * typed value of one setting, so loading the store does not parse any
+ * strings. Saving appends records for the settings that have changed
+ * since the store was last read or written. The store is rewritten
+ * instead if the journal has grown too large or if the file was changed
+ * by someone else. A record with a bad checksum (e.g. from an
+ * interrupted write) ends the journal.
  */
 
 #include <ph.h>
@@ -59,20 +74,56 @@ VOID PhpFreeSettingValue(
     _In_ PPH_SETTING Setting
     );
 
-PVOID PhpLookupSetting(
+PPH_SETTING PhpLookupSetting(
     _In_ PPH_STRINGREF Name
     );
 
+#define PH_SETTINGS_STORE_MAGIC ('tSHP')
+#define PH_SETTINGS_STORE_VERSION 1
+
+typedef struct _PH_SETTINGS_STORE_HEADER
+{
+    ULONG Magic;
+    ULONG Version;
+} PH_SETTINGS_STORE_HEADER, *PPH_SETTINGS_STORE_HEADER;
+
+typedef struct _PH_SETTINGS_STORE_RECORD
+{
+    ULONG Length; // length of the entire record, a multiple of 4
+    ULONG Checksum; // CRC-32 of the rest of the record, starting at Type
+    UCHAR Type;
+    UCHAR Reserved;
+    USHORT NameLength;
+    ULONG ValueLength;
+    // WCHAR Name[]; (not null-terminated)
+    // UCHAR Value[]; (aligned to 4 bytes)
+} PH_SETTINGS_STORE_RECORD, *PPH_SETTINGS_STORE_RECORD;
+
+#define PH_SETTINGS_STORE_RECORD_NAME(Record) \
+    ((PWCH)PTR_ADD_OFFSET((Record), sizeof(PH_SETTINGS_STORE_RECORD)))
+#define PH_SETTINGS_STORE_RECORD_VALUE(Record) \
+    (PTR_ADD_OFFSET((Record), sizeof(PH_SETTINGS_STORE_RECORD) + ALIGN_UP_BY((Record)->NameLength, sizeof(ULONG))))
+#define PH_SETTINGS_STORE_CHECKSUM_OFFSET FIELD_OFFSET(PH_SETTINGS_STORE_RECORD, Type)
+
+// The hashtable holds pointers to the settings. Settings are never freed or moved, which allows
+// them to be used as setting handles.
 PPH_HASHTABLE PhSettingsHashtable;
 PH_QUEUED_LOCK PhSettingsLock = PH_QUEUED_LOCK_INIT;
 PPH_LIST PhIgnoredSettings;
+static volatile ULONG PhpSettingsVersion = 0;
+
+// The binary store that the settings were last read from or written to, and where its journal ends.
+// Protected by PhSettingsLock.
+static PPH_STRING PhpSettingsStoreFileName = NULL;
+static ULONG64 PhpSettingsStoreEndOffset = 0;
+static ULONG PhpSettingsStoreRecordCount = 0;
 
 VOID PhSettingsInitialization(
     VOID
     )
 {
     PhSettingsHashtable = PhCreateHashtable(
-        sizeof(PH_SETTING),
+        sizeof(PPH_SETTING),
         PhpSettingsHashtableEqualFunction,
         PhpSettingsHashtableHashFunction,
         256
@@ -88,8 +139,8 @@ BOOLEAN NTAPI PhpSettingsHashtableEqualFunction(
     _In_ PVOID Entry2
     )
 {
-    PPH_SETTING setting1 = (PPH_SETTING)Entry1;
-    PPH_SETTING setting2 = (PPH_SETTING)Entry2;
+    PPH_SETTING setting1 = *(PPH_SETTING *)Entry1;
+    PPH_SETTING setting2 = *(PPH_SETTING *)Entry2;
 
     return PhEqualStringRef(&setting1->Name, &setting2->Name, FALSE);
 }
@@ -98,7 +149,7 @@ ULONG NTAPI PhpSettingsHashtableHashFunction(
     _In_ PVOID Entry
     )
 {
-    PPH_SETTING setting = (PPH_SETTING)Entry;
+    PPH_SETTING setting = *(PPH_SETTING *)Entry;
 
     return PhHashBytes((PUCHAR)setting->Name.Buffer, setting->Name.Length);
 }
@@ -308,20 +359,43 @@ static VOID PhpFreeSettingValue(
     }
 }
 
-static PVOID PhpLookupSetting(
+static PPH_SETTING PhpLookupSetting(
     _In_ PPH_STRINGREF Name
     )
 {
     PH_SETTING lookupSetting;
-    PPH_SETTING setting;
+    PPH_SETTING lookupSettingPtr = &lookupSetting;
+    PPH_SETTING *setting;
 
     lookupSetting.Name = *Name;
-    setting = (PPH_SETTING)PhFindEntryHashtable(
+    setting = (PPH_SETTING *)PhFindEntryHashtable(
         PhSettingsHashtable,
-        &lookupSetting
+        &lookupSettingPtr
         );
 
-    return setting;
+    if (setting)
+        return *setting;
+    else
+        return NULL;
+}
+
+// These must be called with PhSettingsLock held exclusively.
+
+static VOID PhpBeginSettingChange(
+    _Inout_ PPH_SETTING Setting
+    )
+{
+    Setting->Version++;
+    MemoryBarrier();
+}
+
+static VOID PhpEndSettingChange(
+    _Inout_ PPH_SETTING Setting
+    )
+{
+    MemoryBarrier();
+    Setting->Version++;
+    PhpSettingsVersion++;
 }
 
 VOID PhEnumSettings(
@@ -330,7 +404,7 @@ VOID PhEnumSettings(
     )
 {
     PH_HASHTABLE_ENUM_CONTEXT enumContext;
-    PPH_SETTING setting;
+    PPH_SETTING *setting;
 
     PhAcquireQueuedLockExclusive(&PhSettingsLock);
 
@@ -338,104 +412,98 @@ VOID PhEnumSettings(
 
     while (setting = PhNextEnumHashtable(&enumContext))
     {
-        if (!Callback(setting, Context))
+        if (!Callback(*setting, Context))
             break;
     }
 
     PhReleaseQueuedLockExclusive(&PhSettingsLock);
 }
 
-_May_raise_ ULONG PhGetIntegerSetting(
+_May_raise_ PPH_SETTING_HANDLE PhGetSettingHandle(
     _In_ PWSTR Name
     )
 {
     PPH_SETTING setting;
     PH_STRINGREF name;
-    ULONG value;
 
     PhInitializeStringRef(&name, Name);
 
     PhAcquireQueuedLockShared(&PhSettingsLock);
-
     setting = PhpLookupSetting(&name);
-
-    if (setting && setting->Type == IntegerSettingType)
-    {
-        value = setting->u.Integer;
-    }
-    else
-    {
-        setting = NULL;
-    }
-
     PhReleaseQueuedLockShared(&PhSettingsLock);
 
     if (!setting)
         PhRaiseStatus(STATUS_NOT_FOUND);
 
-    return value;
+    return setting;
 }
 
-_May_raise_ PH_INTEGER_PAIR PhGetIntegerPairSetting(
-    _In_ PWSTR Name
+ULONG PhGetSettingVersion(
+    _In_ PPH_SETTING_HANDLE Handle
     )
 {
-    PPH_SETTING setting;
-    PH_STRINGREF name;
-    PH_INTEGER_PAIR value;
+    return Handle->Version / 2;
+}
 
-    PhInitializeStringRef(&name, Name);
+ULONG PhGetSettingsVersion(
+    VOID
+    )
+{
+    return PhpSettingsVersion;
+}
 
-    PhAcquireQueuedLockShared(&PhSettingsLock);
+_May_raise_ ULONG PhGetIntegerSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle
+    )
+{
+    if (Handle->Type != IntegerSettingType)
+        PhRaiseStatus(STATUS_NOT_FOUND);
 
-    setting = PhpLookupSetting(&name);
+    // The value is always written with a single aligned store, so we don't need the lock.
+    return *(volatile ULONG *)&Handle->u.Integer;
+}
 
-    if (setting && setting->Type == IntegerPairSettingType)
-    {
-        value = setting->u.IntegerPair;
-    }
-    else
+_May_raise_ PH_INTEGER_PAIR PhGetIntegerPairSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle
+    )
+{
+    ULONG version;
+    PH_INTEGER_PAIR value;
+
+    if (Handle->Type != IntegerPairSettingType)
+        PhRaiseStatus(STATUS_NOT_FOUND);
+
+    // X and Y are written separately. Read the value again if it was being changed.
+    while (TRUE)
     {
-        setting = NULL;
-    }
+        version = Handle->Version;
+        MemoryBarrier();
+        value = Handle->u.IntegerPair;
+        MemoryBarrier();
 
-    PhReleaseQueuedLockShared(&PhSettingsLock);
+        if (!(version & 1) && Handle->Version == version)
+            break;
 
-    if (!setting)
-        PhRaiseStatus(STATUS_NOT_FOUND);
+        YieldProcessor();
+    }
 
     return value;
 }
 
-_May_raise_ PH_SCALABLE_INTEGER_PAIR PhGetScalableIntegerPairSetting(
-    _In_ PWSTR Name,
+_May_raise_ PH_SCALABLE_INTEGER_PAIR PhGetScalableIntegerPairSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle,
     _In_ BOOLEAN ScaleToCurrent
     )
 {
-    PPH_SETTING setting;
-    PH_STRINGREF name;
     PH_SCALABLE_INTEGER_PAIR value;
 
-    PhInitializeStringRef(&name, Name);
+    if (Handle->Type != ScalableIntegerPairSettingType)
+        PhRaiseStatus(STATUS_NOT_FOUND);
 
     PhAcquireQueuedLockShared(&PhSettingsLock);
-
-    setting = PhpLookupSetting(&name);
-
-    if (setting && setting->Type == ScalableIntegerPairSettingType)
-    {
-        value = *(PPH_SCALABLE_INTEGER_PAIR)setting->u.Pointer;
-    }
-    else
-    {
-        setting = NULL;
-    }
-
+    value = *(PPH_SCALABLE_INTEGER_PAIR)Handle->u.Pointer;
     PhReleaseQueuedLockShared(&PhSettingsLock);
 
-    if (!setting)
-        PhRaiseStatus(STATUS_NOT_FOUND);
-
     if (ScaleToCurrent)
     {
         ULONG currentScale;
@@ -453,49 +521,65 @@ _May_raise_ PH_SCALABLE_INTEGER_PAIR PhGetScalableIntegerPairSetting(
     return value;
 }
 
-_May_raise_ PPH_STRING PhGetStringSetting(
-    _In_ PWSTR Name
+_May_raise_ PPH_STRING PhGetStringSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle
     )
 {
-    PPH_SETTING setting;
-    PH_STRINGREF name;
     PPH_STRING value;
 
-    PhInitializeStringRef(&name, Name);
+    if (Handle->Type != StringSettingType)
+        PhRaiseStatus(STATUS_NOT_FOUND);
 
     PhAcquireQueuedLockShared(&PhSettingsLock);
 
-    setting = PhpLookupSetting(&name);
-
-    if (setting && setting->Type == StringSettingType)
+    if (Handle->u.Pointer)
     {
-        if (setting->u.Pointer)
-        {
-            PhSetReference(&value, setting->u.Pointer);
-        }
-        else
-        {
-            // Set to NULL, create an empty string
-            // outside of the lock.
-            value = NULL;
-        }
+        PhSetReference(&value, Handle->u.Pointer);
     }
     else
     {
-        setting = NULL;
+        // Set to NULL, create an empty string
+        // outside of the lock.
+        value = NULL;
     }
 
     PhReleaseQueuedLockShared(&PhSettingsLock);
 
-    if (!setting)
-        PhRaiseStatus(STATUS_NOT_FOUND);
-
     if (!value)
         value = PhReferenceEmptyString();
 
     return value;
 }
 
+_May_raise_ ULONG PhGetIntegerSetting(
+    _In_ PWSTR Name
+    )
+{
+    return PhGetIntegerSettingByHandle(PhGetSettingHandle(Name));
+}
+
+_May_raise_ PH_INTEGER_PAIR PhGetIntegerPairSetting(
+    _In_ PWSTR Name
+    )
+{
+    return PhGetIntegerPairSettingByHandle(PhGetSettingHandle(Name));
+}
+
+_May_raise_ PH_SCALABLE_INTEGER_PAIR PhGetScalableIntegerPairSetting(
+    _In_ PWSTR Name,
+    _In_ BOOLEAN ScaleToCurrent
+    )
+{
+    return PhGetScalableIntegerPairSettingByHandle(PhGetSettingHandle(Name), ScaleToCurrent);
+}
+
+_May_raise_ PPH_STRING PhGetStringSetting(
+    _In_ PWSTR Name
+    )
+{
+    return PhGetStringSettingByHandle(PhGetSettingHandle(Name));
+}
+
 _May_raise_ BOOLEAN PhGetBinarySetting(
     _In_ PWSTR Name,
     _Out_ PVOID Buffer
@@ -511,80 +595,137 @@ _May_raise_ BOOLEAN PhGetBinarySetting(
     return result;
 }
 
-_May_raise_ VOID PhSetIntegerSetting(
-    _In_ PWSTR Name,
+_May_raise_ VOID PhSetIntegerSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle,
     _In_ ULONG Value
     )
 {
-    PPH_SETTING setting;
-    PH_STRINGREF name;
-
-    PhInitializeStringRef(&name, Name);
+    if (Handle->Type != IntegerSettingType)
+        PhRaiseStatus(STATUS_NOT_FOUND);
 
     PhAcquireQueuedLockExclusive(&PhSettingsLock);
 
-    setting = PhpLookupSetting(&name);
-
-    if (setting && setting->Type == IntegerSettingType)
+    if (Handle->u.Integer != Value)
     {
-        setting->u.Integer = Value;
+        PhpBeginSettingChange(Handle);
+        Handle->u.Integer = Value;
+        Handle->Modified = TRUE;
+        PhpEndSettingChange(Handle);
     }
 
     PhReleaseQueuedLockExclusive(&PhSettingsLock);
-
-    if (!setting)
-        PhRaiseStatus(STATUS_NOT_FOUND);
 }
 
-_May_raise_ VOID PhSetIntegerPairSetting(
-    _In_ PWSTR Name,
+_May_raise_ VOID PhSetIntegerPairSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle,
     _In_ PH_INTEGER_PAIR Value
     )
 {
-    PPH_SETTING setting;
-    PH_STRINGREF name;
-
-    PhInitializeStringRef(&name, Name);
+    if (Handle->Type != IntegerPairSettingType)
+        PhRaiseStatus(STATUS_NOT_FOUND);
 
     PhAcquireQueuedLockExclusive(&PhSettingsLock);
 
-    setting = PhpLookupSetting(&name);
-
-    if (setting && setting->Type == IntegerPairSettingType)
+    if (Handle->u.IntegerPair.X != Value.X || Handle->u.IntegerPair.Y != Value.Y)
     {
-        setting->u.IntegerPair = Value;
+        PhpBeginSettingChange(Handle);
+        Handle->u.IntegerPair = Value;
+        Handle->Modified = TRUE;
+        PhpEndSettingChange(Handle);
     }
 
     PhReleaseQueuedLockExclusive(&PhSettingsLock);
-
-    if (!setting)
-        PhRaiseStatus(STATUS_NOT_FOUND);
 }
 
-_May_raise_ VOID PhSetScalableIntegerPairSetting(
-    _In_ PWSTR Name,
+_May_raise_ VOID PhSetScalableIntegerPairSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle,
     _In_ PH_SCALABLE_INTEGER_PAIR Value
     )
 {
-    PPH_SETTING setting;
-    PH_STRINGREF name;
-
-    PhInitializeStringRef(&name, Name);
+    if (Handle->Type != ScalableIntegerPairSettingType)
+        PhRaiseStatus(STATUS_NOT_FOUND);
 
     PhAcquireQueuedLockExclusive(&PhSettingsLock);
 
-    setting = PhpLookupSetting(&name);
-
-    if (setting && setting->Type == ScalableIntegerPairSettingType)
+    if (
+        !Handle->u.Pointer ||
+        ((PPH_SCALABLE_INTEGER_PAIR)Handle->u.Pointer)->X != Value.X ||
+        ((PPH_SCALABLE_INTEGER_PAIR)Handle->u.Pointer)->Y != Value.Y ||
+        ((PPH_SCALABLE_INTEGER_PAIR)Handle->u.Pointer)->Scale != Value.Scale
+        )
     {
-        PhpFreeSettingValue(ScalableIntegerPairSettingType, setting);
-        setting->u.Pointer = PhAllocateCopy(&Value, sizeof(PH_SCALABLE_INTEGER_PAIR));
+        PhpBeginSettingChange(Handle);
+        PhpFreeSettingValue(ScalableIntegerPairSettingType, Handle);
+        Handle->u.Pointer = PhAllocateCopy(&Value, sizeof(PH_SCALABLE_INTEGER_PAIR));
+        Handle->Modified = TRUE;
+        PhpEndSettingChange(Handle);
     }
 
     PhReleaseQueuedLockExclusive(&PhSettingsLock);
+}
 
-    if (!setting)
+_May_raise_ VOID PhSetStringSettingByHandle(
+    _In_ PPH_SETTING_HANDLE Handle,
+    _In_ PPH_STRINGREF Value
+    )
+{
+    if (Handle->Type != StringSettingType)
         PhRaiseStatus(STATUS_NOT_FOUND);
+
+    PhAcquireQueuedLockExclusive(&PhSettingsLock);
+
+    if (!Handle->u.Pointer || !PhEqualStringRef(&((PPH_STRING)Handle->u.Pointer)->sr, Value, FALSE))
+    {
+        PhpBeginSettingChange(Handle);
+        PhpFreeSettingValue(StringSettingType, Handle);
+        Handle->u.Pointer = PhCreateString2(Value);
+        Handle->Modified = TRUE;
+        PhpEndSettingChange(Handle);
+    }
+
+    PhReleaseQueuedLockExclusive(&PhSettingsLock);
+}
+
+// The name-based setters raise only when the setting doesn't exist. A setting of a different type
+// is left unchanged, unlike the *ByHandle setters.
+
+_May_raise_ VOID PhSetIntegerSetting(
+    _In_ PWSTR Name,
+    _In_ ULONG Value
+    )
+{
+    PPH_SETTING_HANDLE handle;
+
+    handle = PhGetSettingHandle(Name);
+
+    if (handle->Type == IntegerSettingType)
+        PhSetIntegerSettingByHandle(handle, Value);
+}
+
+_May_raise_ VOID PhSetIntegerPairSetting(
+    _In_ PWSTR Name,
+    _In_ PH_INTEGER_PAIR Value
+    )
+{
+    PPH_SETTING_HANDLE handle;
+
+    handle = PhGetSettingHandle(Name);
+
+    if (handle->Type == IntegerPairSettingType)
+        PhSetIntegerPairSettingByHandle(handle, Value);
+}
+
+_May_raise_ VOID PhSetScalableIntegerPairSetting(
+    _In_ PWSTR Name,
+    _In_ PH_SCALABLE_INTEGER_PAIR Value
+    )
+{
+    PPH_SETTING_HANDLE handle;
+
+    handle = PhGetSettingHandle(Name);
+
+    if (handle->Type == ScalableIntegerPairSettingType)
+        PhSetScalableIntegerPairSettingByHandle(handle, Value);
 }
 
 _May_raise_ VOID PhSetScalableIntegerPairSetting2(
@@ -604,25 +745,16 @@ _May_raise_ VOID PhSetStringSetting(
     _In_ PWSTR Value
     )
 {
-    PPH_SETTING setting;
-    PH_STRINGREF name;
+    PPH_SETTING_HANDLE handle;
+    PH_STRINGREF value;
 
-    PhInitializeStringRef(&name, Name);
-
-    PhAcquireQueuedLockExclusive(&PhSettingsLock);
+    handle = PhGetSettingHandle(Name);
 
-    setting = PhpLookupSetting(&name);
-
-    if (setting && setting->Type == StringSettingType)
+    if (handle->Type == StringSettingType)
     {
-        PhpFreeSettingValue(StringSettingType, setting);
-        setting->u.Pointer = PhCreateString(Value);
+        PhInitializeStringRef(&value, Value);
+        PhSetStringSettingByHandle(handle, &value);
     }
-
-    PhReleaseQueuedLockExclusive(&PhSettingsLock);
-
-    if (!setting)
-        PhRaiseStatus(STATUS_NOT_FOUND);
 }
 
 _May_raise_ VOID PhSetStringSetting2(
@@ -630,25 +762,12 @@ _May_raise_ VOID PhSetStringSetting2(
     _In_ PPH_STRINGREF Value
     )
 {
-    PPH_SETTING setting;
-    PH_STRINGREF name;
-
-    PhInitializeStringRef(&name, Name);
-
-    PhAcquireQueuedLockExclusive(&PhSettingsLock);
-
-    setting = PhpLookupSetting(&name);
-
-    if (setting && setting->Type == StringSettingType)
-    {
-        PhpFreeSettingValue(StringSettingType, setting);
-        setting->u.Pointer = PhCreateString2(Value);
-    }
+    PPH_SETTING_HANDLE handle;
 
-    PhReleaseQueuedLockExclusive(&PhSettingsLock);
+    handle = PhGetSettingHandle(Name);
 
-    if (!setting)
-        PhRaiseStatus(STATUS_NOT_FOUND);
+    if (handle->Type == StringSettingType)
+        PhSetStringSettingByHandle(handle, Value);
 }
 
 _May_raise_ VOID PhSetBinarySetting(
@@ -716,6 +835,7 @@ VOID PhConvertIgnoredSettings(
 
         if (setting)
         {
+            PhpBeginSettingChange(setting);
             PhpFreeSettingValue(setting->Type, setting);
 
             if (!PhSettingFromString(
@@ -733,6 +853,8 @@ VOID PhConvertIgnoredSettings(
                     );
             }
 
+            PhpEndSettingChange(setting);
+
             PhpFreeIgnoredSetting(ignoredSetting);
 
             PhRemoveItemList(PhIgnoredSettings, i);
@@ -759,6 +881,257 @@ PPH_STRING PhpGetOpaqueXmlNodeText(
     }
 }
 
+static PPH_STRING PhpSettingsStoreValueToString(
+    _In_ PH_SETTING_TYPE Type,
+    _In_ PVOID Value,
+    _In_ ULONG ValueLength
+    )
+{
+    PH_SETTING setting;
+
+    memset(&setting, 0, sizeof(PH_SETTING));
+
+    switch (Type)
+    {
+    case StringSettingType:
+        return PhCreateStringEx(Value, ValueLength);
+    case IntegerSettingType:
+        if (ValueLength != sizeof(ULONG))
+            return NULL;
+        setting.u.Integer = *(PULONG)Value;
+        break;
+    case IntegerPairSettingType:
+        if (ValueLength != sizeof(PH_INTEGER_PAIR))
+            return NULL;
+        setting.u.IntegerPair = *(PPH_INTEGER_PAIR)Value;
+        break;
+    case ScalableIntegerPairSettingType:
+        if (ValueLength != sizeof(PH_SCALABLE_INTEGER_PAIR))
+            return NULL;
+        setting.u.Pointer = Value;
+        break;
+    default:
+        return NULL;
+    }
+
+    return PhSettingToString(Type, &setting);
+}
+
+static BOOLEAN PhpSettingFromStoreValue(
+    _Inout_ PPH_SETTING Setting,
+    _In_ PH_SETTING_TYPE Type,
+    _In_ PVOID Value,
+    _In_ ULONG ValueLength
+    )
+{
+    if (Setting->Type != Type)
+    {
+        PPH_STRING string;
+        BOOLEAN result;
+
+        // The type of the setting has changed since it was saved (or it was saved as an ignored
+        // setting), so go through the string representation.
+
+        if (!(string = PhpSettingsStoreValueToString(Type, Value, ValueLength)))
+            return FALSE;
+
+        result = PhSettingFromString(Setting->Type, &string->sr, string, Setting);
+        PhDereferenceObject(string);
+
+        return result;
+    }
+
+    switch (Type)
+    {
+    case StringSettingType:
+        Setting->u.Pointer = PhCreateStringEx(Value, ValueLength);
+        return TRUE;
+    case IntegerSettingType:
+        if (ValueLength != sizeof(ULONG))
+            return FALSE;
+        Setting->u.Integer = *(PULONG)Value;
+        return TRUE;
+    case IntegerPairSettingType:
+        if (ValueLength != sizeof(PH_INTEGER_PAIR))
+            return FALSE;
+        Setting->u.IntegerPair = *(PPH_INTEGER_PAIR)Value;
+        return TRUE;
+    case ScalableIntegerPairSettingType:
+        if (ValueLength != sizeof(PH_SCALABLE_INTEGER_PAIR))
+            return FALSE;
+        Setting->u.Pointer = PhAllocateCopy(Value, sizeof(PH_SCALABLE_INTEGER_PAIR));
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static PPH_SETTINGS_STORE_RECORD PhpGetSettingsStoreRecord(
+    _In_ PVOID Buffer,
+    _In_ ULONG BufferLength,
+    _In_ ULONG Offset
+    )
+{
+    PPH_SETTINGS_STORE_RECORD record;
+
+    if (BufferLength - Offset < sizeof(PH_SETTINGS_STORE_RECORD))
+        return NULL;
+
+    record = PTR_ADD_OFFSET(Buffer, Offset);
+
+    if (record->Length < sizeof(PH_SETTINGS_STORE_RECORD) || record->Length > BufferLength - Offset || (record->Length & 3))
+        return NULL;
+    if (record->NameLength == 0 || (record->NameLength & 1))
+        return NULL;
+    if (sizeof(PH_SETTINGS_STORE_RECORD) + ALIGN_UP_BY(record->NameLength, sizeof(ULONG)) + (ULONG64)record->ValueLength > record->Length)
+        return NULL;
+    if (record->Type == StringSettingType && (record->ValueLength & 1))
+        return NULL;
+
+    if (PhCrc32(
+        0,
+        (PCHAR)PTR_ADD_OFFSET(record, PH_SETTINGS_STORE_CHECKSUM_OFFSET),
+        record->Length - PH_SETTINGS_STORE_CHECKSUM_OFFSET
+        ) != record->Checksum)
+    {
+        return NULL;
+    }
+
+    return record;
+}
+
+static VOID PhpApplySettingsStoreRecord(
+    _In_ PPH_SETTINGS_STORE_RECORD Record
+    )
+{
+    PH_STRINGREF name;
+    PVOID value;
+    PPH_SETTING setting;
+
+    name.Buffer = PH_SETTINGS_STORE_RECORD_NAME(Record);
+    name.Length = Record->NameLength;
+    value = PH_SETTINGS_STORE_RECORD_VALUE(Record);
+
+    if (setting = PhpLookupSetting(&name))
+    {
+        PhpBeginSettingChange(setting);
+        PhpFreeSettingValue(setting->Type, setting);
+
+        if (!PhpSettingFromStoreValue(setting, Record->Type, value, Record->ValueLength))
+            PhSettingFromString(setting->Type, &setting->DefaultValue, NULL, setting);
+
+        setting->Modified = FALSE;
+        PhpEndSettingChange(setting);
+    }
+    else
+    {
+        PPH_STRING settingValue;
+        ULONG i;
+
+        if (!(settingValue = PhpSettingsStoreValueToString(Record->Type, value, Record->ValueLength)))
+            return;
+
+        // Later records replace earlier ones for the same setting.
+        for (i = 0; i < PhIgnoredSettings->Count; i++)
+        {
+            setting = PhIgnoredSettings->Items[i];
+
+            if (PhEqualStringRef(&setting->Name, &name, FALSE))
+            {
+                PhMoveReference(&setting->u.Pointer, settingValue);
+                return;
+            }
+        }
+
+        setting = PhAllocate(sizeof(PH_SETTING));
+        setting->Name.Buffer = PhAllocate(name.Length + sizeof(UNICODE_NULL));
+        memcpy(setting->Name.Buffer, name.Buffer, name.Length);
+        setting->Name.Buffer[name.Length / sizeof(WCHAR)] = UNICODE_NULL;
+        setting->Name.Length = name.Length;
+        setting->u.Pointer = settingValue;
+
+        PhAddItemList(PhIgnoredSettings, setting);
+    }
+}
+
+static NTSTATUS PhpLoadSettingsStore(
+    _In_ HANDLE FileHandle,
+    _In_ ULONG FileSize,
+    _In_ PWSTR FileName
+    )
+{
+    NTSTATUS status;
+    HANDLE sectionHandle;
+    PVOID viewBase = NULL;
+    SIZE_T viewSize = 0;
+    PPH_SETTINGS_STORE_HEADER header;
+    PPH_SETTINGS_STORE_RECORD record;
+    ULONG offset;
+    ULONG recordCount;
+
+    status = NtCreateSection(
+        &sectionHandle,
+        SECTION_QUERY | SECTION_MAP_READ,
+        NULL,
+        NULL,
+        PAGE_READONLY,
+        SEC_COMMIT,
+        FileHandle
+        );
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    status = NtMapViewOfSection(
+        sectionHandle,
+        NtCurrentProcess(),
+        &viewBase,
+        0,
+        0,
+        NULL,
+        &viewSize,
+        ViewShare,
+        0,
+        PAGE_READONLY
+        );
+    NtClose(sectionHandle);
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    header = viewBase;
+
+    if (FileSize < sizeof(PH_SETTINGS_STORE_HEADER) || header->Version != PH_SETTINGS_STORE_VERSION)
+    {
+        NtUnmapViewOfSection(NtCurrentProcess(), viewBase);
+        return STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    offset = sizeof(PH_SETTINGS_STORE_HEADER);
+    recordCount = 0;
+
+    PhAcquireQueuedLockExclusive(&PhSettingsLock);
+
+    while (record = PhpGetSettingsStoreRecord(viewBase, FileSize, offset))
+    {
+        PhpApplySettingsStoreRecord(record);
+        offset += record->Length;
+        recordCount++;
+    }
+
+    // If the journal ended early, the next save will find that the file is larger than expected
+    // and rewrite it.
+    PhMoveReference(&PhpSettingsStoreFileName, PhCreateString(FileName));
+    PhpSettingsStoreEndOffset = offset;
+    PhpSettingsStoreRecordCount = recordCount;
+
+    PhReleaseQueuedLockExclusive(&PhSettingsLock);
+
+    NtUnmapViewOfSection(NtCurrentProcess(), viewBase);
+
+    return STATUS_SUCCESS;
+}
+
 NTSTATUS PhLoadSettings(
     _In_ PWSTR FileName
     )
@@ -766,11 +1139,18 @@ NTSTATUS PhLoadSettings(
     NTSTATUS status;
     HANDLE fileHandle;
     LARGE_INTEGER fileSize;
+    LARGE_INTEGER offset;
+    IO_STATUS_BLOCK isb;
+    ULONG magic;
     mxml_node_t *topNode;
     mxml_node_t *currentNode;
 
     PhpClearIgnoredSettings();
 
+    PhAcquireQueuedLockExclusive(&PhSettingsLock);
+    PhClearReference(&PhpSettingsStoreFileName);
+    PhReleaseQueuedLockExclusive(&PhSettingsLock);
+
     status = PhCreateFileWin32(
         &fileHandle,
         FileName,
@@ -784,11 +1164,39 @@ NTSTATUS PhLoadSettings(
     if (!NT_SUCCESS(status))
         return status;
 
-    if (NT_SUCCESS(PhGetFileSize(fileHandle, &fileSize)) && fileSize.QuadPart == 0)
+    if (NT_SUCCESS(PhGetFileSize(fileHandle, &fileSize)))
     {
-        // A blank file is OK. There are no settings to load.
-        NtClose(fileHandle);
-        return status;
+        if (fileSize.QuadPart == 0)
+        {
+            // A blank file is OK. There are no settings to load.
+            NtClose(fileHandle);
+            return status;
+        }
+
+        offset.QuadPart = 0;
+
+        if (fileSize.QuadPart <= MAXLONG && NT_SUCCESS(NtReadFile(
+            fileHandle,
+            NULL,
+            NULL,
+            NULL,
+            &isb,
+            &magic,
+            sizeof(ULONG),
+            &offset,
+            NULL
+            )) && isb.Information == sizeof(ULONG) && magic == PH_SETTINGS_STORE_MAGIC)
+        {
+            status = PhpLoadSettingsStore(fileHandle, fileSize.LowPart, FileName);
+            NtClose(fileHandle);
+
+            if (NT_SUCCESS(status))
+                PhUpdateCachedSettings();
+
+            return status;
+        }
+
+        PhSetFilePosition(fileHandle, &offset);
     }
 
     topNode = mxmlLoadFd(NULL, fileHandle, MXML_OPAQUE_CALLBACK);
@@ -830,6 +1238,7 @@ NTSTATUS PhLoadSettings(
 
                 if (setting)
                 {
+                    PhpBeginSettingChange(setting);
                     PhpFreeSettingValue(setting->Type, setting);
 
                     if (!PhSettingFromString(
@@ -846,6 +1255,8 @@ NTSTATUS PhLoadSettings(
                             setting
                             );
                     }
+
+                    PhpEndSettingChange(setting);
                 }
                 else
                 {
@@ -929,6 +1340,29 @@ mxml_node_t *PhpCreateSettingElement(
     return settingNode;
 }
 
+static VOID PhpCreateSettingsDirectory(
+    _In_ PWSTR FileName
+    )
+{
+    PPH_STRING fullPath;
+    ULONG indexOfFileName;
+    PPH_STRING directoryName;
+
+    fullPath = PhGetFullPath(FileName, &indexOfFileName);
+
+    if (fullPath)
+    {
+        if (indexOfFileName != -1)
+        {
+            directoryName = PhSubstring(fullPath, 0, indexOfFileName);
+            PhCreateDirectory(directoryName);
+            PhDereferenceObject(directoryName);
+        }
+
+        PhDereferenceObject(fullPath);
+    }
+}
+
 NTSTATUS PhSaveSettings(
     _In_ PWSTR FileName
     )
@@ -937,6 +1371,7 @@ NTSTATUS PhSaveSettings(
     HANDLE fileHandle;
     mxml_node_t *topNode;
     PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PPH_SETTING *settingEntry;
     PPH_SETTING setting;
 
     topNode = mxmlNewElement(MXML_NO_PARENT, "settings");
@@ -945,10 +1380,11 @@ NTSTATUS PhSaveSettings(
 
     PhBeginEnumHashtable(PhSettingsHashtable, &enumContext);
 
-    while (setting = PhNextEnumHashtable(&enumContext))
+    while (settingEntry = PhNextEnumHashtable(&enumContext))
     {
         PPH_STRING settingValue;
 
+        setting = *settingEntry;
         settingValue = PhSettingToString(setting->Type, setting);
         PhpCreateSettingElement(topNode, &setting->Name, &settingValue->sr);
         PhDereferenceObject(settingValue);
@@ -971,25 +1407,7 @@ NTSTATUS PhSaveSettings(
     PhReleaseQueuedLockShared(&PhSettingsLock);
 
     // Create the directory if it does not exist.
-    {
-        PPH_STRING fullPath;
-        ULONG indexOfFileName;
-        PPH_STRING directoryName;
-
-        fullPath = PhGetFullPath(FileName, &indexOfFileName);
-
-        if (fullPath)
-        {
-            if (indexOfFileName != -1)
-            {
-                directoryName = PhSubstring(fullPath, 0, indexOfFileName);
-                PhCreateDirectory(directoryName);
-                PhDereferenceObject(directoryName);
-            }
-
-            PhDereferenceObject(fullPath);
-        }
-    }
+    PhpCreateSettingsDirectory(FileName);
 
     status = PhCreateFileWin32(
         &fileHandle,
@@ -1014,21 +1432,261 @@ NTSTATUS PhSaveSettings(
     return STATUS_SUCCESS;
 }
 
+static VOID PhpAppendSettingsStoreRecord(
+    _Inout_ PPH_BYTES_BUILDER BytesBuilder,
+    _In_ PH_SETTING_TYPE Type,
+    _In_ PPH_STRINGREF Name,
+    _In_reads_bytes_opt_(ValueLength) PVOID Value,
+    _In_ ULONG ValueLength
+    )
+{
+    PPH_SETTINGS_STORE_RECORD record;
+    ULONG length;
+
+    if (Name->Length == 0 || Name->Length > MAXUSHORT - 1)
+        return;
+
+    length = (ULONG)(sizeof(PH_SETTINGS_STORE_RECORD) + ALIGN_UP_BY(Name->Length, sizeof(ULONG)) + ALIGN_UP_BY(ValueLength, sizeof(ULONG)));
+    record = PhAppendBytesBuilderEx(BytesBuilder, NULL, length, 0, NULL);
+    memset(record, 0, length);
+
+    record->Length = length;
+    record->Type = (UCHAR)Type;
+    record->NameLength = (USHORT)Name->Length;
+    record->ValueLength = ValueLength;
+    memcpy(PH_SETTINGS_STORE_RECORD_NAME(record), Name->Buffer, Name->Length);
+
+    if (ValueLength != 0)
+        memcpy(PH_SETTINGS_STORE_RECORD_VALUE(record), Value, ValueLength);
+
+    record->Checksum = PhCrc32(
+        0,
+        (PCHAR)PTR_ADD_OFFSET(record, PH_SETTINGS_STORE_CHECKSUM_OFFSET),
+        length - PH_SETTINGS_STORE_CHECKSUM_OFFSET
+        );
+}
+
+static VOID PhpAppendSettingsStoreSetting(
+    _Inout_ PPH_BYTES_BUILDER BytesBuilder,
+    _In_ PPH_SETTING Setting
+    )
+{
+    switch (Setting->Type)
+    {
+    case StringSettingType:
+        {
+            PPH_STRING string = Setting->u.Pointer;
+
+            PhpAppendSettingsStoreRecord(
+                BytesBuilder,
+                StringSettingType,
+                &Setting->Name,
+                string ? string->Buffer : NULL,
+                string ? (ULONG)string->Length : 0
+                );
+        }
+        break;
+    case IntegerSettingType:
+        PhpAppendSettingsStoreRecord(BytesBuilder, IntegerSettingType, &Setting->Name, &Setting->u.Integer, sizeof(ULONG));
+        break;
+    case IntegerPairSettingType:
+        PhpAppendSettingsStoreRecord(BytesBuilder, IntegerPairSettingType, &Setting->Name, &Setting->u.IntegerPair, sizeof(PH_INTEGER_PAIR));
+        break;
+    case ScalableIntegerPairSettingType:
+        if (Setting->u.Pointer)
+            PhpAppendSettingsStoreRecord(BytesBuilder, ScalableIntegerPairSettingType, &Setting->Name, Setting->u.Pointer, sizeof(PH_SCALABLE_INTEGER_PAIR));
+        break;
+    }
+}
+
+NTSTATUS PhSaveSettingsBinary(
+    _In_ PWSTR FileName
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle = NULL;
+    PH_STRINGREF fileName;
+    PH_BYTES_BUILDER bytesBuilder;
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PPH_SETTING *settingEntry;
+    PPH_SETTING setting;
+    LARGE_INTEGER fileSize;
+    LARGE_INTEGER offset;
+    IO_STATUS_BLOCK isb;
+    ULONG recordCount = 0;
+    BOOLEAN append = FALSE;
+    ULONG i;
+
+    PhInitializeStringRefLongHint(&fileName, FileName);
+    PhInitializeBytesBuilder(&bytesBuilder, 0x1000);
+
+    // Hold the lock until the file has been written so that the modified flags can be cleared.
+    PhAcquireQueuedLockExclusive(&PhSettingsLock);
+
+    // Append to the journal if we were the last to read or write the store.
+    if (PhpSettingsStoreFileName && PhEqualStringRef(&PhpSettingsStoreFileName->sr, &fileName, TRUE))
+    {
+        if (NT_SUCCESS(PhCreateFileWin32(
+            &fileHandle,
+            FileName,
+            FILE_GENERIC_READ | FILE_GENERIC_WRITE,
+            FILE_ATTRIBUTE_NORMAL,
+            FILE_SHARE_READ,
+            FILE_OPEN,
+            FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+            )))
+        {
+            if (NT_SUCCESS(PhGetFileSize(fileHandle, &fileSize)) && (ULONG64)fileSize.QuadPart == PhpSettingsStoreEndOffset)
+            {
+                append = TRUE;
+            }
+            else
+            {
+                NtClose(fileHandle);
+                fileHandle = NULL;
+            }
+        }
+    }
+
+    if (append)
+    {
+        PhBeginEnumHashtable(PhSettingsHashtable, &enumContext);
+
+        while (settingEntry = PhNextEnumHashtable(&enumContext))
+        {
+            setting = *settingEntry;
+
+            if (setting->Modified)
+            {
+                PhpAppendSettingsStoreSetting(&bytesBuilder, setting);
+                recordCount++;
+            }
+        }
+
+        // Compact the store once most of the journal would be superseded records.
+        if (PhpSettingsStoreRecordCount + recordCount > (PhSettingsHashtable->Count + PhIgnoredSettings->Count) * 2)
+        {
+            append = FALSE;
+            NtClose(fileHandle);
+            fileHandle = NULL;
+
+            PhDeleteBytesBuilder(&bytesBuilder);
+            PhInitializeBytesBuilder(&bytesBuilder, 0x1000);
+            recordCount = 0;
+        }
+    }
+
+    if (!append)
+    {
+        PH_SETTINGS_STORE_HEADER header;
+
+        header.Magic = PH_SETTINGS_STORE_MAGIC;
+        header.Version = PH_SETTINGS_STORE_VERSION;
+        PhAppendBytesBuilderEx(&bytesBuilder, &header, sizeof(PH_SETTINGS_STORE_HEADER), 0, NULL);
+
+        PhBeginEnumHashtable(PhSettingsHashtable, &enumContext);
+
+        while (settingEntry = PhNextEnumHashtable(&enumContext))
+        {
+            PhpAppendSettingsStoreSetting(&bytesBuilder, *settingEntry);
+            recordCount++;
+        }
+
+        for (i = 0; i < PhIgnoredSettings->Count; i++)
+        {
+            PPH_STRING settingValue;
+
+            setting = PhIgnoredSettings->Items[i];
+            settingValue = setting->u.Pointer;
+            PhpAppendSettingsStoreRecord(&bytesBuilder, StringSettingType, &setting->Name, settingValue->Buffer, (ULONG)settingValue->Length);
+            recordCount++;
+        }
+
+        PhpCreateSettingsDirectory(FileName);
+
+        status = PhCreateFileWin32(
+            &fileHandle,
+            FileName,
+            FILE_GENERIC_WRITE,
+            FILE_ATTRIBUTE_NORMAL,
+            FILE_SHARE_READ,
+            FILE_OVERWRITE_IF,
+            FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+            );
+
+        if (!NT_SUCCESS(status))
+            goto CleanupExit;
+
+        fileSize.QuadPart = 0;
+    }
+
+    status = STATUS_SUCCESS;
+
+    if (bytesBuilder.Bytes->Length != 0)
+    {
+        offset = fileSize;
+        status = NtWriteFile(
+            fileHandle,
+            NULL,
+            NULL,
+            NULL,
+            &isb,
+            bytesBuilder.Bytes->Buffer,
+            (ULONG)bytesBuilder.Bytes->Length,
+            &offset,
+            NULL
+            );
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        PhMoveReference(&PhpSettingsStoreFileName, PhCreateString2(&fileName));
+        PhpSettingsStoreEndOffset = fileSize.QuadPart + bytesBuilder.Bytes->Length;
+        PhpSettingsStoreRecordCount = (append ? PhpSettingsStoreRecordCount : 0) + recordCount;
+
+        PhBeginEnumHashtable(PhSettingsHashtable, &enumContext);
+
+        while (settingEntry = PhNextEnumHashtable(&enumContext))
+            (*settingEntry)->Modified = FALSE;
+    }
+
+CleanupExit:
+    if (!NT_SUCCESS(status))
+    {
+        // We don't know what state the file is in, so rewrite it next time.
+        PhClearReference(&PhpSettingsStoreFileName);
+    }
+
+    PhReleaseQueuedLockExclusive(&PhSettingsLock);
+
+    if (fileHandle)
+        NtClose(fileHandle);
+
+    PhDeleteBytesBuilder(&bytesBuilder);
+
+    return status;
+}
+
 VOID PhResetSettings(
     VOID
     )
 {
     PH_HASHTABLE_ENUM_CONTEXT enumContext;
-    PPH_SETTING setting;
+    PPH_SETTING *settingEntry;
 
     PhAcquireQueuedLockExclusive(&PhSettingsLock);
 
     PhBeginEnumHashtable(PhSettingsHashtable, &enumContext);
 
-    while (setting = PhNextEnumHashtable(&enumContext))
+    while (settingEntry = PhNextEnumHashtable(&enumContext))
     {
+        PPH_SETTING setting = *settingEntry;
+
+        PhpBeginSettingChange(setting);
         PhpFreeSettingValue(setting->Type, setting);
         PhSettingFromString(setting->Type, &setting->DefaultValue, NULL, setting);
+        setting->Modified = TRUE;
+        PhpEndSettingChange(setting);
     }
 
     PhReleaseQueuedLockExclusive(&PhSettingsLock);
@@ -1040,16 +1698,21 @@ VOID PhAddSetting(
     _In_ PPH_STRINGREF DefaultValue
     )
 {
-    PH_SETTING setting;
+    PPH_SETTING setting;
 
-    setting.Type = Type;
-    setting.Name = *Name;
-    setting.DefaultValue = *DefaultValue;
-    memset(&setting.u, 0, sizeof(setting.u));
+    setting = PhAllocateZero(sizeof(PH_SETTING));
+    setting->Type = Type;
+    setting->Name = *Name;
+    setting->DefaultValue = *DefaultValue;
 
-    PhSettingFromString(Type, &setting.DefaultValue, NULL, &setting);
+    PhSettingFromString(Type, &setting->DefaultValue, NULL, setting);
 
-    PhAddEntryHashtable(PhSettingsHashtable, &setting);
+    if (!PhAddEntryHashtable(PhSettingsHashtable, &setting))
+    {
+        // The setting already exists.
+        PhpFreeSettingValue(Type, setting);
+        PhFree(setting);
+    }
 }
 
 VOID PhAddSettings(
@@ -22,6 +22,11 @@
 #include <phbase.h>
 #include "sha.h"
 
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
 /* SHA1 Helper Macros */
 
 //#define rol(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
@@ -88,6 +93,244 @@ static void SHATransform(ULONG State[5], UCHAR Buffer[64])
    a = b = c = d = e = 0;
 }
 
+#if defined(_M_IX86) || defined(_M_X64)
+/* Hash consecutive 512-bit blocks using the Intel SHA extensions. Based on the
+   public domain code by Sean Gulley and Jeffrey Walton. */
+static VOID SHATransformShaNi(ULONG State[5], UCHAR *Data, ULONG NumberOfBlocks)
+{
+   __m128i abcd, abcdSave, E0, E0Save, E1;
+   __m128i MSG0, MSG1, MSG2, MSG3;
+   const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL);
+
+   abcd = _mm_loadu_si128((const __m128i *)State);
+   E0 = _mm_set_epi32(State[4], 0, 0, 0);
+   abcd = _mm_shuffle_epi32(abcd, 0x1B);
+
+   while (NumberOfBlocks--)
+   {
+      abcdSave = abcd;
+      E0Save = E0;
+
+      /* Rounds 0-3 */
+      MSG0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Data + 0)), mask);
+      E0 = _mm_add_epi32(E0, MSG0);
+      E1 = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, E0, 0);
+
+      /* Rounds 4-7 */
+      MSG1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Data + 16)), mask);
+      E1 = _mm_sha1nexte_epu32(E1, MSG1);
+      E0 = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, E1, 0);
+      MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+
+      /* Rounds 8-11 */
+      MSG2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Data + 32)), mask);
+      E0 = _mm_sha1nexte_epu32(E0, MSG2);
+      E1 = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, E0, 0);
+      MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+      MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+      /* Rounds 12-15 */
+      MSG3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(Data + 48)), mask);
+      E1 = _mm_sha1nexte_epu32(E1, MSG3);
+      E0 = abcd;
+      MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+      abcd = _mm_sha1rnds4_epu32(abcd, E1, 0);
+      MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+      MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+      /* Rounds 16-19 */
+      E0 = _mm_sha1nexte_epu32(E0, MSG0);
+      E1 = abcd;
+      MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+      abcd = _mm_sha1rnds4_epu32(abcd, E0, 0);
+      MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+      MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+      /* Rounds 20-23 */
+      E1 = _mm_sha1nexte_epu32(E1, MSG1);
+      E0 = abcd;
+      MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+      abcd = _mm_sha1rnds4_epu32(abcd, E1, 1);
+      MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+      MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+      /* Rounds 24-27 */
+      E0 = _mm_sha1nexte_epu32(E0, MSG2);
+      E1 = abcd;
+      MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+      abcd = _mm_sha1rnds4_epu32(abcd, E0, 1);
+      MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+      MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+      /* Rounds 28-31 */
+      E1 = _mm_sha1nexte_epu32(E1, MSG3);
+      E0 = abcd;
+      MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+      abcd = _mm_sha1rnds4_epu32(abcd, E1, 1);
+      MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+      MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+      /* Rounds 32-35 */
+      E0 = _mm_sha1nexte_epu32(E0, MSG0);
+      E1 = abcd;
+      MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+      abcd = _mm_sha1rnds4_epu32(abcd, E0, 1);
+      MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+      MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+      /* Rounds 36-39 */
+      E1 = _mm_sha1nexte_epu32(E1, MSG1);
+      E0 = abcd;
+      MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+      abcd = _mm_sha1rnds4_epu32(abcd, E1, 1);
+      MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+      MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+      /* Rounds 40-43 */
+      E0 = _mm_sha1nexte_epu32(E0, MSG2);
+      E1 = abcd;
+      MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+      abcd = _mm_sha1rnds4_epu32(abcd, E0, 2);
+      MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+      MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+      /* Rounds 44-47 */
+      E1 = _mm_sha1nexte_epu32(E1, MSG3);
+      E0 = abcd;
+      MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+      abcd = _mm_sha1rnds4_epu32(abcd, E1, 2);
+      MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+      MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+      /* Rounds 48-51 */
+      E0 = _mm_sha1nexte_epu32(E0, MSG0);
+      E1 = abcd;
+      MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+      abcd = _mm_sha1rnds4_epu32(abcd, E0, 2);
+      MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+      MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+      /* Rounds 52-55 */
+      E1 = _mm_sha1nexte_epu32(E1, MSG1);
+      E0 = abcd;
+      MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+      abcd = _mm_sha1rnds4_epu32(abcd, E1, 2);
+      MSG0 = _mm_sha1msg1_epu32(MSG0, MSG1);
+      MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+      /* Rounds 56-59 */
+      E0 = _mm_sha1nexte_epu32(E0, MSG2);
+      E1 = abcd;
+      MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+      abcd = _mm_sha1rnds4_epu32(abcd, E0, 2);
+      MSG1 = _mm_sha1msg1_epu32(MSG1, MSG2);
+      MSG0 = _mm_xor_si128(MSG0, MSG2);
+
+      /* Rounds 60-63 */
+      E1 = _mm_sha1nexte_epu32(E1, MSG3);
+      E0 = abcd;
+      MSG0 = _mm_sha1msg2_epu32(MSG0, MSG3);
+      abcd = _mm_sha1rnds4_epu32(abcd, E1, 3);
+      MSG2 = _mm_sha1msg1_epu32(MSG2, MSG3);
+      MSG1 = _mm_xor_si128(MSG1, MSG3);
+
+      /* Rounds 64-67 */
+      E0 = _mm_sha1nexte_epu32(E0, MSG0);
+      E1 = abcd;
+      MSG1 = _mm_sha1msg2_epu32(MSG1, MSG0);
+      abcd = _mm_sha1rnds4_epu32(abcd, E0, 3);
+      MSG3 = _mm_sha1msg1_epu32(MSG3, MSG0);
+      MSG2 = _mm_xor_si128(MSG2, MSG0);
+
+      /* Rounds 68-71 */
+      E1 = _mm_sha1nexte_epu32(E1, MSG1);
+      E0 = abcd;
+      MSG2 = _mm_sha1msg2_epu32(MSG2, MSG1);
+      abcd = _mm_sha1rnds4_epu32(abcd, E1, 3);
+      MSG3 = _mm_xor_si128(MSG3, MSG1);
+
+      /* Rounds 72-75 */
+      E0 = _mm_sha1nexte_epu32(E0, MSG2);
+      E1 = abcd;
+      MSG3 = _mm_sha1msg2_epu32(MSG3, MSG2);
+      abcd = _mm_sha1rnds4_epu32(abcd, E0, 3);
+
+      /* Rounds 76-79 */
+      E1 = _mm_sha1nexte_epu32(E1, MSG3);
+      E0 = abcd;
+      abcd = _mm_sha1rnds4_epu32(abcd, E1, 3);
+
+      /* Combine state */
+      E0 = _mm_sha1nexte_epu32(E0, E0Save);
+      abcd = _mm_add_epi32(abcd, abcdSave);
+
+      Data += 64;
+   }
+
+   abcd = _mm_shuffle_epi32(abcd, 0x1B);
+   _mm_storeu_si128((__m128i *)State, abcd);
+   State[4] = _mm_extract_epi32(E0, 3);
+}
+#endif
+
+/* Hash consecutive 512-bit blocks, using the SHA extensions when available. */
+static VOID SHATransformBlocks(ULONG State[5], UCHAR *Data, ULONG NumberOfBlocks)
+{
+   UCHAR Block[64];
+
+#if defined(_M_IX86) || defined(_M_X64)
+   if (A_SHAExtensionsPresent())
+   {
+      SHATransformShaNi(State, Data, NumberOfBlocks);
+      return;
+   }
+#endif
+
+   while (NumberOfBlocks--)
+   {
+      /* SHATransform byte-swaps the block in place. */
+      RtlCopyMemory(Block, Data, 64);
+      SHATransform(State, Block);
+      Data += 64;
+   }
+}
+
+/* Checks whether the processor supports the SHA extensions (and the SSSE3/SSE4.1
+   instructions used alongside them). The result is shared with the SHA-256 code. */
+BOOLEAN A_SHAExtensionsPresent(
+    VOID
+    )
+{
+   static PH_INITONCE InitOnce = PH_INITONCE_INIT;
+   static BOOLEAN Present = FALSE;
+
+   if (PhBeginInitOnce(&InitOnce))
+   {
+#if defined(_M_IX86) || defined(_M_X64)
+      INT CpuInfo[4];
+
+      __cpuid(CpuInfo, 0);
+
+      if (CpuInfo[0] >= 7)
+      {
+         BOOLEAN Sse;
+
+         __cpuid(CpuInfo, 1);
+         Sse = (CpuInfo[2] & (1 << 9)) && (CpuInfo[2] & (1 << 19)); // SSSE3, SSE4.1
+         __cpuidex(CpuInfo, 7, 0);
+         Present = Sse && (CpuInfo[1] & (1 << 29)); // SHA
+      }
+#endif
+
+      PhEndInitOnce(&InitOnce);
+   }
+
+   return Present;
+}
+
 VOID A_SHAInit(
     _Out_ A_SHA_CTX *Context
     )
@@ -123,16 +366,24 @@ VOID A_SHAUpdate(
    }
    else
    {
-      while (InputContentSize + Length >= 64)
+      if (InputContentSize != 0)
       {
          RtlCopyMemory(Context->buffer + InputContentSize, Input,
                        64 - InputContentSize);
          Input += 64 - InputContentSize;
          Length -= 64 - InputContentSize;
-         SHATransform(Context->state, Context->buffer);
-         InputContentSize = 0;
+         SHATransformBlocks(Context->state, Context->buffer, 1);
       }
-      RtlCopyMemory(Context->buffer + InputContentSize, Input, Length);
+
+      /* Hash whole blocks directly from the input. */
+      if (Length >= 64)
+      {
+         SHATransformBlocks(Context->state, Input, Length / 64);
+         Input += Length & ~63;
+         Length &= 63;
+      }
+
+      RtlCopyMemory(Context->buffer, Input, Length);
    }
 }
 
@@ -25,4 +25,8 @@ VOID A_SHAFinal(
     _Out_writes_bytes_(20) UCHAR *Hash
     );
 
+BOOLEAN A_SHAExtensionsPresent(
+    VOID
+    );
+
 #endif
@@ -0,0 +1,1018 @@
+/*
+ * Process Hacker -
+ *   system information trace
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A trace is either recorded or replayed, one tick at a time. A tick belongs to the thread that
+ * began it: while it is active, PhQuerySystemInformation() calls made by that thread are passed
+ * to PhQuerySystemTraceInformation(), and calls made by other threads are not affected.
+ *
+ * The trace keeps the latest block of each information class, since the next block of the class
+ * is encoded against it. When replaying, the blocks of the current tick are kept as well, and a
+ * query is served from the first block of its class that hasn't been served yet in the tick. If
+ * all of them have been served, the last one is served again, and if the tick has no block of
+ * the class, the latest block from an earlier tick is served.
+ */
+
+#include <phbase.h>
+#include <systrace.h>
+
+C_ASSERT(sizeof(PH_SYSTEM_TRACE_FILE_HEADER) == 16);
+C_ASSERT(sizeof(PH_SYSTEM_TRACE_TICK_HEADER) == 16);
+C_ASSERT(sizeof(PH_SYSTEM_TRACE_BLOCK_HEADER) == 16);
+
+// Runs of unchanged bytes shorter than this are stored as part of the surrounding literal,
+// because the varints would take more space than the bytes.
+#define PH_SYSTEM_TRACE_MINIMUM_COPY 4
+
+typedef struct _PH_SYSTEM_TRACE_BLOCK
+{
+    ULONG InformationClass;
+    ULONG Length;
+    PUCHAR Buffer; // image name pointers of processes are stored as offsets
+
+    BOOLEAN Latest; // the latest block of its class
+    BOOLEAN Current; // part of the current tick
+    BOOLEAN Served;
+
+    // Process information only
+    ULONG NumberOfEntries;
+    PULONG EntryOffsets;
+} PH_SYSTEM_TRACE_BLOCK, *PPH_SYSTEM_TRACE_BLOCK;
+
+typedef struct _PH_SYSTEM_TRACE
+{
+    PPH_FILE_STREAM FileStream;
+    ULONG Flags;
+    PPH_LIST Blocks;
+
+    HANDLE TickThreadId; // the thread that is running the current tick, or NULL
+    LARGE_INTEGER TickTime;
+
+    // Recording only
+    PH_BYTES_BUILDER TickBuilder;
+    ULONG NumberOfTickBlocks;
+
+    // Replaying only
+    NTSTATUS EndStatus; // why the trace has ended, or STATUS_SUCCESS
+} PH_SYSTEM_TRACE, *PPH_SYSTEM_TRACE;
+
+typedef struct _PH_SYSTEM_TRACE_PROCESS_KEY
+{
+    HANDLE ProcessId;
+    LONG64 CreateTime;
+    ULONG Index;
+} PH_SYSTEM_TRACE_PROCESS_KEY, *PPH_SYSTEM_TRACE_PROCESS_KEY;
+
+static PPH_SYSTEM_TRACE PhpCurrentSystemTrace = NULL;
+
+static BOOLEAN NTAPI PhpSystemTraceProcessKeyEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PPH_SYSTEM_TRACE_PROCESS_KEY key1 = Entry1;
+    PPH_SYSTEM_TRACE_PROCESS_KEY key2 = Entry2;
+
+    return key1->ProcessId == key2->ProcessId && key1->CreateTime == key2->CreateTime;
+}
+
+static ULONG NTAPI PhpSystemTraceProcessKeyHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PPH_SYSTEM_TRACE_PROCESS_KEY key = Entry;
+
+    return PhHashIntPtr((ULONG_PTR)key->ProcessId) ^ PhHashInt64(key->CreateTime);
+}
+
+static BOOLEAN PhpIsProcessInformationClass(
+    _In_ ULONG InformationClass
+    )
+{
+    return
+        InformationClass == SystemProcessInformation ||
+        InformationClass == SystemExtendedProcessInformation ||
+        InformationClass == SystemFullProcessInformation;
+}
+
+static VOID PhpAppendSystemTraceVarint(
+    _Inout_ PPH_BYTES_BUILDER BytesBuilder,
+    _In_ ULONG Value
+    )
+{
+    UCHAR buffer[5];
+    ULONG length = 0;
+
+    while (Value >= 0x80)
+    {
+        buffer[length++] = (UCHAR)Value | 0x80;
+        Value >>= 7;
+    }
+
+    buffer[length++] = (UCHAR)Value;
+
+    PhAppendBytesBuilderEx(BytesBuilder, buffer, length, 0, NULL);
+}
+
+static BOOLEAN PhpReadSystemTraceVarint(
+    _Inout_ PUCHAR *Position,
+    _In_ PUCHAR End,
+    _Out_ PULONG Value
+    )
+{
+    PUCHAR position = *Position;
+    ULONG value = 0;
+    ULONG shift = 0;
+
+    while (TRUE)
+    {
+        if (position == End || shift > 28)
+            return FALSE;
+
+        value |= (ULONG)(*position & 0x7f) << shift;
+        shift += 7;
+
+        if (!(*position++ & 0x80))
+            break;
+    }
+
+    *Position = position;
+    *Value = value;
+
+    return TRUE;
+}
+
+/**
+ * Encodes data as a delta against reference data.
+ *
+ * \param BytesBuilder A bytes builder which receives the delta.
+ * \param Data The data.
+ * \param Length The length of the data.
+ * \param Reference The reference data. Bytes beyond its end count as zero.
+ * \param ReferenceLength The length of the reference data.
+ */
+static VOID PhpEncodeSystemTraceDelta(
+    _Inout_ PPH_BYTES_BUILDER BytesBuilder,
+    _In_reads_bytes_(Length) PUCHAR Data,
+    _In_ ULONG Length,
+    _In_reads_bytes_opt_(ReferenceLength) PUCHAR Reference,
+    _In_ ULONG ReferenceLength
+    )
+{
+#define REFERENCE_BYTE(Index) ((Index) < ReferenceLength ? Reference[Index] : 0)
+
+    ULONG i = 0;
+
+    while (i < Length)
+    {
+        ULONG start;
+        ULONG copyLength;
+        ULONG sameLength;
+
+        start = i;
+
+        while (i < Length && Data[i] == REFERENCE_BYTE(i))
+            i++;
+
+        copyLength = i - start;
+        start = i;
+        sameLength = 0;
+
+        // The literal ends at the next run of unchanged bytes that is long enough.
+        while (i < Length)
+        {
+            if (Data[i] == REFERENCE_BYTE(i))
+            {
+                if (++sameLength == PH_SYSTEM_TRACE_MINIMUM_COPY)
+                {
+                    i -= PH_SYSTEM_TRACE_MINIMUM_COPY - 1;
+                    break;
+                }
+            }
+            else
+            {
+                sameLength = 0;
+            }
+
+            i++;
+        }
+
+        PhpAppendSystemTraceVarint(BytesBuilder, copyLength);
+        PhpAppendSystemTraceVarint(BytesBuilder, i - start);
+        PhAppendBytesBuilderEx(BytesBuilder, Data + start, i - start, 0, NULL);
+    }
+
+#undef REFERENCE_BYTE
+}
+
+static BOOLEAN PhpDecodeSystemTraceDelta(
+    _Inout_ PUCHAR *Position,
+    _In_ PUCHAR End,
+    _Out_writes_bytes_(Length) PUCHAR Data,
+    _In_ ULONG Length,
+    _In_reads_bytes_opt_(ReferenceLength) PUCHAR Reference,
+    _In_ ULONG ReferenceLength
+    )
+{
+    ULONG i = 0;
+
+    while (i < Length)
+    {
+        ULONG copyLength;
+        ULONG literalLength;
+
+        if (!PhpReadSystemTraceVarint(Position, End, &copyLength))
+            return FALSE;
+        if (!PhpReadSystemTraceVarint(Position, End, &literalLength))
+            return FALSE;
+        if (copyLength > Length - i)
+            return FALSE;
+
+        if (i < ReferenceLength)
+        {
+            ULONG referenceCopyLength = min(copyLength, ReferenceLength - i);
+
+            memcpy(Data + i, Reference + i, referenceCopyLength);
+            memset(Data + i + referenceCopyLength, 0, copyLength - referenceCopyLength);
+        }
+        else
+        {
+            memset(Data + i, 0, copyLength);
+        }
+
+        i += copyLength;
+
+        if (literalLength > Length - i || literalLength > (ULONG_PTR)(End - *Position))
+            return FALSE;
+
+        memcpy(Data + i, *Position, literalLength);
+        *Position += literalLength;
+        i += literalLength;
+    }
+
+    return TRUE;
+}
+
+static PPH_SYSTEM_TRACE_BLOCK PhpCreateSystemTraceBlock(
+    _In_ ULONG InformationClass,
+    _In_ ULONG Length
+    )
+{
+    PPH_SYSTEM_TRACE_BLOCK block;
+
+    block = PhAllocateZero(sizeof(PH_SYSTEM_TRACE_BLOCK));
+    block->InformationClass = InformationClass;
+    block->Length = Length;
+    block->Buffer = PhAllocate(max(Length, 1));
+
+    return block;
+}
+
+static VOID PhpDestroySystemTraceBlock(
+    _In_ _Post_invalid_ PPH_SYSTEM_TRACE_BLOCK Block
+    )
+{
+    if (Block->EntryOffsets)
+        PhFree(Block->EntryOffsets);
+
+    PhFree(Block->Buffer);
+    PhFree(Block);
+}
+
+static ULONG PhpGetSystemTraceEntryLength(
+    _In_ PPH_SYSTEM_TRACE_BLOCK Block,
+    _In_ ULONG Index
+    )
+{
+    if (Index + 1 < Block->NumberOfEntries)
+        return Block->EntryOffsets[Index + 1] - Block->EntryOffsets[Index];
+    else
+        return Block->Length - Block->EntryOffsets[Index];
+}
+
+/**
+ * Finds the entries of the processes in a block of process information.
+ *
+ * \return FALSE if the entries are invalid.
+ */
+static BOOLEAN PhpSplitSystemTraceBlock(
+    _Inout_ PPH_SYSTEM_TRACE_BLOCK Block
+    )
+{
+    ULONG offset;
+    ULONG nextEntryOffset;
+    ULONG allocatedCount;
+
+    Block->NumberOfEntries = 0;
+    allocatedCount = 64;
+    Block->EntryOffsets = PhAllocate(sizeof(ULONG) * allocatedCount);
+    offset = 0;
+
+    if (Block->Length == 0)
+        return TRUE;
+
+    while (TRUE)
+    {
+        if (Block->Length - offset < UFIELD_OFFSET(SYSTEM_PROCESS_INFORMATION, Threads))
+            return FALSE;
+
+        if (Block->NumberOfEntries == allocatedCount)
+        {
+            allocatedCount *= 2;
+            Block->EntryOffsets = PhReAllocate(Block->EntryOffsets, sizeof(ULONG) * allocatedCount);
+        }
+
+        Block->EntryOffsets[Block->NumberOfEntries++] = offset;
+        nextEntryOffset = ((PSYSTEM_PROCESS_INFORMATION)(Block->Buffer + offset))->NextEntryOffset;
+
+        if (nextEntryOffset == 0)
+            break;
+        if (nextEntryOffset < UFIELD_OFFSET(SYSTEM_PROCESS_INFORMATION, Threads) || nextEntryOffset > Block->Length - offset)
+            return FALSE;
+        if (nextEntryOffset & (sizeof(ULONG_PTR) - 1))
+            return FALSE;
+
+        offset += nextEntryOffset;
+    }
+
+    return TRUE;
+}
+
+static PPH_SYSTEM_TRACE_BLOCK PhpFindLatestSystemTraceBlock(
+    _In_ PPH_SYSTEM_TRACE Trace,
+    _In_ ULONG InformationClass
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < Trace->Blocks->Count; i++)
+    {
+        PPH_SYSTEM_TRACE_BLOCK block = Trace->Blocks->Items[i];
+
+        if (block->Latest && block->InformationClass == InformationClass)
+            return block;
+    }
+
+    return NULL;
+}
+
+/**
+ * Makes a block the latest block of its class.
+ */
+static VOID PhpAddSystemTraceBlock(
+    _Inout_ PPH_SYSTEM_TRACE Trace,
+    _In_ PPH_SYSTEM_TRACE_BLOCK Block
+    )
+{
+    PPH_SYSTEM_TRACE_BLOCK previousBlock;
+
+    if (previousBlock = PhpFindLatestSystemTraceBlock(Trace, Block->InformationClass))
+    {
+        previousBlock->Latest = FALSE;
+
+        // Blocks of the current tick can still be served.
+        if (!previousBlock->Current)
+        {
+            PhRemoveItemList(Trace->Blocks, PhFindItemList(Trace->Blocks, previousBlock));
+            PhpDestroySystemTraceBlock(previousBlock);
+        }
+    }
+
+    Block->Latest = TRUE;
+    PhAddItemList(Trace->Blocks, Block);
+}
+
+static VOID PhpRecordSystemTraceBlock(
+    _Inout_ PPH_SYSTEM_TRACE Trace,
+    _In_ ULONG InformationClass,
+    _In_reads_bytes_(Length) PVOID Information,
+    _In_ ULONG Length
+    )
+{
+    PPH_SYSTEM_TRACE_BLOCK block;
+    PPH_SYSTEM_TRACE_BLOCK referenceBlock;
+    PH_SYSTEM_TRACE_BLOCK_HEADER blockHeader;
+    SIZE_T headerOffset;
+    ULONG i;
+
+    block = PhpCreateSystemTraceBlock(InformationClass, Length);
+    memcpy(block->Buffer, Information, Length);
+
+    if (PhpIsProcessInformationClass(InformationClass) && !PhpSplitSystemTraceBlock(block))
+    {
+        PhpDestroySystemTraceBlock(block);
+        return;
+    }
+
+    referenceBlock = PhpFindLatestSystemTraceBlock(Trace, InformationClass);
+
+    memset(&blockHeader, 0, sizeof(PH_SYSTEM_TRACE_BLOCK_HEADER));
+    blockHeader.InformationClass = InformationClass;
+    blockHeader.Length = Length;
+    PhAppendBytesBuilderEx(&Trace->TickBuilder, &blockHeader, sizeof(PH_SYSTEM_TRACE_BLOCK_HEADER), 0, &headerOffset);
+
+    if (block->EntryOffsets)
+    {
+        PPH_HASHTABLE hashtable = NULL;
+        PH_SYSTEM_TRACE_PROCESS_KEY key;
+        PPH_SYSTEM_TRACE_PROCESS_KEY referenceKey;
+
+        if (referenceBlock)
+        {
+            hashtable = PhCreateHashtable(
+                sizeof(PH_SYSTEM_TRACE_PROCESS_KEY),
+                PhpSystemTraceProcessKeyEqualFunction,
+                PhpSystemTraceProcessKeyHashFunction,
+                referenceBlock->NumberOfEntries
+                );
+
+            for (i = 0; i < referenceBlock->NumberOfEntries; i++)
+            {
+                PSYSTEM_PROCESS_INFORMATION process = (PSYSTEM_PROCESS_INFORMATION)(referenceBlock->Buffer + referenceBlock->EntryOffsets[i]);
+
+                key.ProcessId = process->UniqueProcessId;
+                key.CreateTime = process->CreateTime.QuadPart;
+                key.Index = i;
+                PhAddEntryHashtable(hashtable, &key);
+            }
+        }
+
+        for (i = 0; i < block->NumberOfEntries; i++)
+        {
+            PSYSTEM_PROCESS_INFORMATION process = (PSYSTEM_PROCESS_INFORMATION)(block->Buffer + block->EntryOffsets[i]);
+            ULONG entryLength = PhpGetSystemTraceEntryLength(block, i);
+            ULONG_PTR imageNameOffset;
+
+            // Make the image name pointer independent of the address of the buffer.
+            imageNameOffset = (ULONG_PTR)process->ImageName.Buffer - ((ULONG_PTR)Information + block->EntryOffsets[i]);
+
+            if (process->ImageName.Buffer && imageNameOffset < entryLength)
+                process->ImageName.Buffer = (PWCH)imageNameOffset;
+            else
+                process->ImageName.Buffer = NULL;
+
+            referenceKey = NULL;
+
+            if (hashtable)
+            {
+                key.ProcessId = process->UniqueProcessId;
+                key.CreateTime = process->CreateTime.QuadPart;
+                referenceKey = PhFindEntryHashtable(hashtable, &key);
+            }
+
+            if (referenceKey)
+            {
+                PhpAppendSystemTraceVarint(&Trace->TickBuilder, referenceKey->Index + 1);
+                PhpAppendSystemTraceVarint(&Trace->TickBuilder, entryLength);
+                PhpEncodeSystemTraceDelta(
+                    &Trace->TickBuilder,
+                    (PUCHAR)process,
+                    entryLength,
+                    referenceBlock->Buffer + referenceBlock->EntryOffsets[referenceKey->Index],
+                    PhpGetSystemTraceEntryLength(referenceBlock, referenceKey->Index)
+                    );
+            }
+            else
+            {
+                PhpAppendSystemTraceVarint(&Trace->TickBuilder, 0);
+                PhpAppendSystemTraceVarint(&Trace->TickBuilder, entryLength);
+                PhpEncodeSystemTraceDelta(&Trace->TickBuilder, (PUCHAR)process, entryLength, NULL, 0);
+            }
+        }
+
+        if (hashtable)
+            PhDereferenceObject(hashtable);
+    }
+    else
+    {
+        PhpEncodeSystemTraceDelta(
+            &Trace->TickBuilder,
+            block->Buffer,
+            Length,
+            referenceBlock ? referenceBlock->Buffer : NULL,
+            referenceBlock ? referenceBlock->Length : 0
+            );
+    }
+
+    // Block headers aren't aligned.
+    blockHeader.EncodedLength = (ULONG)(Trace->TickBuilder.Bytes->Length - headerOffset - sizeof(PH_SYSTEM_TRACE_BLOCK_HEADER));
+    memcpy(Trace->TickBuilder.Bytes->Buffer + headerOffset, &blockHeader, sizeof(PH_SYSTEM_TRACE_BLOCK_HEADER));
+
+    PhpAddSystemTraceBlock(Trace, block);
+    Trace->NumberOfTickBlocks++;
+}
+
+static PPH_SYSTEM_TRACE_BLOCK PhpDecodeSystemTraceBlock(
+    _Inout_ PPH_SYSTEM_TRACE Trace,
+    _In_ PPH_SYSTEM_TRACE_BLOCK_HEADER BlockHeader,
+    _In_ PUCHAR Position,
+    _In_ PUCHAR End
+    )
+{
+    PPH_SYSTEM_TRACE_BLOCK block;
+    PPH_SYSTEM_TRACE_BLOCK referenceBlock;
+
+    if (BlockHeader->Length > PH_SYSTEM_TRACE_MAXIMUM_BLOCK_LENGTH)
+        return NULL;
+
+    block = PhpCreateSystemTraceBlock(BlockHeader->InformationClass, BlockHeader->Length);
+    referenceBlock = PhpFindLatestSystemTraceBlock(Trace, BlockHeader->InformationClass);
+
+    if (PhpIsProcessInformationClass(BlockHeader->InformationClass))
+    {
+        ULONG threadSize;
+        ULONG offset = 0;
+        ULONG index;
+        ULONG entryLength;
+        PUCHAR reference;
+        ULONG referenceLength;
+        ULONG i;
+
+        while (offset < block->Length)
+        {
+            if (!PhpReadSystemTraceVarint(&Position, End, &index))
+                goto ErrorExit;
+            if (!PhpReadSystemTraceVarint(&Position, End, &entryLength))
+                goto ErrorExit;
+            if (entryLength > block->Length - offset)
+                goto ErrorExit;
+
+            reference = NULL;
+            referenceLength = 0;
+
+            if (index != 0)
+            {
+                if (!referenceBlock || !referenceBlock->EntryOffsets || index > referenceBlock->NumberOfEntries)
+                    goto ErrorExit;
+
+                reference = referenceBlock->Buffer + referenceBlock->EntryOffsets[index - 1];
+                referenceLength = PhpGetSystemTraceEntryLength(referenceBlock, index - 1);
+            }
+
+            if (!PhpDecodeSystemTraceDelta(&Position, End, block->Buffer + offset, entryLength, reference, referenceLength))
+                goto ErrorExit;
+
+            offset += entryLength;
+        }
+
+        // Check that the entries are linked correctly and that the image names and threads are
+        // inside the entries, since the information is passed to code that trusts it.
+
+        if (BlockHeader->InformationClass == SystemProcessInformation)
+            threadSize = sizeof(SYSTEM_THREAD_INFORMATION);
+        else
+            threadSize = sizeof(SYSTEM_EXTENDED_THREAD_INFORMATION);
+
+        if (!PhpSplitSystemTraceBlock(block))
+            goto ErrorExit;
+
+        for (i = 0; i < block->NumberOfEntries; i++)
+        {
+            PSYSTEM_PROCESS_INFORMATION process = (PSYSTEM_PROCESS_INFORMATION)(block->Buffer + block->EntryOffsets[i]);
+            ULONG_PTR imageNameOffset = (ULONG_PTR)process->ImageName.Buffer;
+
+            entryLength = PhpGetSystemTraceEntryLength(block, i);
+
+            if (imageNameOffset == 0 && process->ImageName.Length != 0)
+                goto ErrorExit;
+            if (imageNameOffset > entryLength || process->ImageName.Length > entryLength - imageNameOffset)
+                goto ErrorExit;
+            if (process->NumberOfThreads > (entryLength - UFIELD_OFFSET(SYSTEM_PROCESS_INFORMATION, Threads)) / threadSize)
+                goto ErrorExit;
+        }
+    }
+    else
+    {
+        if (!PhpDecodeSystemTraceDelta(
+            &Position,
+            End,
+            block->Buffer,
+            block->Length,
+            referenceBlock ? referenceBlock->Buffer : NULL,
+            referenceBlock ? referenceBlock->Length : 0
+            ))
+            goto ErrorExit;
+    }
+
+    if (Position != End)
+        goto ErrorExit;
+
+    return block;
+
+ErrorExit:
+    PhpDestroySystemTraceBlock(block);
+    return NULL;
+}
+
+static NTSTATUS PhpReadSystemTraceTick(
+    _Inout_ PPH_SYSTEM_TRACE Trace
+    )
+{
+    NTSTATUS status;
+    PH_SYSTEM_TRACE_TICK_HEADER tickHeader;
+    ULONG readLength;
+    ULONG tickLength;
+    PUCHAR buffer;
+    PUCHAR position;
+    PUCHAR end;
+    ULONG i;
+
+    status = PhReadFileStream(Trace->FileStream, &tickHeader, sizeof(PH_SYSTEM_TRACE_TICK_HEADER), &readLength);
+
+    // A tick that was only partially written, for example because the program was terminated
+    // while recording, ends the trace.
+
+    if (status == STATUS_END_OF_FILE || (NT_SUCCESS(status) && readLength != sizeof(PH_SYSTEM_TRACE_TICK_HEADER)))
+        return STATUS_NO_MORE_ENTRIES;
+    if (!NT_SUCCESS(status))
+        return status;
+    if (tickHeader.Length < sizeof(PH_SYSTEM_TRACE_TICK_HEADER) || tickHeader.Length > PH_SYSTEM_TRACE_MAXIMUM_TICK_LENGTH)
+        return STATUS_FILE_CORRUPT_ERROR;
+
+    tickLength = tickHeader.Length - sizeof(PH_SYSTEM_TRACE_TICK_HEADER);
+    buffer = PhAllocateSafe(max(tickLength, 1));
+
+    if (!buffer)
+        return STATUS_NO_MEMORY;
+
+    status = PhReadFileStream(Trace->FileStream, buffer, tickLength, &readLength);
+
+    if (status == STATUS_END_OF_FILE || (NT_SUCCESS(status) && readLength != tickLength))
+        status = STATUS_NO_MORE_ENTRIES;
+
+    if (NT_SUCCESS(status))
+    {
+        position = buffer;
+        end = buffer + tickLength;
+        Trace->TickTime.QuadPart = tickHeader.Time;
+
+        for (i = 0; i < tickHeader.NumberOfBlocks; i++)
+        {
+            PH_SYSTEM_TRACE_BLOCK_HEADER blockHeader;
+            PPH_SYSTEM_TRACE_BLOCK block;
+
+            if ((ULONG_PTR)(end - position) < sizeof(PH_SYSTEM_TRACE_BLOCK_HEADER))
+            {
+                status = STATUS_FILE_CORRUPT_ERROR;
+                break;
+            }
+
+            memcpy(&blockHeader, position, sizeof(PH_SYSTEM_TRACE_BLOCK_HEADER));
+            position += sizeof(PH_SYSTEM_TRACE_BLOCK_HEADER);
+
+            if (blockHeader.EncodedLength > (ULONG_PTR)(end - position) ||
+                !(block = PhpDecodeSystemTraceBlock(Trace, &blockHeader, position, position + blockHeader.EncodedLength)))
+            {
+                status = STATUS_FILE_CORRUPT_ERROR;
+                break;
+            }
+
+            position += blockHeader.EncodedLength;
+            block->Current = TRUE;
+            PhpAddSystemTraceBlock(Trace, block);
+        }
+    }
+
+    PhFree(buffer);
+
+    return status;
+}
+
+/**
+ * Creates a system information trace.
+ *
+ * \param Trace A variable which receives the trace.
+ * \param FileName The file name of the trace.
+ * \param Flags A combination of flags.
+ * \li \c PH_SYSTEM_TRACE_REPLAY Replay an existing trace. Otherwise, a new trace is recorded.
+ *
+ * \retval STATUS_FILE_CORRUPT_ERROR The file is not a trace.
+ * \retval STATUS_REVISION_MISMATCH The trace was recorded by a different version, or on a system
+ * with a different pointer size or number of processors.
+ */
+NTSTATUS PhCreateSystemTrace(
+    _Out_ PPH_SYSTEM_TRACE *Trace,
+    _In_ PWSTR FileName,
+    _In_ ULONG Flags
+    )
+{
+    NTSTATUS status;
+    PPH_SYSTEM_TRACE trace;
+    PH_SYSTEM_TRACE_FILE_HEADER fileHeader;
+    ULONG readLength;
+
+    trace = PhAllocateZero(sizeof(PH_SYSTEM_TRACE));
+    trace->Flags = Flags;
+    trace->Blocks = PhCreateList(16);
+
+    if (Flags & PH_SYSTEM_TRACE_REPLAY)
+    {
+        status = PhCreateFileStream(
+            &trace->FileStream,
+            FileName,
+            FILE_GENERIC_READ,
+            FILE_SHARE_READ,
+            FILE_OPEN,
+            0
+            );
+
+        if (NT_SUCCESS(status))
+            status = PhReadFileStream(trace->FileStream, &fileHeader, sizeof(PH_SYSTEM_TRACE_FILE_HEADER), &readLength);
+
+        if (NT_SUCCESS(status))
+        {
+            if (readLength != sizeof(PH_SYSTEM_TRACE_FILE_HEADER) || fileHeader.Magic != PH_SYSTEM_TRACE_MAGIC)
+            {
+                status = STATUS_FILE_CORRUPT_ERROR;
+            }
+            else if (
+                fileHeader.Version != PH_SYSTEM_TRACE_VERSION ||
+                fileHeader.PointerSize != sizeof(PVOID) ||
+                fileHeader.NumberOfProcessors != (ULONG)PhSystemBasicInformation.NumberOfProcessors
+                )
+            {
+                status = STATUS_REVISION_MISMATCH;
+            }
+        }
+        else if (status == STATUS_END_OF_FILE)
+        {
+            status = STATUS_FILE_CORRUPT_ERROR;
+        }
+    }
+    else
+    {
+        status = PhCreateFileStream(
+            &trace->FileStream,
+            FileName,
+            FILE_GENERIC_WRITE,
+            FILE_SHARE_READ,
+            FILE_OVERWRITE_IF,
+            0
+            );
+
+        if (NT_SUCCESS(status))
+        {
+            fileHeader.Magic = PH_SYSTEM_TRACE_MAGIC;
+            fileHeader.Version = PH_SYSTEM_TRACE_VERSION;
+            fileHeader.PointerSize = sizeof(PVOID);
+            fileHeader.NumberOfProcessors = PhSystemBasicInformation.NumberOfProcessors;
+
+            status = PhWriteFileStream(trace->FileStream, &fileHeader, sizeof(PH_SYSTEM_TRACE_FILE_HEADER));
+        }
+
+        PhInitializeBytesBuilder(&trace->TickBuilder, 0x10000);
+    }
+
+    if (!NT_SUCCESS(status))
+    {
+        PhDestroySystemTrace(trace);
+        return status;
+    }
+
+    *Trace = trace;
+
+    return status;
+}
+
+/**
+ * Closes a system information trace.
+ *
+ * \param Trace The trace. If a tick is being recorded, it is not written.
+ */
+VOID PhDestroySystemTrace(
+    _In_ _Post_invalid_ PPH_SYSTEM_TRACE Trace
+    )
+{
+    ULONG i;
+
+    if (PhpCurrentSystemTrace == Trace)
+        PhpCurrentSystemTrace = NULL;
+
+    for (i = 0; i < Trace->Blocks->Count; i++)
+        PhpDestroySystemTraceBlock(Trace->Blocks->Items[i]);
+
+    PhDereferenceObject(Trace->Blocks);
+
+    if (!(Trace->Flags & PH_SYSTEM_TRACE_REPLAY))
+        PhDeleteBytesBuilder(&Trace->TickBuilder);
+
+    if (Trace->FileStream)
+        PhDereferenceObject(Trace->FileStream);
+
+    PhFree(Trace);
+}
+
+/**
+ * Begins a tick on the current thread. Only one tick can be active at a time.
+ *
+ * \param Trace The trace.
+ *
+ * \retval STATUS_NO_MORE_ENTRIES The end of a replayed trace has been reached. The tick is still
+ * active, and it serves the latest information from the trace. The same applies to other errors
+ * that end the trace, such as STATUS_FILE_CORRUPT_ERROR.
+ */
+NTSTATUS PhBeginSystemTraceTick(
+    _Inout_ PPH_SYSTEM_TRACE Trace
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    ULONG i;
+
+    assert(!PhpCurrentSystemTrace);
+
+    if (Trace->Flags & PH_SYSTEM_TRACE_REPLAY)
+    {
+        // Keep only the latest blocks, which the blocks of the new tick are decoded against.
+        for (i = 0; i < Trace->Blocks->Count; i++)
+        {
+            PPH_SYSTEM_TRACE_BLOCK block = Trace->Blocks->Items[i];
+
+            if (block->Latest)
+            {
+                block->Current = FALSE;
+                block->Served = FALSE;
+            }
+            else
+            {
+                PhRemoveItemList(Trace->Blocks, i--);
+                PhpDestroySystemTraceBlock(block);
+            }
+        }
+
+        // Once a tick can't be read, the ticks that follow it can't be decoded either.
+        if (NT_SUCCESS(Trace->EndStatus))
+            Trace->EndStatus = PhpReadSystemTraceTick(Trace);
+
+        status = Trace->EndStatus;
+    }
+    else
+    {
+        PH_SYSTEM_TRACE_TICK_HEADER tickHeader;
+
+        PhQuerySystemTime(&Trace->TickTime);
+        Trace->NumberOfTickBlocks = 0;
+
+        Trace->TickBuilder.Bytes->Length = 0;
+        memset(&tickHeader, 0, sizeof(PH_SYSTEM_TRACE_TICK_HEADER));
+        PhAppendBytesBuilderEx(&Trace->TickBuilder, &tickHeader, sizeof(PH_SYSTEM_TRACE_TICK_HEADER), 0, NULL);
+    }
+
+    Trace->TickThreadId = NtCurrentThreadId();
+    PhpCurrentSystemTrace = Trace;
+
+    return status;
+}
+
+/**
+ * Ends the current tick. If the trace is being recorded, the tick is written to the file.
+ *
+ * \param Trace The trace.
+ */
+NTSTATUS PhEndSystemTraceTick(
+    _Inout_ PPH_SYSTEM_TRACE Trace
+    )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+
+    assert(PhpCurrentSystemTrace == Trace && Trace->TickThreadId == NtCurrentThreadId());
+
+    PhpCurrentSystemTrace = NULL;
+    Trace->TickThreadId = NULL;
+
+    if (!(Trace->Flags & PH_SYSTEM_TRACE_REPLAY) && Trace->NumberOfTickBlocks != 0)
+    {
+        PPH_SYSTEM_TRACE_TICK_HEADER tickHeader;
+
+        tickHeader = (PPH_SYSTEM_TRACE_TICK_HEADER)Trace->TickBuilder.Bytes->Buffer;
+        tickHeader->Length = (ULONG)Trace->TickBuilder.Bytes->Length;
+        tickHeader->NumberOfBlocks = Trace->NumberOfTickBlocks;
+        tickHeader->Time = Trace->TickTime.QuadPart;
+
+        status = PhWriteFileStream(Trace->FileStream, Trace->TickBuilder.Bytes->Buffer, (ULONG)Trace->TickBuilder.Bytes->Length);
+
+        // Keep the file complete in case the program exits without closing the trace.
+        if (NT_SUCCESS(status))
+            status = PhFlushFileStream(Trace->FileStream, FALSE);
+    }
+
+    return status;
+}
+
+/**
+ * Gets the trace whose tick is active on the current thread.
+ *
+ * \return The trace, or NULL if there is no active tick on the current thread.
+ */
+PPH_SYSTEM_TRACE PhGetCurrentSystemTrace(
+    VOID
+    )
+{
+    PPH_SYSTEM_TRACE trace = PhpCurrentSystemTrace;
+
+    if (trace && trace->TickThreadId == NtCurrentThreadId())
+        return trace;
+
+    return NULL;
+}
+
+/**
+ * Queries system information through a trace. If the trace is being recorded, the information is
+ * queried from the system and added to the current tick. If the trace is being replayed, the
+ * information is taken from the trace.
+ *
+ * \param Trace The trace.
+ * \param SystemInformationClass The information class.
+ * \param SystemInformation A buffer which receives the information.
+ * \param SystemInformationLength The length of the buffer.
+ * \param ReturnLength A variable which receives the length of the information.
+ *
+ * \retval STATUS_NOT_FOUND The trace does not contain information of the specified class.
+ */
+NTSTATUS PhQuerySystemTraceInformation(
+    _Inout_ PPH_SYSTEM_TRACE Trace,
+    _In_ SYSTEM_INFORMATION_CLASS SystemInformationClass,
+    _Out_writes_bytes_opt_(SystemInformationLength) PVOID SystemInformation,
+    _In_ ULONG SystemInformationLength,
+    _Out_opt_ PULONG ReturnLength
+    )
+{
+    NTSTATUS status;
+    PPH_SYSTEM_TRACE_BLOCK block;
+    ULONG returnLength;
+    ULONG i;
+
+    if (!(Trace->Flags & PH_SYSTEM_TRACE_REPLAY))
+    {
+        returnLength = 0;
+        status = NtQuerySystemInformation(SystemInformationClass, SystemInformation, SystemInformationLength, &returnLength);
+
+        if (NT_SUCCESS(status) && SystemInformation)
+        {
+            PhpRecordSystemTraceBlock(
+                Trace,
+                SystemInformationClass,
+                SystemInformation,
+                returnLength != 0 && returnLength <= SystemInformationLength ? returnLength : SystemInformationLength
+                );
+        }
+
+        if (ReturnLength)
+            *ReturnLength = returnLength;
+
+        return status;
+    }
+
+    block = NULL;
+
+    for (i = 0; i < Trace->Blocks->Count; i++)
+    {
+        PPH_SYSTEM_TRACE_BLOCK currentBlock = Trace->Blocks->Items[i];
+
+        if (currentBlock->Current && currentBlock->InformationClass == (ULONG)SystemInformationClass)
+        {
+            block = currentBlock;
+
+            if (!block->Served)
+                break;
+        }
+    }
+
+    if (!block && !(block = PhpFindLatestSystemTraceBlock(Trace, SystemInformationClass)))
+        return STATUS_NOT_FOUND;
+
+    if (ReturnLength)
+        *ReturnLength = block->Length;
+
+    if (!SystemInformation || SystemInformationLength < block->Length)
+        return STATUS_INFO_LENGTH_MISMATCH;
+
+    memcpy(SystemInformation, block->Buffer, block->Length);
+    block->Served = TRUE;
+
+    for (i = 0; i < block->NumberOfEntries; i++)
+    {
+        PSYSTEM_PROCESS_INFORMATION process = PTR_ADD_OFFSET(SystemInformation, block->EntryOffsets[i]);
+
+        if (process->ImageName.Buffer)
+            process->ImageName.Buffer = PTR_ADD_OFFSET(process, process->ImageName.Buffer);
+    }
+
+    return STATUS_SUCCESS;
+}
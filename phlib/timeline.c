@@ -0,0 +1,327 @@
+/*
+ * Process Hacker -
+ *   timeline index
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <phbase.h>
+#include <timeline.h>
+
+typedef struct _PH_TIMELINE_KEY
+{
+    ULONG_PTR Key;
+    ULONG Count;
+    ULONG AllocatedCount;
+    PPH_TIMELINE_ENTRY Entries;
+} PH_TIMELINE_KEY, *PPH_TIMELINE_KEY;
+
+static BOOLEAN NTAPI PhpTimelineKeyEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    return ((PPH_TIMELINE_KEY)Entry1)->Key == ((PPH_TIMELINE_KEY)Entry2)->Key;
+}
+
+static ULONG NTAPI PhpTimelineKeyHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    return PhHashIntPtr(((PPH_TIMELINE_KEY)Entry)->Key);
+}
+
+/**
+ * Finds the first entry of a key that is later than a time.
+ */
+static ULONG PhpSearchTimelineKey(
+    _In_ PPH_TIMELINE_KEY Key,
+    _In_ LONG64 Time
+    )
+{
+    ULONG low;
+    ULONG high;
+    ULONG i;
+
+    low = 0;
+    high = Key->Count;
+
+    while (low < high)
+    {
+        i = low + (high - low) / 2;
+
+        if (Key->Entries[i].Time <= Time)
+            low = i + 1;
+        else
+            high = i;
+    }
+
+    return low;
+}
+
+/**
+ * Initializes a timeline.
+ *
+ * \param Timeline A timeline.
+ */
+VOID PhInitializeTimeline(
+    _Out_ PPH_TIMELINE Timeline
+    )
+{
+    Timeline->Hashtable = PhCreateHashtable(
+        sizeof(PH_TIMELINE_KEY),
+        PhpTimelineKeyEqualFunction,
+        PhpTimelineKeyHashFunction,
+        64
+        );
+    Timeline->Count = 0;
+}
+
+/**
+ * Frees resources used by a timeline.
+ *
+ * \param Timeline A timeline.
+ */
+VOID PhDeleteTimeline(
+    _Inout_ PPH_TIMELINE Timeline
+    )
+{
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PPH_TIMELINE_KEY key;
+
+    PhBeginEnumHashtable(Timeline->Hashtable, &enumContext);
+
+    while (key = PhNextEnumHashtable(&enumContext))
+        PhFree(key->Entries);
+
+    PhDereferenceObject(Timeline->Hashtable);
+}
+
+/**
+ * Adds an entry to a timeline.
+ *
+ * \param Timeline A timeline.
+ * \param Key The key of the entry.
+ * \param Time The time of the entry. Entries are usually added in order of time, in which case
+ * this operation is O(1).
+ * \param Value The value of the entry.
+ */
+VOID PhAddTimelineEntry(
+    _Inout_ PPH_TIMELINE Timeline,
+    _In_ ULONG_PTR Key,
+    _In_ LONG64 Time,
+    _In_opt_ PVOID Value
+    )
+{
+    PH_TIMELINE_KEY lookupKey;
+    PPH_TIMELINE_KEY key;
+    ULONG index;
+
+    lookupKey.Key = Key;
+
+    if (!(key = PhFindEntryHashtable(Timeline->Hashtable, &lookupKey)))
+    {
+        lookupKey.Count = 0;
+        lookupKey.AllocatedCount = 2;
+        lookupKey.Entries = PhAllocate(sizeof(PH_TIMELINE_ENTRY) * lookupKey.AllocatedCount);
+        key = PhAddEntryHashtableEx(Timeline->Hashtable, &lookupKey, NULL);
+    }
+
+    if (key->Count == key->AllocatedCount)
+    {
+        key->AllocatedCount *= 2;
+        key->Entries = PhReAllocate(key->Entries, sizeof(PH_TIMELINE_ENTRY) * key->AllocatedCount);
+    }
+
+    // Entries with the same time are kept in the order in which they were added.
+    if (key->Count != 0 && key->Entries[key->Count - 1].Time > Time)
+    {
+        index = PhpSearchTimelineKey(key, Time);
+        memmove(&key->Entries[index + 1], &key->Entries[index], sizeof(PH_TIMELINE_ENTRY) * (key->Count - index));
+    }
+    else
+    {
+        index = key->Count;
+    }
+
+    key->Entries[index].Time = Time;
+    key->Entries[index].Value = Value;
+    key->Count++;
+    Timeline->Count++;
+}
+
+/**
+ * Removes an entry from a timeline.
+ *
+ * \param Timeline A timeline.
+ * \param Key The key of the entry.
+ * \param Time The time of the entry.
+ * \param Value The value of the entry.
+ *
+ * \return TRUE if the entry was removed, FALSE if it could not be found.
+ */
+BOOLEAN PhRemoveTimelineEntry(
+    _Inout_ PPH_TIMELINE Timeline,
+    _In_ ULONG_PTR Key,
+    _In_ LONG64 Time,
+    _In_opt_ PVOID Value
+    )
+{
+    PH_TIMELINE_KEY lookupKey;
+    PPH_TIMELINE_KEY key;
+    ULONG index;
+
+    lookupKey.Key = Key;
+
+    if (!(key = PhFindEntryHashtable(Timeline->Hashtable, &lookupKey)))
+        return FALSE;
+
+    index = PhpSearchTimelineKey(key, Time);
+
+    while (TRUE)
+    {
+        if (index == 0 || key->Entries[index - 1].Time != Time)
+            return FALSE;
+
+        index--;
+
+        if (key->Entries[index].Value == Value)
+            break;
+    }
+
+    key->Count--;
+    Timeline->Count--;
+
+    if (key->Count == 0)
+    {
+        PhFree(key->Entries);
+        PhRemoveEntryHashtable(Timeline->Hashtable, &lookupKey);
+    }
+    else
+    {
+        memmove(&key->Entries[index], &key->Entries[index + 1], sizeof(PH_TIMELINE_ENTRY) * (key->Count - index));
+    }
+
+    return TRUE;
+}
+
+/**
+ * Finds the newest entry of a key that is not later than a time.
+ *
+ * \param Timeline A timeline.
+ * \param Key The key of the entry.
+ * \param Time The time.
+ *
+ * \return The entry, or NULL if the key has no entries at or before \a Time. The entry is
+ * valid until the timeline is modified.
+ */
+PPH_TIMELINE_ENTRY PhFindTimelineEntry(
+    _In_ PPH_TIMELINE Timeline,
+    _In_ ULONG_PTR Key,
+    _In_ LONG64 Time
+    )
+{
+    PH_TIMELINE_KEY lookupKey;
+    PPH_TIMELINE_KEY key;
+    ULONG index;
+
+    lookupKey.Key = Key;
+
+    if (!(key = PhFindEntryHashtable(Timeline->Hashtable, &lookupKey)))
+        return NULL;
+
+    index = PhpSearchTimelineKey(key, Time);
+
+    if (index == 0)
+        return NULL;
+
+    return &key->Entries[index - 1];
+}
+
+/**
+ * Inserts an entry into a retention queue.
+ *
+ * \param ListHead The head of the queue.
+ * \param Entry The entry to insert.
+ * \param Time The time at which the entry starts to expire.
+ *
+ * \remarks Entries are usually inserted in order of time, so the queue is searched from the tail.
+ */
+VOID PhInsertRetentionEntry(
+    _Inout_ PLIST_ENTRY ListHead,
+    _Out_ PPH_RETENTION_ENTRY Entry,
+    _In_ LONG64 Time
+    )
+{
+    PLIST_ENTRY listEntry;
+
+    Entry->Time = Time;
+
+    listEntry = ListHead->Blink;
+
+    while (listEntry != ListHead && CONTAINING_RECORD(listEntry, PH_RETENTION_ENTRY, ListEntry)->Time > Time)
+        listEntry = listEntry->Blink;
+
+    // Insert after the newest entry that is not later than Time.
+    InsertHeadList(listEntry, &Entry->ListEntry);
+}
+
+/**
+ * Removes expired entries from a retention queue.
+ *
+ * \param ListHead The head of the queue.
+ * \param Threshold Entries earlier than this time have expired.
+ * \param Callback A callback function which is executed for each expired entry. The entry is
+ * removed from the queue if the callback returns TRUE. The callback must not free the entry.
+ * \param Context A user-defined value to pass to the callback function.
+ *
+ * \return The number of entries that were removed.
+ *
+ * \remarks Expired entries that the callback keeps are skipped, so only the expired entries and
+ * the first unexpired entry are visited.
+ */
+ULONG PhPurgeRetentionQueue(
+    _Inout_ PLIST_ENTRY ListHead,
+    _In_ LONG64 Threshold,
+    _In_ PPH_RETENTION_CALLBACK Callback,
+    _In_opt_ PVOID Context
+    )
+{
+    PLIST_ENTRY listEntry;
+    PPH_RETENTION_ENTRY entry;
+    ULONG count = 0;
+
+    listEntry = ListHead->Flink;
+
+    while (listEntry != ListHead)
+    {
+        entry = CONTAINING_RECORD(listEntry, PH_RETENTION_ENTRY, ListEntry);
+
+        if (entry->Time >= Threshold)
+            break;
+
+        // Get the next entry first, since this one may be removed.
+        listEntry = listEntry->Flink;
+
+        if (Callback(entry, Context))
+        {
+            RemoveEntryList(&entry->ListEntry);
+            count++;
+        }
+    }
+
+    return count;
+}
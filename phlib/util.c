@@ -32,6 +32,7 @@
 #include <lsasup.h>
 #include <mapimg.h>
 #include <wslsup.h>
+#include <workqueue.h>
 
 #include "md5.h"
 #include "sha.h"
@@ -4833,16 +4834,92 @@ CleanupExit:
     return status;
 }
 
+static ULONG PhpCrc32SliceTable[16][256];
+
+static VOID PhpInitializeCrc32SliceTable(
+    VOID
+    )
+{
+    ULONG i;
+    ULONG j;
+
+    // Each table advances the previous one by a zero byte, so table j gives the CRC contribution
+    // of a byte followed by j zero bytes.
+
+    memcpy(PhpCrc32SliceTable[0], PhCrc32Table, sizeof(PhCrc32Table));
+
+    for (i = 0; i < 256; i++)
+    {
+        for (j = 1; j < 16; j++)
+        {
+            ULONG previous = PhpCrc32SliceTable[j - 1][i];
+
+            PhpCrc32SliceTable[j][i] = (previous >> 8) ^ PhCrc32Table[previous & 0xff];
+        }
+    }
+}
+
+/**
+ * Computes the CRC-32 (IEEE 802.3) of a block of data.
+ *
+ * \param Crc The CRC of the preceding data, or 0.
+ * \param Buffer The block of data.
+ * \param Length The number of bytes in the block.
+ *
+ * \remarks Large buffers are processed 16 bytes at a time using slicing-by-16 tables.
+ */
 ULONG PhCrc32(
     _In_ ULONG Crc,
     _In_reads_(Length) PCHAR Buffer,
     _In_ SIZE_T Length
     )
 {
+    static PH_INITONCE initOnce = PH_INITONCE_INIT;
+    PUCHAR buffer = (PUCHAR)Buffer;
+
     Crc ^= 0xffffffff;
 
+    // Short buffers are faster with the byte-at-a-time loop (and don't need the tables).
+    if (Length >= 64)
+    {
+        if (PhBeginInitOnce(&initOnce))
+        {
+            PhpInitializeCrc32SliceTable();
+            PhEndInitOnce(&initOnce);
+        }
+
+        while (Length >= 16)
+        {
+            ULONG one = *(ULONG UNALIGNED *)(buffer + 0) ^ Crc;
+            ULONG two = *(ULONG UNALIGNED *)(buffer + 4);
+            ULONG three = *(ULONG UNALIGNED *)(buffer + 8);
+            ULONG four = *(ULONG UNALIGNED *)(buffer + 12);
+
+            Crc =
+                PhpCrc32SliceTable[0][(four >> 24) & 0xff] ^
+                PhpCrc32SliceTable[1][(four >> 16) & 0xff] ^
+                PhpCrc32SliceTable[2][(four >> 8) & 0xff] ^
+                PhpCrc32SliceTable[3][four & 0xff] ^
+                PhpCrc32SliceTable[4][(three >> 24) & 0xff] ^
+                PhpCrc32SliceTable[5][(three >> 16) & 0xff] ^
+                PhpCrc32SliceTable[6][(three >> 8) & 0xff] ^
+                PhpCrc32SliceTable[7][three & 0xff] ^
+                PhpCrc32SliceTable[8][(two >> 24) & 0xff] ^
+                PhpCrc32SliceTable[9][(two >> 16) & 0xff] ^
+                PhpCrc32SliceTable[10][(two >> 8) & 0xff] ^
+                PhpCrc32SliceTable[11][two & 0xff] ^
+                PhpCrc32SliceTable[12][(one >> 24) & 0xff] ^
+                PhpCrc32SliceTable[13][(one >> 16) & 0xff] ^
+                PhpCrc32SliceTable[14][(one >> 8) & 0xff] ^
+                PhpCrc32SliceTable[15][one & 0xff];
+
+            buffer += 16;
+            Length -= 16;
+        }
+    }
+
     while (Length--)
-        Crc = (Crc >> 8) ^ PhCrc32Table[(Crc ^ *Buffer++) & 0xff];
+        Crc = (Crc >> 8) ^ PhCrc32Table[(Crc ^ *buffer++) & 0xff];
 
     return Crc ^ 0xffffffff;
 }
@@ -4992,6 +5069,357 @@ BOOLEAN PhFinalHash(
     return result;
 }
 
+#define PH_FILE_HASH_VIEW_SIZE (32 * 1024 * 1024) // must be a multiple of the allocation granularity
+#define PH_FILE_HASH_BLOCK_SIZE (64 * 1024)
+
+static VOID PhpUpdateFileHashes(
+    _In_ ULONG Flags,
+    _Inout_ PPH_HASH_CONTEXT Md5Context,
+    _Inout_ PPH_HASH_CONTEXT Sha1Context,
+    _Inout_ PPH_HASH_CONTEXT Sha256Context,
+    _In_reads_bytes_(Length) PVOID Buffer,
+    _In_ SIZE_T Length
+    )
+{
+    PUCHAR buffer = Buffer;
+
+    // Feed every algorithm the same block before moving on so each block is
+    // only brought into the cache once.
+    while (Length)
+    {
+        ULONG blockLength = (ULONG)min(Length, PH_FILE_HASH_BLOCK_SIZE);
+
+        if (Flags & PH_FILE_HASH_MD5)
+            PhUpdateHash(Md5Context, buffer, blockLength);
+        if (Flags & PH_FILE_HASH_SHA1)
+            PhUpdateHash(Sha1Context, buffer, blockLength);
+        if (Flags & PH_FILE_HASH_SHA256)
+            PhUpdateHash(Sha256Context, buffer, blockLength);
+
+        buffer += blockLength;
+        Length -= blockLength;
+    }
+}
+
+/**
+ * Computes one or more hashes of a file in a single pass.
+ *
+ * \param FileHandle A handle to a file. The handle must have FILE_READ_DATA access.
+ * \param Flags A combination of flags:
+ * \li \c PH_FILE_HASH_MD5 Compute the MD5 hash.
+ * \li \c PH_FILE_HASH_SHA1 Compute the SHA-1 hash.
+ * \li \c PH_FILE_HASH_SHA256 Compute the SHA-256 hash.
+ * \param Hashes A variable which receives the hashes.
+ *
+ * \remarks The file is mapped into memory instead of being read, and the position of
+ * the file handle is not changed.
+ */
+NTSTATUS PhHashFile(
+    _In_ HANDLE FileHandle,
+    _In_ ULONG Flags,
+    _Out_ PPH_FILE_HASHES Hashes
+    )
+{
+    NTSTATUS status;
+    LARGE_INTEGER fileSize;
+    HANDLE sectionHandle = NULL;
+    PH_HASH_CONTEXT md5Context;
+    PH_HASH_CONTEXT sha1Context;
+    PH_HASH_CONTEXT sha256Context;
+    LARGE_INTEGER offset;
+
+    if (!(Flags & PH_FILE_HASH_ALL))
+        return STATUS_INVALID_PARAMETER_2;
+
+    if (!NT_SUCCESS(status = PhGetFileSize(FileHandle, &fileSize)))
+        return status;
+
+    PhInitializeHash(&md5Context, Md5HashAlgorithm);
+    PhInitializeHash(&sha1Context, Sha1HashAlgorithm);
+    PhInitializeHash(&sha256Context, Sha256HashAlgorithm);
+
+    // Empty files can't be mapped.
+    if (fileSize.QuadPart != 0)
+    {
+        status = NtCreateSection(
+            &sectionHandle,
+            SECTION_MAP_READ | SECTION_QUERY,
+            NULL,
+            &fileSize,
+            PAGE_READONLY,
+            SEC_COMMIT,
+            FileHandle
+            );
+
+        if (!NT_SUCCESS(status))
+            return status;
+
+        for (offset.QuadPart = 0; offset.QuadPart < fileSize.QuadPart; offset.QuadPart += PH_FILE_HASH_VIEW_SIZE)
+        {
+            PVOID viewBase = NULL;
+            SIZE_T viewSize;
+            LARGE_INTEGER viewOffset;
+
+            viewOffset = offset;
+            viewSize = (SIZE_T)min(fileSize.QuadPart - offset.QuadPart, PH_FILE_HASH_VIEW_SIZE);
+
+            status = NtMapViewOfSection(
+                sectionHandle,
+                NtCurrentProcess(),
+                &viewBase,
+                0,
+                0,
+                &viewOffset,
+                &viewSize,
+                ViewUnmap,
+                0,
+                PAGE_READONLY
+                );
+
+            if (!NT_SUCCESS(status))
+                break;
+
+            __try
+            {
+                PhpUpdateFileHashes(
+                    Flags,
+                    &md5Context,
+                    &sha1Context,
+                    &sha256Context,
+                    viewBase,
+                    (SIZE_T)min(fileSize.QuadPart - offset.QuadPart, PH_FILE_HASH_VIEW_SIZE)
+                    );
+            }
+            __except (GetExceptionCode() == STATUS_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+            {
+                // The file is on a volume which went away or returned an I/O error.
+                status = GetExceptionCode();
+            }
+
+            NtUnmapViewOfSection(NtCurrentProcess(), viewBase);
+
+            if (!NT_SUCCESS(status))
+                break;
+        }
+
+        NtClose(sectionHandle);
+
+        if (!NT_SUCCESS(status))
+            return status;
+    }
+
+    memset(Hashes, 0, sizeof(PH_FILE_HASHES));
+    Hashes->Flags = Flags & PH_FILE_HASH_ALL;
+
+    if (Flags & PH_FILE_HASH_MD5)
+        PhFinalHash(&md5Context, Hashes->Md5, sizeof(Hashes->Md5), NULL);
+    if (Flags & PH_FILE_HASH_SHA1)
+        PhFinalHash(&sha1Context, Hashes->Sha1, sizeof(Hashes->Sha1), NULL);
+    if (Flags & PH_FILE_HASH_SHA256)
+        PhFinalHash(&sha256Context, Hashes->Sha256, sizeof(Hashes->Sha256), NULL);
+
+    return STATUS_SUCCESS;
+}
+
+typedef struct _PH_FILE_HASH_BATCH
+{
+    LONG ReferenceCount;
+    LONG NextIndex;
+    LONG RemainingItems;
+    ULONG NumberOfItems;
+    PPH_FILE_HASH_ITEM Items;
+    PPH_FILE_HASH_LOOKUP_CALLBACK LookupCallback;
+    PVOID Context;
+    PH_EVENT CompletedEvent;
+} PH_FILE_HASH_BATCH, *PPH_FILE_HASH_BATCH;
+
+static VOID PhpHashFileItem(
+    _Inout_ PPH_FILE_HASH_ITEM Item,
+    _In_opt_ PPH_FILE_HASH_LOOKUP_CALLBACK LookupCallback,
+    _In_opt_ PVOID Context
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle;
+    IO_STATUS_BLOCK isb;
+    FILE_INTERNAL_INFORMATION internalInfo;
+    FILE_NETWORK_OPEN_INFORMATION networkOpenInfo;
+    FILE_FS_VOLUME_INFORMATION volumeInfo;
+
+    Item->Cached = FALSE;
+
+    if (!(fileHandle = Item->FileHandle))
+    {
+        status = PhCreateFileWin32(
+            &fileHandle,
+            PhGetString(Item->FileName),
+            FILE_GENERIC_READ,
+            FILE_ATTRIBUTE_NORMAL,
+            FILE_SHARE_READ | FILE_SHARE_DELETE,
+            FILE_OPEN,
+            FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+            );
+
+        if (!NT_SUCCESS(status))
+        {
+            Item->Status = status;
+            return;
+        }
+    }
+
+    // The identity of the file is returned to the caller so results can be cached
+    // across runs. (FileId, LastWriteTime, EndOfFile) changes whenever the content does.
+
+    memset(&volumeInfo, 0, sizeof(FILE_FS_VOLUME_INFORMATION));
+
+    if (NT_SUCCESS(status = NtQueryInformationFile(
+        fileHandle,
+        &isb,
+        &internalInfo,
+        sizeof(FILE_INTERNAL_INFORMATION),
+        FileInternalInformation
+        )))
+    {
+        status = NtQueryInformationFile(
+            fileHandle,
+            &isb,
+            &networkOpenInfo,
+            sizeof(FILE_NETWORK_OPEN_INFORMATION),
+            FileNetworkOpenInformation
+            );
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        // The volume label doesn't fit in the structure; we only need the serial number.
+        status = NtQueryVolumeInformationFile(
+            fileHandle,
+            &isb,
+            &volumeInfo,
+            sizeof(FILE_FS_VOLUME_INFORMATION),
+            FileFsVolumeInformation
+            );
+
+        if (status == STATUS_BUFFER_OVERFLOW)
+            status = STATUS_SUCCESS;
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        Item->VolumeSerialNumber = volumeInfo.VolumeSerialNumber;
+        Item->FileId = internalInfo.IndexNumber;
+        Item->LastWriteTime = networkOpenInfo.LastWriteTime;
+        Item->EndOfFile = networkOpenInfo.EndOfFile;
+
+        if (LookupCallback && LookupCallback(Item, Context) && (Item->Hashes.Flags & Item->Flags) == Item->Flags)
+        {
+            Item->Cached = TRUE;
+        }
+        else
+        {
+            status = PhHashFile(fileHandle, Item->Flags, &Item->Hashes);
+        }
+    }
+
+    if (!Item->FileHandle)
+        NtClose(fileHandle);
+
+    Item->Status = status;
+}
+
+static VOID PhpDereferenceFileHashBatch(
+    _In_ PPH_FILE_HASH_BATCH Batch
+    )
+{
+    if (_InterlockedDecrement(&Batch->ReferenceCount) == 0)
+        PhFree(Batch);
+}
+
+static VOID PhpProcessFileHashBatch(
+    _In_ PPH_FILE_HASH_BATCH Batch
+    )
+{
+    LONG index;
+
+    while ((index = _InterlockedIncrement(&Batch->NextIndex) - 1) < (LONG)Batch->NumberOfItems)
+    {
+        PhpHashFileItem(&Batch->Items[index], Batch->LookupCallback, Batch->Context);
+
+        if (_InterlockedDecrement(&Batch->RemainingItems) == 0)
+            PhSetEvent(&Batch->CompletedEvent);
+    }
+}
+
+static NTSTATUS PhpFileHashWorker(
+    _In_ PVOID Parameter
+    )
+{
+    PPH_FILE_HASH_BATCH batch = Parameter;
+
+    PhpProcessFileHashBatch(batch);
+    PhpDereferenceFileHashBatch(batch);
+
+    return STATUS_SUCCESS;
+}
+
+/**
+ * Computes hashes for multiple files in parallel.
+ *
+ * \param Items An array of items. For each item, \a FileName (or \a FileHandle) and
+ * \a Flags must be set by the caller; the output fields are filled in by this function.
+ * \param NumberOfItems The number of items.
+ * \param LookupCallback A callback function which is executed for each file before it is
+ * hashed. The callback can supply hashes computed previously for the same file.
+ * \param Context A user-defined value to pass to the callback function.
+ *
+ * \remarks The files are hashed on the global work queue with low I/O priority. The
+ * calling thread also participates, so the function makes progress even if the work
+ * queue is busy. The function returns once every item has been processed.
+ */
+VOID PhHashFiles(
+    _Inout_updates_(NumberOfItems) PPH_FILE_HASH_ITEM Items,
+    _In_ ULONG NumberOfItems,
+    _In_opt_ PPH_FILE_HASH_LOOKUP_CALLBACK LookupCallback,
+    _In_opt_ PVOID Context
+    )
+{
+    PPH_FILE_HASH_BATCH batch;
+    PH_WORK_QUEUE_ENVIRONMENT environment;
+    ULONG numberOfWorkers;
+    ULONG i;
+
+    if (NumberOfItems == 0)
+        return;
+
+    batch = PhAllocate(sizeof(PH_FILE_HASH_BATCH));
+    batch->ReferenceCount = 1;
+    batch->NextIndex = 0;
+    batch->RemainingItems = NumberOfItems;
+    batch->NumberOfItems = NumberOfItems;
+    batch->Items = Items;
+    batch->LookupCallback = LookupCallback;
+    batch->Context = Context;
+    PhInitializeEvent(&batch->CompletedEvent);
+
+    // Workers only touch Items while claiming an index below NumberOfItems, so workers
+    // which start late only reference the batch itself.
+    numberOfWorkers = min(NumberOfItems, PhSystemBasicInformation.NumberOfProcessors) - 1;
+
+    PhInitializeWorkQueueEnvironment(&environment);
+    environment.IoPriority = IoPriorityLow;
+
+    for (i = 0; i < numberOfWorkers; i++)
+    {
+        _InterlockedIncrement(&batch->ReferenceCount);
+        PhQueueItemWorkQueueEx(PhGetGlobalWorkQueue(), PhpFileHashWorker, batch, NULL, &environment);
+    }
+
+    PhpProcessFileHashBatch(batch);
+    PhWaitForEvent(&batch->CompletedEvent, NULL);
+
+    PhpDereferenceFileHashBatch(batch);
+}
+
 /**
  * Parses one part of a command line string. Quotation marks and backslashes are handled
  * appropriately.
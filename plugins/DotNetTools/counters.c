@@ -902,3 +902,317 @@ CleanupExit:
 
     return appDomainsList;
 }
+
+// Shared counter sampler
+
+static LIST_ENTRY DotNetProcessListHead = { &DotNetProcessListHead, &DotNetProcessListHead };
+static PH_QUEUED_LOCK DotNetProcessListLock = PH_QUEUED_LOCK_INIT;
+static ULONG DotNetCountersRunCount = 0;
+static PH_CALLBACK_REGISTRATION DotNetCountersProcessesUpdatedRegistration;
+
+VOID CopyPerfIpcBlock(
+    _In_ BOOLEAN Wow64,
+    _In_ PVOID PerfStatBlock,
+    _Out_ PDN_PERF_COUNTERS Counters
+    )
+{
+    if (Wow64)
+    {
+        PerfCounterIPCControlBlock_Wow64* perfBlock = PerfStatBlock;
+        Perf_GC_Wow64 dotNetPerfGC_Wow64 = perfBlock->GC;
+        Perf_Loading_Wow64 dotNetPerfLoading_Wow64 = perfBlock->Loading;
+        Perf_Security_Wow64 dotNetPerfSecurity_Wow64 = perfBlock->Security;
+
+        // Thunk the Wow64 structures into their 64bit versions (or 32bit version on x86).
+
+        Counters->GC.cGenCollections[0] = dotNetPerfGC_Wow64.cGenCollections[0];
+        Counters->GC.cGenCollections[1] = dotNetPerfGC_Wow64.cGenCollections[1];
+        Counters->GC.cGenCollections[2] = dotNetPerfGC_Wow64.cGenCollections[2];
+        Counters->GC.cbPromotedMem[0] = dotNetPerfGC_Wow64.cbPromotedMem[0];
+        Counters->GC.cbPromotedMem[1] = dotNetPerfGC_Wow64.cbPromotedMem[1];
+        Counters->GC.cbPromotedFinalizationMem = dotNetPerfGC_Wow64.cbPromotedFinalizationMem;
+        Counters->GC.cProcessID = dotNetPerfGC_Wow64.cProcessID;
+        Counters->GC.cGenHeapSize[0] = dotNetPerfGC_Wow64.cGenHeapSize[0];
+        Counters->GC.cGenHeapSize[1] = dotNetPerfGC_Wow64.cGenHeapSize[1];
+        Counters->GC.cGenHeapSize[2] = dotNetPerfGC_Wow64.cGenHeapSize[2];
+        Counters->GC.cTotalCommittedBytes = dotNetPerfGC_Wow64.cTotalCommittedBytes;
+        Counters->GC.cTotalReservedBytes = dotNetPerfGC_Wow64.cTotalReservedBytes;
+        Counters->GC.cLrgObjSize = dotNetPerfGC_Wow64.cLrgObjSize;
+        Counters->GC.cSurviveFinalize = dotNetPerfGC_Wow64.cSurviveFinalize;
+        Counters->GC.cHandles = dotNetPerfGC_Wow64.cHandles;
+        Counters->GC.cbAlloc = dotNetPerfGC_Wow64.cbAlloc;
+        Counters->GC.cbLargeAlloc = dotNetPerfGC_Wow64.cbLargeAlloc;
+        Counters->GC.cInducedGCs = dotNetPerfGC_Wow64.cInducedGCs;
+        Counters->GC.timeInGC = dotNetPerfGC_Wow64.timeInGC;
+        Counters->GC.timeInGCBase = dotNetPerfGC_Wow64.timeInGCBase;
+        Counters->GC.cPinnedObj = dotNetPerfGC_Wow64.cPinnedObj;
+        Counters->GC.cSinkBlocks = dotNetPerfGC_Wow64.cSinkBlocks;
+
+        Counters->Context = perfBlock->Context;
+        Counters->Interop = perfBlock->Interop;
+
+        Counters->Loading.cClassesLoaded.Current = dotNetPerfLoading_Wow64.cClassesLoaded.Current;
+        Counters->Loading.cClassesLoaded.Total = dotNetPerfLoading_Wow64.cClassesLoaded.Total;
+        Counters->Loading.cAppDomains.Current = dotNetPerfLoading_Wow64.cAppDomains.Current;
+        Counters->Loading.cAppDomains.Total = dotNetPerfLoading_Wow64.cAppDomains.Total;
+        Counters->Loading.cAssemblies.Current = dotNetPerfLoading_Wow64.cAssemblies.Current;
+        Counters->Loading.cAssemblies.Total = dotNetPerfLoading_Wow64.cAssemblies.Total;
+        Counters->Loading.timeLoading = dotNetPerfLoading_Wow64.timeLoading;
+        Counters->Loading.cAsmSearchLen = dotNetPerfLoading_Wow64.cAsmSearchLen;
+        Counters->Loading.cLoadFailures.Total = dotNetPerfLoading_Wow64.cLoadFailures.Total;
+        Counters->Loading.cbLoaderHeapSize = dotNetPerfLoading_Wow64.cbLoaderHeapSize;
+        Counters->Loading.cAppDomainsUnloaded = dotNetPerfLoading_Wow64.cAppDomainsUnloaded;
+
+        Counters->Exceptions = perfBlock->Exceptions;
+        Counters->LocksAndThreads = perfBlock->LocksAndThreads;
+        Counters->Jit = perfBlock->Jit;
+
+        Counters->Security.cTotalRTChecks = dotNetPerfSecurity_Wow64.cTotalRTChecks;
+        Counters->Security.timeAuthorize = dotNetPerfSecurity_Wow64.timeAuthorize;
+        Counters->Security.cLinkChecks = dotNetPerfSecurity_Wow64.cLinkChecks;
+        Counters->Security.timeRTchecks = dotNetPerfSecurity_Wow64.timeRTchecks;
+        Counters->Security.timeRTchecksBase = dotNetPerfSecurity_Wow64.timeRTchecksBase;
+        Counters->Security.stackWalkDepth = dotNetPerfSecurity_Wow64.stackWalkDepth;
+    }
+    else
+    {
+        PerfCounterIPCControlBlock* perfBlock = PerfStatBlock;
+
+        Counters->GC = perfBlock->GC;
+        Counters->Context = perfBlock->Context;
+        Counters->Interop = perfBlock->Interop;
+        Counters->Loading = perfBlock->Loading;
+        Counters->Exceptions = perfBlock->Exceptions;
+        Counters->LocksAndThreads = perfBlock->LocksAndThreads;
+        Counters->Jit = perfBlock->Jit;
+        Counters->Security = perfBlock->Security;
+    }
+}
+
+static VOID OpenDotNetProcessControlBlock(
+    _Inout_ PDN_PROCESS_ITEM DotNetProcess
+    )
+{
+    PPH_PROCESS_ITEM processItem = DotNetProcess->ProcessItem;
+    HANDLE processHandle;
+
+    // Only one attempt is made to map the control block. The mapping stays open until the process
+    // item is deleted so later samples only have to copy the counters out of the view.
+    DotNetProcess->ControlBlockOpened = TRUE;
+
+#ifdef _WIN64
+    DotNetProcess->IsWow64 = !!processItem->IsWow64;
+#else
+    // HACK: Work-around for Appdomain enumeration on 32bit.
+    DotNetProcess->IsWow64 = TRUE;
+#endif
+
+    if (NT_SUCCESS(PhOpenProcess(
+        &processHandle,
+        PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ,
+        processItem->ProcessId
+        )))
+    {
+        ULONG flags = 0;
+
+        if (NT_SUCCESS(PhGetProcessIsDotNetEx(
+            processItem->ProcessId,
+            processHandle,
+            processItem->IsImmersive ? 0 : PH_CLR_USE_SECTION_CHECK,
+            NULL,
+            &flags
+            )))
+        {
+            if (flags & PH_CLR_VERSION_4_ABOVE)
+            {
+                DotNetProcess->ClrV4 = TRUE;
+            }
+        }
+
+        if (DotNetProcess->ClrV4)
+        {
+            if (OpenDotNetPublicControlBlock_V4(
+                !!processItem->IsImmersive,
+                processHandle,
+                processItem->ProcessId,
+                &DotNetProcess->BlockTableAddress
+                ))
+            {
+                DotNetProcess->ControlBlockValid = TRUE;
+            }
+        }
+
+        NtClose(processHandle);
+    }
+
+    if (!DotNetProcess->ClrV4)
+    {
+        if (OpenDotNetPublicControlBlock_V2(
+            processItem->ProcessId,
+            &DotNetProcess->BlockTableAddress
+            ))
+        {
+            DotNetProcess->ControlBlockValid = TRUE;
+        }
+    }
+}
+
+static VOID UpdateDotNetProcessCounters(
+    _Inout_ PDN_PROCESS_ITEM DotNetProcess
+    )
+{
+    PVOID perfStatBlock;
+
+    if (!DotNetProcess->ControlBlockOpened)
+        OpenDotNetProcessControlBlock(DotNetProcess);
+
+    if (!DotNetProcess->ControlBlockValid)
+        return;
+
+    if (DotNetProcess->ClrV4)
+        perfStatBlock = GetPerfIpcBlock_V4(DotNetProcess->IsWow64, DotNetProcess->BlockTableAddress);
+    else
+        perfStatBlock = GetPerfIpcBlock_V2(DotNetProcess->IsWow64, DotNetProcess->BlockTableAddress);
+
+    if (perfStatBlock)
+    {
+        CopyPerfIpcBlock(DotNetProcess->IsWow64, perfStatBlock, &DotNetProcess->Counters);
+        DotNetProcess->CountersValid = TRUE;
+    }
+}
+
+static BOOLEAN IsDotNetProcessCountersDemanded(
+    _In_ PDN_PROCESS_ITEM DotNetProcess
+    )
+{
+    if (DotNetProcess->ReferenceCount != 0)
+        return TRUE;
+
+    // Tree columns only keep a process sampled while it is being displayed, and only processes
+    // that the provider has identified as .NET are worth mapping.
+    return DotNetProcess->ProcessItem->IsDotNet &&
+        DotNetCountersRunCount - DotNetProcess->LastDemandRunCount <= DN_COUNTERS_DEMAND_TIMEOUT;
+}
+
+static VOID NTAPI DotNetCountersProcessesUpdatedCallback(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    PLIST_ENTRY listEntry;
+
+    DotNetCountersRunCount++;
+
+    // Every demanded process is sampled in a single pass so the tree and the property pages
+    // all see counters from the same provider tick.
+
+    PhAcquireQueuedLockExclusive(&DotNetProcessListLock);
+
+    for (listEntry = DotNetProcessListHead.Flink; listEntry != &DotNetProcessListHead; listEntry = listEntry->Flink)
+    {
+        PDN_PROCESS_ITEM dotNetProcess = CONTAINING_RECORD(listEntry, DN_PROCESS_ITEM, ListEntry);
+
+        if (IsDotNetProcessCountersDemanded(dotNetProcess))
+        {
+            UpdateDotNetProcessCounters(dotNetProcess);
+        }
+    }
+
+    PhReleaseQueuedLockExclusive(&DotNetProcessListLock);
+}
+
+VOID InitializeDotNetCounters(
+    VOID
+    )
+{
+    PhRegisterCallback(
+        PhGetGeneralCallback(GeneralCallbackProcessProviderUpdatedEvent),
+        DotNetCountersProcessesUpdatedCallback,
+        NULL,
+        &DotNetCountersProcessesUpdatedRegistration
+        );
+}
+
+VOID InitializeDotNetProcessItem(
+    _Out_ PDN_PROCESS_ITEM DotNetProcess,
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    )
+{
+    memset(DotNetProcess, 0, sizeof(DN_PROCESS_ITEM));
+    DotNetProcess->ProcessItem = ProcessItem;
+    DotNetProcess->LastDemandRunCount = DotNetCountersRunCount - DN_COUNTERS_DEMAND_TIMEOUT - 1;
+
+    PhAcquireQueuedLockExclusive(&DotNetProcessListLock);
+    InsertTailList(&DotNetProcessListHead, &DotNetProcess->ListEntry);
+    PhReleaseQueuedLockExclusive(&DotNetProcessListLock);
+}
+
+VOID DeleteDotNetProcessItem(
+    _In_ PDN_PROCESS_ITEM DotNetProcess
+    )
+{
+    PhAcquireQueuedLockExclusive(&DotNetProcessListLock);
+    RemoveEntryList(&DotNetProcess->ListEntry);
+    PhReleaseQueuedLockExclusive(&DotNetProcessListLock);
+
+    if (DotNetProcess->BlockTableAddress)
+    {
+        NtUnmapViewOfSection(NtCurrentProcess(), DotNetProcess->BlockTableAddress);
+    }
+
+    for (ULONG i = 0; i < DNPRTNC_MAXIMUM; i++)
+        PhClearReference(&DotNetProcess->TextCache[i]);
+}
+
+PDN_PROCESS_ITEM GetDotNetProcessItem(
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    )
+{
+    return PhPluginGetObjectExtension(PluginInstance, ProcessItem, EmProcessItemType);
+}
+
+VOID TouchDotNetProcessCounters(
+    _In_ PDN_PROCESS_ITEM DotNetProcess
+    )
+{
+    DotNetProcess->LastDemandRunCount = DotNetCountersRunCount;
+}
+
+VOID ReferenceDotNetProcessCounters(
+    _In_ PDN_PROCESS_ITEM DotNetProcess
+    )
+{
+    InterlockedIncrement(&DotNetProcess->ReferenceCount);
+
+    // Take a sample straight away so the caller doesn't have to wait for the next provider tick.
+    PhAcquireQueuedLockExclusive(&DotNetProcessListLock);
+    UpdateDotNetProcessCounters(DotNetProcess);
+    PhReleaseQueuedLockExclusive(&DotNetProcessListLock);
+}
+
+VOID DereferenceDotNetProcessCounters(
+    _In_ PDN_PROCESS_ITEM DotNetProcess
+    )
+{
+    InterlockedDecrement(&DotNetProcess->ReferenceCount);
+}
+
+_Success_(return)
+BOOLEAN QueryDotNetProcessCounters(
+    _In_ PDN_PROCESS_ITEM DotNetProcess,
+    _Out_ PDN_PERF_COUNTERS Counters
+    )
+{
+    BOOLEAN valid;
+
+    PhAcquireQueuedLockShared(&DotNetProcessListLock);
+
+    if (valid = DotNetProcess->CountersValid)
+    {
+        memcpy(Counters, &DotNetProcess->Counters, sizeof(DN_PERF_COUNTERS));
+    }
+
+    PhReleaseQueuedLockShared(&DotNetProcessListLock);
+
+    return valid;
+}
@@ -28,6 +28,7 @@
 #include <settings.h>
 
 #include "resource.h"
+#include "clr/perfcounterdefs.h"
 
 #define PLUGIN_NAME L"ProcessHacker.DotNetTools"
 #define SETTING_NAME_ASM_TREE_LIST_COLUMNS (PLUGIN_NAME L".AsmTreeListColumns")
@@ -55,6 +56,57 @@ typedef struct _DN_THREAD_ITEM
     PPH_STRING AppDomainText;
 } DN_THREAD_ITEM, *PDN_THREAD_ITEM;
 
+typedef struct _DN_PERF_COUNTERS
+{
+    Perf_GC GC;
+    Perf_Contexts Context;
+    Perf_Interop Interop;
+    Perf_Loading Loading;
+    Perf_Excep Exceptions;
+    Perf_LocksAndThreads LocksAndThreads;
+    Perf_Jit Jit;
+    Perf_Security Security;
+} DN_PERF_COUNTERS, *PDN_PERF_COUNTERS;
+
+#define DNPRTNC_GCHEAPBYTES 1
+#define DNPRTNC_GEN0COLLECTIONS 2
+#define DNPRTNC_GEN1COLLECTIONS 3
+#define DNPRTNC_GEN2COLLECTIONS 4
+#define DNPRTNC_TIMEINGC 5
+#define DNPRTNC_EXCEPTIONSTHROWN 6
+#define DNPRTNC_MAXIMUM 7
+
+// Number of provider ticks a process stays sampled after its tree columns were last drawn.
+#define DN_COUNTERS_DEMAND_TIMEOUT 2
+
+typedef struct _DN_PROCESS_ITEM
+{
+    LIST_ENTRY ListEntry;
+    PPH_PROCESS_ITEM ProcessItem;
+
+    union
+    {
+        ULONG Flags;
+        struct
+        {
+            ULONG ControlBlockOpened : 1;
+            ULONG ControlBlockValid : 1;
+            ULONG ClrV4 : 1;
+            ULONG IsWow64 : 1;
+            ULONG CountersValid : 1;
+            ULONG Spare : 27;
+        };
+    };
+
+    PVOID BlockTableAddress;
+    ULONG LastDemandRunCount;
+    LONG ReferenceCount;
+
+    DN_PERF_COUNTERS Counters;
+
+    PPH_STRING TextCache[DNPRTNC_MAXIMUM];
+} DN_PROCESS_ITEM, *PDN_PROCESS_ITEM;
+
 // counters
 
 PVOID GetPerfIpcBlock_V2(
@@ -93,6 +145,47 @@ PPH_LIST QueryDotNetAppDomainsForPid_V4(
     _In_ HANDLE ProcessId
     );
 
+VOID CopyPerfIpcBlock(
+    _In_ BOOLEAN Wow64,
+    _In_ PVOID PerfStatBlock,
+    _Out_ PDN_PERF_COUNTERS Counters
+    );
+
+VOID InitializeDotNetCounters(
+    VOID
+    );
+
+VOID InitializeDotNetProcessItem(
+    _Out_ PDN_PROCESS_ITEM DotNetProcess,
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    );
+
+VOID DeleteDotNetProcessItem(
+    _In_ PDN_PROCESS_ITEM DotNetProcess
+    );
+
+PDN_PROCESS_ITEM GetDotNetProcessItem(
+    _In_ PPH_PROCESS_ITEM ProcessItem
+    );
+
+VOID TouchDotNetProcessCounters(
+    _In_ PDN_PROCESS_ITEM DotNetProcess
+    );
+
+VOID ReferenceDotNetProcessCounters(
+    _In_ PDN_PROCESS_ITEM DotNetProcess
+    );
+
+VOID DereferenceDotNetProcessCounters(
+    _In_ PDN_PROCESS_ITEM DotNetProcess
+    );
+
+_Success_(return)
+BOOLEAN QueryDotNetProcessCounters(
+    _In_ PDN_PROCESS_ITEM DotNetProcess,
+    _Out_ PDN_PERF_COUNTERS Counters
+    );
+
 // asmpage
 
 VOID AddAsmPageToPropContext(
@@ -140,6 +233,10 @@ VOID DispatchTreeNewMessage(
 
 #define DNTHTNC_APPDOMAIN 1
 
+VOID ProcessTreeNewInitializing(
+    __in PVOID Parameter
+    );
+
 VOID ThreadTreeNewInitializing(
     __in PVOID Parameter
     );
@@ -179,7 +179,8 @@ VOID NTAPI ProcessTreeNewInitializingCallback(
     _In_opt_ PVOID Context
     )
 {
-    NOTHING;
+    if (Parameter)
+        ProcessTreeNewInitializing(Parameter);
 }
 
 VOID NTAPI ThreadStackControlCallback(
@@ -193,6 +194,24 @@ VOID NTAPI ThreadStackControlCallback(
     ProcessThreadStackControl(Parameter);
 }
 
+VOID NTAPI ProcessItemCreateCallback(
+    _In_ PVOID Object,
+    _In_ PH_EM_OBJECT_TYPE ObjectType,
+    _In_ PVOID Extension
+    )
+{
+    InitializeDotNetProcessItem(Extension, Object);
+}
+
+VOID NTAPI ProcessItemDeleteCallback(
+    _In_ PVOID Object,
+    _In_ PH_EM_OBJECT_TYPE ObjectType,
+    _In_ PVOID Extension
+    )
+{
+    DeleteDotNetProcessItem(Extension);
+}
+
 VOID NTAPI ThreadItemCreateCallback(
     _In_ PVOID Object,
     _In_ PH_EM_OBJECT_TYPE ObjectType,
@@ -309,12 +328,12 @@ LOGICAL DllMain(
             //    NULL,
             //    &ModuleMenuInitializingCallbackRegistration
             //    );
-            //PhRegisterCallback(
-            //    PhGetGeneralCallback(GeneralCallbackProcessTreeNewInitializing),
-            //    ProcessTreeNewInitializingCallback,
-            //    NULL,
-            //    &ProcessTreeNewInitializingCallbackRegistration
-            //    );
+            PhRegisterCallback(
+                PhGetGeneralCallback(GeneralCallbackProcessTreeNewInitializing),
+                ProcessTreeNewInitializingCallback,
+                NULL,
+                &ProcessTreeNewInitializingCallbackRegistration
+                );
             PhRegisterCallback(
                 PhGetGeneralCallback(GeneralCallbackThreadTreeNewInitializing),
                 ThreadTreeNewInitializingCallback,
@@ -334,6 +353,13 @@ LOGICAL DllMain(
                 &ThreadStackControlCallbackRegistration
                 );
 
+            PhPluginSetObjectExtension(
+                PluginInstance,
+                EmProcessItemType,
+                sizeof(DN_PROCESS_ITEM),
+                ProcessItemCreateCallback,
+                ProcessItemDeleteCallback
+                );
             PhPluginSetObjectExtension(
                 PluginInstance,
                 EmThreadItemType,
@@ -342,6 +368,7 @@ LOGICAL DllMain(
                 ThreadItemDeleteCallback
                 );
             InitializeTreeNewObjectExtensions();
+            InitializeDotNetCounters();
 
             PhAddSettings(settings, RTL_NUMBER_OF(settings));
         }
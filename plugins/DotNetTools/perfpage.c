@@ -143,24 +143,14 @@ typedef struct _PERFPAGE_CONTEXT
         struct
         {
             BOOLEAN Enabled : 1;
-            BOOLEAN ControlBlockValid : 1;
-            BOOLEAN ClrV4 : 1;
-            BOOLEAN IsWow64 : 1;
-            BOOLEAN Spare : 4;
+            BOOLEAN CountersValid : 1;
+            BOOLEAN Spare : 6;
         };
     };
 
-    HANDLE ProcessHandle;
-    PVOID BlockTableAddress;
+    PDN_PROCESS_ITEM DotNetProcess;
     PH_CALLBACK_REGISTRATION ProcessesUpdatedCallbackRegistration;
-    Perf_GC DotNetPerfGC;
-    Perf_Contexts DotNetPerfContext;
-    Perf_Interop DotNetPerfInterop;
-    Perf_Loading DotNetPerfLoading;
-    Perf_Excep DotNetPerfExceptions;
-    Perf_LocksAndThreads DotNetPerfLocksAndThreads;
-    Perf_Jit DotNetPerfJit;
-    Perf_Security DotNetPerfSecurity;
+    DN_PERF_COUNTERS Counters;
 } PERFPAGE_CONTEXT, *PPERFPAGE_CONTEXT;
 
 VOID NTAPI DotNetPerfProcessesUpdatedCallback(
@@ -647,97 +637,12 @@ VOID DotNetPerfUpdateCounterData(
     _In_ PPERFPAGE_CONTEXT Context
     )
 {
-    PVOID perfStatBlock;
-
-    if (Context->ClrV4)
-    {
-        perfStatBlock = GetPerfIpcBlock_V4(
-            Context->IsWow64,
-            Context->BlockTableAddress
-            );
-    }
-    else
-    {
-        perfStatBlock = GetPerfIpcBlock_V2(
-            Context->IsWow64,
-            Context->BlockTableAddress
-            );
-    }
-
-    if (!perfStatBlock)
+    // The counters are sampled for all .NET processes by the shared sampler, so we only need to
+    // copy the latest snapshot here instead of reading the control block ourselves.
+    if (!QueryDotNetProcessCounters(Context->DotNetProcess, &Context->Counters))
         return;
 
-    if (Context->IsWow64)
-    {
-        PerfCounterIPCControlBlock_Wow64* perfBlock = perfStatBlock;
-        Perf_GC_Wow64 dotNetPerfGC_Wow64 = perfBlock->GC;
-        Perf_Loading_Wow64 dotNetPerfLoading_Wow64 = perfBlock->Loading;
-        Perf_Security_Wow64 dotNetPerfSecurity_Wow64 = perfBlock->Security;
-
-        // Thunk the Wow64 structures into their 64bit versions (or 32bit version on x86).
-
-        Context->DotNetPerfGC.cGenCollections[0] = dotNetPerfGC_Wow64.cGenCollections[0];
-        Context->DotNetPerfGC.cGenCollections[1] = dotNetPerfGC_Wow64.cGenCollections[1];
-        Context->DotNetPerfGC.cGenCollections[2] = dotNetPerfGC_Wow64.cGenCollections[2];
-        Context->DotNetPerfGC.cbPromotedMem[0] = dotNetPerfGC_Wow64.cbPromotedMem[0];
-        Context->DotNetPerfGC.cbPromotedMem[1] = dotNetPerfGC_Wow64.cbPromotedMem[1];
-        Context->DotNetPerfGC.cbPromotedFinalizationMem = dotNetPerfGC_Wow64.cbPromotedFinalizationMem;
-        Context->DotNetPerfGC.cProcessID = dotNetPerfGC_Wow64.cProcessID;
-        Context->DotNetPerfGC.cGenHeapSize[0] = dotNetPerfGC_Wow64.cGenHeapSize[0];
-        Context->DotNetPerfGC.cGenHeapSize[1] = dotNetPerfGC_Wow64.cGenHeapSize[1];
-        Context->DotNetPerfGC.cGenHeapSize[2] = dotNetPerfGC_Wow64.cGenHeapSize[2];
-        Context->DotNetPerfGC.cTotalCommittedBytes = dotNetPerfGC_Wow64.cTotalCommittedBytes;
-        Context->DotNetPerfGC.cTotalReservedBytes = dotNetPerfGC_Wow64.cTotalReservedBytes;
-        Context->DotNetPerfGC.cLrgObjSize = dotNetPerfGC_Wow64.cLrgObjSize;
-        Context->DotNetPerfGC.cSurviveFinalize = dotNetPerfGC_Wow64.cSurviveFinalize;
-        Context->DotNetPerfGC.cHandles = dotNetPerfGC_Wow64.cHandles;
-        Context->DotNetPerfGC.cbAlloc = dotNetPerfGC_Wow64.cbAlloc;
-        Context->DotNetPerfGC.cbLargeAlloc = dotNetPerfGC_Wow64.cbLargeAlloc;
-        Context->DotNetPerfGC.cInducedGCs = dotNetPerfGC_Wow64.cInducedGCs;
-        Context->DotNetPerfGC.timeInGC = dotNetPerfGC_Wow64.timeInGC;
-        Context->DotNetPerfGC.timeInGCBase = dotNetPerfGC_Wow64.timeInGCBase;
-        Context->DotNetPerfGC.cPinnedObj = dotNetPerfGC_Wow64.cPinnedObj;
-        Context->DotNetPerfGC.cSinkBlocks = dotNetPerfGC_Wow64.cSinkBlocks;
-
-        Context->DotNetPerfContext = perfBlock->Context;
-        Context->DotNetPerfInterop = perfBlock->Interop;
-
-        Context->DotNetPerfLoading.cClassesLoaded.Current = dotNetPerfLoading_Wow64.cClassesLoaded.Current;
-        Context->DotNetPerfLoading.cClassesLoaded.Total = dotNetPerfLoading_Wow64.cClassesLoaded.Total;
-        Context->DotNetPerfLoading.cAppDomains.Current = dotNetPerfLoading_Wow64.cAppDomains.Current;
-        Context->DotNetPerfLoading.cAppDomains.Total = dotNetPerfLoading_Wow64.cAppDomains.Total;
-        Context->DotNetPerfLoading.cAssemblies.Current = dotNetPerfLoading_Wow64.cAssemblies.Current;
-        Context->DotNetPerfLoading.cAssemblies.Total = dotNetPerfLoading_Wow64.cAssemblies.Total;
-        Context->DotNetPerfLoading.timeLoading = dotNetPerfLoading_Wow64.timeLoading;
-        Context->DotNetPerfLoading.cAsmSearchLen = dotNetPerfLoading_Wow64.cAsmSearchLen;
-        Context->DotNetPerfLoading.cLoadFailures.Total = dotNetPerfLoading_Wow64.cLoadFailures.Total;
-        Context->DotNetPerfLoading.cbLoaderHeapSize = dotNetPerfLoading_Wow64.cbLoaderHeapSize;
-        Context->DotNetPerfLoading.cAppDomainsUnloaded = dotNetPerfLoading_Wow64.cAppDomainsUnloaded;
-
-        Context->DotNetPerfExceptions = perfBlock->Exceptions;
-        Context->DotNetPerfLocksAndThreads = perfBlock->LocksAndThreads;
-        Context->DotNetPerfJit = perfBlock->Jit;
-
-        Context->DotNetPerfSecurity.cTotalRTChecks = dotNetPerfSecurity_Wow64.cTotalRTChecks;
-        Context->DotNetPerfSecurity.timeAuthorize = dotNetPerfSecurity_Wow64.timeAuthorize;
-        Context->DotNetPerfSecurity.cLinkChecks = dotNetPerfSecurity_Wow64.cLinkChecks;
-        Context->DotNetPerfSecurity.timeRTchecks = dotNetPerfSecurity_Wow64.timeRTchecks;
-        Context->DotNetPerfSecurity.timeRTchecksBase = dotNetPerfSecurity_Wow64.timeRTchecksBase;
-        Context->DotNetPerfSecurity.stackWalkDepth = dotNetPerfSecurity_Wow64.stackWalkDepth;
-    }
-    else
-    {
-        PerfCounterIPCControlBlock* perfBlock = perfStatBlock;
-
-        Context->DotNetPerfGC = perfBlock->GC;
-        Context->DotNetPerfContext = perfBlock->Context;
-        Context->DotNetPerfInterop = perfBlock->Interop;
-        Context->DotNetPerfLoading = perfBlock->Loading;
-        Context->DotNetPerfExceptions = perfBlock->Exceptions;
-        Context->DotNetPerfLocksAndThreads = perfBlock->LocksAndThreads;
-        Context->DotNetPerfJit = perfBlock->Jit;
-        Context->DotNetPerfSecurity = perfBlock->Security;
-    }
+    Context->CountersValid = TRUE;
 
     // The ListView doesn't send LVN_GETDISPINFO (or redraw properly) when not focused so we'll force a redraw. (dmex)
     ListView_RedrawItems(Context->CountersListViewHandle, 0, DOTNET_INDEX_MAXIMUM);
@@ -786,63 +691,9 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
             PhLoadListViewSortColumnsFromSetting(SETTING_NAME_DOT_NET_COUNTERS_SORTCOLUMN, context->CountersListViewHandle);
             PhLoadListViewGroupStatesFromSetting(SETTING_NAME_DOT_NET_COUNTERS_GROUPSTATES, context->CountersListViewHandle);
 
-#ifdef _WIN64
-            context->IsWow64 = !!context->ProcessItem->IsWow64;
-#else
-            // HACK: Work-around for Appdomain enumeration on 32bit.
-            context->IsWow64 = TRUE;
-#endif
-
-            if (NT_SUCCESS(PhOpenProcess(
-                &context->ProcessHandle,
-                PROCESS_QUERY_LIMITED_INFORMATION | PROCESS_VM_READ | PROCESS_DUP_HANDLE | SYNCHRONIZE,
-                context->ProcessItem->ProcessId
-                )))
-            {
-                ULONG flags = 0;
-
-                if (NT_SUCCESS(PhGetProcessIsDotNetEx(
-                    context->ProcessItem->ProcessId,
-                    context->ProcessHandle,
-                    context->ProcessItem->IsImmersive ? 0 : PH_CLR_USE_SECTION_CHECK,
-                    NULL,
-                    &flags
-                    )))
-                {
-                    if (flags & PH_CLR_VERSION_4_ABOVE)
-                    {
-                        context->ClrV4 = TRUE;
-                    }
-                }
-            }
-
-            if (context->ClrV4)
-            {
-                if (OpenDotNetPublicControlBlock_V4(
-                    !!context->ProcessItem->IsImmersive,
-                    context->ProcessHandle,
-                    context->ProcessItem->ProcessId,
-                    &context->BlockTableAddress
-                    ))
-                {
-                    context->ControlBlockValid = TRUE;
-                }
-            }
-            else
-            {
-                if (OpenDotNetPublicControlBlock_V2(
-                    context->ProcessItem->ProcessId,
-                    &context->BlockTableAddress
-                    ))
-                {
-                    context->ControlBlockValid = TRUE;
-                }
-            }
-
-            if (context->ControlBlockValid)
-            {
-                DotNetPerfUpdateCounterData(hwndDlg, context);
-            }
+            context->DotNetProcess = GetDotNetProcessItem(processItem);
+            ReferenceDotNetProcessCounters(context->DotNetProcess);
+            DotNetPerfUpdateCounterData(hwndDlg, context);
 
             PhRegisterCallback(
                 PhGetGeneralCallback(GeneralCallbackProcessesUpdated),
@@ -861,15 +712,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                 &context->ProcessesUpdatedCallbackRegistration
                 );
 
-            if (context->BlockTableAddress)
-            {
-                NtUnmapViewOfSection(NtCurrentProcess(), context->BlockTableAddress);
-            }
-
-            if (context->ProcessHandle)
-            {
-                NtClose(context->ProcessHandle);
-            }
+            DereferenceDotNetProcessCounters(context->DotNetProcess);
 
             PhSaveListViewGroupStatesToSetting(SETTING_NAME_DOT_NET_COUNTERS_GROUPSTATES, context->CountersListViewHandle);
             PhSaveListViewSortColumnsToSetting(SETTING_NAME_DOT_NET_COUNTERS_SORTCOLUMN, context->CountersListViewHandle);
@@ -910,7 +753,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                 {
                     NMLVDISPINFO *dispInfo = (NMLVDISPINFO *)header;
 
-                    if (!context->ControlBlockValid) // Don't show statistics when the CLR data is invalid. (dmex)
+                    if (!context->CountersValid) // Don't show statistics when the CLR data is invalid. (dmex)
                         break;
 
                     if (dispInfo->item.iSubItem == 1)
@@ -924,7 +767,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfExceptions.cThrown.Total);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Exceptions.cThrown.Total);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -937,7 +780,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfExceptions.cFiltersExecuted);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Exceptions.cFiltersExecuted);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -950,7 +793,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfExceptions.cFinallysExecuted);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Exceptions.cFinallysExecuted);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -964,7 +807,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfInterop.cCCW);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Interop.cCCW);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -977,7 +820,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfInterop.cStubs);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Interop.cStubs);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -990,7 +833,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfInterop.cMarshalling);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Interop.cMarshalling);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1003,7 +846,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfInterop.cTLBImports);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Interop.cTLBImports);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1016,7 +859,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfInterop.cTLBExports);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Interop.cTLBExports);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1030,7 +873,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfJit.cMethodsJitted);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Jit.cMethodsJitted);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1043,7 +886,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfJit.cbILJitted.Current);
+                                    PhInitFormatSize(&format[0], context->Counters.Jit.cbILJitted.Current);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1056,7 +899,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfJit.cbILJitted.Total);
+                                    PhInitFormatSize(&format[0], context->Counters.Jit.cbILJitted.Total);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1069,7 +912,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfJit.cJitFailures);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Jit.cJitFailures);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1079,14 +922,14 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                 break;
                             case DOTNET_INDEX_JIT_TIME:
                                 {
-                                    if (context->DotNetPerfJit.timeInJitBase != 0)
+                                    if (context->Counters.Jit.timeInJitBase != 0)
                                     {
                                         PH_FORMAT format[1];
                                         WCHAR formatBuffer[10];
 
                                         // TODO: perlib never shows the TimeInJit value and it can sometimes show values above 100% ???
                                         // SeeAlso: https://github.com/dotnet/coreclr/blob/master/src/gc/gcee.cpp#L324
-                                        PhInitFormatF(&format[0], (context->DotNetPerfJit.timeInJit << 8) * 100 / (FLOAT)(context->DotNetPerfJit.timeInJitBase << 8), 2);
+                                        PhInitFormatF(&format[0], (context->Counters.Jit.timeInJit << 8) * 100 / (FLOAT)(context->Counters.Jit.timeInJitBase << 8), 2);
 
                                         if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                         {
@@ -1105,7 +948,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLoading.cClassesLoaded.Current);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Loading.cClassesLoaded.Current);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1118,7 +961,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLoading.cClassesLoaded.Total);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Loading.cClassesLoaded.Total);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1131,7 +974,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLoading.cAppDomains.Current);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Loading.cAppDomains.Current);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1144,7 +987,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLoading.cAppDomains.Total);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Loading.cAppDomains.Total);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1157,7 +1000,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLoading.cAssemblies.Current);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Loading.cAssemblies.Current);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1170,7 +1013,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLoading.cAssemblies.Total);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Loading.cAssemblies.Total);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1183,7 +1026,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLoading.cAsmSearchLen);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Loading.cAsmSearchLen);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1196,7 +1039,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLoading.cLoadFailures.Total);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Loading.cLoadFailures.Total);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1209,7 +1052,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfLoading.cbLoaderHeapSize);
+                                    PhInitFormatSize(&format[0], context->Counters.Loading.cbLoaderHeapSize);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1222,7 +1065,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLoading.cAppDomainsUnloaded.Total);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Loading.cAppDomainsUnloaded.Total);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1236,7 +1079,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLocksAndThreads.cContention.Total);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.LocksAndThreads.cContention.Total);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1249,7 +1092,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLocksAndThreads.cQueueLength.Current);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.LocksAndThreads.cQueueLength.Current);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1262,7 +1105,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLocksAndThreads.cQueueLength.Total);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.LocksAndThreads.cQueueLength.Total);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1275,7 +1118,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLocksAndThreads.cCurrentThreadsLogical);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.LocksAndThreads.cCurrentThreadsLogical);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1288,7 +1131,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLocksAndThreads.cCurrentThreadsPhysical);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.LocksAndThreads.cCurrentThreadsPhysical);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1301,7 +1144,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLocksAndThreads.cRecognizedThreads.Current);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.LocksAndThreads.cRecognizedThreads.Current);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1314,7 +1157,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfLocksAndThreads.cRecognizedThreads.Total);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.LocksAndThreads.cRecognizedThreads.Total);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1328,7 +1171,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfGC.cGenCollections[0]);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.GC.cGenCollections[0]);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1341,7 +1184,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfGC.cGenCollections[1]);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.GC.cGenCollections[1]);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1354,7 +1197,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfGC.cGenCollections[2]);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.GC.cGenCollections[2]);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1367,7 +1210,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfGC.cbPromotedMem[0]);
+                                    PhInitFormatSize(&format[0], context->Counters.GC.cbPromotedMem[0]);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1380,7 +1223,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfGC.cbPromotedMem[1]);
+                                    PhInitFormatSize(&format[0], context->Counters.GC.cbPromotedMem[1]);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1393,7 +1236,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfGC.cbPromotedFinalizationMem);
+                                    PhInitFormatSize(&format[0], context->Counters.GC.cbPromotedFinalizationMem);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1406,7 +1249,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64U(&format[0], context->DotNetPerfGC.cProcessID);
+                                    PhInitFormatI64U(&format[0], context->Counters.GC.cProcessID);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1419,7 +1262,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfGC.cGenHeapSize[0]);
+                                    PhInitFormatSize(&format[0], context->Counters.GC.cGenHeapSize[0]);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1432,7 +1275,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfGC.cGenHeapSize[1]);
+                                    PhInitFormatSize(&format[0], context->Counters.GC.cGenHeapSize[1]);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1445,7 +1288,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfGC.cGenHeapSize[2]);
+                                    PhInitFormatSize(&format[0], context->Counters.GC.cGenHeapSize[2]);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1458,7 +1301,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfGC.cLrgObjSize);
+                                    PhInitFormatSize(&format[0], context->Counters.GC.cLrgObjSize);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1471,7 +1314,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfGC.cSurviveFinalize);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.GC.cSurviveFinalize);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1484,7 +1327,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfGC.cHandles);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.GC.cHandles);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1497,7 +1340,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfGC.cInducedGCs);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.GC.cInducedGCs);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1507,12 +1350,12 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                 break;
                             case DOTNET_INDEX_MEMORY_TIMEINGC:
                                 {
-                                    if (context->DotNetPerfGC.timeInGCBase != 0)
+                                    if (context->Counters.GC.timeInGCBase != 0)
                                     {
                                         PH_FORMAT format[1];
                                         WCHAR formatBuffer[10];
 
-                                        PhInitFormatF(&format[0], (FLOAT)context->DotNetPerfGC.timeInGC * 100 / (FLOAT)context->DotNetPerfGC.timeInGCBase, 2);
+                                        PhInitFormatF(&format[0], (FLOAT)context->Counters.GC.timeInGC * 100 / (FLOAT)context->Counters.GC.timeInGCBase, 2);
 
                                         if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                         {
@@ -1535,9 +1378,9 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
 
                                     PhInitFormatSize(
                                         &format[0],
-                                        context->DotNetPerfGC.cGenHeapSize[1] +
-                                        context->DotNetPerfGC.cGenHeapSize[2] +
-                                        context->DotNetPerfGC.cLrgObjSize
+                                        context->Counters.GC.cGenHeapSize[1] +
+                                        context->Counters.GC.cGenHeapSize[2] +
+                                        context->Counters.GC.cLrgObjSize
                                         );
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
@@ -1551,7 +1394,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfGC.cTotalCommittedBytes);
+                                    PhInitFormatSize(&format[0], context->Counters.GC.cTotalCommittedBytes);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1564,7 +1407,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfGC.cTotalReservedBytes);
+                                    PhInitFormatSize(&format[0], context->Counters.GC.cTotalReservedBytes);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1577,7 +1420,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfGC.cPinnedObj);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.GC.cPinnedObj);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1590,7 +1433,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfGC.cSinkBlocks);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.GC.cSinkBlocks);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1603,7 +1446,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfGC.cbAlloc);
+                                    PhInitFormatSize(&format[0], context->Counters.GC.cbAlloc);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1616,7 +1459,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[0x100];
 
-                                    PhInitFormatSize(&format[0], context->DotNetPerfGC.cbLargeAlloc);
+                                    PhInitFormatSize(&format[0], context->Counters.GC.cbLargeAlloc);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1630,7 +1473,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfContext.cRemoteCalls.Total);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Context.cRemoteCalls.Total);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1643,7 +1486,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfContext.cChannels);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Context.cChannels);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1656,7 +1499,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfContext.cProxies);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Context.cProxies);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1669,7 +1512,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfContext.cClasses);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Context.cClasses);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1682,7 +1525,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfContext.cContexts);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Context.cContexts);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1695,7 +1538,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfContext.cObjAlloc);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Context.cObjAlloc);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1709,7 +1552,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfSecurity.cTotalRTChecks);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Security.cTotalRTChecks);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1722,7 +1565,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfSecurity.cLinkChecks);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Security.cLinkChecks);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1732,12 +1575,12 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                 break;
                             case DOTNET_INDEX_SECURITY_TIMEINRTCHECKS:
                                 {
-                                    if (context->DotNetPerfSecurity.timeRTchecksBase != 0)
+                                    if (context->Counters.Security.timeRTchecksBase != 0)
                                     {
                                         PH_FORMAT format[1];
                                         WCHAR formatBuffer[10];
 
-                                        PhInitFormatF(&format[0], (FLOAT)context->DotNetPerfSecurity.timeRTchecks * 100 / (FLOAT)context->DotNetPerfSecurity.timeRTchecksBase, 2);
+                                        PhInitFormatF(&format[0], (FLOAT)context->Counters.Security.timeRTchecks * 100 / (FLOAT)context->Counters.Security.timeRTchecksBase, 2);
 
                                         if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                         {
@@ -1755,7 +1598,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
                                     PH_FORMAT format[1];
                                     WCHAR formatBuffer[PH_INT64_STR_LEN_1];
 
-                                    PhInitFormatI64UGroupDigits(&format[0], context->DotNetPerfSecurity.stackWalkDepth);
+                                    PhInitFormatI64UGroupDigits(&format[0], context->Counters.Security.stackWalkDepth);
 
                                     if (PhFormatToBuffer(format, RTL_NUMBER_OF(format), formatBuffer, sizeof(formatBuffer), NULL))
                                     {
@@ -1773,7 +1616,7 @@ INT_PTR CALLBACK DotNetPerfPageDlgProc(
         break;
     case MSG_UPDATE:
         {
-            if (context->Enabled && context->ControlBlockValid)
+            if (context->Enabled)
             {
                 DotNetPerfUpdateCounterData(hwndDlg, context);
             }
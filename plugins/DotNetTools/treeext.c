@@ -49,7 +49,22 @@ LONG ThreadTreeNewSortFunction(
     _In_ PVOID Context
     );
 
+VOID ProcessTreeNewMessage(
+    _In_ PVOID Parameter
+    );
+
+LONG ProcessTreeNewSortFunction(
+    _In_ PVOID Node1,
+    _In_ PVOID Node2,
+    _In_ ULONG SubId,
+    _In_ PH_SORT_ORDER SortOrder,
+    _In_ PVOID Context
+    );
+
 #define THREAD_TREE_CONTEXT_TYPE 1
+#define PROCESS_TREE_CONTEXT_TYPE 2
+
+static ULONG ProcessTreeContextType = PROCESS_TREE_CONTEXT_TYPE;
 
 typedef struct _THREAD_TREE_CONTEXT
 {
@@ -126,6 +141,9 @@ VOID DispatchTreeNewMessage(
     case THREAD_TREE_CONTEXT_TYPE:
         ThreadTreeNewMessage(Parameter);
         break;
+    case PROCESS_TREE_CONTEXT_TYPE:
+        ProcessTreeNewMessage(Parameter);
+        break;
     }
 }
 
@@ -390,3 +408,136 @@ LONG ThreadTreeNewSortFunction(
 
     return result;
 }
+
+VOID ProcessTreeNewInitializing(
+    _In_ PVOID Parameter
+    )
+{
+    PPH_PLUGIN_TREENEW_INFORMATION info = Parameter;
+
+    AddTreeNewColumn(info, &ProcessTreeContextType, DNPRTNC_GCHEAPBYTES, FALSE, L".NET bytes in all heaps", 80, PH_ALIGN_RIGHT, DT_RIGHT, TRUE, ProcessTreeNewSortFunction);
+    AddTreeNewColumn(info, &ProcessTreeContextType, DNPRTNC_GEN0COLLECTIONS, FALSE, L".NET Gen 0 collections", 70, PH_ALIGN_RIGHT, DT_RIGHT, TRUE, ProcessTreeNewSortFunction);
+    AddTreeNewColumn(info, &ProcessTreeContextType, DNPRTNC_GEN1COLLECTIONS, FALSE, L".NET Gen 1 collections", 70, PH_ALIGN_RIGHT, DT_RIGHT, TRUE, ProcessTreeNewSortFunction);
+    AddTreeNewColumn(info, &ProcessTreeContextType, DNPRTNC_GEN2COLLECTIONS, FALSE, L".NET Gen 2 collections", 70, PH_ALIGN_RIGHT, DT_RIGHT, TRUE, ProcessTreeNewSortFunction);
+    AddTreeNewColumn(info, &ProcessTreeContextType, DNPRTNC_TIMEINGC, FALSE, L".NET % time in GC", 50, PH_ALIGN_RIGHT, DT_RIGHT, TRUE, ProcessTreeNewSortFunction);
+    AddTreeNewColumn(info, &ProcessTreeContextType, DNPRTNC_EXCEPTIONSTHROWN, FALSE, L".NET exceptions thrown", 70, PH_ALIGN_RIGHT, DT_RIGHT, TRUE, ProcessTreeNewSortFunction);
+}
+
+_Success_(return)
+static BOOLEAN QueryProcessNodeCounters(
+    _In_ PPH_PROCESS_ITEM ProcessItem,
+    _Out_ PDN_PERF_COUNTERS Counters
+    )
+{
+    PDN_PROCESS_ITEM dotNetProcess;
+
+    if (!ProcessItem->IsDotNet)
+        return FALSE;
+
+    dotNetProcess = GetDotNetProcessItem(ProcessItem);
+
+    // The tree only asks for the visible rows, so this tells the sampler which processes
+    // actually need their counters read on the next tick.
+    TouchDotNetProcessCounters(dotNetProcess);
+
+    return QueryDotNetProcessCounters(dotNetProcess, Counters);
+}
+
+static ULONG64 GetProcessNodeCounterValue(
+    _In_ PDN_PERF_COUNTERS Counters,
+    _In_ ULONG SubId
+    )
+{
+    switch (SubId)
+    {
+    case DNPRTNC_GCHEAPBYTES:
+        // Same total as the "# Bytes in all Heaps" counter on the performance page.
+        return Counters->GC.cGenHeapSize[1] + Counters->GC.cGenHeapSize[2] + Counters->GC.cLrgObjSize;
+    case DNPRTNC_GEN0COLLECTIONS:
+        return Counters->GC.cGenCollections[0];
+    case DNPRTNC_GEN1COLLECTIONS:
+        return Counters->GC.cGenCollections[1];
+    case DNPRTNC_GEN2COLLECTIONS:
+        return Counters->GC.cGenCollections[2];
+    case DNPRTNC_EXCEPTIONSTHROWN:
+        return Counters->Exceptions.cThrown.Total;
+    }
+
+    return 0;
+}
+
+static FLOAT GetProcessNodeTimeInGc(
+    _In_ PDN_PERF_COUNTERS Counters
+    )
+{
+    if (Counters->GC.timeInGCBase == 0)
+        return 0;
+
+    return (FLOAT)Counters->GC.timeInGC * 100 / (FLOAT)Counters->GC.timeInGCBase;
+}
+
+VOID ProcessTreeNewMessage(
+    _In_ PVOID Parameter
+    )
+{
+    PPH_PLUGIN_TREENEW_MESSAGE message = Parameter;
+
+    if (message->Message == TreeNewGetCellText)
+    {
+        PPH_TREENEW_GET_CELL_TEXT getCellText = message->Parameter1;
+        PPH_PROCESS_NODE processNode = (PPH_PROCESS_NODE)getCellText->Node;
+        PDN_PROCESS_ITEM dotNetProcess;
+        DN_PERF_COUNTERS counters;
+        PPH_STRING text;
+
+        if (message->SubId >= DNPRTNC_MAXIMUM)
+            return;
+
+        if (!QueryProcessNodeCounters(processNode->ProcessItem, &counters))
+            return;
+
+        if (message->SubId == DNPRTNC_TIMEINGC)
+        {
+            PH_FORMAT format[1];
+
+            PhInitFormatF(&format[0], GetProcessNodeTimeInGc(&counters), 2);
+            text = PhFormat(format, RTL_NUMBER_OF(format), 0);
+        }
+        else if (message->SubId == DNPRTNC_GCHEAPBYTES)
+        {
+            text = PhFormatSize(GetProcessNodeCounterValue(&counters, message->SubId), ULONG_MAX);
+        }
+        else
+        {
+            text = PhFormatUInt64(GetProcessNodeCounterValue(&counters, message->SubId), TRUE);
+        }
+
+        dotNetProcess = GetDotNetProcessItem(processNode->ProcessItem);
+        PhMoveReference(&dotNetProcess->TextCache[message->SubId], text);
+        getCellText->Text = dotNetProcess->TextCache[message->SubId]->sr;
+    }
+}
+
+LONG ProcessTreeNewSortFunction(
+    _In_ PVOID Node1,
+    _In_ PVOID Node2,
+    _In_ ULONG SubId,
+    _In_ PH_SORT_ORDER SortOrder,
+    _In_ PVOID Context
+    )
+{
+    PPH_PROCESS_NODE node1 = Node1;
+    PPH_PROCESS_NODE node2 = Node2;
+    DN_PERF_COUNTERS counters1;
+    DN_PERF_COUNTERS counters2;
+
+    if (!QueryProcessNodeCounters(node1->ProcessItem, &counters1))
+        memset(&counters1, 0, sizeof(DN_PERF_COUNTERS));
+    if (!QueryProcessNodeCounters(node2->ProcessItem, &counters2))
+        memset(&counters2, 0, sizeof(DN_PERF_COUNTERS));
+
+    if (SubId == DNPRTNC_TIMEINGC)
+        return singlecmp(GetProcessNodeTimeInGc(&counters1), GetProcessNodeTimeInGc(&counters2));
+
+    return uint64cmp(GetProcessNodeCounterValue(&counters1, SubId), GetProcessNodeCounterValue(&counters2, SubId));
+}
@@ -59,6 +59,7 @@ static GUID DiskIoGuid_I = { 0x3d6fa8d4, 0xfe05, 0x11d0, { 0x9d, 0xda, 0x00, 0xc
 static GUID FileIoGuid_I = { 0x90cbdc39, 0x4a3e, 0x11d1, { 0x84, 0xf4, 0x00, 0x00, 0xf8, 0x04, 0x64, 0xe3 } };
 static GUID TcpIpGuid_I = { 0x9a280ac0, 0xc8e0, 0x11d1, { 0x84, 0xe2, 0x00, 0xc0, 0x4f, 0xb9, 0x98, 0xa2 } };
 static GUID UdpIpGuid_I = { 0xbf3a50c5, 0xa9c9, 0x4988, { 0xa0, 0x05, 0x2d, 0xf0, 0xb7, 0xc8, 0x0f, 0x80 } };
+static GUID ProcessGuid_I = { 0x3d6fa8d0, 0xfe05, 0x11d0, { 0x9d, 0xda, 0x00, 0xc0, 0x4f, 0xd7, 0xba, 0x7c } };
 
 // ETW tracing layer
 
@@ -73,6 +74,7 @@ static PEVENT_TRACE_PROPERTIES EtpTraceProperties = NULL;
 static BOOLEAN EtpEtwActive = FALSE;
 static BOOLEAN EtpStartedSession = FALSE;
 static BOOLEAN EtpEtwExiting = FALSE;
+static BOOLEAN EtpProcessEventsEnabled = FALSE;
 
 // ETW rundown layer
 
@@ -87,6 +89,8 @@ VOID EtEtwMonitorInitialization(
 {
     if (PhGetOwnTokenAttributes().Elevated && PhGetIntegerSetting(SETTING_NAME_ENABLE_ETW_MONITOR))
     {
+        EtpProcessEventsEnabled = !!PhGetIntegerSetting(SETTING_NAME_ENABLE_ETW_PROCESS_EVENTS);
+
         EtStartEtwSession();
 
         if (EtEtwEnabled)
@@ -150,6 +154,20 @@ VOID EtStartEtwSession(
     if (WindowsVersion >= WINDOWS_8)
         EtpTraceProperties->LogFileMode |= EVENT_TRACE_SYSTEM_LOGGER_MODE;
 
+    // The process start and end events are passed to the process provider, so new and terminated
+    // processes are shown without waiting for the next update. The buffers are flushed more often
+    // so that the events aren't delayed by up to a second.
+    if (EtpProcessEventsEnabled)
+    {
+        EtpTraceProperties->EnableFlags |= EVENT_TRACE_FLAG_PROCESS;
+
+        if (WindowsVersion >= WINDOWS_8)
+        {
+            EtpTraceProperties->LogFileMode |= EVENT_TRACE_USE_MS_FLUSH_TIMER;
+            EtpTraceProperties->FlushTimer = 100;
+        }
+    }
+
     EtEtwStatus = StartTrace(&EtpSessionHandle, EtpActualKernelLoggerName->Buffer, EtpTraceProperties);
 
     if (EtEtwStatus == ERROR_SUCCESS)
@@ -212,6 +230,48 @@ ULONG NTAPI EtpEtwBufferCallback(
     return !EtpEtwExiting;
 }
 
+PPH_STRING EtpGetProcessEventImageName(
+    _In_ PEVENT_RECORD EventRecord,
+    _In_ ULONG Offset,
+    _In_ ULONG PointerSize
+    )
+{
+    PUCHAR data = EventRecord->UserData;
+    ULONG length = EventRecord->UserDataLength;
+    SIZE_T nameLength;
+
+    // UserSID is a TOKEN_USER structure followed by the SID, or a zero ULONG if there is no SID.
+
+    if (Offset + sizeof(ULONG) > length)
+        return NULL;
+
+    if (*(PULONG)PTR_ADD_OFFSET(data, Offset) == 0)
+    {
+        Offset += sizeof(ULONG);
+    }
+    else
+    {
+        Offset += PointerSize * 2;
+
+        if (Offset + RtlLengthRequiredSid(0) > length)
+            return NULL;
+
+        Offset += RtlLengthRequiredSid(((PISID)PTR_ADD_OFFSET(data, Offset))->SubAuthorityCount);
+    }
+
+    // ImageFileName is a null-terminated ANSI string.
+
+    if (Offset >= length)
+        return NULL;
+
+    nameLength = strnlen(PTR_ADD_OFFSET(data, Offset), length - Offset);
+
+    if (nameLength == 0 || nameLength == length - Offset)
+        return NULL;
+
+    return PhConvertMultiByteToUtf16Ex(PTR_ADD_OFFSET(data, Offset), nameLength);
+}
+
 VOID NTAPI EtpEtwEventCallback(
     _In_ PEVENT_RECORD EventRecord
     )
@@ -397,6 +457,78 @@ VOID NTAPI EtpEtwEventCallback(
             EtProcessNetworkEvent(&networkEvent);
         }
     }
+    else if (IsEqualGUID(&EventRecord->EventHeader.ProviderId, &ProcessGuid_I))
+    {
+        // Process
+
+        PH_PROCESS_PROVIDER_EVENT_TYPE type;
+        ULONG processId;
+        ULONG parentId;
+        ULONG sessionId;
+        ULONG offset;
+        ULONG pointerSize;
+        PPH_STRING imageName = NULL;
+
+        if (!EtpProcessEventsEnabled || EventRecord->EventHeader.EventDescriptor.Version < 3)
+            return;
+
+        switch (EventRecord->EventHeader.EventDescriptor.Opcode)
+        {
+        case EVENT_TRACE_TYPE_START:
+            type = ProcessProviderStartedEvent;
+            break;
+        case EVENT_TRACE_TYPE_END:
+            type = ProcessProviderExitedEvent;
+            break;
+        default: // ignore the rundown events
+            return;
+        }
+
+        if (PhIsExecutingInWow64())
+        {
+            Process_TypeGroup1_Wow64 *dataWow64 = EventRecord->UserData;
+
+            if (EventRecord->UserDataLength < sizeof(Process_TypeGroup1_Wow64))
+                return;
+
+            processId = dataWow64->ProcessId;
+            parentId = dataWow64->ParentId;
+            sessionId = dataWow64->SessionId;
+            offset = sizeof(Process_TypeGroup1_Wow64);
+            pointerSize = sizeof(ULONGLONG);
+        }
+        else
+        {
+            Process_TypeGroup1 *data = EventRecord->UserData;
+
+            if (EventRecord->UserDataLength < sizeof(Process_TypeGroup1))
+                return;
+
+            processId = data->ProcessId;
+            parentId = data->ParentId;
+            sessionId = data->SessionId;
+            offset = sizeof(Process_TypeGroup1);
+            pointerSize = sizeof(ULONG_PTR);
+        }
+
+        if (EventRecord->EventHeader.EventDescriptor.Version >= 4)
+            offset += sizeof(ULONG); // Flags
+
+        // The process provider only needs the image name if the process has already exited.
+        if (type == ProcessProviderStartedEvent)
+            imageName = EtpGetProcessEventImageName(EventRecord, offset, pointerSize);
+
+        PhQueueProcessProviderEvent(
+            type,
+            UlongToHandle(processId),
+            UlongToHandle(parentId),
+            sessionId,
+            imageName
+            );
+
+        if (imageName)
+            PhDereferenceObject(imageName);
+    }
 }
 
 NTSTATUS EtpEtwMonitorThreadStart(
@@ -48,6 +48,28 @@ typedef struct
     USHORT sport;
 } TcpIpOrUdpIp_IPV6_Header;
 
+typedef struct
+{
+    ULONG_PTR UniqueProcessKey;
+    ULONG ProcessId;
+    ULONG ParentId;
+    ULONG SessionId;
+    LONG ExitStatus;
+    ULONG_PTR DirectoryTableBase;
+    // ULONG Flags; // since WIN8 (Process_V4_TypeGroup1)
+    // UserSID, ImageFileName, CommandLine...
+} Process_TypeGroup1; // since WIN7 (Process_V3_TypeGroup1)
+
+typedef struct
+{
+    ULONGLONG UniqueProcessKey;
+    ULONG ProcessId;
+    ULONG ParentId;
+    ULONG SessionId;
+    LONG ExitStatus;
+    ULONGLONG DirectoryTableBase;
+} Process_TypeGroup1_Wow64;
+
 // etwmon
 
 VOID EtEtwMonitorInitialization(
@@ -25,6 +25,7 @@ extern ULONG ProcessesUpdatedCount;
 #define SETTING_NAME_ENABLE_GPUPERFCOUNTERS (PLUGIN_NAME L".EnableGpuPerformanceCounters")
 #define SETTING_NAME_ENABLE_DISKEXT (PLUGIN_NAME L".EnableDiskExt")
 #define SETTING_NAME_ENABLE_ETW_MONITOR (PLUGIN_NAME L".EnableEtwMonitor")
+#define SETTING_NAME_ENABLE_ETW_PROCESS_EVENTS (PLUGIN_NAME L".EnableEtwProcessEvents")
 #define SETTING_NAME_ENABLE_GPU_MONITOR (PLUGIN_NAME L".EnableGpuMonitor")
 #define SETTING_NAME_ENABLE_SYSINFO_GRAPHS (PLUGIN_NAME L".EnableSysInfoGraphs")
 #define SETTING_NAME_GPU_NODE_BITMAP (PLUGIN_NAME L".GpuNodeBitmap")
@@ -285,6 +286,9 @@ typedef struct _ET_PROCESS_BLOCK
     PH_UINT64_DELTA NetworkSendRawDelta;
 
     PH_UINT64_DELTA GpuRunningTimeDelta;
+    ULONG64 GpuLastSampleTime; // performance counter value at the last D3DKMT sample
+    ULONG GpuLastDemandRunCount; // last update in which the GPU statistics were displayed
+    LONG GpuStatisticsReferenceCount; // number of open pages displaying the GPU statistics
     //PPH_UINT64_DELTA GpuTotalRunningTimeDelta;
     //PPH_CIRCULAR_BUFFER_FLOAT GpuTotalNodesHistory;
 
@@ -537,6 +541,10 @@ VOID EtQueryProcessGpuStatistics(
     _Out_ PET_PROCESS_GPU_STATISTICS Statistics
     );
 
+VOID EtTouchProcessGpuStatistics(
+    _In_ PET_PROCESS_BLOCK Block
+    );
+
 // gpudetails
 
 VOID EtShowGpuDetailsDialog(
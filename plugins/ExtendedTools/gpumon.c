@@ -53,6 +53,15 @@ ULONG64 EtGpuSharedUsage = 0;
 PH_CIRCULAR_BUFFER_ULONG64 EtGpuDedicatedHistory;
 PH_CIRCULAR_BUFFER_ULONG64 EtGpuSharedHistory;
 
+// Processes whose GPU statistics are being displayed are sampled on every update, the rest
+// only every ET_GPU_BACKGROUND_SAMPLE_INTERVAL updates (staggered by process ID so the
+// cost is spread evenly). A process stays in the displayed set for ET_GPU_DEMAND_TIMEOUT
+// updates after its statistics were last requested.
+#define ET_GPU_BACKGROUND_SAMPLE_INTERVAL 5
+#define ET_GPU_DEMAND_TIMEOUT 2
+
+static ULONG EtpGpuRunCount = 0; // MUST keep in sync with runCount in process provider
+
 VOID EtGpuMonitorInitialization(
     VOID
     )
@@ -738,7 +747,7 @@ PETP_GPU_ADAPTER EtpAllocateGpuAdapter(
     return adapter;
 }
 
-VOID EtpUpdateProcessSegmentInformation(
+VOID EtpUpdateProcessGpuInformation(
     _In_ PET_PROCESS_BLOCK Block
     )
 {
@@ -747,6 +756,8 @@ VOID EtpUpdateProcessSegmentInformation(
     ULONG64 dedicatedUsage;
     ULONG64 sharedUsage;
     ULONG64 commitUsage;
+    ULONG64 totalRunningTime;
+    ULONG64 totalContextSwitches;
 
     if (!Block->ProcessItem->QueryHandle)
         return;
@@ -754,11 +765,28 @@ VOID EtpUpdateProcessSegmentInformation(
     dedicatedUsage = 0;
     sharedUsage = 0;
     commitUsage = 0;
+    totalRunningTime = 0;
+    totalContextSwitches = 0;
+
+    // Query each adapter in a single pass. The process-wide query comes first since it fails when
+    // the process has never opened the adapter, and in that case there are no segment or node
+    // statistics to query either. Most processes never touch the GPU, so this turns
+    // (segments + nodes + 1) queries per adapter into one.
 
     for (ULONG i = 0; i < EtpGpuAdapterList->Count; i++)
     {
         gpuAdapter = EtpGpuAdapterList->Items[i];
 
+        memset(&queryStatistics, 0, sizeof(D3DKMT_QUERYSTATISTICS));
+        queryStatistics.Type = D3DKMT_QUERYSTATISTICS_PROCESS;
+        queryStatistics.AdapterLuid = gpuAdapter->AdapterLuid;
+        queryStatistics.ProcessHandle = Block->ProcessItem->QueryHandle;
+
+        if (!NT_SUCCESS(D3DKMTQueryStatistics(&queryStatistics)))
+            continue;
+
+        commitUsage += queryStatistics.QueryResult.ProcessInformation.SystemMemory.BytesAllocated;
+
         for (ULONG j = 0; j < gpuAdapter->SegmentCount; j++)
         {
             memset(&queryStatistics, 0, sizeof(D3DKMT_QUERYSTATISTICS));
@@ -782,26 +810,33 @@ VOID EtpUpdateProcessSegmentInformation(
                     dedicatedUsage += bytesCommitted;
             }
         }
-    }
 
-    for (ULONG i = 0; i < EtpGpuAdapterList->Count; i++)
-    {
-        gpuAdapter = EtpGpuAdapterList->Items[i];
+        for (ULONG j = 0; j < gpuAdapter->NodeCount; j++)
+        {
+            memset(&queryStatistics, 0, sizeof(D3DKMT_QUERYSTATISTICS));
+            queryStatistics.Type = D3DKMT_QUERYSTATISTICS_PROCESS_NODE;
+            queryStatistics.AdapterLuid = gpuAdapter->AdapterLuid;
+            queryStatistics.ProcessHandle = Block->ProcessItem->QueryHandle;
+            queryStatistics.QueryProcessNode.NodeId = j;
 
-        memset(&queryStatistics, 0, sizeof(D3DKMT_QUERYSTATISTICS));
-        queryStatistics.Type = D3DKMT_QUERYSTATISTICS_PROCESS;
-        queryStatistics.AdapterLuid = gpuAdapter->AdapterLuid;
-        queryStatistics.ProcessHandle = Block->ProcessItem->QueryHandle;
+            if (NT_SUCCESS(D3DKMTQueryStatistics(&queryStatistics)))
+            {
+                //ULONG64 runningTime;
+                //runningTime = queryStatistics.QueryResult.ProcessNodeInformation.RunningTime.QuadPart;
+                //PhUpdateDelta(&Block->GpuTotalRunningTimeDelta[j], runningTime);
 
-        if (NT_SUCCESS(D3DKMTQueryStatistics(&queryStatistics)))
-        {
-            commitUsage += queryStatistics.QueryResult.ProcessInformation.SystemMemory.BytesAllocated;
+                totalRunningTime += queryStatistics.QueryResult.ProcessNodeInformation.RunningTime.QuadPart;
+                totalContextSwitches += queryStatistics.QueryResult.ProcessNodeInformation.ContextSwitch;
+            }
         }
     }
 
     Block->GpuDedicatedUsage = dedicatedUsage;
     Block->GpuSharedUsage = sharedUsage;
     Block->GpuCommitUsage = commitUsage;
+
+    PhUpdateDelta(&Block->GpuRunningTimeDelta, totalRunningTime);
+    Block->GpuContextSwitches = totalContextSwitches;
 }
 
 VOID EtpUpdateSystemSegmentInformation(
@@ -855,49 +890,6 @@ VOID EtpUpdateSystemSegmentInformation(
     EtGpuSharedUsage = sharedUsage;
 }
 
-VOID EtpUpdateProcessNodeInformation(
-    _In_ PET_PROCESS_BLOCK Block
-    )
-{
-    PETP_GPU_ADAPTER gpuAdapter;
-    D3DKMT_QUERYSTATISTICS queryStatistics;
-    ULONG64 totalRunningTime;
-    ULONG64 totalContextSwitches;
-
-    if (!Block->ProcessItem->QueryHandle)
-        return;
-
-    totalRunningTime = 0;
-    totalContextSwitches = 0;
-
-    for (ULONG i = 0; i < EtpGpuAdapterList->Count; i++)
-    {
-        gpuAdapter = EtpGpuAdapterList->Items[i];
-
-        for (ULONG j = 0; j < gpuAdapter->NodeCount; j++)
-        {
-            memset(&queryStatistics, 0, sizeof(D3DKMT_QUERYSTATISTICS));
-            queryStatistics.Type = D3DKMT_QUERYSTATISTICS_PROCESS_NODE;
-            queryStatistics.AdapterLuid = gpuAdapter->AdapterLuid;
-            queryStatistics.ProcessHandle = Block->ProcessItem->QueryHandle;
-            queryStatistics.QueryProcessNode.NodeId = j;
-
-            if (NT_SUCCESS(D3DKMTQueryStatistics(&queryStatistics)))
-            {
-                //ULONG64 runningTime;
-                //runningTime = queryStatistics.QueryResult.ProcessNodeInformation.RunningTime.QuadPart;
-                //PhUpdateDelta(&Block->GpuTotalRunningTimeDelta[j], runningTime);
-
-                totalRunningTime += queryStatistics.QueryResult.ProcessNodeInformation.RunningTime.QuadPart;
-                totalContextSwitches += queryStatistics.QueryResult.ProcessNodeInformation.ContextSwitch;
-            }
-        }
-    }
-
-    PhUpdateDelta(&Block->GpuRunningTimeDelta, totalRunningTime);
-    Block->GpuContextSwitches = totalContextSwitches;
-}
-
 VOID EtpUpdateSystemNodeInformation(
     VOID
     )
@@ -934,12 +926,39 @@ VOID EtpUpdateSystemNodeInformation(
     PhUpdateDelta(&EtClockTotalRunningTimeDelta, performanceCounter.QuadPart);
 }
 
+/**
+ * Marks the GPU statistics of a process as displayed, so that the process is sampled on every
+ * update for the next few updates.
+ *
+ * \param Block The process block.
+ */
+VOID EtTouchProcessGpuStatistics(
+    _In_ PET_PROCESS_BLOCK Block
+    )
+{
+    Block->GpuLastDemandRunCount = EtpGpuRunCount;
+}
+
+BOOLEAN EtpIsProcessGpuSampleDue(
+    _In_ PET_PROCESS_BLOCK Block
+    )
+{
+    if (Block->GpuStatisticsReferenceCount != 0)
+        return TRUE;
+    if (Block->GpuLastSampleTime == 0)
+        return TRUE;
+    if (EtpGpuRunCount - Block->GpuLastDemandRunCount <= ET_GPU_DEMAND_TIMEOUT)
+        return TRUE;
+
+    return (EtpGpuRunCount + HandleToUlong(Block->ProcessItem->ProcessId) / 4) % ET_GPU_BACKGROUND_SAMPLE_INTERVAL == 0;
+}
+
 VOID NTAPI EtGpuProcessesUpdatedCallback(
     _In_opt_ PVOID Parameter,
     _In_opt_ PVOID Context
     )
 {
-    static ULONG runCount = 0; // MUST keep in sync with runCount in process provider
+    ULONG runCount = EtpGpuRunCount;
     DOUBLE elapsedTime = 0; // total GPU node elapsed time in micro-seconds
     FLOAT tempGpuUsage = 0;
     ULONG i;
@@ -1026,13 +1045,30 @@ VOID NTAPI EtGpuProcessesUpdatedCallback(
         }
         else
         {
-            EtpUpdateProcessSegmentInformation(block);
-            EtpUpdateProcessNodeInformation(block);
+            if (EtpIsProcessGpuSampleDue(block))
+            {
+                ULONG64 lastSampleTime;
+
+                lastSampleTime = block->GpuLastSampleTime;
+                EtpUpdateProcessGpuInformation(block);
+                block->GpuLastSampleTime = EtClockTotalRunningTimeDelta.Value;
+
+                // The running time delta covers every update since the process was last sampled,
+                // so divide by the clock time over the same period.
+
+                if (lastSampleTime != 0 && block->GpuLastSampleTime > lastSampleTime)
+                {
+                    DOUBLE sampleElapsedTime;
+
+                    sampleElapsedTime = (DOUBLE)((block->GpuLastSampleTime - lastSampleTime) * 10000000ULL / EtClockTotalRunningTimeFrequency.QuadPart);
+
+                    if (sampleElapsedTime != 0)
+                        block->GpuNodeUtilization = (FLOAT)(block->GpuRunningTimeDelta.Delta / sampleElapsedTime);
+                }
+            }
 
             if (elapsedTime != 0)
             {
-                block->GpuNodeUtilization = (FLOAT)(block->GpuRunningTimeDelta.Delta / elapsedTime);
-
                 // HACK
                 if (block->GpuNodeUtilization > EtGpuNodeUsage)
                     block->GpuNodeUtilization = EtGpuNodeUsage;
@@ -1133,7 +1169,7 @@ VOID NTAPI EtGpuProcessesUpdatedCallback(
         }
     }
 
-    runCount++;
+    EtpGpuRunCount++;
 }
 
 ULONG EtGetGpuAdapterCount(
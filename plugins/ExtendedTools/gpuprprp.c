@@ -354,6 +354,7 @@ INT_PTR CALLBACK EtpGpuPageDlgProc(
             context->WindowHandle = hwndDlg;
             context->Block = EtGetProcessBlock(processItem);
             context->Enabled = TRUE;
+            InterlockedIncrement(&context->Block->GpuStatisticsReferenceCount);
             context->GpuGroupBox = GetDlgItem(hwndDlg, IDC_GROUPGPU);
             context->MemGroupBox = GetDlgItem(hwndDlg, IDC_GROUPMEM);
             context->SharedGroupBox = GetDlgItem(hwndDlg, IDC_GROUPSHARED);
@@ -382,6 +383,8 @@ INT_PTR CALLBACK EtpGpuPageDlgProc(
         break;
     case WM_DESTROY:
         {
+            InterlockedDecrement(&context->Block->GpuStatisticsReferenceCount);
+
             PhDeleteLayoutManager(&context->LayoutManager);
 
             PhDeleteGraphState(&context->GpuGraphState);
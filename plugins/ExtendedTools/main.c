@@ -509,6 +509,8 @@ VOID NTAPI ProcessStatsEventCallback(
             if (!(block = EtGetProcessBlock(event->ProcessItem)))
                 break;
 
+            EtTouchProcessGpuStatistics(block);
+
             PhPrintTimeSpan(runningTimeString, block->GpuRunningTimeDelta.Value * 10, PH_TIMESPAN_HMSM);
             PhSetListViewSubItem(listViewHandle, block->ListViewRowCache[ET_PROCESS_STATISTICS_INDEX_RUNNINGTIME], 1,
                 runningTimeString);
@@ -697,6 +699,7 @@ LOGICAL DllMain(
                 { IntegerSettingType, SETTING_NAME_ENABLE_GPUPERFCOUNTERS, L"0" },
                 { IntegerSettingType, SETTING_NAME_ENABLE_DISKEXT, L"1" },
                 { IntegerSettingType, SETTING_NAME_ENABLE_ETW_MONITOR, L"1" },
+                { IntegerSettingType, SETTING_NAME_ENABLE_ETW_PROCESS_EVENTS, L"0" },
                 { IntegerSettingType, SETTING_NAME_ENABLE_GPU_MONITOR, L"1" },
                 { IntegerSettingType, SETTING_NAME_ENABLE_SYSINFO_GRAPHS, L"1" },
                 { StringSettingType, SETTING_NAME_GPU_NODE_BITMAP, L"01000000" },
@@ -22,6 +22,43 @@
 
 #include "exttools.h"
 
+static BOOLEAN RestartRequired = FALSE;
+
+#define SetSettingForDlgItemCheckRestartRequired(hwndDlg, Id, Name) \
+{ \
+    BOOLEAN __oldValue = !!PhGetIntegerSetting(Name); \
+    BOOLEAN __newValue = Button_GetCheck(GetDlgItem(hwndDlg, Id)) == BST_CHECKED; \
+    if (__newValue != __oldValue) \
+        RestartRequired = TRUE; \
+    PhSetIntegerSetting(Name, __newValue); \
+}
+
+static VOID NTAPI EtpOptionsRestartRequiredCallback(
+    _In_opt_ PVOID Context
+    )
+{
+    if (PhShowMessage2(
+        PhMainWndHandle,
+        TDCBF_YES_BUTTON | TDCBF_NO_BUTTON,
+        TD_INFORMATION_ICON,
+        L"One or more options you have changed requires a restart of Process Hacker.",
+        L"Do you want to restart Process Hacker now?"
+        ) == IDYES)
+    {
+        ProcessHacker_PrepareForEarlyShutdown(PhMainWndHandle);
+        PhShellProcessHacker(
+            PhMainWndHandle,
+            L"-v",
+            SW_SHOW,
+            0,
+            PH_SHELL_APP_PROPAGATE_PARAMETERS | PH_SHELL_APP_PROPAGATE_PARAMETERS_IGNORE_VISIBILITY,
+            0,
+            NULL
+            );
+        ProcessHacker_Destroy(PhMainWndHandle);
+    }
+}
+
 INT_PTR CALLBACK OptionsDlgProc(
     _In_ HWND hwndDlg,
     _In_ UINT uMsg,
@@ -33,16 +70,26 @@ INT_PTR CALLBACK OptionsDlgProc(
     {
     case WM_INITDIALOG:
         {
+            RestartRequired = FALSE;
+
             Button_SetCheck(GetDlgItem(hwndDlg, IDC_ENABLEETWMONITOR), PhGetIntegerSetting(SETTING_NAME_ENABLE_ETW_MONITOR) ? BST_CHECKED : BST_UNCHECKED);
             Button_SetCheck(GetDlgItem(hwndDlg, IDC_ENABLEGPUMONITOR), PhGetIntegerSetting(SETTING_NAME_ENABLE_GPU_MONITOR) ? BST_CHECKED : BST_UNCHECKED);
             Button_SetCheck(GetDlgItem(hwndDlg, IDC_ENABLESYSINFOGRAPHS), PhGetIntegerSetting(SETTING_NAME_ENABLE_SYSINFO_GRAPHS) ? BST_CHECKED : BST_UNCHECKED);
+            Button_SetCheck(GetDlgItem(hwndDlg, IDC_ENABLEPROCESSEVENTS), PhGetIntegerSetting(SETTING_NAME_ENABLE_ETW_PROCESS_EVENTS) ? BST_CHECKED : BST_UNCHECKED);
         }
         break;
     case WM_DESTROY:
         {
-            PhSetIntegerSetting(SETTING_NAME_ENABLE_ETW_MONITOR, Button_GetCheck(GetDlgItem(hwndDlg, IDC_ENABLEETWMONITOR)) == BST_CHECKED);
-            PhSetIntegerSetting(SETTING_NAME_ENABLE_GPU_MONITOR, Button_GetCheck(GetDlgItem(hwndDlg, IDC_ENABLEGPUMONITOR)) == BST_CHECKED);
-            PhSetIntegerSetting(SETTING_NAME_ENABLE_SYSINFO_GRAPHS, Button_GetCheck(GetDlgItem(hwndDlg, IDC_ENABLESYSINFOGRAPHS)) == BST_CHECKED);
+            // These settings are only read when the plugin is loaded. The ETW session flags, for
+            // example, are chosen when the session is started.
+            SetSettingForDlgItemCheckRestartRequired(hwndDlg, IDC_ENABLEETWMONITOR, SETTING_NAME_ENABLE_ETW_MONITOR);
+            SetSettingForDlgItemCheckRestartRequired(hwndDlg, IDC_ENABLEGPUMONITOR, SETTING_NAME_ENABLE_GPU_MONITOR);
+            SetSettingForDlgItemCheckRestartRequired(hwndDlg, IDC_ENABLESYSINFOGRAPHS, SETTING_NAME_ENABLE_SYSINFO_GRAPHS);
+            SetSettingForDlgItemCheckRestartRequired(hwndDlg, IDC_ENABLEPROCESSEVENTS, SETTING_NAME_ENABLE_ETW_PROCESS_EVENTS);
+
+            // The prompt is shown after the options window has closed.
+            if (RestartRequired)
+                ProcessHacker_Invoke(PhMainWndHandle, EtpOptionsRestartRequiredCallback, NULL);
         }
         break;
     }
@@ -77,6 +77,7 @@
 #define IDC_GROUPNETWORK                1089
 #define IDC_DETAILS                     1092
 #define IDC_GPULIST                     1093
+#define IDC_ENABLEPROCESSEVENTS         1094
 #define ID_DISK_GOTOPROCESS             40005
 #define ID_DISK_COPY                    40006
 #define ID_DISK_PROPERTIES              40007
@@ -89,7 +90,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        145
 #define _APS_NEXT_COMMAND_VALUE         40009
-#define _APS_NEXT_CONTROL_VALUE         1094
+#define _APS_NEXT_CONTROL_VALUE         1095
 #define _APS_NEXT_SYMED_VALUE           135
 #endif
 #endif
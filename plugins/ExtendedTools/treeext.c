@@ -252,6 +252,11 @@ VOID EtProcessTreeNewMessage(
         processNode = (PPH_PROCESS_NODE)getCellText->Node;
         block = EtGetProcessBlock(processNode->ProcessItem);
 
+        // The tree only asks for the text of visible rows, so this tells the GPU monitor which
+        // processes are actually being displayed.
+        if (message->SubId == ETPRTNC_GPU || message->SubId == ETPRTNC_GPUDEDICATEDBYTES || message->SubId == ETPRTNC_GPUSHAREDBYTES)
+            EtTouchProcessGpuStatistics(block);
+
         PhAcquireQueuedLockExclusive(&block->TextCacheLock);
 
         if (block->TextCacheValid[message->SubId])
@@ -606,12 +611,18 @@ LONG EtpProcessTreeNewSortFunction(
         result = uintcmp(block1->ProcessItem->PeakNumberOfThreads, block2->ProcessItem->PeakNumberOfThreads);
         break;
     case ETPRTNC_GPU:
+        EtTouchProcessGpuStatistics(block1);
+        EtTouchProcessGpuStatistics(block2);
         result = singlecmp(block1->GpuNodeUtilization, block2->GpuNodeUtilization);
         break;
     case ETPRTNC_GPUDEDICATEDBYTES:
+        EtTouchProcessGpuStatistics(block1);
+        EtTouchProcessGpuStatistics(block2);
         result = uint64cmp(block1->GpuDedicatedUsage, block2->GpuDedicatedUsage);
         break;
     case ETPRTNC_GPUSHAREDBYTES:
+        EtTouchProcessGpuStatistics(block1);
+        EtTouchProcessGpuStatistics(block2);
         result = uint64cmp(block1->GpuSharedUsage, block2->GpuSharedUsage);
         break;
     case ETPRTNC_DISKREADRATE:
@@ -29,6 +29,14 @@ BOOLEAN GeoDbExpired = FALSE;
 HIMAGELIST GeoImageList = NULL;
 static MMDB_s GeoDbCountry = { 0 };
 
+static VOID GeoDbInitializeCache(
+    VOID
+    );
+
+static VOID GeoDbDeleteCache(
+    VOID
+    );
+
 PPH_STRING NetToolsGetGeoLiteDbPath(
     _In_ PWSTR SettingName
     )
@@ -95,6 +103,7 @@ VOID LoadGeoLiteDb(
 
         if (GeoDbLoaded)
         {
+            GeoDbInitializeCache();
             GeoImageList = ImageList_Create(16, 11, ILC_COLOR32, 20, 20);
         }
 
@@ -114,6 +123,7 @@ VOID FreeGeoLiteDb(
 
     if (GeoDbLoaded)
     {
+        GeoDbDeleteCache();
         MMDB_close(&GeoDbCountry);
     }
 }
@@ -237,79 +247,301 @@ BOOLEAN GeoDbGetContinentData(
     return FALSE;
 }
 
+// The database is already mapped by MMDB_MODE_MMAP, but walking its search tree and
+// decoding the country record still costs a few microseconds per connection. Results
+// are cached in a binary prefix trie using the netmask reported by the database, so
+// every address in the same network block resolves without touching the database.
+// Country strings are interned, lookups only hand out references.
+
+typedef struct _GEODB_COUNTRY
+{
+    PPH_STRING CountryCode;
+    PPH_STRING CountryName;
+    INT IconIndex;
+} GEODB_COUNTRY, *PGEODB_COUNTRY;
+
+typedef struct _GEODB_TRIE_NODE
+{
+    ULONG Child[2];
+    PGEODB_COUNTRY Country;
+    BOOLEAN Terminal;
+} GEODB_TRIE_NODE, *PGEODB_TRIE_NODE;
+
+#define GEODB_TRIE_MAX_NODES 0x10000
+
+static PH_QUEUED_LOCK GeoDbCacheLock = PH_QUEUED_LOCK_INIT;
+static PGEODB_TRIE_NODE GeoDbTrieNodes = NULL;
+static ULONG GeoDbTrieNodeCount = 0;
+static ULONG GeoDbTriePrefixCount = 0;
+static PPH_HASHTABLE GeoDbCountryHashtable = NULL;
+static ULONG64 GeoDbCacheHits = 0;
+static ULONG64 GeoDbCacheMisses = 0;
+
+static BOOLEAN GeoDbCountryHashtableEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PGEODB_COUNTRY country1 = *(PGEODB_COUNTRY *)Entry1;
+    PGEODB_COUNTRY country2 = *(PGEODB_COUNTRY *)Entry2;
+
+    return PhEqualString(country1->CountryCode, country2->CountryCode, TRUE);
+}
+
+static ULONG GeoDbCountryHashtableHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PGEODB_COUNTRY country = *(PGEODB_COUNTRY *)Entry;
+
+    return PhHashStringRef(&country->CountryCode->sr, TRUE);
+}
+
+static VOID GeoDbResetTrie(
+    VOID
+    )
+{
+    // Node 0 is the root.
+    memset(&GeoDbTrieNodes[0], 0, sizeof(GEODB_TRIE_NODE));
+    GeoDbTrieNodeCount = 1;
+    GeoDbTriePrefixCount = 0;
+}
+
+static VOID GeoDbInitializeCache(
+    VOID
+    )
+{
+    GeoDbTrieNodes = PhAllocate(sizeof(GEODB_TRIE_NODE) * GEODB_TRIE_MAX_NODES);
+    GeoDbResetTrie();
+
+    GeoDbCountryHashtable = PhCreateHashtable(
+        sizeof(PGEODB_COUNTRY),
+        GeoDbCountryHashtableEqualFunction,
+        GeoDbCountryHashtableHashFunction,
+        64
+        );
+}
+
+static VOID GeoDbDeleteCache(
+    VOID
+    )
+{
+    if (GeoDbCountryHashtable)
+    {
+        PH_HASHTABLE_ENUM_CONTEXT enumContext;
+        PGEODB_COUNTRY *entry;
+
+        PhBeginEnumHashtable(GeoDbCountryHashtable, &enumContext);
+
+        while (entry = PhNextEnumHashtable(&enumContext))
+        {
+            PhDereferenceObject((*entry)->CountryCode);
+            PhDereferenceObject((*entry)->CountryName);
+            PhFree(*entry);
+        }
+
+        PhDereferenceObject(GeoDbCountryHashtable);
+        GeoDbCountryHashtable = NULL;
+    }
+
+    if (GeoDbTrieNodes)
+    {
+        PhFree(GeoDbTrieNodes);
+        GeoDbTrieNodes = NULL;
+    }
+}
+
+FORCEINLINE ULONG GeoDbGetAddressBit(
+    _In_reads_bytes_(16) PUCHAR Address,
+    _In_ ULONG Bit
+    )
+{
+    return (Address[Bit >> 3] >> (7 - (Bit & 7))) & 1;
+}
+
 _Success_(return)
-BOOLEAN LookupCountryCode(
-    _In_ PH_IP_ADDRESS RemoteAddress,
-    _Out_ PPH_STRING *CountryCode,
-    _Out_ PPH_STRING *CountryName
+static BOOLEAN GeoDbLookupTrie(
+    _In_reads_bytes_(16) PUCHAR Address,
+    _Out_ PGEODB_COUNTRY *Country
+    )
+{
+    ULONG index = 0;
+
+    for (ULONG bit = 0; bit <= 128; bit++)
+    {
+        PGEODB_TRIE_NODE node = &GeoDbTrieNodes[index];
+
+        if (node->Terminal)
+        {
+            *Country = node->Country;
+            return TRUE;
+        }
+
+        if (bit == 128 || !(index = node->Child[GeoDbGetAddressBit(Address, bit)]))
+            break;
+    }
+
+    return FALSE;
+}
+
+static VOID GeoDbInsertTrie(
+    _In_reads_bytes_(16) PUCHAR Address,
+    _In_ ULONG PrefixLength,
+    _In_opt_ PGEODB_COUNTRY Country
+    )
+{
+    ULONG index = 0;
+
+    if (PrefixLength > 128)
+        PrefixLength = 128;
+
+    // Flush the whole trie when it fills up. The working set of remote networks is
+    // usually small and repopulating it is cheap compared to tracking usage.
+    if (GeoDbTrieNodeCount + PrefixLength > GEODB_TRIE_MAX_NODES)
+        GeoDbResetTrie();
+
+    for (ULONG bit = 0; bit < PrefixLength; bit++)
+    {
+        ULONG direction = GeoDbGetAddressBit(Address, bit);
+
+        if (!GeoDbTrieNodes[index].Child[direction])
+        {
+            memset(&GeoDbTrieNodes[GeoDbTrieNodeCount], 0, sizeof(GEODB_TRIE_NODE));
+            GeoDbTrieNodes[index].Child[direction] = GeoDbTrieNodeCount;
+            GeoDbTrieNodeCount++;
+        }
+
+        index = GeoDbTrieNodes[index].Child[direction];
+    }
+
+    GeoDbTrieNodes[index].Terminal = TRUE;
+    GeoDbTrieNodes[index].Country = Country;
+    GeoDbTriePrefixCount++;
+}
+
+static PGEODB_COUNTRY GeoDbInternCountry(
+    _In_ PPH_STRING CountryCode,
+    _In_ PPH_STRING CountryName
+    )
+{
+    GEODB_COUNTRY lookupCountry;
+    PGEODB_COUNTRY lookupCountryPtr = &lookupCountry;
+    PGEODB_COUNTRY *entry;
+    PGEODB_COUNTRY country;
+
+    lookupCountry.CountryCode = CountryCode;
+
+    if (entry = PhFindEntryHashtable(GeoDbCountryHashtable, &lookupCountryPtr))
+    {
+        PhDereferenceObject(CountryCode);
+        PhDereferenceObject(CountryName);
+        return *entry;
+    }
+
+    country = PhAllocate(sizeof(GEODB_COUNTRY));
+    country->CountryCode = CountryCode;
+    country->CountryName = CountryName;
+    country->IconIndex = INT_MAX;
+
+    PhAddEntryHashtable(GeoDbCountryHashtable, &country);
+
+    return country;
+}
+
+_Success_(return)
+static BOOLEAN GeoDbLookupCountry(
+    _In_reads_bytes_(16) PUCHAR Address,
+    _In_ BOOLEAN Ipv4,
+    _Out_ PGEODB_COUNTRY *Country
     )
 {
     MMDB_lookup_result_s mmdb_result;
+    PGEODB_COUNTRY country = NULL;
     INT mmdb_error = 0;
 
-    if (!GeoDbLoaded)
-        return FALSE;
+    PhAcquireQueuedLockExclusive(&GeoDbCacheLock);
 
-    if (RemoteAddress.Type == PH_IPV4_NETWORK_TYPE)
+    if (GeoDbLookupTrie(Address, &country))
     {
-        SOCKADDR_IN ipv4SockAddr;
+        GeoDbCacheHits++;
+        PhReleaseQueuedLockExclusive(&GeoDbCacheLock);
 
-        if (
-            IN4_IS_ADDR_UNSPECIFIED(&RemoteAddress.InAddr) ||
-            IN4_IS_ADDR_LOOPBACK(&RemoteAddress.InAddr) ||
-            IN4_IS_ADDR_RFC1918(&RemoteAddress.InAddr)
-            )
-        {
+        if (!country)
             return FALSE;
-        }
 
-        memset(&ipv4SockAddr, 0, sizeof(SOCKADDR_IN));
-        memset(&mmdb_result, 0, sizeof(MMDB_lookup_result_s));
+        *Country = country;
+        return TRUE;
+    }
+
+    GeoDbCacheMisses++;
+
+    memset(&mmdb_result, 0, sizeof(MMDB_lookup_result_s));
 
+    if (Ipv4)
+    {
+        SOCKADDR_IN ipv4SockAddr;
+
+        memset(&ipv4SockAddr, 0, sizeof(SOCKADDR_IN));
         ipv4SockAddr.sin_family = AF_INET;
-        ipv4SockAddr.sin_addr = RemoteAddress.InAddr;
+        memcpy(&ipv4SockAddr.sin_addr, Address + 12, sizeof(IN_ADDR));
+
+        mmdb_result = MMDB_lookup_sockaddr(&GeoDbCountry, (PSOCKADDR)&ipv4SockAddr, &mmdb_error);
 
-        mmdb_result = MMDB_lookup_sockaddr(
-            &GeoDbCountry,
-            (struct sockaddr*)&ipv4SockAddr,
-            &mmdb_error
-            );
+        // IPv4-only databases report the netmask in 32-bit space, move it into the mapped layout.
+        if (mmdb_error == 0 && GeoDbCountry.metadata.ip_version == 4)
+            mmdb_result.netmask += 96;
     }
     else
     {
         SOCKADDR_IN6 ipv6SockAddr;
 
-        if (
-            IN6_IS_ADDR_UNSPECIFIED(&RemoteAddress.In6Addr) ||
-            IN6_IS_ADDR_LOOPBACK(&RemoteAddress.In6Addr) ||
-            IN6_IS_ADDR_LINKLOCAL(&RemoteAddress.In6Addr)
-            )
-        {
-            return FALSE;
-        }
-
         memset(&ipv6SockAddr, 0, sizeof(SOCKADDR_IN6));
-        memset(&mmdb_result, 0, sizeof(MMDB_lookup_result_s));
-
         ipv6SockAddr.sin6_family = AF_INET6;
-        ipv6SockAddr.sin6_addr = RemoteAddress.In6Addr;
+        memcpy(&ipv6SockAddr.sin6_addr, Address, sizeof(IN6_ADDR));
 
-        mmdb_result = MMDB_lookup_sockaddr(
-            &GeoDbCountry,
-            (struct sockaddr*)&ipv6SockAddr,
-            &mmdb_error
-            );
+        mmdb_result = MMDB_lookup_sockaddr(&GeoDbCountry, (PSOCKADDR)&ipv6SockAddr, &mmdb_error);
     }
 
-    if (mmdb_error == 0 && mmdb_result.found_entry)
+    if (mmdb_error == 0)
     {
-        if (GeoDbGetCountryData(&mmdb_result.entry, CountryCode, CountryName))
-            return TRUE;
-        if (GeoDbGetContinentData(&mmdb_result.entry, CountryCode, CountryName))
-            return TRUE;
+        if (mmdb_result.found_entry)
+        {
+            PPH_STRING countryCode;
+            PPH_STRING countryName;
+
+            if (
+                GeoDbGetCountryData(&mmdb_result.entry, &countryCode, &countryName) ||
+                GeoDbGetContinentData(&mmdb_result.entry, &countryCode, &countryName)
+                )
+            {
+                country = GeoDbInternCountry(countryCode, countryName);
+            }
+        }
+
+        // Negative results are cached too, so unknown networks don't hit the database again.
+        GeoDbInsertTrie(Address, mmdb_result.netmask, country);
     }
 
-    return FALSE;
+    PhReleaseQueuedLockExclusive(&GeoDbCacheLock);
+
+    if (!country)
+        return FALSE;
+
+    *Country = country;
+    return TRUE;
+}
+
+_Success_(return)
+BOOLEAN LookupCountryCode(
+    _In_ PH_IP_ADDRESS RemoteAddress,
+    _Out_ PPH_STRING *CountryCode,
+    _Out_ PPH_STRING *CountryName
+    )
+{
+    if (RemoteAddress.Type == PH_IPV4_NETWORK_TYPE)
+        return LookupSockInAddr4CountryCode(RemoteAddress.InAddr, CountryCode, CountryName);
+    else
+        return LookupSockInAddr6CountryCode(RemoteAddress.In6Addr, CountryCode, CountryName);
 }
 
 _Success_(return)
@@ -319,9 +551,8 @@ BOOLEAN LookupSockInAddr4CountryCode(
     _Out_ PPH_STRING *CountryName
     )
 {
-    MMDB_lookup_result_s mmdb_result;
-    SOCKADDR_IN ipv4SockAddr;
-    INT mmdb_error = 0;
+    PGEODB_COUNTRY country;
+    UCHAR address[16];
 
     if (!GeoDbLoaded)
         return FALSE;
@@ -335,24 +566,16 @@ BOOLEAN LookupSockInAddr4CountryCode(
         return FALSE;
     }
 
-    memset(&ipv4SockAddr, 0, sizeof(SOCKADDR_IN));
-    memset(&mmdb_result, 0, sizeof(MMDB_lookup_result_s));
-
-    ipv4SockAddr.sin_family = AF_INET;
-    ipv4SockAddr.sin_addr = RemoteAddress;
-
-    mmdb_result = MMDB_lookup_sockaddr(
-        &GeoDbCountry,
-        (PSOCKADDR)&ipv4SockAddr,
-        &mmdb_error
-        );
+    // IPv4 addresses are cached as IPv4-compatible addresses (::a.b.c.d), the same
+    // layout the database uses for its IPv4 subtree.
+    memset(address, 0, 12);
+    memcpy(address + 12, &RemoteAddress, sizeof(IN_ADDR));
 
-    if (mmdb_error == 0 && mmdb_result.found_entry)
+    if (GeoDbLookupCountry(address, TRUE, &country))
     {
-        if (GeoDbGetCountryData(&mmdb_result.entry, CountryCode, CountryName))
-            return TRUE;
-        if (GeoDbGetContinentData(&mmdb_result.entry, CountryCode, CountryName))
-            return TRUE;
+        *CountryCode = PhReferenceObject(country->CountryCode);
+        *CountryName = PhReferenceObject(country->CountryName);
+        return TRUE;
     }
 
     return FALSE;
@@ -365,9 +588,7 @@ BOOLEAN LookupSockInAddr6CountryCode(
     _Out_ PPH_STRING *CountryName
     )
 {
-    MMDB_lookup_result_s mmdb_result;
-    SOCKADDR_IN6 ipv6SockAddr;
-    INT mmdb_error = 0;
+    PGEODB_COUNTRY country;
 
     if (!GeoDbLoaded)
         return FALSE;
@@ -381,29 +602,31 @@ BOOLEAN LookupSockInAddr6CountryCode(
         return FALSE;
     }
 
-    memset(&ipv6SockAddr, 0, sizeof(SOCKADDR_IN6));
-    memset(&mmdb_result, 0, sizeof(MMDB_lookup_result_s));
-
-    ipv6SockAddr.sin6_family = AF_INET6;
-    ipv6SockAddr.sin6_addr = RemoteAddress;
-
-    mmdb_result = MMDB_lookup_sockaddr(
-        &GeoDbCountry,
-        (PSOCKADDR)&ipv6SockAddr,
-        &mmdb_error
-        );
-
-    if (mmdb_error == 0 && mmdb_result.found_entry)
+    if (GeoDbLookupCountry(RemoteAddress.s6_addr, FALSE, &country))
     {
-        if (GeoDbGetCountryData(&mmdb_result.entry, CountryCode, CountryName))
-            return TRUE;
-        if (GeoDbGetContinentData(&mmdb_result.entry, CountryCode, CountryName))
-            return TRUE;
+        *CountryCode = PhReferenceObject(country->CountryCode);
+        *CountryName = PhReferenceObject(country->CountryName);
+        return TRUE;
     }
 
     return FALSE;
 }
 
+VOID QueryGeoDbCacheStatistics(
+    _Out_ PULONG64 Hits,
+    _Out_ PULONG64 Misses,
+    _Out_ PULONG Prefixes,
+    _Out_ PULONG Countries
+    )
+{
+    PhAcquireQueuedLockShared(&GeoDbCacheLock);
+    *Hits = GeoDbCacheHits;
+    *Misses = GeoDbCacheMisses;
+    *Prefixes = GeoDbTriePrefixCount;
+    *Countries = GeoDbCountryHashtable ? GeoDbCountryHashtable->Count : 0;
+    PhReleaseQueuedLockShared(&GeoDbCacheLock);
+}
+
 struct
 {
     PWSTR CountryCode;
@@ -484,13 +707,10 @@ CountryResourceTable[] =
     { L"ZA", ZA_PNG, INT_MAX }, { L"ZM", ZM_PNG, INT_MAX }, { L"ZW", ZW_PNG, INT_MAX }
 };
 
-INT LookupCountryIcon(
+static INT LookupCountryIconFromTable(
     _In_ PPH_STRING Name
     )
 {
-    if (!GeoImageList)
-        return INT_MAX;
-
     for (INT i = 0; i < ARRAYSIZE(CountryResourceTable); i++)
     {
         if (PhEqualString2(Name, CountryResourceTable[i].CountryCode, TRUE))
@@ -523,6 +743,42 @@ INT LookupCountryIcon(
     return INT_MAX;
 }
 
+INT LookupCountryIcon(
+    _In_ PPH_STRING Name
+    )
+{
+    GEODB_COUNTRY lookupCountry;
+    PGEODB_COUNTRY lookupCountryPtr = &lookupCountry;
+    PGEODB_COUNTRY *entry;
+    INT iconIndex;
+
+    if (!GeoImageList)
+        return INT_MAX;
+
+    // Interned countries remember their icon index, so the resource table is only
+    // scanned once per country.
+
+    lookupCountry.CountryCode = Name;
+
+    PhAcquireQueuedLockExclusive(&GeoDbCacheLock);
+
+    if (GeoDbCountryHashtable && (entry = PhFindEntryHashtable(GeoDbCountryHashtable, &lookupCountryPtr)))
+    {
+        if ((*entry)->IconIndex == INT_MAX)
+            (*entry)->IconIndex = LookupCountryIconFromTable(Name);
+
+        iconIndex = (*entry)->IconIndex;
+    }
+    else
+    {
+        iconIndex = LookupCountryIconFromTable(Name);
+    }
+
+    PhReleaseQueuedLockExclusive(&GeoDbCacheLock);
+
+    return iconIndex;
+}
+
 VOID DrawCountryIcon(
     _In_ HDC hdc, 
     _In_ RECT rect, 
@@ -557,6 +557,10 @@ VOID NTAPI NetworkNodeCreateCallback(
         {
             PhMoveReference(&extension->RemoteCountryCode, remoteCountryCode);
             PhMoveReference(&extension->RemoteCountryName, remoteCountryName);
+
+            // Resolve the flag now so painting the column is only an ImageList_Draw.
+            if (!GeoDbExpired)
+                extension->CountryIconIndex = LookupCountryIcon(extension->RemoteCountryCode);
         }
 
         extension->CountryValid = TRUE;
@@ -759,6 +763,8 @@ VOID NTAPI TreeNewMessageCallback(
             // Draw the column data
             if (GeoDbLoaded && !GeoDbExpired && extension->RemoteCountryCode && extension->RemoteCountryName)
             {
+                // The flag is usually resolved when the node is created, but the database may
+                // have been loaded or updated since then.
                 if (extension->CountryIconIndex == INT_MAX)
                     extension->CountryIconIndex = LookupCountryIcon(extension->RemoteCountryCode);
 
@@ -294,6 +294,13 @@ BOOLEAN LookupSockInAddr6CountryCode(
     _Out_ PPH_STRING *CountryName
     );
 
+VOID QueryGeoDbCacheStatistics(
+    _Out_ PULONG64 Hits,
+    _Out_ PULONG64 Misses,
+    _Out_ PULONG Prefixes,
+    _Out_ PULONG Countries
+    );
+
 INT LookupCountryIcon(
     _In_ PPH_STRING Name
     );
@@ -42,6 +42,28 @@ INT_PTR CALLBACK OptionsDlgProc(
 
             PhSetDialogItemText(hwndDlg, IDC_DATABASE, PhaGetStringSetting(SETTING_NAME_DB_LOCATION)->Buffer);
 
+            if (GeoDbLoaded)
+            {
+                ULONG64 cacheHits;
+                ULONG64 cacheMisses;
+                ULONG cachePrefixes;
+                ULONG cacheCountries;
+
+                QueryGeoDbCacheStatistics(&cacheHits, &cacheMisses, &cachePrefixes, &cacheCountries);
+
+                PhSetDialogItemText(hwndDlg, IDC_GEOIP_CACHESTATS, PhaFormatString(
+                    L"GeoIP lookup cache: %I64u hits, %I64u misses, %lu networks, %lu countries.",
+                    cacheHits,
+                    cacheMisses,
+                    cachePrefixes,
+                    cacheCountries
+                    )->Buffer);
+            }
+            else
+            {
+                PhSetDialogItemText(hwndDlg, IDC_GEOIP_CACHESTATS, L"GeoIP lookup cache: database not loaded.");
+            }
+
             PhInitializeLayoutManager(&LayoutManager, hwndDlg);
             PhAddLayoutItem(&LayoutManager, GetDlgItem(hwndDlg, IDC_DATABASE), NULL, PH_ANCHOR_TOP | PH_ANCHOR_LEFT | PH_ANCHOR_RIGHT);
             PhAddLayoutItem(&LayoutManager, GetDlgItem(hwndDlg, IDC_BROWSE), NULL, PH_ANCHOR_TOP | PH_ANCHOR_RIGHT);
@@ -273,6 +273,7 @@
 #define IDC_LIST_TRACERT                1030
 #define IDC_REFRESH                     1031
 #define IDC_ENABLE_EXTENDED_TCP         1032
+#define IDC_GEOIP_CACHESTATS            1033
 
 // Next default values for new objects
 // 
@@ -280,7 +281,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        107
 #define _APS_NEXT_COMMAND_VALUE         40006
-#define _APS_NEXT_CONTROL_VALUE         1033
+#define _APS_NEXT_CONTROL_VALUE         1034
 #define _APS_NEXT_SYMED_VALUE           104
 #endif
 #endif
@@ -0,0 +1,525 @@
+/*
+ * Process Hacker Online Checks -
+ *   file hash cache
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "onlnchk.h"
+
+// The cache maps a file identity (volume serial number, file id) to the hashes of the
+// file, and is only valid while the last write time and size are unchanged. The entries
+// added or updated by a batch are appended to the file, so an interrupted scan resumes
+// where it stopped. Later entries replace earlier ones with the same identity, and the
+// file is compacted on shutdown or when it would grow past the maximum number of entries.
+
+#define HASH_CACHE_MAGIC ('CHHP')
+#define HASH_CACHE_VERSION 1
+#define HASH_CACHE_MAX_ENTRIES 0x10000
+
+typedef struct _HASH_CACHE_HEADER
+{
+    ULONG Magic;
+    ULONG Version;
+    ULONG EntrySize;
+    ULONG NumberOfEntries;
+} HASH_CACHE_HEADER, *PHASH_CACHE_HEADER;
+
+typedef struct _HASH_CACHE_ENTRY
+{
+    ULONG VolumeSerialNumber;
+    ULONG Spare;
+    LARGE_INTEGER FileId;
+    LARGE_INTEGER LastWriteTime;
+    LARGE_INTEGER EndOfFile;
+    PH_FILE_HASHES Hashes;
+} HASH_CACHE_ENTRY, *PHASH_CACHE_ENTRY;
+
+static PPH_HASHTABLE HashCacheHashtable = NULL;
+static PH_QUEUED_LOCK HashCacheLock = PH_QUEUED_LOCK_INIT;
+static PPH_STRING HashCachePath = NULL;
+static PH_QUEUED_LOCK HashCacheFileLock = PH_QUEUED_LOCK_INIT; // protects the cache file and the variables below
+static ULONG HashCacheFileEntries = 0; // entries in the file, including replaced ones
+static BOOLEAN HashCacheRewrite = TRUE; // the file must be rewritten before entries can be appended
+
+static BOOLEAN NTAPI HashCacheEqualFunction(
+    _In_ PVOID Entry1,
+    _In_ PVOID Entry2
+    )
+{
+    PHASH_CACHE_ENTRY entry1 = Entry1;
+    PHASH_CACHE_ENTRY entry2 = Entry2;
+
+    return
+        entry1->VolumeSerialNumber == entry2->VolumeSerialNumber &&
+        entry1->FileId.QuadPart == entry2->FileId.QuadPart;
+}
+
+static ULONG NTAPI HashCacheHashFunction(
+    _In_ PVOID Entry
+    )
+{
+    PHASH_CACHE_ENTRY entry = Entry;
+
+    return PhHashInt64(entry->FileId.QuadPart) ^ entry->VolumeSerialNumber;
+}
+
+static PPH_STRING HashCacheGetPath(
+    VOID
+    )
+{
+    PPH_STRING path;
+
+    path = PhaGetStringSetting(SETTING_NAME_HASH_CACHE_PATH);
+    path = PH_AUTO(PhExpandEnvironmentStrings(&path->sr));
+
+    if (PhDetermineDosPathNameType(path->Buffer) == RtlPathTypeRelative)
+    {
+        PPH_STRING directory;
+
+        directory = PH_AUTO(PhGetApplicationDirectory());
+        path = PH_AUTO(PhConcatStringRef2(&directory->sr, &path->sr));
+    }
+
+    return PhReferenceObject(path);
+}
+
+static NTSTATUS LoadHashCache(
+    VOID
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle;
+    IO_STATUS_BLOCK isb;
+    HASH_CACHE_HEADER header;
+    PHASH_CACHE_ENTRY entries;
+    ULONG bufferLength;
+
+    status = PhCreateFileWin32(
+        &fileHandle,
+        HashCachePath->Buffer,
+        FILE_GENERIC_READ,
+        FILE_ATTRIBUTE_NORMAL,
+        FILE_SHARE_READ | FILE_SHARE_DELETE,
+        FILE_OPEN,
+        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+        );
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    status = NtReadFile(fileHandle, NULL, NULL, NULL, &isb, &header, sizeof(HASH_CACHE_HEADER), NULL, NULL);
+
+    if (!NT_SUCCESS(status) || isb.Information != sizeof(HASH_CACHE_HEADER))
+    {
+        if (NT_SUCCESS(status))
+            status = STATUS_FILE_CORRUPT_ERROR;
+
+        goto CleanupExit;
+    }
+
+    if (
+        header.Magic != HASH_CACHE_MAGIC ||
+        header.Version != HASH_CACHE_VERSION ||
+        header.EntrySize != sizeof(HASH_CACHE_ENTRY) ||
+        header.NumberOfEntries > HASH_CACHE_MAX_ENTRIES
+        )
+    {
+        // Incompatible or corrupt cache, start from scratch.
+        status = STATUS_FILE_CORRUPT_ERROR;
+        goto CleanupExit;
+    }
+
+    if (header.NumberOfEntries == 0)
+        goto CleanupExit;
+
+    bufferLength = header.NumberOfEntries * sizeof(HASH_CACHE_ENTRY);
+    entries = PhAllocate(bufferLength);
+
+    status = NtReadFile(fileHandle, NULL, NULL, NULL, &isb, entries, bufferLength, NULL, NULL);
+
+    if (NT_SUCCESS(status) && isb.Information == bufferLength)
+    {
+        PhAcquireQueuedLockExclusive(&HashCacheLock);
+
+        for (ULONG i = 0; i < header.NumberOfEntries; i++)
+        {
+            PHASH_CACHE_ENTRY entry;
+            BOOLEAN added;
+
+            // Appended entries replace the earlier ones.
+            entry = PhAddEntryHashtableEx(HashCacheHashtable, &entries[i], &added);
+
+            if (!added)
+                *entry = entries[i];
+        }
+
+        PhReleaseQueuedLockExclusive(&HashCacheLock);
+    }
+    else
+    {
+        if (NT_SUCCESS(status))
+            status = STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    PhFree(entries);
+
+CleanupExit:
+    NtClose(fileHandle);
+
+    if (NT_SUCCESS(status))
+    {
+        HashCacheFileEntries = header.NumberOfEntries;
+        HashCacheRewrite = FALSE;
+    }
+
+    return status;
+}
+
+/**
+ * Rewrites the cache file with the entries of the hashtable.
+ *
+ * \remarks The file lock must be held exclusively.
+ */
+static NTSTATUS WriteHashCache(
+    VOID
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle;
+    IO_STATUS_BLOCK isb;
+    HASH_CACHE_HEADER header;
+    PH_HASHTABLE_ENUM_CONTEXT enumContext;
+    PHASH_CACHE_ENTRY entry;
+    PHASH_CACHE_ENTRY entries;
+    ULONG numberOfEntries = 0;
+
+    // Create the directory if it does not exist.
+    {
+        PPH_STRING fullPath;
+        ULONG indexOfFileName;
+
+        if (fullPath = PhGetFullPath(HashCachePath->Buffer, &indexOfFileName))
+        {
+            if (indexOfFileName != ULONG_MAX)
+            {
+                PPH_STRING directory;
+
+                if (directory = PhSubstring(fullPath, 0, indexOfFileName))
+                {
+                    PhCreateDirectory(directory);
+                    PhDereferenceObject(directory);
+                }
+            }
+
+            PhDereferenceObject(fullPath);
+        }
+    }
+
+    status = PhCreateFileWin32(
+        &fileHandle,
+        HashCachePath->Buffer,
+        FILE_GENERIC_WRITE,
+        FILE_ATTRIBUTE_NORMAL,
+        FILE_SHARE_READ,
+        FILE_OVERWRITE_IF,
+        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+        );
+
+    if (!NT_SUCCESS(status))
+    {
+        HashCacheRewrite = TRUE;
+        return status;
+    }
+
+    // Take a snapshot of the entries so the lock isn't held during I/O.
+
+    PhAcquireQueuedLockShared(&HashCacheLock);
+
+    entries = PhAllocate(max(HashCacheHashtable->Count, 1) * sizeof(HASH_CACHE_ENTRY));
+    PhBeginEnumHashtable(HashCacheHashtable, &enumContext);
+
+    while (entry = PhNextEnumHashtable(&enumContext))
+        entries[numberOfEntries++] = *entry;
+
+    PhReleaseQueuedLockShared(&HashCacheLock);
+
+    header.Magic = HASH_CACHE_MAGIC;
+    header.Version = HASH_CACHE_VERSION;
+    header.EntrySize = sizeof(HASH_CACHE_ENTRY);
+    header.NumberOfEntries = numberOfEntries;
+
+    status = NtWriteFile(fileHandle, NULL, NULL, NULL, &isb, &header, sizeof(HASH_CACHE_HEADER), NULL, NULL);
+
+    if (NT_SUCCESS(status) && numberOfEntries)
+    {
+        status = NtWriteFile(fileHandle, NULL, NULL, NULL, &isb, entries, numberOfEntries * sizeof(HASH_CACHE_ENTRY), NULL, NULL);
+    }
+
+    PhFree(entries);
+    NtClose(fileHandle);
+
+    if (NT_SUCCESS(status))
+    {
+        HashCacheFileEntries = numberOfEntries;
+        HashCacheRewrite = FALSE;
+    }
+    else
+    {
+        HashCacheRewrite = TRUE;
+    }
+
+    return status;
+}
+
+/**
+ * Appends entries to the cache file.
+ *
+ * \remarks The file lock must be held exclusively.
+ */
+static NTSTATUS AppendHashCache(
+    _In_reads_(NumberOfEntries) PHASH_CACHE_ENTRY Entries,
+    _In_ ULONG NumberOfEntries
+    )
+{
+    NTSTATUS status;
+    HANDLE fileHandle;
+    IO_STATUS_BLOCK isb;
+    HASH_CACHE_HEADER header;
+    LARGE_INTEGER offset;
+
+    status = PhCreateFileWin32(
+        &fileHandle,
+        HashCachePath->Buffer,
+        FILE_GENERIC_WRITE,
+        FILE_ATTRIBUTE_NORMAL,
+        FILE_SHARE_READ,
+        FILE_OPEN,
+        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+        );
+
+    if (!NT_SUCCESS(status))
+        return status;
+
+    // Write the entries after the ones already in the file, then update the header. The new
+    // entries are ignored if the header can't be written.
+
+    offset.QuadPart = sizeof(HASH_CACHE_HEADER) + (LONGLONG)HashCacheFileEntries * sizeof(HASH_CACHE_ENTRY);
+    status = NtWriteFile(fileHandle, NULL, NULL, NULL, &isb, Entries, NumberOfEntries * sizeof(HASH_CACHE_ENTRY), &offset, NULL);
+
+    if (NT_SUCCESS(status))
+    {
+        header.Magic = HASH_CACHE_MAGIC;
+        header.Version = HASH_CACHE_VERSION;
+        header.EntrySize = sizeof(HASH_CACHE_ENTRY);
+        header.NumberOfEntries = HashCacheFileEntries + NumberOfEntries;
+
+        offset.QuadPart = 0;
+        status = NtWriteFile(fileHandle, NULL, NULL, NULL, &isb, &header, sizeof(HASH_CACHE_HEADER), &offset, NULL);
+    }
+
+    NtClose(fileHandle);
+
+    if (NT_SUCCESS(status))
+        HashCacheFileEntries += NumberOfEntries;
+
+    return status;
+}
+
+/**
+ * Saves the entries added or updated by a batch.
+ *
+ * \param Entries The new or updated entries.
+ * \param NumberOfEntries The number of entries.
+ * \param Rewrite TRUE if the hashtable was cleared and the file must be rewritten.
+ */
+static VOID SaveHashCache(
+    _In_reads_(NumberOfEntries) PHASH_CACHE_ENTRY Entries,
+    _In_ ULONG NumberOfEntries,
+    _In_ BOOLEAN Rewrite
+    )
+{
+    PhAcquireQueuedLockExclusive(&HashCacheFileLock);
+
+    if (Rewrite || HashCacheRewrite || HashCacheFileEntries + NumberOfEntries > HASH_CACHE_MAX_ENTRIES)
+    {
+        WriteHashCache();
+    }
+    else
+    {
+        // Fall back to a full write if the file has been deleted or can't be written.
+        if (!NT_SUCCESS(AppendHashCache(Entries, NumberOfEntries)))
+            WriteHashCache();
+    }
+
+    PhReleaseQueuedLockExclusive(&HashCacheFileLock);
+}
+
+VOID InitializeHashCache(
+    VOID
+    )
+{
+    HashCacheHashtable = PhCreateHashtable(
+        sizeof(HASH_CACHE_ENTRY),
+        HashCacheEqualFunction,
+        HashCacheHashFunction,
+        256
+        );
+
+    HashCachePath = HashCacheGetPath();
+
+    LoadHashCache();
+}
+
+VOID CleanupHashCache(
+    VOID
+    )
+{
+    if (!HashCacheHashtable)
+        return;
+
+    // Compact the file if entries have been replaced, or write it if an earlier write failed.
+    PhAcquireQueuedLockExclusive(&HashCacheFileLock);
+
+    if (
+        (HashCacheRewrite && HashCacheHashtable->Count != 0) ||
+        HashCacheFileEntries > HashCacheHashtable->Count
+        )
+    {
+        WriteHashCache();
+    }
+
+    PhReleaseQueuedLockExclusive(&HashCacheFileLock);
+
+    PhDereferenceObject(HashCacheHashtable);
+    HashCacheHashtable = NULL;
+    PhClearReference(&HashCachePath);
+}
+
+static BOOLEAN NTAPI HashCacheLookupCallback(
+    _Inout_ PPH_FILE_HASH_ITEM Item,
+    _In_opt_ PVOID Context
+    )
+{
+    HASH_CACHE_ENTRY lookupEntry;
+    PHASH_CACHE_ENTRY entry;
+    BOOLEAN found = FALSE;
+
+    lookupEntry.VolumeSerialNumber = Item->VolumeSerialNumber;
+    lookupEntry.FileId = Item->FileId;
+
+    PhAcquireQueuedLockShared(&HashCacheLock);
+
+    if (entry = PhFindEntryHashtable(HashCacheHashtable, &lookupEntry))
+    {
+        if (
+            entry->LastWriteTime.QuadPart == Item->LastWriteTime.QuadPart &&
+            entry->EndOfFile.QuadPart == Item->EndOfFile.QuadPart
+            )
+        {
+            Item->Hashes = entry->Hashes;
+            found = TRUE;
+        }
+    }
+
+    PhReleaseQueuedLockShared(&HashCacheLock);
+
+    return found;
+}
+
+/**
+ * Hashes files on the work queue, using and updating the persistent hash cache.
+ *
+ * \param Items The files to hash.
+ * \param NumberOfItems The number of items.
+ */
+VOID HashCacheHashFiles(
+    _Inout_updates_(NumberOfItems) PPH_FILE_HASH_ITEM Items,
+    _In_ ULONG NumberOfItems
+    )
+{
+    PHASH_CACHE_ENTRY updatedEntries;
+    ULONG numberOfUpdatedEntries = 0;
+    BOOLEAN cleared = FALSE;
+
+    if (!HashCacheHashtable)
+    {
+        PhHashFiles(Items, NumberOfItems, NULL, NULL);
+        return;
+    }
+
+    PhHashFiles(Items, NumberOfItems, HashCacheLookupCallback, NULL);
+
+    updatedEntries = PhAllocate(max(NumberOfItems, 1) * sizeof(HASH_CACHE_ENTRY));
+
+    PhAcquireQueuedLockExclusive(&HashCacheLock);
+
+    for (ULONG i = 0; i < NumberOfItems; i++)
+    {
+        HASH_CACHE_ENTRY entry;
+        BOOLEAN added;
+        PHASH_CACHE_ENTRY existingEntry;
+
+        if (!NT_SUCCESS(Items[i].Status) || Items[i].Cached)
+            continue;
+
+        if (HashCacheHashtable->Count >= HASH_CACHE_MAX_ENTRIES)
+        {
+            PhClearHashtable(HashCacheHashtable);
+            cleared = TRUE;
+        }
+
+        memset(&entry, 0, sizeof(HASH_CACHE_ENTRY));
+        entry.VolumeSerialNumber = Items[i].VolumeSerialNumber;
+        entry.FileId = Items[i].FileId;
+        entry.LastWriteTime = Items[i].LastWriteTime;
+        entry.EndOfFile = Items[i].EndOfFile;
+        entry.Hashes = Items[i].Hashes;
+
+        existingEntry = PhAddEntryHashtableEx(HashCacheHashtable, &entry, &added);
+
+        if (!added)
+        {
+            // Keep any hashes the old entry has which weren't requested this time
+            // (only if the file is unchanged).
+            if (
+                existingEntry->LastWriteTime.QuadPart == entry.LastWriteTime.QuadPart &&
+                existingEntry->EndOfFile.QuadPart == entry.EndOfFile.QuadPart
+                )
+            {
+                if (!(entry.Hashes.Flags & PH_FILE_HASH_MD5) && (existingEntry->Hashes.Flags & PH_FILE_HASH_MD5))
+                    memcpy(entry.Hashes.Md5, existingEntry->Hashes.Md5, sizeof(entry.Hashes.Md5));
+                if (!(entry.Hashes.Flags & PH_FILE_HASH_SHA1) && (existingEntry->Hashes.Flags & PH_FILE_HASH_SHA1))
+                    memcpy(entry.Hashes.Sha1, existingEntry->Hashes.Sha1, sizeof(entry.Hashes.Sha1));
+                if (!(entry.Hashes.Flags & PH_FILE_HASH_SHA256) && (existingEntry->Hashes.Flags & PH_FILE_HASH_SHA256))
+                    memcpy(entry.Hashes.Sha256, existingEntry->Hashes.Sha256, sizeof(entry.Hashes.Sha256));
+
+                entry.Hashes.Flags |= existingEntry->Hashes.Flags;
+            }
+
+            *existingEntry = entry;
+        }
+
+        updatedEntries[numberOfUpdatedEntries++] = *existingEntry;
+    }
+
+    PhReleaseQueuedLockExclusive(&HashCacheLock);
+
+    if (numberOfUpdatedEntries)
+        SaveHashCache(updatedEntries, numberOfUpdatedEntries, cleared);
+
+    PhFree(updatedEntries);
+}
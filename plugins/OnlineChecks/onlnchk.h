@@ -42,6 +42,7 @@
 #define SETTING_NAME_VIRUSTOTAL_SCAN_ENABLED (PLUGIN_NAME L".EnableVirusTotalScanning")
 #define SETTING_NAME_VIRUSTOTAL_HIGHLIGHT_DETECTIONS (PLUGIN_NAME L".VirusTotalHighlightDetection")
 #define SETTING_NAME_VIRUSTOTAL_DEFAULT_ACTION (PLUGIN_NAME L".VirusTotalDefautAction")
+#define SETTING_NAME_HASH_CACHE_PATH (PLUGIN_NAME L".HashCachePath")
 
 #define UM_UPLOAD (WM_APP + 1)
 #define UM_EXISTS (WM_APP + 2)
@@ -224,10 +225,24 @@ typedef enum _NETWORK_COLUMN_ID
     COLUMN_ID_VIUSTOTAL_SERVICE = 3
 } NETWORK_COLUMN_ID;
 
+// hashcache
+
+VOID InitializeHashCache(
+    VOID
+    );
+
+VOID CleanupHashCache(
+    VOID
+    );
+
+VOID HashCacheHashFiles(
+    _Inout_updates_(NumberOfItems) PPH_FILE_HASH_ITEM Items,
+    _In_ ULONG NumberOfItems
+    );
+
 _Success_(return >= 0)
 NTSTATUS HashFileAndResetPosition(
     _In_ HANDLE FileHandle,
-    _In_ PLARGE_INTEGER FileSize,
     _In_ PH_HASH_ALGORITHM Algorithm,
     _Out_ PPH_STRING *HashString
     );
@@ -147,71 +147,55 @@ PPH_STRING UpdateVersionString(
 _Success_(return >= 0)
 NTSTATUS HashFileAndResetPosition(
     _In_ HANDLE FileHandle,
-    _In_ PLARGE_INTEGER FileSize,
     _In_ PH_HASH_ALGORITHM Algorithm,
     _Out_ PPH_STRING *HashString
     )
 {
-    NTSTATUS status = STATUS_UNSUCCESSFUL;
-    IO_STATUS_BLOCK iosb;
-    PH_HASH_CONTEXT hashContext;
-    PPH_STRING hashString = NULL;
-    ULONG64 bytesRemaining;
+    NTSTATUS status;
+    PH_FILE_HASH_ITEM hashItem;
     LARGE_INTEGER position;
     LONG priority;
     IO_PRIORITY_HINT ioPriority;
-    BYTE buffer[PAGE_SIZE];
-    
-    bytesRemaining = FileSize->QuadPart;
+
+    memset(&hashItem, 0, sizeof(PH_FILE_HASH_ITEM));
+    hashItem.FileHandle = FileHandle;
+
+    switch (Algorithm)
+    {
+    case Md5HashAlgorithm:
+        hashItem.Flags = PH_FILE_HASH_MD5;
+        break;
+    case Sha1HashAlgorithm:
+        hashItem.Flags = PH_FILE_HASH_SHA1;
+        break;
+    case Sha256HashAlgorithm:
+        hashItem.Flags = PH_FILE_HASH_SHA256;
+        break;
+    default:
+        return STATUS_INVALID_PARAMETER_3;
+    }
 
     PhGetThreadBasePriority(NtCurrentThread(), &priority);
     PhGetThreadIoPriority(NtCurrentThread(), &ioPriority);
     PhSetThreadBasePriority(NtCurrentThread(), THREAD_PRIORITY_LOWEST);
     PhSetThreadIoPriority(NtCurrentThread(), IoPriorityVeryLow);
 
-    PhInitializeHash(&hashContext, Algorithm);
-
-    while (bytesRemaining)
-    {
-        status = NtReadFile(
-            FileHandle,
-            NULL,
-            NULL,
-            NULL,
-            &iosb,
-            buffer,
-            sizeof(buffer),
-            NULL,
-            NULL
-            );
-
-        if (!NT_SUCCESS(status))
-            break;
-
-        PhUpdateHash(&hashContext, buffer, (ULONG)iosb.Information);
-        bytesRemaining -= (ULONG)iosb.Information;
-    }
-
-    if (status == STATUS_END_OF_FILE)
-        status = STATUS_SUCCESS;
+    // The file is memory-mapped and hashed in one pass, and the result is stored in
+    // the hash cache so checking the same file again doesn't read it again.
+    HashCacheHashFiles(&hashItem, 1);
 
-    if (NT_SUCCESS(status))
+    if (NT_SUCCESS(status = hashItem.Status))
     {
-        BYTE hash[32];
-
         switch (Algorithm)
         {
         case Md5HashAlgorithm:
-            PhFinalHash(&hashContext, hash, 16, NULL);
-            *HashString = PhBufferToHexString(hash, 16);
+            *HashString = PhBufferToHexString(hashItem.Hashes.Md5, sizeof(hashItem.Hashes.Md5));
             break;
         case Sha1HashAlgorithm:
-            PhFinalHash(&hashContext, hash, 20, NULL);
-            *HashString = PhBufferToHexString(hash, 20);
+            *HashString = PhBufferToHexString(hashItem.Hashes.Sha1, sizeof(hashItem.Hashes.Sha1));
             break;
         case Sha256HashAlgorithm:
-            PhFinalHash(&hashContext, hash, 32, NULL);
-            *HashString = PhBufferToHexString(hash, 32);
+            *HashString = PhBufferToHexString(hashItem.Hashes.Sha256, sizeof(hashItem.Hashes.Sha256));
             break;
         }
 
@@ -1049,7 +1033,7 @@ NTSTATUS UploadCheckThreadStart(
                 serviceInfo->UploadObjectName
                 );
 
-            if (!NT_SUCCESS(status = HashFileAndResetPosition(fileHandle, &fileSize64, Sha256HashAlgorithm, &tempHashString)))
+            if (!NT_SUCCESS(status = HashFileAndResetPosition(fileHandle, Sha256HashAlgorithm, &tempHashString)))
             {
                 RaiseUploadError(context, L"Unable to hash the file", RtlNtStatusToDosError(status));
                 goto CleanupExit;
@@ -1102,7 +1086,7 @@ NTSTATUS UploadCheckThreadStart(
             PSTR quote = NULL;
             PVOID rootJsonObject;
 
-            if (!NT_SUCCESS(status = HashFileAndResetPosition(fileHandle, &fileSize64, Sha256HashAlgorithm, &tempHashString)))
+            if (!NT_SUCCESS(status = HashFileAndResetPosition(fileHandle, Sha256HashAlgorithm, &tempHashString)))
             {
                 RaiseUploadError(context, L"Unable to hash the file", RtlNtStatusToDosError(status));
                 goto CleanupExit;
@@ -204,34 +204,85 @@ PPH_BYTES VirusTotalGetCachedDbHash(
     return string;
 }
 
-PPH_LIST VirusTotalJsonToResultList(
-    _In_ PVOID JsonObject
+static VOID VirusTotalJsonReadResultArray(
+    _Inout_ PPH_JSON_READER Reader,
+    _Inout_ PPH_LIST Results
     )
 {
-    ULONG i;
-    ULONG arrayLength;
-    PPH_LIST results;
-
-    if (!(arrayLength = PhGetJsonArrayLength(JsonObject)))
-        return NULL;
+    // Objects and arrays that aren't used are always skipped, so the next end token belongs to
+    // the current array or object.
 
-    results = PhCreateList(arrayLength);
-
-    for (i = 0; i < arrayLength; i++)
+    while (PhReadJsonToken(Reader) && Reader->Value.Type != PH_JSON_TOKEN_END_ARRAY)
     {
         PVIRUSTOTAL_API_RESULT result;
-        PVOID jsonArrayObject;
 
-        if (!(jsonArrayObject = PhGetJsonArrayIndexObject(JsonObject, i)))
+        if (Reader->Value.Type != PH_JSON_TOKEN_BEGIN_OBJECT)
+        {
+            PhSkipJsonValue(Reader);
             continue;
+        }
 
         result = PhAllocateZero(sizeof(VIRUSTOTAL_API_RESULT));
-        result->FileHash = PhGetJsonValueAsString(jsonArrayObject, "hash");
-        result->Found = PhGetJsonObjectBool(jsonArrayObject, "found") == TRUE;
-        result->Positives = PhGetJsonValueAsLong64(jsonArrayObject, "positives");
-        result->Total = PhGetJsonValueAsLong64(jsonArrayObject, "total");
 
-        PhAddItemList(results, result);
+        while (PhReadJsonToken(Reader) && Reader->Value.Type != PH_JSON_TOKEN_END_OBJECT)
+        {
+            if (PhEqualJsonKey(Reader, "hash"))
+                PhMoveReference(&result->FileHash, PhJsonValueToString(&Reader->Value));
+            else if (PhEqualJsonKey(Reader, "found"))
+                result->Found = PhJsonValueToBoolean(&Reader->Value);
+            else if (PhEqualJsonKey(Reader, "positives"))
+                result->Positives = PhJsonValueToInteger64(&Reader->Value);
+            else if (PhEqualJsonKey(Reader, "total"))
+                result->Total = PhJsonValueToInteger64(&Reader->Value);
+
+            PhSkipJsonValue(Reader);
+        }
+
+        PhAddItemList(Results, result);
+    }
+}
+
+PPH_LIST VirusTotalJsonToResultList(
+    _In_ PPH_BYTES JsonString
+    )
+{
+    PH_JSON_READER reader;
+    PPH_LIST results = NULL;
+    LONG64 resultCode = 0;
+
+    PhInitializeJsonReader(&reader, JsonString->Buffer, JsonString->Length);
+
+    if (!PhReadJsonToken(&reader) || reader.Value.Type != PH_JSON_TOKEN_BEGIN_OBJECT)
+        return NULL;
+
+    while (PhReadJsonToken(&reader) && reader.Depth != 0)
+    {
+        if (PhEqualJsonKey(&reader, "result"))
+        {
+            resultCode = PhJsonValueToInteger64(&reader.Value);
+        }
+        else if (PhEqualJsonKey(&reader, "data") && reader.Value.Type == PH_JSON_TOKEN_BEGIN_ARRAY && !results)
+        {
+            results = PhCreateList(30);
+            VirusTotalJsonReadResultArray(&reader, results);
+            continue;
+        }
+
+        PhSkipJsonValue(&reader);
+    }
+
+    if (results && (!NT_SUCCESS(reader.Status) || resultCode == 0 || results->Count == 0))
+    {
+        for (ULONG i = 0; i < results->Count; i++)
+        {
+            PVIRUSTOTAL_API_RESULT result = results->Items[i];
+
+            PhClearReference(&result->FileHash);
+            PhFree(result);
+        }
+
+        PhDereferenceObject(results);
+        results = NULL;
     }
 
     return results;
@@ -239,12 +290,15 @@ PPH_LIST VirusTotalJsonToResultList(
 
 VOID VirusTotalBuildJsonArray(
     _In_ PVIRUSTOTAL_FILE_HASH_ENTRY Entry,
-    _In_ PVOID JsonArray
+    _In_ PPH_FILE_HASH_ITEM HashItem,
+    _Inout_ PPH_JSON_WRITER JsonWriter
     )
 {
-    HANDLE fileHandle;
     FILE_NETWORK_OPEN_INFORMATION fileAttributeInfo;
-    PPH_STRING hashString = NULL;
+    PPH_STRING hashString;
+
+    if (!NT_SUCCESS(HashItem->Status))
+        return;
 
     if (NT_SUCCESS(PhQueryFullAttributesFileWin32(
         Entry->FileName->Buffer,
@@ -254,39 +308,18 @@ VOID VirusTotalBuildJsonArray(
         Entry->CreationTime = VirusTotalTimeString(&fileAttributeInfo.CreationTime);
     }
 
-    if (NT_SUCCESS(PhCreateFileWin32(
-        &fileHandle,
-        Entry->FileName->Buffer,
-        FILE_GENERIC_READ,
-        FILE_ATTRIBUTE_NORMAL,
-        FILE_SHARE_READ,
-        FILE_OPEN,
-        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT // FILE_OPEN_FOR_BACKUP_INTENT
-        )))
-    {
-        if (NT_SUCCESS(HashFileAndResetPosition(
-            fileHandle,
-            &fileAttributeInfo.EndOfFile,
-            Sha256HashAlgorithm,
-            &hashString
-            )))
-        {
-            PVOID entry;
-
-            Entry->FileHash = hashString;
-            Entry->FileHashAnsi = PhConvertUtf16ToMultiByte(hashString->Buffer);
-
-            entry = PhCreateJsonObject();
-            PhAddJsonObject(entry, "autostart_location", "");
-            PhAddJsonObject(entry, "autostart_entry", "");
-            PhAddJsonObject(entry, "hash", Entry->FileHashAnsi->Buffer);
-            PhAddJsonObject(entry, "image_path", Entry->FileNameAnsi->Buffer);
-            PhAddJsonObject(entry, "creation_datetime", Entry->CreationTime ? Entry->CreationTime->Buffer : "");
-            PhAddJsonArrayObject(JsonArray, entry);
-        }
+    hashString = PhBufferToHexString(HashItem->Hashes.Sha256, sizeof(HashItem->Hashes.Sha256));
 
-        NtClose(fileHandle);
-    }
+    Entry->FileHash = hashString;
+    Entry->FileHashAnsi = PhConvertUtf16ToMultiByte(hashString->Buffer);
+
+    PhWriteJsonBeginObject(JsonWriter, NULL);
+    PhWriteJsonStringZ(JsonWriter, "autostart_location", "");
+    PhWriteJsonStringZ(JsonWriter, "autostart_entry", "");
+    PhWriteJsonString(JsonWriter, "hash", &hashString->sr);
+    PhWriteJsonString(JsonWriter, "image_path", &Entry->FileName->sr);
+    PhWriteJsonStringZ(JsonWriter, "creation_datetime", Entry->CreationTime ? Entry->CreationTime->Buffer : "");
+    PhWriteJsonEndObject(JsonWriter);
 }
 
 PPH_BYTES VirusTotalSendHttpRequest(
@@ -738,16 +771,12 @@ NTSTATUS NTAPI VirusTotalProcessApiThread(
     do
     {
         ULONG i;
-        INT64 resultLength;
         PPH_BYTES jsonApiResult = NULL;
-        PVOID jsonArray;
-        PVOID rootJsonObject = NULL;
-        PVOID dataJsonObject;
-        PPH_STRING jsonArrayToSendString = NULL;
+        PH_JSON_WRITER jsonWriter;
         PPH_LIST resultTempList = NULL;
         PPH_LIST virusTotalResults = NULL;
+        PPH_FILE_HASH_ITEM hashItems = NULL;
 
-        jsonArray = PhCreateJsonArray();
         resultTempList = PhCreateList(30);
 
         PhAcquireQueuedLockExclusive(&ProcessListLock);
@@ -775,27 +804,34 @@ NTSTATUS NTAPI VirusTotalProcessApiThread(
             goto CleanupExit;
         }
 
+        // Hash the whole batch in parallel; unchanged files come from the hash cache.
+
+        hashItems = PhAllocateZero(sizeof(PH_FILE_HASH_ITEM) * resultTempList->Count);
+
         for (i = 0; i < resultTempList->Count; i++)
         {
-            VirusTotalBuildJsonArray(resultTempList->Items[i], jsonArray);
+            PVIRUSTOTAL_FILE_HASH_ENTRY entry = resultTempList->Items[i];
+
+            hashItems[i].FileName = entry->FileName;
+            hashItems[i].Flags = PH_FILE_HASH_SHA256;
         }
 
-        if (!(jsonArrayToSendString = PhGetJsonArrayString(jsonArray)))
-            goto CleanupExit;
+        HashCacheHashFiles(hashItems, resultTempList->Count);
 
-        if (!(jsonApiResult = VirusTotalSendHttpRequest(PhConvertUtf16ToUtf8(jsonArrayToSendString->Buffer))))
-            goto CleanupExit;
+        PhInitializeJsonWriter(&jsonWriter, 0x1000);
+        PhWriteJsonBeginArray(&jsonWriter, NULL);
 
-        if (!(rootJsonObject = PhCreateJsonParser(jsonApiResult->Buffer)))
-            goto CleanupExit;
+        for (i = 0; i < resultTempList->Count; i++)
+        {
+            VirusTotalBuildJsonArray(resultTempList->Items[i], &hashItems[i], &jsonWriter);
+        }
 
-        if (!(dataJsonObject = PhGetJsonObject(rootJsonObject, "data")))
-            goto CleanupExit;
+        PhWriteJsonEndArray(&jsonWriter);
 
-        if (!(resultLength = PhGetJsonValueAsLong64(rootJsonObject, "result")))
+        if (!(jsonApiResult = VirusTotalSendHttpRequest(PhFinalJsonWriterBytes(&jsonWriter))))
             goto CleanupExit;
 
-        if (virusTotalResults = VirusTotalJsonToResultList(dataJsonObject))
+        if (virusTotalResults = VirusTotalJsonToResultList(jsonApiResult))
         {
             for (i = 0; i < virusTotalResults->Count; i++)
             {
@@ -828,6 +864,11 @@ NTSTATUS NTAPI VirusTotalProcessApiThread(
 
 CleanupExit:
 
+        if (hashItems)
+        {
+            PhFree(hashItems);
+        }
+
         if (virusTotalResults)
         {
             for (i = 0; i < virusTotalResults->Count; i++)
@@ -844,19 +885,6 @@ CleanupExit:
             PhDereferenceObject(virusTotalResults);
         }
         
-        if (rootJsonObject)
-        {
-            PhFreeJsonParser(rootJsonObject);
-        }
-
-        if (jsonArrayToSendString)
-            PhDereferenceObject(jsonArrayToSendString);
-
-        if (jsonArray)
-        {
-            PhFreeJsonParser(jsonArray);
-        }
-
         if (jsonApiResult)
         {
             PhDereferenceObject(jsonApiResult);
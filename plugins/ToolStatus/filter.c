@@ -47,279 +47,444 @@ BOOLEAN WordMatchStringRef(
     return FALSE;
 }
 
-BOOLEAN WordMatchStringZ(
-    _In_ PWSTR Text
-    )
+// Search index
+
+// Each process, service and network item has a search index (an object extension) that holds the
+// searchable text of the item as a single upper-case string with the fields separated by line
+// breaks. The index is rebuilt only when its key, the strings and values that it was built from,
+// changes. The result of the last match is cached along with the ID of the search text, so items
+// are only searched again when the search text or the item changes. Since the search box can't
+// contain line breaks, a search term never matches across two fields.
+
+#define SEARCH_INDEX_MAXIMUM_STRINGS 10
+#define SEARCH_INDEX_MAXIMUM_VALUES 8
+
+typedef struct _SEARCH_INDEX_KEY
 {
-    PH_STRINGREF text;
+    PPH_STRING Strings[SEARCH_INDEX_MAXIMUM_STRINGS];
+    ULONG_PTR Values[SEARCH_INDEX_MAXIMUM_VALUES];
+} SEARCH_INDEX_KEY, *PSEARCH_INDEX_KEY;
 
-    PhInitializeStringRef(&text, Text);
-    return WordMatchStringRef(&text);
-}
+typedef struct _SEARCH_INDEX
+{
+    SEARCH_INDEX_KEY Key;
+    PPH_STRING Text;
+    ULONG MatchSearchId;
+    BOOLEAN Matched;
+} SEARCH_INDEX, *PSEARCH_INDEX;
+
+static PPH_STRING SearchTextUpper = NULL;
+static ULONG SearchId = 1;
+static ULONG NarrowedSearchId = 0;
+static LONG ServicesGeneration = 0;
+static PH_CALLBACK_REGISTRATION ServiceAddedCallbackRegistration;
+static PH_CALLBACK_REGISTRATION ServiceModifiedCallbackRegistration;
+static PH_CALLBACK_REGISTRATION ServiceRemovedCallbackRegistration;
+static PPH_QUERY ProcessQuery = NULL;
+static PPH_QUERY ServiceQuery = NULL;
+static PPH_QUERY NetworkQuery = NULL;
+
+static VOID UpdateSearchQueries(
+    _In_ PPH_STRINGREF Text
+    );
 
-BOOLEAN ProcessTreeFilterCallback(
-    _In_ PPH_TREENEW_NODE Node,
-    _In_opt_ PVOID Context
+static VOID UpperSearchText(
+    _Inout_ PPH_STRINGREF Text
     )
 {
-    PPH_PROCESS_NODE processNode = (PPH_PROCESS_NODE)Node;
+    SIZE_T count;
+    PWCHAR buffer;
 
-    if (PhIsNullOrEmptyString(SearchboxText))
-        return TRUE;
+    count = Text->Length / sizeof(WCHAR);
+    buffer = Text->Buffer;
 
-    if (!PhIsNullOrEmptyString(processNode->ProcessItem->ProcessName))
+    // Use the same case mapping as PhFindStringInStringRef.
+    while (count--)
     {
-        if (WordMatchStringRef(&processNode->ProcessItem->ProcessName->sr))
-            return TRUE;
+        *buffer = RtlUpcaseUnicodeChar(*buffer);
+        buffer++;
     }
+}
 
-    if (!PhIsNullOrEmptyString(processNode->ProcessItem->FileNameWin32))
-    {
-        if (WordMatchStringRef(&processNode->ProcessItem->FileNameWin32->sr))
-            return TRUE;
-    }
+static BOOLEAN SearchTextHasAlternatives(
+    _In_ PPH_STRINGREF Text
+    )
+{
+    return PhFindCharInStringRef(Text, L'|', FALSE) != -1;
+}
 
-    if (!PhIsNullOrEmptyString(processNode->ProcessItem->FileName))
+VOID UpdateSearchFilterText(
+    _In_ PPH_STRING NewText
+    )
+{
+    PPH_STRING newText;
+
+    newText = PhCreateString2(&NewText->sr);
+    UpperSearchText(&newText->sr);
+
+    // If the new text contains the old text, every item that matches the new text also matches
+    // the old text. Items that didn't match before don't need to be searched again.
+    if (
+        !PhIsNullOrEmptyString(SearchTextUpper) &&
+        !SearchTextHasAlternatives(&SearchTextUpper->sr) &&
+        !SearchTextHasAlternatives(&newText->sr) &&
+        PhFindStringInStringRef(&newText->sr, &SearchTextUpper->sr, FALSE) != -1
+        )
     {
-        if (WordMatchStringRef(&processNode->ProcessItem->FileName->sr))
-            return TRUE;
+        NarrowedSearchId = SearchId;
     }
-
-    if (!PhIsNullOrEmptyString(processNode->ProcessItem->CommandLine))
+    else
     {
-        if (WordMatchStringRef(&processNode->ProcessItem->CommandLine->sr))
-            return TRUE;
+        NarrowedSearchId = 0;
     }
 
-    if (!PhIsNullOrEmptyString(processNode->ProcessItem->VersionInfo.CompanyName))
-    {
-        if (WordMatchStringRef(&processNode->ProcessItem->VersionInfo.CompanyName->sr))
-            return TRUE;
-    }
+    SearchId++;
+    PhMoveReference(&SearchTextUpper, newText);
 
-    if (!PhIsNullOrEmptyString(processNode->ProcessItem->VersionInfo.FileDescription))
-    {
-        if (WordMatchStringRef(&processNode->ProcessItem->VersionInfo.FileDescription->sr))
-            return TRUE;
-    }
+    UpdateSearchQueries(&NewText->sr);
+}
 
-    if (!PhIsNullOrEmptyString(processNode->ProcessItem->VersionInfo.FileVersion))
-    {
-        if (WordMatchStringRef(&processNode->ProcessItem->VersionInfo.FileVersion->sr))
-            return TRUE;
-    }
+static BOOLEAN WordMatchSearchIndex(
+    _In_ PPH_STRINGREF Text
+    )
+{
+    PH_STRINGREF part;
+    PH_STRINGREF remainingPart;
 
-    if (!PhIsNullOrEmptyString(processNode->ProcessItem->VersionInfo.ProductName))
+    if (!SearchTextUpper)
+        return FALSE;
+
+    remainingPart = SearchTextUpper->sr;
+
+    while (remainingPart.Length)
     {
-        if (WordMatchStringRef(&processNode->ProcessItem->VersionInfo.ProductName->sr))
-            return TRUE;
+        PhSplitStringRefAtChar(&remainingPart, L'|', &part, &remainingPart);
+
+        if (part.Length)
+        {
+            if (PhFindStringInStringRef(Text, &part, FALSE) != -1)
+                return TRUE;
+        }
     }
 
-    //if (!PhIsNullOrEmptyString(processNode->ProcessItem->UserName))
-    //{
-    //    if (WordMatchStringRef(&processNode->ProcessItem->UserName->sr))
-    //        return TRUE;
-    //}
+    return FALSE;
+}
 
-    if (processNode->ProcessItem->IntegrityString)
+static BOOLEAN MatchSearchIndex(
+    _Inout_ PSEARCH_INDEX Index
+    )
+{
+    if (Index->MatchSearchId != SearchId)
     {
-        if (WordMatchStringZ(processNode->ProcessItem->IntegrityString))
-            return TRUE;
+        if (!(NarrowedSearchId != 0 && Index->MatchSearchId == NarrowedSearchId && !Index->Matched))
+            Index->Matched = WordMatchSearchIndex(&Index->Text->sr);
+
+        Index->MatchSearchId = SearchId;
     }
 
-    //if (!PhIsNullOrEmptyString(processNode->ProcessItem->JobName))
-    //{
-    //    if (WordMatchStringRef(&processNode->ProcessItem->JobName->sr))
-    //        return TRUE;
-    //}
+    return Index->Matched;
+}
+
+static BOOLEAN UpdateSearchIndexKey(
+    _Inout_ PSEARCH_INDEX Index,
+    _In_ PSEARCH_INDEX_KEY Key
+    )
+{
+    ULONG i;
+
+    if (Index->Text && memcmp(&Index->Key, Key, sizeof(SEARCH_INDEX_KEY)) == 0)
+        return FALSE;
 
-    if (!PhIsNullOrEmptyString(processNode->ProcessItem->VerifySignerName))
+    // Keep references to the strings so that their addresses can't be reused by new strings
+    // while the index exists.
+    for (i = 0; i < SEARCH_INDEX_MAXIMUM_STRINGS; i++)
     {
-        if (WordMatchStringRef(&processNode->ProcessItem->VerifySignerName->sr))
-            return TRUE;
+        if (Key->Strings[i])
+            PhReferenceObject(Key->Strings[i]);
+        if (Index->Key.Strings[i])
+            PhDereferenceObject(Index->Key.Strings[i]);
     }
 
-    if (PH_IS_REAL_PROCESS_ID(processNode->ProcessItem->ProcessId) && processNode->ProcessItem->ProcessIdString[0])
-    {
-        if (WordMatchStringZ(processNode->ProcessItem->ProcessIdString))
-            return TRUE;
+    Index->Key = *Key;
+    Index->MatchSearchId = 0;
 
-         // HACK PidHexText from PH_PROCESS_NODE is not exported (dmex)
-        {
-            PH_FORMAT format;
-            SIZE_T returnLength;
-            PH_STRINGREF processIdHex;
-            WCHAR pidHexText[PH_PTR_STR_LEN_1];
+    return TRUE;
+}
 
-            PhInitFormatIX(&format, HandleToUlong(processNode->ProcessItem->ProcessId));
+static VOID AppendSearchIndexStringRef(
+    _Inout_ PPH_STRING_BUILDER StringBuilder,
+    _In_ PPH_STRINGREF Text
+    )
+{
+    if (Text->Length == 0)
+        return;
 
-            if (PhFormatToBuffer(&format, 1, pidHexText, sizeof(pidHexText), &returnLength))
-            {
-                processIdHex.Buffer = pidHexText;
-                processIdHex.Length = returnLength - sizeof(UNICODE_NULL);
+    PhAppendStringBuilder(StringBuilder, Text);
+    PhAppendCharStringBuilder(StringBuilder, L'\n');
+}
 
-                if (WordMatchStringRef(&processIdHex))
-                    return TRUE;
-            }
-        }
-    }
+static VOID AppendSearchIndexString(
+    _Inout_ PPH_STRING_BUILDER StringBuilder,
+    _In_opt_ PPH_STRING Text
+    )
+{
+    if (Text)
+        AppendSearchIndexStringRef(StringBuilder, &Text->sr);
+}
 
-    if (processNode->ProcessItem->ParentProcessIdString[0])
-    {
-        if (WordMatchStringZ(processNode->ProcessItem->ParentProcessIdString))
-            return TRUE;
-    }
+static VOID AppendSearchIndexStringZ(
+    _Inout_ PPH_STRING_BUILDER StringBuilder,
+    _In_opt_ PWSTR Text
+    )
+{
+    PH_STRINGREF text;
 
-    if (processNode->ProcessItem->SessionIdString[0])
+    if (Text)
     {
-        if (WordMatchStringZ(processNode->ProcessItem->SessionIdString))
-            return TRUE;
+        PhInitializeStringRefLongHint(&text, Text);
+        AppendSearchIndexStringRef(StringBuilder, &text);
     }
+}
 
-    if (!PhIsNullOrEmptyString(processNode->ProcessItem->PackageFullName))
-    {
-        if (WordMatchStringRef(&processNode->ProcessItem->PackageFullName->sr))
-            return TRUE;
-    }
+static VOID FinalSearchIndexText(
+    _Inout_ PSEARCH_INDEX Index,
+    _Inout_ PPH_STRING_BUILDER StringBuilder
+    )
+{
+    PhMoveReference(&Index->Text, PhFinalStringBuilderString(StringBuilder));
+    UpperSearchText(&Index->Text->sr);
+}
 
-    if (WordMatchStringZ(PhGetProcessPriorityClassString(processNode->ProcessItem->PriorityClass)))
+static PWSTR GetVerifyResultSearchText(
+    _In_ VERIFY_RESULT VerifyResult
+    )
+{
+    switch (VerifyResult)
     {
-        return TRUE;
+    case VrUnknown:
+        return NULL;
+    case VrNoSignature:
+        return L"NoSignature";
+    case VrTrusted:
+        return L"Trusted";
+    case VrExpired:
+        return L"Expired";
+    case VrRevoked:
+        return L"Revoked";
+    case VrDistrust:
+        return L"Distrust";
+    case VrSecuritySettings:
+        return L"SecuritySettings";
+    case VrBadSignature:
+        return L"BadSignature";
+    default:
+        return L"Unknown";
     }
+}
 
-    if (processNode->ProcessItem->VerifyResult != VrUnknown)
+static VOID AppendServiceFileNames(
+    _Inout_ PPH_STRING_BUILDER StringBuilder,
+    _In_ PPH_SERVICE_ITEM ServiceItem
+    )
+{
+    PPH_STRING serviceFileName = NULL;
+    PPH_STRING serviceBinaryPath = NULL;
+
+    if (NT_SUCCESS(QueryServiceFileName(
+        &ServiceItem->Name->sr,
+        &serviceFileName,
+        &serviceBinaryPath
+        )))
     {
-        switch (processNode->ProcessItem->VerifyResult)
+        if (serviceFileName)
         {
-        case VrNoSignature:
-            if (WordMatchStringZ(L"NoSignature"))
-                return TRUE;
-            break;
-        case VrTrusted:
-            if (WordMatchStringZ(L"Trusted"))
-                return TRUE;
-            break;
-        case VrExpired:
-            if (WordMatchStringZ(L"Expired"))
-                return TRUE;
-            break;
-        case VrRevoked:
-            if (WordMatchStringZ(L"Revoked"))
-                return TRUE;
-            break;
-        case VrDistrust:
-            if (WordMatchStringZ(L"Distrust"))
-                return TRUE;
-            break;
-        case VrSecuritySettings:
-            if (WordMatchStringZ(L"SecuritySettings"))
-                return TRUE;
-            break;
-        case VrBadSignature:
-            if (WordMatchStringZ(L"BadSignature"))
-                return TRUE;
-            break;
-        default:
-            if (WordMatchStringZ(L"Unknown"))
-                return TRUE;
-            break;
+            AppendSearchIndexString(StringBuilder, serviceFileName);
+            PhDereferenceObject(serviceFileName);
         }
-    }
 
-    if (processNode->ProcessItem->ElevationType != TokenElevationTypeDefault)
-    {
-        switch (processNode->ProcessItem->ElevationType)
+        if (serviceBinaryPath)
         {
-        case TokenElevationTypeLimited:
-            if (WordMatchStringZ(L"Limited"))
-                return TRUE;
-            break;
-        case TokenElevationTypeFull:
-            if (WordMatchStringZ(L"Full"))
-                return TRUE;
-            break;
-        default:
-            if (WordMatchStringZ(L"Unknown"))
-                return TRUE;
-            break;
+            AppendSearchIndexString(StringBuilder, serviceBinaryPath);
+            PhDereferenceObject(serviceBinaryPath);
         }
     }
+}
 
-    if (WordMatchStringZ(L"IsBeingDebugged") && processNode->ProcessItem->IsBeingDebugged)
-    {
-        return TRUE;
-    }
+static VOID NTAPI ServicesChangedCallback(
+    _In_opt_ PVOID Parameter,
+    _In_opt_ PVOID Context
+    )
+{
+    // Process indexes include the names of their services.
+    InterlockedIncrement(&ServicesGeneration);
+}
 
-    if (WordMatchStringZ(L"IsDotNet") && processNode->ProcessItem->IsDotNet)
-    {
-        return TRUE;
-    }
+static VOID NTAPI SearchIndexCreateCallback(
+    _In_ PVOID Object,
+    _In_ PH_EM_OBJECT_TYPE ObjectType,
+    _In_ PVOID Extension
+    )
+{
+    memset(Extension, 0, sizeof(SEARCH_INDEX));
+}
 
-    if (WordMatchStringZ(L"IsElevated") && processNode->ProcessItem->IsElevated)
-    {
-        return TRUE;
-    }
+static VOID NTAPI SearchIndexDeleteCallback(
+    _In_ PVOID Object,
+    _In_ PH_EM_OBJECT_TYPE ObjectType,
+    _In_ PVOID Extension
+    )
+{
+    PSEARCH_INDEX index = Extension;
+    ULONG i;
 
-    if (WordMatchStringZ(L"IsInJob") && processNode->ProcessItem->IsInJob)
+    for (i = 0; i < SEARCH_INDEX_MAXIMUM_STRINGS; i++)
     {
-        return TRUE;
+        if (index->Key.Strings[i])
+            PhDereferenceObject(index->Key.Strings[i]);
     }
 
-    if (WordMatchStringZ(L"IsInSignificantJob") && processNode->ProcessItem->IsInSignificantJob)
-    {
-        return TRUE;
-    }
+    PhClearReference(&index->Text);
+}
 
-    if (WordMatchStringZ(L"IsPacked") && processNode->ProcessItem->IsPacked)
-    {
-        return TRUE;
-    }
+VOID InitializeSearchIndex(
+    VOID
+    )
+{
+    PhPluginSetObjectExtension(
+        PluginInstance,
+        EmProcessItemType,
+        sizeof(SEARCH_INDEX),
+        SearchIndexCreateCallback,
+        SearchIndexDeleteCallback
+        );
+    PhPluginSetObjectExtension(
+        PluginInstance,
+        EmServiceItemType,
+        sizeof(SEARCH_INDEX),
+        SearchIndexCreateCallback,
+        SearchIndexDeleteCallback
+        );
+    PhPluginSetObjectExtension(
+        PluginInstance,
+        EmNetworkItemType,
+        sizeof(SEARCH_INDEX),
+        SearchIndexCreateCallback,
+        SearchIndexDeleteCallback
+        );
+
+    PhRegisterCallback(
+        PhGetGeneralCallback(GeneralCallbackServiceProviderAddedEvent),
+        ServicesChangedCallback,
+        NULL,
+        &ServiceAddedCallbackRegistration
+        );
+    PhRegisterCallback(
+        PhGetGeneralCallback(GeneralCallbackServiceProviderModifiedEvent),
+        ServicesChangedCallback,
+        NULL,
+        &ServiceModifiedCallbackRegistration
+        );
+    PhRegisterCallback(
+        PhGetGeneralCallback(GeneralCallbackServiceProviderRemovedEvent),
+        ServicesChangedCallback,
+        NULL,
+        &ServiceRemovedCallbackRegistration
+        );
+}
 
-    if (WordMatchStringZ(L"IsSuspended") && processNode->ProcessItem->IsSuspended)
-    {
-        return TRUE;
-    }
+static VOID BuildProcessSearchIndex(
+    _In_ PPH_PROCESS_ITEM ProcessItem,
+    _Inout_ PSEARCH_INDEX Index
+    )
+{
+    PH_STRING_BUILDER stringBuilder;
+    ULONG i;
 
-    if (WordMatchStringZ(L"IsWow64") && processNode->ProcessItem->IsWow64)
-    {
-        return TRUE;
-    }
+    PhInitializeStringBuilder(&stringBuilder, 0x100);
 
-    if (WordMatchStringZ(L"IsImmersive") && processNode->ProcessItem->IsImmersive)
-    {
-        return TRUE;
-    }
+    for (i = 0; i < SEARCH_INDEX_MAXIMUM_STRINGS; i++)
+        AppendSearchIndexString(&stringBuilder, Index->Key.Strings[i]);
 
-    if (WordMatchStringZ(L"IsProtectedProcess") && processNode->ProcessItem->IsProtectedProcess)
-    {
-        return TRUE;
-    }
+    AppendSearchIndexStringZ(&stringBuilder, ProcessItem->IntegrityString);
 
-    if (WordMatchStringZ(L"IsSecureProcess") && processNode->ProcessItem->IsSecureProcess)
+    if (PH_IS_REAL_PROCESS_ID(ProcessItem->ProcessId) && ProcessItem->ProcessIdString[0])
     {
-        return TRUE;
+        PH_FORMAT format;
+        SIZE_T returnLength;
+        PH_STRINGREF processIdHex;
+        WCHAR pidHexText[PH_PTR_STR_LEN_1];
+
+        AppendSearchIndexStringZ(&stringBuilder, ProcessItem->ProcessIdString);
+
+        // HACK PidHexText from PH_PROCESS_NODE is not exported (dmex)
+        PhInitFormatIX(&format, HandleToUlong(ProcessItem->ProcessId));
+
+        if (PhFormatToBuffer(&format, 1, pidHexText, sizeof(pidHexText), &returnLength))
+        {
+            processIdHex.Buffer = pidHexText;
+            processIdHex.Length = returnLength - sizeof(UNICODE_NULL);
+            AppendSearchIndexStringRef(&stringBuilder, &processIdHex);
+        }
     }
 
-    if (WordMatchStringZ(L"IsPicoProcess") && processNode->ProcessItem->IsSubsystemProcess)
+    AppendSearchIndexStringZ(&stringBuilder, ProcessItem->ParentProcessIdString);
+    AppendSearchIndexStringZ(&stringBuilder, ProcessItem->SessionIdString);
+    AppendSearchIndexStringZ(&stringBuilder, PhGetProcessPriorityClassString(ProcessItem->PriorityClass));
+    AppendSearchIndexStringZ(&stringBuilder, GetVerifyResultSearchText(ProcessItem->VerifyResult));
+
+    switch (ProcessItem->ElevationType)
     {
-        return TRUE;
+    case TokenElevationTypeDefault:
+        break;
+    case TokenElevationTypeLimited:
+        AppendSearchIndexStringZ(&stringBuilder, L"Limited");
+        break;
+    case TokenElevationTypeFull:
+        AppendSearchIndexStringZ(&stringBuilder, L"Full");
+        break;
+    default:
+        AppendSearchIndexStringZ(&stringBuilder, L"Unknown");
+        break;
     }
 
-    if (processNode->ProcessItem->ServiceList && processNode->ProcessItem->ServiceList->Count)
+    if (ProcessItem->IsBeingDebugged)
+        AppendSearchIndexStringZ(&stringBuilder, L"IsBeingDebugged");
+    if (ProcessItem->IsDotNet)
+        AppendSearchIndexStringZ(&stringBuilder, L"IsDotNet");
+    if (ProcessItem->IsElevated)
+        AppendSearchIndexStringZ(&stringBuilder, L"IsElevated");
+    if (ProcessItem->IsInJob)
+        AppendSearchIndexStringZ(&stringBuilder, L"IsInJob");
+    if (ProcessItem->IsInSignificantJob)
+        AppendSearchIndexStringZ(&stringBuilder, L"IsInSignificantJob");
+    if (ProcessItem->IsPacked)
+        AppendSearchIndexStringZ(&stringBuilder, L"IsPacked");
+    if (ProcessItem->IsSuspended)
+        AppendSearchIndexStringZ(&stringBuilder, L"IsSuspended");
+    if (ProcessItem->IsWow64)
+        AppendSearchIndexStringZ(&stringBuilder, L"IsWow64");
+    if (ProcessItem->IsImmersive)
+        AppendSearchIndexStringZ(&stringBuilder, L"IsImmersive");
+    if (ProcessItem->IsProtectedProcess)
+        AppendSearchIndexStringZ(&stringBuilder, L"IsProtectedProcess");
+    if (ProcessItem->IsSecureProcess)
+        AppendSearchIndexStringZ(&stringBuilder, L"IsSecureProcess");
+    if (ProcessItem->IsSubsystemProcess)
+        AppendSearchIndexStringZ(&stringBuilder, L"IsPicoProcess");
+
+    if (ProcessItem->ServiceList && ProcessItem->ServiceList->Count)
     {
         ULONG enumerationKey = 0;
         PPH_SERVICE_ITEM serviceItem;
         PPH_LIST serviceList;
-        ULONG i;
-        BOOLEAN matched = FALSE;
 
         // Copy the service list so we can search it.
-        serviceList = PhCreateList(processNode->ProcessItem->ServiceList->Count);
+        serviceList = PhCreateList(ProcessItem->ServiceList->Count);
 
-        PhAcquireQueuedLockShared(&processNode->ProcessItem->ServiceListLock);
+        PhAcquireQueuedLockShared(&ProcessItem->ServiceListLock);
 
         while (PhEnumPointerList(
-            processNode->ProcessItem->ServiceList,
+            ProcessItem->ServiceList,
             &enumerationKey,
             &serviceItem
             ))
@@ -328,212 +493,105 @@ BOOLEAN ProcessTreeFilterCallback(
             PhAddItemList(serviceList, serviceItem);
         }
 
-        PhReleaseQueuedLockShared(&processNode->ProcessItem->ServiceListLock);
+        PhReleaseQueuedLockShared(&ProcessItem->ServiceListLock);
 
         for (i = 0; i < serviceList->Count; i++)
         {
-            PPH_STRING serviceFileName = NULL;
-            PPH_STRING serviceBinaryPath = NULL;
-
             serviceItem = serviceList->Items[i];
 
-            if (!PhIsNullOrEmptyString(serviceItem->Name))
-            {
-                if (WordMatchStringRef(&serviceItem->Name->sr))
-                {
-                    matched = TRUE;
-                    break;
-                }
-            }
-
-            if (!PhIsNullOrEmptyString(serviceItem->DisplayName))
-            {
-                if (WordMatchStringRef(&serviceItem->DisplayName->sr))
-                {
-                    matched = TRUE;
-                    break;
-                }
-            }
+            AppendSearchIndexString(&stringBuilder, serviceItem->Name);
+            AppendSearchIndexString(&stringBuilder, serviceItem->DisplayName);
 
             if (serviceItem->ProcessId)
-            {
-                if (WordMatchStringZ(serviceItem->ProcessIdString))
-                {
-                    matched = TRUE;
-                    break;
-                }
-            }
+                AppendSearchIndexStringZ(&stringBuilder, serviceItem->ProcessIdString);
 
-            if (NT_SUCCESS(QueryServiceFileName(
-                &serviceItem->Name->sr,
-                &serviceFileName,
-                &serviceBinaryPath
-                )))
-            {
-                if (serviceFileName)
-                {
-                    if (WordMatchStringRef(&serviceFileName->sr))
-                    {
-                        matched = TRUE;
-                    }
-
-                    PhDereferenceObject(serviceFileName);
-                }
-
-                if (serviceBinaryPath)
-                {
-                    if (WordMatchStringRef(&serviceBinaryPath->sr))
-                    {
-                        matched = TRUE;
-                    }
-
-                    PhDereferenceObject(serviceBinaryPath);
-                }
-
-                if (matched)
-                    break;
-            }
+            AppendServiceFileNames(&stringBuilder, serviceItem);
         }
 
         PhDereferenceObjects(serviceList->Items, serviceList->Count);
         PhDereferenceObject(serviceList);
-
-        if (matched)
-            return TRUE;
     }
 
-    return FALSE;
+    FinalSearchIndexText(Index, &stringBuilder);
 }
 
-BOOLEAN ServiceTreeFilterCallback(
-    _In_ PPH_TREENEW_NODE Node,
-    _In_opt_ PVOID Context
+static PSEARCH_INDEX GetProcessSearchIndex(
+    _In_ PPH_PROCESS_ITEM ProcessItem
     )
 {
-    PPH_SERVICE_NODE serviceNode = (PPH_SERVICE_NODE)Node;
-    PPH_STRING serviceFileName = NULL;
-    PPH_STRING serviceBinaryPath = NULL;
-
-    if (PhIsNullOrEmptyString(SearchboxText))
-        return TRUE;
-
-    if (WordMatchStringZ(PhGetServiceTypeString(serviceNode->ServiceItem->Type)))
-        return TRUE;
-
-    if (WordMatchStringZ(PhGetServiceStateString(serviceNode->ServiceItem->State)))
-        return TRUE;
-
-    if (WordMatchStringZ(PhGetServiceStartTypeString(serviceNode->ServiceItem->StartType)))
-        return TRUE;
-
-    if (WordMatchStringZ(PhGetServiceErrorControlString(serviceNode->ServiceItem->ErrorControl)))
-        return TRUE;
-
-    if (!PhIsNullOrEmptyString(serviceNode->ServiceItem->Name))
-    {
-        if (WordMatchStringRef(&serviceNode->ServiceItem->Name->sr))
-            return TRUE;
-    }
-
-    if (!PhIsNullOrEmptyString(serviceNode->ServiceItem->DisplayName))
-    {
-        if (WordMatchStringRef(&serviceNode->ServiceItem->DisplayName->sr))
-            return TRUE;
-    }
-
-    if (serviceNode->ServiceItem->ProcessId)
-    {
-        PPH_PROCESS_NODE processNode;
-
-        if (WordMatchStringZ(serviceNode->ServiceItem->ProcessIdString))
-            return TRUE;
-
-        // Search the process node
-        if (processNode = PhFindProcessNode(serviceNode->ServiceItem->ProcessId))
-        {
-            if (ProcessTreeFilterCallback(&processNode->Node, NULL))
-                return TRUE;
-        }
-    }
-
-    if (!PhIsNullOrEmptyString(serviceNode->ServiceItem->VerifySignerName))
-    {
-        if (WordMatchStringRef(&serviceNode->ServiceItem->VerifySignerName->sr))
-            return TRUE;
-    }
-
-    if (serviceNode->ServiceItem->VerifyResult != VrUnknown)
-    {
-        switch (serviceNode->ServiceItem->VerifyResult)
-        {
-        case VrNoSignature:
-            if (WordMatchStringZ(L"NoSignature"))
-                return TRUE;
-            break;
-        case VrTrusted:
-            if (WordMatchStringZ(L"Trusted"))
-                return TRUE;
-            break;
-        case VrExpired:
-            if (WordMatchStringZ(L"Expired"))
-                return TRUE;
-            break;
-        case VrRevoked:
-            if (WordMatchStringZ(L"Revoked"))
-                return TRUE;
-            break;
-        case VrDistrust:
-            if (WordMatchStringZ(L"Distrust"))
-                return TRUE;
-            break;
-        case VrSecuritySettings:
-            if (WordMatchStringZ(L"SecuritySettings"))
-                return TRUE;
-            break;
-        case VrBadSignature:
-            if (WordMatchStringZ(L"BadSignature"))
-                return TRUE;
-            break;
-        default:
-            if (WordMatchStringZ(L"Unknown"))
-                return TRUE;
-            break;
-        }
-    }
+    PSEARCH_INDEX index;
+    SEARCH_INDEX_KEY key;
+
+    memset(&key, 0, sizeof(SEARCH_INDEX_KEY));
+    key.Strings[0] = ProcessItem->ProcessName;
+    key.Strings[1] = ProcessItem->FileNameWin32;
+    key.Strings[2] = ProcessItem->FileName;
+    key.Strings[3] = ProcessItem->CommandLine;
+    key.Strings[4] = ProcessItem->VersionInfo.CompanyName;
+    key.Strings[5] = ProcessItem->VersionInfo.FileDescription;
+    key.Strings[6] = ProcessItem->VersionInfo.FileVersion;
+    key.Strings[7] = ProcessItem->VersionInfo.ProductName;
+    key.Strings[8] = ProcessItem->VerifySignerName;
+    key.Strings[9] = ProcessItem->PackageFullName;
+    key.Values[0] = (ULONG_PTR)ProcessItem->IntegrityString;
+    key.Values[1] = ProcessItem->SessionId;
+    key.Values[2] = ProcessItem->PriorityClass;
+    key.Values[3] = ProcessItem->VerifyResult;
+    key.Values[4] = ProcessItem->ElevationType;
+    key.Values[5] = ProcessItem->Flags;
+    key.Values[6] = (ProcessItem->ServiceList && ProcessItem->ServiceList->Count) ? (ULONG)ServicesGeneration : 0;
+
+    index = PhPluginGetObjectExtension(PluginInstance, ProcessItem, EmProcessItemType);
+
+    if (UpdateSearchIndexKey(index, &key))
+        BuildProcessSearchIndex(ProcessItem, index);
+
+    return index;
+}
 
-    if (NT_SUCCESS(QueryServiceFileName(
-        &serviceNode->ServiceItem->Name->sr, 
-        &serviceFileName, 
-        &serviceBinaryPath
-        )))
+static PSEARCH_INDEX GetServiceSearchIndex(
+    _In_ PPH_SERVICE_ITEM ServiceItem
+    )
+{
+    PSEARCH_INDEX index;
+    SEARCH_INDEX_KEY key;
+
+    memset(&key, 0, sizeof(SEARCH_INDEX_KEY));
+    key.Strings[0] = ServiceItem->Name;
+    key.Strings[1] = ServiceItem->DisplayName;
+    key.Strings[2] = ServiceItem->VerifySignerName;
+    key.Strings[3] = ServiceItem->FileName;
+    key.Values[0] = ServiceItem->Type;
+    key.Values[1] = ServiceItem->State;
+    key.Values[2] = ServiceItem->StartType;
+    key.Values[3] = ServiceItem->ErrorControl;
+    key.Values[4] = ServiceItem->VerifyResult;
+    key.Values[5] = (ULONG_PTR)ServiceItem->ProcessId;
+
+    index = PhPluginGetObjectExtension(PluginInstance, ServiceItem, EmServiceItemType);
+
+    if (UpdateSearchIndexKey(index, &key))
     {
-        BOOLEAN matched = FALSE;
-
-        if (serviceFileName)
-        {
-            if (WordMatchStringRef(&serviceFileName->sr))
-            {
-                matched = TRUE;
-            }
-
-            PhDereferenceObject(serviceFileName);
-        }
-
-        if (serviceBinaryPath)
-        {
-            if (WordMatchStringRef(&serviceBinaryPath->sr))
-            {
-                matched = TRUE;
-            }
-
-            PhDereferenceObject(serviceBinaryPath);
-        }
-
-        if (matched)
-            return TRUE;
+        PH_STRING_BUILDER stringBuilder;
+
+        PhInitializeStringBuilder(&stringBuilder, 0x100);
+        AppendSearchIndexStringZ(&stringBuilder, PhGetServiceTypeString(ServiceItem->Type));
+        AppendSearchIndexStringZ(&stringBuilder, PhGetServiceStateString(ServiceItem->State));
+        AppendSearchIndexStringZ(&stringBuilder, PhGetServiceStartTypeString(ServiceItem->StartType));
+        AppendSearchIndexStringZ(&stringBuilder, PhGetServiceErrorControlString(ServiceItem->ErrorControl));
+        AppendSearchIndexString(&stringBuilder, ServiceItem->Name);
+        AppendSearchIndexString(&stringBuilder, ServiceItem->DisplayName);
+
+        if (ServiceItem->ProcessId)
+            AppendSearchIndexStringZ(&stringBuilder, ServiceItem->ProcessIdString);
+
+        AppendSearchIndexString(&stringBuilder, ServiceItem->VerifySignerName);
+        AppendSearchIndexStringZ(&stringBuilder, GetVerifyResultSearchText(ServiceItem->VerifyResult));
+        AppendServiceFileNames(&stringBuilder, ServiceItem);
+        FinalSearchIndexText(index, &stringBuilder);
     }
 
-    return FALSE;
+    return index;
 }
 
 // copied from ProcessHacker\netlist.c..
@@ -558,94 +616,512 @@ static PPH_STRING PhpNetworkTreeGetNetworkItemProcessName(
     return PH_AUTO(PhFormat(format, 4, 96));
 }
 
-BOOLEAN NetworkTreeFilterCallback(
-    _In_ PPH_TREENEW_NODE Node,
-    _In_opt_ PVOID Context
+static PSEARCH_INDEX GetNetworkSearchIndex(
+    _In_ PPH_NETWORK_ITEM NetworkItem
     )
 {
-    PPH_NETWORK_NODE networkNode = (PPH_NETWORK_NODE)Node;
-    PPH_STRING processNameText;
+    PSEARCH_INDEX index;
+    SEARCH_INDEX_KEY key;
 
-    if (PhIsNullOrEmptyString(SearchboxText))
-        return TRUE;
+    memset(&key, 0, sizeof(SEARCH_INDEX_KEY));
+    key.Strings[0] = NetworkItem->ProcessName;
+    key.Strings[1] = NetworkItem->OwnerName;
+    key.Strings[2] = NetworkItem->LocalHostString;
+    key.Strings[3] = NetworkItem->RemoteHostString;
+    key.Values[0] = NetworkItem->State;
+    key.Values[1] = (ULONG_PTR)NetworkItem->ProcessId;
 
-    // TODO: We need export the PPH_NETWORK_NODE->ProcessNameText field to search 
-    // waiting/unknown network connections... For now just replicate the data here.
-    processNameText = PhpNetworkTreeGetNetworkItemProcessName(networkNode->NetworkItem);
+    index = PhPluginGetObjectExtension(PluginInstance, NetworkItem, EmNetworkItemType);
 
-    if (!PhIsNullOrEmptyString(processNameText))
+    if (UpdateSearchIndexKey(index, &key))
     {
-        if (WordMatchStringRef(&processNameText->sr))
-            return TRUE;
+        PH_STRING_BUILDER stringBuilder;
+
+        PhInitializeStringBuilder(&stringBuilder, 0x100);
+
+        // TODO: We need export the PPH_NETWORK_NODE->ProcessNameText field to search
+        // waiting/unknown network connections... For now just replicate the data here.
+        AppendSearchIndexString(&stringBuilder, PhpNetworkTreeGetNetworkItemProcessName(NetworkItem));
+        AppendSearchIndexString(&stringBuilder, NetworkItem->ProcessName);
+        AppendSearchIndexString(&stringBuilder, NetworkItem->OwnerName);
+        AppendSearchIndexStringZ(&stringBuilder, NetworkItem->LocalAddressString);
+        AppendSearchIndexStringZ(&stringBuilder, NetworkItem->LocalPortString);
+        AppendSearchIndexString(&stringBuilder, NetworkItem->LocalHostString);
+        AppendSearchIndexStringZ(&stringBuilder, NetworkItem->RemoteAddressString);
+        AppendSearchIndexStringZ(&stringBuilder, NetworkItem->RemotePortString);
+        AppendSearchIndexString(&stringBuilder, NetworkItem->RemoteHostString);
+        AppendSearchIndexStringZ(&stringBuilder, PhGetProtocolTypeName(NetworkItem->ProtocolType));
+
+        if (NetworkItem->ProtocolType & PH_TCP_PROTOCOL_TYPE)
+            AppendSearchIndexStringZ(&stringBuilder, PhGetTcpStateName(NetworkItem->State));
+
+        if (NetworkItem->ProcessId)
+        {
+            WCHAR processIdString[PH_INT32_STR_LEN_1];
+
+            PhPrintUInt32(processIdString, HandleToUlong(NetworkItem->ProcessId));
+            AppendSearchIndexStringZ(&stringBuilder, processIdString);
+        }
+
+        FinalSearchIndexText(index, &stringBuilder);
     }
 
-    if (!PhIsNullOrEmptyString(networkNode->NetworkItem->ProcessName))
+    return index;
+}
+
+// Queries
+
+// If the search text is a query that compares at least one field (e.g. "cpu>5 and user:system"),
+// items are filtered using a compiled query for each tree instead of a plain text search. Words
+// in a query that aren't compared with a field are found using the search index of the item.
+
+typedef enum _PROCESS_QUERY_FIELD
+{
+    ProcessQueryPid,
+    ProcessQueryParentPid,
+    ProcessQuerySession,
+    ProcessQueryCpu,
+    ProcessQueryThreads,
+    ProcessQueryHandles,
+    ProcessQueryPrivateBytes,
+    ProcessQueryWorkingSet,
+    ProcessQueryPriority,
+    ProcessQueryName,
+    ProcessQueryUserName,
+    ProcessQueryCommandLine,
+    ProcessQueryFileName,
+    ProcessQueryCompanyName,
+    ProcessQueryDescription,
+    ProcessQuerySigner,
+    ProcessQueryPackage
+} PROCESS_QUERY_FIELD;
+
+typedef enum _SERVICE_QUERY_FIELD
+{
+    ServiceQueryPid,
+    ServiceQueryName,
+    ServiceQueryDisplayName,
+    ServiceQueryState,
+    ServiceQueryStartType,
+    ServiceQueryType,
+    ServiceQuerySigner,
+    ServiceQueryFileName
+} SERVICE_QUERY_FIELD;
+
+typedef enum _NETWORK_QUERY_FIELD
+{
+    NetworkQueryPid,
+    NetworkQueryLocalPort,
+    NetworkQueryRemotePort,
+    NetworkQueryProcessName,
+    NetworkQueryLocalAddress,
+    NetworkQueryRemoteAddress,
+    NetworkQueryProtocol,
+    NetworkQueryState,
+    NetworkQueryOwner,
+    NetworkQueryLocalHost,
+    NetworkQueryRemoteHost
+} NETWORK_QUERY_FIELD;
+
+static BOOLEAN GetQueryString(
+    _In_opt_ PPH_STRING String,
+    _Out_ PPH_STRINGREF Value
+    )
+{
+    if (!String)
+        return FALSE;
+
+    *Value = String->sr;
+
+    return TRUE;
+}
+
+static BOOLEAN GetQueryStringZ(
+    _In_opt_ PWSTR String,
+    _Out_ PPH_STRINGREF Value
+    )
+{
+    if (!String)
+        return FALSE;
+
+    PhInitializeStringRefLongHint(Value, String);
+
+    return TRUE;
+}
+
+static DOUBLE NTAPI ProcessQueryGetNumber(
+    _In_ ULONG FieldId,
+    _In_ PVOID Object
+    )
+{
+    PPH_PROCESS_ITEM processItem = Object;
+
+    switch (FieldId)
     {
-        if (WordMatchStringRef(&networkNode->NetworkItem->ProcessName->sr))
-            return TRUE;
+    case ProcessQueryPid:
+        return HandleToUlong(processItem->ProcessId);
+    case ProcessQueryParentPid:
+        return HandleToUlong(processItem->ParentProcessId);
+    case ProcessQuerySession:
+        return processItem->SessionId;
+    case ProcessQueryCpu:
+        return processItem->CpuUsage * 100;
+    case ProcessQueryThreads:
+        return processItem->NumberOfThreads;
+    case ProcessQueryHandles:
+        return processItem->NumberOfHandles;
+    case ProcessQueryPrivateBytes:
+        return (DOUBLE)processItem->VmCounters.PagefileUsage;
+    case ProcessQueryWorkingSet:
+        return (DOUBLE)processItem->VmCounters.WorkingSetSize;
+    case ProcessQueryPriority:
+        return processItem->BasePriority;
     }
 
-    if (!PhIsNullOrEmptyString(networkNode->NetworkItem->OwnerName))
+    return 0;
+}
+
+static BOOLEAN NTAPI ProcessQueryGetString(
+    _In_ ULONG FieldId,
+    _In_ PVOID Object,
+    _Out_ PPH_STRINGREF Value
+    )
+{
+    PPH_PROCESS_ITEM processItem = Object;
+
+    switch (FieldId)
     {
-        if (WordMatchStringRef(&networkNode->NetworkItem->OwnerName->sr))
-            return TRUE;
+    case ProcessQueryName:
+        return GetQueryString(processItem->ProcessName, Value);
+    case ProcessQueryUserName:
+        return GetQueryString(processItem->UserName, Value);
+    case ProcessQueryCommandLine:
+        return GetQueryString(processItem->CommandLine, Value);
+    case ProcessQueryFileName:
+        return GetQueryString(processItem->FileNameWin32, Value);
+    case ProcessQueryCompanyName:
+        return GetQueryString(processItem->VersionInfo.CompanyName, Value);
+    case ProcessQueryDescription:
+        return GetQueryString(processItem->VersionInfo.FileDescription, Value);
+    case ProcessQuerySigner:
+        return GetQueryString(processItem->VerifySignerName, Value);
+    case ProcessQueryPackage:
+        return GetQueryString(processItem->PackageFullName, Value);
     }
 
-    if (networkNode->NetworkItem->LocalAddressString[0])
+    return FALSE;
+}
+
+static BOOLEAN NTAPI ProcessQueryMatchText(
+    _In_ PPH_STRINGREF Text,
+    _In_ PVOID Object
+    )
+{
+    return PhFindStringInStringRef(&GetProcessSearchIndex(Object)->Text->sr, Text, FALSE) != -1;
+}
+
+static DOUBLE NTAPI ServiceQueryGetNumber(
+    _In_ ULONG FieldId,
+    _In_ PVOID Object
+    )
+{
+    PPH_SERVICE_ITEM serviceItem = Object;
+
+    switch (FieldId)
     {
-        if (WordMatchStringZ(networkNode->NetworkItem->LocalAddressString))
-            return TRUE;
+    case ServiceQueryPid:
+        return HandleToUlong(serviceItem->ProcessId);
     }
 
-    if (networkNode->NetworkItem->LocalPortString[0])
+    return 0;
+}
+
+static BOOLEAN NTAPI ServiceQueryGetString(
+    _In_ ULONG FieldId,
+    _In_ PVOID Object,
+    _Out_ PPH_STRINGREF Value
+    )
+{
+    PPH_SERVICE_ITEM serviceItem = Object;
+
+    switch (FieldId)
     {
-        if (WordMatchStringZ(networkNode->NetworkItem->LocalPortString))
-            return TRUE;
+    case ServiceQueryName:
+        return GetQueryString(serviceItem->Name, Value);
+    case ServiceQueryDisplayName:
+        return GetQueryString(serviceItem->DisplayName, Value);
+    case ServiceQueryState:
+        return GetQueryStringZ(PhGetServiceStateString(serviceItem->State), Value);
+    case ServiceQueryStartType:
+        return GetQueryStringZ(PhGetServiceStartTypeString(serviceItem->StartType), Value);
+    case ServiceQueryType:
+        return GetQueryStringZ(PhGetServiceTypeString(serviceItem->Type), Value);
+    case ServiceQuerySigner:
+        return GetQueryString(serviceItem->VerifySignerName, Value);
+    case ServiceQueryFileName:
+        return GetQueryString(serviceItem->FileName, Value);
     }
 
-    if (!PhIsNullOrEmptyString(networkNode->NetworkItem->LocalHostString))
+    return FALSE;
+}
+
+static BOOLEAN NTAPI ServiceQueryMatchText(
+    _In_ PPH_STRINGREF Text,
+    _In_ PVOID Object
+    )
+{
+    return PhFindStringInStringRef(&GetServiceSearchIndex(Object)->Text->sr, Text, FALSE) != -1;
+}
+
+static DOUBLE NTAPI NetworkQueryGetNumber(
+    _In_ ULONG FieldId,
+    _In_ PVOID Object
+    )
+{
+    PPH_NETWORK_ITEM networkItem = Object;
+
+    switch (FieldId)
     {
-        if (WordMatchStringRef(&networkNode->NetworkItem->LocalHostString->sr))
-            return TRUE;
+    case NetworkQueryPid:
+        return HandleToUlong(networkItem->ProcessId);
+    case NetworkQueryLocalPort:
+        return networkItem->LocalEndpoint.Port;
+    case NetworkQueryRemotePort:
+        return networkItem->RemoteEndpoint.Port;
     }
 
-    if (networkNode->NetworkItem->RemoteAddressString[0])
+    return 0;
+}
+
+static BOOLEAN NTAPI NetworkQueryGetString(
+    _In_ ULONG FieldId,
+    _In_ PVOID Object,
+    _Out_ PPH_STRINGREF Value
+    )
+{
+    PPH_NETWORK_ITEM networkItem = Object;
+
+    switch (FieldId)
     {
-        if (WordMatchStringZ(networkNode->NetworkItem->RemoteAddressString))
-            return TRUE;
+    case NetworkQueryProcessName:
+        return GetQueryString(networkItem->ProcessName, Value);
+    case NetworkQueryLocalAddress:
+        return GetQueryStringZ(networkItem->LocalAddressString, Value);
+    case NetworkQueryRemoteAddress:
+        return GetQueryStringZ(networkItem->RemoteAddressString, Value);
+    case NetworkQueryProtocol:
+        return GetQueryStringZ(PhGetProtocolTypeName(networkItem->ProtocolType), Value);
+    case NetworkQueryState:
+        if (!(networkItem->ProtocolType & PH_TCP_PROTOCOL_TYPE))
+            return FALSE;
+        return GetQueryStringZ(PhGetTcpStateName(networkItem->State), Value);
+    case NetworkQueryOwner:
+        return GetQueryString(networkItem->OwnerName, Value);
+    case NetworkQueryLocalHost:
+        return GetQueryString(networkItem->LocalHostString, Value);
+    case NetworkQueryRemoteHost:
+        return GetQueryString(networkItem->RemoteHostString, Value);
     }
 
-    if (networkNode->NetworkItem->RemotePortString[0])
+    return FALSE;
+}
+
+static BOOLEAN NTAPI NetworkQueryMatchText(
+    _In_ PPH_STRINGREF Text,
+    _In_ PVOID Object
+    )
+{
+    return PhFindStringInStringRef(&GetNetworkSearchIndex(Object)->Text->sr, Text, FALSE) != -1;
+}
+
+static PH_QUERY_FIELD ProcessQueryFields[] =
+{
+    { PH_STRINGREF_INIT(L"pid"), PH_QUERY_FIELD_NUMBER, ProcessQueryPid },
+    { PH_STRINGREF_INIT(L"ppid"), PH_QUERY_FIELD_NUMBER, ProcessQueryParentPid },
+    { PH_STRINGREF_INIT(L"session"), PH_QUERY_FIELD_NUMBER, ProcessQuerySession },
+    { PH_STRINGREF_INIT(L"cpu"), PH_QUERY_FIELD_NUMBER, ProcessQueryCpu },
+    { PH_STRINGREF_INIT(L"threads"), PH_QUERY_FIELD_NUMBER, ProcessQueryThreads },
+    { PH_STRINGREF_INIT(L"handles"), PH_QUERY_FIELD_NUMBER, ProcessQueryHandles },
+    { PH_STRINGREF_INIT(L"private"), PH_QUERY_FIELD_NUMBER, ProcessQueryPrivateBytes },
+    { PH_STRINGREF_INIT(L"ws"), PH_QUERY_FIELD_NUMBER, ProcessQueryWorkingSet },
+    { PH_STRINGREF_INIT(L"priority"), PH_QUERY_FIELD_NUMBER, ProcessQueryPriority },
+    { PH_STRINGREF_INIT(L"name"), PH_QUERY_FIELD_STRING, ProcessQueryName },
+    { PH_STRINGREF_INIT(L"user"), PH_QUERY_FIELD_STRING, ProcessQueryUserName },
+    { PH_STRINGREF_INIT(L"cmdline"), PH_QUERY_FIELD_STRING, ProcessQueryCommandLine },
+    { PH_STRINGREF_INIT(L"path"), PH_QUERY_FIELD_STRING, ProcessQueryFileName },
+    { PH_STRINGREF_INIT(L"company"), PH_QUERY_FIELD_STRING, ProcessQueryCompanyName },
+    { PH_STRINGREF_INIT(L"description"), PH_QUERY_FIELD_STRING, ProcessQueryDescription },
+    { PH_STRINGREF_INIT(L"signer"), PH_QUERY_FIELD_STRING, ProcessQuerySigner },
+    { PH_STRINGREF_INIT(L"package"), PH_QUERY_FIELD_STRING, ProcessQueryPackage }
+};
+
+static PH_QUERY_FIELD ServiceQueryFields[] =
+{
+    { PH_STRINGREF_INIT(L"pid"), PH_QUERY_FIELD_NUMBER, ServiceQueryPid },
+    { PH_STRINGREF_INIT(L"name"), PH_QUERY_FIELD_STRING, ServiceQueryName },
+    { PH_STRINGREF_INIT(L"display"), PH_QUERY_FIELD_STRING, ServiceQueryDisplayName },
+    { PH_STRINGREF_INIT(L"state"), PH_QUERY_FIELD_STRING, ServiceQueryState },
+    { PH_STRINGREF_INIT(L"start"), PH_QUERY_FIELD_STRING, ServiceQueryStartType },
+    { PH_STRINGREF_INIT(L"type"), PH_QUERY_FIELD_STRING, ServiceQueryType },
+    { PH_STRINGREF_INIT(L"signer"), PH_QUERY_FIELD_STRING, ServiceQuerySigner },
+    { PH_STRINGREF_INIT(L"file"), PH_QUERY_FIELD_STRING, ServiceQueryFileName }
+};
+
+static PH_QUERY_FIELD NetworkQueryFields[] =
+{
+    { PH_STRINGREF_INIT(L"pid"), PH_QUERY_FIELD_NUMBER, NetworkQueryPid },
+    { PH_STRINGREF_INIT(L"lport"), PH_QUERY_FIELD_NUMBER, NetworkQueryLocalPort },
+    { PH_STRINGREF_INIT(L"rport"), PH_QUERY_FIELD_NUMBER, NetworkQueryRemotePort },
+    { PH_STRINGREF_INIT(L"process"), PH_QUERY_FIELD_STRING, NetworkQueryProcessName },
+    { PH_STRINGREF_INIT(L"local"), PH_QUERY_FIELD_STRING, NetworkQueryLocalAddress },
+    { PH_STRINGREF_INIT(L"remote"), PH_QUERY_FIELD_STRING, NetworkQueryRemoteAddress },
+    { PH_STRINGREF_INIT(L"protocol"), PH_QUERY_FIELD_STRING, NetworkQueryProtocol },
+    { PH_STRINGREF_INIT(L"state"), PH_QUERY_FIELD_STRING, NetworkQueryState },
+    { PH_STRINGREF_INIT(L"owner"), PH_QUERY_FIELD_STRING, NetworkQueryOwner },
+    { PH_STRINGREF_INIT(L"lhost"), PH_QUERY_FIELD_STRING, NetworkQueryLocalHost },
+    { PH_STRINGREF_INIT(L"rhost"), PH_QUERY_FIELD_STRING, NetworkQueryRemoteHost }
+};
+
+static PH_QUERY_SCHEMA ProcessQuerySchema = { ProcessQueryFields, RTL_NUMBER_OF(ProcessQueryFields), ProcessQueryGetNumber, ProcessQueryGetString, ProcessQueryMatchText };
+static PH_QUERY_SCHEMA ServiceQuerySchema = { ServiceQueryFields, RTL_NUMBER_OF(ServiceQueryFields), ServiceQueryGetNumber, ServiceQueryGetString, ServiceQueryMatchText };
+static PH_QUERY_SCHEMA NetworkQuerySchema = { NetworkQueryFields, RTL_NUMBER_OF(NetworkQueryFields), NetworkQueryGetNumber, NetworkQueryGetString, NetworkQueryMatchText };
+
+static VOID UpdateSearchQueries(
+    _In_ PPH_STRINGREF Text
+    )
+{
+    PPH_QUERY processQuery = NULL;
+    PPH_QUERY serviceQuery = NULL;
+    PPH_QUERY networkQuery = NULL;
+    ULONG processFields = 0;
+    ULONG serviceFields = 0;
+    ULONG networkFields = 0;
+
+    if (ProcessQuery)
+        PhFreeQuery(ProcessQuery);
+    if (ServiceQuery)
+        PhFreeQuery(ServiceQuery);
+    if (NetworkQuery)
+        PhFreeQuery(NetworkQuery);
+
+    ProcessQuery = NULL;
+    ServiceQuery = NULL;
+    NetworkQuery = NULL;
+
+    // Text that isn't a valid query, or that doesn't compare any fields (e.g. "svchost|explorer"
+    // or "C:\Windows"), is searched for as plain text.
+    if (
+        NT_SUCCESS(PhCompileQuery(Text, &ProcessQuerySchema, &processQuery, &processFields)) &&
+        NT_SUCCESS(PhCompileQuery(Text, &ServiceQuerySchema, &serviceQuery, &serviceFields)) &&
+        NT_SUCCESS(PhCompileQuery(Text, &NetworkQuerySchema, &networkQuery, &networkFields)) &&
+        processFields + serviceFields + networkFields != 0
+        )
     {
-        if (WordMatchStringZ(networkNode->NetworkItem->RemotePortString))
-            return TRUE;
+        ProcessQuery = processQuery;
+        ServiceQuery = serviceQuery;
+        NetworkQuery = networkQuery;
     }
-
-    if (!PhIsNullOrEmptyString(networkNode->NetworkItem->RemoteHostString))
+    else
     {
-        if (WordMatchStringRef(&networkNode->NetworkItem->RemoteHostString->sr))
-            return TRUE;
+        if (processQuery)
+            PhFreeQuery(processQuery);
+        if (serviceQuery)
+            PhFreeQuery(serviceQuery);
+        if (networkQuery)
+            PhFreeQuery(networkQuery);
     }
+}
+
+VOID RefreshSearchQueryFilters(
+    VOID
+    )
+{
+    // The values of number fields change on every update, so items have to be filtered again.
+    if (!ProcessQuery || PhIsNullOrEmptyString(SearchboxText))
+        return;
+
+    PhApplyTreeNewFilters(PhGetFilterSupportProcessTreeList());
+    PhApplyTreeNewFilters(PhGetFilterSupportServiceTreeList());
+    PhApplyTreeNewFilters(PhGetFilterSupportNetworkTreeList());
+}
 
-    if (WordMatchStringZ(PhGetProtocolTypeName(networkNode->NetworkItem->ProtocolType)))
+BOOLEAN ProcessTreeFilterCallback(
+    _In_ PPH_TREENEW_NODE Node,
+    _In_opt_ PVOID Context
+    )
+{
+    PPH_PROCESS_NODE processNode = (PPH_PROCESS_NODE)Node;
+
+    if (PhIsNullOrEmptyString(SearchboxText))
+        return TRUE;
+
+    if (ProcessQuery)
+        return PhEvaluateQuery(ProcessQuery, processNode->ProcessItem);
+
+    return MatchSearchIndex(GetProcessSearchIndex(processNode->ProcessItem));
+}
+
+BOOLEAN ServiceTreeFilterCallback(
+    _In_ PPH_TREENEW_NODE Node,
+    _In_opt_ PVOID Context
+    )
+{
+    PPH_SERVICE_NODE serviceNode = (PPH_SERVICE_NODE)Node;
+    PPH_SERVICE_ITEM serviceItem = serviceNode->ServiceItem;
+    BOOLEAN matched;
+
+    if (PhIsNullOrEmptyString(SearchboxText))
         return TRUE;
 
-    if ((networkNode->NetworkItem->ProtocolType & PH_TCP_PROTOCOL_TYPE) &&
-        WordMatchStringZ(PhGetTcpStateName(networkNode->NetworkItem->State)))
+    if (ServiceQuery)
+        matched = PhEvaluateQuery(ServiceQuery, serviceItem);
+    else
+        matched = MatchSearchIndex(GetServiceSearchIndex(serviceItem));
+
+    if (matched)
         return TRUE;
 
-    if (networkNode->NetworkItem->ProcessId)
+    if (serviceItem->ProcessId)
     {
         PPH_PROCESS_NODE processNode;
-        WCHAR processIdString[PH_INT32_STR_LEN_1];
 
-        PhPrintUInt32(processIdString, HandleToUlong(networkNode->NetworkItem->ProcessId));
+        // Search the process node
+        if (processNode = PhFindProcessNode(serviceItem->ProcessId))
+        {
+            if (ProcessTreeFilterCallback(&processNode->Node, NULL))
+                return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+BOOLEAN NetworkTreeFilterCallback(
+    _In_ PPH_TREENEW_NODE Node,
+    _In_opt_ PVOID Context
+    )
+{
+    PPH_NETWORK_NODE networkNode = (PPH_NETWORK_NODE)Node;
+    PPH_NETWORK_ITEM networkItem = networkNode->NetworkItem;
+    BOOLEAN matched;
+
+    if (PhIsNullOrEmptyString(SearchboxText))
+        return TRUE;
+
+    if (NetworkQuery)
+        matched = PhEvaluateQuery(NetworkQuery, networkItem);
+    else
+        matched = MatchSearchIndex(GetNetworkSearchIndex(networkItem));
+
+    if (matched)
+        return TRUE;
 
-        if (WordMatchStringZ(processIdString))
-            return TRUE;
+    if (networkItem->ProcessId)
+    {
+        PPH_PROCESS_NODE processNode;
 
         // Search the process node
-        if (processNode = PhFindProcessNode(networkNode->NetworkItem->ProcessId))
+        if (processNode = PhFindProcessNode(networkItem->ProcessId))
         {
             if (ProcessTreeFilterCallback(&processNode->Node, NULL))
                 return TRUE;
@@ -25,6 +25,14 @@
 PPH_LIST PhpToolbarGraphList = NULL;
 PPH_HASHTABLE PhpToolbarGraphHashtable = NULL;
 
+// The graphs are redrawn on every update, so look up their color settings once.
+static PPH_SETTING_HANDLE ColorCpuKernelSetting = NULL;
+static PPH_SETTING_HANDLE ColorCpuUserSetting = NULL;
+static PPH_SETTING_HANDLE ColorPhysicalSetting = NULL;
+static PPH_SETTING_HANDLE ColorPrivateSetting = NULL;
+static PPH_SETTING_HANDLE ColorIoReadOtherSetting = NULL;
+static PPH_SETTING_HANDLE ColorIoWriteSetting = NULL;
+
 TOOLSTATUS_GRAPH_MESSAGE_CALLBACK_DECLARE(CpuHistoryGraphMessageCallback);
 TOOLSTATUS_GRAPH_MESSAGE_CALLBACK_DECLARE(PhysicalHistoryGraphMessageCallback);
 TOOLSTATUS_GRAPH_MESSAGE_CALLBACK_DECLARE(CommitHistoryGraphMessageCallback);
@@ -130,6 +138,13 @@ VOID ToolbarGraphsInitialize(
         PhpToolbarGraphHashtable = PhCreateSimpleHashtable(10);
     }
 
+    ColorCpuKernelSetting = PhGetSettingHandle(L"ColorCpuKernel");
+    ColorCpuUserSetting = PhGetSettingHandle(L"ColorCpuUser");
+    ColorPhysicalSetting = PhGetSettingHandle(L"ColorPhysical");
+    ColorPrivateSetting = PhGetSettingHandle(L"ColorPrivate");
+    ColorIoReadOtherSetting = PhGetSettingHandle(L"ColorIoReadOther");
+    ColorIoWriteSetting = PhGetSettingHandle(L"ColorIoWrite");
+
     ToolbarRegisterGraph(
         PluginInstance,
         1,
@@ -658,7 +673,7 @@ TOOLSTATUS_GRAPH_MESSAGE_CALLBACK_DECLARE(CpuHistoryGraphMessageCallback)
             PPH_GRAPH_DRAW_INFO drawInfo = getDrawInfo->DrawInfo;
 
             drawInfo->Flags = PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_LINE_2;
-            PhSiSetColorsGraphDrawInfo(drawInfo, PhGetIntegerSetting(L"ColorCpuKernel"), PhGetIntegerSetting(L"ColorCpuUser"));
+            PhSiSetColorsGraphDrawInfo(drawInfo, PhGetIntegerSettingByHandle(ColorCpuKernelSetting), PhGetIntegerSettingByHandle(ColorCpuUserSetting));
 
             if (!(SystemStatistics.CpuKernelHistory && SystemStatistics.CpuUserHistory))
                 break;
@@ -733,7 +748,7 @@ TOOLSTATUS_GRAPH_MESSAGE_CALLBACK_DECLARE(PhysicalHistoryGraphMessageCallback)
             PPH_GRAPH_DRAW_INFO drawInfo = getDrawInfo->DrawInfo;
 
             drawInfo->Flags = PH_GRAPH_USE_GRID_X;
-            PhSiSetColorsGraphDrawInfo(drawInfo, PhGetIntegerSetting(L"ColorPhysical"), 0);
+            PhSiSetColorsGraphDrawInfo(drawInfo, PhGetIntegerSettingByHandle(ColorPhysicalSetting), 0);
 
             if (!SystemStatistics.PhysicalHistory)
                 break;
@@ -804,7 +819,7 @@ TOOLSTATUS_GRAPH_MESSAGE_CALLBACK_DECLARE(CommitHistoryGraphMessageCallback)
             PPH_GRAPH_DRAW_INFO drawInfo = getDrawInfo->DrawInfo;
 
             drawInfo->Flags = PH_GRAPH_USE_GRID_X;
-            PhSiSetColorsGraphDrawInfo(drawInfo, PhGetIntegerSetting(L"ColorPrivate"), 0);
+            PhSiSetColorsGraphDrawInfo(drawInfo, PhGetIntegerSettingByHandle(ColorPrivateSetting), 0);
 
             if (!(SystemStatistics.CommitHistory && SystemStatistics.Performance))
                 break;
@@ -875,7 +890,7 @@ TOOLSTATUS_GRAPH_MESSAGE_CALLBACK_DECLARE(IoHistoryGraphMessageCallback)
             PPH_GRAPH_DRAW_INFO drawInfo = getDrawInfo->DrawInfo;
 
             drawInfo->Flags = PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_LINE_2;
-            PhSiSetColorsGraphDrawInfo(drawInfo, PhGetIntegerSetting(L"ColorIoReadOther"), PhGetIntegerSetting(L"ColorIoWrite"));
+            PhSiSetColorsGraphDrawInfo(drawInfo, PhGetIntegerSettingByHandle(ColorIoReadOtherSetting), PhGetIntegerSettingByHandle(ColorIoWriteSetting));
 
             if (!(SystemStatistics.IoReadHistory && SystemStatistics.IoOtherHistory && SystemStatistics.IoWriteHistory))
                 break;
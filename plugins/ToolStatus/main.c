@@ -115,6 +115,8 @@ VOID NTAPI ProcessesUpdatedCallback(
 
     if (ToolStatusConfig.StatusBarEnabled)
         StatusBarUpdate(FALSE);
+
+    RefreshSearchQueryFilters();
 }
 
 VOID NTAPI TreeNewInitializingCallback(
@@ -614,6 +616,7 @@ LRESULT CALLBACK MainWndSubclassProc(
                     if (!PhEqualString(SearchboxText, newSearchboxText, FALSE))
                     {
                         // Cache the current search text for our callback.
+                        UpdateSearchFilterText(newSearchboxText);
                         PhSwapReference(&SearchboxText, newSearchboxText);
 
                         if (!PhIsNullOrEmptyString(SearchboxText))
@@ -1622,6 +1625,8 @@ LOGICAL DllMain(
                 &NetworkTreeNewInitializingCallbackRegistration
                 );
 
+            InitializeSearchIndex();
+
             PhAddSettings(settings, ARRAYSIZE(settings));
 
             AcceleratorTable = LoadAccelerators(
@@ -231,6 +231,18 @@ BOOLEAN WordMatchStringRef(
     _In_ PPH_STRINGREF Text
     );
 
+VOID InitializeSearchIndex(
+    VOID
+    );
+
+VOID UpdateSearchFilterText(
+    _In_ PPH_STRING NewText
+    );
+
+VOID RefreshSearchQueryFilters(
+    VOID
+    );
+
 BOOLEAN ProcessTreeFilterCallback(
     _In_ PPH_TREENEW_NODE Node,
     _In_opt_ PVOID Context
@@ -323,7 +323,17 @@ BOOLEAN QueryUpdateData(
     BOOLEAN success = FALSE;
     PPH_HTTP_CONTEXT httpContext = NULL;
     PPH_BYTES jsonString = NULL;
-    PVOID jsonObject = NULL;
+    PH_JSON_QUERY queries[] =
+    {
+        { "version" },
+        { "updated" },
+        { "setup_url" },
+        { "setup_length" },
+        { "setup_hash" },
+        { "setup_sig" },
+        { "changelog" },
+        { "commit" }
+    };
 
     if (!PhHttpSocketCreate(&httpContext, NULL))
     {
@@ -413,17 +423,17 @@ BOOLEAN QueryUpdateData(
         goto CleanupExit;
     }
 
-    if (!(jsonObject = PhCreateJsonParser(jsonString->Buffer)))
+    if (!NT_SUCCESS(PhQueryJson(jsonString->Buffer, jsonString->Length, queries, RTL_NUMBER_OF(queries))))
         goto CleanupExit;
 
-    Context->Version = PhGetJsonValueAsString(jsonObject, "version");
-    Context->RelDate = PhGetJsonValueAsString(jsonObject, "updated");
-    Context->SetupFileDownloadUrl = PhGetJsonValueAsString(jsonObject, "setup_url");
-    Context->SetupFileLength = PhFormatSize(PhGetJsonValueAsLong64(jsonObject, "setup_length"), 2);
-    Context->SetupFileHash = PhGetJsonValueAsString(jsonObject, "setup_hash");
-    Context->SetupFileSignature = PhGetJsonValueAsString(jsonObject, "setup_sig");
-    Context->BuildMessage = PhGetJsonValueAsString(jsonObject, "changelog");
-    Context->CommitHash = PhGetJsonValueAsString(jsonObject, "commit");
+    Context->Version = PhJsonValueToString(&queries[0].Value);
+    Context->RelDate = PhJsonValueToString(&queries[1].Value);
+    Context->SetupFileDownloadUrl = PhJsonValueToString(&queries[2].Value);
+    Context->SetupFileLength = PhFormatSize(PhJsonValueToInteger64(&queries[3].Value), 2);
+    Context->SetupFileHash = PhJsonValueToString(&queries[4].Value);
+    Context->SetupFileSignature = PhJsonValueToString(&queries[5].Value);
+    Context->BuildMessage = PhJsonValueToString(&queries[6].Value);
+    Context->CommitHash = PhJsonValueToString(&queries[7].Value);
 
     Context->CurrentVersion = ParseVersionString(Context->CurrentVersionString);
 #ifdef FORCE_LATEST_VERSION
@@ -432,8 +442,6 @@ BOOLEAN QueryUpdateData(
     Context->LatestVersion = ParseVersionString(Context->Version);
 #endif
 
-    PhFreeJsonParser(jsonObject);
-
     if (PhIsNullOrEmptyString(Context->Version))
         goto CleanupExit;
     if (PhIsNullOrEmptyString(Context->RelDate))
@@ -123,8 +123,10 @@ namespace CustomBuildTool
         private static readonly string[] phlib_headers =
         {
             "appresolver.h",
+            "binlog.h",
             "circbuf.h",
             "circbuf_h.h",
+            "colsnap.h",
             "cpysave.h",
             "dltmgr.h",
             "dspick.h",
@@ -136,6 +138,7 @@ namespace CustomBuildTool
             "graph.h",
             "guisup.h",
             "hexedit.h",
+            "histbuf.h",
             "hndlinfo.h",
             "json.h",
             "kphapi.h",
@@ -150,6 +153,7 @@ namespace CustomBuildTool
             "phnative.h",
             "phnativeinl.h",
             "phnet.h",
+            "phquery.h",
             "phsup.h",
             "phutil.h",
             "provider.h",
@@ -159,7 +163,9 @@ namespace CustomBuildTool
             "settings.h",
             "svcsup.h",
             "symprv.h",
+            "systrace.h",
             "templ.h",
+            "timeline.h",
             "treenew.h",
             "verify.h",
             "workqueue.h"
@@ -0,0 +1,552 @@
+/*
+ * Process Hacker -
+ *   graph rasterizer test
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * graphtest reference.txt      Draws every test graph with the scalar and strip rasterizers, with
+ *                              and without SSE2, and compares them with the reference images.
+ * graphtest -w reference.txt   Writes the reference images using the current rasterizer. Only do
+ *                              this after a deliberate change to the output.
+ * graphtest -b                 Times both rasterizers at a few graph sizes.
+ *
+ * The rasterizer is included from phlib/graph_i.h. The definitions below stand in for the parts of
+ * phlib that it uses.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#else
+#define _ARM64_ // scalar code only
+#endif
+
+typedef void VOID;
+typedef uint8_t BOOLEAN;
+typedef int32_t LONG, *PLONG;
+typedef uint32_t ULONG, *PULONG;
+typedef float FLOAT, *PFLOAT;
+typedef double DOUBLE;
+typedef size_t SIZE_T;
+typedef uint32_t COLORREF;
+
+#define TRUE 1
+#define FALSE 0
+#define MAXLONG 0x7fffffff
+#define FORCEINLINE static inline
+#define _In_
+#define _Inout_
+#define _Out_
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define PH_GRAPH_USE_GRID_X 0x1
+#define PH_GRAPH_USE_GRID_Y 0x2
+#define PH_GRAPH_LOGARITHMIC_GRID_Y 0x4
+#define PH_GRAPH_USE_LINE_2 0x10
+
+typedef struct _PH_GRAPH_DRAW_INFO
+{
+    ULONG Width;
+    ULONG Height;
+    ULONG Flags;
+    ULONG Step;
+    COLORREF BackColor;
+
+    ULONG LineDataCount;
+    PFLOAT LineData1;
+    PFLOAT LineData2;
+    COLORREF LineColor1;
+    COLORREF LineColor2;
+    COLORREF LineBackColor1;
+    COLORREF LineBackColor2;
+
+    COLORREF GridColor;
+    ULONG GridWidth;
+    FLOAT GridHeight;
+    ULONG GridXOffset;
+    ULONG GridYThreshold;
+    FLOAT GridBase;
+} PH_GRAPH_DRAW_INFO, *PPH_GRAPH_DRAW_INFO;
+
+#define PF_XMMI64_INSTRUCTIONS_AVAILABLE 10
+
+static struct
+{
+    BOOLEAN ProcessorFeatures[64];
+} test_shared_data;
+
+#define USER_SHARED_DATA (&test_shared_data)
+
+static void *test_allocate(size_t size)
+{
+    void *memory = malloc(size);
+
+    if (!memory)
+    {
+        fputs("out of memory\n", stderr);
+        exit(2);
+    }
+
+    return memory;
+}
+
+#define PhAllocate test_allocate
+#define PhFree free
+
+static void PhFillMemoryUlong(uint32_t *memory, uint32_t value, size_t count)
+{
+    while (count--)
+        *memory++ = value;
+}
+
+#define COLORREF_TO_BITS(Color) (((((Color) & 0xff) << 24) | (((Color) & 0xff00) << 8) | (((Color) & 0xff0000) >> 8)) >> 8)
+
+static LONG test_strip_minimum_width;
+#define PH_GRAPH_STRIP_MINIMUM_WIDTH test_strip_minimum_width
+
+#include "../../phlib/graph_i.h"
+
+/* Each color is written as one character in the reference images. */
+#define TEST_BACK_COLOR 0x000000
+#define TEST_LINE_COLOR_1 0x0000ff
+#define TEST_LINE_BACK_COLOR_1 0x000080
+#define TEST_LINE_COLOR_2 0x00ff00
+#define TEST_LINE_BACK_COLOR_2 0x008000
+#define TEST_GRID_COLOR 0x808080
+
+static const struct
+{
+    COLORREF color;
+    char character;
+} test_colors[] =
+{
+    { TEST_BACK_COLOR, '.' },
+    { TEST_LINE_COLOR_1, 'A' },
+    { TEST_LINE_BACK_COLOR_1, 'a' },
+    { TEST_LINE_COLOR_2, 'B' },
+    { TEST_LINE_BACK_COLOR_2, 'b' },
+    { TEST_GRID_COLOR, '+' }
+};
+
+typedef struct test_case
+{
+    LONG width;
+    LONG height;
+    ULONG flags;
+    ULONG grid_width;
+    FLOAT grid_height;
+    ULONG grid_x_offset;
+    ULONG grid_y_threshold;
+    FLOAT grid_base;
+    ULONG data_count; /* 0 for enough data to fill the graph */
+    uint32_t seed;
+} test_case;
+
+#define GRID_XY (PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y)
+#define GRID_LOG (PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y | PH_GRAPH_LOGARITHMIC_GRID_Y)
+
+/* The grid heights and bases are chosen so that the grid rows do not depend on how log and exp
+ * round. */
+static const test_case test_cases[] =
+{
+    { 1, 1, 0, 0, 0, 0, 0, 0, 0, 1 },
+    { 2, 5, PH_GRAPH_USE_LINE_2, 0, 0, 0, 0, 0, 0, 2 },
+    { 7, 3, GRID_XY | PH_GRAPH_USE_LINE_2, 3, 0.3f, 0, 1, 0, 0, 3 },
+    { 15, 10, GRID_XY, 4, 0.2f, 1, 2, 0, 0, 4 },
+    { 16, 16, GRID_XY | PH_GRAPH_USE_LINE_2, 6, 0.15f, 2, 3, 0, 0, 5 },
+    { 17, 24, PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_LINE_2, 5, 0, 3, 0, 0, 0, 6 },
+    { 31, 12, PH_GRAPH_USE_GRID_Y, 5, 0.3f, 0, 1, 0, 0, 7 },
+    { 33, 20, GRID_LOG | PH_GRAPH_USE_LINE_2, 8, 0.3f, 0, 2, 2.5f, 0, 8 },
+    { 48, 32, GRID_LOG, 12, 0.7f, 5, 1, 3.3f, 0, 9 },
+    { 64, 40, GRID_XY | PH_GRAPH_USE_LINE_2, 12, 0.1f, 7, 3, 0, 10, 10 },
+    { 80, 18, GRID_XY, 7, 1.3f, 0, 1, 0, 0, 11 },
+    { 100, 40, GRID_XY | PH_GRAPH_USE_LINE_2, 12, 0.1f, 3, 3, 0, 0, 12 },
+    { 100, 40, GRID_LOG | PH_GRAPH_USE_LINE_2, 12, 0.3f, 1, 3, 0.5f, 0, 13 },
+    { 129, 50, GRID_XY | PH_GRAPH_USE_LINE_2, 12, 0.1f, 11, 3, 0, 0, 14 },
+    { 150, 30, PH_GRAPH_USE_LINE_2, 0, 0, 0, 0, 0, 30, 15 },
+    { 200, 30, GRID_LOG, 10, 0.3f, 4, 2, 2.5f, 0, 16 },
+    { 260, 20, GRID_XY | PH_GRAPH_USE_LINE_2, 12, 0.1f, 9, 3, 0, 0, 17 },
+    { 300, 8, GRID_XY, 12, 0.25f, 0, 1, 0, 0, 18 },
+    { 320, 24, GRID_XY | PH_GRAPH_USE_LINE_2, 12, 0.1f, 2, 3, 0, 0, 19 }
+};
+
+#define TEST_CASE_COUNT (sizeof(test_cases) / sizeof(test_cases[0]))
+
+static uint32_t test_random(uint32_t *state)
+{
+    *state = *state * 1103515245 + 12345;
+    return (*state >> 16) & 0x7fff;
+}
+
+/* Creates data which wanders up and down, jumps now and then and sometimes leaves the 0 to 1
+ * range, so that the clamping and both slopes are used. */
+static void create_data(const test_case *test, FLOAT *data1, FLOAT *data2, ULONG count)
+{
+    uint32_t state = test->seed;
+    int32_t level1 = (int32_t)(test_random(&state) % 1000);
+    int32_t level2 = (int32_t)(test_random(&state) % 500);
+    ULONG i;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t r = test_random(&state);
+
+        if (r % 13 == 0)
+            level1 = (int32_t)(test_random(&state) % 1300) - 150;
+        else
+            level1 += (int32_t)(r % 201) - 100;
+
+        level2 += (int32_t)(test_random(&state) % 101) - 50;
+
+        data1[i] = (FLOAT)level1 / 1000;
+        data2[i] = (FLOAT)level2 / 1000;
+    }
+}
+
+static void init_draw_info(const test_case *test, PH_GRAPH_DRAW_INFO *draw_info, FLOAT *data1, FLOAT *data2, ULONG count)
+{
+    memset(draw_info, 0, sizeof(PH_GRAPH_DRAW_INFO));
+    draw_info->Width = test->width;
+    draw_info->Height = test->height;
+    draw_info->Flags = test->flags;
+    draw_info->Step = 2;
+    draw_info->BackColor = TEST_BACK_COLOR;
+    draw_info->LineDataCount = count;
+    draw_info->LineData1 = data1;
+    draw_info->LineData2 = data2;
+    draw_info->LineColor1 = TEST_LINE_COLOR_1;
+    draw_info->LineColor2 = TEST_LINE_COLOR_2;
+    draw_info->LineBackColor1 = TEST_LINE_BACK_COLOR_1;
+    draw_info->LineBackColor2 = TEST_LINE_BACK_COLOR_2;
+    draw_info->GridColor = TEST_GRID_COLOR;
+    draw_info->GridWidth = test->grid_width;
+    draw_info->GridHeight = test->grid_height;
+    draw_info->GridXOffset = test->grid_x_offset;
+    draw_info->GridYThreshold = test->grid_y_threshold;
+    draw_info->GridBase = test->grid_base;
+}
+
+static ULONG data_count(const test_case *test)
+{
+    return test->data_count ? test->data_count : (ULONG)test->width / 2 + 2;
+}
+
+/* Draws a test graph into a bitmap with the given stride. Returns the bitmap. */
+static uint32_t *draw_test(const test_case *test, LONG stride, LONG strip_minimum_width, BOOLEAN sse2)
+{
+    PH_GRAPH_DRAW_INFO draw_info;
+    ULONG count = data_count(test);
+    FLOAT *data1 = test_allocate(count * sizeof(FLOAT));
+    FLOAT *data2 = test_allocate(count * sizeof(FLOAT));
+    uint32_t *bits = test_allocate((size_t)stride * test->height * sizeof(uint32_t));
+
+    /* Columns outside the graph must not be touched. */
+    memset(bits, 0xcc, (size_t)stride * test->height * sizeof(uint32_t));
+
+    create_data(test, data1, data2, count);
+    init_draw_info(test, &draw_info, data1, data2, count);
+
+    test_strip_minimum_width = strip_minimum_width;
+    test_shared_data.ProcessorFeatures[PF_XMMI64_INSTRUCTIONS_AVAILABLE] = sse2;
+    PhpRasterizeGraph(bits, stride, &draw_info);
+
+    free(data1);
+    free(data2);
+
+    return bits;
+}
+
+static char color_character(uint32_t pixel)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof(test_colors) / sizeof(test_colors[0]); i++)
+    {
+        if (pixel == COLORREF_TO_BITS(test_colors[i].color))
+            return test_colors[i].character;
+    }
+
+    return '?';
+}
+
+/* The first row of a bitmap is the bottom of the graph, so rows are written from the last one. */
+static int write_reference(const char *file_name)
+{
+    FILE *file;
+    size_t i;
+
+    if (!(file = fopen(file_name, "w")))
+    {
+        perror(file_name);
+        return 1;
+    }
+
+    fputs("# Reference images for graphtest. Each image is written top row first. '.' is the\n", file);
+    fputs("# background, 'a' and 'A' are the line 1 fill and outline, 'b' and 'B' are the line 2\n", file);
+    fputs("# fill and outline and '+' is the grid.\n", file);
+
+    for (i = 0; i < TEST_CASE_COUNT; i++)
+    {
+        const test_case *test = &test_cases[i];
+        uint32_t *bits = draw_test(test, test->width, MAXLONG, 0);
+        LONG x;
+        LONG y;
+
+        fprintf(file, "case %zu %dx%d\n", i, (int)test->width, (int)test->height);
+
+        for (y = test->height - 1; y >= 0; y--)
+        {
+            for (x = 0; x < test->width; x++)
+                fputc(color_character(bits[(size_t)y * test->width + x]), file);
+
+            fputc('\n', file);
+        }
+
+        free(bits);
+    }
+
+    fclose(file);
+
+    return 0;
+}
+
+/* Reads the reference image of a test case, converted back into a bitmap. */
+static uint32_t *read_reference(FILE *file, size_t index, const test_case *test)
+{
+    char line[1024];
+    char expected[64];
+    uint32_t *bits;
+    LONG x;
+    LONG y;
+
+    snprintf(expected, sizeof(expected), "case %zu %dx%d\n", index, (int)test->width, (int)test->height);
+
+    do
+    {
+        if (!fgets(line, sizeof(line), file))
+            return NULL;
+    } while (line[0] == '#');
+
+    if (strcmp(line, expected) != 0)
+        return NULL;
+
+    bits = test_allocate((size_t)test->width * test->height * sizeof(uint32_t));
+
+    for (y = test->height - 1; y >= 0; y--)
+    {
+        if (!fgets(line, sizeof(line), file) || strlen(line) != (size_t)test->width + 1)
+        {
+            free(bits);
+            return NULL;
+        }
+
+        for (x = 0; x < test->width; x++)
+        {
+            uint32_t pixel = 0xffffffff;
+            size_t i;
+
+            for (i = 0; i < sizeof(test_colors) / sizeof(test_colors[0]); i++)
+            {
+                if (line[x] == test_colors[i].character)
+                    pixel = COLORREF_TO_BITS(test_colors[i].color);
+            }
+
+            bits[(size_t)y * test->width + x] = pixel;
+        }
+    }
+
+    return bits;
+}
+
+static int compare_test(size_t index, const char *name, const uint32_t *reference, LONG stride, LONG strip_minimum_width, BOOLEAN sse2)
+{
+    const test_case *test = &test_cases[index];
+    uint32_t *bits = draw_test(test, stride, strip_minimum_width, sse2);
+    int result = 0;
+    LONG x;
+    LONG y;
+
+    for (y = 0; y < test->height && !result; y++)
+    {
+        for (x = 0; x < stride; x++)
+        {
+            uint32_t pixel = bits[(size_t)y * stride + x];
+            uint32_t expected = x < test->width ? reference[(size_t)y * test->width + x] : 0xcccccccc;
+
+            if (pixel != expected)
+            {
+                printf(
+                    "case %zu (%dx%d), %s, stride %d: pixel (%d, %d) is %06x, expected %06x\n",
+                    index,
+                    (int)test->width,
+                    (int)test->height,
+                    name,
+                    (int)stride,
+                    (int)x,
+                    (int)y,
+                    pixel,
+                    expected
+                    );
+                result = 1;
+                break;
+            }
+        }
+    }
+
+    free(bits);
+
+    return result;
+}
+
+static int check_reference(const char *file_name)
+{
+    FILE *file;
+    size_t i;
+    int failures = 0;
+
+    if (!(file = fopen(file_name, "r")))
+    {
+        perror(file_name);
+        return 1;
+    }
+
+    for (i = 0; i < TEST_CASE_COUNT; i++)
+    {
+        const test_case *test = &test_cases[i];
+        uint32_t *reference = read_reference(file, i, test);
+
+        if (!reference)
+        {
+            fprintf(stderr, "%s: missing or malformed reference image for case %zu\n", file_name, i);
+            fclose(file);
+            return 1;
+        }
+
+        failures += compare_test(i, "scalar", reference, test->width, MAXLONG, 0);
+        failures += compare_test(i, "scalar", reference, test->width + 5, MAXLONG, 0);
+        failures += compare_test(i, "strips", reference, test->width, 0, 0);
+        failures += compare_test(i, "strips", reference, test->width + 5, 0, 0);
+#ifndef _ARM64_
+        failures += compare_test(i, "strips with SSE2", reference, test->width, 0, 1);
+        failures += compare_test(i, "strips with SSE2", reference, test->width + 5, 0, 1);
+#endif
+        free(reference);
+    }
+
+    fclose(file);
+
+    printf("%zu cases, %d failures\n", TEST_CASE_COUNT, failures);
+
+    return failures != 0;
+}
+
+static double time_draws(const test_case *test, LONG strip_minimum_width, int iterations)
+{
+    PH_GRAPH_DRAW_INFO draw_info;
+    ULONG count = data_count(test);
+    FLOAT *data1 = test_allocate(count * sizeof(FLOAT));
+    FLOAT *data2 = test_allocate(count * sizeof(FLOAT));
+    uint32_t *bits = test_allocate((size_t)test->width * test->height * sizeof(uint32_t));
+    double best = 0;
+    int repeat;
+    int i;
+
+    create_data(test, data1, data2, count);
+    init_draw_info(test, &draw_info, data1, data2, count);
+
+    test_strip_minimum_width = strip_minimum_width;
+    test_shared_data.ProcessorFeatures[PF_XMMI64_INSTRUCTIONS_AVAILABLE] = 1;
+
+    /* Take the best of several runs, which is the least disturbed by other work. */
+    for (repeat = 0; repeat < 7; repeat++)
+    {
+        struct timespec start;
+        struct timespec end;
+        double time;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (i = 0; i < iterations; i++)
+            PhpRasterizeGraph(bits, test->width, &draw_info);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        time = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / iterations / 1000;
+
+        if (repeat == 0 || best > time)
+            best = time;
+    }
+
+    free(data1);
+    free(data2);
+    free(bits);
+
+    return best;
+}
+
+static int benchmark(void)
+{
+    static const LONG sizes[][2] =
+    {
+        { 40, 20 }, { 64, 40 }, { 100, 40 }, { 128, 60 }, { 160, 60 }, { 192, 40 }, { 200, 80 }, { 256, 100 },
+        { 320, 100 }, { 400, 120 }, { 600, 150 }, { 1000, 300 }
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        test_case test = { sizes[i][0], sizes[i][1], GRID_XY | PH_GRAPH_USE_LINE_2, 12, 0.1f, 0, 3, 0, 0, 1 };
+        int iterations = (int)(20000000 / ((size_t)test.width * test.height)) + 1;
+
+        printf(
+            "%4dx%-4d scalar %8.2f us, strips %8.2f us\n",
+            (int)test.width,
+            (int)test.height,
+            time_draws(&test, MAXLONG, iterations),
+            time_draws(&test, 0, iterations)
+            );
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 2 && strcmp(argv[1], "-b") == 0)
+        return benchmark();
+    if (argc == 3 && strcmp(argv[1], "-w") == 0)
+        return write_reference(argv[2]);
+    if (argc == 2)
+        return check_reference(argv[1]);
+
+    fprintf(stderr, "usage: %s [-w] reference.txt | -b\n", argv[0]);
+
+    return 2;
+}
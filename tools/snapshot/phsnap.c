@@ -0,0 +1,496 @@
+/*
+ * Process Hacker -
+ *   columnar snapshot reader
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "phsnap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* All integers in the file are little-endian. */
+
+static uint32_t phsnap_get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t phsnap_get_u64(const uint8_t *p)
+{
+    return (uint64_t)phsnap_get_u32(p) | ((uint64_t)phsnap_get_u32(p + 4) << 32);
+}
+
+static void phsnap_get_name(char *name, const uint8_t *p, size_t size)
+{
+    memcpy(name, p, size);
+    name[size] = 0;
+}
+
+/* Decodes an unsigned LEB128 value. Returns the number of bytes used, or 0 if the value is truncated
+ * or too long. */
+static size_t phsnap_get_varint(const uint8_t *p, const uint8_t *end, uint64_t *value)
+{
+    const uint8_t *start = p;
+    uint64_t result = 0;
+    unsigned int shift = 0;
+
+    while (p != end && shift < 64)
+    {
+        uint8_t b = *p++;
+
+        result |= (uint64_t)(b & 0x7f) << shift;
+
+        if (!(b & 0x80))
+        {
+            *value = result;
+            return (size_t)(p - start);
+        }
+
+        shift += 7;
+    }
+
+    return 0;
+}
+
+int phsnap_open(phsnap_file *file, const char *path)
+{
+    memset(file, 0, sizeof(phsnap_file));
+
+#ifdef _WIN32
+    {
+        FILE *stream;
+        long length;
+        uint8_t *data;
+
+        if (!(stream = fopen(path, "rb")))
+            return PHSNAP_ERROR_IO;
+
+        if (fseek(stream, 0, SEEK_END) != 0 || (length = ftell(stream)) < 0 || fseek(stream, 0, SEEK_SET) != 0)
+        {
+            fclose(stream);
+            return PHSNAP_ERROR_IO;
+        }
+
+        if (!(data = malloc(length ? length : 1)))
+        {
+            fclose(stream);
+            return PHSNAP_ERROR_MEMORY;
+        }
+
+        if (fread(data, 1, length, stream) != (size_t)length)
+        {
+            free(data);
+            fclose(stream);
+            return PHSNAP_ERROR_IO;
+        }
+
+        fclose(stream);
+        file->data = data;
+        file->length = length;
+    }
+#else
+    {
+        int fd;
+        struct stat st;
+        void *data;
+
+        if ((fd = open(path, O_RDONLY)) < 0)
+            return PHSNAP_ERROR_IO;
+
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return PHSNAP_ERROR_IO;
+        }
+
+        if (st.st_size != 0)
+        {
+            data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (data == MAP_FAILED)
+            {
+                close(fd);
+                return PHSNAP_ERROR_IO;
+            }
+
+            file->data = data;
+            file->length = (size_t)st.st_size;
+        }
+
+        close(fd);
+    }
+#endif
+
+    file->mapped = 1;
+
+    return PHSNAP_OK;
+}
+
+void phsnap_open_memory(phsnap_file *file, const void *data, size_t length)
+{
+    file->data = data;
+    file->length = length;
+    file->offset = 0;
+    file->mapped = 0;
+}
+
+void phsnap_close(phsnap_file *file)
+{
+    if (file->mapped && file->data)
+    {
+#ifdef _WIN32
+        free((void *)file->data);
+#else
+        munmap((void *)file->data, file->length);
+#endif
+    }
+
+    memset(file, 0, sizeof(phsnap_file));
+}
+
+static int phsnap_parse_dictionary(phsnap_column *column, const uint8_t *p, const uint8_t *end)
+{
+    uint32_t i;
+
+    if (column->dictionary_count == 0)
+        return p == end ? PHSNAP_OK : PHSNAP_ERROR_FORMAT;
+
+    // Each entry takes at least one byte, which bounds the allocation.
+    if (column->dictionary_count > (size_t)(end - p))
+        return PHSNAP_ERROR_FORMAT;
+
+    if (!(column->dictionary = malloc(sizeof(phsnap_string) * column->dictionary_count)))
+        return PHSNAP_ERROR_MEMORY;
+
+    for (i = 0; i < column->dictionary_count; i++)
+    {
+        uint64_t length;
+        size_t used;
+
+        if (!(used = phsnap_get_varint(p, end, &length)))
+            return PHSNAP_ERROR_FORMAT;
+
+        p += used;
+
+        if (length > (uint64_t)(end - p))
+            return PHSNAP_ERROR_FORMAT;
+
+        column->dictionary[i].data = (const char *)p;
+        column->dictionary[i].length = (uint32_t)length;
+        p += length;
+    }
+
+    return p == end ? PHSNAP_OK : PHSNAP_ERROR_FORMAT;
+}
+
+static int phsnap_parse_table(phsnap_table *table, const uint8_t *p, const uint8_t *end)
+{
+    const uint8_t *columnHeader;
+    uint32_t i;
+    int result;
+
+    phsnap_get_name(table->name, p, PHSNAP_TABLE_NAME_SIZE);
+    table->row_count = phsnap_get_u32(p + 16);
+    table->column_count = phsnap_get_u32(p + 20);
+    p += PHSNAP_TABLE_HEADER_SIZE;
+
+    if (table->column_count > (size_t)(end - p) / PHSNAP_COLUMN_HEADER_SIZE)
+        return PHSNAP_ERROR_FORMAT;
+
+    if (table->column_count != 0 && !(table->columns = calloc(table->column_count, sizeof(phsnap_column))))
+        return PHSNAP_ERROR_MEMORY;
+
+    columnHeader = p;
+    p += (size_t)table->column_count * PHSNAP_COLUMN_HEADER_SIZE;
+
+    for (i = 0; i < table->column_count; i++)
+    {
+        phsnap_column *column = &table->columns[i];
+        uint64_t dictionaryLength;
+        uint64_t dataLength;
+
+        phsnap_get_name(column->name, columnHeader, PHSNAP_COLUMN_NAME_SIZE);
+        column->type = phsnap_get_u32(columnHeader + 24);
+        column->dictionary_count = phsnap_get_u32(columnHeader + 28);
+        dictionaryLength = phsnap_get_u64(columnHeader + 32);
+        dataLength = phsnap_get_u64(columnHeader + 40);
+        columnHeader += PHSNAP_COLUMN_HEADER_SIZE;
+
+        if (column->type != PHSNAP_COLUMN_INTEGER && column->type != PHSNAP_COLUMN_STRING)
+            return PHSNAP_ERROR_FORMAT;
+        if (column->type == PHSNAP_COLUMN_INTEGER && (column->dictionary_count != 0 || dictionaryLength != 0))
+            return PHSNAP_ERROR_FORMAT;
+        if (dictionaryLength > (uint64_t)(end - p) || dataLength > (uint64_t)(end - p) - dictionaryLength)
+            return PHSNAP_ERROR_FORMAT;
+        // Each value takes at least one byte. Callers allocate row_count elements per column, so
+        // this also bounds those allocations.
+        if (table->row_count > dataLength)
+            return PHSNAP_ERROR_FORMAT;
+
+        if ((result = phsnap_parse_dictionary(column, p, p + dictionaryLength)) != PHSNAP_OK)
+            return result;
+
+        p += dictionaryLength;
+        column->data = p;
+        column->data_length = (size_t)dataLength;
+        p += dataLength;
+    }
+
+    return p == end ? PHSNAP_OK : PHSNAP_ERROR_FORMAT;
+}
+
+int phsnap_next(phsnap_file *file, phsnap_snapshot *snapshot)
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    uint64_t length;
+    uint32_t i;
+    int result;
+
+    memset(snapshot, 0, sizeof(phsnap_snapshot));
+
+    if (file->offset == file->length)
+        return PHSNAP_END;
+
+    if (file->length - file->offset < PHSNAP_SNAPSHOT_HEADER_SIZE)
+        return PHSNAP_ERROR_FORMAT;
+
+    p = file->data + file->offset;
+
+    if (phsnap_get_u32(p) != PHSNAP_MAGIC || phsnap_get_u32(p + 4) != PHSNAP_VERSION)
+        return PHSNAP_ERROR_FORMAT;
+
+    length = phsnap_get_u64(p + 8);
+
+    if (length < PHSNAP_SNAPSHOT_HEADER_SIZE || length > file->length - file->offset)
+        return PHSNAP_ERROR_FORMAT;
+
+    end = p + length;
+    snapshot->time = (int64_t)phsnap_get_u64(p + 16);
+    snapshot->table_count = phsnap_get_u32(p + 24);
+    p += PHSNAP_SNAPSHOT_HEADER_SIZE;
+
+    if (snapshot->table_count > (size_t)(end - p) / PHSNAP_TABLE_HEADER_SIZE)
+        return PHSNAP_ERROR_FORMAT;
+
+    if (snapshot->table_count != 0 && !(snapshot->tables = calloc(snapshot->table_count, sizeof(phsnap_table))))
+        return PHSNAP_ERROR_MEMORY;
+
+    for (i = 0; i < snapshot->table_count; i++)
+    {
+        uint64_t tableLength;
+
+        if ((size_t)(end - p) < PHSNAP_TABLE_HEADER_SIZE)
+        {
+            result = PHSNAP_ERROR_FORMAT;
+            goto Error;
+        }
+
+        tableLength = phsnap_get_u64(p + 24);
+
+        if (tableLength < PHSNAP_TABLE_HEADER_SIZE || tableLength > (uint64_t)(end - p))
+        {
+            result = PHSNAP_ERROR_FORMAT;
+            goto Error;
+        }
+
+        if ((result = phsnap_parse_table(&snapshot->tables[i], p, p + tableLength)) != PHSNAP_OK)
+            goto Error;
+
+        p += tableLength;
+    }
+
+    if (p != end)
+    {
+        result = PHSNAP_ERROR_FORMAT;
+        goto Error;
+    }
+
+    file->offset += (size_t)length;
+
+    return PHSNAP_OK;
+
+Error:
+    phsnap_free_snapshot(snapshot);
+    return result;
+}
+
+void phsnap_free_snapshot(phsnap_snapshot *snapshot)
+{
+    uint32_t i;
+    uint32_t j;
+
+    if (snapshot->tables)
+    {
+        for (i = 0; i < snapshot->table_count; i++)
+        {
+            phsnap_table *table = &snapshot->tables[i];
+
+            if (table->columns)
+            {
+                for (j = 0; j < table->column_count; j++)
+                    free(table->columns[j].dictionary);
+
+                free(table->columns);
+            }
+        }
+
+        free(snapshot->tables);
+    }
+
+    memset(snapshot, 0, sizeof(phsnap_snapshot));
+}
+
+const phsnap_table *phsnap_find_table(const phsnap_snapshot *snapshot, const char *name)
+{
+    uint32_t i;
+
+    for (i = 0; i < snapshot->table_count; i++)
+    {
+        if (strcmp(snapshot->tables[i].name, name) == 0)
+            return &snapshot->tables[i];
+    }
+
+    return NULL;
+}
+
+int phsnap_find_column(const phsnap_table *table, const char *name)
+{
+    uint32_t i;
+
+    for (i = 0; i < table->column_count; i++)
+    {
+        if (strcmp(table->columns[i].name, name) == 0)
+            return (int)i;
+    }
+
+    return -1;
+}
+
+int phsnap_read_integers(const phsnap_table *table, uint32_t column, int64_t *values)
+{
+    const phsnap_column *c;
+    const uint8_t *p;
+    const uint8_t *end;
+    uint64_t previous = 0;
+    uint32_t i;
+
+    if (column >= table->column_count)
+        return PHSNAP_ERROR_TYPE;
+
+    c = &table->columns[column];
+
+    if (c->type != PHSNAP_COLUMN_INTEGER)
+        return PHSNAP_ERROR_TYPE;
+
+    p = c->data;
+    end = c->data + c->data_length;
+
+    // Each value is the zigzag-encoded difference from the previous value.
+    for (i = 0; i < table->row_count; i++)
+    {
+        uint64_t delta;
+        size_t used;
+
+        // Fast path for single-byte deltas, which are by far the most common.
+        if (p != end && !(*p & 0x80))
+        {
+            delta = *p++;
+        }
+        else
+        {
+            if (!(used = phsnap_get_varint(p, end, &delta)))
+                return PHSNAP_ERROR_FORMAT;
+
+            p += used;
+        }
+
+        previous += (delta >> 1) ^ (0 - (delta & 1));
+        values[i] = (int64_t)previous;
+    }
+
+    return p == end ? PHSNAP_OK : PHSNAP_ERROR_FORMAT;
+}
+
+int phsnap_read_strings(const phsnap_table *table, uint32_t column, uint32_t *indices)
+{
+    const phsnap_column *c;
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t i;
+
+    if (column >= table->column_count)
+        return PHSNAP_ERROR_TYPE;
+
+    c = &table->columns[column];
+
+    if (c->type != PHSNAP_COLUMN_STRING)
+        return PHSNAP_ERROR_TYPE;
+
+    p = c->data;
+    end = c->data + c->data_length;
+
+    for (i = 0; i < table->row_count; i++)
+    {
+        uint64_t index;
+        size_t used;
+
+        if (!(used = phsnap_get_varint(p, end, &index)) || index > c->dictionary_count)
+            return PHSNAP_ERROR_FORMAT;
+
+        p += used;
+        indices[i] = (uint32_t)index;
+    }
+
+    return p == end ? PHSNAP_OK : PHSNAP_ERROR_FORMAT;
+}
+
+const char *phsnap_error_string(int error)
+{
+    switch (error)
+    {
+    case PHSNAP_OK:
+        return "success";
+    case PHSNAP_END:
+        return "end of file";
+    case PHSNAP_ERROR_IO:
+        return "I/O error";
+    case PHSNAP_ERROR_FORMAT:
+        return "invalid or corrupt snapshot";
+    case PHSNAP_ERROR_MEMORY:
+        return "out of memory";
+    case PHSNAP_ERROR_TYPE:
+        return "wrong column type";
+    default:
+        return "unknown error";
+    }
+}
@@ -0,0 +1,140 @@
+/*
+ * Process Hacker -
+ *   columnar snapshot reader
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHSNAP_H
+#define PHSNAP_H
+
+/*
+ * A reader for the columnar snapshot files written by phlib (see phlib/include/colsnap.h, which
+ * defines the format). This code only depends on the C standard library and POSIX mmap, so it
+ * can be built on Linux and other systems that do not have the Windows headers.
+ *
+ * A file is a sequence of snapshots. Each snapshot contains tables, such as "process" and
+ * "thread", and each table stores its rows column by column. Integer columns are decoded into
+ * arrays of int64_t. String columns are decoded into arrays of dictionary indices, where 0 means
+ * that the value is missing and i refers to entry i - 1 of the column's dictionary.
+ *
+ *     phsnap_file file;
+ *     phsnap_snapshot snapshot;
+ *
+ *     if (phsnap_open(&file, "snapshots.bin") == PHSNAP_OK)
+ *     {
+ *         while (phsnap_next(&file, &snapshot) == PHSNAP_OK)
+ *         {
+ *             const phsnap_table *table = phsnap_find_table(&snapshot, "process");
+ *             ...
+ *             phsnap_free_snapshot(&snapshot);
+ *         }
+ *
+ *         phsnap_close(&file);
+ *     }
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PHSNAP_MAGIC 0x53534850 /* "PHSS" */
+#define PHSNAP_VERSION 1
+
+#define PHSNAP_SNAPSHOT_HEADER_SIZE 32
+#define PHSNAP_TABLE_HEADER_SIZE 32
+#define PHSNAP_COLUMN_HEADER_SIZE 48
+#define PHSNAP_TABLE_NAME_SIZE 16
+#define PHSNAP_COLUMN_NAME_SIZE 24
+
+#define PHSNAP_COLUMN_INTEGER 1
+#define PHSNAP_COLUMN_STRING 2
+
+#define PHSNAP_OK 0
+#define PHSNAP_END 1
+#define PHSNAP_ERROR_IO (-1)
+#define PHSNAP_ERROR_FORMAT (-2)
+#define PHSNAP_ERROR_MEMORY (-3)
+#define PHSNAP_ERROR_TYPE (-4)
+
+typedef struct phsnap_string
+{
+    const char *data; /* UTF-8, not null-terminated */
+    uint32_t length;
+} phsnap_string;
+
+typedef struct phsnap_column
+{
+    char name[PHSNAP_COLUMN_NAME_SIZE + 1];
+    uint32_t type;
+    uint32_t dictionary_count;
+    phsnap_string *dictionary;
+    const uint8_t *data;
+    size_t data_length;
+} phsnap_column;
+
+typedef struct phsnap_table
+{
+    char name[PHSNAP_TABLE_NAME_SIZE + 1];
+    uint32_t row_count;
+    uint32_t column_count;
+    phsnap_column *columns;
+} phsnap_table;
+
+typedef struct phsnap_snapshot
+{
+    int64_t time; /* 100ns intervals since 1601-01-01 UTC */
+    uint32_t table_count;
+    phsnap_table *tables;
+} phsnap_snapshot;
+
+typedef struct phsnap_file
+{
+    const uint8_t *data;
+    size_t length;
+    size_t offset;
+    int mapped;
+} phsnap_file;
+
+/* Maps a file into memory. */
+int phsnap_open(phsnap_file *file, const char *path);
+/* Reads snapshots from a buffer, which must remain valid until the file is closed. */
+void phsnap_open_memory(phsnap_file *file, const void *data, size_t length);
+void phsnap_close(phsnap_file *file);
+
+/* Parses the next snapshot. Returns PHSNAP_END when there are no more snapshots. */
+int phsnap_next(phsnap_file *file, phsnap_snapshot *snapshot);
+void phsnap_free_snapshot(phsnap_snapshot *snapshot);
+
+const phsnap_table *phsnap_find_table(const phsnap_snapshot *snapshot, const char *name);
+/* Returns the index of a column, or -1 if the table does not have the column. */
+int phsnap_find_column(const phsnap_table *table, const char *name);
+
+/* Decodes every value of an integer column. values must have room for row_count elements. */
+int phsnap_read_integers(const phsnap_table *table, uint32_t column, int64_t *values);
+/* Decodes the dictionary index of every value of a string column. */
+int phsnap_read_strings(const phsnap_table *table, uint32_t column, uint32_t *indices);
+
+const char *phsnap_error_string(int error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ * Process Hacker -
+ *   columnar snapshot dump tool
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * snapdump file...              Lists the snapshots and tables in each file.
+ * snapdump -t table file...     Prints the rows of a table from every snapshot as CSV.
+ */
+
+#include "phsnap.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_csv_string(const phsnap_string *string)
+{
+    uint32_t i;
+
+    putchar('"');
+
+    for (i = 0; i < string->length; i++)
+    {
+        if (string->data[i] == '"')
+            putchar('"');
+
+        putchar(string->data[i]);
+    }
+
+    putchar('"');
+}
+
+static int print_table(const phsnap_table *table, int print_header)
+{
+    int64_t **integers;
+    uint32_t **strings;
+    uint32_t i;
+    uint32_t j;
+    int result = PHSNAP_OK;
+
+    integers = calloc(table->column_count ? table->column_count : 1, sizeof(int64_t *));
+    strings = calloc(table->column_count ? table->column_count : 1, sizeof(uint32_t *));
+
+    if (!integers || !strings)
+    {
+        result = PHSNAP_ERROR_MEMORY;
+        goto CleanupExit;
+    }
+
+    // Decode whole columns first, then print row by row.
+    for (j = 0; j < table->column_count && result == PHSNAP_OK; j++)
+    {
+        size_t count = table->row_count ? table->row_count : 1;
+
+        if (table->columns[j].type == PHSNAP_COLUMN_INTEGER)
+        {
+            if (!(integers[j] = malloc(count * sizeof(int64_t))))
+                result = PHSNAP_ERROR_MEMORY;
+            else
+                result = phsnap_read_integers(table, j, integers[j]);
+        }
+        else
+        {
+            if (!(strings[j] = malloc(count * sizeof(uint32_t))))
+                result = PHSNAP_ERROR_MEMORY;
+            else
+                result = phsnap_read_strings(table, j, strings[j]);
+        }
+    }
+
+    if (result != PHSNAP_OK)
+        goto CleanupExit;
+
+    if (print_header)
+    {
+        for (j = 0; j < table->column_count; j++)
+            printf("%s%s", j ? "," : "", table->columns[j].name);
+
+        putchar('\n');
+    }
+
+    for (i = 0; i < table->row_count; i++)
+    {
+        for (j = 0; j < table->column_count; j++)
+        {
+            if (j)
+                putchar(',');
+
+            if (integers[j])
+            {
+                printf("%" PRId64, integers[j][i]);
+            }
+            else if (strings[j][i] != 0)
+            {
+                print_csv_string(&table->columns[j].dictionary[strings[j][i] - 1]);
+            }
+        }
+
+        putchar('\n');
+    }
+
+CleanupExit:
+    if (integers && strings)
+    {
+        for (j = 0; j < table->column_count; j++)
+        {
+            free(integers[j]);
+            free(strings[j]);
+        }
+    }
+
+    free(integers);
+    free(strings);
+
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *table_name = NULL;
+    int header_printed = 0;
+    int argi = 1;
+    int exit_code = 0;
+
+    if (argc > 2 && strcmp(argv[1], "-t") == 0)
+    {
+        table_name = argv[2];
+        argi = 3;
+    }
+
+    if (argi >= argc)
+    {
+        fprintf(stderr, "usage: %s [-t table] file...\n", argv[0]);
+        return 2;
+    }
+
+    for (; argi < argc; argi++)
+    {
+        phsnap_file file;
+        phsnap_snapshot snapshot;
+        uint64_t index = 0;
+        int result;
+
+        if ((result = phsnap_open(&file, argv[argi])) != PHSNAP_OK)
+        {
+            fprintf(stderr, "%s: %s\n", argv[argi], phsnap_error_string(result));
+            exit_code = 1;
+            continue;
+        }
+
+        while ((result = phsnap_next(&file, &snapshot)) == PHSNAP_OK)
+        {
+            uint32_t i;
+
+            if (table_name)
+            {
+                const phsnap_table *table;
+
+                if ((table = phsnap_find_table(&snapshot, table_name)))
+                {
+                    result = print_table(table, !header_printed);
+                    header_printed = 1;
+                }
+            }
+            else
+            {
+                printf("%s: snapshot %" PRIu64 ", time %" PRId64 "\n", argv[argi], index, snapshot.time);
+
+                for (i = 0; i < snapshot.table_count; i++)
+                {
+                    printf(
+                        "  %-16s %10" PRIu32 " rows %4" PRIu32 " columns\n",
+                        snapshot.tables[i].name,
+                        snapshot.tables[i].row_count,
+                        snapshot.tables[i].column_count
+                        );
+                }
+            }
+
+            phsnap_free_snapshot(&snapshot);
+            index++;
+
+            if (result != PHSNAP_OK)
+                break;
+        }
+
+        if (result != PHSNAP_END)
+        {
+            fprintf(stderr, "%s: snapshot %" PRIu64 ": %s\n", argv[argi], index, phsnap_error_string(result));
+            exit_code = 1;
+        }
+
+        phsnap_close(&file);
+    }
+
+    return exit_code;
+}
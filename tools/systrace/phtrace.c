@@ -0,0 +1,612 @@
+/*
+ * Process Hacker -
+ *   system information trace reader
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS
+#else
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "phtrace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Offsets in SYSTEM_PROCESS_INFORMATION, which are the same for 32-bit and 64-bit systems up to
+ * the image name. */
+#define PHTRACE_PROCESS_NEXT_ENTRY_OFFSET 0
+#define PHTRACE_PROCESS_NUMBER_OF_THREADS 4
+#define PHTRACE_PROCESS_IMAGE_NAME 56
+
+/* All integers in the file are little-endian. */
+
+static uint32_t phtrace_get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t phtrace_get_u64(const uint8_t *p)
+{
+    return (uint64_t)phtrace_get_u32(p) | ((uint64_t)phtrace_get_u32(p + 4) << 32);
+}
+
+static uint64_t phtrace_get_pointer(const phtrace_file *file, const uint8_t *p)
+{
+    return file->pointer_size == 8 ? phtrace_get_u64(p) : phtrace_get_u32(p);
+}
+
+/* Decodes an unsigned LEB128 value of up to 32 bits. Returns the number of bytes used, or 0 if
+ * the value is truncated or too long. */
+static size_t phtrace_get_varint(const uint8_t *p, const uint8_t *end, uint32_t *value)
+{
+    const uint8_t *start = p;
+    uint32_t result = 0;
+    unsigned int shift = 0;
+
+    while (p != end && shift <= 28)
+    {
+        uint8_t b = *p++;
+
+        result |= (uint32_t)(b & 0x7f) << shift;
+
+        if (!(b & 0x80))
+        {
+            *value = result;
+            return (size_t)(p - start);
+        }
+
+        shift += 7;
+    }
+
+    return 0;
+}
+
+static int phtrace_read_header(phtrace_file *file)
+{
+    if (file->length < PHTRACE_FILE_HEADER_SIZE)
+        return PHTRACE_ERROR_FORMAT;
+
+    if (phtrace_get_u32(file->data) != PHTRACE_MAGIC || phtrace_get_u32(file->data + 4) != PHTRACE_VERSION)
+        return PHTRACE_ERROR_FORMAT;
+
+    file->pointer_size = phtrace_get_u32(file->data + 8);
+    file->number_of_processors = phtrace_get_u32(file->data + 12);
+    file->offset = PHTRACE_FILE_HEADER_SIZE;
+
+    if (file->pointer_size != 4 && file->pointer_size != 8)
+        return PHTRACE_ERROR_FORMAT;
+
+    return PHTRACE_OK;
+}
+
+int phtrace_open(phtrace_file *file, const char *path)
+{
+    int result;
+
+    memset(file, 0, sizeof(phtrace_file));
+
+#ifdef _WIN32
+    {
+        FILE *stream;
+        long length;
+        uint8_t *data;
+
+        if (!(stream = fopen(path, "rb")))
+            return PHTRACE_ERROR_IO;
+
+        if (fseek(stream, 0, SEEK_END) != 0 || (length = ftell(stream)) < 0 || fseek(stream, 0, SEEK_SET) != 0)
+        {
+            fclose(stream);
+            return PHTRACE_ERROR_IO;
+        }
+
+        if (!(data = malloc(length ? length : 1)))
+        {
+            fclose(stream);
+            return PHTRACE_ERROR_MEMORY;
+        }
+
+        if (fread(data, 1, length, stream) != (size_t)length)
+        {
+            free(data);
+            fclose(stream);
+            return PHTRACE_ERROR_IO;
+        }
+
+        fclose(stream);
+        file->data = data;
+        file->length = length;
+    }
+#else
+    {
+        int fd;
+        struct stat st;
+        void *data;
+
+        if ((fd = open(path, O_RDONLY)) < 0)
+            return PHTRACE_ERROR_IO;
+
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            return PHTRACE_ERROR_IO;
+        }
+
+        if (st.st_size != 0)
+        {
+            data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (data == MAP_FAILED)
+            {
+                close(fd);
+                return PHTRACE_ERROR_IO;
+            }
+
+            file->data = data;
+            file->length = (size_t)st.st_size;
+        }
+
+        close(fd);
+    }
+#endif
+
+    file->mapped = 1;
+
+    if ((result = phtrace_read_header(file)) != PHTRACE_OK)
+        phtrace_close(file);
+
+    return result;
+}
+
+int phtrace_open_memory(phtrace_file *file, const void *data, size_t length)
+{
+    memset(file, 0, sizeof(phtrace_file));
+    file->data = data;
+    file->length = length;
+
+    return phtrace_read_header(file);
+}
+
+static void phtrace_free_block(phtrace_block *block)
+{
+    free(block->entry_offsets);
+    free(block->data);
+    free(block);
+}
+
+void phtrace_close(phtrace_file *file)
+{
+    uint32_t i;
+
+    for (i = 0; i < file->block_count; i++)
+        phtrace_free_block(file->blocks[i]);
+
+    free(file->blocks);
+    free(file->tick_blocks);
+
+    if (file->mapped && file->data)
+    {
+#ifdef _WIN32
+        free((void *)file->data);
+#else
+        munmap((void *)file->data, file->length);
+#endif
+    }
+
+    memset(file, 0, sizeof(phtrace_file));
+}
+
+static int phtrace_is_process_class(uint32_t information_class)
+{
+    return
+        information_class == PHTRACE_CLASS_PROCESS ||
+        information_class == PHTRACE_CLASS_EXTENDED_PROCESS ||
+        information_class == PHTRACE_CLASS_FULL_PROCESS;
+}
+
+static uint32_t phtrace_entry_length(const phtrace_block *block, uint32_t entry)
+{
+    if (entry + 1 < block->entry_count)
+        return block->entry_offsets[entry + 1] - block->entry_offsets[entry];
+    else
+        return block->length - block->entry_offsets[entry];
+}
+
+static phtrace_block *phtrace_find_latest_block(phtrace_file *file, uint32_t information_class)
+{
+    uint32_t i;
+
+    for (i = 0; i < file->block_count; i++)
+    {
+        if (file->blocks[i]->latest && file->blocks[i]->information_class == information_class)
+            return file->blocks[i];
+    }
+
+    return NULL;
+}
+
+static int phtrace_decode_delta(
+    const uint8_t **position,
+    const uint8_t *end,
+    uint8_t *data,
+    uint32_t length,
+    const uint8_t *reference,
+    uint32_t reference_length
+    )
+{
+    uint32_t i = 0;
+
+    while (i < length)
+    {
+        uint32_t copy_length;
+        uint32_t literal_length;
+        size_t used;
+
+        if (!(used = phtrace_get_varint(*position, end, &copy_length)))
+            return 0;
+        *position += used;
+        if (!(used = phtrace_get_varint(*position, end, &literal_length)))
+            return 0;
+        *position += used;
+
+        if (copy_length > length - i)
+            return 0;
+
+        /* Bytes beyond the end of the reference are zero. */
+        if (i < reference_length)
+        {
+            uint32_t reference_copy_length = copy_length < reference_length - i ? copy_length : reference_length - i;
+
+            memcpy(data + i, reference + i, reference_copy_length);
+            memset(data + i + reference_copy_length, 0, copy_length - reference_copy_length);
+        }
+        else
+        {
+            memset(data + i, 0, copy_length);
+        }
+
+        i += copy_length;
+
+        if (literal_length > length - i || literal_length > (size_t)(end - *position))
+            return 0;
+
+        memcpy(data + i, *position, literal_length);
+        *position += literal_length;
+        i += literal_length;
+    }
+
+    return 1;
+}
+
+static int phtrace_split_block(const phtrace_file *file, phtrace_block *block)
+{
+    /* Each entry must extend at least to the end of UniqueProcessId. */
+    uint32_t header_length = PHTRACE_PROCESS_IMAGE_NAME + 4 * file->pointer_size;
+    uint32_t allocated_count = 64;
+    uint32_t offset = 0;
+    uint32_t i;
+
+    if (!(block->entry_offsets = malloc(sizeof(uint32_t) * allocated_count)))
+        return PHTRACE_ERROR_MEMORY;
+
+    if (block->length == 0)
+        return PHTRACE_OK;
+
+    while (1)
+    {
+        uint32_t next_entry_offset;
+
+        if (block->length - offset < header_length)
+            return PHTRACE_ERROR_FORMAT;
+
+        if (block->entry_count == allocated_count)
+        {
+            uint32_t *entry_offsets;
+
+            allocated_count *= 2;
+
+            if (!(entry_offsets = realloc(block->entry_offsets, sizeof(uint32_t) * allocated_count)))
+                return PHTRACE_ERROR_MEMORY;
+
+            block->entry_offsets = entry_offsets;
+        }
+
+        block->entry_offsets[block->entry_count++] = offset;
+        next_entry_offset = phtrace_get_u32(block->data + offset + PHTRACE_PROCESS_NEXT_ENTRY_OFFSET);
+
+        if (next_entry_offset == 0)
+            break;
+        if (next_entry_offset < header_length || next_entry_offset > block->length - offset)
+            return PHTRACE_ERROR_FORMAT;
+
+        offset += next_entry_offset;
+    }
+
+    /* Image names must be inside their entries. */
+    for (i = 0; i < block->entry_count; i++)
+    {
+        const uint8_t *entry = block->data + block->entry_offsets[i];
+        uint32_t name_length = entry[PHTRACE_PROCESS_IMAGE_NAME] | (entry[PHTRACE_PROCESS_IMAGE_NAME + 1] << 8);
+        uint64_t name_offset = phtrace_get_pointer(file, entry + PHTRACE_PROCESS_IMAGE_NAME + file->pointer_size);
+        uint32_t entry_length = phtrace_entry_length(block, i);
+
+        if (name_offset == 0 && name_length != 0)
+            return PHTRACE_ERROR_FORMAT;
+        if (name_offset > entry_length || name_length > entry_length - name_offset)
+            return PHTRACE_ERROR_FORMAT;
+    }
+
+    return PHTRACE_OK;
+}
+
+static int phtrace_decode_block(
+    phtrace_file *file,
+    phtrace_block *block,
+    const uint8_t *p,
+    const uint8_t *end
+    )
+{
+    phtrace_block *reference = phtrace_find_latest_block(file, block->information_class);
+
+    if (!(block->data = malloc(block->length ? block->length : 1)))
+        return PHTRACE_ERROR_MEMORY;
+
+    if (phtrace_is_process_class(block->information_class))
+    {
+        uint32_t offset = 0;
+
+        while (offset < block->length)
+        {
+            uint32_t index;
+            uint32_t entry_length;
+            const uint8_t *entry_reference = NULL;
+            uint32_t entry_reference_length = 0;
+            size_t used;
+
+            if (!(used = phtrace_get_varint(p, end, &index)))
+                return PHTRACE_ERROR_FORMAT;
+            p += used;
+            if (!(used = phtrace_get_varint(p, end, &entry_length)))
+                return PHTRACE_ERROR_FORMAT;
+            p += used;
+
+            if (entry_length > block->length - offset)
+                return PHTRACE_ERROR_FORMAT;
+
+            /* The entry of the same process in the previous block. */
+            if (index != 0)
+            {
+                if (!reference || !reference->entry_offsets || index > reference->entry_count)
+                    return PHTRACE_ERROR_FORMAT;
+
+                entry_reference = reference->data + reference->entry_offsets[index - 1];
+                entry_reference_length = phtrace_entry_length(reference, index - 1);
+            }
+
+            if (!phtrace_decode_delta(&p, end, block->data + offset, entry_length, entry_reference, entry_reference_length))
+                return PHTRACE_ERROR_FORMAT;
+
+            offset += entry_length;
+        }
+
+        if (p != end)
+            return PHTRACE_ERROR_FORMAT;
+
+        return phtrace_split_block(file, block);
+    }
+    else
+    {
+        if (!phtrace_decode_delta(
+            &p,
+            end,
+            block->data,
+            block->length,
+            reference ? reference->data : NULL,
+            reference ? reference->length : 0
+            ))
+            return PHTRACE_ERROR_FORMAT;
+
+        return p == end ? PHTRACE_OK : PHTRACE_ERROR_FORMAT;
+    }
+}
+
+static int phtrace_add_block(phtrace_file *file, phtrace_block *block)
+{
+    phtrace_block *previous;
+
+    if (file->block_count == file->allocated_block_count)
+    {
+        uint32_t allocated_count = file->allocated_block_count ? file->allocated_block_count * 2 : 16;
+        phtrace_block **blocks;
+
+        if (!(blocks = realloc(file->blocks, sizeof(phtrace_block *) * allocated_count)))
+            return PHTRACE_ERROR_MEMORY;
+
+        file->blocks = blocks;
+        file->allocated_block_count = allocated_count;
+    }
+
+    if ((previous = phtrace_find_latest_block(file, block->information_class)))
+    {
+        previous->latest = 0;
+
+        /* Blocks of the current tick are freed by the next call to phtrace_next. */
+        if (!previous->current)
+        {
+            uint32_t i;
+
+            for (i = 0; file->blocks[i] != previous; i++)
+                ;
+
+            phtrace_free_block(previous);
+            file->blocks[i] = file->blocks[--file->block_count];
+        }
+    }
+
+    block->latest = 1;
+    block->current = 1;
+    file->blocks[file->block_count++] = block;
+
+    return PHTRACE_OK;
+}
+
+int phtrace_next(phtrace_file *file, phtrace_tick *tick)
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t length;
+    uint32_t i;
+    int result;
+
+    memset(tick, 0, sizeof(phtrace_tick));
+
+    /* Keep only the latest blocks, which the blocks of the next tick are decoded against. */
+    for (i = 0; i < file->block_count; i++)
+    {
+        if (file->blocks[i]->latest)
+        {
+            file->blocks[i]->current = 0;
+        }
+        else
+        {
+            phtrace_free_block(file->blocks[i]);
+            file->blocks[i--] = file->blocks[--file->block_count];
+        }
+    }
+
+    free(file->tick_blocks);
+    file->tick_blocks = NULL;
+
+    /* A tick that was only partially written ends the trace. */
+    if (file->length - file->offset < PHTRACE_TICK_HEADER_SIZE)
+        return PHTRACE_END;
+
+    p = file->data + file->offset;
+    length = phtrace_get_u32(p);
+
+    if (length < PHTRACE_TICK_HEADER_SIZE)
+        return PHTRACE_ERROR_FORMAT;
+    if (length > file->length - file->offset)
+        return PHTRACE_END;
+
+    end = p + length;
+    tick->block_count = phtrace_get_u32(p + 4);
+    tick->time = (int64_t)phtrace_get_u64(p + 8);
+    p += PHTRACE_TICK_HEADER_SIZE;
+
+    if (tick->block_count > (size_t)(end - p) / PHTRACE_BLOCK_HEADER_SIZE)
+        return PHTRACE_ERROR_FORMAT;
+
+    if (!(file->tick_blocks = calloc(tick->block_count ? tick->block_count : 1, sizeof(phtrace_block *))))
+        return PHTRACE_ERROR_MEMORY;
+
+    tick->blocks = file->tick_blocks;
+
+    for (i = 0; i < tick->block_count; i++)
+    {
+        phtrace_block *block;
+
+        if ((size_t)(end - p) < PHTRACE_BLOCK_HEADER_SIZE)
+            return PHTRACE_ERROR_FORMAT;
+        if (!(block = calloc(1, sizeof(phtrace_block))))
+            return PHTRACE_ERROR_MEMORY;
+
+        block->information_class = phtrace_get_u32(p);
+        block->length = phtrace_get_u32(p + 4);
+        block->encoded_length = phtrace_get_u32(p + 8);
+        p += PHTRACE_BLOCK_HEADER_SIZE;
+
+        if (block->length > PHTRACE_MAXIMUM_BLOCK_LENGTH || block->encoded_length > (size_t)(end - p))
+        {
+            phtrace_free_block(block);
+            return PHTRACE_ERROR_FORMAT;
+        }
+
+        if ((result = phtrace_decode_block(file, block, p, p + block->encoded_length)) != PHTRACE_OK ||
+            (result = phtrace_add_block(file, block)) != PHTRACE_OK)
+        {
+            phtrace_free_block(block);
+            return result;
+        }
+
+        tick->blocks[i] = block;
+        p += block->encoded_length;
+    }
+
+    if (p != end)
+        return PHTRACE_ERROR_FORMAT;
+
+    file->offset += length;
+
+    return PHTRACE_OK;
+}
+
+const phtrace_block *phtrace_find_block(const phtrace_tick *tick, uint32_t information_class)
+{
+    uint32_t i;
+
+    for (i = 0; i < tick->block_count; i++)
+    {
+        if (tick->blocks[i]->information_class == information_class)
+            return tick->blocks[i];
+    }
+
+    return NULL;
+}
+
+uint32_t phtrace_process_thread_count(const phtrace_block *block, uint32_t entry)
+{
+    return phtrace_get_u32(block->data + block->entry_offsets[entry] + PHTRACE_PROCESS_NUMBER_OF_THREADS);
+}
+
+uint64_t phtrace_process_id(const phtrace_file *file, const phtrace_block *block, uint32_t entry)
+{
+    /* UniqueProcessId follows the image name and BasePriority, aligned to a pointer. */
+    uint32_t offset = PHTRACE_PROCESS_IMAGE_NAME + 2 * file->pointer_size + file->pointer_size;
+
+    return phtrace_get_pointer(file, block->data + block->entry_offsets[entry] + offset);
+}
+
+const char *phtrace_error_string(int error)
+{
+    switch (error)
+    {
+    case PHTRACE_OK:
+        return "success";
+    case PHTRACE_END:
+        return "end of file";
+    case PHTRACE_ERROR_IO:
+        return "I/O error";
+    case PHTRACE_ERROR_FORMAT:
+        return "invalid or corrupt trace";
+    case PHTRACE_ERROR_MEMORY:
+        return "out of memory";
+    default:
+        return "unknown error";
+    }
+}
@@ -0,0 +1,134 @@
+/*
+ * Process Hacker -
+ *   system information trace reader
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHTRACE_H
+#define PHTRACE_H
+
+/*
+ * A reader for the system information traces recorded by phlib (see phlib/include/systrace.h,
+ * which defines the format). This code only depends on the C standard library and POSIX mmap, so
+ * it can be built on Linux and other systems that do not have the Windows headers.
+ *
+ * A trace is a sequence of ticks, and each tick contains blocks of information returned by
+ * NtQuerySystemInformation. The blocks are decoded into the layout that the recording system
+ * used, except that the image name pointers of processes are offsets from the start of each
+ * process entry (or 0).
+ *
+ *     phtrace_file file;
+ *     phtrace_tick tick;
+ *
+ *     if (phtrace_open(&file, "trace.bin") == PHTRACE_OK)
+ *     {
+ *         while (phtrace_next(&file, &tick) == PHTRACE_OK)
+ *         {
+ *             const phtrace_block *block = phtrace_find_block(&tick, PHTRACE_CLASS_PROCESS);
+ *             ...
+ *         }
+ *
+ *         phtrace_close(&file);
+ *     }
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PHTRACE_MAGIC 0x54534850 /* "PHST" */
+#define PHTRACE_VERSION 1
+
+#define PHTRACE_FILE_HEADER_SIZE 16
+#define PHTRACE_TICK_HEADER_SIZE 16
+#define PHTRACE_BLOCK_HEADER_SIZE 16
+#define PHTRACE_MAXIMUM_BLOCK_LENGTH (256 * 1024 * 1024)
+
+/* Information classes that are split into process entries. */
+#define PHTRACE_CLASS_PROCESS 5
+#define PHTRACE_CLASS_EXTENDED_PROCESS 57
+#define PHTRACE_CLASS_FULL_PROCESS 148
+
+#define PHTRACE_OK 0
+#define PHTRACE_END 1
+#define PHTRACE_ERROR_IO (-1)
+#define PHTRACE_ERROR_FORMAT (-2)
+#define PHTRACE_ERROR_MEMORY (-3)
+
+typedef struct phtrace_block
+{
+    uint32_t information_class;
+    uint32_t length;
+    uint32_t encoded_length;
+    uint8_t *data;
+    /* Process information only */
+    uint32_t entry_count;
+    uint32_t *entry_offsets;
+    /* Internal */
+    int latest;
+    int current;
+} phtrace_block;
+
+typedef struct phtrace_tick
+{
+    int64_t time; /* 100ns intervals since 1601-01-01 UTC */
+    uint32_t block_count;
+    phtrace_block **blocks;
+} phtrace_tick;
+
+typedef struct phtrace_file
+{
+    const uint8_t *data;
+    size_t length;
+    size_t offset;
+    int mapped;
+    uint32_t pointer_size;
+    uint32_t number_of_processors;
+    /* The blocks of the current tick and the latest block of each class. */
+    uint32_t block_count;
+    uint32_t allocated_block_count;
+    phtrace_block **blocks;
+    phtrace_block **tick_blocks;
+} phtrace_file;
+
+/* Maps a file into memory and reads the file header. */
+int phtrace_open(phtrace_file *file, const char *path);
+/* Reads a trace from a buffer, which must remain valid until the file is closed. */
+int phtrace_open_memory(phtrace_file *file, const void *data, size_t length);
+void phtrace_close(phtrace_file *file);
+
+/* Decodes the next tick. Returns PHTRACE_END when there are no more complete ticks. The blocks of
+ * a tick remain valid until the next call to phtrace_next or phtrace_close. */
+int phtrace_next(phtrace_file *file, phtrace_tick *tick);
+
+/* Returns the first block of an information class in a tick, or NULL. */
+const phtrace_block *phtrace_find_block(const phtrace_tick *tick, uint32_t information_class);
+
+/* Process entries. The offsets depend on the pointer size of the recording system. */
+uint32_t phtrace_process_thread_count(const phtrace_block *block, uint32_t entry);
+uint64_t phtrace_process_id(const phtrace_file *file, const phtrace_block *block, uint32_t entry);
+
+const char *phtrace_error_string(int error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ * Process Hacker -
+ *   system information trace dump tool
+ *
+ * This file is part of Process Hacker.
+ *
+ * Process Hacker is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Process Hacker is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Process Hacker.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * tracedump file...        Lists the ticks and blocks in each file.
+ * tracedump -s file...     Only prints a summary of each file: the number of ticks, the size of
+ *                          the information before and after encoding, and the decoding time.
+ */
+
+#include "phtrace.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static void print_block(const phtrace_file *file, const phtrace_block *block)
+{
+    printf(
+        "  class %3" PRIu32 " %10" PRIu32 " bytes %10" PRIu32 " encoded",
+        block->information_class,
+        block->length,
+        block->encoded_length
+        );
+
+    if (block->entry_offsets)
+    {
+        uint64_t thread_count = 0;
+        uint32_t i;
+
+        for (i = 0; i < block->entry_count; i++)
+            thread_count += phtrace_process_thread_count(block, i);
+
+        printf(" %6" PRIu32 " processes %7" PRIu64 " threads", block->entry_count, thread_count);
+
+        if (block->entry_count != 0)
+            printf(" (first PID %" PRIu64 ")", phtrace_process_id(file, block, 0));
+    }
+
+    putchar('\n');
+}
+
+int main(int argc, char *argv[])
+{
+    int summary = 0;
+    int argi = 1;
+    int exit_code = 0;
+
+    if (argc > 1 && strcmp(argv[1], "-s") == 0)
+    {
+        summary = 1;
+        argi = 2;
+    }
+
+    if (argi >= argc)
+    {
+        fprintf(stderr, "usage: %s [-s] file...\n", argv[0]);
+        return 2;
+    }
+
+    for (; argi < argc; argi++)
+    {
+        phtrace_file file;
+        phtrace_tick tick;
+        uint64_t index = 0;
+        uint64_t length = 0;
+        uint64_t encoded_length = 0;
+        clock_t start;
+        int result;
+
+        if ((result = phtrace_open(&file, argv[argi])) != PHTRACE_OK)
+        {
+            fprintf(stderr, "%s: %s\n", argv[argi], phtrace_error_string(result));
+            exit_code = 1;
+            continue;
+        }
+
+        if (!summary)
+        {
+            printf(
+                "%s: %" PRIu32 "-bit, %" PRIu32 " processors\n",
+                argv[argi],
+                file.pointer_size * 8,
+                file.number_of_processors
+                );
+        }
+
+        start = clock();
+
+        while ((result = phtrace_next(&file, &tick)) == PHTRACE_OK)
+        {
+            uint32_t i;
+
+            if (!summary)
+                printf("tick %" PRIu64 ", time %" PRId64 "\n", index, tick.time);
+
+            for (i = 0; i < tick.block_count; i++)
+            {
+                length += tick.blocks[i]->length;
+                encoded_length += tick.blocks[i]->encoded_length;
+
+                if (!summary)
+                    print_block(&file, tick.blocks[i]);
+            }
+
+            index++;
+        }
+
+        if (result != PHTRACE_END)
+        {
+            fprintf(stderr, "%s: tick %" PRIu64 ": %s\n", argv[argi], index, phtrace_error_string(result));
+            exit_code = 1;
+        }
+
+        printf(
+            "%s: %" PRIu64 " ticks, %" PRIu64 " bytes encoded as %" PRIu64 " bytes (%.1f%%), decoded in %.1f ms\n",
+            argv[argi],
+            index,
+            length,
+            encoded_length,
+            length ? (double)encoded_length * 100 / length : 0.0,
+            (double)(clock() - start) * 1000 / CLOCKS_PER_SEC
+            );
+
+        phtrace_close(&file);
+    }
+
+    return exit_code;
+}
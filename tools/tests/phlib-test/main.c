@@ -1,5 +1,17 @@
 #include "tests.h"
 
+DOUBLE GetElapsedMilliseconds(
+    _In_ PLARGE_INTEGER StartCounter
+    )
+{
+    LARGE_INTEGER endCounter;
+    LARGE_INTEGER frequency;
+
+    NtQueryPerformanceCounter(&endCounter, &frequency);
+
+    return (DOUBLE)(endCounter.QuadPart - StartCounter->QuadPart) * 1000 / frequency.QuadPart;
+}
+
 int __cdecl wmain(int argc, wchar_t *argv[])
 {
     NTSTATUS status;
@@ -11,6 +23,19 @@ int __cdecl wmain(int argc, wchar_t *argv[])
     Test_avltree();
     Test_format();
     Test_util();
+    Test_hash();
+    Test_graph();
+    Test_histbuf();
+    Test_binlog();
+    Test_settings();
+    Test_json();
+    Test_colsnap();
+    Test_phquery();
+    Test_iconcache();
+    Test_timeline();
+    Test_native();
+    Test_systrace();
+    Test_provider();
 
     return 0;
 }
@@ -0,0 +1,321 @@
+#include "tests.h"
+#include <binlog.h>
+
+#define WRITER_COUNT 4
+#define WRITER_RECORD_COUNT 5000
+
+static PPH_STRING FormatName(
+    _In_ ULONG Value
+    )
+{
+    return PhFormatString(L"process%lu.exe", Value);
+}
+
+static VOID Test_sequential(
+    VOID
+    )
+{
+    static PH_STRINGREF message = PH_STRINGREF_INIT(L"A message that is shared by every record");
+    NTSTATUS status;
+    PPH_BINARY_LOG log;
+    PH_BINARY_LOG_RECORD record;
+    PPH_STRINGREF strings[PH_BINARY_LOG_STRING_COUNT];
+    PPH_STRING readStrings[PH_BINARY_LOG_STRING_COUNT];
+    ULONG64 sequence;
+    ULONG64 firstSequence;
+    ULONG64 nextSequence;
+    ULONG i;
+
+    status = PhCreateBinaryLog(&log, NULL, 16, 4);
+    assert(NT_SUCCESS(status));
+
+    PhQueryBinaryLogRange(log, &firstSequence, &nextSequence);
+    assert(firstSequence == 0 && nextSequence == 0);
+    status = PhReadBinaryLog(log, 0, &record, NULL);
+    assert(status == STATUS_NOT_FOUND);
+
+    memset(&record, 0, sizeof(PH_BINARY_LOG_RECORD));
+    memset(strings, 0, sizeof(strings));
+
+    for (i = 0; i < 10000; i++)
+    {
+        PPH_STRING name;
+
+        name = FormatName(i % 50);
+        record.Type = 1 + i % 3;
+        record.Time.QuadPart = i;
+        record.Values[0] = i;
+        strings[0] = &name->sr;
+        strings[1] = i % 2 ? &message : NULL;
+        strings[2] = &name->sr;
+
+        status = PhWriteBinaryLog(log, &record, strings, &sequence);
+        assert(NT_SUCCESS(status));
+        assert(sequence == i);
+
+        PhDereferenceObject(name);
+    }
+
+    // The log only holds four 64 kB segments, so the oldest records must have been discarded.
+
+    PhQueryBinaryLogRange(log, &firstSequence, &nextSequence);
+    assert(nextSequence == 10000);
+    assert(firstSequence > 0 && firstSequence < nextSequence);
+    status = PhReadBinaryLog(log, firstSequence - 1, &record, NULL);
+    assert(status == STATUS_NOT_FOUND);
+    status = PhReadBinaryLog(log, nextSequence, &record, NULL);
+    assert(status == STATUS_NOT_FOUND);
+
+    for (sequence = firstSequence; sequence < nextSequence; sequence++)
+    {
+        PPH_STRING name;
+
+        status = PhReadBinaryLog(log, sequence, &record, readStrings);
+        assert(NT_SUCCESS(status));
+        assert(record.Type == 1 + sequence % 3);
+        assert(record.Time.QuadPart == (LONGLONG)sequence);
+        assert(record.Values[0] == sequence);
+
+        name = FormatName((ULONG)sequence % 50);
+        assert(readStrings[0] && PhEqualString(readStrings[0], name, FALSE));
+        assert(readStrings[2] && PhEqualString(readStrings[2], name, FALSE));
+        assert(record.Strings[0] == record.Strings[2]);
+        PhDereferenceObject(name);
+
+        if (sequence % 2)
+            assert(readStrings[1] && PhEqualStringRef(&readStrings[1]->sr, &message, FALSE));
+        else
+            assert(!readStrings[1]);
+
+        assert(!readStrings[3]);
+
+        for (i = 0; i < PH_BINARY_LOG_STRING_COUNT; i++)
+            PhClearReference(&readStrings[i]);
+    }
+
+    // Clearing the log keeps the sequence numbers increasing.
+
+    PhClearBinaryLog(log);
+    PhQueryBinaryLogRange(log, &firstSequence, &nextSequence);
+    assert(firstSequence == 10000 && nextSequence == 10000);
+    status = PhReadBinaryLog(log, 9999, &record, NULL);
+    assert(status == STATUS_NOT_FOUND);
+
+    record.Type = 1;
+    status = PhWriteBinaryLog(log, &record, NULL, &sequence);
+    assert(NT_SUCCESS(status));
+    assert(sequence == 10000);
+    status = PhReadBinaryLog(log, 10000, &record, readStrings);
+    assert(NT_SUCCESS(status));
+    assert(!readStrings[0] && !readStrings[1]);
+
+    PhDestroyBinaryLog(log);
+}
+
+static VOID Test_reopen(
+    VOID
+    )
+{
+    static PH_STRINGREF logFileName = PH_STRINGREF_INIT(L"%TEMP%\\phlib-test-binlog.bin");
+    NTSTATUS status;
+    PPH_STRING fileName;
+    PPH_BINARY_LOG log;
+    PH_BINARY_LOG_RECORD record;
+    PPH_STRINGREF strings[PH_BINARY_LOG_STRING_COUNT];
+    PPH_STRING readStrings[PH_BINARY_LOG_STRING_COUNT];
+    ULONG64 sequence;
+    ULONG64 firstSequence;
+    ULONG64 nextSequence;
+    ULONG64 reopenedFirstSequence;
+    ULONG64 reopenedNextSequence;
+    ULONG i;
+
+    fileName = PhExpandEnvironmentStrings(&logFileName);
+    PhDeleteFileWin32(fileName->Buffer);
+
+    status = PhCreateBinaryLog(&log, fileName->Buffer, 16, 4);
+    assert(NT_SUCCESS(status));
+
+    memset(&record, 0, sizeof(PH_BINARY_LOG_RECORD));
+    memset(strings, 0, sizeof(strings));
+
+    // Write enough records to rotate through every segment at least once.
+
+    for (i = 0; i < 10000; i++)
+    {
+        PPH_STRING name;
+
+        name = FormatName(i % 50);
+        record.Type = 1;
+        record.Time.QuadPart = i;
+        record.Values[0] = i;
+        strings[0] = &name->sr;
+
+        status = PhWriteBinaryLog(log, &record, strings, NULL);
+        assert(NT_SUCCESS(status));
+
+        PhDereferenceObject(name);
+    }
+
+    PhQueryBinaryLogRange(log, &firstSequence, &nextSequence);
+    assert(firstSequence > 0 && nextSequence == 10000);
+    PhDestroyBinaryLog(log);
+
+    // The records are still there after the log is opened again, and new records continue the
+    // sequence.
+
+    status = PhCreateBinaryLog(&log, fileName->Buffer, 16, 4);
+    assert(NT_SUCCESS(status));
+
+    PhQueryBinaryLogRange(log, &reopenedFirstSequence, &reopenedNextSequence);
+    assert(reopenedFirstSequence == firstSequence && reopenedNextSequence == nextSequence);
+
+    for (sequence = firstSequence; sequence < nextSequence; sequence++)
+    {
+        PPH_STRING name;
+
+        status = PhReadBinaryLog(log, sequence, &record, readStrings);
+        assert(NT_SUCCESS(status));
+        assert(record.Type == 1);
+        assert(record.Time.QuadPart == (LONGLONG)sequence);
+        assert(record.Values[0] == sequence);
+
+        name = FormatName((ULONG)sequence % 50);
+        assert(readStrings[0] && PhEqualString(readStrings[0], name, FALSE));
+        PhDereferenceObject(name);
+
+        for (i = 0; i < PH_BINARY_LOG_STRING_COUNT; i++)
+            PhClearReference(&readStrings[i]);
+    }
+
+    memset(&record, 0, sizeof(PH_BINARY_LOG_RECORD));
+    record.Type = 2;
+    status = PhWriteBinaryLog(log, &record, NULL, &sequence);
+    assert(NT_SUCCESS(status));
+    assert(sequence == nextSequence);
+    PhDestroyBinaryLog(log);
+
+    status = PhCreateBinaryLog(&log, fileName->Buffer, 16, 4);
+    assert(NT_SUCCESS(status));
+    PhQueryBinaryLogRange(log, &reopenedFirstSequence, &reopenedNextSequence);
+    assert(reopenedNextSequence == nextSequence + 1);
+    status = PhReadBinaryLog(log, nextSequence, &record, NULL);
+    assert(NT_SUCCESS(status));
+    assert(record.Type == 2);
+    PhDestroyBinaryLog(log);
+
+    // A file with a different layout is started over.
+
+    status = PhCreateBinaryLog(&log, fileName->Buffer, 16, 8);
+    assert(NT_SUCCESS(status));
+    PhQueryBinaryLogRange(log, &reopenedFirstSequence, &reopenedNextSequence);
+    assert(reopenedFirstSequence == 0 && reopenedNextSequence == 0);
+    PhDestroyBinaryLog(log);
+
+    PhDeleteFileWin32(fileName->Buffer);
+    PhDereferenceObject(fileName);
+}
+
+static NTSTATUS WriterThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PPH_BINARY_LOG log = ((PVOID *)Parameter)[0];
+    ULONG writer = PtrToUlong(((PVOID *)Parameter)[1]);
+    NTSTATUS status;
+    PH_BINARY_LOG_RECORD record;
+    PPH_STRINGREF strings[PH_BINARY_LOG_STRING_COUNT];
+    PPH_STRING name;
+    ULONG i;
+
+    name = FormatName(writer);
+    memset(&record, 0, sizeof(PH_BINARY_LOG_RECORD));
+    memset(strings, 0, sizeof(strings));
+    strings[0] = &name->sr;
+
+    for (i = 0; i < WRITER_RECORD_COUNT; i++)
+    {
+        record.Type = 1;
+        record.Values[0] = writer;
+        record.Values[1] = i;
+        status = PhWriteBinaryLog(log, &record, strings, NULL);
+        assert(NT_SUCCESS(status));
+    }
+
+    PhDereferenceObject(name);
+
+    return STATUS_SUCCESS;
+}
+
+static VOID Test_concurrent(
+    VOID
+    )
+{
+    NTSTATUS status;
+    PPH_BINARY_LOG log;
+    PVOID parameters[WRITER_COUNT][2];
+    HANDLE threadHandles[WRITER_COUNT];
+    ULONG nextValues[WRITER_COUNT];
+    PPH_STRING names[WRITER_COUNT];
+    PH_BINARY_LOG_RECORD record;
+    PPH_STRING readStrings[PH_BINARY_LOG_STRING_COUNT];
+    ULONG64 sequence;
+    ULONG64 firstSequence;
+    ULONG64 nextSequence;
+    ULONG i;
+
+    // 32 segments of 64 kB are enough to keep every record.
+    status = PhCreateBinaryLog(&log, NULL, 16, 32);
+    assert(NT_SUCCESS(status));
+
+    for (i = 0; i < WRITER_COUNT; i++)
+    {
+        parameters[i][0] = log;
+        parameters[i][1] = UlongToPtr(i);
+        threadHandles[i] = PhCreateThread2(WriterThreadStart, parameters[i]);
+        assert(threadHandles[i]);
+    }
+
+    for (i = 0; i < WRITER_COUNT; i++)
+    {
+        NtWaitForSingleObject(threadHandles[i], FALSE, NULL);
+        NtClose(threadHandles[i]);
+        nextValues[i] = 0;
+        names[i] = FormatName(i);
+    }
+
+    PhQueryBinaryLogRange(log, &firstSequence, &nextSequence);
+    assert(firstSequence == 0 && nextSequence == WRITER_COUNT * WRITER_RECORD_COUNT);
+
+    // Every record must be present exactly once, and each writer's records must be in order.
+
+    for (sequence = firstSequence; sequence < nextSequence; sequence++)
+    {
+        status = PhReadBinaryLog(log, sequence, &record, readStrings);
+        assert(NT_SUCCESS(status));
+        assert(record.Values[0] < WRITER_COUNT);
+        assert(record.Values[1] == nextValues[record.Values[0]]);
+        nextValues[record.Values[0]]++;
+        assert(readStrings[0] && PhEqualString(readStrings[0], names[record.Values[0]], FALSE));
+
+        for (i = 0; i < PH_BINARY_LOG_STRING_COUNT; i++)
+            PhClearReference(&readStrings[i]);
+    }
+
+    for (i = 0; i < WRITER_COUNT; i++)
+    {
+        assert(nextValues[i] == WRITER_RECORD_COUNT);
+        PhDereferenceObject(names[i]);
+    }
+
+    PhDestroyBinaryLog(log);
+}
+
+VOID Test_binlog(
+    VOID
+    )
+{
+    Test_sequential();
+    Test_reopen();
+    Test_concurrent();
+}
@@ -0,0 +1,138 @@
+#include "tests.h"
+#include <colsnap.h>
+#include "../../snapshot/phsnap.h"
+
+#define TEST_PROCESS_COUNT 200
+
+static VOID WriteTestSnapshot(
+    _In_ PPH_SNAPSHOT_WRITER Writer,
+    _In_ PPH_BYTES_BUILDER BytesBuilder,
+    _In_ ULONG Sample
+    )
+{
+    static PH_STRINGREF names[] = { PH_STRINGREF_INIT(L"svchost.exe"), PH_STRINGREF_INIT(L"explorer.exe"), PH_STRINGREF_INIT(L"\x00e9\xd83d\xde00.exe") };
+    static PH_STRINGREF emptyString = PH_STRINGREF_INIT(L"");
+    ULONG i;
+
+    for (i = 0; i < TEST_PROCESS_COUNT; i++)
+    {
+        PhBeginSnapshotRow(Writer, "process");
+        PhAddSnapshotInteger(Writer, "ProcessId", (i + 1) * 4);
+        PhAddSnapshotString(Writer, "Name", i == 0 ? NULL : (i == 1 ? &emptyString : &names[i % 3]));
+        PhAddSnapshotInteger(Writer, "CpuTime", i == 2 ? MINLONG64 : (i == 3 ? MAXLONG64 : (LONG64)Sample * 1000 - i));
+        PhEndSnapshotRow(Writer);
+    }
+
+    // The thread table only has rows in the first snapshot.
+    if (Sample == 0)
+    {
+        PhBeginSnapshotRow(Writer, "thread");
+        PhAddSnapshotInteger(Writer, "ThreadId", 8);
+        PhEndSnapshotRow(Writer);
+    }
+
+    PhWriteSnapshot(Writer, 132000000000000000 + Sample, BytesBuilder);
+}
+
+static VOID CheckTestSnapshot(
+    _In_ phsnap_snapshot *Snapshot,
+    _In_ ULONG Sample
+    )
+{
+    const phsnap_table *table;
+    const phsnap_column *nameColumn;
+    int result;
+    int64_t values[TEST_PROCESS_COUNT];
+    uint32_t indices[TEST_PROCESS_COUNT];
+    ULONG i;
+
+    assert(Snapshot->time == 132000000000000000 + Sample);
+    assert(Snapshot->table_count == (Sample == 0 ? 2 : 1));
+    table = phsnap_find_table(Snapshot, "process");
+    assert(table && table->row_count == TEST_PROCESS_COUNT && table->column_count == 3);
+    assert(phsnap_find_column(table, "CpuTime") == 2 && phsnap_find_column(table, "Missing") == -1);
+
+    result = phsnap_read_integers(table, 0, values);
+    assert(result == PHSNAP_OK);
+
+    for (i = 0; i < TEST_PROCESS_COUNT; i++)
+        assert(values[i] == (i + 1) * 4);
+
+    result = phsnap_read_integers(table, 2, values);
+    assert(result == PHSNAP_OK);
+    assert(values[2] == MINLONG64 && values[3] == MAXLONG64 && values[4] == (LONG64)Sample * 1000 - 4);
+    result = phsnap_read_integers(table, 1, values);
+    assert(result == PHSNAP_ERROR_TYPE);
+
+    // Each distinct string is stored once.
+    nameColumn = &table->columns[1];
+    result = phsnap_read_strings(table, 1, indices);
+    assert(result == PHSNAP_OK);
+    assert(nameColumn->dictionary_count == 4);
+    assert(indices[0] == 0 && indices[1] != 0 && nameColumn->dictionary[indices[1] - 1].length == 0);
+    assert(indices[3] == indices[6] && indices[4] != indices[3]);
+    assert(nameColumn->dictionary[indices[3] - 1].length == 11);
+    assert(memcmp(nameColumn->dictionary[indices[3] - 1].data, "svchost.exe", 11) == 0);
+    assert(nameColumn->dictionary[indices[5] - 1].length == 10);
+    assert(memcmp(nameColumn->dictionary[indices[5] - 1].data, "\xc3\xa9\xf0\x9f\x98\x80.exe", 10) == 0);
+
+    // Sorted IDs take one byte per row.
+    assert(table->columns[0].data_length == TEST_PROCESS_COUNT);
+}
+
+VOID Test_colsnap(
+    VOID
+    )
+{
+    PPH_SNAPSHOT_WRITER writer;
+    PH_BYTES_BUILDER bytesBuilder;
+    phsnap_file file;
+    phsnap_snapshot snapshot;
+    int result;
+    PVOID corrupt;
+    ULONG i;
+
+    writer = PhCreateSnapshotWriter();
+    PhInitializeBytesBuilder(&bytesBuilder, 0x1000);
+
+    for (i = 0; i < 3; i++)
+        WriteTestSnapshot(writer, &bytesBuilder, i);
+
+    phsnap_open_memory(&file, bytesBuilder.Bytes->Buffer, bytesBuilder.Bytes->Length);
+
+    for (i = 0; i < 3; i++)
+    {
+        result = phsnap_next(&file, &snapshot);
+        assert(result == PHSNAP_OK);
+        CheckTestSnapshot(&snapshot, i);
+        phsnap_free_snapshot(&snapshot);
+    }
+
+    result = phsnap_next(&file, &snapshot);
+    assert(result == PHSNAP_END);
+    phsnap_close(&file);
+
+    // Truncated files are rejected.
+    phsnap_open_memory(&file, bytesBuilder.Bytes->Buffer, bytesBuilder.Bytes->Length - 1);
+    result = phsnap_next(&file, &snapshot);
+    assert(result == PHSNAP_OK);
+    phsnap_free_snapshot(&snapshot);
+    result = phsnap_next(&file, &snapshot);
+    assert(result == PHSNAP_OK);
+    phsnap_free_snapshot(&snapshot);
+    result = phsnap_next(&file, &snapshot);
+    assert(result == PHSNAP_ERROR_FORMAT);
+    phsnap_close(&file);
+
+    // A row count that the column data can't hold is rejected before anything is allocated for it.
+    corrupt = PhAllocateCopy(bytesBuilder.Bytes->Buffer, bytesBuilder.Bytes->Length);
+    *(PULONG)PTR_ADD_OFFSET(corrupt, PHSNAP_SNAPSHOT_HEADER_SIZE + 16) = MAXULONG;
+    phsnap_open_memory(&file, corrupt, bytesBuilder.Bytes->Length);
+    result = phsnap_next(&file, &snapshot);
+    assert(result == PHSNAP_ERROR_FORMAT);
+    phsnap_close(&file);
+    PhFree(corrupt);
+
+    PhDeleteBytesBuilder(&bytesBuilder);
+    PhDestroySnapshotWriter(writer);
+}
@@ -0,0 +1,477 @@
+#include "tests.h"
+#include <graph.h>
+#include <math.h>
+
+static ULONG ReferenceColorToBits(
+    _In_ COLORREF Color
+    )
+{
+    return _byteswap_ulong(Color) >> 8;
+}
+
+// The per-pixel rasterizer which PhDrawGraphDirect replaced. It writes one pixel at a time and is
+// kept here as the reference for the output of the current implementation.
+
+static VOID ReferenceGetGraphPoint(
+    _In_ PPH_GRAPH_DRAW_INFO DrawInfo,
+    _In_ ULONG Index,
+    _Out_ PULONG H1,
+    _Out_ PULONG H2
+    )
+{
+    if (Index < DrawInfo->LineDataCount)
+    {
+        FLOAT f1;
+        FLOAT f2;
+
+        f1 = DrawInfo->LineData1[Index];
+
+        if (f1 < 0)
+            f1 = 0;
+        if (f1 > 1)
+            f1 = 1;
+
+        *H1 = (ULONG)(f1 * (DrawInfo->Height - 1));
+
+        if (DrawInfo->Flags & PH_GRAPH_USE_LINE_2)
+        {
+            f2 = f1 + DrawInfo->LineData2[Index];
+
+            if (f2 < 0)
+                f2 = 0;
+            if (f2 > 1)
+                f2 = 1;
+
+            *H2 = (ULONG)(f2 * (DrawInfo->Height - 1));
+        }
+        else
+        {
+            *H2 = *H1;
+        }
+    }
+    else
+    {
+        *H1 = 0;
+        *H2 = 0;
+    }
+}
+
+static VOID ReferenceDrawGraph(
+    _Out_ PVOID Bits,
+    _In_ PPH_GRAPH_DRAW_INFO DrawInfo
+    )
+{
+    PULONG bits = Bits;
+    LONG width = DrawInfo->Width;
+    LONG height = DrawInfo->Height;
+    LONG numberOfPixels = width * height;
+    ULONG flags = DrawInfo->Flags;
+    LONG i;
+    LONG x;
+
+    BOOLEAN intermediate = FALSE; // whether we are currently between two data positions
+    ULONG dataIndex = 0; // the data index of the current position
+    ULONG h1_i; // the line 1 height value to the left of the current position
+    ULONG h1_o; // the line 1 height value at the current position
+    ULONG h2_i; // the line 1 + line 2 height value to the left of the current position
+    ULONG h2_o; // the line 1 + line 2 height value at the current position
+    ULONG h1; // current pixel
+    ULONG h1_left; // current pixel
+    ULONG h2; // current pixel
+    ULONG h2_left; // current pixel
+
+    LONG mid;
+    LONG h1_low1;
+    LONG h1_high1;
+    LONG h1_low2;
+    LONG h1_high2;
+    LONG h2_low1;
+    LONG h2_high1;
+    LONG h2_low2;
+    LONG h2_high2;
+    LONG old_low2;
+    LONG old_high2;
+
+    ULONG lineColor1;
+    ULONG lineBackColor1;
+    ULONG lineColor2;
+    ULONG lineBackColor2;
+    FLOAT gridHeight;
+    LONG gridYThreshold;
+    ULONG gridYCounter;
+    ULONG gridColor;
+    FLOAT gridBase;
+    FLOAT gridLevel;
+
+    lineColor1 = ReferenceColorToBits(DrawInfo->LineColor1);
+    lineBackColor1 = ReferenceColorToBits(DrawInfo->LineBackColor1);
+    lineColor2 = ReferenceColorToBits(DrawInfo->LineColor2);
+    lineBackColor2 = ReferenceColorToBits(DrawInfo->LineBackColor2);
+
+    if (DrawInfo->BackColor == 0)
+    {
+        memset(bits, 0, (size_t)numberOfPixels * 4);
+    }
+    else
+    {
+        PhFillMemoryUlong(bits, ReferenceColorToBits(DrawInfo->BackColor), numberOfPixels);
+    }
+
+    x = width - 1;
+    h1_low2 = MAXLONG;
+    h1_high2 = 0;
+    h2_low2 = MAXLONG;
+    h2_high2 = 0;
+
+    ReferenceGetGraphPoint(DrawInfo, 0, &h1_i, &h2_i);
+
+    if (flags & (PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y))
+    {
+        gridHeight = max(DrawInfo->GridHeight, 0);
+        gridLevel = gridHeight;
+        gridYThreshold = DrawInfo->GridYThreshold;
+        gridYCounter = DrawInfo->GridWidth - (DrawInfo->GridXOffset * DrawInfo->Step) % DrawInfo->GridWidth - 1;
+        gridColor = ReferenceColorToBits(DrawInfo->GridColor);
+    }
+
+    if ((flags & (PH_GRAPH_USE_GRID_Y | PH_GRAPH_LOGARITHMIC_GRID_Y)) == (PH_GRAPH_USE_GRID_Y | PH_GRAPH_LOGARITHMIC_GRID_Y))
+    {
+        // Pre-process to find the largest integer n such that GridHeight*GridBase^n < 1.
+
+        gridBase = DrawInfo->GridBase;
+
+        if (gridBase > 1)
+        {
+            DOUBLE logBase;
+            DOUBLE exponent;
+            DOUBLE high;
+
+            logBase = log(gridBase);
+            exponent = ceil(-log(gridHeight) / logBase) - 1; // Works for both GridHeight > 1 and GridHeight < 1
+            high = exp(exponent * logBase);
+            gridLevel = (FLOAT)(gridHeight * high);
+
+            if (gridLevel < 0 || !isfinite(gridLevel))
+                gridLevel = 0;
+            if (gridLevel > 1)
+                gridLevel = 1;
+        }
+        else
+        {
+            // This is an error.
+            gridLevel = 0;
+        }
+    }
+
+    while (x >= 0)
+    {
+        // Calculate the height of the graph at this point.
+
+        if (!intermediate)
+        {
+            h1_o = h1_i;
+            h2_o = h2_i;
+
+            // Pull in new data.
+            dataIndex++;
+            ReferenceGetGraphPoint(DrawInfo, dataIndex, &h1_i, &h2_i);
+
+            h1 = h1_o;
+            h1_left = (h1_i + h1_o) / 2;
+            h2 = h2_o;
+            h2_left = (h2_i + h2_o) / 2;
+        }
+        else
+        {
+            h1 = h1_left;
+            h1_left = h1_i;
+            h2 = h2_left;
+            h2_left = h2_i;
+        }
+
+        // The graph is drawn right-to-left. There is one iteration of the loop per horizontal pixel.
+        // There is a fixed step value of 2, so every other iteration is a mid-point (intermediate)
+        // iteration with a height value of (left + right) / 2. In order to rasterize the outline,
+        // effectively in each iteration half of the line is drawn at the current column and the other
+        // half is drawn in the column to the left.
+
+        // Rasterize the data outline.
+        // h?_low2 to h?_high2 is the vertical line to the left of the current pixel.
+        // h?_low1 to h?_high1 is the vertical line at the current pixel.
+        // We merge (union) the old h?_low2 to h?_high2 line with the current line in each iteration.
+        //
+        // For example:
+        //
+        // X represents a data point. M represents the mid-point between two data points ("intermediate").
+        // X, M and x are all part of the outline. # represents the background filled in during
+        // the current loop iteration.
+        //
+        // slope > 0:                                     slope < 0:
+        //
+        //     X  < high1                                   X    < high2 (of next loop iteration)
+        //     x                                            x
+        //     x  < low1                                    x    < low2 (of next loop iteration)
+        //    x#  < high2                                    x   < high1 (of next loop iteration)
+        //    M#  < low2                                     M   < low1 (of next loop iteration)
+        //    x#  < high1 (of next loop iteration)           x   < high2
+        //    x#  < low1 (of next loop iteration)            x   < low2
+        //   x #  < high2 (of next loop iteration)            x  < high1
+        //   x #                                              x
+        //   X #  < low2 (of next loop iteration)             X  < low1
+        //     #                                              #
+        //     ^                                              ^
+        //    ^| current pixel                               ^| current pixel
+        //    |                                              |
+        //    | left of current pixel                        | left of current pixel
+        //
+        // In both examples above, the line low2-high2 will be merged with the line low1-high1 of
+        // the next iteration.
+
+        mid = ((h1_left + h1) / 2) * width;
+        old_low2 = h1_low2;
+        old_high2 = h1_high2;
+
+        if (h1_left < h1) // slope > 0
+        {
+            h1_low2 = h1_left * width;
+            h1_high2 = mid;
+            h1_low1 = mid + width;
+            h1_high1 = h1 * width;
+        }
+        else // slope < 0
+        {
+            h1_high2 = h1_left * width;
+            h1_low2 = mid + width;
+            h1_high1 = mid;
+            h1_low1 = h1 * width;
+        }
+
+        // Merge the lines.
+        if (h1_low1 > old_low2)
+            h1_low1 = old_low2;
+        if (h1_high1 < old_high2)
+            h1_high1 = old_high2;
+
+        // Fix up values for the current horizontal offset.
+        h1_low1 += x;
+        h1_high1 += x;
+
+        if (flags & PH_GRAPH_USE_LINE_2)
+        {
+            mid = ((h2_left + h2) / 2) * width;
+            old_low2 = h2_low2;
+            old_high2 = h2_high2;
+
+            if (h2_left < h2) // slope > 0
+            {
+                h2_low2 = h2_left * width;
+                h2_high2 = mid;
+                h2_low1 = mid + width;
+                h2_high1 = h2 * width;
+            }
+            else // slope < 0
+            {
+                h2_high2 = h2_left * width;
+                h2_low2 = mid + width;
+                h2_high1 = mid;
+                h2_low1 = h2 * width;
+            }
+
+            // Merge the lines.
+            if (h2_low1 > old_low2)
+                h2_low1 = old_low2;
+            if (h2_high1 < old_high2)
+                h2_high1 = old_high2;
+
+            // Fix up values for the current horizontal offset.
+            h2_low1 += x;
+            h2_high1 += x;
+        }
+
+        // Fill in the background.
+
+        if (flags & PH_GRAPH_USE_LINE_2)
+        {
+            for (i = h1_high1 + width; i < h2_low1; i += width)
+            {
+                bits[i] = lineBackColor2;
+            }
+        }
+
+        for (i = x; i < h1_low1; i += width)
+        {
+            bits[i] = lineBackColor1;
+        }
+
+        // Draw the grid.
+
+        if (flags & PH_GRAPH_USE_GRID_X)
+        {
+            // Draw the vertical grid line.
+            if (gridYCounter == 0)
+            {
+                for (i = x; i < numberOfPixels; i += width)
+                {
+                    bits[i] = gridColor;
+                }
+            }
+
+            gridYCounter++;
+
+            if (gridYCounter == DrawInfo->GridWidth)
+                gridYCounter = 0;
+        }
+
+        if (flags & PH_GRAPH_USE_GRID_Y)
+        {
+            FLOAT level;
+            LONG h;
+            LONG h_last;
+
+            // Draw the horizontal grid line.
+            if (flags & PH_GRAPH_LOGARITHMIC_GRID_Y)
+            {
+                level = gridLevel;
+                h = (LONG)(level * (height - 1));
+                h_last = height + gridYThreshold - 1;
+
+                while (TRUE)
+                {
+                    if (h <= h_last - gridYThreshold)
+                    {
+                        bits[x + h * width] = gridColor;
+                        h_last = h;
+                    }
+                    else
+                    {
+                        break;
+                    }
+
+                    level /= gridBase;
+                    h = (LONG)(level * (height - 1));
+                }
+            }
+            else
+            {
+                level = gridHeight;
+                h = (LONG)(level * (height - 1));
+                h_last = 0;
+
+                while (h < height - 1)
+                {
+                    if (h >= h_last + gridYThreshold)
+                    {
+                        bits[x + h * width] = gridColor;
+                        h_last = h;
+                    }
+
+                    level += gridHeight;
+                    h = (LONG)(level * (height - 1));
+                }
+            }
+        }
+
+        // Draw the outline (line 1 is allowed to paint over line 2).
+
+        if (flags & PH_GRAPH_USE_LINE_2)
+        {
+            for (i = h2_low1; i <= h2_high1; i += width) // exclude pixel in the middle
+            {
+                bits[i] = lineColor2;
+            }
+        }
+
+        for (i = h1_low1; i <= h1_high1; i += width)
+        {
+            bits[i] = lineColor1;
+        }
+
+        intermediate = !intermediate;
+        x--;
+    }
+}
+
+static ULONG RandomNumber(
+    _Inout_ PULONG Seed
+    )
+{
+    *Seed = *Seed * 1103515245 + 12345;
+    return *Seed >> 8;
+}
+
+static FLOAT RandomValue(
+    _Inout_ PULONG Seed
+    )
+{
+    // Include values outside of [0, 1] and exact zeros, which are clamped by the rasterizer.
+    switch (RandomNumber(Seed) % 10)
+    {
+    case 0:
+        return -0.2f;
+    case 1:
+        return 1.3f;
+    case 2:
+        return 0;
+    default:
+        return (RandomNumber(Seed) % 10000) / 10000.0f;
+    }
+}
+
+VOID Test_graph(
+    VOID
+    )
+{
+    static FLOAT lineData1[512];
+    static FLOAT lineData2[512];
+    ULONG seed = 1;
+    ULONG iteration;
+
+    for (iteration = 0; iteration < 20000; iteration++)
+    {
+        PH_GRAPH_DRAW_INFO drawInfo;
+        PULONG expected;
+        PULONG bits;
+        SIZE_T size;
+        ULONG i;
+
+        memset(&drawInfo, 0, sizeof(PH_GRAPH_DRAW_INFO));
+        drawInfo.Width = 1 + RandomNumber(&seed) % (iteration % 10 == 0 ? 300 : 70);
+        drawInfo.Height = 1 + RandomNumber(&seed) % (iteration % 10 == 0 ? 200 : 60);
+        drawInfo.Step = 2;
+        drawInfo.Flags = RandomNumber(&seed) & (PH_GRAPH_USE_GRID_X | PH_GRAPH_USE_GRID_Y | PH_GRAPH_LOGARITHMIC_GRID_Y | PH_GRAPH_USE_LINE_2);
+        drawInfo.BackColor = RandomNumber(&seed) % 4 == 0 ? 0 : RandomNumber(&seed);
+        drawInfo.LineColor1 = RandomNumber(&seed);
+        drawInfo.LineColor2 = RandomNumber(&seed);
+        drawInfo.LineBackColor1 = RandomNumber(&seed);
+        drawInfo.LineBackColor2 = RandomNumber(&seed);
+        drawInfo.GridColor = RandomNumber(&seed);
+        drawInfo.GridWidth = 1 + RandomNumber(&seed) % 30;
+        drawInfo.GridHeight = 0.05f + (RandomNumber(&seed) % 100) / 100.0f;
+        drawInfo.GridXOffset = RandomNumber(&seed) % 50;
+        drawInfo.GridYThreshold = 1 + RandomNumber(&seed) % 10;
+        drawInfo.GridBase = RandomNumber(&seed) % 5 == 0 ? 1.0f : 1.5f + (RandomNumber(&seed) % 30) / 10.0f;
+        drawInfo.LineDataCount = RandomNumber(&seed) % (drawInfo.Width / 2 + 5);
+
+        for (i = 0; i < drawInfo.LineDataCount; i++)
+        {
+            lineData1[i] = RandomValue(&seed);
+            lineData2[i] = RandomValue(&seed);
+        }
+
+        drawInfo.LineData1 = lineData1;
+        drawInfo.LineData2 = lineData2;
+
+        size = (SIZE_T)drawInfo.Width * drawInfo.Height * sizeof(ULONG);
+        expected = PhAllocate(size);
+        bits = PhAllocate(size);
+        memset(expected, 0xcd, size);
+        memset(bits, 0xab, size);
+
+        ReferenceDrawGraph(expected, &drawInfo);
+        PhDrawGraphDirect(NULL, bits, &drawInfo);
+        assert(memcmp(bits, expected, size) == 0);
+
+        PhFree(bits);
+        PhFree(expected);
+    }
+}
@@ -0,0 +1,213 @@
+#include "tests.h"
+
+static PPH_STRING HashBuffer(
+    _In_ PH_HASH_ALGORITHM Algorithm,
+    _In_reads_bytes_(Length) PUCHAR Buffer,
+    _In_ ULONG Length,
+    _In_ ULONG ChunkSize
+    )
+{
+    PH_HASH_CONTEXT context;
+    UCHAR hash[32];
+    ULONG returnLength;
+    ULONG offset;
+
+    PhInitializeHash(&context, Algorithm);
+
+    for (offset = 0; offset < Length; offset += ChunkSize)
+        PhUpdateHash(&context, Buffer + offset, min(ChunkSize, Length - offset));
+
+    PhFinalHash(&context, hash, sizeof(hash), &returnLength);
+
+    return PhBufferToHexString(hash, returnLength);
+}
+
+static ULONG ReferenceCrc32(
+    _In_reads_bytes_(Length) PUCHAR Buffer,
+    _In_ ULONG Length
+    )
+{
+    ULONG crc = 0xffffffff;
+    ULONG i;
+
+    while (Length--)
+    {
+        crc ^= *Buffer++;
+
+        for (i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+
+    return crc ^ 0xffffffff;
+}
+
+static PUCHAR CreateTestBuffer(
+    _In_ ULONG Length
+    )
+{
+    PUCHAR buffer;
+    ULONG seed = 0x12345678;
+    ULONG i;
+
+    buffer = PhAllocate(Length);
+
+    for (i = 0; i < Length; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        buffer[i] = (UCHAR)(seed >> 16);
+    }
+
+    return buffer;
+}
+
+static VOID Test_knownanswers(
+    VOID
+    )
+{
+    static struct
+    {
+        PH_HASH_ALGORITHM Algorithm;
+        PSTR Input;
+        PWSTR Hash;
+    } testCases[] =
+    {
+        { Md5HashAlgorithm, "", L"d41d8cd98f00b204e9800998ecf8427e" },
+        { Md5HashAlgorithm, "abc", L"900150983cd24fb0d6963f7d28e17f72" },
+        { Sha1HashAlgorithm, "", L"da39a3ee5e6b4b0d3255bfef95601890afd80709" },
+        { Sha1HashAlgorithm, "abc", L"a9993e364706816aba3e25717850c26c9cd0d89d" },
+        { Sha1HashAlgorithm, "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", L"84983e441c3bd26ebaae4aa1f95129e5e54670f1" },
+        { Sha256HashAlgorithm, "", L"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { Sha256HashAlgorithm, "abc", L"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { Sha256HashAlgorithm, "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", L"248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+        { Crc32HashAlgorithm, "123456789", L"2639f4cb" } // 0xcbf43926, little endian
+    };
+    ULONG i;
+    PUCHAR buffer;
+    PPH_STRING hash;
+
+    for (i = 0; i < RTL_NUMBER_OF(testCases); i++)
+    {
+        hash = HashBuffer(testCases[i].Algorithm, (PUCHAR)testCases[i].Input, (ULONG)strlen(testCases[i].Input), 1024);
+        assert(PhEqualStringZ(hash->Buffer, testCases[i].Hash, TRUE));
+        PhDereferenceObject(hash);
+    }
+
+    // One million repetitions of 'a', hashed in blocks of 1000 bytes.
+
+    buffer = PhAllocate(1000000);
+    memset(buffer, 'a', 1000000);
+
+    hash = HashBuffer(Sha1HashAlgorithm, buffer, 1000000, 1000);
+    assert(PhEqualStringZ(hash->Buffer, L"34aa973cd4c4daa4f61eeb2bdbad27316534016f", TRUE));
+    PhDereferenceObject(hash);
+
+    hash = HashBuffer(Sha256HashAlgorithm, buffer, 1000000, 1000);
+    assert(PhEqualStringZ(hash->Buffer, L"cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0", TRUE));
+    PhDereferenceObject(hash);
+
+    PhFree(buffer);
+}
+
+static VOID Test_chunking(
+    VOID
+    )
+{
+    static PH_HASH_ALGORITHM algorithms[] = { Md5HashAlgorithm, Sha1HashAlgorithm, Crc32HashAlgorithm, Sha256HashAlgorithm };
+    static ULONG chunkSizes[] = { 1, 3, 15, 16, 63, 64, 65, 127, 1000, 4096 };
+    static ULONG lengths[] = { 0, 1, 55, 56, 63, 64, 65, 100, 1000, 10007 };
+    PUCHAR buffer;
+    ULONG i;
+    ULONG j;
+    ULONG k;
+    ULONG offset;
+
+    buffer = CreateTestBuffer(10007 + 3);
+
+    // The block-at-a-time paths (accelerated or not) must agree with the buffered path for every
+    // split of the input, including unaligned starting addresses.
+
+    for (i = 0; i < RTL_NUMBER_OF(algorithms); i++)
+    {
+        for (j = 0; j < RTL_NUMBER_OF(lengths); j++)
+        {
+            for (offset = 0; offset < 4; offset++)
+            {
+                PPH_STRING expected;
+
+                expected = HashBuffer(algorithms[i], buffer + offset, lengths[j], 1);
+
+                for (k = 0; k < RTL_NUMBER_OF(chunkSizes); k++)
+                {
+                    PPH_STRING hash;
+
+                    hash = HashBuffer(algorithms[i], buffer + offset, lengths[j], chunkSizes[k]);
+                    assert(PhEqualString(hash, expected, TRUE));
+                    PhDereferenceObject(hash);
+                }
+
+                PhDereferenceObject(expected);
+            }
+        }
+    }
+
+    for (j = 0; j < RTL_NUMBER_OF(lengths); j++)
+    {
+        for (offset = 0; offset < 4; offset++)
+        {
+            assert(PhCrc32(0, (PCHAR)buffer + offset, lengths[j]) == ReferenceCrc32(buffer + offset, lengths[j]));
+        }
+    }
+
+    PhFree(buffer);
+}
+
+static VOID Test_throughput(
+    VOID
+    )
+{
+    static struct
+    {
+        PH_HASH_ALGORITHM Algorithm;
+        PWSTR Name;
+    } algorithms[] =
+    {
+        { Md5HashAlgorithm, L"MD5" },
+        { Sha1HashAlgorithm, L"SHA-1" },
+        { Crc32HashAlgorithm, L"CRC-32" },
+        { Sha256HashAlgorithm, L"SHA-256" }
+    };
+    static ULONG bufferSize = 16 * 1024 * 1024;
+    PUCHAR buffer;
+    LARGE_INTEGER frequency;
+    ULONG i;
+
+    buffer = CreateTestBuffer(bufferSize);
+
+    for (i = 0; i < RTL_NUMBER_OF(algorithms); i++)
+    {
+        LARGE_INTEGER startCounter;
+        LARGE_INTEGER endCounter;
+        PPH_STRING hash;
+        DOUBLE seconds;
+
+        NtQueryPerformanceCounter(&startCounter, &frequency);
+        hash = HashBuffer(algorithms[i].Algorithm, buffer, bufferSize, PAGE_SIZE * 16);
+        NtQueryPerformanceCounter(&endCounter, NULL);
+
+        seconds = (DOUBLE)(endCounter.QuadPart - startCounter.QuadPart) / frequency.QuadPart;
+
+        wprintf(L"%-8s %8.1f MB/s\n", algorithms[i].Name, seconds > 0 ? bufferSize / (1024.0 * 1024.0) / seconds : 0.0);
+        PhDereferenceObject(hash);
+    }
+
+    PhFree(buffer);
+}
+
+VOID Test_hash(
+    VOID
+    )
+{
+    Test_knownanswers();
+    Test_chunking();
+    Test_throughput();
+}
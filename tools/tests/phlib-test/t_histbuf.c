@@ -0,0 +1,86 @@
+#include "tests.h"
+#include <histbuf.h>
+#include <math.h>
+
+static VOID Test_aggregates(
+    _In_ ULONG Size,
+    _In_ ULONG Factor,
+    _In_ ULONG NumberOfLevels,
+    _In_ ULONG NumberOfSamples
+    )
+{
+    PH_HISTORY_BUFFER buffer;
+    PFLOAT samples;
+    PFLOAT items;
+    ULONG seed = 0x12345678;
+    ULONG level;
+    ULONG i;
+    ULONG j;
+
+    PhInitializeHistoryBuffer(&buffer, Size, Factor, NumberOfLevels);
+    samples = PhAllocate(sizeof(FLOAT) * NumberOfSamples);
+    items = PhAllocate(sizeof(FLOAT) * PhRoundUpToPowerOfTwo(Size));
+
+    for (i = 0; i < NumberOfSamples; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        samples[i] = (FLOAT)((seed >> 16) % 65) / 64;
+        PhAddItemHistoryBuffer(&buffer, samples[i]);
+    }
+
+    for (level = 0; level < NumberOfLevels; level++)
+    {
+        PPH_HISTORY_LEVEL historyLevel = &buffer.Levels[level];
+        ULONG scale = historyLevel->Scale;
+        ULONG count = min(NumberOfSamples / scale, PhRoundUpToPowerOfTwo(Size));
+
+        assert(historyLevel->Average.Count == count);
+        assert(PhGetSampleIndexHistoryBuffer(&buffer, level, 0) == NumberOfSamples % scale);
+
+        PhCopyHistoryBuffer(&buffer, level, AverageHistoryAggregate, items, count);
+
+        for (i = 0; i < count; i++)
+        {
+            ULONG newest = NumberOfSamples - 1 - PhGetSampleIndexHistoryBuffer(&buffer, level, i);
+            DOUBLE sum = 0;
+            FLOAT minimum = samples[newest];
+            FLOAT maximum = samples[newest];
+
+            for (j = 0; j < scale; j++)
+            {
+                FLOAT value = samples[newest - j];
+
+                sum += value;
+                minimum = min(minimum, value);
+                maximum = max(maximum, value);
+            }
+
+            assert(fabs(items[i] - sum / scale) < 1e-5);
+            assert(PhGetItemHistoryBuffer(&buffer, level, MinimumHistoryAggregate, i) == minimum);
+            assert(PhGetItemHistoryBuffer(&buffer, level, MaximumHistoryAggregate, i) == maximum);
+        }
+    }
+
+    PhClearHistoryBuffer(&buffer);
+
+    for (level = 0; level < NumberOfLevels; level++)
+    {
+        assert(buffer.Levels[level].Average.Count == 0);
+        assert(PhGetSampleIndexHistoryBuffer(&buffer, level, 0) == 0);
+    }
+
+    PhFree(items);
+    PhFree(samples);
+    PhDeleteHistoryBuffer(&buffer);
+}
+
+VOID Test_histbuf(
+    VOID
+    )
+{
+    Test_aggregates(16, 2, 3, 0);
+    Test_aggregates(16, 2, 3, 7);
+    Test_aggregates(16, 4, 4, 1000);
+    Test_aggregates(512, 4, 4, 100000);
+    Test_aggregates(100, 3, 5, 5000); // size is not a power of two
+}
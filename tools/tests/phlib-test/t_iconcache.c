@@ -0,0 +1,86 @@
+#include "tests.h"
+#include <guisup.h>
+
+#define TEST_ICON_COUNT 200
+
+static PPH_STRING GetSystemFileName(
+    _In_ PWSTR BaseName
+    )
+{
+    PPH_STRING systemDirectory;
+    PPH_STRING fileName;
+
+    systemDirectory = PhGetSystemDirectory();
+    assert(systemDirectory);
+    fileName = PhConcatStrings(3, systemDirectory->Buffer, L"\\", BaseName);
+    PhDereferenceObject(systemDirectory);
+
+    return fileName;
+}
+
+VOID Test_iconcache(
+    VOID
+    )
+{
+    PPH_STRING user32FileName;
+    PPH_STRING shell32FileName;
+    PPH_FILE_ICON icon1;
+    PPH_FILE_ICON icon2;
+    INT index1;
+    INT index2;
+    ULONG i;
+
+    user32FileName = GetSystemFileName(L"user32.dll");
+    shell32FileName = GetSystemFileName(L"shell32.dll");
+
+    // The same file and icon index share one entry, even if the path is different.
+    icon1 = PhGetFileIcon(user32FileName->Buffer, 0);
+    assert(icon1->SmallIcon && icon1->LargeIcon);
+    PhUpperString(user32FileName);
+    icon2 = PhGetFileIcon(user32FileName->Buffer, 0);
+    assert(icon2 == icon1);
+    icon2 = PhReferenceFileIcon(icon1);
+    assert(icon2 == icon1);
+
+    index1 = PhGetFileIconImageListIndex(icon1);
+    assert(index1 > 0);
+    index2 = PhGetFileIconImageListIndex(icon2);
+    assert(index2 == index1);
+
+    icon2 = PhGetFileIcon(shell32FileName->Buffer, 0);
+    assert(icon2 != icon1);
+    index2 = PhGetFileIconImageListIndex(icon2);
+    assert(index2 != index1);
+    PhDereferenceFileIcon(icon2);
+
+    PhDereferenceFileIcon(icon1);
+    PhDereferenceFileIcon(icon1);
+    PhDereferenceFileIcon(icon1);
+
+    // Unused entries are kept until they are evicted.
+    icon2 = PhGetFileIcon(user32FileName->Buffer, 0);
+    assert(icon2 == icon1);
+    index2 = PhGetFileIconImageListIndex(icon2);
+    assert(index2 == index1);
+    PhDereferenceFileIcon(icon2);
+
+    // Files that cannot be opened are not cached, and use the stock application icon.
+    icon1 = PhGetFileIcon(L"C:\\this file does not exist.exe", 0);
+    assert(!icon1->SmallIcon && !icon1->LargeIcon);
+    index2 = PhGetFileIconImageListIndex(icon1);
+    assert(index2 == 0);
+    PhDereferenceFileIcon(icon1);
+
+    // The image list slots of evicted entries are reused.
+    for (i = 0; i < TEST_ICON_COUNT; i++)
+    {
+        icon1 = PhGetFileIcon(shell32FileName->Buffer, i);
+        PhGetFileIconImageListIndex(icon1);
+        PhDereferenceFileIcon(icon1);
+    }
+
+    assert(ImageList_GetImageCount(PhGetFileIconImageList()) < TEST_ICON_COUNT);
+
+    PhDereferenceObject(shell32FileName);
+    PhDereferenceObject(user32FileName);
+}
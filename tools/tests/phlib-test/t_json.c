@@ -0,0 +1,352 @@
+#include "tests.h"
+#include <json.h>
+
+#define BENCHMARK_RESULT_COUNT 20000
+
+static PPH_BYTES WriteTestDocument(
+    _In_ ULONG NumberOfResults
+    )
+{
+    static PH_STRINGREF permalink = PH_STRINGREF_INIT(L"https://www.virustotal.com/file/report/\x00e9\xd83d\xde00");
+    PH_JSON_WRITER writer;
+    ULONG i;
+    ULONG j;
+
+    PhInitializeJsonWriter(&writer, 0x1000);
+    PhWriteJsonBeginObject(&writer, NULL);
+    PhWriteJsonStringZ(&writer, "verbose_msg", "Scan finished, \"scan\" results\r\n\tbelow");
+    PhWriteJsonBeginArray(&writer, "data");
+
+    for (i = 0; i < NumberOfResults; i++)
+    {
+        PhWriteJsonBeginObject(&writer, NULL);
+        PhWriteJsonStringZ(&writer, "hash", "275a021bbfb6489e54d471899f7db9d1663fc695ec2fe2a2c4538aabf651fd0f");
+        PhWriteJsonBoolean(&writer, "found", i % 3 != 0);
+        PhWriteJsonInteger64(&writer, "positives", i % 70);
+        PhWriteJsonInteger64(&writer, "total", 70);
+        PhWriteJsonString(&writer, "permalink", &permalink);
+        PhWriteJsonBeginObject(&writer, "scans");
+
+        for (j = 0; j < 8; j++)
+        {
+            CHAR name[2] = { (CHAR)('a' + j), ANSI_NULL };
+
+            PhWriteJsonBeginObject(&writer, name);
+            PhWriteJsonBoolean(&writer, "detected", j < 2);
+            PhWriteJsonStringZ(&writer, "result", j < 2 ? "Trojan.Generic" : "");
+            PhWriteJsonNull(&writer, "update");
+            PhWriteJsonEndObject(&writer);
+        }
+
+        PhWriteJsonEndObject(&writer);
+        PhWriteJsonEndObject(&writer);
+    }
+
+    PhWriteJsonEndArray(&writer);
+    PhWriteJsonInteger64(&writer, "result", 1);
+    PhWriteJsonEndObject(&writer);
+
+    return PhFinalJsonWriterBytes(&writer);
+}
+
+static NTSTATUS ReadAllTokens(
+    _In_ PSTR Document,
+    _Out_opt_ PULONG NumberOfTokens
+    )
+{
+    PH_JSON_READER reader;
+    ULONG numberOfTokens = 0;
+
+    PhInitializeJsonReader(&reader, Document, strlen(Document));
+
+    while (PhReadJsonToken(&reader))
+        numberOfTokens++;
+
+    if (NumberOfTokens)
+        *NumberOfTokens = numberOfTokens;
+
+    return reader.Status;
+}
+
+static VOID Test_reader(
+    VOID
+    )
+{
+    static PSTR document =
+        "\xef\xbb\xbf { \"a\": 1, \"b\": [true, false, null, \"x\\\"y\"],"
+        " \"c\": {\"d\": -1.5e3, \"e\": \"\\u00e9\\ud83d\\ude00\\n\"}, \"f\": [{\"g\": 1}, {\"g\": 2, \"h\": [1, 2]}]} ";
+    static PSTR invalidDocuments[] =
+    {
+        "", "{", "[1,]", "[1 2]", "{\"a\":1}x", "{\"a\" 1}", "[\"a\x01\"]", "[01]", "[1.]", "[tru]",
+        "[\"\\x\"]", "[1}", "{\"a\":1]", "[\"\\u12\"]"
+    };
+    NTSTATUS status;
+    BOOLEAN result;
+    PH_JSON_READER reader;
+    PPH_STRING string;
+    ULONG numberOfTokens;
+    ULONG i;
+
+    status = ReadAllTokens(document, &numberOfTokens);
+    assert(NT_SUCCESS(status));
+    assert(numberOfTokens == 25);
+    status = ReadAllTokens(" 42 ", &numberOfTokens);
+    assert(NT_SUCCESS(status) && numberOfTokens == 1);
+
+    for (i = 0; i < RTL_NUMBER_OF(invalidDocuments); i++)
+    {
+        status = ReadAllTokens(invalidDocuments[i], NULL);
+        assert(status == STATUS_FILE_CORRUPT_ERROR);
+    }
+
+    PhInitializeJsonReader(&reader, document, strlen(document));
+    result = PhReadJsonToken(&reader);
+    assert(result && reader.Value.Type == PH_JSON_TOKEN_BEGIN_OBJECT && reader.Depth == 0);
+    result = PhReadJsonToken(&reader);
+    assert(result && PhEqualJsonKey(&reader, "a") && reader.Depth == 1 && reader.Index == 0);
+    assert(PhJsonValueToInteger64(&reader.Value) == 1);
+
+    // Skipping an array moves the reader to its end.
+    result = PhReadJsonToken(&reader);
+    assert(result && PhEqualJsonKey(&reader, "b") && reader.Index == 1);
+    result = PhSkipJsonValue(&reader);
+    assert(result && reader.Value.Type == PH_JSON_TOKEN_END_ARRAY && reader.Depth == 1);
+
+    result = PhReadJsonToken(&reader);
+    assert(result && PhEqualJsonKey(&reader, "c"));
+    result = PhReadJsonToken(&reader);
+    assert(result && PhEqualJsonKey(&reader, "d") && reader.Depth == 2);
+    assert(PhJsonValueToInteger64(&reader.Value) == -1500);
+
+    // Escape sequences, including a surrogate pair.
+    result = PhReadJsonToken(&reader);
+    assert(result && PhEqualJsonKey(&reader, "e") && reader.Value.Escaped);
+    string = PhJsonValueToString(&reader.Value);
+    assert(string->Length == 4 * sizeof(WCHAR));
+    assert(string->Buffer[0] == 0xe9 && string->Buffer[1] == 0xd83d && string->Buffer[2] == 0xde00 && string->Buffer[3] == L'\n');
+    PhDereferenceObject(string);
+
+    result = PhReadJsonToken(&reader);
+    assert(result && reader.Value.Type == PH_JSON_TOKEN_END_OBJECT && reader.Depth == 1);
+}
+
+static VOID Test_query(
+    VOID
+    )
+{
+    static PSTR document = "{\"a\": 1, \"b\": [true, \"x\\\"y\"], \"c\": {\"d\": {}, \"e\": [1]}, \"f\": [{\"g\": 1}, {\"g\": 2, \"h\": [1, 2]}]}";
+    NTSTATUS status;
+    PH_JSON_QUERY queries[] =
+    {
+        { "a" },
+        { "b.1" },
+        { "c" },
+        { "f.1.h.1" },
+        { "f.1.g" },
+        { "missing" },
+        { "b.9" },
+        { "" }
+    };
+    PPH_STRING string;
+
+    status = PhQueryJson(document, strlen(document), queries, RTL_NUMBER_OF(queries));
+    assert(NT_SUCCESS(status));
+
+    assert(queries[0].Value.Type == PH_JSON_TOKEN_NUMBER && PhJsonValueToInteger64(&queries[0].Value) == 1);
+    string = PhJsonValueToString(&queries[1].Value);
+    assert(PhEqualString2(string, L"x\"y", FALSE));
+    PhDereferenceObject(string);
+
+    // Objects and arrays are returned as a whole.
+    assert(queries[2].Value.Type == PH_JSON_TOKEN_BEGIN_OBJECT);
+    assert(queries[2].Value.Text.Length == strlen("{\"d\": {}, \"e\": [1]}"));
+    assert(memcmp(queries[2].Value.Text.Buffer, "{\"d\": {}, \"e\": [1]}", queries[2].Value.Text.Length) == 0);
+    assert(queries[7].Value.Type == PH_JSON_TOKEN_BEGIN_OBJECT && queries[7].Value.Text.Length == strlen(document));
+
+    assert(PhJsonValueToInteger64(&queries[3].Value) == 2);
+    assert(PhJsonValueToInteger64(&queries[4].Value) == 2);
+    assert(queries[5].Value.Type == PH_JSON_TOKEN_NONE && !PhJsonValueToString(&queries[5].Value));
+    assert(queries[6].Value.Type == PH_JSON_TOKEN_NONE);
+
+    queries[0].Path = "a";
+    status = PhQueryJson("{\"a\": [1,}", 10, queries, 2);
+    assert(status == STATUS_FILE_CORRUPT_ERROR);
+}
+
+static VOID Test_writer(
+    VOID
+    )
+{
+    static WCHAR text[] = { L'a', L'"', L'\\', L'\n', 0xe9, 0xd83d, 0xde00, 0xd800, L'z', 1 };
+    PH_STRINGREF textSr = { sizeof(text), text };
+    NTSTATUS status;
+    PH_JSON_WRITER writer;
+    PPH_BYTES document;
+    PVOID object;
+    PPH_STRING string;
+    PH_JSON_QUERY queries[] =
+    {
+        { "text" },
+        { "minimum" },
+        { "maximum" },
+        { "list.0" },
+        { "list.1" },
+        { "list.2" },
+        { "empty" }
+    };
+
+    PhInitializeJsonWriter(&writer, 0);
+
+    // Anything written before a reset is discarded.
+    PhWriteJsonBeginArray(&writer, NULL);
+    PhWriteJsonStringZ(&writer, NULL, "discarded");
+    PhResetJsonWriter(&writer);
+
+    PhWriteJsonBeginObject(&writer, NULL);
+    PhWriteJsonString(&writer, "text", &textSr);
+    PhWriteJsonInteger64(&writer, "minimum", MINLONG64);
+    PhWriteJsonInteger64(&writer, "maximum", MAXLONG64);
+    PhWriteJsonBeginArray(&writer, "list");
+    PhWriteJsonBoolean(&writer, NULL, TRUE);
+    PhWriteJsonNull(&writer, NULL);
+    PhWriteJsonStringZ(&writer, NULL, "tab\t");
+    PhWriteJsonEndArray(&writer);
+    PhWriteJsonBeginObject(&writer, "empty");
+    PhWriteJsonEndObject(&writer);
+    PhWriteJsonEndObject(&writer);
+    document = PhFinalJsonWriterBytes(&writer);
+    assert(document->Buffer[0] == '{');
+
+    status = PhQueryJson(document->Buffer, document->Length, queries, RTL_NUMBER_OF(queries));
+    assert(NT_SUCCESS(status));
+
+    // The lone surrogate is replaced.
+    string = PhJsonValueToString(&queries[0].Value);
+    assert(string->Length == sizeof(text));
+    assert(memcmp(string->Buffer, text, 7 * sizeof(WCHAR)) == 0 && string->Buffer[7] == 0xfffd);
+    assert(string->Buffer[8] == L'z' && string->Buffer[9] == 1);
+    PhDereferenceObject(string);
+
+    assert(PhJsonValueToInteger64(&queries[1].Value) == MINLONG64);
+    assert(PhJsonValueToInteger64(&queries[2].Value) == MAXLONG64);
+    assert(queries[3].Value.Type == PH_JSON_TOKEN_BOOLEAN && PhJsonValueToBoolean(&queries[3].Value));
+    assert(queries[4].Value.Type == PH_JSON_TOKEN_NULL);
+    string = PhJsonValueToString(&queries[5].Value);
+    assert(PhEqualString2(string, L"tab\t", FALSE));
+    PhDereferenceObject(string);
+    assert(queries[6].Value.Text.Length == 2);
+
+    // The output must also be accepted by json-c.
+    object = PhCreateJsonParser(document->Buffer);
+    assert(object);
+    assert(PhGetJsonValueAsLong64(object, "maximum") == MAXLONG64);
+    PhFreeJsonParser(object);
+
+    PhDereferenceObject(document);
+}
+
+static LONG64 SumPositivesDom(
+    _In_ PPH_BYTES Document
+    )
+{
+    PVOID rootObject;
+    PVOID dataObject;
+    LONG64 sum = 0;
+    INT length;
+    INT i;
+
+    rootObject = PhCreateJsonParser(Document->Buffer);
+    assert(rootObject);
+    dataObject = PhGetJsonObject(rootObject, "data");
+    assert(dataObject);
+    length = PhGetJsonArrayLength(dataObject);
+
+    for (i = 0; i < length; i++)
+        sum += PhGetJsonValueAsLong64(PhGetJsonArrayIndexObject(dataObject, i), "positives");
+
+    PhFreeJsonParser(rootObject);
+
+    return sum;
+}
+
+static LONG64 SumPositivesReader(
+    _In_ PPH_BYTES Document
+    )
+{
+    PH_JSON_READER reader;
+    LONG64 sum = 0;
+
+    PhInitializeJsonReader(&reader, Document->Buffer, Document->Length);
+
+    while (PhReadJsonToken(&reader))
+    {
+        if (reader.Depth == 3 && PhEqualJsonKey(&reader, "positives"))
+            sum += PhJsonValueToInteger64(&reader.Value);
+        else if (reader.Depth == 3)
+            PhSkipJsonValue(&reader);
+    }
+
+    assert(NT_SUCCESS(reader.Status));
+
+    return sum;
+}
+
+static VOID Test_benchmark(
+    VOID
+    )
+{
+    NTSTATUS status;
+    PPH_BYTES document;
+    LARGE_INTEGER startCounter;
+    LONG64 expectedSum = 0;
+    LONG64 sum;
+    PH_JSON_QUERY queries[] =
+    {
+        { "result" },
+        { "data.20000" }, // one past the last result
+        { "data.0.scans.b.result" }
+    };
+    ULONG i;
+
+    document = WriteTestDocument(BENCHMARK_RESULT_COUNT);
+
+    for (i = 0; i < BENCHMARK_RESULT_COUNT; i++)
+        expectedSum += i % 70;
+
+    wprintf(L"json document: %lu kB\n", (ULONG)(document->Length / 1024));
+
+    NtQueryPerformanceCounter(&startCounter, NULL);
+    sum = SumPositivesDom(document);
+    wprintf(L"%-26s %8.2f ms\n", L"json-c parse", GetElapsedMilliseconds(&startCounter));
+    assert(sum == expectedSum);
+
+    NtQueryPerformanceCounter(&startCounter, NULL);
+    sum = SumPositivesReader(document);
+    wprintf(L"%-26s %8.2f ms\n", L"streaming reader", GetElapsedMilliseconds(&startCounter));
+    assert(sum == expectedSum);
+
+    NtQueryPerformanceCounter(&startCounter, NULL);
+    status = ReadAllTokens(document->Buffer, NULL);
+    assert(NT_SUCCESS(status));
+    wprintf(L"%-26s %8.2f ms\n", L"streaming reader (all)", GetElapsedMilliseconds(&startCounter));
+
+    NtQueryPerformanceCounter(&startCounter, NULL);
+    status = PhQueryJson(document->Buffer, document->Length, queries, RTL_NUMBER_OF(queries));
+    assert(NT_SUCCESS(status));
+    wprintf(L"%-26s %8.2f ms\n", L"query", GetElapsedMilliseconds(&startCounter));
+    assert(PhJsonValueToInteger64(&queries[0].Value) == 1);
+    assert(queries[1].Value.Type == PH_JSON_TOKEN_NONE);
+    assert(queries[2].Value.Type == PH_JSON_TOKEN_STRING && queries[2].Value.Text.Length == 14);
+
+    PhDereferenceObject(document);
+}
+
+VOID Test_json(
+    VOID
+    )
+{
+    Test_reader();
+    Test_query();
+    Test_writer();
+    Test_benchmark();
+}
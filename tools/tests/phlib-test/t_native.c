@@ -0,0 +1,347 @@
+#include "tests.h"
+
+#define TEST_ITERATIONS 1000
+
+// A fake address space made of a few regions. A read succeeds only if it lies entirely within
+// one region, like a read of a process whose memory around the regions is not mapped.
+
+#define TEST_PEB_ADDRESS ((ULONG_PTR)0x10000)
+#define TEST_PARAMETERS_ADDRESS ((ULONG_PTR)0x20000)
+#define TEST_FAR_ADDRESS ((ULONG_PTR)0x800000)
+#define TEST_PEB32_ADDRESS ((ULONG_PTR)0x30000)
+#define TEST_PARAMETERS32_ADDRESS ((ULONG_PTR)0x40000)
+
+typedef struct _TEST_MEMORY_REGION
+{
+    ULONG_PTR Address;
+    SIZE_T Size;
+    PVOID Buffer;
+} TEST_MEMORY_REGION, *PTEST_MEMORY_REGION;
+
+typedef struct _TEST_ADDRESS_SPACE
+{
+    ULONG NumberOfRegions;
+    TEST_MEMORY_REGION Regions[4];
+    ULONG NumberOfReads;
+} TEST_ADDRESS_SPACE, *PTEST_ADDRESS_SPACE;
+
+static NTSTATUS NTAPI TestReadMemoryCallback(
+    _In_ HANDLE ProcessHandle,
+    _In_ PVOID BaseAddress,
+    _Out_writes_bytes_(BufferSize) PVOID Buffer,
+    _In_ SIZE_T BufferSize,
+    _In_opt_ PVOID Context
+    )
+{
+    PTEST_ADDRESS_SPACE addressSpace = Context;
+    ULONG_PTR address = (ULONG_PTR)BaseAddress;
+    ULONG i;
+
+    addressSpace->NumberOfReads++;
+
+    if (address + BufferSize < address)
+        return STATUS_ACCESS_VIOLATION;
+
+    for (i = 0; i < addressSpace->NumberOfRegions; i++)
+    {
+        PTEST_MEMORY_REGION region = &addressSpace->Regions[i];
+
+        if (address >= region->Address && address + BufferSize <= region->Address + region->Size)
+        {
+            memcpy(Buffer, PTR_ADD_OFFSET(region->Buffer, address - region->Address), BufferSize);
+            return STATUS_SUCCESS;
+        }
+    }
+
+    return STATUS_PARTIAL_COPY;
+}
+
+static VOID SetTestPebString(
+    _Out_ PUNICODE_STRING UnicodeString,
+    _In_ ULONG_PTR Address,
+    _In_ USHORT Length
+    )
+{
+    UnicodeString->Length = Length;
+    UnicodeString->MaximumLength = Length;
+    UnicodeString->Buffer = (PWCH)Address;
+}
+
+static VOID Test_pebimages(
+    VOID
+    )
+{
+    static PH_PEB_OFFSET offsets[] =
+    {
+        PhpoCommandLine,
+        PhpoCurrentDirectory,
+        PhpoImagePathName,
+        PhpoWindowTitle
+    };
+    static PH_PEB_OFFSET offsets32[] =
+    {
+        PhpoCommandLine | PhpoWow64,
+        PhpoCurrentDirectory | PhpoWow64
+    };
+    static WCHAR text[] = L"C:\\Windows\\notepad.exe readme.txt";
+    TEST_ADDRESS_SPACE addressSpace;
+    PVOID peb;
+    PRTL_USER_PROCESS_PARAMETERS parameters;
+    PWCHAR farText;
+    PVOID peb32;
+    PRTL_USER_PROCESS_PARAMETERS32 parameters32;
+    ULONG_PTR textAddress;
+    ULONG textOffset;
+    PPH_STRING strings[RTL_NUMBER_OF(offsets)];
+    PH_PEB_OFFSET badOffsets[2];
+    NTSTATUS status;
+    ULONG i;
+
+    // The parameters region holds the structure followed by the text, like a real process.
+
+    textOffset = sizeof(RTL_USER_PROCESS_PARAMETERS);
+    textAddress = TEST_PARAMETERS_ADDRESS + textOffset;
+
+    peb = PhAllocateZero(sizeof(PEB));
+    parameters = PhAllocateZero(textOffset + sizeof(text));
+    memcpy(PTR_ADD_OFFSET(parameters, textOffset), text, sizeof(text));
+    farText = PhAllocateCopy(text, sizeof(text));
+
+    ((PPEB)peb)->ProcessParameters = (PRTL_USER_PROCESS_PARAMETERS)TEST_PARAMETERS_ADDRESS;
+    SetTestPebString(&parameters->CommandLine, textAddress, sizeof(text) - sizeof(UNICODE_NULL));
+    SetTestPebString(&parameters->CurrentDirectory.DosPath, textAddress, 10 * sizeof(WCHAR));
+    SetTestPebString(&parameters->ImagePathName, textAddress, 22 * sizeof(WCHAR));
+    SetTestPebString(&parameters->WindowTitle, MAXULONG_PTR - 1, 0); // empty, so never read
+
+    memset(&addressSpace, 0, sizeof(TEST_ADDRESS_SPACE));
+    addressSpace.NumberOfRegions = 3;
+    addressSpace.Regions[0].Address = TEST_PEB_ADDRESS;
+    addressSpace.Regions[0].Size = sizeof(PEB);
+    addressSpace.Regions[0].Buffer = peb;
+    addressSpace.Regions[1].Address = TEST_PARAMETERS_ADDRESS;
+    addressSpace.Regions[1].Size = textOffset + sizeof(text);
+    addressSpace.Regions[1].Buffer = parameters;
+    addressSpace.Regions[2].Address = TEST_FAR_ADDRESS;
+    addressSpace.Regions[2].Size = sizeof(text);
+    addressSpace.Regions[2].Buffer = farText;
+
+    // A well-formed image is read with one call for the PEB, one for the parameters and one for
+    // all the strings.
+
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB_ADDRESS, RTL_NUMBER_OF(offsets), offsets, strings, TestReadMemoryCallback, &addressSpace);
+    assert(NT_SUCCESS(status));
+    assert(addressSpace.NumberOfReads == 3);
+    assert(PhEqualString2(strings[0], text, FALSE));
+    assert(PhEqualString2(strings[1], L"C:\\Windows", FALSE));
+    assert(PhEqualString2(strings[2], L"C:\\Windows\\notepad.exe", FALSE));
+    assert(strings[3]->Length == 0);
+
+    for (i = 0; i < RTL_NUMBER_OF(offsets); i++)
+        PhDereferenceObject(strings[i]);
+
+    badOffsets[0] = PhpoCommandLine;
+    badOffsets[1] = PhpoCommandLine | PhpoWow64;
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB_ADDRESS, 2, badOffsets, strings, TestReadMemoryCallback, &addressSpace);
+    assert(status == STATUS_INVALID_PARAMETER_4);
+
+    // Strings that are far apart, or that have a gap between them, are read separately.
+
+    SetTestPebString(&parameters->ImagePathName, TEST_FAR_ADDRESS, 22 * sizeof(WCHAR));
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB_ADDRESS, RTL_NUMBER_OF(offsets), offsets, strings, TestReadMemoryCallback, &addressSpace);
+    assert(NT_SUCCESS(status));
+    assert(PhEqualString2(strings[0], text, FALSE));
+    assert(PhEqualString2(strings[2], L"C:\\Windows\\notepad.exe", FALSE));
+
+    for (i = 0; i < RTL_NUMBER_OF(offsets); i++)
+        PhDereferenceObject(strings[i]);
+
+    addressSpace.Regions[2].Address = textAddress + sizeof(text) + 0x1000;
+    SetTestPebString(&parameters->ImagePathName, addressSpace.Regions[2].Address, 22 * sizeof(WCHAR));
+    addressSpace.NumberOfReads = 0;
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB_ADDRESS, RTL_NUMBER_OF(offsets), offsets, strings, TestReadMemoryCallback, &addressSpace);
+    assert(NT_SUCCESS(status));
+    assert(addressSpace.NumberOfReads == 6);
+    assert(PhEqualString2(strings[1], L"C:\\Windows", FALSE));
+    assert(PhEqualString2(strings[2], L"C:\\Windows\\notepad.exe", FALSE));
+
+    for (i = 0; i < RTL_NUMBER_OF(offsets); i++)
+        PhDereferenceObject(strings[i]);
+
+    // An odd length is truncated to a whole number of characters.
+
+    SetTestPebString(&parameters->ImagePathName, textAddress, 22 * sizeof(WCHAR) + 1);
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB_ADDRESS, RTL_NUMBER_OF(offsets), offsets, strings, TestReadMemoryCallback, &addressSpace);
+    assert(NT_SUCCESS(status));
+    assert(PhEqualString2(strings[2], L"C:\\Windows\\notepad.exe", FALSE));
+
+    for (i = 0; i < RTL_NUMBER_OF(offsets); i++)
+        PhDereferenceObject(strings[i]);
+
+    // A string that runs past the end of its region, or whose end overflows the address space,
+    // fails the whole call.
+
+    SetTestPebString(&parameters->ImagePathName, textAddress, sizeof(text) + sizeof(WCHAR));
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB_ADDRESS, RTL_NUMBER_OF(offsets), offsets, strings, TestReadMemoryCallback, &addressSpace);
+    assert(!NT_SUCCESS(status));
+
+    SetTestPebString(&parameters->ImagePathName, MAXULONG_PTR - 3, 0x100);
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB_ADDRESS, RTL_NUMBER_OF(offsets), offsets, strings, TestReadMemoryCallback, &addressSpace);
+    assert(!NT_SUCCESS(status));
+
+    SetTestPebString(&parameters->ImagePathName, textAddress, 22 * sizeof(WCHAR));
+
+    // A truncated parameters structure or PEB, or a bad parameters pointer, fails the call.
+
+    addressSpace.Regions[1].Size = FIELD_OFFSET(RTL_USER_PROCESS_PARAMETERS, CurrentDirectories) - 1;
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB_ADDRESS, RTL_NUMBER_OF(offsets), offsets, strings, TestReadMemoryCallback, &addressSpace);
+    assert(!NT_SUCCESS(status));
+    addressSpace.Regions[1].Size = textOffset + sizeof(text);
+
+    ((PPEB)peb)->ProcessParameters = (PRTL_USER_PROCESS_PARAMETERS)(TEST_PARAMETERS_ADDRESS + textOffset);
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB_ADDRESS, RTL_NUMBER_OF(offsets), offsets, strings, TestReadMemoryCallback, &addressSpace);
+    assert(!NT_SUCCESS(status));
+    ((PPEB)peb)->ProcessParameters = NULL;
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB_ADDRESS, RTL_NUMBER_OF(offsets), offsets, strings, TestReadMemoryCallback, &addressSpace);
+    assert(!NT_SUCCESS(status));
+    ((PPEB)peb)->ProcessParameters = (PRTL_USER_PROCESS_PARAMETERS)TEST_PARAMETERS_ADDRESS;
+
+    addressSpace.Regions[0].Size = FIELD_OFFSET(PEB, ProcessParameters) + sizeof(PVOID) - 1;
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB_ADDRESS, RTL_NUMBER_OF(offsets), offsets, strings, TestReadMemoryCallback, &addressSpace);
+    assert(!NT_SUCCESS(status));
+    addressSpace.Regions[0].Size = sizeof(PEB);
+
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB_ADDRESS, RTL_NUMBER_OF(offsets), offsets, strings, TestReadMemoryCallback, &addressSpace);
+    assert(NT_SUCCESS(status));
+
+    for (i = 0; i < RTL_NUMBER_OF(offsets); i++)
+        PhDereferenceObject(strings[i]);
+
+    // The 32-bit structures of a WOW64 process.
+
+    textOffset = sizeof(RTL_USER_PROCESS_PARAMETERS32);
+    textAddress = TEST_PARAMETERS32_ADDRESS + textOffset;
+
+    peb32 = PhAllocateZero(sizeof(PEB32));
+    parameters32 = PhAllocateZero(textOffset + sizeof(text));
+    memcpy(PTR_ADD_OFFSET(parameters32, textOffset), text, sizeof(text));
+
+    ((PPEB32)peb32)->ProcessParameters = TEST_PARAMETERS32_ADDRESS;
+    parameters32->CommandLine.Length = sizeof(text) - sizeof(UNICODE_NULL);
+    parameters32->CommandLine.Buffer = (ULONG)textAddress;
+    parameters32->CurrentDirectory.DosPath.Length = 10 * sizeof(WCHAR);
+    parameters32->CurrentDirectory.DosPath.Buffer = (ULONG)textAddress;
+
+    addressSpace.NumberOfRegions = 2;
+    addressSpace.Regions[0].Address = TEST_PEB32_ADDRESS;
+    addressSpace.Regions[0].Size = sizeof(PEB32);
+    addressSpace.Regions[0].Buffer = peb32;
+    addressSpace.Regions[1].Address = TEST_PARAMETERS32_ADDRESS;
+    addressSpace.Regions[1].Size = textOffset + sizeof(text);
+    addressSpace.Regions[1].Buffer = parameters32;
+
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB32_ADDRESS, RTL_NUMBER_OF(offsets32), offsets32, strings, TestReadMemoryCallback, &addressSpace);
+    assert(NT_SUCCESS(status));
+    assert(PhEqualString2(strings[0], text, FALSE));
+    assert(PhEqualString2(strings[1], L"C:\\Windows", FALSE));
+
+    for (i = 0; i < RTL_NUMBER_OF(offsets32); i++)
+        PhDereferenceObject(strings[i]);
+
+    addressSpace.Regions[1].Size = FIELD_OFFSET(RTL_USER_PROCESS_PARAMETERS32, CurrentDirectories) - 1;
+    status = PhGetProcessPebStringsEx(NULL, (PVOID)TEST_PEB32_ADDRESS, RTL_NUMBER_OF(offsets32), offsets32, strings, TestReadMemoryCallback, &addressSpace);
+    assert(!NT_SUCCESS(status));
+
+    PhFree(parameters32);
+    PhFree(peb32);
+    PhFree(farText);
+    PhFree(parameters);
+    PhFree(peb);
+}
+
+static VOID Test_pebstrings(
+    VOID
+    )
+{
+    static PH_PEB_OFFSET offsets[] =
+    {
+        PhpoCommandLine,
+        PhpoCurrentDirectory,
+        PhpoImagePathName,
+        PhpoDllPath,
+        PhpoWindowTitle,
+        PhpoDesktopInfo
+    };
+    PPH_STRING strings[RTL_NUMBER_OF(offsets)];
+    PPH_STRING string;
+    PH_PEB_OFFSET badOffsets[2];
+    LARGE_INTEGER startCounter;
+    DOUBLE batchTime;
+    DOUBLE singleTime;
+    NTSTATUS status;
+    ULONG i;
+    ULONG j;
+
+    // The strings are the same as the ones returned separately.
+
+    status = PhGetProcessPebStrings(NtCurrentProcess(), RTL_NUMBER_OF(offsets), offsets, strings);
+    assert(NT_SUCCESS(status));
+
+    for (i = 0; i < RTL_NUMBER_OF(offsets); i++)
+    {
+        status = PhGetProcessPebString(NtCurrentProcess(), offsets[i], &string);
+        assert(NT_SUCCESS(status));
+        assert(PhEqualString(strings[i], string, FALSE));
+        PhDereferenceObject(string);
+        PhDereferenceObject(strings[i]);
+    }
+
+    status = PhGetProcessPebStrings(NtCurrentProcess(), 0, offsets, strings);
+    assert(NT_SUCCESS(status));
+
+    badOffsets[0] = PhpoCommandLine;
+    badOffsets[1] = PhpoTypeMask;
+    status = PhGetProcessPebStrings(NtCurrentProcess(), 2, badOffsets, strings);
+    assert(status == STATUS_INVALID_PARAMETER_3);
+    badOffsets[1] = PhpoCurrentDirectory | PhpoWow64;
+    status = PhGetProcessPebStrings(NtCurrentProcess(), 2, badOffsets, strings);
+    assert(status == STATUS_INVALID_PARAMETER_3);
+
+    NtQueryPerformanceCounter(&startCounter, NULL);
+
+    for (j = 0; j < TEST_ITERATIONS; j++)
+    {
+        PhGetProcessPebStrings(NtCurrentProcess(), RTL_NUMBER_OF(offsets), offsets, strings);
+
+        for (i = 0; i < RTL_NUMBER_OF(offsets); i++)
+            PhDereferenceObject(strings[i]);
+    }
+
+    batchTime = GetElapsedMilliseconds(&startCounter);
+
+    NtQueryPerformanceCounter(&startCounter, NULL);
+
+    for (j = 0; j < TEST_ITERATIONS; j++)
+    {
+        for (i = 0; i < RTL_NUMBER_OF(offsets); i++)
+        {
+            PhGetProcessPebString(NtCurrentProcess(), offsets[i], &string);
+            PhDereferenceObject(string);
+        }
+    }
+
+    singleTime = GetElapsedMilliseconds(&startCounter);
+
+    wprintf(L"%lu PEB strings: %.3f ms per 1000 calls (%.3f ms separately)\n",
+        (ULONG)RTL_NUMBER_OF(offsets),
+        batchTime * 1000 / TEST_ITERATIONS,
+        singleTime * 1000 / TEST_ITERATIONS
+        );
+}
+
+VOID Test_native(
+    VOID
+    )
+{
+    Test_pebstrings();
+    Test_pebimages();
+}
@@ -0,0 +1,307 @@
+#include "tests.h"
+#include <phquery.h>
+
+#define BENCHMARK_RECORD_COUNT 10000
+#define BENCHMARK_ITERATIONS 100
+
+typedef enum _TEST_FIELD
+{
+    TestFieldPid,
+    TestFieldCpu,
+    TestFieldPrivate,
+    TestFieldName,
+    TestFieldUser,
+    TestFieldPath
+} TEST_FIELD;
+
+typedef struct _TEST_RECORD
+{
+    ULONG Pid;
+    DOUBLE Cpu;
+    ULONG64 Private;
+    PH_STRINGREF Name;
+    PH_STRINGREF User;
+    PPH_STRINGREF Path;
+} TEST_RECORD, *PTEST_RECORD;
+
+static ULONG NumberOfStringLookups;
+
+static DOUBLE NTAPI TestGetNumber(
+    _In_ ULONG FieldId,
+    _In_ PVOID Object
+    )
+{
+    PTEST_RECORD record = Object;
+
+    switch (FieldId)
+    {
+    case TestFieldPid:
+        return record->Pid;
+    case TestFieldCpu:
+        return record->Cpu;
+    case TestFieldPrivate:
+        return (DOUBLE)record->Private;
+    }
+
+    return 0;
+}
+
+static BOOLEAN NTAPI TestGetString(
+    _In_ ULONG FieldId,
+    _In_ PVOID Object,
+    _Out_ PPH_STRINGREF Value
+    )
+{
+    PTEST_RECORD record = Object;
+
+    NumberOfStringLookups++;
+
+    switch (FieldId)
+    {
+    case TestFieldName:
+        *Value = record->Name;
+        return TRUE;
+    case TestFieldUser:
+        *Value = record->User;
+        return TRUE;
+    case TestFieldPath:
+        if (!record->Path)
+            return FALSE;
+        *Value = *record->Path;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static BOOLEAN NTAPI TestMatchText(
+    _In_ PPH_STRINGREF Text,
+    _In_ PVOID Object
+    )
+{
+    PTEST_RECORD record = Object;
+
+    return PhFindStringInStringRef(&record->Name, Text, TRUE) != -1;
+}
+
+static PH_QUERY_FIELD TestFields[] =
+{
+    { PH_STRINGREF_INIT(L"pid"), PH_QUERY_FIELD_NUMBER, TestFieldPid },
+    { PH_STRINGREF_INIT(L"cpu"), PH_QUERY_FIELD_NUMBER, TestFieldCpu },
+    { PH_STRINGREF_INIT(L"private"), PH_QUERY_FIELD_NUMBER, TestFieldPrivate },
+    { PH_STRINGREF_INIT(L"name"), PH_QUERY_FIELD_STRING, TestFieldName },
+    { PH_STRINGREF_INIT(L"user"), PH_QUERY_FIELD_STRING, TestFieldUser },
+    { PH_STRINGREF_INIT(L"path"), PH_QUERY_FIELD_STRING, TestFieldPath }
+};
+
+static PH_QUERY_SCHEMA TestSchema =
+{
+    TestFields,
+    RTL_NUMBER_OF(TestFields),
+    TestGetNumber,
+    TestGetString,
+    TestMatchText
+};
+
+static PPH_QUERY CompileTestQuery(
+    _In_ PWSTR Text,
+    _In_ ULONG ExpectedNumberOfFieldPredicates
+    )
+{
+    NTSTATUS status;
+    PH_STRINGREF text;
+    PPH_QUERY query;
+    ULONG numberOfFieldPredicates;
+
+    PhInitializeStringRefLongHint(&text, Text);
+    status = PhCompileQuery(&text, &TestSchema, &query, &numberOfFieldPredicates);
+    assert(NT_SUCCESS(status));
+    assert(numberOfFieldPredicates == ExpectedNumberOfFieldPredicates);
+
+    return query;
+}
+
+static BOOLEAN EvaluateTestQuery(
+    _In_ PWSTR Text,
+    _In_ PTEST_RECORD Record
+    )
+{
+    NTSTATUS status;
+    PH_STRINGREF text;
+    PPH_QUERY query;
+    BOOLEAN result;
+
+    PhInitializeStringRefLongHint(&text, Text);
+    status = PhCompileQuery(&text, &TestSchema, &query, NULL);
+    assert(NT_SUCCESS(status));
+    result = PhEvaluateQuery(query, Record);
+    PhFreeQuery(query);
+
+    return result;
+}
+
+static BOOLEAN IsInvalidTestQuery(
+    _In_ PWSTR Text
+    )
+{
+    PH_STRINGREF text;
+    PPH_QUERY query;
+
+    PhInitializeStringRefLongHint(&text, Text);
+
+    return PhCompileQuery(&text, &TestSchema, &query, NULL) == STATUS_INVALID_PARAMETER;
+}
+
+static VOID Test_language(
+    VOID
+    )
+{
+    static PH_STRINGREF path = PH_STRINGREF_INIT(L"C:\\Windows\\System32\\svchost.exe");
+    TEST_RECORD record = { 4, 12.5, 3 * 1024 * 1024, PH_STRINGREF_INIT(L"svchost.exe"), PH_STRINGREF_INIT(L"NT AUTHORITY\\SYSTEM"), &path };
+    TEST_RECORD noPathRecord = { 8, 0, 0, PH_STRINGREF_INIT(L"explorer.exe"), PH_STRINGREF_INIT(L"user"), NULL };
+    TEST_RECORD busyRecord;
+    PPH_QUERY query;
+    BOOLEAN result;
+
+    // Predicates
+    assert(EvaluateTestQuery(L"", &record));
+    assert(EvaluateTestQuery(L"  ", &record));
+    assert(EvaluateTestQuery(L"pid=4", &record));
+    assert(EvaluateTestQuery(L"pid:4", &record));
+    assert(!EvaluateTestQuery(L"pid!=4", &record));
+    assert(EvaluateTestQuery(L"cpu > 12 cpu<=12.5 cpu >= -1", &record));
+    assert(!EvaluateTestQuery(L"cpu<12.5", &record));
+    assert(EvaluateTestQuery(L"private=3m private>=3MB private<3g private>3071k", &record));
+    assert(EvaluateTestQuery(L"user:system USER=\"nt authority\\system\"", &record));
+    assert(!EvaluateTestQuery(L"user=system", &record));
+    assert(EvaluateTestQuery(L"name~svc* name~*.EXE name~s?chost.exe name~*host*", &record));
+    assert(!EvaluateTestQuery(L"name~svc", &record));
+    assert(!EvaluateTestQuery(L"name~*.dll", &record));
+    assert(EvaluateTestQuery(L"path:C:\\Windows\\", &record));
+    assert(EvaluateTestQuery(L"SVCHOST", &record));
+    assert(EvaluateTestQuery(L"\"chost.e\"", &record));
+    assert(!EvaluateTestQuery(L"explorer", &record));
+
+    // Operators
+    assert(EvaluateTestQuery(L"pid=1 or pid=4", &record));
+    assert(EvaluateTestQuery(L"pid=1 | pid=4", &record));
+    assert(EvaluateTestQuery(L"pid=4 or pid=1 and pid=2", &record));
+    assert(!EvaluateTestQuery(L"(pid=4 or pid=1) and pid=2", &record));
+    assert(EvaluateTestQuery(L"not pid=1 and not (cpu<1 or user:nobody)", &record));
+    assert(!EvaluateTestQuery(L"not not pid=1", &record));
+    assert(EvaluateTestQuery(L"pid=4 cpu>1 (name:svc or name:explorer)", &record));
+    assert(!EvaluateTestQuery(L"pid=4 cpu>1 name:explorer", &record));
+
+    // Fields that are missing from the object or the schema never match.
+    assert(!EvaluateTestQuery(L"path:C", &noPathRecord));
+    assert(!EvaluateTestQuery(L"path!=C", &noPathRecord));
+    assert(EvaluateTestQuery(L"not path:C", &noPathRecord));
+    assert(!EvaluateTestQuery(L"color=red", &record));
+    assert(EvaluateTestQuery(L"color=red or pid=4", &record));
+    PhFreeQuery(CompileTestQuery(L"color=red or pid=4 name:svc explorer", 2));
+
+    // Number predicates are evaluated before string predicates.
+    query = CompileTestQuery(L"user:system and name~\"svc*\" and cpu>50", 3);
+    NumberOfStringLookups = 0;
+    result = PhEvaluateQuery(query, &record);
+    assert(!result);
+    assert(NumberOfStringLookups == 0);
+    busyRecord = record;
+    busyRecord.Cpu = 60;
+    result = PhEvaluateQuery(query, &busyRecord);
+    assert(result);
+    assert(NumberOfStringLookups == 2);
+    PhFreeQuery(query);
+
+    // Errors
+    assert(IsInvalidTestQuery(L"name>5"));
+    assert(IsInvalidTestQuery(L"pid~4"));
+    assert(IsInvalidTestQuery(L"pid=four"));
+    assert(IsInvalidTestQuery(L"private=k"));
+    assert(IsInvalidTestQuery(L"pid="));
+    assert(IsInvalidTestQuery(L"pid!4"));
+    assert(IsInvalidTestQuery(L"(pid=4"));
+    assert(IsInvalidTestQuery(L"pid=4)"));
+    assert(IsInvalidTestQuery(L"pid=4 and"));
+    assert(IsInvalidTestQuery(L"or pid=4"));
+    assert(IsInvalidTestQuery(L"not"));
+    assert(IsInvalidTestQuery(L"\"svchost"));
+    assert(IsInvalidTestQuery(L"((((((((((((((((((((((((((((((((((((((((((((((((((((((((((((((((((pid=4))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))))"));
+}
+
+static VOID BenchmarkQuery(
+    _In_ PTEST_RECORD Records,
+    _In_ PWSTR Text,
+    _In_ ULONG ExpectedCount
+    )
+{
+    NTSTATUS status;
+    PH_STRINGREF text;
+    PPH_QUERY query;
+    LARGE_INTEGER startCounter;
+    ULONG count;
+    ULONG i;
+    ULONG j;
+
+    PhInitializeStringRefLongHint(&text, Text);
+    status = PhCompileQuery(&text, &TestSchema, &query, NULL);
+    assert(NT_SUCCESS(status));
+
+    NtQueryPerformanceCounter(&startCounter, NULL);
+
+    for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+    {
+        count = 0;
+
+        for (j = 0; j < BENCHMARK_RECORD_COUNT; j++)
+        {
+            if (PhEvaluateQuery(query, &Records[j]))
+                count++;
+        }
+
+        assert(count == ExpectedCount);
+    }
+
+    wprintf(L"%-46s %8.3f ms per 10k\n", Text, GetElapsedMilliseconds(&startCounter) / BENCHMARK_ITERATIONS);
+
+    PhFreeQuery(query);
+}
+
+static VOID Test_benchmark(
+    VOID
+    )
+{
+    static PH_STRINGREF names[] = { PH_STRINGREF_INIT(L"svchost.exe"), PH_STRINGREF_INIT(L"explorer.exe"), PH_STRINGREF_INIT(L"chrome.exe"), PH_STRINGREF_INIT(L"services.exe") };
+    static PH_STRINGREF users[] = { PH_STRINGREF_INIT(L"NT AUTHORITY\\SYSTEM"), PH_STRINGREF_INIT(L"NT AUTHORITY\\LOCAL SERVICE"), PH_STRINGREF_INIT(L"DESKTOP\\user") };
+    PTEST_RECORD records;
+    ULONG i;
+
+    records = PhAllocate(sizeof(TEST_RECORD) * BENCHMARK_RECORD_COUNT);
+
+    for (i = 0; i < BENCHMARK_RECORD_COUNT; i++)
+    {
+        records[i].Pid = (i + 1) * 4;
+        records[i].Cpu = i % 100;
+        records[i].Private = (ULONG64)(i % 64) * 1024 * 1024;
+        records[i].Name = names[i % 4];
+        records[i].User = users[i % 3];
+        records[i].Path = NULL;
+    }
+
+    // The first two queries only differ in the order of their predicates, and should take about
+    // the same time.
+    BenchmarkQuery(records, L"cpu>5 and user:SYSTEM and name~\"svc*\"", 767);
+    BenchmarkQuery(records, L"name~\"svc*\" and user:SYSTEM and cpu>5", 767);
+    BenchmarkQuery(records, L"cpu>=99 or private>=63m", 250);
+    BenchmarkQuery(records, L"svchost", 2500);
+
+    PhFree(records);
+}
+
+VOID Test_phquery(
+    VOID
+    )
+{
+    Test_language();
+    Test_benchmark();
+}
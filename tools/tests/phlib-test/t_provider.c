@@ -0,0 +1,167 @@
+#include "tests.h"
+#include <provider.h>
+
+#define TEST_THREAD_INTERVAL 20
+#define TEST_DURATION 1000
+#define TEST_SLOW_RUN_TIME 5
+
+static PH_PROVIDER_REGISTRATION NormalRegistration;
+static PH_PROVIDER_REGISTRATION SlowRegistration; // runs every 100 ms and takes a while
+static PH_PROVIDER_REGISTRATION UnchangedRegistration; // never reports changes
+static PH_PROVIDER_REGISTRATION ChangedRegistration; // always reports changes
+static PH_PROVIDER_REGISTRATION BackgroundRegistration;
+
+static ULONG NormalRuns;
+static ULONG SlowRuns;
+static ULONG UnchangedRuns;
+static ULONG ChangedRuns;
+static ULONG BackgroundRuns;
+
+static VOID NTAPI NormalProviderUpdate(
+    _In_ PVOID Object
+    )
+{
+    NormalRuns++;
+}
+
+static VOID NTAPI SlowProviderUpdate(
+    _In_ PVOID Object
+    )
+{
+    SlowRuns++;
+    PhDelayExecution(TEST_SLOW_RUN_TIME);
+}
+
+static VOID NTAPI UnchangedProviderUpdate(
+    _In_ PVOID Object
+    )
+{
+    UnchangedRuns++;
+}
+
+static VOID NTAPI ChangedProviderUpdate(
+    _In_ PVOID Object
+    )
+{
+    ChangedRuns++;
+    PhSetChangedProvider(&ChangedRegistration);
+}
+
+static VOID NTAPI BackgroundProviderUpdate(
+    _In_ PVOID Object
+    )
+{
+    BackgroundRuns++;
+}
+
+static VOID Test_schedule(
+    VOID
+    )
+{
+    PH_PROVIDER_THREAD providerThread;
+    PH_PROVIDER_STATISTICS statistics;
+
+    PhInitializeProviderThread(&providerThread, TEST_THREAD_INTERVAL);
+
+    PhRegisterProvider(&providerThread, NormalProviderUpdate, NULL, &NormalRegistration);
+    PhRegisterProvider(&providerThread, SlowProviderUpdate, NULL, &SlowRegistration);
+    PhRegisterProvider(&providerThread, UnchangedProviderUpdate, NULL, &UnchangedRegistration);
+    PhRegisterProvider(&providerThread, ChangedProviderUpdate, NULL, &ChangedRegistration);
+    PhRegisterProvider(&providerThread, BackgroundProviderUpdate, NULL, &BackgroundRegistration);
+
+    PhSetScheduleProvider(&SlowRegistration, 100, 0);
+    PhSetScheduleProvider(&UnchangedRegistration, 0, PH_PROVIDER_BACKOFF_UNCHANGED);
+    PhSetScheduleProvider(&ChangedRegistration, 0, PH_PROVIDER_BACKOFF_UNCHANGED);
+    PhSetScheduleProvider(&BackgroundRegistration, 0, PH_PROVIDER_BACKOFF_BACKGROUND);
+    PhSetBackgroundProviderThread(&providerThread, TRUE);
+
+    PhSetEnabledProvider(&NormalRegistration, TRUE);
+    PhSetEnabledProvider(&SlowRegistration, TRUE);
+    PhSetEnabledProvider(&UnchangedRegistration, TRUE);
+    PhSetEnabledProvider(&ChangedRegistration, TRUE);
+    PhSetEnabledProvider(&BackgroundRegistration, TRUE);
+
+    PhStartProviderThread(&providerThread);
+    PhDelayExecution(TEST_DURATION);
+    PhStopProviderThread(&providerThread);
+
+    wprintf(L"provider runs: normal %lu, slow %lu, unchanged %lu, changed %lu, background %lu\n",
+        NormalRuns, SlowRuns, UnchangedRuns, ChangedRuns, BackgroundRuns);
+
+    // The timer resolution makes the exact number of runs unpredictable, so only compare them.
+
+    assert(NormalRuns >= 10);
+    assert(SlowRuns * 2 < NormalRuns);
+    assert(UnchangedRuns * 2 < NormalRuns);
+    assert(ChangedRuns * 2 > NormalRuns);
+    assert(BackgroundRuns * 2 < NormalRuns);
+
+    PhGetStatisticsProvider(&NormalRegistration, &statistics);
+    assert(statistics.NumberOfRuns == NormalRuns);
+    assert(statistics.Backoff == 1);
+
+    PhGetStatisticsProvider(&SlowRegistration, &statistics);
+    assert(statistics.NumberOfRuns == SlowRuns);
+    assert(statistics.NumberOfSkippedRuns != 0);
+    assert(statistics.MaximumRunTime >= (TEST_SLOW_RUN_TIME - 1) * PH_TICKS_PER_MS);
+    assert(statistics.TotalRunTime >= statistics.MaximumRunTime);
+    assert(statistics.LastRunTime <= statistics.MaximumRunTime);
+
+    PhGetStatisticsProvider(&UnchangedRegistration, &statistics);
+    assert(statistics.NumberOfRuns == UnchangedRuns);
+    assert(statistics.Backoff == PH_PROVIDER_MAXIMUM_BACKOFF);
+
+    PhGetStatisticsProvider(&ChangedRegistration, &statistics);
+    assert(statistics.Backoff == 1);
+
+    PhUnregisterProvider(&NormalRegistration);
+    PhUnregisterProvider(&SlowRegistration);
+    PhUnregisterProvider(&UnchangedRegistration);
+    PhUnregisterProvider(&ChangedRegistration);
+    PhUnregisterProvider(&BackgroundRegistration);
+    PhDeleteProviderThread(&providerThread);
+}
+
+static VOID Test_interval(
+    VOID
+    )
+{
+    PH_PROVIDER_THREAD providerThread;
+    PH_PROVIDER_REGISTRATION registration;
+    PH_PROVIDER_STATISTICS statistics;
+
+    PhInitializeProviderThread(&providerThread, TEST_THREAD_INTERVAL);
+
+    UnchangedRuns = 0;
+    PhRegisterProvider(&providerThread, UnchangedProviderUpdate, NULL, &registration);
+    PhSetScheduleProvider(&registration, 0, PH_PROVIDER_BACKOFF_UNCHANGED);
+    PhSetEnabledProvider(&registration, TRUE);
+
+    PhStartProviderThread(&providerThread);
+    PhDelayExecution(TEST_DURATION / 2);
+    PhStopProviderThread(&providerThread);
+
+    PhGetStatisticsProvider(&registration, &statistics);
+    assert(statistics.Backoff == PH_PROVIDER_MAXIMUM_BACKOFF);
+    assert(registration.DueTime != 0);
+
+    // A new interval discards the schedule computed with the old one.
+
+    PhSetIntervalProviderThread(&providerThread, TEST_THREAD_INTERVAL * 2);
+
+    PhGetStatisticsProvider(&registration, &statistics);
+    assert(statistics.Backoff == 1);
+    assert(registration.DueTime == 0);
+    assert(providerThread.Interval == TEST_THREAD_INTERVAL * 2);
+
+    PhUnregisterProvider(&registration);
+    PhDeleteProviderThread(&providerThread);
+}
+
+VOID Test_provider(
+    VOID
+    )
+{
+    Test_schedule();
+    Test_interval();
+}
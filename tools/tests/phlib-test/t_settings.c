@@ -0,0 +1,384 @@
+#include "tests.h"
+#include <settings.h>
+
+#define TEST_SETTING_COUNT 5000
+#define TEST_CHANGED_COUNT 16
+
+// The settings system expects the program to provide these.
+
+VOID PhAddDefaultSettings(
+    VOID
+    )
+{
+    NOTHING;
+}
+
+VOID PhUpdateCachedSettings(
+    VOID
+    )
+{
+    NOTHING;
+}
+
+static PPH_STRING SettingNames[TEST_SETTING_COUNT];
+
+static VOID AddTestSettings(
+    VOID
+    )
+{
+    static PWSTR defaultValues[] = { L"", L"0", L"0,0", L"@96|0,0" };
+    PPH_SETTING_CREATE settings;
+    ULONG i;
+
+    settings = PhAllocate(sizeof(PH_SETTING_CREATE) * TEST_SETTING_COUNT);
+
+    for (i = 0; i < TEST_SETTING_COUNT; i++)
+    {
+        // The settings system keeps pointers to the names, so they are never freed.
+        SettingNames[i] = PhFormatString(L"TestSetting%lu", i);
+        settings[i].Type = (PH_SETTING_TYPE)(i % 4);
+        settings[i].Name = SettingNames[i]->Buffer;
+        settings[i].DefaultValue = defaultValues[i % 4];
+    }
+
+    PhAddSettings(settings, TEST_SETTING_COUNT);
+    PhFree(settings);
+}
+
+static PPH_STRING FormatStringValue(
+    _In_ ULONG Index,
+    _In_ ULONG Seed
+    )
+{
+    // Roughly the size of a tree list column setting.
+    return PhFormatString(L"%lu,%lu|0,50,1;1,120,2;2,80,3;3,80,4;4,100,5;5,200,6;6,60,7;7,60,8;8,90,9", Index, Seed);
+}
+
+static VOID SetTestSetting(
+    _In_ ULONG Index,
+    _In_ ULONG Seed
+    )
+{
+    PWSTR name = SettingNames[Index]->Buffer;
+
+    switch (Index % 4)
+    {
+    case StringSettingType:
+        {
+            PPH_STRING value = FormatStringValue(Index, Seed);
+
+            PhSetStringSetting2(name, &value->sr);
+            PhDereferenceObject(value);
+        }
+        break;
+    case IntegerSettingType:
+        PhSetIntegerSetting(name, Index * 7 + Seed);
+        break;
+    case IntegerPairSettingType:
+        {
+            PH_INTEGER_PAIR value;
+
+            value.X = Index + Seed;
+            value.Y = -(LONG)Index;
+            PhSetIntegerPairSetting(name, value);
+        }
+        break;
+    case ScalableIntegerPairSettingType:
+        {
+            PH_SCALABLE_INTEGER_PAIR value;
+
+            value.X = Index;
+            value.Y = Index + Seed;
+            value.Scale = 144;
+            PhSetScalableIntegerPairSetting(name, value);
+        }
+        break;
+    }
+}
+
+static VOID CheckTestSetting(
+    _In_ ULONG Index,
+    _In_ ULONG Seed
+    )
+{
+    PWSTR name = SettingNames[Index]->Buffer;
+
+    switch (Index % 4)
+    {
+    case StringSettingType:
+        {
+            PPH_STRING expected = FormatStringValue(Index, Seed);
+            PPH_STRING value = PhGetStringSetting(name);
+
+            assert(PhEqualString(value, expected, FALSE));
+            PhDereferenceObject(value);
+            PhDereferenceObject(expected);
+        }
+        break;
+    case IntegerSettingType:
+        assert(PhGetIntegerSetting(name) == Index * 7 + Seed);
+        break;
+    case IntegerPairSettingType:
+        {
+            PH_INTEGER_PAIR value = PhGetIntegerPairSetting(name);
+
+            assert(value.X == (LONG)(Index + Seed) && value.Y == -(LONG)Index);
+        }
+        break;
+    case ScalableIntegerPairSettingType:
+        {
+            PH_SCALABLE_INTEGER_PAIR value = PhGetScalableIntegerPairSetting(name, FALSE);
+
+            assert(value.X == (LONG)Index && value.Y == (LONG)(Index + Seed) && value.Scale == 144);
+        }
+        break;
+    }
+}
+
+static VOID CheckTestSettings(
+    _In_ ULONG Seed,
+    _In_ ULONG ChangedSeed
+    )
+{
+    ULONG i;
+
+    for (i = 0; i < TEST_SETTING_COUNT; i++)
+        CheckTestSetting(i, i < TEST_CHANGED_COUNT ? ChangedSeed : Seed);
+}
+
+static ULONG64 GetTestFileSize(
+    _In_ PPH_STRING FileName
+    )
+{
+    NTSTATUS status;
+    FILE_NETWORK_OPEN_INFORMATION information;
+
+    status = PhQueryFullAttributesFileWin32(FileName->Buffer, &information);
+    assert(NT_SUCCESS(status));
+
+    return information.EndOfFile.QuadPart;
+}
+
+static NTSTATUS PairWriterThreadStart(
+    _In_ PVOID Parameter
+    )
+{
+    PPH_SETTING_HANDLE handle = Parameter;
+    PH_INTEGER_PAIR value;
+    LONG i;
+
+    for (i = 1; i <= 100000; i++)
+    {
+        value.X = i;
+        value.Y = -i;
+        PhSetIntegerPairSettingByHandle(handle, value);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static VOID TestSettingHandles(
+    VOID
+    )
+{
+    PPH_SETTING_HANDLE integerHandle;
+    PPH_SETTING_HANDLE pairHandle;
+    PPH_SETTING_HANDLE stringHandle;
+    PPH_SETTING_HANDLE scalableHandle;
+    PPH_STRING value;
+    PH_INTEGER_PAIR pair;
+    PH_SCALABLE_INTEGER_PAIR scalablePair;
+    ULONG version;
+    ULONG settingsVersion;
+    HANDLE threadHandle;
+    LARGE_INTEGER timeout;
+
+    // Handles refer to the same settings as the names, and stay valid when more settings are added.
+
+    integerHandle = PhGetSettingHandle(SettingNames[IntegerSettingType]->Buffer);
+    pairHandle = PhGetSettingHandle(SettingNames[IntegerPairSettingType]->Buffer);
+    stringHandle = PhGetSettingHandle(SettingNames[StringSettingType]->Buffer);
+    scalableHandle = PhGetSettingHandle(SettingNames[ScalableIntegerPairSettingType]->Buffer);
+    assert(integerHandle == PhGetSettingHandle(SettingNames[IntegerSettingType]->Buffer));
+
+    {
+        PH_SETTING_CREATE setting = { IntegerSettingType, L"TestSettingAddedLater", L"2a" };
+
+        PhAddSettings(&setting, 1);
+        assert(PhGetIntegerSetting(L"TestSettingAddedLater") == 0x2a);
+    }
+
+    PhSetIntegerSetting(SettingNames[IntegerSettingType]->Buffer, 100);
+    assert(PhGetIntegerSettingByHandle(integerHandle) == 100);
+
+    // Versions only change when the value does.
+
+    version = PhGetSettingVersion(integerHandle);
+    settingsVersion = PhGetSettingsVersion();
+    PhSetIntegerSettingByHandle(integerHandle, 100);
+    assert(PhGetSettingVersion(integerHandle) == version);
+    assert(PhGetSettingsVersion() == settingsVersion);
+    PhSetIntegerSettingByHandle(integerHandle, 101);
+    assert(PhGetSettingVersion(integerHandle) == version + 1);
+    assert(PhGetSettingsVersion() == settingsVersion + 1);
+    assert(PhGetIntegerSetting(SettingNames[IntegerSettingType]->Buffer) == 101);
+
+    version = PhGetSettingVersion(stringHandle);
+    value = FormatStringValue(0, 4);
+    PhSetStringSettingByHandle(stringHandle, &value->sr);
+    PhSetStringSettingByHandle(stringHandle, &value->sr);
+    assert(PhGetSettingVersion(stringHandle) == version + 1);
+    PhDereferenceObject(value);
+    CheckTestSetting(0, 4);
+
+    scalablePair = PhGetScalableIntegerPairSettingByHandle(scalableHandle, FALSE);
+    version = PhGetSettingVersion(scalableHandle);
+    PhSetScalableIntegerPairSettingByHandle(scalableHandle, scalablePair);
+    assert(PhGetSettingVersion(scalableHandle) == version);
+    scalablePair.Scale++;
+    PhSetScalableIntegerPairSettingByHandle(scalableHandle, scalablePair);
+    assert(PhGetSettingVersion(scalableHandle) == version + 1);
+
+    // The name-based setters ignore a setting of another type.
+
+    pair.X = 1;
+    pair.Y = 1;
+    version = PhGetSettingVersion(integerHandle);
+    PhSetStringSetting(SettingNames[IntegerSettingType]->Buffer, L"1");
+    PhSetIntegerPairSetting(SettingNames[IntegerSettingType]->Buffer, pair);
+    assert(PhGetSettingVersion(integerHandle) == version);
+    assert(PhGetIntegerSettingByHandle(integerHandle) == 101);
+
+    // Pairs read through a handle are never torn.
+
+    pair.X = 0;
+    pair.Y = 0;
+    PhSetIntegerPairSettingByHandle(pairHandle, pair);
+
+    threadHandle = PhCreateThread2(PairWriterThreadStart, pairHandle);
+    assert(threadHandle);
+    timeout.QuadPart = 0;
+
+    while (NtWaitForSingleObject(threadHandle, FALSE, &timeout) == STATUS_TIMEOUT)
+    {
+        pair = PhGetIntegerPairSettingByHandle(pairHandle);
+        assert(pair.X == -pair.Y);
+    }
+
+    NtClose(threadHandle);
+    assert(PhGetIntegerPairSettingByHandle(pairHandle).X == 100000);
+}
+
+#define BENCHMARK(Name, Expression) \
+    { \
+        LARGE_INTEGER startCounter; \
+        NtQueryPerformanceCounter(&startCounter, NULL); \
+        status = (Expression); \
+        assert(NT_SUCCESS(status)); \
+        wprintf(L"%-26s %8.2f ms\n", Name, GetElapsedMilliseconds(&startCounter)); \
+    }
+
+VOID Test_settings(
+    VOID
+    )
+{
+    static PH_STRINGREF xmlFileName = PH_STRINGREF_INIT(L"%TEMP%\\phlib-test-settings.xml");
+    static PH_STRINGREF storeFileName = PH_STRINGREF_INIT(L"%TEMP%\\phlib-test-settings.bin");
+    NTSTATUS status;
+    PPH_STRING xmlFile;
+    PPH_STRING storeFile;
+    ULONG64 fullSize;
+    ULONG64 journalSize;
+    ULONG i;
+
+    xmlFile = PhExpandEnvironmentStrings(&xmlFileName);
+    storeFile = PhExpandEnvironmentStrings(&storeFileName);
+
+    PhSettingsInitialization();
+    AddTestSettings();
+
+    for (i = 0; i < TEST_SETTING_COUNT; i++)
+        SetTestSetting(i, 1);
+
+    // XML
+
+    BENCHMARK(L"save xml", PhSaveSettings(xmlFile->Buffer));
+    PhResetSettings();
+    BENCHMARK(L"load xml", PhLoadSettings(xmlFile->Buffer));
+    CheckTestSettings(1, 1);
+
+    // Binary store, written in full because it was not the last file loaded.
+
+    BENCHMARK(L"save binary (full)", PhSaveSettingsBinary(storeFile->Buffer));
+    fullSize = GetTestFileSize(storeFile);
+    PhResetSettings();
+    BENCHMARK(L"load binary", PhLoadSettings(storeFile->Buffer));
+    CheckTestSettings(1, 1);
+
+    // Only the changed settings are appended.
+
+    for (i = 0; i < TEST_CHANGED_COUNT; i++)
+        SetTestSetting(i, 2);
+
+    BENCHMARK(L"save binary (incremental)", PhSaveSettingsBinary(storeFile->Buffer));
+    journalSize = GetTestFileSize(storeFile);
+    assert(journalSize > fullSize && journalSize - fullSize < fullSize / 100);
+
+    // Saving again without changes doesn't write anything.
+    status = PhSaveSettingsBinary(storeFile->Buffer);
+    assert(NT_SUCCESS(status));
+    assert(GetTestFileSize(storeFile) == journalSize);
+
+    PhResetSettings();
+    status = PhLoadSettings(storeFile->Buffer);
+    assert(NT_SUCCESS(status));
+    CheckTestSettings(1, 2);
+
+    // A torn record at the end is ignored, and the next save rewrites the file.
+    {
+        HANDLE fileHandle;
+        IO_STATUS_BLOCK isb;
+        LARGE_INTEGER offset;
+        UCHAR garbage[13];
+
+        memset(garbage, 0x5a, sizeof(garbage));
+        offset.QuadPart = journalSize;
+
+        status = PhCreateFileWin32(
+            &fileHandle,
+            storeFile->Buffer,
+            FILE_GENERIC_WRITE,
+            FILE_ATTRIBUTE_NORMAL,
+            0,
+            FILE_OPEN,
+            FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT
+            );
+        assert(NT_SUCCESS(status));
+        status = NtWriteFile(fileHandle, NULL, NULL, NULL, &isb, garbage, sizeof(garbage), &offset, NULL);
+        assert(NT_SUCCESS(status));
+        NtClose(fileHandle);
+    }
+
+    PhResetSettings();
+    status = PhLoadSettings(storeFile->Buffer);
+    assert(NT_SUCCESS(status));
+    CheckTestSettings(1, 2);
+
+    SetTestSetting(0, 3);
+    status = PhSaveSettingsBinary(storeFile->Buffer);
+    assert(NT_SUCCESS(status));
+    assert(GetTestFileSize(storeFile) == fullSize);
+
+    PhResetSettings();
+    status = PhLoadSettings(storeFile->Buffer);
+    assert(NT_SUCCESS(status));
+    CheckTestSetting(0, 3);
+    CheckTestSetting(TEST_SETTING_COUNT - 1, 1);
+
+    TestSettingHandles();
+
+    PhDeleteFileWin32(xmlFile->Buffer);
+    PhDeleteFileWin32(storeFile->Buffer);
+    PhDereferenceObject(xmlFile);
+    PhDereferenceObject(storeFile);
+}
@@ -0,0 +1,246 @@
+#include "tests.h"
+#include <systrace.h>
+#include "../../systrace/phtrace.h"
+
+#define TEST_TICKS 20
+#define TEST_TICK_INTERVAL 50
+
+typedef struct _TEST_TICK
+{
+    SYSTEM_PERFORMANCE_INFORMATION PerformanceInformation;
+    PVOID Processes;
+    ULONG ProcessesLength;
+} TEST_TICK, *PTEST_TICK;
+
+static PVOID QueryTestProcesses(
+    _Out_ PULONG Length
+    )
+{
+    NTSTATUS status;
+    PVOID buffer;
+    ULONG bufferSize;
+
+    bufferSize = 0x4000;
+    buffer = PhAllocate(bufferSize);
+
+    while ((status = PhQuerySystemInformation(
+        SystemProcessInformation,
+        buffer,
+        bufferSize,
+        &bufferSize
+        )) == STATUS_INFO_LENGTH_MISMATCH)
+    {
+        PhFree(buffer);
+        buffer = PhAllocate(bufferSize);
+    }
+
+    assert(NT_SUCCESS(status));
+    *Length = bufferSize;
+
+    return buffer;
+}
+
+/**
+ * Replaces the image name pointers of processes with offsets, so that process information can be
+ * compared regardless of the address of its buffer.
+ */
+static VOID NormalizeTestProcesses(
+    _Inout_ PVOID Processes
+    )
+{
+    PSYSTEM_PROCESS_INFORMATION process;
+
+    process = PH_FIRST_PROCESS(Processes);
+
+    do
+    {
+        if (process->ImageName.Buffer)
+            process->ImageName.Buffer = (PWCH)((ULONG_PTR)process->ImageName.Buffer - (ULONG_PTR)process);
+    } while (process = PH_NEXT_PROCESS(process));
+}
+
+static ULONG64 GetTestFileSize(
+    _In_ PPH_STRING FileName
+    )
+{
+    NTSTATUS status;
+    FILE_NETWORK_OPEN_INFORMATION information;
+
+    status = PhQueryFullAttributesFileWin32(FileName->Buffer, &information);
+    assert(NT_SUCCESS(status));
+
+    return information.EndOfFile.QuadPart;
+}
+
+static VOID Test_replay(
+    VOID
+    )
+{
+    static PH_STRINGREF traceFileName = PH_STRINGREF_INIT(L"%TEMP%\\phlib-test-systrace.bin");
+    static CHAR data[] = "This is not a system information trace.";
+    PPH_STRING fileName;
+    PPH_BYTES fileNameUtf8;
+    PPH_FILE_STREAM fileStream;
+    phtrace_file traceFile;
+    phtrace_tick traceTick;
+    PPH_SYSTEM_TRACE trace;
+    PTEST_TICK ticks;
+    SYSTEM_PERFORMANCE_INFORMATION performanceInformation;
+    PVOID processes;
+    ULONG processesLength;
+    ULONG returnLength;
+    ULONG64 rawLength = 0;
+    ULONG64 fileLength;
+    NTSTATUS status;
+    int result;
+    ULONG i;
+
+    fileName = PhExpandEnvironmentStrings(&traceFileName);
+    ticks = PhAllocateZero(sizeof(TEST_TICK) * TEST_TICKS);
+
+    // Record
+
+    status = PhCreateSystemTrace(&trace, fileName->Buffer, 0);
+    assert(NT_SUCCESS(status));
+    assert(!PhGetCurrentSystemTrace());
+
+    for (i = 0; i < TEST_TICKS; i++)
+    {
+        PTEST_TICK tick = &ticks[i];
+
+        if (i != 0)
+            PhDelayExecution(TEST_TICK_INTERVAL);
+
+        status = PhBeginSystemTraceTick(trace);
+        assert(NT_SUCCESS(status));
+        assert(PhGetCurrentSystemTrace() == trace);
+
+        status = PhQuerySystemInformation(
+            SystemPerformanceInformation,
+            &tick->PerformanceInformation,
+            sizeof(SYSTEM_PERFORMANCE_INFORMATION),
+            NULL
+            );
+        assert(NT_SUCCESS(status));
+        tick->Processes = QueryTestProcesses(&tick->ProcessesLength);
+        NormalizeTestProcesses(tick->Processes);
+
+        status = PhEndSystemTraceTick(trace);
+        assert(NT_SUCCESS(status));
+        assert(!PhGetCurrentSystemTrace());
+
+        rawLength += sizeof(SYSTEM_PERFORMANCE_INFORMATION) + tick->ProcessesLength;
+    }
+
+    PhDestroySystemTrace(trace);
+
+    fileLength = GetTestFileSize(fileName);
+
+    wprintf(L"%lu ticks of system information: %I64u bytes recorded as %I64u bytes (%.1f%%)\n",
+        (ULONG)TEST_TICKS,
+        rawLength,
+        fileLength,
+        (DOUBLE)fileLength * 100 / rawLength
+        );
+
+    // The portable reader decodes the same information.
+
+    fileNameUtf8 = PhConvertUtf16ToUtf8(fileName->Buffer);
+    result = phtrace_open(&traceFile, fileNameUtf8->Buffer);
+    assert(result == PHTRACE_OK);
+    assert(traceFile.pointer_size == sizeof(PVOID));
+
+    for (i = 0; i < TEST_TICKS; i++)
+    {
+        const phtrace_block *block;
+
+        result = phtrace_next(&traceFile, &traceTick);
+        assert(result == PHTRACE_OK);
+        block = phtrace_find_block(&traceTick, PHTRACE_CLASS_PROCESS);
+        assert(block && block->length == ticks[i].ProcessesLength);
+        assert(memcmp(block->data, ticks[i].Processes, block->length) == 0);
+    }
+
+    result = phtrace_next(&traceFile, &traceTick);
+    assert(result == PHTRACE_END);
+    phtrace_close(&traceFile);
+    PhDereferenceObject(fileNameUtf8);
+
+    // Replay
+
+    status = PhCreateSystemTrace(&trace, fileName->Buffer, PH_SYSTEM_TRACE_REPLAY);
+    assert(NT_SUCCESS(status));
+
+    for (i = 0; i < TEST_TICKS; i++)
+    {
+        PTEST_TICK tick = &ticks[i];
+
+        status = PhBeginSystemTraceTick(trace);
+        assert(NT_SUCCESS(status));
+
+        memset(&performanceInformation, 0, sizeof(SYSTEM_PERFORMANCE_INFORMATION));
+        status = PhQuerySystemInformation(
+            SystemPerformanceInformation,
+            &performanceInformation,
+            sizeof(SYSTEM_PERFORMANCE_INFORMATION),
+            NULL
+            );
+        assert(NT_SUCCESS(status));
+        assert(memcmp(&performanceInformation, &tick->PerformanceInformation, sizeof(SYSTEM_PERFORMANCE_INFORMATION)) == 0);
+
+        // The required length is returned if the buffer is too small.
+        status = PhQuerySystemInformation(SystemProcessInformation, NULL, 0, &returnLength);
+        assert(status == STATUS_INFO_LENGTH_MISMATCH);
+        assert(returnLength == tick->ProcessesLength);
+
+        processes = QueryTestProcesses(&processesLength);
+        assert(processesLength == tick->ProcessesLength);
+        NormalizeTestProcesses(processes);
+        assert(memcmp(processes, tick->Processes, processesLength) == 0);
+        PhFree(processes);
+
+        status = PhQuerySystemInformation(SystemBasicInformation, NULL, 0, NULL);
+        assert(status == STATUS_NOT_FOUND);
+
+        status = PhEndSystemTraceTick(trace);
+        assert(NT_SUCCESS(status));
+    }
+
+    // The last tick is served again after the end of the trace.
+
+    status = PhBeginSystemTraceTick(trace);
+    assert(status == STATUS_NO_MORE_ENTRIES);
+    processes = QueryTestProcesses(&processesLength);
+    assert(processesLength == ticks[TEST_TICKS - 1].ProcessesLength);
+    PhFree(processes);
+    status = PhEndSystemTraceTick(trace);
+    assert(NT_SUCCESS(status));
+
+    PhDestroySystemTrace(trace);
+
+    for (i = 0; i < TEST_TICKS; i++)
+        PhFree(ticks[i].Processes);
+
+    PhFree(ticks);
+
+    // Other files are rejected.
+
+    status = PhCreateFileStream(&fileStream, fileName->Buffer, FILE_GENERIC_WRITE, FILE_SHARE_READ, FILE_OVERWRITE_IF, 0);
+    assert(NT_SUCCESS(status));
+    status = PhWriteFileStream(fileStream, data, sizeof(data) - 1);
+    assert(NT_SUCCESS(status));
+    PhDereferenceObject(fileStream);
+
+    status = PhCreateSystemTrace(&trace, fileName->Buffer, PH_SYSTEM_TRACE_REPLAY);
+    assert(status == STATUS_FILE_CORRUPT_ERROR);
+
+    PhDeleteFileWin32(fileName->Buffer);
+    PhDereferenceObject(fileName);
+}
+
+VOID Test_systrace(
+    VOID
+    )
+{
+    Test_replay();
+}
@@ -0,0 +1,383 @@
+#include "tests.h"
+#include <timeline.h>
+
+#define TEST_SECOND 10000000LL
+#define TEST_WEEK (7 * 24 * 60 * 60 * TEST_SECOND)
+#define TEST_MAXIMUM_PROCESSES 120000
+#define TEST_QUERY_COUNT 10000
+#define TEST_LINEAR_QUERY_COUNT 500
+
+typedef struct _TEST_PROCESS
+{
+    ULONG ProcessId;
+    LONG64 CreateTime;
+    LONG64 ExitTime;
+} TEST_PROCESS, *PTEST_PROCESS;
+
+static ULONG TestRandomSeed = 1;
+
+static ULONG TestRandom(
+    _In_ ULONG Limit
+    )
+{
+    ULONG value;
+
+    TestRandomSeed = TestRandomSeed * 1103515245 + 12345;
+    value = (TestRandomSeed >> 16) & 0x7fff;
+    TestRandomSeed = TestRandomSeed * 1103515245 + 12345;
+    value = (value << 15) | ((TestRandomSeed >> 16) & 0x7fff);
+
+    return value % Limit;
+}
+
+static VOID Test_basic(
+    VOID
+    )
+{
+    PH_TIMELINE timeline;
+    ULONG values[6];
+    PPH_TIMELINE_ENTRY entry;
+    BOOLEAN result;
+
+    PhInitializeTimeline(&timeline);
+
+    PhAddTimelineEntry(&timeline, 4, 100, &values[0]);
+    PhAddTimelineEntry(&timeline, 4, 300, &values[1]);
+    PhAddTimelineEntry(&timeline, 8, 200, &values[2]);
+    PhAddTimelineEntry(&timeline, 4, 200, &values[3]); // out of order
+    PhAddTimelineEntry(&timeline, 4, 200, &values[4]); // same time
+    PhAddTimelineEntry(&timeline, 4, 50, &values[5]);
+    assert(timeline.Count == 6);
+
+    assert(!PhFindTimelineEntry(&timeline, 4, 49));
+    assert(PhFindTimelineEntry(&timeline, 4, 50)->Value == &values[5]);
+    assert(PhFindTimelineEntry(&timeline, 4, 199)->Value == &values[0]);
+    assert(PhFindTimelineEntry(&timeline, 4, 200)->Value == &values[4]);
+    assert(PhFindTimelineEntry(&timeline, 4, 299)->Value == &values[4]);
+    entry = PhFindTimelineEntry(&timeline, 4, MAXLONG64);
+    assert(entry->Value == &values[1] && entry->Time == 300);
+    assert(!PhFindTimelineEntry(&timeline, 8, 199));
+    assert(PhFindTimelineEntry(&timeline, 8, 200)->Value == &values[2]);
+    assert(!PhFindTimelineEntry(&timeline, 12, MAXLONG64));
+
+    result = PhRemoveTimelineEntry(&timeline, 4, 200, &values[0]);
+    assert(!result);
+    result = PhRemoveTimelineEntry(&timeline, 4, 150, &values[0]);
+    assert(!result);
+    result = PhRemoveTimelineEntry(&timeline, 12, 100, &values[0]);
+    assert(!result);
+    result = PhRemoveTimelineEntry(&timeline, 4, 200, &values[4]);
+    assert(result);
+    assert(PhFindTimelineEntry(&timeline, 4, 299)->Value == &values[3]);
+    result = PhRemoveTimelineEntry(&timeline, 4, 200, &values[3]);
+    assert(result);
+    assert(PhFindTimelineEntry(&timeline, 4, 299)->Value == &values[0]);
+    result = PhRemoveTimelineEntry(&timeline, 8, 200, &values[2]);
+    assert(result);
+    assert(!PhFindTimelineEntry(&timeline, 8, MAXLONG64));
+    assert(timeline.Count == 3);
+
+    PhDeleteTimeline(&timeline);
+}
+
+/**
+ * Simulates a week of process churn. Processes are created every few seconds; most of them exit
+ * within a minute and a few run for hours. Process IDs are reused as soon as they are free.
+ */
+typedef struct _TEST_RECORD
+{
+    PH_RETENTION_ENTRY RetainedEntry;
+    BOOLEAN Referenced; // still needed, so it can't be purged yet
+    BOOLEAN Purged;
+} TEST_RECORD, *PTEST_RECORD;
+
+static BOOLEAN NTAPI TestPurgeRecordCallback(
+    _In_ PPH_RETENTION_ENTRY Entry,
+    _In_opt_ PVOID Context
+    )
+{
+    PTEST_RECORD record = CONTAINING_RECORD(Entry, TEST_RECORD, RetainedEntry);
+
+    assert(!record->Purged);
+
+    if (record->Referenced)
+        return FALSE;
+
+    record->Purged = TRUE;
+
+    return TRUE;
+}
+
+static VOID Test_retention(
+    VOID
+    )
+{
+    static LONG64 times[] = { 100, 300, 200, 50, 400, 200 };
+    LIST_ENTRY listHead;
+    TEST_RECORD records[ARRAYSIZE(times)];
+    PLIST_ENTRY listEntry;
+    LONG64 lastTime;
+    ULONG count;
+    ULONG i;
+
+    InitializeListHead(&listHead);
+    memset(records, 0, sizeof(records));
+
+    for (i = 0; i < ARRAYSIZE(times); i++)
+        PhInsertRetentionEntry(&listHead, &records[i].RetainedEntry, times[i]);
+
+    // The queue is in order of time, and entries with the same time are in order of insertion.
+    lastTime = 0;
+    count = 0;
+
+    for (listEntry = listHead.Flink; listEntry != &listHead; listEntry = listEntry->Flink)
+    {
+        assert(CONTAINING_RECORD(listEntry, PH_RETENTION_ENTRY, ListEntry)->Time >= lastTime);
+        lastTime = CONTAINING_RECORD(listEntry, PH_RETENTION_ENTRY, ListEntry)->Time;
+        count++;
+    }
+
+    assert(count == ARRAYSIZE(times));
+    assert(listHead.Flink == &records[3].RetainedEntry.ListEntry);
+    assert(records[2].RetainedEntry.ListEntry.Flink == &records[5].RetainedEntry.ListEntry);
+
+    // A referenced record at the head must not hold back the expired records behind it.
+    records[3].Referenced = TRUE;
+    records[2].Referenced = TRUE;
+
+    count = PhPurgeRetentionQueue(&listHead, 250, TestPurgeRecordCallback, NULL);
+    assert(count == 2);
+    assert(!records[3].Purged && records[0].Purged && !records[2].Purged && records[5].Purged);
+    assert(!records[1].Purged && !records[4].Purged);
+    assert(listHead.Flink == &records[3].RetainedEntry.ListEntry);
+    assert(records[3].RetainedEntry.ListEntry.Flink == &records[2].RetainedEntry.ListEntry);
+    assert(records[2].RetainedEntry.ListEntry.Flink == &records[1].RetainedEntry.ListEntry);
+
+    // Nothing else has expired yet.
+    count = PhPurgeRetentionQueue(&listHead, 250, TestPurgeRecordCallback, NULL);
+    assert(count == 0);
+
+    // Once they are no longer referenced, the records are purged.
+    records[3].Referenced = FALSE;
+    records[2].Referenced = FALSE;
+
+    count = PhPurgeRetentionQueue(&listHead, 350, TestPurgeRecordCallback, NULL);
+    assert(count == 3);
+    assert(records[3].Purged && records[2].Purged && records[1].Purged && !records[4].Purged);
+    assert(listHead.Flink == &records[4].RetainedEntry.ListEntry);
+    assert(listHead.Blink == &records[4].RetainedEntry.ListEntry);
+
+    count = PhPurgeRetentionQueue(&listHead, MAXLONG64, TestPurgeRecordCallback, NULL);
+    assert(count == 1);
+    assert(records[4].Purged);
+    assert(IsListEmpty(&listHead));
+}
+
+static ULONG CreateTestProcesses(
+    _Out_writes_(TEST_MAXIMUM_PROCESSES) PTEST_PROCESS Processes
+    )
+{
+    PULONG freeProcessIds;
+    ULONG numberOfFreeProcessIds = 0;
+    PULONG activeProcesses;
+    ULONG numberOfActiveProcesses = 0;
+    ULONG nextProcessId = 4;
+    ULONG count = 0;
+    LONG64 time = 0;
+    ULONG i;
+
+    freeProcessIds = PhAllocate(sizeof(ULONG) * TEST_MAXIMUM_PROCESSES);
+    activeProcesses = PhAllocate(sizeof(ULONG) * TEST_MAXIMUM_PROCESSES);
+
+    while (count < TEST_MAXIMUM_PROCESSES)
+    {
+        PTEST_PROCESS process = &Processes[count];
+        ULONG kind;
+
+        time += (1 + TestRandom(11)) * TEST_SECOND;
+
+        if (time >= TEST_WEEK)
+            break;
+
+        for (i = 0; i < numberOfActiveProcesses; i++)
+        {
+            if (Processes[activeProcesses[i]].ExitTime < time)
+            {
+                freeProcessIds[numberOfFreeProcessIds++] = Processes[activeProcesses[i]].ProcessId;
+                activeProcesses[i--] = activeProcesses[--numberOfActiveProcesses];
+            }
+        }
+
+        if (numberOfFreeProcessIds != 0)
+        {
+            process->ProcessId = freeProcessIds[--numberOfFreeProcessIds];
+        }
+        else
+        {
+            process->ProcessId = nextProcessId;
+            nextProcessId += 4;
+        }
+
+        kind = TestRandom(100);
+        process->CreateTime = time;
+
+        if (kind < 70)
+            process->ExitTime = time + (1 + TestRandom(60)) * TEST_SECOND;
+        else if (kind < 95)
+            process->ExitTime = time + (60 + TestRandom(60 * 60)) * TEST_SECOND;
+        else
+            process->ExitTime = time + (60 * 60 + TestRandom(48 * 60 * 60)) * TEST_SECOND;
+
+        activeProcesses[numberOfActiveProcesses++] = count;
+        count++;
+    }
+
+    PhFree(activeProcesses);
+    PhFree(freeProcessIds);
+
+    return count;
+}
+
+/**
+ * Finds a process the way process records used to be found: a binary search by create time over
+ * all processes, followed by a backward scan for the process ID.
+ */
+static PTEST_PROCESS FindTestProcessLinear(
+    _In_ PTEST_PROCESS Processes,
+    _In_ ULONG Count,
+    _In_ ULONG ProcessId,
+    _In_ LONG64 Time
+    )
+{
+    ULONG low = 0;
+    ULONG high = Count;
+    ULONG i;
+
+    while (low < high)
+    {
+        i = low + (high - low) / 2;
+
+        if (Processes[i].CreateTime <= Time)
+            low = i + 1;
+        else
+            high = i;
+    }
+
+    while (low != 0)
+    {
+        low--;
+
+        if (Processes[low].ProcessId == ProcessId)
+            return &Processes[low];
+    }
+
+    return NULL;
+}
+
+static VOID Test_week(
+    VOID
+    )
+{
+    PTEST_PROCESS processes;
+    PULONG queryIndices;
+    PLONG64 queryTimes;
+    ULONG count;
+    PH_TIMELINE timeline;
+    LARGE_INTEGER startCounter;
+    DOUBLE timelineTime;
+    DOUBLE linearTime;
+    BOOLEAN result;
+    ULONG i;
+
+    processes = PhAllocate(sizeof(TEST_PROCESS) * TEST_MAXIMUM_PROCESSES);
+    count = CreateTestProcesses(processes);
+    assert(count > TEST_MAXIMUM_PROCESSES / 2);
+
+    queryIndices = PhAllocate(sizeof(ULONG) * TEST_QUERY_COUNT);
+    queryTimes = PhAllocate(sizeof(LONG64) * TEST_QUERY_COUNT);
+
+    for (i = 0; i < TEST_QUERY_COUNT; i++)
+    {
+        PTEST_PROCESS process;
+
+        queryIndices[i] = TestRandom(count);
+        process = &processes[queryIndices[i]];
+        queryTimes[i] = process->CreateTime + TestRandom((ULONG)((process->ExitTime - process->CreateTime) / TEST_SECOND) + 1) * TEST_SECOND;
+    }
+
+    PhInitializeTimeline(&timeline);
+
+    for (i = 0; i < count; i++)
+        PhAddTimelineEntry(&timeline, processes[i].ProcessId, processes[i].CreateTime, &processes[i]);
+
+    assert(timeline.Count == count);
+
+    // A process is found at any time during its lifetime.
+
+    NtQueryPerformanceCounter(&startCounter, NULL);
+
+    for (i = 0; i < TEST_QUERY_COUNT; i++)
+    {
+        PTEST_PROCESS process = &processes[queryIndices[i]];
+
+        assert(PhFindTimelineEntry(&timeline, process->ProcessId, queryTimes[i])->Value == process);
+    }
+
+    timelineTime = GetElapsedMilliseconds(&startCounter);
+
+    NtQueryPerformanceCounter(&startCounter, NULL);
+
+    for (i = 0; i < TEST_LINEAR_QUERY_COUNT; i++)
+    {
+        PTEST_PROCESS process = &processes[queryIndices[i]];
+
+        assert(FindTestProcessLinear(processes, count, process->ProcessId, queryTimes[i]) == process);
+    }
+
+    linearTime = GetElapsedMilliseconds(&startCounter);
+
+    wprintf(L"%lu processes in a week: %.3f ms per 1000 lookups (%.3f ms with a linear scan)\n",
+        count,
+        timelineTime * 1000 / TEST_QUERY_COUNT,
+        linearTime * 1000 / TEST_LINEAR_QUERY_COUNT
+        );
+
+    // Expire the first half of the week.
+    for (i = 0; i < count; i++)
+    {
+        if (processes[i].ExitTime < TEST_WEEK / 2)
+        {
+            result = PhRemoveTimelineEntry(&timeline, processes[i].ProcessId, processes[i].CreateTime, &processes[i]);
+            assert(result);
+        }
+    }
+
+    for (i = 0; i < TEST_QUERY_COUNT; i++)
+    {
+        PTEST_PROCESS process = &processes[queryIndices[i]];
+        PPH_TIMELINE_ENTRY entry;
+
+        // Earlier processes with the same ID have exited as well.
+        entry = PhFindTimelineEntry(&timeline, process->ProcessId, queryTimes[i]);
+
+        if (process->ExitTime < TEST_WEEK / 2)
+            assert(!entry);
+        else
+            assert(entry->Value == process);
+    }
+
+    PhDeleteTimeline(&timeline);
+
+    PhFree(queryTimes);
+    PhFree(queryIndices);
+    PhFree(processes);
+}
+
+VOID Test_timeline(
+    VOID
+    )
+{
+    Test_basic();
+    Test_retention();
+    Test_week();
+}
@@ -3,6 +3,10 @@
 
 #include <ph.h>
 
+DOUBLE GetElapsedMilliseconds(
+    _In_ PLARGE_INTEGER StartCounter
+    );
+
 VOID Test_basesup(
     VOID
     );
@@ -19,4 +23,56 @@ VOID Test_util(
     VOID
     );
 
+VOID Test_hash(
+    VOID
+    );
+
+VOID Test_graph(
+    VOID
+    );
+
+VOID Test_histbuf(
+    VOID
+    );
+
+VOID Test_binlog(
+    VOID
+    );
+
+VOID Test_settings(
+    VOID
+    );
+
+VOID Test_json(
+    VOID
+    );
+
+VOID Test_colsnap(
+    VOID
+    );
+
+VOID Test_phquery(
+    VOID
+    );
+
+VOID Test_iconcache(
+    VOID
+    );
+
+VOID Test_timeline(
+    VOID
+    );
+
+VOID Test_native(
+    VOID
+    );
+
+VOID Test_systrace(
+    VOID
+    );
+
+VOID Test_provider(
+    VOID
+    );
+
 #endif